@@ -49,6 +49,8 @@ __FBSDID("$FreeBSD$");
 #include <sys/uio.h>
 #ifndef __FreeBSD__
 #include <sys/dkio.h>
+#include <aio.h>
+#include <port.h>
 #endif
 
 #include <assert.h>
@@ -64,6 +66,7 @@ __FBSDID("$FreeBSD$");
 #include <pthread_np.h>
 #include <signal.h>
 #include <sysexits.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <machine/atomic.h>
@@ -83,8 +86,31 @@ __FBSDID("$FreeBSD$");
 /* Enlarge to keep pace with the virtio-block ring size */
 #define BLOCKIF_NUMTHR	16
 #endif
+#define	BLOCKIF_MAXTHR	64	/* limit of the "workers" option */
 #define BLOCKIF_MAXREQ	(BLOCKIF_RING_MAX + BLOCKIF_NUMTHR)
 
+/*
+ * A read or write is blocked in the pending queue while another request that
+ * ends where it starts is pending or in progress.  When a worker thread takes
+ * a request, those blocked behind it are merged into a single preadv() or
+ * pwritev() of up to BLOCKIF_MERGE_MAX bytes, unless the "nomerge" option is
+ * given.
+ */
+#define	BLOCKIF_MERGE_MAX	(1024 * 1024)
+#define	BLOCKIF_MERGE_IOV	(4 * BLOCKIF_IOV_MAX)
+
+#ifndef __FreeBSD__
+/*
+ * With the "aio" option, reads and writes are not performed by the worker
+ * threads but submitted as POSIX asynchronous I/O, with completions delivered
+ * to an event port; for devices whose driver supports it, this is kernel
+ * asynchronous I/O, with no thread waiting for each request.  A request is
+ * submitted as an aiocb for each run of contiguous guest buffers.  Flushes and
+ * deletes are still performed by the worker threads.
+ */
+#define	BLOCKIF_AIO_EVENTS	32
+#endif
+
 enum blockop {
 	BOP_READ,
 	BOP_WRITE,
@@ -110,6 +136,16 @@ struct blockif_elem {
 	enum blockstat	     be_status;
 	pthread_t            be_tid;
 	off_t		     be_block;
+	ssize_t		     be_len;
+	uint64_t	     be_start;
+	struct blockif_elem *be_merged;	/* next request merged into this */
+#ifndef __FreeBSD__
+	struct aiocb	    *be_aiocb;	/* BLOCKIF_IOV_MAX entries, for "aio" */
+	port_notify_t	     be_pn;
+	int		     be_aio_pending;
+	int		     be_aio_err;
+	ssize_t		     be_aio_done;
+#endif
 };
 
 #ifndef __FreeBSD__
@@ -135,9 +171,18 @@ struct blockif_ctxt {
 	int			bc_psectsz;
 	int			bc_psectoff;
 	int			bc_closing;
-	pthread_t		bc_btid[BLOCKIF_NUMTHR];
+	int			bc_merge;
+	int			bc_aio;
+	int			bc_nworkers;
+	pthread_t		bc_btid[BLOCKIF_MAXTHR];
 	pthread_mutex_t		bc_mtx;
 	pthread_cond_t		bc_cond;
+	struct blockif_stats	bc_stats;
+#ifndef __FreeBSD__
+	int			bc_port;
+	pthread_t		bc_aio_tid;
+	struct aiocb		*bc_aiocbs;
+#endif
 
 	/* Request elements and free/pending/busy queues */
 	TAILQ_HEAD(, blockif_elem) bc_freeq;       
@@ -157,6 +202,22 @@ struct blockif_sig_elem {
 
 static struct blockif_sig_elem *blockif_bse_head;
 
+static uint64_t
+blockif_now(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static int
+blockif_isaio(struct blockif_ctxt *bc, enum blockop op)
+{
+
+	return (bc->bc_aio && (op == BOP_READ || op == BOP_WRITE));
+}
+
 static int
 blockif_enqueue(struct blockif_ctxt *bc, struct blockif_req *breq,
 		enum blockop op)
@@ -186,6 +247,9 @@ blockif_enqueue(struct blockif_ctxt *bc, struct blockif_req *breq,
 		off = OFF_MAX;
 	}
 	be->be_block = off;
+	be->be_len = (off == OFF_MAX) ? 0 : off - breq->br_offset;
+	be->be_start = blockif_now();
+	be->be_merged = NULL;
 	TAILQ_FOREACH(tbe, &bc->bc_pendq, be_link) {
 		if (tbe->be_block == breq->br_offset)
 			break;
@@ -204,15 +268,24 @@ blockif_enqueue(struct blockif_ctxt *bc, struct blockif_req *breq,
 	return (be->be_status == BST_PEND);
 }
 
+/*
+ * Take the first pending request for asynchronous I/O, if aio is set, or
+ * else for a worker thread.
+ */
 static int
-blockif_dequeue(struct blockif_ctxt *bc, pthread_t t, struct blockif_elem **bep)
+blockif_dequeue(struct blockif_ctxt *bc, pthread_t t, struct blockif_elem **bep,
+    int aio)
 {
-	struct blockif_elem *be;
+	struct blockif_elem *be, *tbe, *last;
+	ssize_t len;
+	int iovcnt;
 
 	TAILQ_FOREACH(be, &bc->bc_pendq, be_link) {
-		if (be->be_status == BST_PEND)
+		if (be->be_status == BST_PEND &&
+		    blockif_isaio(bc, be->be_op) == aio)
 			break;
-		assert(be->be_status == BST_BLOCK);
+		assert(be->be_status == BST_BLOCK ||
+		    be->be_status == BST_PEND);
 	}
 	if (be == NULL)
 		return (0);
@@ -221,6 +294,37 @@ blockif_dequeue(struct blockif_ctxt *bc, pthread_t t, struct blockif_elem **bep)
 	be->be_tid = t;
 	TAILQ_INSERT_TAIL(&bc->bc_busyq, be, be_link);
 	*bep = be;
+
+	if (!bc->bc_merge || aio || bc->bc_isgeom ||
+	    (be->be_op != BOP_READ && be->be_op != BOP_WRITE))
+		return (1);
+
+	/*
+	 * Merge the requests of the same kind blocked behind this one.
+	 */
+	iovcnt = be->be_req->br_iovcnt;
+	len = be->be_len;
+	for (last = be; ; last = tbe) {
+		TAILQ_FOREACH(tbe, &bc->bc_pendq, be_link) {
+			if (tbe->be_status == BST_BLOCK &&
+			    tbe->be_op == be->be_op &&
+			    tbe->be_req->br_offset == last->be_block)
+				break;
+		}
+		if (tbe == NULL ||
+		    iovcnt + tbe->be_req->br_iovcnt > BLOCKIF_MERGE_IOV ||
+		    len + tbe->be_len > BLOCKIF_MERGE_MAX)
+			break;
+
+		iovcnt += tbe->be_req->br_iovcnt;
+		len += tbe->be_len;
+		TAILQ_REMOVE(&bc->bc_pendq, tbe, be_link);
+		tbe->be_status = BST_BUSY;
+		tbe->be_tid = t;
+		TAILQ_INSERT_TAIL(&bc->bc_busyq, tbe, be_link);
+		last->be_merged = tbe;
+		bc->bc_stats.bs_merged++;
+	}
 	return (1);
 }
 
@@ -243,6 +347,104 @@ blockif_complete(struct blockif_ctxt *bc, struct blockif_elem *be)
 	TAILQ_INSERT_TAIL(&bc->bc_freeq, be, be_link);
 }
 
+static void
+blockif_stat(struct blockif_ctxt *bc, struct blockif_elem *be)
+{
+	struct blockif_stats *bs = &bc->bc_stats;
+	uint64_t lat;
+	int i;
+
+	switch (be->be_op) {
+	case BOP_READ:
+		bs->bs_reads++;
+		bs->bs_read_bytes += be->be_len;
+		break;
+	case BOP_WRITE:
+#ifndef __FreeBSD__
+	case BOP_WRITE_SYNC:
+#endif
+		bs->bs_writes++;
+		bs->bs_write_bytes += be->be_len;
+		break;
+	case BOP_FLUSH:
+		bs->bs_flushes++;
+		break;
+	case BOP_DELETE:
+		bs->bs_deletes++;
+		break;
+	}
+
+	lat = blockif_now() - be->be_start;
+	bs->bs_lat_total += lat;
+	if (lat > bs->bs_lat_max)
+		bs->bs_lat_max = lat;
+	lat /= 1000;
+	for (i = 0; i < BLOCKIF_LATHIST - 1 && lat >= (1ULL << i); i++)
+		;
+	bs->bs_lathist[i]++;
+}
+
+/*
+ * Account for and free a finished request, and those merged into it.
+ */
+static void
+blockif_done(struct blockif_ctxt *bc, struct blockif_elem *be)
+{
+	struct blockif_elem *next;
+
+	for (; be != NULL; be = next) {
+		next = be->be_merged;
+		blockif_stat(bc, be);
+		blockif_complete(bc, be);
+	}
+}
+
+/*
+ * Perform a request and those merged into it with a single preadv() or
+ * pwritev(), and call back for each of them.
+ */
+static void
+blockif_proc_merged(struct blockif_ctxt *bc, struct blockif_elem *be,
+    struct iovec *iov)
+{
+	struct blockif_elem *tbe;
+	struct blockif_req *br;
+	ssize_t len, n;
+	int iovcnt, err;
+
+	iovcnt = 0;
+	for (tbe = be; tbe != NULL; tbe = tbe->be_merged) {
+		br = tbe->be_req;
+		memcpy(&iov[iovcnt], br->br_iov,
+		    br->br_iovcnt * sizeof (struct iovec));
+		iovcnt += br->br_iovcnt;
+	}
+
+	err = 0;
+	len = 0;
+	if (be->be_op == BOP_READ) {
+		if ((len = preadv(bc->bc_fd, iov, iovcnt,
+		    be->be_req->br_offset)) < 0)
+			err = errno;
+	} else if (bc->bc_rdonly) {
+		err = EROFS;
+	} else if ((len = pwritev(bc->bc_fd, iov, iovcnt,
+	    be->be_req->br_offset)) < 0) {
+		err = errno;
+	}
+
+	for (tbe = be; tbe != NULL; tbe = tbe->be_merged) {
+		br = tbe->be_req;
+		if (err == 0) {
+			n = MIN(br->br_resid, len);
+			br->br_resid -= n;
+			len -= n;
+		}
+		tbe->be_status = BST_DONE;
+		(*br->br_callback)(br, err);
+	}
+}
+
 static void
 blockif_proc(struct blockif_ctxt *bc, struct blockif_elem *be, uint8_t *buf)
 {
@@ -418,21 +620,29 @@ blockif_thr(void *arg)
 	struct blockif_elem *be;
 	pthread_t t;
 	uint8_t *buf;
+	struct iovec *iov;
 
 	bc = arg;
 	if (bc->bc_isgeom)
 		buf = malloc(MAXPHYS);
 	else
 		buf = NULL;
+	if (bc->bc_merge)
+		iov = malloc(BLOCKIF_MERGE_IOV * sizeof (struct iovec));
+	else
+		iov = NULL;
 	t = pthread_self();
 
 	pthread_mutex_lock(&bc->bc_mtx);
 	for (;;) {
-		while (blockif_dequeue(bc, t, &be)) {
+		while (blockif_dequeue(bc, t, &be, 0)) {
 			pthread_mutex_unlock(&bc->bc_mtx);
-			blockif_proc(bc, be, buf);
+			if (be->be_merged != NULL)
+				blockif_proc_merged(bc, be, iov);
+			else
+				blockif_proc(bc, be, buf);
 			pthread_mutex_lock(&bc->bc_mtx);
-			blockif_complete(bc, be);
+			blockif_done(bc, be);
 		}
 		/* Check ctxt status here to see if exit requested */
 		if (bc->bc_closing)
@@ -443,9 +653,169 @@ blockif_thr(void *arg)
 
 	if (buf)
 		free(buf);
+	free(iov);
+	pthread_exit(NULL);
+	return (NULL);
+}
+
+#ifndef __FreeBSD__
+/*
+ * Start the asynchronous reads or writes of a request, returning how many
+ * are outstanding.  If none are, the request failed (or was empty) and must
+ * be finished by the caller.
+ */
+static int
+blockif_aio_start(struct blockif_ctxt *bc, struct blockif_elem *be)
+{
+	struct blockif_req *br = be->be_req;
+	struct aiocb *cb = NULL;
+	off_t off;
+	int i, n, error;
+
+	be->be_aio_pending = 0;
+	be->be_aio_err = 0;
+	be->be_aio_done = 0;
+	if (be->be_op == BOP_WRITE && bc->bc_rdonly) {
+		be->be_aio_err = EROFS;
+		return (0);
+	}
+
+	be->be_pn.portnfy_port = bc->bc_port;
+	be->be_pn.portnfy_user = be;
+	off = br->br_offset;
+	n = 0;
+	for (i = 0; i < br->br_iovcnt; i++) {
+		if (cb != NULL && (caddr_t)cb->aio_buf + cb->aio_nbytes ==
+		    br->br_iov[i].iov_base) {
+			cb->aio_nbytes += br->br_iov[i].iov_len;
+		} else {
+			cb = &be->be_aiocb[n++];
+			bzero(cb, sizeof (*cb));
+			cb->aio_fildes = bc->bc_fd;
+			cb->aio_buf = br->br_iov[i].iov_base;
+			cb->aio_nbytes = br->br_iov[i].iov_len;
+			cb->aio_offset = off;
+			cb->aio_sigevent.sigev_notify = SIGEV_PORT;
+			cb->aio_sigevent.sigev_value.sival_ptr = &be->be_pn;
+		}
+		off += br->br_iov[i].iov_len;
+	}
+
+	for (i = 0; i < n; i++) {
+		cb = &be->be_aiocb[i];
+		if (be->be_op == BOP_READ)
+			error = aio_read(cb);
+		else
+			error = aio_write(cb);
+		if (error != 0) {
+			be->be_aio_err = errno;
+			break;
+		}
+		be->be_aio_pending++;
+	}
+	return (be->be_aio_pending);
+}
+
+/*
+ * Submit the pending requests for asynchronous I/O.  Those that fail to
+ * start are finished by blockif_aio_thr(), rather than calling back in the
+ * submitter's context.
+ */
+static void
+blockif_aio_submit(struct blockif_ctxt *bc)
+{
+	struct blockif_elem *be;
+
+	if (bc->bc_closing)
+		return;
+
+	while (blockif_dequeue(bc, 0, &be, 1)) {
+		if (blockif_aio_start(bc, be) == 0 &&
+		    port_send(bc->bc_port, 0, be) != 0)
+			err(EX_OSERR, "Unable to post block i/o completion");
+	}
+}
+
+/*
+ * Call back for a request whose asynchronous I/O has all completed, and
+ * free it.  bc_mtx is dropped for the callback.
+ */
+static void
+blockif_aio_finish(struct blockif_ctxt *bc, struct blockif_elem *be)
+{
+	struct blockif_req *br = be->be_req;
+
+	assert(be->be_aio_pending == 0);
+	br->br_resid -= be->be_aio_done;
+	be->be_status = BST_DONE;
+	pthread_mutex_unlock(&bc->bc_mtx);
+	(*br->br_callback)(br, be->be_aio_err);
+	pthread_mutex_lock(&bc->bc_mtx);
+	blockif_done(bc, be);
+}
+
+static void *
+blockif_aio_thr(void *arg)
+{
+	struct blockif_ctxt *bc = arg;
+	port_event_t pe[BLOCKIF_AIO_EVENTS];
+	struct blockif_elem *be;
+	struct aiocb *cb;
+	uint_t i, n;
+	int closing = 0, error;
+	ssize_t len;
+
+	for (;;) {
+		n = 1;
+		if (port_getn(bc->bc_port, pe, BLOCKIF_AIO_EVENTS, &n,
+		    NULL) != 0) {
+			if (errno == EINTR)
+				continue;
+			err(EX_OSERR, "Unable to get block i/o completions");
+		}
+
+		pthread_mutex_lock(&bc->bc_mtx);
+		for (i = 0; i < n; i++) {
+			be = pe[i].portev_user;
+			if (pe[i].portev_source == PORT_SOURCE_USER) {
+				/* a request that failed to start, or close */
+				if (be != NULL)
+					blockif_aio_finish(bc, be);
+				else
+					closing = 1;
+				continue;
+			}
+
+			assert(pe[i].portev_source == PORT_SOURCE_AIO);
+			cb = (struct aiocb *)pe[i].portev_object;
+			error = aio_error(cb);
+			len = aio_return(cb);
+			if (error != 0) {
+				if (be->be_aio_err == 0)
+					be->be_aio_err = error;
+			} else {
+				be->be_aio_done += len;
+			}
+			if (--be->be_aio_pending == 0)
+				blockif_aio_finish(bc, be);
+		}
+
+		/* Completions may have unblocked other requests */
+		blockif_aio_submit(bc);
+		pthread_cond_broadcast(&bc->bc_cond);
+
+		/* The worker threads have exited; wait for the rest */
+		if (closing && TAILQ_EMPTY(&bc->bc_busyq)) {
+			pthread_mutex_unlock(&bc->bc_mtx);
+			break;
+		}
+		pthread_mutex_unlock(&bc->bc_mtx);
+	}
+
 	pthread_exit(NULL);
 	return (NULL);
 }
+#endif /* __FreeBSD__ */
 
 #ifdef	__FreeBSD__
 static void
@@ -508,7 +878,7 @@ blockif_open(const char *optstr, const char *ident)
 	off_t size, psectsz, psectoff;
 	int extra, fd, i, sectsz;
 	int nocache, sync, ro, candelete, geom, ssopt, pssopt;
-	int nodelete;
+	int nodelete, nomerge, aio, workers;
 
 #ifndef WITHOUT_CAPSICUM
 	cap_rights_t rights;
@@ -523,6 +893,9 @@ blockif_open(const char *optstr, const char *ident)
 	sync = 0;
 	ro = 0;
 	nodelete = 0;
+	nomerge = 0;
+	aio = 0;
+	workers = BLOCKIF_NUMTHR;
 
 	/*
 	 * The first element in the optstring is always a pathname.
@@ -541,6 +914,19 @@ blockif_open(const char *optstr, const char *ident)
 			sync = 1;
 		else if (!strcmp(cp, "ro"))
 			ro = 1;
+		else if (!strcmp(cp, "nomerge"))
+			nomerge = 1;
+#ifndef __FreeBSD__
+		else if (!strcmp(cp, "aio"))
+			aio = 1;
+#endif
+		else if (sscanf(cp, "workers=%d", &workers) == 1) {
+			if (workers < 1 || workers > BLOCKIF_MAXTHR) {
+				EPRINTLN("Invalid number of workers %d",
+				    workers);
+				goto err;
+			}
+		}
 		else if (sscanf(cp, "sectorsize=%d/%d", &ssopt, &pssopt) == 2)
 			;
 		else if (sscanf(cp, "sectorsize=%d", &ssopt) == 1)
@@ -739,6 +1125,9 @@ blockif_open(const char *optstr, const char *ident)
 	bc->bc_sectsz = sectsz;
 	bc->bc_psectsz = psectsz;
 	bc->bc_psectoff = psectoff;
+	bc->bc_merge = !nomerge;
+	bc->bc_aio = aio;
+	bc->bc_nworkers = workers;
 	pthread_mutex_init(&bc->bc_mtx, NULL);
 	pthread_cond_init(&bc->bc_cond, NULL);
 	TAILQ_INIT(&bc->bc_freeq);
@@ -749,7 +1138,30 @@ blockif_open(const char *optstr, const char *ident)
 		TAILQ_INSERT_HEAD(&bc->bc_freeq, &bc->bc_reqs[i], be_link);
 	}
 
-	for (i = 0; i < BLOCKIF_NUMTHR; i++) {
+#ifndef __FreeBSD__
+	if (aio) {
+		if ((bc->bc_port = port_create()) < 0) {
+			warn("Could not create event port for %s", nopt);
+			goto err;
+		}
+		bc->bc_aiocbs = calloc(BLOCKIF_MAXREQ * BLOCKIF_IOV_MAX,
+		    sizeof (struct aiocb));
+		if (bc->bc_aiocbs == NULL) {
+			perror("calloc");
+			close(bc->bc_port);
+			goto err;
+		}
+		for (i = 0; i < BLOCKIF_MAXREQ; i++) {
+			bc->bc_reqs[i].be_aiocb =
+			    &bc->bc_aiocbs[i * BLOCKIF_IOV_MAX];
+		}
+		pthread_create(&bc->bc_aio_tid, NULL, blockif_aio_thr, bc);
+		snprintf(tname, sizeof(tname), "blk-%s-aio", ident);
+		pthread_set_name_np(bc->bc_aio_tid, tname);
+	}
+#endif
+
+	for (i = 0; i < bc->bc_nworkers; i++) {
 		pthread_create(&bc->bc_btid[i], NULL, blockif_thr, bc);
 		snprintf(tname, sizeof(tname), "blk-%s-%d", ident, i);
 		pthread_set_name_np(bc->bc_btid[i], tname);
@@ -777,8 +1189,14 @@ blockif_request(struct blockif_ctxt *bc, struct blockif_req *breq,
 		 * Enqueue and inform the block i/o thread
 		 * that there is work available
 		 */
-		if (blockif_enqueue(bc, breq, op))
-			pthread_cond_signal(&bc->bc_cond);
+		if (blockif_enqueue(bc, breq, op)) {
+#ifndef __FreeBSD__
+			if (blockif_isaio(bc, op))
+				blockif_aio_submit(bc);
+			else
+#endif
+				pthread_cond_signal(&bc->bc_cond);
+		}
 	} else {
 		/*
 		 * Callers are not allowed to enqueue more than
@@ -865,6 +1283,15 @@ blockif_cancel(struct blockif_ctxt *bc, struct blockif_req *breq)
 		return (EINVAL);
 	}
 
+	/*
+	 * Asynchronous I/O cannot be interrupted; it will complete via the
+	 * normal callback path.
+	 */
+	if (be->be_tid == 0) {
+		pthread_mutex_unlock(&bc->bc_mtx);
+		return (EBUSY);
+	}
+
 	/*
 	 * Interrupt the processing thread to force it return
 	 * prematurely via it's normal callback path.
@@ -916,9 +1343,22 @@ blockif_close(struct blockif_ctxt *bc)
 	bc->bc_closing = 1;
 	pthread_mutex_unlock(&bc->bc_mtx);
 	pthread_cond_broadcast(&bc->bc_cond);
-	for (i = 0; i < BLOCKIF_NUMTHR; i++)
+	for (i = 0; i < bc->bc_nworkers; i++)
 		pthread_join(bc->bc_btid[i], &jval);
 
+#ifndef __FreeBSD__
+	/*
+	 * Wait for asynchronous I/O in progress.
+	 */
+	if (bc->bc_aio) {
+		if (port_send(bc->bc_port, 0, NULL) != 0)
+			err(EX_OSERR, "Unable to stop block i/o completions");
+		pthread_join(bc->bc_aio_tid, &jval);
+		close(bc->bc_port);
+		free(bc->bc_aiocbs);
+	}
+#endif
+
 	/* XXX Cancel queued i/o's ??? */
 
 	/*
@@ -1032,6 +1472,16 @@ blockif_candelete(struct blockif_ctxt *bc)
 	return (bc->bc_candelete);
 }
 
+void
+blockif_stats(struct blockif_ctxt *bc, struct blockif_stats *bs)
+{
+
+	assert(bc->bc_magic == BLOCKIF_SIG);
+	pthread_mutex_lock(&bc->bc_mtx);
+	*bs = bc->bc_stats;
+	pthread_mutex_unlock(&bc->bc_mtx);
+}
+
 #ifndef __FreeBSD__
 int
 blockif_set_wce(struct blockif_ctxt *bc, int wc_enable)
@@ -28,6 +28,10 @@
  * $FreeBSD$
  */
 
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
 /*
  * The block API to be used by bhyve block-device emulations. The routines
  * are thread safe, with no assumptions about the context of the completion
@@ -58,6 +62,26 @@ struct blockif_req {
 	struct iovec	br_iov[BLOCKIF_IOV_MAX];
 };
 
+/*
+ * Per-device statistics.  Latencies are from the submission of a request to
+ * its completion; bs_lathist[i] counts requests that took less than 2^i
+ * microseconds, and the last bucket those that took longer.
+ */
+#define	BLOCKIF_LATHIST		24
+
+struct blockif_stats {
+	uint64_t	bs_reads;
+	uint64_t	bs_writes;
+	uint64_t	bs_flushes;
+	uint64_t	bs_deletes;
+	uint64_t	bs_read_bytes;
+	uint64_t	bs_write_bytes;
+	uint64_t	bs_merged;	/* requests merged into another */
+	uint64_t	bs_lat_total;	/* nanoseconds */
+	uint64_t	bs_lat_max;	/* nanoseconds */
+	uint64_t	bs_lathist[BLOCKIF_LATHIST];
+};
+
 struct blockif_ctxt;
 struct blockif_ctxt *blockif_open(const char *optstr, const char *ident);
 off_t	blockif_size(struct blockif_ctxt *bc);
@@ -77,5 +101,6 @@ int	blockif_flush(struct blockif_ctxt *bc, struct blockif_req *breq);
 int	blockif_delete(struct blockif_ctxt *bc, struct blockif_req *breq);
 int	blockif_cancel(struct blockif_ctxt *bc, struct blockif_req *breq);
 int	blockif_close(struct blockif_ctxt *bc);
+void	blockif_stats(struct blockif_ctxt *bc, struct blockif_stats *bs);
 
 #endif /* _BLOCK_IF_H_ */
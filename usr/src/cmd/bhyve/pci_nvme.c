@@ -29,11 +29,16 @@
  * SUCH DAMAGE.
  */
 
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
 /*
  * bhyve PCIe-NVMe device emulation.
  *
  * options:
- *  -s <n>,nvme,devpath,maxq=#,qsz=#,ioslots=#,sectsz=#,ser=A-Z,eui64=#
+ *  -s <n>,nvme,devpath,maxq=#,qsz=#,ioslots=#,sectsz=#,ser=A-Z,eui64=#,
+ *      iothreads
  *
  *  accepted devpath:
  *    /dev/blockdev
@@ -46,12 +51,25 @@
  *  sectsz  = sector size (defaults to blockif sector size)
  *  ser     = serial number (20-chars max)
  *  eui64   = IEEE Extended Unique Identifier (8 byte value)
+ *  iothreads = service each I/O submission queue from its own thread
  *
+ * Without iothreads, I/O submission queues are processed by the vCPU which
+ * writes the doorbell.  With it, a doorbell write just wakes the queue's
+ * thread, and the vCPU returns to the guest straight away.  Either way, the
+ * guest may configure shadow doorbells (Doorbell Buffer Config), after which
+ * it only writes a doorbell register when the EventIdx we publish shows that
+ * we have caught up with the queue; while a queue's thread is busy, further
+ * submissions cost the guest no exits at all.  Completion queue heads are
+ * likewise read from the shadow each time a completion is posted.
+ *
+ * Interrupt coalescing is implemented as specified: completions on I/O
+ * queues whose vector has coalescing enabled are signalled once the
+ * aggregation threshold is exceeded, or the aggregation time has passed
+ * since the first of them.
  */
 
 /* TODO:
     - create async event for smart and log
-    - intr coalesce
  */
 
 #include <sys/cdefs.h>
@@ -65,6 +83,7 @@ __FBSDID("$FreeBSD$");
 
 #include <assert.h>
 #include <pthread.h>
+#include <pthread_np.h>
 #include <semaphore.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -72,6 +91,7 @@ __FBSDID("$FreeBSD$");
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <machine/atomic.h>
 #include <machine/vmm.h>
@@ -121,6 +141,10 @@ static int nvme_debug = 0;
 
 #define	NVME_DOORBELL_OFFSET	offsetof(struct nvme_registers, doorbell)
 
+/* Index of a queue's doorbell within the shadow and EventIdx buffers */
+#define	NVME_DBBUF_SQ(qid)	((qid) * 2)
+#define	NVME_DBBUF_CQ(qid)	((qid) * 2 + 1)
+
 enum nvme_controller_register_offsets {
 	NVME_CR_CAP_LOW = 0x00,
 	NVME_CR_CAP_HI  = 0x04,
@@ -158,6 +182,8 @@ struct nvme_completion_queue {
 	uint16_t	head; /* guest progress */
 	uint16_t	intr_vec;
 	uint32_t	intr_en;
+	uint32_t	intr_pending;	/* completions not yet signalled */
+	uint64_t	intr_deadline;	/* when they must be, or 0 */
 	pthread_mutex_t	mtx;
 };
 
@@ -169,6 +195,13 @@ struct nvme_submission_queue {
 	uint16_t	cqid; /* completion queue id */
 	int		busy; /* queue is being processed */
 	int		qpriority;
+
+	/* with iothreads, the thread servicing the queue */
+	struct pci_nvme_softc *sc;
+	pthread_t	tid;
+	pthread_mutex_t	mtx;
+	pthread_cond_t	cond;
+	bool		kick;	/* doorbell written since last pass */
 };
 
 enum nvme_storage_type {
@@ -261,6 +294,18 @@ struct pci_nvme_softc {
 	uint32_t	async_ev_config;         /* 0x0B: async event config */
 
 	enum nvme_dsm_type dataset_management;
+
+	bool		iothreads;
+
+	/* guest shadow doorbell and EventIdx buffers, if configured */
+	uint32_t	*dbbuf_shadow;
+	uint32_t	*dbbuf_eventidx;
+
+	/* expires coalesced interrupts */
+	pthread_t	coal_tid;
+	pthread_mutex_t	coal_mtx;
+	pthread_cond_t	coal_cond;
+	bool		coal_kick;
 };
 
 
@@ -364,7 +409,8 @@ pci_nvme_init_ctrldata(struct pci_nvme_softc *sc)
 
 	cd->ver = 0x00010300;
 
-	cd->oacs = 1 << NVME_CTRLR_DATA_OACS_FORMAT_SHIFT;
+	cd->oacs = 1 << NVME_CTRLR_DATA_OACS_FORMAT_SHIFT |
+	    1 << NVME_CTRLR_DATA_OACS_DBBUFFER_SHIFT;
 	cd->acl = 2;
 	cd->aerl = 4;
 
@@ -512,6 +558,8 @@ pci_nvme_reset_locked(struct pci_nvme_softc *sc)
 	sc->regs.csts = 0;
 
 	sc->num_cqueues = sc->num_squeues = sc->max_queues;
+	sc->dbbuf_shadow = NULL;
+	sc->dbbuf_eventidx = NULL;
 	if (sc->submit_queues != NULL) {
 		for (int i = 0; i < sc->num_squeues + 1; i++) {
 			/*
@@ -542,6 +590,8 @@ pci_nvme_reset_locked(struct pci_nvme_softc *sc)
 
 			sc->compl_queues[i].tail = 0;
 			sc->compl_queues[i].head = 0;
+			sc->compl_queues[i].intr_pending = 0;
+			sc->compl_queues[i].intr_deadline = 0;
 		}
 	} else {
 		sc->compl_queues = calloc(sc->num_cqueues + 1,
@@ -738,6 +788,12 @@ nvme_opc_create_io_cq(struct pci_nvme_softc* sc, struct nvme_command* command,
 		ncq->intr_vec = (command->cdw11 >> 16) & 0xffff;
 		ncq->size = ONE_BASED((command->cdw10 >> 16) & 0xffff);
 
+		/* Coalescing is on for all but the admin vector by default */
+		if (ncq->intr_vec != 0)
+			ncq->intr_en |= NVME_CQ_INTCOAL;
+		ncq->intr_pending = 0;
+		ncq->intr_deadline = 0;
+
 		ncq->qbase = vm_map_gpa(sc->nsc_pi->pi_vmctx,
 		             command->prp1,
 		             sizeof(struct nvme_command) * (size_t)ncq->size);
@@ -758,6 +814,26 @@ nvme_opc_create_io_cq(struct pci_nvme_softc* sc, struct nvme_command* command,
 	return (1);
 }
 
+/*
+ * Fill in the I/O counters of the SMART / Health log from the statistics of
+ * the backing store.  Data units are thousands of 512-byte units, rounded up.
+ */
+static void
+pci_nvme_health_update(struct pci_nvme_softc *sc)
+{
+	struct nvme_health_information_page *hl = &sc->health_log;
+	struct blockif_stats bs;
+
+	if (sc->nvstore.type != NVME_STOR_BLOCKIF)
+		return;
+
+	blockif_stats(sc->nvstore.ctx, &bs);
+	hl->data_units_read[0] = howmany(bs.bs_read_bytes, 512 * 1000);
+	hl->data_units_written[0] = howmany(bs.bs_write_bytes, 512 * 1000);
+	hl->host_read_commands[0] = bs.bs_reads;
+	hl->host_write_commands[0] = bs.bs_writes;
+}
+
 static int
 nvme_opc_get_log_page(struct pci_nvme_softc* sc, struct nvme_command* command,
 	struct nvme_completion* compl)
@@ -776,7 +852,7 @@ nvme_opc_get_log_page(struct pci_nvme_softc* sc, struct nvme_command* command,
 		    NVME_COPY_TO_PRP);
 		break;
 	case NVME_LOG_HEALTH_INFORMATION:
-		/* TODO: present some smart info */
+		pci_nvme_health_update(sc);
 		nvme_prp_memcpy(sc->nsc_pi->pi_vmctx, command->prp1,
 		    command->prp2, (uint8_t *)&sc->health_log, logsize,
 		    NVME_COPY_TO_PRP);
@@ -930,15 +1006,22 @@ nvme_opc_set_features(struct pci_nvme_softc* sc, struct nvme_command* command,
 		DPRINTF(("  interrupt vector configuration 0x%x",
 		        command->cdw11));
 
-		for (uint32_t i = 0; i < sc->num_cqueues + 1; i++) {
-			if (sc->compl_queues[i].intr_vec == iv) {
-				if (command->cdw11 & (1 << 16))
-					sc->compl_queues[i].intr_en |=
-					                      NVME_CQ_INTCOAL;  
-				else
-					sc->compl_queues[i].intr_en &=
-					                     ~NVME_CQ_INTCOAL;  
-			}
+		/* The admin vector is never coalesced */
+		if (iv == 0)
+			break;
+
+		/* Bit 16 is Coalescing Disable */
+		for (uint32_t i = 1; i < sc->num_cqueues + 1; i++) {
+			struct nvme_completion_queue *cq = &sc->compl_queues[i];
+
+			if (cq->intr_vec != iv)
+				continue;
+			pthread_mutex_lock(&cq->mtx);
+			if (command->cdw11 & (1 << 16))
+				cq->intr_en &= ~NVME_CQ_INTCOAL;
+			else
+				cq->intr_en |= NVME_CQ_INTCOAL;
+			pthread_mutex_unlock(&cq->mtx);
 		}
 		break;
 	case NVME_FEAT_WRITE_ATOMICITY:
@@ -1021,9 +1104,26 @@ nvme_opc_get_features(struct pci_nvme_softc* sc, struct nvme_command* command,
 		break;
 	case NVME_FEAT_INTERRUPT_COALESCING:
 		DPRINTF(("  interrupt coalescing"));
+		compl->cdw0 = (sc->intr_coales_aggr_time / 100) << 8 |
+		    sc->intr_coales_aggr_thresh;
 		break;
 	case NVME_FEAT_INTERRUPT_VECTOR_CONFIGURATION:
 		DPRINTF(("  interrupt vector configuration"));
+		compl->cdw0 = command->cdw11 & 0xFFFF;
+		if (compl->cdw0 == 0) {
+			/* the admin vector is never coalesced */
+			compl->cdw0 |= 1 << 16;
+			break;
+		}
+		for (uint32_t i = 1; i < sc->num_cqueues + 1; i++) {
+			struct nvme_completion_queue *cq = &sc->compl_queues[i];
+
+			if (cq->intr_vec == compl->cdw0 &&
+			    (cq->intr_en & NVME_CQ_INTCOAL) == 0) {
+				compl->cdw0 |= 1 << 16;
+				break;
+			}
+		}
 		break;
 	case NVME_FEAT_WRITE_ATOMICITY:
 		DPRINTF(("  write atomicity"));
@@ -1062,6 +1162,53 @@ nvme_opc_abort(struct pci_nvme_softc* sc, struct nvme_command* command,
 	return (1);
 }
 
+/*
+ * Doorbell Buffer Config: PRP1 is the page of shadow doorbells which the guest
+ * writes instead of the registers, and PRP2 the page of EventIdx values with
+ * which we tell it when it must still write the registers.  Both are laid
+ * out as the doorbell registers are, and are only used for I/O queues.
+ */
+static int
+nvme_opc_dbbuf_config(struct pci_nvme_softc* sc, struct nvme_command* command,
+	struct nvme_completion* compl)
+{
+	struct vmctx *ctx = sc->nsc_pi->pi_vmctx;
+	uint32_t *shadow, *eventidx;
+
+	DPRINTF(("%s shadow 0x%lx eventidx 0x%lx", __func__, command->prp1,
+	    command->prp2));
+
+	if (command->prp1 == 0 || (command->prp1 & PAGE_MASK) != 0 ||
+	    command->prp2 == 0 || (command->prp2 & PAGE_MASK) != 0) {
+		pci_nvme_status_genc(&compl->status, NVME_SC_INVALID_FIELD);
+		return (1);
+	}
+
+	shadow = vm_map_gpa(ctx, command->prp1, PAGE_SIZE);
+	eventidx = vm_map_gpa(ctx, command->prp2, PAGE_SIZE);
+	if (shadow == NULL || eventidx == NULL) {
+		pci_nvme_status_genc(&compl->status, NVME_SC_INVALID_FIELD);
+		return (1);
+	}
+
+	/* Start from where the doorbell registers have got to */
+	for (uint32_t i = 1; i < sc->num_squeues + 1; i++) {
+		shadow[NVME_DBBUF_SQ(i)] = sc->submit_queues[i].tail;
+		eventidx[NVME_DBBUF_SQ(i)] = sc->submit_queues[i].tail;
+	}
+	for (uint32_t i = 1; i < sc->num_cqueues + 1; i++) {
+		shadow[NVME_DBBUF_CQ(i)] = sc->compl_queues[i].head;
+		eventidx[NVME_DBBUF_CQ(i)] = sc->compl_queues[i].head;
+	}
+	atomic_thread_fence_seq_cst();
+
+	sc->dbbuf_eventidx = eventidx;
+	sc->dbbuf_shadow = shadow;
+
+	pci_nvme_status_genc(&compl->status, NVME_SC_SUCCESS);
+	return (1);
+}
+
 #ifdef __FreeBSD__
 static int
 nvme_opc_async_event_req(struct pci_nvme_softc* sc,
@@ -1155,6 +1302,11 @@ pci_nvme_handle_admin_cmd(struct pci_nvme_softc* sc, uint64_t value)
 			*/
 			compl.status = NVME_NO_STATUS;
 			break;
+		case NVME_OPC_DOORBELL_BUFFER_CONFIG:
+			DPRINTF(("%s command DOORBELL_BUFFER_CONFIG",
+			    __func__));
+			nvme_opc_dbbuf_config(sc, cmd, &compl);
+			break;
 		default:
 			WPRINTF(("0x%x command is not implemented",
 			    cmd->opc));
@@ -1273,6 +1425,125 @@ pci_nvme_append_iov_req(struct pci_nvme_softc *sc, struct pci_nvme_ioreq *req,
 	return (0);
 }
 
+static uint64_t
+pci_nvme_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/*
+ * Decide whether the interrupt for a completion just posted to an I/O queue
+ * can be held back by interrupt coalescing.  Called with cq->mtx held.
+ */
+static bool
+pci_nvme_cq_intr_defer(struct pci_nvme_softc *sc,
+	struct nvme_completion_queue *cq)
+{
+	uint32_t aggr_time = sc->intr_coales_aggr_time;
+
+	if ((cq->intr_en & NVME_CQ_INTCOAL) == 0 || aggr_time == 0)
+		return (false);
+
+	/* The threshold is a zero-based count of entries */
+	if (++cq->intr_pending > sc->intr_coales_aggr_thresh) {
+		cq->intr_pending = 0;
+		cq->intr_deadline = 0;
+		return (false);
+	}
+
+	if (cq->intr_deadline == 0) {
+		cq->intr_deadline = pci_nvme_now() + aggr_time * 1000ULL;
+		pthread_mutex_lock(&sc->coal_mtx);
+		sc->coal_kick = true;
+		pthread_cond_signal(&sc->coal_cond);
+		pthread_mutex_unlock(&sc->coal_mtx);
+	}
+	return (true);
+}
+
+/*
+ * Signal the coalesced interrupts whose aggregation time has passed, and
+ * return the earliest deadline of those still held back, or 0 if none are.
+ */
+static uint64_t
+pci_nvme_cq_intr_expire(struct pci_nvme_softc *sc)
+{
+	uint64_t now = pci_nvme_now();
+	uint64_t next = 0;
+
+	for (uint32_t i = 1; i < sc->num_cqueues + 1; i++) {
+		struct nvme_completion_queue *cq = &sc->compl_queues[i];
+		bool fire = false;
+
+		pthread_mutex_lock(&cq->mtx);
+		if (cq->intr_deadline != 0 && cq->intr_deadline <= now) {
+			cq->intr_pending = 0;
+			cq->intr_deadline = 0;
+			fire = (cq->intr_en & NVME_CQ_INTEN) != 0;
+		} else if (cq->intr_deadline != 0 &&
+		    (next == 0 || cq->intr_deadline < next)) {
+			next = cq->intr_deadline;
+		}
+		pthread_mutex_unlock(&cq->mtx);
+
+		if (fire)
+			pci_generate_msix(sc->nsc_pi, cq->intr_vec);
+	}
+
+	return (next);
+}
+
+static void *
+pci_nvme_coal_thr(void *arg)
+{
+	struct pci_nvme_softc *sc = arg;
+	struct timespec ts;
+	uint64_t next;
+
+	for (;;) {
+		next = pci_nvme_cq_intr_expire(sc);
+
+		pthread_mutex_lock(&sc->coal_mtx);
+		if (!sc->coal_kick && next == 0) {
+			pthread_cond_wait(&sc->coal_cond, &sc->coal_mtx);
+		} else if (!sc->coal_kick) {
+			ts.tv_sec = next / 1000000000;
+			ts.tv_nsec = next % 1000000000;
+			pthread_cond_timedwait(&sc->coal_cond, &sc->coal_mtx,
+			    &ts);
+		}
+		sc->coal_kick = false;
+		pthread_mutex_unlock(&sc->coal_mtx);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Bring an I/O completion queue's head up to date from the guest's shadow
+ * doorbell, and publish it as the EventIdx, so that the guest goes on
+ * writing the shadow alone until it moves its head past what we have seen.
+ * Called with cq->mtx held.
+ */
+static void
+pci_nvme_cq_head(struct pci_nvme_softc *sc, struct nvme_completion_queue *cq,
+	uint16_t idx)
+{
+	uint32_t *shadow = sc->dbbuf_shadow;
+	uint32_t head;
+
+	if (shadow == NULL || idx == 0)
+		return;
+
+	head = atomic_load_acq_32(&shadow[NVME_DBBUF_CQ(idx)]);
+	if (head < cq->size)
+		cq->head = (uint16_t)head;
+	atomic_store_rel_32(&sc->dbbuf_eventidx[NVME_DBBUF_CQ(idx)], cq->head);
+}
+
 static void
 pci_nvme_set_completion(struct pci_nvme_softc *sc,
 	struct nvme_submission_queue *sq, int sqid, uint16_t cid,
@@ -1280,6 +1551,7 @@ pci_nvme_set_completion(struct pci_nvme_softc *sc,
 {
 	struct nvme_completion_queue *cq = &sc->compl_queues[sq->cqid];
 	struct nvme_completion *compl;
+	bool pending;
 	int phase;
 
 	DPRINTF(("%s sqid %d cqid %u cid %u status: 0x%x 0x%x",
@@ -1290,6 +1562,7 @@ pci_nvme_set_completion(struct pci_nvme_softc *sc,
 
 	assert(cq->qbase != NULL);
 
+	pci_nvme_cq_head(sc, cq, sq->cqid);
 	compl = &cq->qbase[cq->tail];
 
 	compl->cdw0 = cdw0;
@@ -1304,9 +1577,18 @@ pci_nvme_set_completion(struct pci_nvme_softc *sc,
 
 	cq->tail = (cq->tail + 1) % cq->size;
 
+	pci_nvme_cq_head(sc, cq, sq->cqid);
+	pending = (cq->head != cq->tail);
+
+	if (pending && (cq->intr_en & NVME_CQ_INTEN) &&
+	    pci_nvme_cq_intr_defer(sc, cq)) {
+		pthread_mutex_unlock(&cq->mtx);
+		return;
+	}
+
 	pthread_mutex_unlock(&cq->mtx);
 
-	if (cq->head != cq->tail) {
+	if (pending) {
 		if (cq->intr_en & NVME_CQ_INTEN) {
 			pci_generate_msix(sc->nsc_pi, cq->intr_vec);
 		} else {
@@ -1519,6 +1801,26 @@ out:
 	return (err);
 }
 
+/*
+ * The guest's tail for an I/O submission queue.  With shadow doorbells it is
+ * the shadow which is current, the register only being written now and then.
+ */
+static uint16_t
+pci_nvme_sq_tail(struct pci_nvme_softc *sc, struct nvme_submission_queue *sq,
+	uint16_t idx)
+{
+	uint32_t *shadow = sc->dbbuf_shadow;
+	uint32_t tail;
+
+	if (shadow != NULL) {
+		tail = atomic_load_acq_32(&shadow[NVME_DBBUF_SQ(idx)]);
+		if (tail < sq->size)
+			atomic_store_short(&sq->tail, (uint16_t)tail);
+	}
+
+	return (atomic_load_acq_short(&sq->tail));
+}
+
 static void
 pci_nvme_handle_io_cmd(struct pci_nvme_softc* sc, uint16_t idx)
 {
@@ -1540,7 +1842,8 @@ pci_nvme_handle_io_cmd(struct pci_nvme_softc* sc, uint16_t idx)
 	DPRINTF(("nvme_handle_io qid %u head %u tail %u cmdlist %p",
 	         idx, sqhead, sq->tail, sq->qbase));
 
-	while (sqhead != atomic_load_acq_short(&sq->tail)) {
+again:
+	while (sqhead != pci_nvme_sq_tail(sc, sq, idx)) {
 		struct nvme_command *cmd;
 		struct pci_nvme_ioreq *req = NULL;
 		uint64_t lba;
@@ -1729,9 +2032,52 @@ do_error:
 	}
 
 	atomic_store_short(&sq->head, sqhead);
+
+	/*
+	 * Tell the guest how far we have got, so that it writes the doorbell
+	 * for its next submission, then look again for any it made without
+	 * doing so while we were busy.
+	 */
+	if (sc->dbbuf_eventidx != NULL) {
+		atomic_store_rel_32(&sc->dbbuf_eventidx[NVME_DBBUF_SQ(idx)],
+		    sqhead);
+		atomic_thread_fence_seq_cst();
+		if (pci_nvme_sq_tail(sc, sq, idx) != sqhead)
+			goto again;
+	}
+
 	atomic_store_int(&sq->busy, 0);
 }
 
+static void *
+pci_nvme_sq_thr(void *arg)
+{
+	struct nvme_submission_queue *sq = arg;
+	struct pci_nvme_softc *sc = sq->sc;
+	uint16_t idx = sq - sc->submit_queues;
+
+	for (;;) {
+		pthread_mutex_lock(&sq->mtx);
+		while (!sq->kick)
+			pthread_cond_wait(&sq->cond, &sq->mtx);
+		sq->kick = false;
+		pthread_mutex_unlock(&sq->mtx);
+
+		pci_nvme_handle_io_cmd(sc, idx);
+	}
+
+	return (NULL);
+}
+
+static void
+pci_nvme_sq_kick(struct nvme_submission_queue *sq)
+{
+	pthread_mutex_lock(&sq->mtx);
+	sq->kick = true;
+	pthread_cond_signal(&sq->cond);
+	pthread_mutex_unlock(&sq->mtx);
+}
+
 static void
 pci_nvme_handle_doorbell(struct vmctx *ctx, struct pci_nvme_softc* sc,
 	uint64_t idx, int is_sq, uint64_t value)
@@ -1753,7 +2099,10 @@ pci_nvme_handle_doorbell(struct vmctx *ctx, struct pci_nvme_softc* sc,
 				         __func__, idx, sc->num_squeues));
 				return;
 			}
-			pci_nvme_handle_io_cmd(sc, (uint16_t)idx);
+			if (sc->iothreads)
+				pci_nvme_sq_kick(&sc->submit_queues[idx]);
+			else
+				pci_nvme_handle_io_cmd(sc, (uint16_t)idx);
 		}
 	} else {
 		if (idx > sc->num_cqueues) {
@@ -2091,6 +2440,8 @@ pci_nvme_parse_opts(struct pci_nvme_softc *sc, char *opts)
 				sc->dataset_management = NVME_DATASET_MANAGEMENT_ENABLE;
 			else if (!strcmp("disable", config))
 				sc->dataset_management = NVME_DATASET_MANAGEMENT_DISABLE;
+		} else if (!strcmp("iothreads", xopts)) {
+			sc->iothreads = true;
 		} else if (optidx == 0) {
 			snprintf(bident, sizeof(bident), "%d:%d",
 			         sc->nsc_pi->pi_slot, sc->nsc_pi->pi_func);
@@ -2143,6 +2494,8 @@ static int
 pci_nvme_init(struct vmctx *ctx, struct pci_devinst *pi, char *opts)
 {
 	struct pci_nvme_softc *sc;
+	pthread_condattr_t attr;
+	char tname[MAXCOMLEN + 1];
 	uint32_t pci_membar_sz;
 	int	error;
 
@@ -2165,7 +2518,6 @@ pci_nvme_init(struct vmctx *ctx, struct pci_devinst *pi, char *opts)
 		pthread_mutex_init(&sc->ioreqs[i].mtx, NULL);
 		pthread_cond_init(&sc->ioreqs[i].cv, NULL);
 	}
-	sc->intr_coales_aggr_thresh = 1;
 
 	pci_set_cfgdata16(pi, PCIR_DEVICE, 0x0A0A);
 	pci_set_cfgdata16(pi, PCIR_VENDOR, 0xFB5D);
@@ -2217,6 +2569,31 @@ pci_nvme_init(struct vmctx *ctx, struct pci_devinst *pi, char *opts)
 	pci_nvme_init_ctrldata(sc);
 	pci_nvme_init_logpages(sc);
 
+	pthread_mutex_init(&sc->coal_mtx, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sc->coal_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_create(&sc->coal_tid, NULL, pci_nvme_coal_thr, sc);
+	snprintf(tname, sizeof(tname), "nvme-%d:%d-intr", pi->pi_slot,
+	    pi->pi_func);
+	pthread_set_name_np(sc->coal_tid, tname);
+
+	if (sc->iothreads) {
+		for (uint32_t i = 1; i < sc->max_queues + 1; i++) {
+			struct nvme_submission_queue *sq;
+
+			sq = &sc->submit_queues[i];
+			sq->sc = sc;
+			pthread_mutex_init(&sq->mtx, NULL);
+			pthread_cond_init(&sq->cond, NULL);
+			pthread_create(&sq->tid, NULL, pci_nvme_sq_thr, sq);
+			snprintf(tname, sizeof(tname), "nvme-%d:%d-sq%u",
+			    pi->pi_slot, pi->pi_func, i);
+			pthread_set_name_np(sq->tid, tname);
+		}
+	}
+
 	pci_lintr_request(pi);
 
 done:
@@ -0,0 +1,784 @@
+/*
+ * Copyright (c) 2011 NetApp, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NETAPP, INC ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL NETAPP, INC OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * Copyright 2015 Pluribus Networks Inc.
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * virtio-blk-viob: a virtio-blk device whose request queue is processed by
+ * the viob driver in the kernel, against the backing zvol or file directly.
+ * As with virtio-net-viona, this emulates the PCI device and configuration
+ * space, relaying the ring setup, MSI-X configuration and feature negotiation
+ * to the kernel.  Usage:
+ *
+ *	-s <slot>,virtio-blk-viob,<path>[,ro][,vqsize=<n>]
+ */
+
+#include <sys/cdefs.h>
+
+#include <sys/param.h>
+#include <sys/linker_set.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/dkio.h>
+#include <sys/viob_io.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <poll.h>
+#include <md5.h>
+
+#include <machine/vmm.h>
+#include <vmmapi.h>
+
+#include "bhyverun.h"
+#include "pci_emul.h"
+#include "virtio.h"
+
+#define	VIOB_RINGSZ	128
+#define	VIOB_BSIZE	512
+
+#define	VIOB_MAXQ	1
+
+/*
+ * Debug printf
+ */
+static volatile int pci_viob_debug;
+#define	DPRINTF(params) if (pci_viob_debug) printf params
+#define	WPRINTF(params) printf params
+
+/*
+ * Config space "registers", as for virtio-blk.  Only the fields up to and
+ * including the topology are advertised by viob.
+ */
+struct viob_config {
+	uint64_t	vbc_capacity;
+	uint32_t	vbc_size_max;
+	uint32_t	vbc_seg_max;
+	struct {
+		uint16_t cylinders;
+		uint8_t heads;
+		uint8_t sectors;
+	} vbc_geometry;
+	uint32_t	vbc_blk_size;
+	struct {
+		uint8_t physical_block_exp;
+		uint8_t alignment_offset;
+		uint16_t min_io_size;
+		uint32_t opt_io_size;
+	} vbc_topology;
+	uint8_t		vbc_writeback;
+} __packed;
+
+#define	VIOB_REGSZ	(VTCFG_R_CFG1 + sizeof (struct viob_config))
+
+/*
+ * Per-device softc
+ */
+struct pci_viob_softc {
+	struct pci_devinst *vsc_pi;
+	pthread_mutex_t vsc_mtx;
+
+	int		vsc_curq;
+	int		vsc_status;
+	int		vsc_isr;
+
+	int		vsc_viobfd;
+
+	/* Configurable parameters */
+	char		*vsc_path;
+	boolean_t	vsc_rdonly;
+	uint16_t	vsc_vq_size;
+
+	uint32_t	vsc_features;
+	struct viob_config vsc_cfg;
+
+	uint64_t	vsc_pfn[VIOB_MAXQ];
+	uint16_t	vsc_msix_table_idx[VIOB_MAXQ + 1];
+	boolean_t	vsc_msix_active;
+};
+
+/* The configuration change vector follows those of the queues */
+#define	VIOB_CFGVEC	VIOB_MAXQ
+
+/*
+ * Return the size of IO BAR that maps virtio header and device specific
+ * region. The size would vary depending on whether MSI-X is enabled or
+ * not.
+ */
+static uint64_t
+pci_viob_iosize(struct pci_devinst *pi)
+{
+	if (pci_msix_enabled(pi))
+		return (VIOB_REGSZ);
+	else
+		return (VIOB_REGSZ - (VTCFG_R_CFG1 - VTCFG_R_MSIX));
+}
+
+static void
+pci_viob_ring_reset(struct pci_viob_softc *sc, int ring)
+{
+	assert(ring < VIOB_MAXQ);
+
+	for (;;) {
+		int res;
+
+		res = ioctl(sc->vsc_viobfd, VIOB_IOC_RING_RESET, ring);
+		if (res == 0) {
+			break;
+		} else if (errno != EINTR) {
+			WPRINTF(("ioctl viob ring %d reset failed %d\n",
+			    ring, errno));
+			return;
+		}
+	}
+
+	sc->vsc_pfn[ring] = 0;
+}
+
+static void
+pci_viob_update_status(struct pci_viob_softc *sc, uint32_t value)
+{
+
+	if (value == 0) {
+		uint64_t feat = 0;
+
+		DPRINTF(("viob: device reset requested !\n"));
+		pci_viob_ring_reset(sc, 0);
+
+		/* Disable write cache until FLUSH feature is negotiated */
+		if (ioctl(sc->vsc_viobfd, VIOB_IOC_SET_FEATURES, &feat) != 0) {
+			WPRINTF(("ioctl viob feature reset failed %d\n",
+			    errno));
+		}
+		sc->vsc_features = 0;
+	}
+
+	sc->vsc_status = value;
+}
+
+static void *
+pci_viob_poll_thread(void *param)
+{
+	struct pci_viob_softc *sc = param;
+	pollfd_t pollset;
+	const int fd = sc->vsc_viobfd;
+
+	pollset.fd = fd;
+	pollset.events = POLLRDBAND;
+
+	for (;;) {
+		if (poll(&pollset, 1, -1) < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			} else {
+				WPRINTF(("pci_viob_poll_thread poll() "
+				    "error %d\n", errno));
+				break;
+			}
+		}
+		if (pollset.revents & POLLRDBAND) {
+			vioc_blk_intr_poll_t vip;
+			uint_t i;
+			int res;
+			boolean_t assert_lintr = B_FALSE;
+			const boolean_t do_msix = pci_msix_enabled(sc->vsc_pi);
+
+			res = ioctl(fd, VIOB_IOC_INTR_POLL, &vip);
+			for (i = 0; res > 0 && i < VIOB_VQ_MAX; i++) {
+				if (vip.vip_status[i] == 0) {
+					continue;
+				}
+				if (do_msix) {
+					pci_generate_msix(sc->vsc_pi,
+					    sc->vsc_msix_table_idx[i]);
+				} else {
+					assert_lintr = B_TRUE;
+				}
+				res = ioctl(fd, VIOB_IOC_RING_INTR_CLR, i);
+				if (res != 0) {
+					WPRINTF(("ioctl viob vq %d intr "
+					    "clear failed %d\n", i, errno));
+				}
+			}
+			if (assert_lintr) {
+				pthread_mutex_lock(&sc->vsc_mtx);
+				sc->vsc_isr |= VTCFG_ISR_QUEUES;
+				pci_lintr_assert(sc->vsc_pi);
+				pthread_mutex_unlock(&sc->vsc_mtx);
+			}
+		}
+	}
+
+	pthread_exit(NULL);
+}
+
+static void
+pci_viob_ring_init(struct pci_viob_softc *sc, uint64_t pfn)
+{
+	int			qnum = sc->vsc_curq;
+	vioc_blk_ring_init_t	vri;
+	int			error;
+
+	assert(qnum < VIOB_MAXQ);
+
+	sc->vsc_pfn[qnum] = (pfn << VRING_PFN);
+
+	vri.ri_index = qnum;
+	vri.ri_qsize = sc->vsc_vq_size;
+	vri.ri_qaddr = (pfn << VRING_PFN);
+	error = ioctl(sc->vsc_viobfd, VIOB_IOC_RING_INIT, &vri);
+
+	if (error != 0) {
+		WPRINTF(("ioctl viob ring %u init failed %d\n", qnum, errno));
+	}
+}
+
+/*
+ * Open the backing store and describe it in the configuration space, then
+ * hand it to the kernel.  Once viob holds it, our descriptor is closed.
+ */
+static int
+pci_viob_viob_init(struct vmctx *ctx, struct pci_viob_softc *sc)
+{
+	vioc_blk_create_t	vbc;
+	struct stat		sbuf;
+	MD5_CTX			mdctx;
+	u_char			digest[16];
+	char			ident[VIOB_IDENT_LEN + 1];
+	int			fd, error, sectsz, psectsz;
+
+	fd = open(sc->vsc_path, sc->vsc_rdonly ? O_RDONLY : O_RDWR);
+	if (fd == -1) {
+		WPRINTF(("open of %s failed: %d\n", sc->vsc_path, errno));
+		return (-1);
+	}
+	if (fstat(fd, &sbuf) != 0) {
+		WPRINTF(("stat of %s failed: %d\n", sc->vsc_path, errno));
+		(void) close(fd);
+		return (-1);
+	}
+
+	sectsz = VIOB_BSIZE;
+	psectsz = sbuf.st_blksize;
+	if (S_ISCHR(sbuf.st_mode)) {
+		struct dk_minfo_ext dkmext;
+
+		if (ioctl(fd, DKIOCGMEDIAINFOEXT, &dkmext) == 0) {
+			sectsz = MAX(dkmext.dki_lbsize, VIOB_BSIZE);
+			psectsz = dkmext.dki_pbsize;
+		}
+	}
+
+	/*
+	 * Create an identifier for the backing file. Use parts of the
+	 * md5 sum of the filename, as virtio-blk does.
+	 */
+	MD5Init(&mdctx);
+	MD5Update(&mdctx, sc->vsc_path, strlen(sc->vsc_path));
+	MD5Final(digest, &mdctx);
+	(void) snprintf(ident, sizeof (ident),
+	    "BHYVE-%02X%02X-%02X%02X-%02X%02X",
+	    digest[0], digest[1], digest[2], digest[3], digest[4], digest[5]);
+
+	sc->vsc_cfg.vbc_capacity = sbuf.st_size / VIOB_BSIZE;
+	sc->vsc_cfg.vbc_seg_max = MIN(sc->vsc_vq_size - 2, VIOB_IOV_MAX);
+	sc->vsc_cfg.vbc_blk_size = sectsz;
+	sc->vsc_cfg.vbc_topology.physical_block_exp =
+	    (psectsz > sectsz) ? (ffs(psectsz / sectsz) - 1) : 0;
+
+	sc->vsc_viobfd = open("/dev/viob", O_RDWR | O_EXCL);
+	if (sc->vsc_viobfd == -1) {
+		WPRINTF(("open viob ctl failed: %d\n", errno));
+		(void) close(fd);
+		return (-1);
+	}
+
+	bzero(&vbc, sizeof (vbc));
+	vbc.c_vmfd = vm_get_device_fd(ctx);
+	vbc.c_fd = fd;
+	vbc.c_flags = sc->vsc_rdonly ? VIOB_CREATE_RDONLY : 0;
+	bcopy(ident, vbc.c_ident, VIOB_IDENT_LEN);
+	error = ioctl(sc->vsc_viobfd, VIOB_IOC_CREATE, &vbc);
+	(void) close(fd);
+	if (error != 0) {
+		WPRINTF(("ioctl viob create failed %d\n", errno));
+		(void) close(sc->vsc_viobfd);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+pci_viob_parse_opts(struct pci_viob_softc *sc, char *opts)
+{
+	char *next, *cp, *path = NULL;
+	int err = 0;
+
+	sc->vsc_vq_size = VIOB_RINGSZ;
+
+	for (; opts != NULL && *opts != '\0'; opts = next) {
+		char *val;
+
+		if ((cp = strchr(opts, ',')) != NULL) {
+			*cp = '\0';
+			next = cp + 1;
+		} else {
+			next = NULL;
+		}
+
+		if (path == NULL) {
+			/* The backing store comes first */
+			path = opts;
+			continue;
+		}
+
+		if (strcmp(opts, "ro") == 0) {
+			sc->vsc_rdonly = B_TRUE;
+			continue;
+		}
+
+		if ((cp = strchr(opts, '=')) == NULL) {
+			fprintf(stderr, "viob: unrecognized option '%s'", opts);
+			err = -1;
+			continue;
+		}
+
+		/* <param>=<value> handling */
+		val = cp + 1;
+		*cp = '\0';
+		if (strcmp(opts, "vqsize") == 0) {
+			long num;
+
+			errno = 0;
+			num = strtol(val, NULL, 0);
+			if (errno != 0) {
+				fprintf(stderr,
+				    "viob: invalid vqsize '%s'", val);
+				err = -1;
+			} else if (num <= 2 || num > 1024) {
+				fprintf(stderr,
+				    "viob: vqsize out of range");
+				err = -1;
+			} else if ((1 << (ffs(num) - 1)) != num) {
+				fprintf(stderr,
+				    "viob: vqsize must be power of 2");
+				err = -1;
+			} else {
+				sc->vsc_vq_size = num;
+			}
+		} else {
+			fprintf(stderr,
+			    "viob: unrecognized option '%s'", opts);
+			err = -1;
+		}
+	}
+	if (path == NULL) {
+		fprintf(stderr, "viob: backing store required");
+		err = -1;
+	} else {
+		sc->vsc_path = strdup(path);
+	}
+
+	DPRINTF(("viob=%p path=%s vqsize=%x ro=%d\n", sc,
+	    sc->vsc_path, sc->vsc_vq_size, sc->vsc_rdonly));
+	return (err);
+}
+
+static int
+pci_viob_init(struct vmctx *ctx, struct pci_devinst *pi, char *opts)
+{
+	int error, i;
+	struct pci_viob_softc *sc;
+	uint64_t ioport;
+
+	if (opts == NULL) {
+		printf("virtio-blk-viob: backing store required\n");
+		return (1);
+	}
+
+	sc = calloc(1, sizeof (struct pci_viob_softc));
+
+	pi->pi_arg = sc;
+	sc->vsc_pi = pi;
+
+	pthread_mutex_init(&sc->vsc_mtx, NULL);
+
+	if (pci_viob_parse_opts(sc, opts) != 0 ||
+	    pci_viob_viob_init(ctx, sc) != 0) {
+		free(sc->vsc_path);
+		free(sc);
+		return (1);
+	}
+
+	error = pthread_create(NULL, NULL, pci_viob_poll_thread, sc);
+	assert(error == 0);
+
+	/* initialize config space */
+	pci_set_cfgdata16(pi, PCIR_DEVICE, VIRTIO_DEV_BLOCK);
+	pci_set_cfgdata16(pi, PCIR_VENDOR, VIRTIO_VENDOR);
+	pci_set_cfgdata8(pi, PCIR_CLASS, PCIC_STORAGE);
+	pci_set_cfgdata16(pi, PCIR_SUBDEV_0, VIRTIO_TYPE_BLOCK);
+	pci_set_cfgdata16(pi, PCIR_SUBVEND_0, VIRTIO_VENDOR);
+
+	/* MSI-X support */
+	for (i = 0; i <= VIOB_MAXQ; i++)
+		sc->vsc_msix_table_idx[i] = VIRTIO_MSI_NO_VECTOR;
+
+	/* BAR 1 used to map MSI-X table and PBA */
+	if (pci_emul_add_msixcap(pi, VIOB_MAXQ + 1, 1)) {
+		free(sc);
+		return (1);
+	}
+
+	/* BAR 0 for legacy-style virtio register access. */
+	error = pci_emul_alloc_bar(pi, 0, PCIBAR_IO, VIOB_REGSZ);
+	if (error != 0) {
+		WPRINTF(("could not allocate virtio BAR\n"));
+		free(sc);
+		return (1);
+	}
+
+	/* Install ioport hook for virtqueue notification */
+	ioport = pi->pi_bar[0].addr + VTCFG_R_QNOTIFY;
+	error = ioctl(sc->vsc_viobfd, VIOB_IOC_SET_NOTIFY_IOP, ioport);
+	if (error != 0) {
+		WPRINTF(("could not install ioport hook at %lx\n", ioport));
+		free(sc);
+		return (1);
+	}
+
+	/*
+	 * Need a legacy interrupt for virtio compliance, even though MSI-X
+	 * operation is _strongly_ suggested for adequate performance.
+	 */
+	pci_lintr_request(pi);
+
+	return (0);
+}
+
+static uint64_t
+viob_adjust_offset(struct pci_devinst *pi, uint64_t offset)
+{
+	/*
+	 * Device specific offsets used by guest would change based on
+	 * whether MSI-X capability is enabled or not
+	 */
+	if (!pci_msix_enabled(pi)) {
+		if (offset >= VTCFG_R_MSIX)
+			return (offset + (VTCFG_R_CFG1 - VTCFG_R_MSIX));
+	}
+
+	return (offset);
+}
+
+static void
+pci_viob_ring_set_msix(struct pci_devinst *pi, uint_t ring)
+{
+	struct pci_viob_softc *sc = pi->pi_arg;
+	struct msix_table_entry mte;
+	uint16_t tab_index;
+	vioc_blk_ring_msi_t vrm;
+	int res;
+
+	assert(ring < VIOB_MAXQ);
+
+	vrm.rm_index = ring;
+	vrm.rm_addr = 0;
+	vrm.rm_msg = 0;
+	tab_index = sc->vsc_msix_table_idx[ring];
+
+	if (tab_index != VIRTIO_MSI_NO_VECTOR && sc->vsc_msix_active) {
+		mte = pi->pi_msix.table[tab_index];
+		if ((mte.vector_control & PCIM_MSIX_VCTRL_MASK) == 0) {
+			vrm.rm_addr = mte.addr;
+			vrm.rm_msg = mte.msg_data;
+		}
+	}
+
+	res = ioctl(sc->vsc_viobfd, VIOB_IOC_RING_SET_MSI, &vrm);
+	if (res != 0) {
+		WPRINTF(("ioctl viob set_msi %d failed %d\n", ring, errno));
+	}
+}
+
+static void
+pci_viob_lintrupdate(struct pci_devinst *pi)
+{
+	struct pci_viob_softc *sc = pi->pi_arg;
+	boolean_t msix_on = B_FALSE;
+
+	pthread_mutex_lock(&sc->vsc_mtx);
+	msix_on = pci_msix_enabled(pi) && (pi->pi_msix.function_mask == 0);
+	if ((sc->vsc_msix_active && !msix_on) ||
+	    (msix_on && !sc->vsc_msix_active)) {
+		uint_t i;
+
+		sc->vsc_msix_active = msix_on;
+		/* Update in-kernel ring configs */
+		for (i = 0; i < VIOB_MAXQ; i++) {
+			pci_viob_ring_set_msix(pi, i);
+		}
+	}
+	pthread_mutex_unlock(&sc->vsc_mtx);
+}
+
+static void
+pci_viob_msix_update(struct pci_devinst *pi, uint64_t offset)
+{
+	struct pci_viob_softc *sc = pi->pi_arg;
+	uint_t tab_index, i;
+
+	pthread_mutex_lock(&sc->vsc_mtx);
+	if (!sc->vsc_msix_active) {
+		pthread_mutex_unlock(&sc->vsc_mtx);
+		return;
+	}
+
+	/* As in viona, use the offset to find the updated table entry. */
+	tab_index = offset / MSIX_TABLE_ENTRY_SIZE;
+
+	for (i = 0; i < VIOB_MAXQ; i++) {
+		if (sc->vsc_msix_table_idx[i] != tab_index) {
+			continue;
+		}
+		pci_viob_ring_set_msix(pi, i);
+	}
+
+	pthread_mutex_unlock(&sc->vsc_mtx);
+}
+
+static void
+pci_viob_write(struct vmctx *ctx, int vcpu, struct pci_devinst *pi,
+    int baridx, uint64_t offset, int size, uint64_t value)
+{
+	struct pci_viob_softc *sc = pi->pi_arg;
+	int err = 0;
+
+	if (baridx == pci_msix_table_bar(pi) ||
+	    baridx == pci_msix_pba_bar(pi)) {
+		if (pci_emul_msix_twrite(pi, offset, size, value) == 0) {
+			pci_viob_msix_update(pi, offset);
+		}
+		return;
+	}
+
+	assert(baridx == 0);
+
+	if (offset + size > pci_viob_iosize(pi)) {
+		DPRINTF(("viob_write: 2big, offset %ld size %d\n",
+		    offset, size));
+		return;
+	}
+
+	pthread_mutex_lock(&sc->vsc_mtx);
+
+	offset = viob_adjust_offset(pi, offset);
+
+	switch (offset) {
+	case VTCFG_R_GUESTCAP:
+		assert(size == 4);
+		err = ioctl(sc->vsc_viobfd, VIOB_IOC_SET_FEATURES, &value);
+		if (err != 0) {
+			WPRINTF(("ioctl feature negotiation returned"
+			    " err = %d\n", errno));
+		} else {
+			sc->vsc_features = value;
+		}
+		break;
+	case VTCFG_R_PFN:
+		assert(size == 4);
+		pci_viob_ring_init(sc, value);
+		break;
+	case VTCFG_R_QSEL:
+		assert(size == 2);
+		sc->vsc_curq = value;
+		break;
+	case VTCFG_R_QNOTIFY:
+		/*
+		 * Notifications are normally handled by the ioport hook in
+		 * the kernel, but fall back to an ioctl if they get here.
+		 */
+		assert(size == 2);
+		if (value < VIOB_MAXQ &&
+		    ioctl(sc->vsc_viobfd, VIOB_IOC_RING_KICK, value) != 0) {
+			WPRINTF(("ioctl viob ring %d kick failed %d\n",
+			    (int)value, errno));
+		}
+		break;
+	case VTCFG_R_STATUS:
+		assert(size == 1);
+		pci_viob_update_status(sc, value);
+		break;
+	case VTCFG_R_CFGVEC:
+		assert(size == 2);
+		sc->vsc_msix_table_idx[VIOB_CFGVEC] = value;
+		break;
+	case VTCFG_R_QVEC:
+		assert(size == 2);
+		if (sc->vsc_curq < VIOB_MAXQ) {
+			sc->vsc_msix_table_idx[sc->vsc_curq] = value;
+			pci_viob_ring_set_msix(pi, sc->vsc_curq);
+		}
+		break;
+	case VTCFG_R_HOSTCAP:
+	case VTCFG_R_QNUM:
+	case VTCFG_R_ISR:
+		DPRINTF(("viob: write to readonly reg %ld\n\r", offset));
+		break;
+	default:
+		/* The device configuration is read-only too */
+		DPRINTF(("viob: unknown i/o write offset %ld\n\r", offset));
+		break;
+	}
+
+	pthread_mutex_unlock(&sc->vsc_mtx);
+}
+
+static uint64_t
+pci_viob_read(struct vmctx *ctx, int vcpu, struct pci_devinst *pi,
+    int baridx, uint64_t offset, int size)
+{
+	struct pci_viob_softc *sc = pi->pi_arg;
+	uint64_t value = 0;
+	int err = 0;
+
+	if (baridx == pci_msix_table_bar(pi) ||
+	    baridx == pci_msix_pba_bar(pi)) {
+		return (pci_emul_msix_tread(pi, offset, size));
+	}
+
+	assert(baridx == 0);
+
+	if (offset + size > pci_viob_iosize(pi)) {
+		DPRINTF(("viob_read: 2big, offset %ld size %d\n",
+		    offset, size));
+		return (0);
+	}
+
+	pthread_mutex_lock(&sc->vsc_mtx);
+
+	offset = viob_adjust_offset(pi, offset);
+
+	switch (offset) {
+	case VTCFG_R_HOSTCAP:
+		assert(size == 4);
+		err = ioctl(sc->vsc_viobfd, VIOB_IOC_GET_FEATURES, &value);
+		if (err != 0) {
+			WPRINTF(("ioctl get host features returned"
+			    " err = %d\n", errno));
+		}
+		break;
+	case VTCFG_R_GUESTCAP:
+		assert(size == 4);
+		value = sc->vsc_features;
+		break;
+	case VTCFG_R_PFN:
+		assert(size == 4);
+		if (sc->vsc_curq < VIOB_MAXQ)
+			value = sc->vsc_pfn[sc->vsc_curq] >> VRING_PFN;
+		break;
+	case VTCFG_R_QNUM:
+		assert(size == 2);
+		if (sc->vsc_curq < VIOB_MAXQ)
+			value = sc->vsc_vq_size;
+		break;
+	case VTCFG_R_QSEL:
+		assert(size == 2);
+		value = sc->vsc_curq;
+		break;
+	case VTCFG_R_QNOTIFY:
+		assert(size == 2);
+		value = sc->vsc_curq;
+		break;
+	case VTCFG_R_STATUS:
+		assert(size == 1);
+		value = sc->vsc_status;
+		break;
+	case VTCFG_R_ISR:
+		assert(size == 1);
+		value = sc->vsc_isr;
+		sc->vsc_isr = 0;	/* a read clears this flag */
+		if (value != 0) {
+			pci_lintr_deassert(pi);
+		}
+		break;
+	case VTCFG_R_CFGVEC:
+		assert(size == 2);
+		value = sc->vsc_msix_table_idx[VIOB_CFGVEC];
+		break;
+	case VTCFG_R_QVEC:
+		assert(size == 2);
+		if (sc->vsc_curq < VIOB_MAXQ)
+			value = sc->vsc_msix_table_idx[sc->vsc_curq];
+		else
+			value = VIRTIO_MSI_NO_VECTOR;
+		break;
+	default:
+		if (offset >= VTCFG_R_CFG1 &&
+		    offset + size <= VIOB_REGSZ) {
+			/* our caller has already verified the size */
+			memcpy(&value, (uint8_t *)&sc->vsc_cfg +
+			    (offset - VTCFG_R_CFG1), size);
+		} else {
+			DPRINTF(("viob: unknown i/o read offset %ld\n\r",
+			    offset));
+		}
+		break;
+	}
+
+	pthread_mutex_unlock(&sc->vsc_mtx);
+
+	return (value);
+}
+
+struct pci_devemu pci_de_viob = {
+	.pe_emu =	"virtio-blk-viob",
+	.pe_init =	pci_viob_init,
+	.pe_barwrite =	pci_viob_write,
+	.pe_barread =	pci_viob_read,
+	.pe_lintrupdate = pci_viob_lintrupdate
+};
+PCI_EMUL_SET(pci_de_viob);
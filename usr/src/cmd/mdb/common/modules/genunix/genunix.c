@@ -2212,6 +2212,8 @@ kmastat_cache(uintptr_t addr, const kmem_cache_t *cp, kmastat_vmem_t **kvpp)
 	int avail, alloc, total;
 	size_t meminuse = (cp->cache_slab_create - cp->cache_slab_destroy) *
 	    cp->cache_slabsize;
+	size_t full = 0;
+	uint64_t full_alloc = 0;
 
 	mdb_walk_cb_t cpu_avail = (mdb_walk_cb_t)kmastat_cpu_avail;
 	mdb_walk_cb_t cpu_alloc = (mdb_walk_cb_t)kmastat_cpu_alloc;
@@ -2219,8 +2221,9 @@ kmastat_cache(uintptr_t addr, const kmem_cache_t *cp, kmastat_vmem_t **kvpp)
 
 	magsize = kmem_get_magsize(cp);
 
-	alloc = cp->cache_slab_alloc + cp->cache_full.ml_alloc;
-	avail = cp->cache_full.ml_total * magsize;
+	(void) kmem_depot_full(cp, &full, &full_alloc);
+	alloc = cp->cache_slab_alloc + full_alloc;
+	avail = full * magsize;
 	total = cp->cache_buftotal;
 
 	(void) mdb_pwalk("kmem_cpu_cache", cpu_alloc, &alloc, addr);
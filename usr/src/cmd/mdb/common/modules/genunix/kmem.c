@@ -34,6 +34,7 @@
 #include <mdb/mdb_whatis.h>
 #include <sys/cpuvar.h>
 #include <sys/kmem_impl.h>
+#include <sys/lgrp.h>
 #include <sys/vmem_impl.h>
 #include <sys/machelf.h>
 #include <sys/modctl.h>
@@ -926,6 +927,58 @@ kmem_get_magsize(const kmem_cache_t *cp)
 	return (mt.mt_magsize);
 }
 
+/*
+ * Read cp's per-lgroup depots, which follow its per-CPU caches.
+ */
+static kmem_depot_t *
+kmem_read_depots(const kmem_cache_t *cp, int alloc_flags)
+{
+	size_t dsize;
+	kmem_depot_t *kdp;
+
+	if (cp->cache_ndepots <= 0 || cp->cache_ndepots > NLGRPS_MAX) {
+		mdb_warn("cache '%s' has invalid depot count (%d)\n",
+		    cp->cache_name, cp->cache_ndepots);
+		return (NULL);
+	}
+
+	dsize = KMEM_DEPOT_SIZE(cp->cache_ndepots);
+	if ((kdp = mdb_alloc(dsize, alloc_flags)) == NULL)
+		return (NULL);
+
+	if (mdb_vread(kdp, dsize, (uintptr_t)cp->cache_depot) == -1) {
+		mdb_warn("couldn't read depots at %p", cp->cache_depot);
+		if (!(alloc_flags & UM_GC))
+			mdb_free(kdp, dsize);
+		return (NULL);
+	}
+
+	return (kdp);
+}
+
+/*
+ * Sum the full magazines in cp's depots, and the allocations from them.
+ */
+int
+kmem_depot_full(const kmem_cache_t *cp, size_t *totalp, uint64_t *allocp)
+{
+	kmem_depot_t *kdp;
+	int d;
+
+	*totalp = 0;
+	*allocp = 0;
+
+	if ((kdp = kmem_read_depots(cp, UM_SLEEP | UM_GC)) == NULL)
+		return (-1);
+
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		*totalp += kdp[d].kd_full.ml_total;
+		*allocp += kdp[d].kd_full.ml_alloc;
+	}
+
+	return (0);
+}
+
 /*ARGSUSED*/
 static int
 kmem_estimate_slab(uintptr_t addr, const kmem_slab_t *sp, size_t *est)
@@ -943,15 +996,17 @@ size_t
 kmem_estimate_allocated(uintptr_t addr, const kmem_cache_t *cp)
 {
 	int magsize;
-	size_t cache_est;
+	size_t cache_est, full;
+	uint64_t full_alloc;
 
 	cache_est = cp->cache_buftotal;
 
 	(void) mdb_pwalk("kmem_slab_partial",
 	    (mdb_walk_cb_t)kmem_estimate_slab, &cache_est, addr);
 
-	if ((magsize = kmem_get_magsize(cp)) != 0) {
-		size_t mag_est = cp->cache_full.ml_total * magsize;
+	if ((magsize = kmem_get_magsize(cp)) != 0 &&
+	    kmem_depot_full(cp, &full, &full_alloc) == 0) {
+		size_t mag_est = full * magsize;
 
 		if (cache_est >= mag_est) {
 			cache_est -= mag_est;
@@ -983,10 +1038,11 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
     void ***maglistp, size_t *magcntp, size_t *magmaxp, int alloc_flags)
 {
 	kmem_magazine_t *kmp, *mp;
+	kmem_depot_t *kdp = NULL;
 	void **maglist = NULL;
-	int i, cpu;
+	int i, cpu, d;
 	size_t magsize, magmax, magbsize;
-	size_t magcnt = 0;
+	size_t magcnt = 0, full = 0;
 
 	/*
 	 * Read the magtype out of the cache, after verifying the pointer's
@@ -1006,19 +1062,24 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 	 * and the full magazine list in the depot.
 	 *
 	 * For an upper bound on the number of buffers in the magazine
-	 * layer, we have the number of magazines on the cache_full
-	 * list plus at most two magazines per CPU (the loaded and the
-	 * spare).  Toss in 100 magazines as a fudge factor in case this
-	 * is live (the number "100" comes from the same fudge factor in
-	 * crash(1M)).
+	 * layer, we have the number of magazines on the full lists of
+	 * the depots plus at most two magazines per CPU (the loaded and
+	 * the spare).  Toss in 100 magazines as a fudge factor in case
+	 * this is live (the number "100" comes from the same fudge factor
+	 * in crash(1M)).
 	 */
-	magmax = (cp->cache_full.ml_total + 2 * ncpus + 100) * magsize;
+	if ((kdp = kmem_read_depots(cp, alloc_flags)) == NULL)
+		return (WALK_ERR);
+	for (d = 0; d < cp->cache_ndepots; d++)
+		full += kdp[d].kd_full.ml_total;
+
+	magmax = (full + 2 * ncpus + 100) * magsize;
 	magbsize = offsetof(kmem_magazine_t, mag_round[magsize]);
 
 	if (magbsize >= PAGESIZE / 2) {
 		mdb_warn("magazine size for cache %p unreasonable (%x)\n",
 		    addr, magbsize);
-		return (WALK_ERR);
+		goto fail;
 	}
 
 	maglist = mdb_alloc(magmax * sizeof (void *), alloc_flags);
@@ -1027,17 +1088,21 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 		goto fail;
 
 	/*
-	 * First up: the magazines in the depot (i.e. on the cache_full list).
+	 * First up: the magazines in the depots (i.e. on the full lists).
 	 */
-	for (kmp = cp->cache_full.ml_list; kmp != NULL; ) {
-		READMAG_ROUNDS(magsize);
-		kmp = mp->mag_next;
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		kmem_magazine_t *head = kdp[d].kd_full.ml_list;
 
-		if (kmp == cp->cache_full.ml_list)
-			break; /* cache_full list loop detected */
+		for (kmp = head; kmp != NULL; ) {
+			READMAG_ROUNDS(magsize);
+			kmp = mp->mag_next;
+
+			if (kmp == head)
+				break; /* full list loop detected */
+		}
 	}
 
-	dprintf(("cache_full list done\n"));
+	dprintf(("depot full lists done\n"));
 
 	/*
 	 * Now whip through the CPUs, snagging the loaded magazines
@@ -1077,8 +1142,10 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 
 	dprintf(("magazine layer: %d buffers\n", magcnt));
 
-	if (!(alloc_flags & UM_GC))
+	if (!(alloc_flags & UM_GC)) {
 		mdb_free(mp, magbsize);
+		mdb_free(kdp, KMEM_DEPOT_SIZE(cp->cache_ndepots));
+	}
 
 	*maglistp = maglist;
 	*magcntp = magcnt;
@@ -1092,6 +1159,7 @@ fail:
 			mdb_free(mp, magbsize);
 		if (maglist)
 			mdb_free(maglist, magmax * sizeof (void *));
+		mdb_free(kdp, KMEM_DEPOT_SIZE(cp->cache_ndepots));
 	}
 	return (WALK_ERR);
 }
@@ -113,6 +113,7 @@ extern void kmem_init(void);
 extern void kmem_statechange(void);
 extern int kmem_get_magsize(const kmem_cache_t *);
 extern size_t kmem_estimate_allocated(uintptr_t, const kmem_cache_t *);
+extern int kmem_depot_full(const kmem_cache_t *, size_t *, uint64_t *);
 
 #ifdef	__cplusplus
 }
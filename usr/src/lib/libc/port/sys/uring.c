@@ -0,0 +1,65 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+#include <sys/io_uring.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+int
+io_uring_setup(uint32_t entries, struct io_uring_params *params)
+{
+	int fd;
+
+	if ((fd = open("/dev/uring", O_RDWR | O_CLOEXEC)) < 0)
+		return (-1);
+
+	params->sq_entries = entries;
+	if (ioctl(fd, URINGIOC_SETUP, params) != 0) {
+		(void) close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+int
+io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+    uint32_t flags, const sigset_t *sigmask)
+{
+	uring_enter_t ue;
+
+	(void) memset(&ue, 0, sizeof (ue));
+	ue.ue_to_submit = to_submit;
+	ue.ue_min_complete = min_complete;
+	ue.ue_flags = flags;
+	ue.ue_sigmask = (uintptr_t)sigmask;
+
+	return (ioctl(fd, URINGIOC_ENTER, &ue));
+}
+
+int
+io_uring_register(int fd, uint32_t opcode, void *arg, uint32_t nr_args)
+{
+	uring_register_t urr;
+
+	urr.ur_opcode = opcode;
+	urr.ur_nr_args = nr_args;
+	urr.ur_arg = (uintptr_t)arg;
+
+	return (ioctl(fd, URINGIOC_REGISTER, &urr) != 0 ? -1 : 0);
+}
@@ -0,0 +1,188 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Measure the cost of epoll_wait() on a large, mostly idle epoll set, and
+ * check that level-triggered, edge-triggered and oneshot descriptors keep
+ * their semantics while doing so.  The read ends of many pipes are
+ * registered and a handful of them are made readable; each epoll_wait()
+ * must then report exactly those.  With the /dev/poll ready list, the time
+ * per call should not depend on the number of idle descriptors; to compare
+ * against the bitmap scan, clear devpoll_readyq with mdb -kw and rerun.
+ *
+ * Usage: epoll_readyq [-n pipes] [-r ready] [-i iterations]
+ */
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int
+er_wait(int epfd, struct epoll_event *evs, int maxevents)
+{
+	int n;
+
+	if ((n = epoll_wait(epfd, evs, maxevents, 0)) < 0)
+		err(EXIT_FAILURE, "epoll_wait failed");
+	return (n);
+}
+
+static void
+er_add(int epfd, int fd, uint32_t events)
+{
+	struct epoll_event ev;
+
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		err(EXIT_FAILURE, "failed to add fd %d", fd);
+}
+
+static void
+er_pipe(int *fds)
+{
+	char c = 'x';
+
+	if (pipe(fds) != 0)
+		err(EXIT_FAILURE, "failed to create pipe");
+	if (write(fds[1], &c, 1) != 1)
+		err(EXIT_FAILURE, "failed to write to pipe");
+}
+
+/*
+ * An edge-triggered and a oneshot descriptor must each be reported once,
+ * however many times the set is waited on, and the level-triggered ones
+ * every time.
+ */
+static void
+er_modes(int epfd, struct epoll_event *evs, int maxevents, uint_t nready)
+{
+	int et[2], os[2];
+	boolean_t et_seen = B_FALSE, os_seen = B_FALSE;
+
+	er_pipe(et);
+	er_pipe(os);
+	er_add(epfd, et[0], EPOLLIN | EPOLLET);
+	er_add(epfd, os[0], EPOLLIN | EPOLLONESHOT);
+
+	for (uint_t pass = 0; pass < 3; pass++) {
+		int n = er_wait(epfd, evs, maxevents);
+		uint_t expect = nready + (pass == 0 ? 2 : 0);
+
+		if (n != expect) {
+			errx(EXIT_FAILURE, "pass %u: %d events, expected %u",
+			    pass, n, expect);
+		}
+		for (int i = 0; i < n; i++) {
+			int fd = evs[i].data.fd;
+
+			if ((fd == et[0] && et_seen) ||
+			    (fd == os[0] && os_seen))
+				errx(EXIT_FAILURE, "fd %d reported twice", fd);
+			et_seen |= (fd == et[0]);
+			os_seen |= (fd == os[0]);
+		}
+	}
+	if (!et_seen || !os_seen)
+		errx(EXIT_FAILURE, "EPOLLET or EPOLLONESHOT fd never reported");
+
+	(void) close(et[0]);
+	(void) close(et[1]);
+	(void) close(os[0]);
+	(void) close(os[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+	uint_t npipes = 8192, nready = 8, iters = 10000;
+	struct epoll_event *evs;
+	struct rlimit rl;
+	hrtime_t start, end;
+	int (*fds)[2];
+	int c, epfd, maxevents;
+
+	while ((c = getopt(argc, argv, "n:r:i:")) != -1) {
+		switch (c) {
+		case 'n':
+			npipes = atoi(optarg);
+			break;
+		case 'r':
+			nready = atoi(optarg);
+			break;
+		case 'i':
+			iters = atoi(optarg);
+			break;
+		default:
+			errx(EXIT_FAILURE, "usage: epoll_readyq [-n pipes] "
+			    "[-r ready] [-i iterations]");
+		}
+	}
+	if (npipes == 0 || nready > npipes || iters == 0)
+		errx(EXIT_FAILURE, "need 0 < pipes, ready <= pipes, 0 < iters");
+
+	rl.rlim_cur = rl.rlim_max = 2 * npipes + 64;
+	if (setrlimit(RLIMIT_NOFILE, &rl) != 0)
+		err(EXIT_FAILURE, "failed to raise RLIMIT_NOFILE");
+
+	maxevents = nready + 2;
+	if ((fds = calloc(npipes, sizeof (*fds))) == NULL ||
+	    (evs = calloc(maxevents, sizeof (*evs))) == NULL)
+		err(EXIT_FAILURE, "failed to allocate");
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		err(EXIT_FAILURE, "failed to create epoll fd");
+
+	/* spread the ready pipes out across the fd space */
+	for (uint_t i = 0; i < npipes; i++) {
+		if (nready != 0 && i % (npipes / nready) == 0 &&
+		    i / (npipes / nready) < nready) {
+			er_pipe(fds[i]);
+		} else if (pipe(fds[i]) != 0) {
+			err(EXIT_FAILURE, "failed to create pipe %u", i);
+		}
+		er_add(epfd, fds[i][0], EPOLLIN);
+	}
+
+	er_modes(epfd, evs, maxevents, nready);
+
+	start = gethrtime();
+	for (uint_t i = 0; i < iters; i++) {
+		int n = er_wait(epfd, evs, maxevents);
+
+		if (n != nready) {
+			errx(EXIT_FAILURE, "iteration %u: %d events, "
+			    "expected %u", i, n, nready);
+		}
+	}
+	end = gethrtime();
+
+	(void) printf("TEST PASSED: %u idle, %u ready fds: %.0f ns per "
+	    "epoll_wait\n", npipes - nready, nready,
+	    (double)(end - start) / iters);
+
+	for (uint_t i = 0; i < npipes; i++) {
+		(void) close(fds[i][0]);
+		(void) close(fds[i][1]);
+	}
+	(void) close(epfd);
+	free(fds);
+	free(evs);
+	return (0);
+}
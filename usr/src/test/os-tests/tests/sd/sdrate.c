@@ -0,0 +1,173 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Measure the small random I/O rate of a disk through its raw device. A
+ * number of threads each keep one aligned pread() (or, with -w, pwrite())
+ * outstanding at a random offset, and the rate and mean latency are reported
+ * at the end. With enough threads to fill the device queue, this is limited
+ * by the submission path in sd rather than by the device, so the rate with
+ * sd_fastpath_enable cleared, the default, can be compared with that with it
+ * set:
+ *
+ *	# echo 'sd_fastpath_enable/W 1' | mdb -kw
+ *
+ * Usage: sdrate [-w] [-b blocksize] [-c threads] [-t seconds] device
+ *
+ * Writing destroys the contents of the device. The program fails only if an
+ * I/O fails.
+ */
+
+#include <sys/types.h>
+#include <sys/dkio.h>
+#include <sys/time.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int sr_fd;
+static boolean_t sr_write = B_FALSE;
+static size_t sr_bsize = 4096;
+static uint64_t sr_nblocks;
+static volatile boolean_t sr_done = B_FALSE;
+
+typedef struct sr_thread {
+	pthread_t	st_tid;
+	uint64_t	st_ios;
+	hrtime_t	st_latency;
+} sr_thread_t;
+
+static void *
+sr_worker(void *arg)
+{
+	sr_thread_t *st = arg;
+	void *buf;
+
+	if ((buf = memalign(sr_bsize, sr_bsize)) == NULL)
+		err(EXIT_FAILURE, "failed to allocate buffer");
+	(void) memset(buf, 0xa5, sr_bsize);
+
+	while (!sr_done) {
+		/* rand_r() has only 15 bits, too few to cover a disk */
+		uint64_t blk = (((uint64_t)arc4random() << 32) |
+		    arc4random()) % sr_nblocks;
+		off_t off = (off_t)(blk * sr_bsize);
+		hrtime_t start = gethrtime();
+		ssize_t ret;
+
+		if (sr_write)
+			ret = pwrite(sr_fd, buf, sr_bsize, off);
+		else
+			ret = pread(sr_fd, buf, sr_bsize, off);
+		if (ret != (ssize_t)sr_bsize) {
+			err(EXIT_FAILURE, "I/O of %zu bytes at %lld returned "
+			    "%zd", sr_bsize, (longlong_t)off, ret);
+		}
+		st->st_latency += gethrtime() - start;
+		st->st_ios++;
+	}
+
+	free(buf);
+	return (NULL);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "Usage: sdrate [-w] [-b blocksize] "
+	    "[-c threads] [-t seconds] device\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct dk_minfo minfo;
+	sr_thread_t *threads;
+	uint_t nthreads = 32, seconds = 10;
+	uint64_t ios = 0;
+	hrtime_t latency = 0, start, elapsed;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:c:t:w")) != -1) {
+		switch (c) {
+		case 'b':
+			sr_bsize = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			nthreads = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			sr_write = B_TRUE;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || nthreads == 0 || seconds == 0 ||
+	    sr_bsize == 0 || (sr_bsize & (sr_bsize - 1)) != 0)
+		usage();
+
+	if ((sr_fd = open(argv[optind], sr_write ? O_RDWR : O_RDONLY)) < 0)
+		err(EXIT_FAILURE, "failed to open %s", argv[optind]);
+	if (ioctl(sr_fd, DKIOCGMEDIAINFO, &minfo) != 0)
+		err(EXIT_FAILURE, "DKIOCGMEDIAINFO failed on %s", argv[optind]);
+	if (sr_bsize < minfo.dki_lbsize)
+		errx(EXIT_FAILURE, "block size is below the device's %u",
+		    minfo.dki_lbsize);
+	sr_nblocks = minfo.dki_capacity * minfo.dki_lbsize / sr_bsize;
+	if (sr_nblocks == 0)
+		errx(EXIT_FAILURE, "%s is too small", argv[optind]);
+
+	if ((threads = calloc(nthreads, sizeof (sr_thread_t))) == NULL)
+		err(EXIT_FAILURE, "failed to allocate threads");
+
+	start = gethrtime();
+	for (uint_t i = 0; i < nthreads; i++) {
+		if ((errno = pthread_create(&threads[i].st_tid, NULL,
+		    sr_worker, &threads[i])) != 0)
+			err(EXIT_FAILURE, "failed to create thread");
+	}
+
+	(void) sleep(seconds);
+	sr_done = B_TRUE;
+
+	for (uint_t i = 0; i < nthreads; i++) {
+		(void) pthread_join(threads[i].st_tid, NULL);
+		ios += threads[i].st_ios;
+		latency += threads[i].st_latency;
+	}
+	elapsed = gethrtime() - start;
+
+	if (ios != 0)
+		latency /= ios;
+	(void) printf("%s: %u threads, %zu byte %ss: %llu IOPS, "
+	    "mean latency %llu us\n", argv[optind], nthreads, sr_bsize,
+	    sr_write ? "write" : "read",
+	    (u_longlong_t)(ios * NANOSEC / elapsed),
+	    (u_longlong_t)(latency / (NANOSEC / MICROSEC)));
+
+	free(threads);
+	(void) close(sr_fd);
+	return (0);
+}
@@ -0,0 +1,173 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Measure the TCP connection setup rate over loopback. A number of client
+ * threads repeatedly connect to a single listener and abort the connection
+ * (SO_LINGER with a zero timeout, so that no TIME_WAIT state accumulates),
+ * while an equal number of threads accept and close. This mostly exercises
+ * the classifier (ipcl_conn_insert(), ipcl_classify_v4()) and the listener,
+ * which is what limits hosts with many short-lived connections.
+ *
+ * Usage: connrate [-c clients] [-t seconds]
+ *
+ * The test fails only if a connection cannot be established; the rate is
+ * reported for comparison between builds.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic.h>
+
+static struct sockaddr_in cr_addr;
+static int cr_lfd;
+static volatile boolean_t cr_stop;
+static volatile uint64_t cr_nconns;
+
+static void *
+cr_client(void *arg)
+{
+	struct linger lng = { .l_onoff = 1, .l_linger = 0 };
+	uint64_t n = 0;
+
+	while (!cr_stop) {
+		int fd;
+
+		if ((fd = socket(PF_INET, SOCK_STREAM, 0)) < 0)
+			err(EXIT_FAILURE, "failed to create socket");
+		if (setsockopt(fd, SOL_SOCKET, SO_LINGER, &lng,
+		    sizeof (lng)) != 0)
+			err(EXIT_FAILURE, "failed to set SO_LINGER");
+		if (connect(fd, (struct sockaddr *)&cr_addr,
+		    sizeof (cr_addr)) != 0)
+			err(EXIT_FAILURE, "failed to connect");
+		(void) close(fd);
+		n++;
+	}
+
+	atomic_add_64((uint64_t *)&cr_nconns, n);
+	return (NULL);
+}
+
+static void *
+cr_server(void *arg)
+{
+	for (;;) {
+		int fd = accept(cr_lfd, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			err(EXIT_FAILURE, "failed to accept");
+		}
+		(void) close(fd);
+
+		/* main() makes one last connection per server at the end */
+		if (cr_stop)
+			break;
+	}
+
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	socklen_t slen = sizeof (cr_addr);
+	uint_t nclients = 8, secs = 5;
+	pthread_t *clients, *servers;
+	hrtime_t start, end;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:t:")) != -1) {
+		switch (c) {
+		case 'c':
+			nclients = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			errx(EXIT_FAILURE, "usage: connrate [-c clients] "
+			    "[-t seconds]");
+		}
+	}
+	if (nclients == 0 || secs == 0)
+		errx(EXIT_FAILURE, "clients and seconds must be non-zero");
+
+	(void) memset(&cr_addr, 0, sizeof (cr_addr));
+	cr_addr.sin_family = AF_INET;
+	cr_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((cr_lfd = socket(PF_INET, SOCK_STREAM, 0)) < 0)
+		err(EXIT_FAILURE, "failed to create listener");
+	if (bind(cr_lfd, (struct sockaddr *)&cr_addr, sizeof (cr_addr)) != 0 ||
+	    getsockname(cr_lfd, (struct sockaddr *)&cr_addr, &slen) != 0 ||
+	    listen(cr_lfd, SOMAXCONN) != 0)
+		err(EXIT_FAILURE, "failed to set up listener");
+
+	if ((clients = calloc(nclients, sizeof (pthread_t))) == NULL ||
+	    (servers = calloc(nclients, sizeof (pthread_t))) == NULL)
+		err(EXIT_FAILURE, "failed to allocate thread ids");
+
+	for (uint_t i = 0; i < nclients; i++) {
+		if (pthread_create(&servers[i], NULL, cr_server, NULL) != 0)
+			errx(EXIT_FAILURE, "failed to create server thread");
+	}
+
+	start = gethrtime();
+	for (uint_t i = 0; i < nclients; i++) {
+		if (pthread_create(&clients[i], NULL, cr_client, NULL) != 0)
+			errx(EXIT_FAILURE, "failed to create client thread");
+	}
+
+	(void) sleep(secs);
+	cr_stop = B_TRUE;
+
+	for (uint_t i = 0; i < nclients; i++)
+		(void) pthread_join(clients[i], NULL);
+	end = gethrtime();
+
+	for (uint_t i = 0; i < nclients; i++) {
+		int fd;
+
+		if ((fd = socket(PF_INET, SOCK_STREAM, 0)) < 0 ||
+		    connect(fd, (struct sockaddr *)&cr_addr,
+		    sizeof (cr_addr)) != 0)
+			err(EXIT_FAILURE, "failed to wake server threads");
+		(void) close(fd);
+	}
+	for (uint_t i = 0; i < nclients; i++)
+		(void) pthread_join(servers[i], NULL);
+	(void) close(cr_lfd);
+
+	(void) printf("TEST PASSED: %llu connections in %.2fs by %u clients "
+	    "(%.0f conn/s)\n", (u_longlong_t)cr_nconns,
+	    (double)(end - start) / NANOSEC, nclients,
+	    (double)cr_nconns * NANOSEC / (end - start));
+
+	free(clients);
+	free(servers);
+	return (0);
+}
@@ -0,0 +1,281 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Exercise SO_ZEROCOPY and MSG_ZEROCOPY over a TCP loopback connection.
+ * Loopback TCP never loans pages, so every send must complete with
+ * SO_ZEROCOPY_COPIED; the test checks that each send is reported exactly
+ * once, that POLLERR is raised while completions are pending, and that the
+ * data arrives intact.
+ *
+ * Pages are only loaned to connections that leave the system over a NIC
+ * that supports zero-copy, which a self-contained test cannot set up.  If
+ * ZEROCOPY_PEER is set in the environment to "address:port" of such a peer
+ * running a discard service, the sends are repeated to it as well and at
+ * least one of them must complete without SO_ZEROCOPY_COPIED.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <err.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define	ZC_NSENDS	16
+#define	ZC_SENDSZ	(32 * 1024)
+
+static uint8_t zc_buf[ZC_NSENDS][ZC_SENDSZ];
+
+static void *
+zc_reader(void *arg)
+{
+	int fd = (int)(uintptr_t)arg;
+	size_t off = 0, total = sizeof (zc_buf);
+	uint8_t *rbuf;
+
+	if ((rbuf = malloc(total)) == NULL)
+		err(EXIT_FAILURE, "failed to allocate receive buffer");
+
+	while (off < total) {
+		ssize_t ret = recv(fd, rbuf + off, total - off, 0);
+		if (ret < 0)
+			err(EXIT_FAILURE, "recv failed");
+		if (ret == 0)
+			errx(EXIT_FAILURE, "unexpected EOF after %zu bytes",
+			    off);
+		off += ret;
+	}
+
+	if (memcmp(rbuf, zc_buf, total) != 0)
+		errx(EXIT_FAILURE, "received data does not match sent data");
+
+	free(rbuf);
+	return (NULL);
+}
+
+static void
+zc_connect(int *cfd, int *afd)
+{
+	struct sockaddr_in sin;
+	socklen_t slen = sizeof (sin);
+	int lfd;
+
+	(void) memset(&sin, 0, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((lfd = socket(PF_INET, SOCK_STREAM, 0)) < 0 ||
+	    (*cfd = socket(PF_INET, SOCK_STREAM, 0)) < 0)
+		err(EXIT_FAILURE, "failed to create sockets");
+	if (bind(lfd, (struct sockaddr *)&sin, sizeof (sin)) != 0 ||
+	    getsockname(lfd, (struct sockaddr *)&sin, &slen) != 0 ||
+	    listen(lfd, 1) != 0)
+		err(EXIT_FAILURE, "failed to set up listener");
+	if (connect(*cfd, (struct sockaddr *)&sin, sizeof (sin)) != 0)
+		err(EXIT_FAILURE, "failed to connect");
+	if ((*afd = accept(lfd, NULL, NULL)) < 0)
+		err(EXIT_FAILURE, "failed to accept");
+	(void) close(lfd);
+}
+
+static void
+zc_connect_peer(const char *peer, int *cfd)
+{
+	struct addrinfo hints, *ai;
+	char *host, *port;
+	int ret;
+
+	if ((host = strdup(peer)) == NULL)
+		err(EXIT_FAILURE, "failed to copy ZEROCOPY_PEER");
+	if ((port = strrchr(host, ':')) == NULL)
+		errx(EXIT_FAILURE, "ZEROCOPY_PEER must be address:port");
+	*port++ = '\0';
+
+	(void) memset(&hints, 0, sizeof (hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+	if ((ret = getaddrinfo(host, port, &hints, &ai)) != 0)
+		errx(EXIT_FAILURE, "bad ZEROCOPY_PEER %s: %s", peer,
+		    gai_strerror(ret));
+
+	if ((*cfd = socket(ai->ai_family, SOCK_STREAM, 0)) < 0)
+		err(EXIT_FAILURE, "failed to create socket");
+	if (connect(*cfd, ai->ai_addr, ai->ai_addrlen) != 0)
+		err(EXIT_FAILURE, "failed to connect to %s", peer);
+
+	freeaddrinfo(ai);
+	free(host);
+}
+
+static uint_t
+zc_drain(int fd, boolean_t *seen, uint_t *loaned)
+{
+	struct so_zerocopy_done szd;
+	socklen_t len;
+	uint_t count = 0;
+
+	for (;;) {
+		len = sizeof (szd);
+		if (getsockopt(fd, SOL_SOCKET, SO_ZEROCOPY_DONE, &szd,
+		    &len) != 0) {
+			if (errno == EAGAIN)
+				return (count);
+			err(EXIT_FAILURE, "failed to get completion");
+		}
+		if (len != sizeof (szd) || szd.szd_first > szd.szd_last ||
+		    szd.szd_last >= ZC_NSENDS) {
+			errx(EXIT_FAILURE, "bad completion [%u, %u]",
+			    szd.szd_first, szd.szd_last);
+		}
+		if ((szd.szd_flags & SO_ZEROCOPY_COPIED) == 0) {
+			if (loaned == NULL) {
+				errx(EXIT_FAILURE, "loopback completion "
+				    "[%u, %u] not flagged as copied",
+				    szd.szd_first, szd.szd_last);
+			}
+			*loaned += szd.szd_last - szd.szd_first + 1;
+		}
+		for (uint32_t i = szd.szd_first; i <= szd.szd_last; i++) {
+			if (seen[i])
+				errx(EXIT_FAILURE, "send %u done twice", i);
+			seen[i] = B_TRUE;
+			count++;
+		}
+	}
+}
+
+static uint_t
+zc_wait(int fd, boolean_t *seen, uint_t *loaned)
+{
+	uint_t done = 0;
+
+	while (done < ZC_NSENDS) {
+		struct pollfd pfd = { .fd = fd, .events = 0 };
+
+		if (poll(&pfd, 1, 10 * 1000) <= 0)
+			errx(EXIT_FAILURE, "timed out waiting for completions");
+		if ((pfd.revents & POLLERR) == 0)
+			errx(EXIT_FAILURE, "poll returned without POLLERR");
+		done += zc_drain(fd, seen, loaned);
+	}
+
+	return (done);
+}
+
+/*
+ * Repeat the sends to a remote peer, where TCP can take the loaned pages.
+ * The buffers are left untouched until their completions arrive.
+ */
+static void
+zc_remote(const char *peer)
+{
+	boolean_t seen[ZC_NSENDS] = { B_FALSE };
+	uint_t loaned = 0;
+	int fd, on = 1;
+
+	zc_connect_peer(peer, &fd);
+	if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof (on)) != 0)
+		err(EXIT_FAILURE, "setsockopt(SO_ZEROCOPY) failed");
+
+	for (size_t i = 0; i < ZC_NSENDS; i++) {
+		if (send(fd, zc_buf[i], ZC_SENDSZ, MSG_ZEROCOPY) !=
+		    ZC_SENDSZ) {
+			err(EXIT_FAILURE, "remote MSG_ZEROCOPY send %zu failed",
+			    i);
+		}
+	}
+
+	(void) zc_wait(fd, seen, &loaned);
+	if (loaned == 0) {
+		errx(EXIT_FAILURE, "no send to %s was loaned; is the route "
+		    "over a zero-copy capable NIC?", peer);
+	}
+
+	(void) close(fd);
+	(void) printf("TEST PASSED: %u of %u sends to %s loaned\n", loaned,
+	    ZC_NSENDS, peer);
+}
+
+int
+main(void)
+{
+	boolean_t seen[ZC_NSENDS] = { B_FALSE };
+	struct so_zerocopy_done szd;
+	socklen_t len;
+	pthread_t tid;
+	const char *peer;
+	uint_t done;
+	int cfd, afd, on = 1, val;
+
+	for (size_t i = 0; i < ZC_NSENDS; i++) {
+		for (size_t j = 0; j < ZC_SENDSZ; j++)
+			zc_buf[i][j] = (uint8_t)(i * 31 + j);
+	}
+
+	zc_connect(&cfd, &afd);
+
+	/* MSG_ZEROCOPY is ignored until SO_ZEROCOPY is enabled */
+	if (send(cfd, zc_buf[0], 1, MSG_ZEROCOPY) != 1)
+		err(EXIT_FAILURE, "plain MSG_ZEROCOPY send failed");
+	if (recv(afd, &val, 1, 0) != 1)
+		err(EXIT_FAILURE, "recv of plain send failed");
+	len = sizeof (szd);
+	if (getsockopt(cfd, SOL_SOCKET, SO_ZEROCOPY_DONE, &szd, &len) == 0 ||
+	    errno != EAGAIN) {
+		errx(EXIT_FAILURE, "completion posted without SO_ZEROCOPY");
+	}
+
+	if (setsockopt(cfd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof (on)) != 0)
+		err(EXIT_FAILURE, "setsockopt(SO_ZEROCOPY) failed");
+	len = sizeof (val);
+	if (getsockopt(cfd, SOL_SOCKET, SO_ZEROCOPY, &val, &len) != 0 ||
+	    val != 1) {
+		errx(EXIT_FAILURE, "SO_ZEROCOPY did not read back as set");
+	}
+
+	if (pthread_create(&tid, NULL, zc_reader, (void *)(uintptr_t)afd) != 0)
+		errx(EXIT_FAILURE, "failed to create reader thread");
+
+	for (size_t i = 0; i < ZC_NSENDS; i++) {
+		if (send(cfd, zc_buf[i], ZC_SENDSZ, MSG_ZEROCOPY) !=
+		    ZC_SENDSZ) {
+			err(EXIT_FAILURE, "MSG_ZEROCOPY send %zu failed", i);
+		}
+	}
+
+	done = zc_wait(cfd, seen, NULL);
+
+	if (pthread_join(tid, NULL) != 0)
+		errx(EXIT_FAILURE, "failed to join reader thread");
+
+	(void) close(cfd);
+	(void) close(afd);
+	(void) printf("TEST PASSED: %u MSG_ZEROCOPY completions\n", done);
+
+	if ((peer = getenv("ZEROCOPY_PEER")) != NULL)
+		zc_remote(peer);
+
+	return (0);
+}
@@ -0,0 +1,243 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Basic tests of the io_uring facility: set up a ring and map it, then
+ * submit NOP, WRITE and READ requests on a file, a READ_FIXED to a registered
+ * buffer, a RECV on a socket that must wait for data, a POLL_ADD that is
+ * cancelled, and one on another ring, which is refused, checking each
+ * completion.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/sysmacros.h>
+#include <sys/io_uring.h>
+#include <atomic.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define	UT_ENTRIES	8
+
+typedef struct ut_ring {
+	int		ut_fd;
+	uint32_t	*ut_sq_tail;
+	uint32_t	*ut_sq_mask;
+	uint32_t	*ut_sq_array;
+	struct io_uring_sqe *ut_sqes;
+	uint32_t	*ut_cq_head;
+	uint32_t	*ut_cq_tail;
+	uint32_t	*ut_cq_mask;
+	struct io_uring_cqe *ut_cqes;
+} ut_ring_t;
+
+static void
+ut_setup(ut_ring_t *ut)
+{
+	struct io_uring_params p;
+	size_t sqlen, cqlen;
+	uint8_t *ring;
+
+	(void) memset(&p, 0, sizeof (p));
+	if ((ut->ut_fd = io_uring_setup(UT_ENTRIES, &p)) < 0)
+		err(EXIT_FAILURE, "io_uring_setup failed");
+	if (p.sq_entries != UT_ENTRIES || p.cq_entries != 2 * UT_ENTRIES)
+		errx(EXIT_FAILURE, "unexpected ring sizes %u/%u",
+		    p.sq_entries, p.cq_entries);
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) == 0)
+		errx(EXIT_FAILURE, "IORING_FEAT_SINGLE_MMAP not set");
+
+	sqlen = p.sq_off.array + p.sq_entries * sizeof (uint32_t);
+	cqlen = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+	if ((ring = mmap(NULL, MAX(sqlen, cqlen), PROT_READ | PROT_WRITE,
+	    MAP_SHARED, ut->ut_fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+		err(EXIT_FAILURE, "failed to map rings");
+	if ((ut->ut_sqes = mmap(NULL,
+	    p.sq_entries * sizeof (struct io_uring_sqe), PROT_READ | PROT_WRITE,
+	    MAP_SHARED, ut->ut_fd, IORING_OFF_SQES)) == MAP_FAILED)
+		err(EXIT_FAILURE, "failed to map SQEs");
+
+	ut->ut_sq_tail = (uint32_t *)(ring + p.sq_off.tail);
+	ut->ut_sq_mask = (uint32_t *)(ring + p.sq_off.ring_mask);
+	ut->ut_sq_array = (uint32_t *)(ring + p.sq_off.array);
+	ut->ut_cq_head = (uint32_t *)(ring + p.cq_off.head);
+	ut->ut_cq_tail = (uint32_t *)(ring + p.cq_off.tail);
+	ut->ut_cq_mask = (uint32_t *)(ring + p.cq_off.ring_mask);
+	ut->ut_cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+}
+
+/*
+ * Queue an SQE and submit it, without waiting.
+ */
+static void
+ut_submit(ut_ring_t *ut, uint8_t op, int fd, void *addr, uint32_t len,
+    uint64_t off, uint32_t op_flags, uint64_t user_data)
+{
+	uint32_t tail = *ut->ut_sq_tail;
+	uint32_t idx = tail & *ut->ut_sq_mask;
+	struct io_uring_sqe *sqe = &ut->ut_sqes[idx];
+	int ret;
+
+	(void) memset(sqe, 0, sizeof (*sqe));
+	sqe->opcode = op;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)addr;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->op_flags = op_flags;
+	sqe->user_data = user_data;
+	ut->ut_sq_array[idx] = idx;
+	membar_producer();
+	*ut->ut_sq_tail = tail + 1;
+
+	if ((ret = io_uring_enter(ut->ut_fd, 1, 0, 0, NULL)) != 1)
+		err(EXIT_FAILURE, "io_uring_enter submitted %d, not 1", ret);
+}
+
+/*
+ * Wait for and consume the next completion, which must be that expected.
+ */
+static void
+ut_reap(ut_ring_t *ut, uint64_t user_data, int32_t res)
+{
+	uint32_t head = *ut->ut_cq_head;
+	struct io_uring_cqe *cqe;
+
+	if (io_uring_enter(ut->ut_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL) < 0)
+		err(EXIT_FAILURE, "io_uring_enter failed to wait");
+	if (*ut->ut_cq_tail == head)
+		errx(EXIT_FAILURE, "no completion after waiting");
+	membar_consumer();
+
+	cqe = &ut->ut_cqes[head & *ut->ut_cq_mask];
+	if (cqe->user_data != user_data || cqe->res != res) {
+		errx(EXIT_FAILURE, "completion %llu/%d, expected %llu/%d",
+		    (u_longlong_t)cqe->user_data, cqe->res,
+		    (u_longlong_t)user_data, res);
+	}
+	*ut->ut_cq_head = head + 1;
+}
+
+static void
+ut_pending(ut_ring_t *ut, const char *what)
+{
+	if (*ut->ut_cq_tail != *ut->ut_cq_head)
+		errx(EXIT_FAILURE, "%s completed early", what);
+}
+
+int
+main(void)
+{
+	char path[] = "/tmp/uring_test.XXXXXX";
+	char wbuf[64], rbuf[64];
+	struct iovec iov;
+	ut_ring_t ut, ut2;
+	void *fixed;
+	int fd, sv[2], pfd[2];
+
+	ut_setup(&ut);
+
+	ut_submit(&ut, IORING_OP_NOP, -1, NULL, 0, 0, 0, 1);
+	ut_reap(&ut, 1, 0);
+
+	ut_submit(&ut, IORING_OP_LAST, -1, NULL, 0, 0, 0, 2);
+	ut_reap(&ut, 2, -EINVAL);
+
+	/* file I/O at explicit offsets, and at the current offset */
+	if ((fd = mkstemp(path)) < 0)
+		err(EXIT_FAILURE, "failed to create temporary file");
+	(void) unlink(path);
+	for (size_t i = 0; i < sizeof (wbuf); i++)
+		wbuf[i] = (char)i;
+
+	ut_submit(&ut, IORING_OP_WRITE, fd, wbuf, sizeof (wbuf), 0, 0, 3);
+	ut_reap(&ut, 3, sizeof (wbuf));
+	ut_submit(&ut, IORING_OP_READ, fd, rbuf, sizeof (rbuf), 0, 0, 4);
+	ut_reap(&ut, 4, sizeof (rbuf));
+	if (memcmp(wbuf, rbuf, sizeof (wbuf)) != 0)
+		errx(EXIT_FAILURE, "READ returned the wrong data");
+	ut_submit(&ut, IORING_OP_WRITE, fd, wbuf, 16, UINT64_MAX, 0, 5);
+	ut_reap(&ut, 5, 16);
+	if (lseek(fd, 0, SEEK_CUR) != 16)
+		errx(EXIT_FAILURE, "WRITE did not advance the file offset");
+
+	/* registered buffers, for which I/O is asynchronous */
+	if ((fixed = mmap(NULL, 8192, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0)) == MAP_FAILED)
+		err(EXIT_FAILURE, "failed to map buffer");
+	iov.iov_base = fixed;
+	iov.iov_len = 8192;
+	if (io_uring_register(ut.ut_fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0)
+		err(EXIT_FAILURE, "failed to register buffer");
+	ut_submit(&ut, IORING_OP_READ_FIXED, fd, (char *)fixed + 100,
+	    sizeof (wbuf), 0, 0, 6);
+	ut_reap(&ut, 6, sizeof (wbuf));
+	if (memcmp(wbuf, (char *)fixed + 100, sizeof (wbuf)) != 0)
+		errx(EXIT_FAILURE, "READ_FIXED returned the wrong data");
+	ut_submit(&ut, IORING_OP_READ_FIXED, fd, (char *)fixed + 8190,
+	    sizeof (wbuf), 0, 0, 7);
+	ut_reap(&ut, 7, -EFAULT);
+	if (io_uring_register(ut.ut_fd, IORING_UNREGISTER_BUFFERS, NULL,
+	    0) != 0)
+		err(EXIT_FAILURE, "failed to unregister buffer");
+	(void) close(fd);
+
+	/* a receive that must wait for its data */
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		err(EXIT_FAILURE, "failed to create socket pair");
+	ut_submit(&ut, IORING_OP_RECV, sv[0], rbuf, sizeof (rbuf), 0, 0, 8);
+	ut_pending(&ut, "RECV with no data");
+	if (write(sv[1], wbuf, 10) != 10)
+		err(EXIT_FAILURE, "failed to write to socket");
+	ut_reap(&ut, 8, 10);
+	if (memcmp(wbuf, rbuf, 10) != 0)
+		errx(EXIT_FAILURE, "RECV returned the wrong data");
+	(void) close(sv[0]);
+	(void) close(sv[1]);
+
+	/* a poll that never fires, and its cancellation */
+	if (pipe(pfd) != 0)
+		err(EXIT_FAILURE, "failed to create pipe");
+	ut_submit(&ut, IORING_OP_POLL_ADD, pfd[0], NULL, 0, 0, POLLIN, 9);
+	ut_pending(&ut, "POLL_ADD on empty pipe");
+	ut_submit(&ut, IORING_OP_POLL_REMOVE, -1, (void *)(uintptr_t)9, 0, 0,
+	    0, 10);
+	ut_reap(&ut, 9, -ECANCELED);
+	ut_reap(&ut, 10, 0);
+	ut_submit(&ut, IORING_OP_POLL_ADD, pfd[0], NULL, 0, 0, POLLIN, 11);
+	if (write(pfd[1], "x", 1) != 1)
+		err(EXIT_FAILURE, "failed to write to pipe");
+	ut_reap(&ut, 11, POLLIN);
+	(void) close(pfd[0]);
+	(void) close(pfd[1]);
+
+	/* a ring cannot be operated upon by another ring */
+	ut_setup(&ut2);
+	ut_submit(&ut, IORING_OP_POLL_ADD, ut2.ut_fd, NULL, 0, 0, POLLIN, 12);
+	ut_reap(&ut, 12, -EBADF);
+	(void) close(ut2.ut_fd);
+
+	(void) close(ut.ut_fd);
+	(void) printf("TEST PASSED: io_uring operations completed as "
+	    "expected\n");
+	return (0);
+}
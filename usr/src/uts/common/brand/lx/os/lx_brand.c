@@ -349,6 +349,7 @@ lx_proc_exit(proc_t *p)
 	lx_clone_grp_exit(p, B_FALSE);
 	/* Cleanup any outstanding aio contexts */
 	lx_io_cleanup(p);
+	lx_futex_cleanup(p);
 
 	mutex_enter(&p->p_lock);
 	VERIFY((lxpd = ptolxproc(p)) != NULL);
@@ -576,6 +577,7 @@ static void
 lx_clearbrand(proc_t *p, boolean_t lwps_ok)
 {
 	lx_clone_grp_exit(p, lwps_ok);
+	lx_futex_cleanup(p);
 }
 
 /*
@@ -2004,8 +2006,9 @@ lx_copy_procdata(proc_t *cp, proc_t *pp)
 	bcopy(ppd, cpd, sizeof (lx_proc_data_t));
 	mutex_exit(&pp->p_lock);
 
-	/* Clear any aio contexts from child */
+	/* Clear any aio contexts and private futex waiters from child */
 	lx_io_clear(cpd);
+	lx_futex_clear(cpd);
 
 	/*
 	 * The l_ptrace count is normally manipulated only while under holding
@@ -78,7 +78,7 @@ extern "C" {
 /*
  * This must be large enough for both the 32-bit table and 64-bit table.
  */
-#define	LX_NSYSCALLS		358
+#define	LX_NSYSCALLS		449
 
 /* Highest capability we know about */
 #define	LX_CAP_MAX_VALID	36
@@ -339,6 +339,9 @@ typedef struct lx_proc_data {
 
 	lx_rlimit64_t l_fake_limits[LX_RLFAKE_NLIMITS];
 
+	kmutex_t l_futex_lock;	/* serializes resizing of the following */
+	struct futex_table *l_futex_table; /* private futex waiters */
+
 	kmutex_t l_io_ctx_lock; /* protects the following members */
 	uintptr_t l_io_ctxpage;
 	kcondvar_t l_io_destroy_cv;
@@ -95,6 +95,30 @@ extern "C" {
 				((((x) << 8) >> 20)))
 #define	FUTEX_OP_CMPARG(x)	(((x) << 20) >> 20)
 
+/*
+ * The futex_waitv() system call takes an array of these, one for each futex
+ * to be waited upon; the layout is the same for 32- and 64-bit processes.
+ * Only 32-bit futexes are supported.
+ */
+typedef struct lx_futex_waitv {
+	uint64_t	fwv_val;	/* expected value */
+	uint64_t	fwv_uaddr;	/* address of the futex */
+	uint32_t	fwv_flags;	/* FUTEX2_* */
+	uint32_t	fwv_reserved;	/* must be zero */
+} lx_futex_waitv_t;
+
+#define	FUTEX2_SIZE_U32		0x02
+#define	FUTEX2_SIZE_MASK	0x03
+#define	FUTEX2_PRIVATE		FUTEX_PRIVATE_FLAG
+
+#define	FUTEX_WAITV_MAX		128
+
+/*
+ * The clocks against which a futex_waitv() timeout may be given.
+ */
+#define	FUTEX_WAITV_REALTIME	0	/* Linux CLOCK_REALTIME */
+#define	FUTEX_WAITV_MONOTONIC	1	/* Linux CLOCK_MONOTONIC */
+
 #ifdef _KERNEL
 
 /*
@@ -106,19 +130,33 @@ extern "C" {
  * At the moment, all fwaiter_t's for a single futex are simply dumped into
  * the hash bucket.  If futex contention ever becomes a hot path, we can
  * chain a single futex's waiters together.
+ *
+ * A thread in futex_waitv() has one fwaiter_t per futex, all of which point
+ * at a shared fwaitv_t on which the thread actually sleeps.
  */
 typedef struct fwaiter {
 	memid_t		fw_memid;	/* memid of the user-space futex */
 	kcondvar_t	fw_cv;		/* cond var */
 	struct fwaiter	*fw_next;	/* hash queue */
 	struct fwaiter	*fw_prev;	/* hash queue */
+	struct futex_hash *fw_hash;	/* bucket we are (or were) hashed on */
+	struct fwaitv	*fw_waitv;	/* for futex_waitv(); shared state */
 	uint32_t	fw_bits;	/* bits waiting on */
 	pid_t		fw_tid;		/* for PI futexes; the waiter's tid */
 	int		fw_opri;	/* for PI futexes; original pri. */
 	boolean_t	fw_pri_up;	/* for PI futexes; pri. increased */
+	boolean_t	fw_rqpi;	/* awaiting requeue to a PI futex */
+	memid_t		fw_rqpi_memid;	/* the PI futex we expect */
 	volatile int	fw_woken;
 } fwaiter_t;
 
+typedef struct fwaitv {
+	kmutex_t	fv_lock;	/* protects fv_woken */
+	kcondvar_t	fv_cv;		/* cond var */
+	int		fv_woken;	/* index of first futex woken, or -1 */
+	fwaiter_t	*fv_waiters;	/* one per futex */
+} fwaitv_t;
+
 #define	FUTEX_WAITERS			0x80000000
 #define	FUTEX_OWNER_DIED		0x40000000
 #define	FUTEX_TID_MASK			0x3fffffff
@@ -126,10 +164,17 @@ typedef struct fwaiter {
 #define	FUTEX_ROBUST_LOCK_PI		1
 #define	FUTEX_ROBUST_LIST_LIMIT		2048
 
+struct lx_proc_data;
+struct proc;
+
 extern long lx_futex(uintptr_t addr, int cmd, int val, uintptr_t lx_timeout,
     uintptr_t addr2, int val2);
+extern long lx_futex_waitv(uintptr_t waiters, uint_t nr_futexes, uint_t flags,
+    uintptr_t lx_timeout, int clockid);
 extern void lx_futex_init(void);
 extern int lx_futex_fini(void);
+extern void lx_futex_clear(struct lx_proc_data *pd);
+extern void lx_futex_cleanup(struct proc *p);
 extern long lx_set_robust_list(void *listp, size_t len);
 extern long lx_get_robust_list(pid_t pid, void **listp, size_t *lenp);
 extern void lx_futex_robust_exit(uintptr_t addr, uint32_t tid);
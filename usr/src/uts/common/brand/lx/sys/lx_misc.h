@@ -122,6 +122,9 @@ extern void lx_vsyscall_enter(proc_t *, klwp_t *, int);
 extern void lx_check_strict_failure(lx_lwp_data_t *);
 
 extern boolean_t lx_is_eventfd(file_t *);
+extern int lx_poll_ltos_events(short, short *);
+extern short lx_poll_stol_revents(short, short);
+extern int lx_socket_msgflags(int);
 
 extern int lx_read_common(file_t *, uio_t *, size_t *, boolean_t);
 extern int lx_write_common(file_t *, uio_t *, size_t *, boolean_t);
@@ -87,6 +87,7 @@ extern long lx_fstat32();
 extern long lx_fstat64();
 extern long lx_fstatat64();
 extern long lx_futex();
+extern long lx_futex_waitv();
 extern long lx_get_robust_list();
 extern long lx_get_thread_area();
 extern long lx_getcpu();
@@ -127,6 +128,9 @@ extern long lx_io_destroy();
 extern long lx_io_getevents();
 extern long lx_io_setup();
 extern long lx_io_submit();
+extern long lx_io_uring_enter();
+extern long lx_io_uring_register();
+extern long lx_io_uring_setup();
 extern long lx_ioctl();
 extern long lx_ioprio_get();
 extern long lx_ioprio_set();
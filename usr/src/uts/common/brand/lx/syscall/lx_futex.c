@@ -29,6 +29,8 @@
 
 #include <sys/types.h>
 #include <sys/systm.h>
+#include <sys/stddef.h>
+#include <sys/sysmacros.h>
 #include <sys/errno.h>
 #include <sys/debug.h>
 #include <vm/as.h>
@@ -212,13 +214,32 @@
  *	there are waiting threads. This will wake the highest priority waiting
  *	thread.
  *
+ * FUTEX_WAIT_REQUEUE_PI
+ *
+ *	The waiting half of a condition variable whose associated mutex is a
+ *	PI futex.  Like FUTEX_WAIT_BITSET (and with the same absolute timeout),
+ *	wait on futex1, but in the expectation of being requeued onto the PI
+ *	futex futex2 by FUTEX_CMP_REQUEUE_PI; the call returns successfully
+ *	only once the caller holds futex2.
+ *
  * FUTEX_CMP_REQUEUE_PI
  *
- *	Not implemented at this time.
+ *	The waking half: if futex1 still contains val3, try to take futex2 on
+ *	behalf of one waiter, waking it if that succeeds, and requeue up to
+ *	val2 of the others onto futex2 as PI waiters, to be woken in turn by
+ *	FUTEX_UNLOCK_PI.  Returns the number of waiters woken or requeued.
  *
- * FUTEX_WAIT_REQUEUE_PI
+ * There is also a separate system call for waiting on several simple futexes
+ * at once:
  *
- *	Not implemented at this time.
+ * futex_waitv(struct futex_waitv *waiters, unsigned int nr_futexes,
+ *     unsigned int flags, struct timespec *timeout, clockid_t clockid)
+ *
+ *	Atomically verify that each futex contains its expected value, and
+ *	sleep until any one of them is woken, returning its index.  The timeout
+ *	is absolute, against CLOCK_MONOTONIC or CLOCK_REALTIME.  (This replaced
+ *	the FUTEX_WAIT_MULTIPLE operation of earlier proposals, which never
+ *	made it into Linux and which we therefore don't implement.)
  *
  * Priority Inheritance
  *
@@ -289,23 +310,60 @@ typedef struct futex_robust_list32 {
 	((d)->val[0] == (s)->val[0] && (d)->val[1] == (s)->val[1])
 
 /*
- * Because collisions on this hash table can be a source of negative
- * scalability, we make it pretty large: 4,096 entries -- 64K.  If this
- * size is found to be insufficient, the size should be made dynamic.
- * (Making it dynamic will be delicate because the per-chain locking will
- * necessitate memory retiring or similar; see the 2008 ACM Queue article
- * "Real-world concurrency" for details on this technique.)
+ * Waiters are hashed by memid into a table of buckets, each with its own
+ * lock.  A memid that names an address in the caller's own address space --
+ * that of a FUTEX_PRIVATE_FLAG futex, or of a shared futex in private memory
+ * -- can only be waited upon and woken by the threads of one process, so its
+ * waiters go into a table that belongs to that process; all other waiters go
+ * into a single global table.  This keeps busy processes, whether in the same
+ * zone or not, from colliding on each other's buckets, and a private futex
+ * needs no as_getmemid() at all.
+ *
+ * Because collisions on the global table can be a source of negative
+ * scalability, we make it pretty large: 4,096 entries -- 96K.  A process's
+ * table starts out small, and is grown when futex_hashin() finds a chain that
+ * has become long with waiters on distinct futexes (a long chain of waiters
+ * on the same futex is no reason to grow it).  Growing a table relies on
+ * memory retiring (see the 2008 ACM Queue article "Real-world concurrency"
+ * for details on this technique): with every bucket of the old table locked,
+ * all of its waiters are moved to a larger table, the old table is pointed at
+ * its successor, and the process is pointed at the new table.  The old table
+ * is retired rather than freed, so that a thread that looked it up beforehand
+ * can still take the lock of one of its buckets, see that ft_next is set, and
+ * move on to the new table; retired tables are freed when the process exits.
+ *
+ * Since a waiter can thus be moved to another bucket while it sleeps -- as it
+ * can also be by a requeue -- each waiter records the bucket on which it is
+ * hashed in fw_hash, and on waking, takes the lock of that bucket (see
+ * futex_relock()) before it looks at its own state.
+ *
+ * When two bucket locks are needed, whether or not they are in the same
+ * table, they are taken in address order; this is also the order in which
+ * the buckets of a table being grown are locked.  The fv_lock of a thread in
+ * futex_waitv() is taken after any bucket lock.
  */
 #define	HASH_SHIFT_SZ	12
-#define	HASH_SIZE	(1 << HASH_SHIFT_SZ)
-#define	HASH_FUNC(id)						\
-	((((uintptr_t)((id)->val[1]) >> 3) +			\
-	((uintptr_t)((id)->val[1]) >> (3 + HASH_SHIFT_SZ)) +		\
-	((uintptr_t)((id)->val[1]) >> (3 + 2 * HASH_SHIFT_SZ)) +	\
+#define	HASH_FUNC(id, shift)						\
+	((((uintptr_t)((id)->val[1]) >> 3) +				\
+	((uintptr_t)((id)->val[1]) >> (3 + (shift))) +			\
+	((uintptr_t)((id)->val[1]) >> (3 + 2 * (shift))) +		\
 	((uintptr_t)((id)->val[0]) >> 3) +				\
-	((uintptr_t)((id)->val[0]) >> (3 + HASH_SHIFT_SZ)) +		\
-	((uintptr_t)((id)->val[0]) >> (3 + 2 * HASH_SHIFT_SZ))) &	\
-	(HASH_SIZE - 1))
+	((uintptr_t)((id)->val[0]) >> (3 + (shift))) +			\
+	((uintptr_t)((id)->val[0]) >> (3 + 2 * (shift)))) &		\
+	((1 << (shift)) - 1))
+
+/*
+ * Per-process tables: whether they are used at all, their initial and
+ * maximum sizes (as the log2 of the number of buckets), and the length past
+ * which a chain with waiters on distinct futexes causes a table to be grown.
+ * These may only be set in /etc/system.
+ */
+int lx_futex_private_tables = 1;
+uint_t lx_futex_table_shift = 6;
+uint_t lx_futex_table_maxshift = 14;
+uint_t lx_futex_chain_max = 8;
+
+#define	FUTEX_TABLE_GROWSHIFT	2
 
 /*
  * A small, invalid value we can compare against to find the highest scheduling
@@ -328,58 +386,386 @@ typedef struct futex_robust_list32 {
 typedef struct futex_hash {
 	kmutex_t fh_lock;
 	fwaiter_t *fh_waiters;
+	uint_t fh_nwaiters;
 } futex_hash_t;
 
-static futex_hash_t futex_hash[HASH_SIZE];
+typedef struct futex_table {
+	uint_t			ft_shift;	/* log2 of number of buckets */
+	volatile uint_t		ft_grow;	/* a chain is too long */
+	struct futex_table	*ft_next;	/* larger successor, if grown */
+	struct futex_table	*ft_retired;	/* smaller predecessor */
+	futex_hash_t		ft_hash[1];	/* really 1 << ft_shift */
+} futex_table_t;
+
+#define	FT_NBUCKETS(shift)	(1U << (shift))
+#define	FT_SIZE(shift)		(offsetof(futex_table_t, ft_hash) + \
+	FT_NBUCKETS(shift) * sizeof (futex_hash_t))
+
+static futex_table_t *futex_global;
+
+static futex_table_t *
+futex_table_alloc(uint_t shift)
+{
+	futex_table_t *ft;
+	uint_t i;
+
+	ft = kmem_zalloc(FT_SIZE(shift), KM_SLEEP);
+	ft->ft_shift = shift;
+	for (i = 0; i < FT_NBUCKETS(shift); i++)
+		mutex_init(&ft->ft_hash[i].fh_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	return (ft);
+}
 
 static void
-futex_hashin(fwaiter_t *fwp)
+futex_table_free(futex_table_t *ft)
 {
-	int index;
+	uint_t i;
 
-	index = HASH_FUNC(&fwp->fw_memid);
-	ASSERT(MUTEX_HELD(&futex_hash[index].fh_lock));
+	for (i = 0; i < FT_NBUCKETS(ft->ft_shift); i++) {
+		ASSERT(ft->ft_hash[i].fh_waiters == NULL);
+		mutex_destroy(&ft->ft_hash[i].fh_lock);
+	}
+	kmem_free(ft, FT_SIZE(ft->ft_shift));
+}
 
+static void
+futex_hash_push(futex_hash_t *fhp, fwaiter_t *fwp)
+{
+	fwp->fw_hash = fhp;
 	fwp->fw_prev = NULL;
-	fwp->fw_next = futex_hash[index].fh_waiters;
+	fwp->fw_next = fhp->fh_waiters;
 	if (fwp->fw_next)
 		fwp->fw_next->fw_prev = fwp;
-	futex_hash[index].fh_waiters = fwp;
+	fhp->fh_waiters = fwp;
+	fhp->fh_nwaiters++;
+}
+
+static void
+futex_hashin(futex_table_t *ft, futex_hash_t *fhp, fwaiter_t *fwp)
+{
+	fwaiter_t *f;
+	uint_t others = 0;
+
+	ASSERT(MUTEX_HELD(&fhp->fh_lock));
+	ASSERT(ft->ft_next == NULL);
+
+	futex_hash_push(fhp, fwp);
+
+	if (ft == futex_global || fhp->fh_nwaiters <= lx_futex_chain_max ||
+	    ft->ft_grow != 0 || ft->ft_shift >= lx_futex_table_maxshift)
+		return;
+
+	for (f = fhp->fh_waiters; f != NULL; f = f->fw_next) {
+		if (!MEMID_EQUAL(&f->fw_memid, &fwp->fw_memid))
+			others++;
+	}
+	if (others > lx_futex_chain_max / 2)
+		ft->ft_grow = 1;
 }
 
 static void
 futex_hashout(fwaiter_t *fwp)
 {
-	int index;
+	futex_hash_t *fhp = fwp->fw_hash;
 
-	index = HASH_FUNC(&fwp->fw_memid);
-	ASSERT(MUTEX_HELD(&futex_hash[index].fh_lock));
+	ASSERT(MUTEX_HELD(&fhp->fh_lock));
 
 	if (fwp->fw_prev)
 		fwp->fw_prev->fw_next = fwp->fw_next;
 	if (fwp->fw_next)
 		fwp->fw_next->fw_prev = fwp->fw_prev;
-	if (futex_hash[index].fh_waiters == fwp)
-		futex_hash[index].fh_waiters = fwp->fw_next;
+	if (fhp->fh_waiters == fwp)
+		fhp->fh_waiters = fwp->fw_next;
+	fhp->fh_nwaiters--;
 
 	fwp->fw_prev = NULL;
 	fwp->fw_next = NULL;
 }
 
+/*
+ * Replace a process's table with a larger one, moving all of its waiters
+ * over; see the block comment above.  If another thread is already doing
+ * this, we leave it to them.
+ */
+static void
+futex_table_grow(lx_proc_data_t *lxpd)
+{
+	futex_table_t *oft, *nft;
+	fwaiter_t *fwp, *prev;
+	uint_t i, shift;
+
+	if (!mutex_tryenter(&lxpd->l_futex_lock))
+		return;
+
+	oft = lxpd->l_futex_table;
+	if (oft->ft_grow == 0 || oft->ft_shift >= lx_futex_table_maxshift) {
+		mutex_exit(&lxpd->l_futex_lock);
+		return;
+	}
+
+	shift = MIN(oft->ft_shift + FUTEX_TABLE_GROWSHIFT,
+	    lx_futex_table_maxshift);
+	nft = futex_table_alloc(shift);
+
+	for (i = 0; i < FT_NBUCKETS(oft->ft_shift); i++)
+		mutex_enter(&oft->ft_hash[i].fh_lock);
+
+	/*
+	 * Move each chain over from its tail, so that the waiters on any one
+	 * futex keep their order; futex_unlock_pi() depends on it.
+	 */
+	for (i = 0; i < FT_NBUCKETS(oft->ft_shift); i++) {
+		for (fwp = oft->ft_hash[i].fh_waiters;
+		    fwp != NULL && fwp->fw_next != NULL; fwp = fwp->fw_next)
+			continue;
+
+		for (; fwp != NULL; fwp = prev) {
+			prev = fwp->fw_prev;
+			futex_hashout(fwp);
+			futex_hash_push(
+			    &nft->ft_hash[HASH_FUNC(&fwp->fw_memid, shift)],
+			    fwp);
+		}
+	}
+
+	DTRACE_PROBE2(futex__table__grow, lx_proc_data_t *, lxpd,
+	    uint_t, shift);
+
+	nft->ft_retired = oft;
+	membar_producer();
+	oft->ft_next = nft;
+	lxpd->l_futex_table = nft;
+
+	for (i = 0; i < FT_NBUCKETS(oft->ft_shift); i++)
+		mutex_exit(&oft->ft_hash[i].fh_lock);
+	mutex_exit(&lxpd->l_futex_lock);
+}
+
+/*
+ * Return the table in which waiters on the futex at memid are hashed; see
+ * the block comment above.  A process's table is allocated on first use.
+ */
+static futex_table_t *
+futex_table(memid_t *memid)
+{
+	proc_t *p = curproc;
+	lx_proc_data_t *lxpd;
+	futex_table_t *ft, *nft;
+
+	if (!lx_futex_private_tables || memid->val[0] != (uintptr_t)p->p_as)
+		return (futex_global);
+
+	/*
+	 * A vfork()ed child shares its parent's address space, and so must
+	 * share its parent's futexes too.
+	 */
+	if ((p->p_flag & SVFORK) != 0)
+		p = p->p_parent;
+	VERIFY((lxpd = ptolxproc(p)) != NULL);
+
+	if ((ft = lxpd->l_futex_table) == NULL) {
+		nft = futex_table_alloc(lx_futex_table_shift);
+		if ((ft = atomic_cas_ptr(&lxpd->l_futex_table, NULL,
+		    nft)) == NULL) {
+			ft = nft;
+		} else {
+			futex_table_free(nft);
+		}
+	}
+
+	if (ft->ft_grow != 0) {
+		futex_table_grow(lxpd);
+		ft = lxpd->l_futex_table;
+	}
+
+	return (ft);
+}
+
+/*
+ * Lock and return the bucket for memid in the table *ftp, which is updated
+ * should the table have been grown.
+ */
+static futex_hash_t *
+futex_lock_bucket(futex_table_t **ftp, memid_t *memid)
+{
+	futex_table_t *ft = *ftp;
+	futex_hash_t *fhp;
+
+	for (;;) {
+		fhp = &ft->ft_hash[HASH_FUNC(memid, ft->ft_shift)];
+		mutex_enter(&fhp->fh_lock);
+		if (ft->ft_next == NULL)
+			break;
+		mutex_exit(&fhp->fh_lock);
+		ft = ft->ft_next;
+	}
+
+	*ftp = ft;
+	return (fhp);
+}
+
+/*
+ * As futex_lock_bucket(), for the buckets of two futexes, which may be in
+ * different tables.  If both are in the same bucket, *fhp2 is set to NULL.
+ */
+static void
+futex_lock_buckets(futex_table_t **ftp1, memid_t *memid1,
+    futex_table_t **ftp2, memid_t *memid2, futex_hash_t **fhp1,
+    futex_hash_t **fhp2)
+{
+	futex_table_t *ft1 = *ftp1, *ft2 = *ftp2;
+	futex_hash_t *fh1, *fh2;
+
+	for (;;) {
+		while (ft1->ft_next != NULL)
+			ft1 = ft1->ft_next;
+		while (ft2->ft_next != NULL)
+			ft2 = ft2->ft_next;
+
+		fh1 = &ft1->ft_hash[HASH_FUNC(memid1, ft1->ft_shift)];
+		fh2 = &ft2->ft_hash[HASH_FUNC(memid2, ft2->ft_shift)];
+
+		if (fh1 == fh2) {
+			fh2 = NULL;
+			mutex_enter(&fh1->fh_lock);
+		} else if (fh1 < fh2) {
+			mutex_enter(&fh1->fh_lock);
+			mutex_enter(&fh2->fh_lock);
+		} else {
+			mutex_enter(&fh2->fh_lock);
+			mutex_enter(&fh1->fh_lock);
+		}
+
+		if (ft1->ft_next == NULL && ft2->ft_next == NULL)
+			break;
+
+		if (fh2 != NULL)
+			mutex_exit(&fh2->fh_lock);
+		mutex_exit(&fh1->fh_lock);
+	}
+
+	*ftp1 = ft1;
+	*ftp2 = ft2;
+	*fhp1 = fh1;
+	*fhp2 = fh2;
+}
+
+static void
+futex_unlock_buckets(futex_hash_t *fh1, futex_hash_t *fh2)
+{
+	if (fh2 != NULL)
+		mutex_exit(&fh2->fh_lock);
+	mutex_exit(&fh1->fh_lock);
+}
+
+/*
+ * Given that we hold the lock of fhp, return holding the lock of the bucket
+ * on which fwp is (or, once woken, was last) hashed.  Moving a waiter to
+ * another bucket requires the lock of the bucket it is on, so if that is the
+ * lock we hold, fw_hash cannot change under us.
+ */
+static futex_hash_t *
+futex_relock(fwaiter_t *fwp, futex_hash_t *fhp)
+{
+	while (fwp->fw_hash != fhp) {
+		mutex_exit(&fhp->fh_lock);
+		fhp = fwp->fw_hash;
+		mutex_enter(&fhp->fh_lock);
+	}
+
+	return (fhp);
+}
+
+/*
+ * Wake a waiter, which we found on the bucket whose lock we hold.  A thread
+ * in futex_waitv() sleeps on the shared fwaitv_t rather than on the waiter;
+ * it won't free that until it has taken the locks of all of its waiters'
+ * buckets, so holding ours keeps it around while we use it.
+ */
+static void
+futex_wakeup(fwaiter_t *fwp)
+{
+	fwaitv_t *fvp = fwp->fw_waitv;
+
+	futex_hashout(fwp);
+	fwp->fw_woken = 1;
+
+	if (fvp == NULL) {
+		cv_signal(&fwp->fw_cv);
+		return;
+	}
+
+	mutex_enter(&fvp->fv_lock);
+	if (fvp->fv_woken == -1)
+		fvp->fv_woken = (int)(fwp - fvp->fv_waiters);
+	cv_signal(&fvp->fv_cv);
+	mutex_exit(&fvp->fv_lock);
+}
+
+/*
+ * Sleep on a hashed waiter until it is woken, we get a signal, or the
+ * absolute timeout (if any) expires, returning 0, EINTR or ETIMEDOUT.  We are
+ * entered holding the lock of the waiter's bucket, *fhpp, and return holding
+ * the lock of the bucket on which it is now hashed (or was woken from).
+ *
+ * If hrtime is set, we interpret timeout to be absolute and
+ * CLOCK_MONOTONIC-based; otherwise we treat it as absolute and
+ * CLOCK_REALTIME-based.  (Strictly speaking -- or at least in as much as the
+ * term "strictly" means anything in the semantic shambles that is Linux --
+ * FUTEX_WAIT defines its timeout to be CLOCK_MONOTONIC-based but limited by
+ * system clock interval; we treat these semantics as effectively
+ * CLOCK_REALTIME.)
+ */
+static int
+futex_sleep(fwaiter_t *fwp, futex_hash_t **fhpp, timespec_t *timeout,
+    boolean_t hrtime)
+{
+	futex_hash_t *fhp = *fhpp;
+	int ret, err = 0;
+
+	ASSERT(!hrtime || timeout != NULL);
+
+	while (fwp->fw_woken == 0) {
+		if (hrtime) {
+			ret = cv_timedwait_sig_hrtime(&fwp->fw_cv,
+			    &fhp->fh_lock, ts2hrt(timeout));
+		} else {
+			ret = cv_waituntil_sig(&fwp->fw_cv, &fhp->fh_lock,
+			    timeout, timechanged);
+		}
+
+		fhp = futex_relock(fwp, fhp);
+		if (fwp->fw_woken != 0)
+			break;
+
+		if (ret < 0) {
+			err = ETIMEDOUT;
+			break;
+		} else if (ret == 0) {
+			err = EINTR;
+			break;
+		}
+	}
+
+	*fhpp = fhp;
+	return (err);
+}
+
 /*
  * Go to sleep until somebody does a WAKE operation on this futex, we get a
  * signal, or the timeout expires.
  */
 static int
-futex_wait(memid_t *memid, caddr_t addr,
+futex_wait(futex_table_t *ft, memid_t *memid, caddr_t addr,
     int val, timespec_t *timeout, uint32_t bits, boolean_t hrtime)
 {
 	kthread_t *t = curthread;
 	lx_lwp_data_t *lwpd = ttolxlwp(t);
 	fwaiter_t *fwp = &lwpd->br_fwaiter;
-	int err, ret;
+	futex_hash_t *fhp;
+	int err;
 	int32_t curval;
-	int index;
 
 	/*
 	 * The LMS_USER_LOCK micro state becomes valid if we sleep; otherwise
@@ -396,8 +782,7 @@ futex_wait(memid_t *memid, caddr_t addr,
 	MEMID_COPY(memid, &fwp->fw_memid);
 	cv_init(&fwp->fw_cv, NULL, CV_DEFAULT, NULL);
 
-	index = HASH_FUNC(&fwp->fw_memid);
-	mutex_enter(&futex_hash[index].fh_lock);
+	fhp = futex_lock_bucket(&ft, memid);
 
 	if (fuword32(addr, (uint32_t *)&curval)) {
 		err = set_errno(EFAULT);
@@ -409,7 +794,7 @@ futex_wait(memid_t *memid, caddr_t addr,
 	}
 
 	/*
-	 * We can't have hrtime and a timeout of 0. See below about
+	 * We can't have hrtime and a timeout of 0. See futex_sleep() about
 	 * CLOCK_REALTIME.
 	 * On Linux this is is an invalid state anyway, so we'll short cut
 	 * this early to avoid a panic from passing a null pointer to ts2hrt().
@@ -419,39 +804,17 @@ futex_wait(memid_t *memid, caddr_t addr,
 		goto out;
 	}
 
-	futex_hashin(fwp);
+	futex_hashin(ft, fhp, fwp);
 
-	err = 0;
-	while ((fwp->fw_woken == 0) && (err == 0)) {
+	if ((err = futex_sleep(fwp, &fhp, timeout, hrtime)) == EINTR) {
 		/*
-		 * If hrtime is set, we interpret timeout to be absolute and
-		 * CLOCK_MONOTONIC-based; otherwise we treat it as absolute
-		 * and CLOCK_REALTIME-based. (Strictly speaking -- or at least
-		 * in as much as the term "strictly" means anything in the
-		 * semantic shambles that is Linux -- FUTEX_WAIT defines its
-		 * timeout to be CLOCK_MONOTONIC-based but limited by system
-		 * clock interval; we treat these semantics as effectively
-		 * CLOCK_REALTIME.)
+		 * According to signal(7), a futex(2) call with the
+		 * FUTEX_WAIT operation is restartable.
 		 */
-		if (hrtime) {
-			ret = cv_timedwait_sig_hrtime(&fwp->fw_cv,
-			    &futex_hash[index].fh_lock, ts2hrt(timeout));
-		} else {
-			ret = cv_waituntil_sig(&fwp->fw_cv,
-			    &futex_hash[index].fh_lock, timeout, timechanged);
-		}
-
-		if (ret < 0) {
-			err = set_errno(ETIMEDOUT);
-		} else if (ret == 0) {
-			/*
-			 * According to signal(7), a futex(2) call with the
-			 * FUTEX_WAIT operation is restartable.
-			 */
-			ttolxlwp(t)->br_syscall_restart = B_TRUE;
-			err = set_errno(EINTR);
-		}
+		ttolxlwp(t)->br_syscall_restart = B_TRUE;
 	}
+	if (err != 0)
+		err = set_errno(err);
 
 	/*
 	 * The futex is normally hashed out in wakeup.  If we timed out or
@@ -461,7 +824,7 @@ futex_wait(memid_t *memid, caddr_t addr,
 		futex_hashout(fwp);
 
 out:
-	mutex_exit(&futex_hash[index].fh_lock);
+	mutex_exit(&fhp->fh_lock);
 
 	return (err);
 }
@@ -470,17 +833,15 @@ out:
  * Wake up to wake_threads threads that are blocked on the futex at memid.
  */
 static int
-futex_wake(memid_t *memid, int wake_threads, uint32_t mask)
+futex_wake(futex_table_t *ft, memid_t *memid, int wake_threads, uint32_t mask)
 {
 	fwaiter_t *fwp, *next;
-	int index;
+	futex_hash_t *fhp;
 	int ret = 0;
 
-	index = HASH_FUNC(memid);
-
-	mutex_enter(&futex_hash[index].fh_lock);
+	fhp = futex_lock_bucket(&ft, memid);
 
-	for (fwp = futex_hash[index].fh_waiters;
+	for (fwp = fhp->fh_waiters;
 	    fwp != NULL && ret < wake_threads; fwp = next) {
 		next = fwp->fw_next;
 		if (MEMID_EQUAL(&fwp->fw_memid, memid)) {
@@ -489,20 +850,18 @@ futex_wake(memid_t *memid, int wake_threads, uint32_t mask)
 				 * A PI waiter. It is invalid to mix PI and
 				 * non-PI usage on the same futex.
 				 */
-				mutex_exit(&futex_hash[index].fh_lock);
+				mutex_exit(&fhp->fh_lock);
 				return (set_errno(EINVAL));
 			}
 
 			if ((fwp->fw_bits & mask)) {
-				futex_hashout(fwp);
-				fwp->fw_woken = 1;
-				cv_signal(&fwp->fw_cv);
+				futex_wakeup(fwp);
 				ret++;
 			}
 		}
 	}
 
-	mutex_exit(&futex_hash[index].fh_lock);
+	mutex_exit(&fhp->fh_lock);
 
 	return (ret);
 }
@@ -600,32 +959,16 @@ futex_wake_op_execute(int32_t *addr, int32_t val3)
 }
 
 static int
-futex_wake_op(memid_t *memid, caddr_t addr2, memid_t *memid2,
-    int wake_threads, int wake_threads2, int val3)
+futex_wake_op(futex_table_t *ft, memid_t *memid, caddr_t addr2,
+    futex_table_t *ft2, memid_t *memid2, int wake_threads, int wake_threads2,
+    int val3)
 {
-	kmutex_t *l1, *l2;
+	futex_hash_t *fh1, *fh2;
 	int ret = 0, ret2 = 0, wake;
 	fwaiter_t *fwp, *next;
-	int index1, index2;
-
-	index1 = HASH_FUNC(memid);
-	index2 = HASH_FUNC(memid2);
-
-	if (index1 == index2) {
-		l1 = &futex_hash[index1].fh_lock;
-		l2 = NULL;
-	} else if (index1 < index2) {
-		l1 = &futex_hash[index1].fh_lock;
-		l2 = &futex_hash[index2].fh_lock;
-	} else {
-		l1 = &futex_hash[index2].fh_lock;
-		l2 = &futex_hash[index1].fh_lock;
-	}
 
 retry:
-	mutex_enter(l1);
-	if (l2 != NULL)
-		mutex_enter(l2);
+	futex_lock_buckets(&ft, memid, &ft2, memid2, &fh1, &fh2);
 
 	/* LINTED: alignment */
 	if ((wake = futex_wake_op_execute((int32_t *)addr2, val3)) < 0) {
@@ -634,9 +977,7 @@ retry:
 		 * involved mutexes to allow others to run, and try again.
 		 */
 		if (wake == -EAGAIN) {
-			if (l2 != NULL)
-				mutex_exit(l2);
-			mutex_exit(l1);
+			futex_unlock_buckets(fh1, fh2);
 			goto retry;
 		}
 
@@ -645,7 +986,7 @@ retry:
 		goto out;
 	}
 
-	for (fwp = futex_hash[index1].fh_waiters; fwp != NULL; fwp = next) {
+	for (fwp = fh1->fh_waiters; fwp != NULL; fwp = next) {
 		next = fwp->fw_next;
 		if (!MEMID_EQUAL(&fwp->fw_memid, memid))
 			continue;
@@ -660,9 +1001,7 @@ retry:
 			goto out;
 		}
 
-		futex_hashout(fwp);
-		fwp->fw_woken = 1;
-		cv_signal(&fwp->fw_cv);
+		futex_wakeup(fwp);
 		if (++ret >= wake_threads) {
 			break;
 		}
@@ -671,7 +1010,8 @@ retry:
 	if (!wake)
 		goto out;
 
-	for (fwp = futex_hash[index2].fh_waiters; fwp != NULL; fwp = next) {
+	for (fwp = (fh2 != NULL ? fh2 : fh1)->fh_waiters; fwp != NULL;
+	    fwp = next) {
 		next = fwp->fw_next;
 		if (!MEMID_EQUAL(&fwp->fw_memid, memid2))
 			continue;
@@ -686,9 +1026,7 @@ retry:
 			goto out;
 		}
 
-		futex_hashout(fwp);
-		fwp->fw_woken = 1;
-		cv_signal(&fwp->fw_cv);
+		futex_wakeup(fwp);
 		if (++ret2 >= wake_threads2) {
 			break;
 		}
@@ -696,9 +1034,7 @@ retry:
 
 	ret += ret2;
 out:
-	if (l2 != NULL)
-		mutex_exit(l2);
-	mutex_exit(l1);
+	futex_unlock_buckets(fh1, fh2);
 
 	return (ret);
 }
@@ -709,38 +1045,21 @@ out:
  * the futex at requeue_memid.
  */
 static int
-futex_requeue(memid_t *memid, memid_t *requeue_memid, int wake_threads,
-    ulong_t requeue_threads, caddr_t addr, int *cmpval)
+futex_requeue(futex_table_t *ft, memid_t *memid, futex_table_t *ft2,
+    memid_t *requeue_memid, int wake_threads, ulong_t requeue_threads,
+    caddr_t addr, int *cmpval)
 {
 	fwaiter_t *fwp, *next;
-	int index1, index2;
+	futex_hash_t *fh1, *fh2;
 	int ret = 0;
 	int32_t curval;
-	kmutex_t *l1, *l2;
 
 	/*
 	 * To ensure that we don't miss a wakeup if the value of cmpval
 	 * changes, we need to grab locks on both the original and new hash
-	 * buckets.  To avoid deadlock, we always grab the lower-indexed
-	 * lock first.
+	 * buckets.
 	 */
-	index1 = HASH_FUNC(memid);
-	index2 = HASH_FUNC(requeue_memid);
-
-	if (index1 == index2) {
-		l1 = &futex_hash[index1].fh_lock;
-		l2 = NULL;
-	} else if (index1 < index2) {
-		l1 = &futex_hash[index1].fh_lock;
-		l2 = &futex_hash[index2].fh_lock;
-	} else {
-		l1 = &futex_hash[index2].fh_lock;
-		l2 = &futex_hash[index1].fh_lock;
-	}
-
-	mutex_enter(l1);
-	if (l2 != NULL)
-		mutex_enter(l2);
+	futex_lock_buckets(&ft, memid, &ft2, requeue_memid, &fh1, &fh2);
 
 	if (cmpval != NULL) {
 		if (fuword32(addr, (uint32_t *)&curval)) {
@@ -753,18 +1072,26 @@ futex_requeue(memid_t *memid, memid_t *requeue_memid, int wake_threads,
 		}
 	}
 
-	for (fwp = futex_hash[index1].fh_waiters; fwp != NULL; fwp = next) {
+	for (fwp = fh1->fh_waiters; fwp != NULL; fwp = next) {
 		next = fwp->fw_next;
 		if (!MEMID_EQUAL(&fwp->fw_memid, memid))
 			continue;
 
-		futex_hashout(fwp);
+		if (fwp->fw_tid != 0) {
+			/*
+			 * A PI waiter, or one waiting to be requeued to a PI
+			 * futex; those are for FUTEX_CMP_REQUEUE_PI.
+			 */
+			ret = -EINVAL;
+			goto out;
+		}
+
 		if (ret++ < wake_threads) {
-			fwp->fw_woken = 1;
-			cv_signal(&fwp->fw_cv);
+			futex_wakeup(fwp);
 		} else {
+			futex_hashout(fwp);
 			MEMID_COPY(requeue_memid, &fwp->fw_memid);
-			futex_hashin(fwp);
+			futex_hashin(ft2, fh2 != NULL ? fh2 : fh1, fwp);
 
 			if ((ret - wake_threads) >= requeue_threads)
 				break;
@@ -772,9 +1099,142 @@ futex_requeue(memid_t *memid, memid_t *requeue_memid, int wake_threads,
 	}
 
 out:
-	if (l2 != NULL)
-		mutex_exit(l2);
-	mutex_exit(l1);
+	futex_unlock_buckets(fh1, fh2);
+
+	if (ret < 0)
+		return (set_errno(-ret));
+	return (ret);
+}
+
+/*
+ * Try to take the PI futex at addr for a waiter with the given tid that is
+ * being requeued onto it by FUTEX_CMP_REQUEUE_PI.  If the futex is held, or
+ * tid is 0, set FUTEX_WAITERS instead, so that the holder will come to
+ * FUTEX_UNLOCK_PI.  Returns 1 if the futex was taken, 0 if not, or a negated
+ * errno.
+ */
+static int
+futex_requeue_pi_atomic(uint32_t *addr, pid_t tid)
+{
+	uint32_t oldval, newval;
+	label_t ljb;
+	uint_t loops = 0;
+
+	if ((uintptr_t)addr >= KERNELBASE)
+		return (-EFAULT);
+
+	if (on_fault(&ljb))
+		return (-EFAULT);
+
+	do {
+		if (loops++ > CAS_LOOP_LIMIT) {
+			no_fault();
+			return (-EAGAIN);
+		}
+
+		oldval = *addr;
+		if (tid != 0 && (oldval & FUTEX_TID_MASK) == 0)
+			newval = tid | (oldval & ~FUTEX_TID_MASK);
+		else
+			newval = oldval | FUTEX_WAITERS;
+	} while (atomic_cas_32(addr, oldval, newval) != oldval);
+
+	no_fault();
+
+	return (tid != 0 && (oldval & FUTEX_TID_MASK) == 0);
+}
+
+/*
+ * The waker's half of a PI condition variable: having checked that the futex
+ * at memid still contains cmpval, try to take the PI futex at memid2 on
+ * behalf of the first waiter, waking it if that succeeds, and requeue up to
+ * requeue_threads of the rest onto the PI futex, where they will be woken by
+ * FUTEX_UNLOCK_PI.  All of the waiters must be in FUTEX_WAIT_REQUEUE_PI
+ * expecting memid2.  Returns the number of waiters woken or requeued.
+ *
+ * In keeping with our best-effort approach to priority inheritance, the
+ * holder of the PI futex does not inherit the priority of waiters requeued
+ * onto it; they will still be woken in priority order.
+ */
+static int
+futex_cmp_requeue_pi(futex_table_t *ft, memid_t *memid, futex_table_t *ft2,
+    memid_t *memid2, int wake_threads, ulong_t requeue_threads,
+    caddr_t addr, caddr_t addr2, int cmpval)
+{
+	fwaiter_t *fwp, *next;
+	futex_hash_t *fh1, *fh2;
+	boolean_t first = B_TRUE, waiters = B_FALSE;
+	ulong_t requeued = 0;
+	int ret = 0, rv;
+	int32_t curval;
+
+	/* As on Linux, exactly one waiter may be woken. */
+	if (wake_threads != 1 || MEMID_EQUAL(memid, memid2))
+		return (set_errno(EINVAL));
+
+	futex_lock_buckets(&ft, memid, &ft2, memid2, &fh1, &fh2);
+
+	if (fuword32(addr, (uint32_t *)&curval)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	if (curval != cmpval) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	for (fwp = fh1->fh_waiters; fwp != NULL; fwp = next) {
+		next = fwp->fw_next;
+		if (!MEMID_EQUAL(&fwp->fw_memid, memid))
+			continue;
+
+		if (!fwp->fw_rqpi ||
+		    !MEMID_EQUAL(&fwp->fw_rqpi_memid, memid2)) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		if (first) {
+			first = B_FALSE;
+			/* LINTED: alignment */
+			rv = futex_requeue_pi_atomic((uint32_t *)addr2,
+			    fwp->fw_tid);
+			if (rv < 0) {
+				ret = rv;
+				goto out;
+			}
+			if (rv == 1) {
+				fwp->fw_rqpi = B_FALSE;
+				futex_wakeup(fwp);
+				ret++;
+				continue;
+			}
+			waiters = B_TRUE;
+		}
+
+		if (requeued >= requeue_threads)
+			break;
+
+		if (!waiters) {
+			/* LINTED: alignment */
+			rv = futex_requeue_pi_atomic((uint32_t *)addr2, 0);
+			if (rv < 0) {
+				ret = rv;
+				goto out;
+			}
+			waiters = B_TRUE;
+		}
+
+		futex_hashout(fwp);
+		fwp->fw_rqpi = B_FALSE;
+		MEMID_COPY(memid2, &fwp->fw_memid);
+		futex_hashin(ft2, fh2 != NULL ? fh2 : fh1, fwp);
+		requeued++;
+		ret++;
+	}
+
+out:
+	futex_unlock_buckets(fh1, fh2);
 
 	if (ret < 0)
 		return (set_errno(-ret));
@@ -834,8 +1294,8 @@ get_timeout(void *lx_timeout, timestruc_t *timeout, int cmd)
  * EAGAIN immediately.
  */
 static int
-futex_lock_pi(memid_t *memid, uint32_t *addr, timespec_t *timeout,
-    boolean_t is_trylock)
+futex_lock_pi(futex_table_t *ft, memid_t *memid, uint32_t *addr,
+    timespec_t *timeout, boolean_t is_trylock)
 {
 	kthread_t *t = curthread;
 	lx_lwp_data_t *lwpd = ttolxlwp(t);
@@ -843,7 +1303,7 @@ futex_lock_pi(memid_t *memid, uint32_t *addr, timespec_t *timeout,
 	fwaiter_t *f_fwp;
 	int fpri, mypri;
 	int err;
-	int index;
+	futex_hash_t *fhp;
 	/* volatile to silence gcc clobber warning for longjmp */
 	volatile pid_t mytid;
 	pid_t ftid;			/* current futex holder tid */
@@ -865,9 +1325,8 @@ futex_lock_pi(memid_t *memid, uint32_t *addr, timespec_t *timeout,
 	 * c) T1 proceeds to enqueue itself.
 	 * At this point nothing will ever wake T1.
 	 */
-	index = HASH_FUNC(memid);
 retry:
-	mutex_enter(&futex_hash[index].fh_lock);
+	fhp = futex_lock_bucket(&ft, memid);
 
 	/* It would be very unusual to actually loop here. */
 	oldval = 0;
@@ -881,12 +1340,12 @@ retry:
 		 * occur, indicative of userspace tomfoolery.
 		 */
 		if (loops++ > CAS_LOOP_LIMIT) {
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			goto retry;
 		}
 
 		if (on_fault(&ljb)) {
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (set_errno(EFAULT));
 		}
 
@@ -900,7 +1359,7 @@ retry:
 		curval = atomic_cas_32(addr, oldval, mytid);
 		if (oldval == curval) {
 			no_fault();
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (0);
 		}
 
@@ -914,14 +1373,14 @@ retry:
 
 		if (ftid == mytid) {
 			no_fault();
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (set_errno(EDEADLK));
 		}
 
 		/* The futex is currently held by another thread. */
 		if (is_trylock) {
 			no_fault();
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (set_errno(EAGAIN));
 		}
 
@@ -967,12 +1426,12 @@ retry:
 			    oldval | FUTEX_OWNER_DIED);
 		}
 		no_fault();
-		mutex_exit(&futex_hash[index].fh_lock);
+		mutex_exit(&fhp->fh_lock);
 		return (set_errno(ESRCH));
 	}
 	if (!PROC_IS_BRANDED(fproc)) {
 		mutex_exit(&fproc->p_lock);
-		mutex_exit(&futex_hash[index].fh_lock);
+		mutex_exit(&fhp->fh_lock);
 		return (set_errno(ESRCH));
 	}
 
@@ -1010,21 +1469,14 @@ retry:
 	MEMID_COPY(memid, &fwp->fw_memid);
 	cv_init(&fwp->fw_cv, NULL, CV_DEFAULT, NULL);
 
-	futex_hashin(fwp);
+	futex_hashin(ft, fhp, fwp);
 
-	err = 0;
-	while (fwp->fw_woken == 0 && err == 0) {
-		int ret;
-
-		ret = cv_waituntil_sig(&fwp->fw_cv, &futex_hash[index].fh_lock,
-		    timeout, timechanged);
-		if (ret < 0) {
-			err = set_errno(ETIMEDOUT);
-		} else if (ret == 0) {
-			/* EINTR is not valid for futex_lock_pi */
-			err = set_errno(EAGAIN);
-		}
+	if ((err = futex_sleep(fwp, &fhp, timeout, B_FALSE)) == EINTR) {
+		/* EINTR is not valid for futex_lock_pi */
+		err = EAGAIN;
 	}
+	if (err != 0)
+		err = set_errno(err);
 
 	/*
 	 * The futex is normally hashed out in futex_unlock_pi. If we timed out
@@ -1033,7 +1485,90 @@ retry:
 	if (fwp->fw_woken == 0)
 		futex_hashout(fwp);
 
-	mutex_exit(&futex_hash[index].fh_lock);
+	mutex_exit(&fhp->fh_lock);
+	return (err);
+}
+
+/*
+ * The waiter's half of a PI condition variable: wait on the non-PI futex at
+ * memid to be requeued by FUTEX_CMP_REQUEUE_PI onto the PI futex at memid2.
+ * We return successfully only once we hold the PI futex, whether it was
+ * taken for us as we were requeued, or handed to us by FUTEX_UNLOCK_PI
+ * afterwards.  The timeout is absolute, as for FUTEX_WAIT_BITSET.
+ */
+static int
+futex_wait_requeue_pi(futex_table_t *ft, memid_t *memid, caddr_t addr,
+    int val, timespec_t *timeout, boolean_t hrtime, memid_t *memid2)
+{
+	kthread_t *t = curthread;
+	lx_lwp_data_t *lwpd = ttolxlwp(t);
+	fwaiter_t *fwp = &lwpd->br_fwaiter;
+	futex_hash_t *fhp;
+	int32_t curval;
+	int mypri, err;
+
+	if (MEMID_EQUAL(memid, memid2))
+		return (set_errno(EINVAL));
+
+	mutex_enter(&curproc->p_lock);
+	(void) CL_DOPRIO(curthread, kcred, 0, &mypri);
+	mutex_exit(&curproc->p_lock);
+
+	/* See futex_wait() for LMS_USER_LOCK state description. */
+	(void) new_mstate(t, LMS_USER_LOCK);
+
+	fwp->fw_woken = 0;
+	fwp->fw_bits = FUTEX_BITSET_MATCH_ANY;
+	fwp->fw_tid = (lwpd->br_pid == curzone->zone_proc_initpid ?
+	    1 : lwpd->br_pid);
+	if (!fwp->fw_pri_up)
+		fwp->fw_opri = mypri;
+	fwp->fw_rqpi = B_TRUE;
+	MEMID_COPY(memid2, &fwp->fw_rqpi_memid);
+	MEMID_COPY(memid, &fwp->fw_memid);
+	cv_init(&fwp->fw_cv, NULL, CV_DEFAULT, NULL);
+
+	fhp = futex_lock_bucket(&ft, memid);
+
+	if (fuword32(addr, (uint32_t *)&curval)) {
+		err = set_errno(EFAULT);
+		goto out;
+	}
+	if (curval != val) {
+		err = set_errno(EWOULDBLOCK);
+		goto out;
+	}
+	if (hrtime && timeout == NULL) {
+		err = set_errno(EINVAL);
+		goto out;
+	}
+
+	futex_hashin(ft, fhp, fwp);
+
+	if ((err = futex_sleep(fwp, &fhp, timeout, hrtime)) == EINTR) {
+		if (fwp->fw_rqpi) {
+			/* Not yet requeued; restart as for FUTEX_WAIT. */
+			ttolxlwp(t)->br_syscall_restart = B_TRUE;
+		} else {
+			/*
+			 * Already requeued, so a restart would only find that
+			 * the value has changed; as Linux does, save it the
+			 * trouble.
+			 */
+			err = EWOULDBLOCK;
+		}
+	}
+	if (err != 0)
+		err = set_errno(err);
+
+	if (fwp->fw_woken == 0)
+		futex_hashout(fwp);
+
+out:
+	fwp->fw_rqpi = B_FALSE;
+	fwp->fw_tid = 0;
+	mutex_exit(&fhp->fh_lock);
+
 	return (err);
 }
 
@@ -1074,9 +1609,7 @@ futex_unlock_pi_waiter(fwaiter_t *fnd_fwp, uint32_t *addr, uint32_t curval)
 
 	no_fault();
 
-	futex_hashout(fnd_fwp);
-	fnd_fwp->fw_woken = 1;
-	cv_signal(&fnd_fwp->fw_cv);
+	futex_wakeup(fnd_fwp);
 
 	return (0);
 }
@@ -1089,7 +1622,8 @@ futex_unlock_pi_waiter(fwaiter_t *fnd_fwp, uint32_t *addr, uint32_t curval)
  * tid to avoid cleanup races.
  */
 static int
-futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
+futex_unlock_pi(futex_table_t *ft, memid_t *memid, uint32_t *addr,
+    pid_t clean_tid)
 {
 	kthread_t *t = curthread;
 	lx_lwp_data_t *lwpd = ttolxlwp(t);
@@ -1097,7 +1631,7 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 	uint32_t curval;
 	pid_t mytid;
 	pid_t holder_tid;
-	int index;
+	futex_hash_t *fhp;
 	int hipri;
 	int res;
 
@@ -1107,11 +1641,10 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 	mytid = (lwpd->br_pid == curzone->zone_proc_initpid ? 1 : lwpd->br_pid);
 
 	/* See comment in futex_lock_pi for why we take the mutex first. */
-	index = HASH_FUNC(memid);
-	mutex_enter(&futex_hash[index].fh_lock);
+	fhp = futex_lock_bucket(&ft, memid);
 
 	if (fuword32(addr, &curval)) {
-		mutex_exit(&futex_hash[index].fh_lock);
+		mutex_exit(&fhp->fh_lock);
 		return (EFAULT);
 	}
 
@@ -1119,7 +1652,7 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 	if (clean_tid == 0) {
 		/* Not cleaning up so we must hold the futex */
 		if (holder_tid != mytid) {
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (EPERM);
 		}
 	} else {
@@ -1139,11 +1672,11 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 		DTRACE_PROBE2(futex__unl__clean, int, curval, int, clean_tid);
 		if ((curval & FUTEX_OWNER_DIED) != 0) {
 			if (holder_tid != 0) {
-				mutex_exit(&futex_hash[index].fh_lock);
+				mutex_exit(&fhp->fh_lock);
 				return (0);
 			}
 		} else if (holder_tid != clean_tid) {
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (0);
 		}
 	}
@@ -1185,7 +1718,7 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 		label_t fjb;
 
 		if (on_fault(&fjb)) {
-			mutex_exit(&futex_hash[index].fh_lock);
+			mutex_exit(&fhp->fh_lock);
 			return (EFAULT);
 		}
 		if (atomic_cas_32(addr, curval,
@@ -1194,23 +1727,22 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 		}
 
 		no_fault();
-		mutex_exit(&futex_hash[index].fh_lock);
+		mutex_exit(&fhp->fh_lock);
 		return (res);
 	}
 
 	/* Find the highest priority waiter. */
 	hipri = BELOW_MINPRI;
 	fnd_fwp = NULL;
-	for (fwp = futex_hash[index].fh_waiters; fwp != NULL;
-	    fwp = fwp->fw_next) {
+	for (fwp = fhp->fh_waiters; fwp != NULL; fwp = fwp->fw_next) {
 		if (MEMID_EQUAL(&fwp->fw_memid, memid)) {
-			if (fwp->fw_tid == 0) {
+			if (fwp->fw_tid == 0 || fwp->fw_rqpi) {
 				/*
 				 * A non-PI waiter. It is invalid to mix PI and
 				 * non-PI usage on the same futex.
 				 */
 				no_fault();
-				mutex_exit(&futex_hash[index].fh_lock);
+				mutex_exit(&fhp->fh_lock);
 				return (EINVAL);
 			}
 			/*
@@ -1226,7 +1758,7 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
 	}
 
 	res = futex_unlock_pi_waiter(fnd_fwp, addr, curval);
-	mutex_exit(&futex_hash[index].fh_lock);
+	mutex_exit(&fhp->fh_lock);
 	return (res);
 }
 
@@ -1236,7 +1768,7 @@ futex_unlock_pi(memid_t *memid, uint32_t *addr, pid_t clean_tid)
  * a live process.
  */
 static int
-futex_trylock_pi(memid_t *memid, uint32_t *addr)
+futex_trylock_pi(futex_table_t *ft, memid_t *memid, uint32_t *addr)
 {
 	uint32_t curval;
 	pid_t ftid;			/* current futex holder tid */
@@ -1251,7 +1783,7 @@ futex_trylock_pi(memid_t *memid, uint32_t *addr)
 
 	/* The futex is free, use the normal flow. */
 	if (curval == 0)
-		return (futex_lock_pi(memid, addr, NULL, B_TRUE));
+		return (futex_lock_pi(ft, memid, addr, NULL, B_TRUE));
 
 	/* Determine if the current futex holder is still alive. */
 	ftid = curval & FUTEX_TID_MASK;
@@ -1263,9 +1795,9 @@ futex_trylock_pi(memid_t *memid, uint32_t *addr)
 		 * Ignore any error that may result from two threads racing to
 		 * cleanup.
 		 */
-		(void) futex_unlock_pi(memid, addr, ftid);
+		(void) futex_unlock_pi(ft, memid, addr, ftid);
 	}
-	return (futex_lock_pi(memid, addr, NULL, B_TRUE));
+	return (futex_lock_pi(ft, memid, addr, NULL, B_TRUE));
 }
 
 long
@@ -1274,6 +1806,7 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 {
 	struct as *as = curproc->p_as;
 	memid_t memid, memid2;
+	futex_table_t *ft, *ft2 = NULL;
 	timestruc_t timeout;
 	timestruc_t *tptr = NULL;
 	int val2 = 0;
@@ -1301,21 +1834,8 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 		return (set_errno(ENOSYS));
 	}
 
-	switch (cmd) {
-	case FUTEX_WAIT_REQUEUE_PI:
-	case FUTEX_CMP_REQUEUE_PI:
-		/*
-		 * These are operations that we don't currently support, but
-		 * may well need to in the future.  For now, callers need to
-		 * deal with these being missing -- but if and as that changes,
-		 * they may well need to be implemented.
-		 */
-		(void) snprintf(dmsg, sizeof (dmsg), "futex 0x%x", cmd);
-		lx_unsupported(dmsg);
-		return (set_errno(ENOSYS));
-	}
-
-	if ((op & FUTEX_CLOCK_REALTIME) && cmd != FUTEX_WAIT_BITSET) {
+	if ((op & FUTEX_CLOCK_REALTIME) && cmd != FUTEX_WAIT_BITSET &&
+	    cmd != FUTEX_WAIT_REQUEUE_PI) {
 		/*
 		 * Linux only allows FUTEX_CLOCK_REALTIME to be set on the
 		 * FUTEX_WAIT_BITSET and FUTEX_WAIT_REQUEUE_PI commands.
@@ -1325,7 +1845,8 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 
 	/* Copy in the timeout structure from userspace. */
 	if ((cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_BITSET ||
-	    cmd == FUTEX_LOCK_PI) && lx_timeout != (uintptr_t)NULL) {
+	    cmd == FUTEX_WAIT_REQUEUE_PI || cmd == FUTEX_LOCK_PI) &&
+	    lx_timeout != (uintptr_t)NULL) {
 		rval = get_timeout((timespec_t *)lx_timeout, &timeout, cmd);
 
 		if (rval != 0)
@@ -1336,6 +1857,7 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 	switch (cmd) {
 	case FUTEX_REQUEUE:
 	case FUTEX_CMP_REQUEUE:
+	case FUTEX_CMP_REQUEUE_PI:
 	case FUTEX_WAKE_OP:
 		/*
 		 * lx_timeout is nominally a pointer to a userspace address.
@@ -1350,7 +1872,7 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 	 * Translate the process-specific, user-space futex virtual
 	 * address(es) to a universal memid.  If the private bit is set, we
 	 * can just use our as plus the virtual address, saving quite a bit
-	 * of effort.
+	 * of effort.  Then find the table in which the waiters are hashed.
 	 */
 	if (private) {
 		memid.val[0] = (uintptr_t)as;
@@ -1362,7 +1884,8 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 	}
 
 	if (cmd == FUTEX_REQUEUE || cmd == FUTEX_CMP_REQUEUE ||
-	    cmd == FUTEX_WAKE_OP) {
+	    cmd == FUTEX_WAKE_OP || cmd == FUTEX_WAIT_REQUEUE_PI ||
+	    cmd == FUTEX_CMP_REQUEUE_PI) {
 		if (addr2 & 0x3)
 			return (set_errno(EINVAL));
 
@@ -1374,34 +1897,36 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 			if (rval)
 				return (set_errno(rval));
 		}
+		ft2 = futex_table(&memid2);
 	}
+	ft = futex_table(&memid);
 
 	switch (cmd) {
 	case FUTEX_WAIT:
-		rval = futex_wait(&memid, (void *)addr, val,
+		rval = futex_wait(ft, &memid, (void *)addr, val,
 		    tptr, FUTEX_BITSET_MATCH_ANY, B_FALSE);
 		break;
 
 	case FUTEX_WAIT_BITSET:
-		rval = futex_wait(&memid, (void *)addr, val, tptr, val3,
+		rval = futex_wait(ft, &memid, (void *)addr, val, tptr, val3,
 		    (op & FUTEX_CLOCK_REALTIME) ? B_FALSE : B_TRUE);
 		break;
 
 	case FUTEX_WAKE:
-		rval = futex_wake(&memid, val, FUTEX_BITSET_MATCH_ANY);
+		rval = futex_wake(ft, &memid, val, FUTEX_BITSET_MATCH_ANY);
 		break;
 
 	case FUTEX_WAKE_BITSET:
-		rval = futex_wake(&memid, val, val3);
+		rval = futex_wake(ft, &memid, val, val3);
 		break;
 
 	case FUTEX_WAKE_OP:
-		rval = futex_wake_op(&memid, (void *)addr2, &memid2,
+		rval = futex_wake_op(ft, &memid, (void *)addr2, ft2, &memid2,
 		    val, val2, val3);
 		break;
 
 	case FUTEX_CMP_REQUEUE:
-		rval = futex_requeue(&memid, &memid2, val,
+		rval = futex_requeue(ft, &memid, ft2, &memid2, val,
 		    val2, (void *)addr2, &val3);
 
 		break;
@@ -1413,21 +1938,33 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 		 * will elide the val3 check if cmpval (the last argument) is
 		 * NULL.
 		 */
-		rval = futex_requeue(&memid, &memid2, val,
+		rval = futex_requeue(ft, &memid, ft2, &memid2, val,
 		    val2, (void *)addr2, NULL);
 
 		break;
 
+	case FUTEX_WAIT_REQUEUE_PI:
+		rval = futex_wait_requeue_pi(ft, &memid, (void *)addr, val,
+		    tptr, (op & FUTEX_CLOCK_REALTIME) ? B_FALSE : B_TRUE,
+		    &memid2);
+		break;
+
+	case FUTEX_CMP_REQUEUE_PI:
+		rval = futex_cmp_requeue_pi(ft, &memid, ft2, &memid2, val,
+		    val2, (void *)addr, (void *)addr2, val3);
+		break;
+
 	case FUTEX_LOCK_PI:
-		rval = futex_lock_pi(&memid, (uint32_t *)addr, tptr, B_FALSE);
+		rval = futex_lock_pi(ft, &memid, (uint32_t *)addr, tptr,
+		    B_FALSE);
 		break;
 
 	case FUTEX_TRYLOCK_PI:
-		rval = futex_trylock_pi(&memid, (uint32_t *)addr);
+		rval = futex_trylock_pi(ft, &memid, (uint32_t *)addr);
 		break;
 
 	case FUTEX_UNLOCK_PI:
-		rval = futex_unlock_pi(&memid, (uint32_t *)addr, 0);
+		rval = futex_unlock_pi(ft, &memid, (uint32_t *)addr, 0);
 		if (rval != 0)
 			(void) set_errno(rval);
 		break;
@@ -1436,6 +1973,166 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 	return (rval);
 }
 
+/*
+ * Wait on up to FUTEX_WAITV_MAX futexes at once, returning the index of one
+ * that was woken.  Each futex gets its own waiter, hashed in the usual way,
+ * but the thread sleeps on the shared fwaitv_t, on which any of them can be
+ * woken.  Timeouts are absolute, against the clock given.
+ */
+long
+lx_futex_waitv(uintptr_t uwaiters, uint_t nr, uint_t flags,
+    uintptr_t lx_timeout, int clockid)
+{
+	kthread_t *t = curthread;
+	struct as *as = curproc->p_as;
+	lx_futex_waitv_t *fwv;
+	fwaitv_t fv;
+	fwaiter_t *fwp;
+	futex_table_t *ft;
+	futex_hash_t *fhp;
+	timestruc_t timeout;
+	timestruc_t *tptr = NULL;
+	int32_t curval;
+	uint_t i, nqueued = 0;
+	int ret = 0, err = 0;
+
+	if (flags != 0 || nr == 0 || nr > FUTEX_WAITV_MAX)
+		return (set_errno(EINVAL));
+
+	if (lx_timeout != (uintptr_t)NULL) {
+		if (clockid != FUTEX_WAITV_REALTIME &&
+		    clockid != FUTEX_WAITV_MONOTONIC)
+			return (set_errno(EINVAL));
+		if ((err = get_timeout((void *)lx_timeout, &timeout,
+		    FUTEX_WAIT_BITSET)) != 0)
+			return (set_errno(err));
+		tptr = &timeout;
+	}
+
+	fwv = kmem_alloc(nr * sizeof (lx_futex_waitv_t), KM_SLEEP);
+	if (copyin((void *)uwaiters, fwv, nr * sizeof (lx_futex_waitv_t))) {
+		kmem_free(fwv, nr * sizeof (lx_futex_waitv_t));
+		return (set_errno(EFAULT));
+	}
+
+	fv.fv_waiters = kmem_zalloc(nr * sizeof (fwaiter_t), KM_SLEEP);
+	for (i = 0; i < nr; i++) {
+		lx_futex_waitv_t *w = &fwv[i];
+		memid_t *memid = &fv.fv_waiters[i].fw_memid;
+
+		if ((w->fwv_flags & FUTEX2_SIZE_MASK) != FUTEX2_SIZE_U32 ||
+		    (w->fwv_flags & ~(FUTEX2_SIZE_MASK | FUTEX2_PRIVATE)) ||
+		    w->fwv_reserved != 0 || w->fwv_val > UINT32_MAX ||
+		    (w->fwv_uaddr & 0x3) != 0) {
+			err = EINVAL;
+			goto out;
+		}
+		if (w->fwv_uaddr >= KERNELBASE) {
+			err = EFAULT;
+			goto out;
+		}
+
+		if (w->fwv_flags & FUTEX2_PRIVATE) {
+			memid->val[0] = (uintptr_t)as;
+			memid->val[1] = (uintptr_t)w->fwv_uaddr;
+		} else if ((err = as_getmemid(as, (void *)(uintptr_t)
+		    w->fwv_uaddr, memid)) != 0) {
+			goto out;
+		}
+	}
+
+	mutex_init(&fv.fv_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&fv.fv_cv, NULL, CV_DEFAULT, NULL);
+	fv.fv_woken = -1;
+
+	/* See futex_wait() for LMS_USER_LOCK state description. */
+	(void) new_mstate(t, LMS_USER_LOCK);
+
+	/*
+	 * Queue a waiter on each futex that still holds its expected value.
+	 * If one doesn't, we back out, unless one of those already queued has
+	 * been woken in the meantime.
+	 */
+	for (i = 0; i < nr; i++) {
+		fwp = &fv.fv_waiters[i];
+		fwp->fw_waitv = &fv;
+		fwp->fw_bits = FUTEX_BITSET_MATCH_ANY;
+
+		ft = futex_table(&fwp->fw_memid);
+		fhp = futex_lock_bucket(&ft, &fwp->fw_memid);
+		if (fuword32((void *)(uintptr_t)fwv[i].fwv_uaddr,
+		    (uint32_t *)&curval)) {
+			err = EFAULT;
+		} else if (curval != (int32_t)fwv[i].fwv_val) {
+			err = EWOULDBLOCK;
+		} else {
+			futex_hashin(ft, fhp, fwp);
+			nqueued++;
+		}
+		mutex_exit(&fhp->fh_lock);
+
+		if (err != 0)
+			break;
+	}
+
+	mutex_enter(&fv.fv_lock);
+	while (err == 0 && fv.fv_woken == -1) {
+		if (tptr == NULL) {
+			ret = cv_wait_sig(&fv.fv_cv, &fv.fv_lock);
+		} else if (clockid == FUTEX_WAITV_MONOTONIC) {
+			ret = cv_timedwait_sig_hrtime(&fv.fv_cv, &fv.fv_lock,
+			    ts2hrt(tptr));
+		} else {
+			ret = cv_waituntil_sig(&fv.fv_cv, &fv.fv_lock, tptr,
+			    timechanged);
+		}
+
+		if (fv.fv_woken != -1)
+			break;
+
+		if (ret < 0) {
+			err = ETIMEDOUT;
+		} else if (ret == 0) {
+			/* As futex_wait(), this is restartable. */
+			ttolxlwp(t)->br_syscall_restart = B_TRUE;
+			err = EINTR;
+		}
+	}
+	mutex_exit(&fv.fv_lock);
+
+	/*
+	 * Hash out whichever waiters have not been woken.  Taking the lock of
+	 * each waiter's bucket also ensures that any thread that woke one of
+	 * them is done with fv before we destroy it.
+	 */
+	for (i = 0; i < nqueued; i++) {
+		fwp = &fv.fv_waiters[i];
+		fhp = fwp->fw_hash;
+		mutex_enter(&fhp->fh_lock);
+		fhp = futex_relock(fwp, fhp);
+		if (fwp->fw_woken == 0)
+			futex_hashout(fwp);
+		mutex_exit(&fhp->fh_lock);
+	}
+
+	/* Being woken trumps everything else. */
+	if (fv.fv_woken != -1) {
+		ret = fv.fv_woken;
+		err = 0;
+	}
+
+	cv_destroy(&fv.fv_cv);
+	mutex_destroy(&fv.fv_lock);
+
+out:
+	kmem_free(fv.fv_waiters, nr * sizeof (fwaiter_t));
+	kmem_free(fwv, nr * sizeof (lx_futex_waitv_t));
+
+	if (err != 0)
+		return (set_errno(err));
+	return (ret);
+}
+
 /*
  * Wake the next waiter if the thread holding the futex has exited without
  * releasing the futex.
@@ -1443,20 +2140,18 @@ lx_futex(uintptr_t addr, int op, int val, uintptr_t lx_timeout,
 static void
 futex_robust_wake(memid_t *memid, uint32_t tid)
 {
+	futex_table_t *ft = futex_table(memid);
+	futex_hash_t *fhp;
 	fwaiter_t *fwp;
-	int index;
-
-	index = HASH_FUNC(memid);
 
-	mutex_enter(&futex_hash[index].fh_lock);
+	fhp = futex_lock_bucket(&ft, memid);
 
-	for (fwp = futex_hash[index].fh_waiters; fwp != NULL;
-	    fwp = fwp->fw_next) {
+	for (fwp = fhp->fh_waiters; fwp != NULL; fwp = fwp->fw_next) {
 		if (MEMID_EQUAL(&fwp->fw_memid, memid))
 			break;
 	}
 
-	if (fwp != NULL) {
+	if (fwp != NULL && !fwp->fw_rqpi) {
 		if (fwp->fw_tid != 0) {
 			/*
 			 * This is a PI futex and there is a waiter; unlock the
@@ -1465,19 +2160,17 @@ futex_robust_wake(memid_t *memid, uint32_t tid)
 			 * unexpected state due to some other cleanup, such as
 			 * might happen with a concurrent trylock call.
 			 */
-			mutex_exit(&futex_hash[index].fh_lock);
-			(void) futex_unlock_pi(memid,
+			mutex_exit(&fhp->fh_lock);
+			(void) futex_unlock_pi(ft, memid,
 			    (uint32_t *)(uintptr_t)memid->val[1], tid);
 			return;
 		}
 
 		/* non-PI futex, just wake it */
-		futex_hashout(fwp);
-		fwp->fw_woken = 1;
-		cv_signal(&fwp->fw_cv);
+		futex_wakeup(fwp);
 	}
 
-	mutex_exit(&futex_hash[index].fh_lock);
+	mutex_exit(&fhp->fh_lock);
 }
 
 /*
@@ -1704,23 +2397,59 @@ out:
 void
 lx_futex_init(void)
 {
-	int i;
-
-	for (i = 0; i < HASH_SIZE; i++)
-		mutex_init(&futex_hash[i].fh_lock, NULL, MUTEX_DEFAULT, NULL);
+	futex_global = futex_table_alloc(HASH_SHIFT_SZ);
 }
 
 int
 lx_futex_fini(void)
 {
+	futex_hash_t *fhp;
 	int i, err;
 
 	err = 0;
-	for (i = 0; (err == 0) && (i < HASH_SIZE); i++) {
-		mutex_enter(&futex_hash[i].fh_lock);
-		if (futex_hash[i].fh_waiters != NULL)
+	for (i = 0; (err == 0) && (i < FT_NBUCKETS(HASH_SHIFT_SZ)); i++) {
+		fhp = &futex_global->ft_hash[i];
+		mutex_enter(&fhp->fh_lock);
+		if (fhp->fh_waiters != NULL)
 			err = EBUSY;
-		mutex_exit(&futex_hash[i].fh_lock);
+		mutex_exit(&fhp->fh_lock);
+	}
+
+	if (err == 0) {
+		futex_table_free(futex_global);
+		futex_global = NULL;
 	}
 	return (err);
 }
+
+/*
+ * A child process starts with no private futex waiters; it gets its own
+ * table on first use.
+ */
+void
+lx_futex_clear(lx_proc_data_t *cpd)
+{
+	mutex_init(&cpd->l_futex_lock, NULL, MUTEX_DEFAULT, NULL);
+	cpd->l_futex_table = NULL;
+}
+
+/*
+ * Called via lx_proc_exit, once all other lwps are gone, and when the brand
+ * is cleared, to free a process's table along with any it has retired.
+ */
+void
+lx_futex_cleanup(proc_t *p)
+{
+	lx_proc_data_t *lxpd;
+	futex_table_t *ft, *next;
+
+	mutex_enter(&p->p_lock);
+	VERIFY((lxpd = ptolxproc(p)) != NULL);
+	mutex_exit(&p->p_lock);
+
+	for (ft = lxpd->l_futex_table; ft != NULL; ft = next) {
+		next = ft->ft_retired;
+		futex_table_free(ft);
+	}
+	lxpd->l_futex_table = NULL;
+}
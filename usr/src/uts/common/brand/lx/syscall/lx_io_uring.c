@@ -0,0 +1,236 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * The Linux io_uring system calls are implemented on top of the native
+ * /dev/uring driver, whose ring layout and submission and completion entries
+ * are those of Linux.  All that is left for us to do is to supply the driver
+ * with translations for the flags and errors within the rings, and to convert
+ * the signal mask of io_uring_enter().
+ */
+
+#include <sys/types.h>
+#include <sys/systm.h>
+#include <sys/fcntl.h>
+#include <sys/file.h>
+#include <sys/ddi.h>
+#include <sys/sunddi.h>
+#include <sys/sunldi.h>
+#include <sys/vnode.h>
+#include <sys/socket.h>
+#include <sys/io_uring.h>
+#include <sys/lx_brand.h>
+#include <sys/lx_types.h>
+#include <sys/lx_signal.h>
+#include <sys/lx_socket.h>
+#include <sys/lx_misc.h>
+#include <lx_errno.h>
+
+static int
+lx_uring_errno(int error)
+{
+	return (lx_errno(error, EINVAL));
+}
+
+static int
+lx_uring_msgflags(uint32_t lx_flags, int *flagsp)
+{
+	*flagsp = lx_socket_msgflags((int)lx_flags);
+	return (0);
+}
+
+static int
+lx_uring_sockflags(uint32_t lx_flags, int *flagsp)
+{
+	int flags = 0;
+
+	if (lx_flags & ~(LX_SOCK_CLOEXEC | LX_SOCK_NONBLOCK))
+		return (EINVAL);
+
+	if (lx_flags & LX_SOCK_CLOEXEC)
+		flags |= SOCK_CLOEXEC;
+	if (lx_flags & LX_SOCK_NONBLOCK)
+		flags |= SOCK_NONBLOCK;
+	*flagsp = flags;
+	return (0);
+}
+
+static int
+lx_uring_pollevents(uint32_t lx_events, short *eventsp)
+{
+	if (lx_events > USHRT_MAX)
+		return (EINVAL);
+
+	return (lx_poll_ltos_events((short)lx_events, eventsp));
+}
+
+static uint32_t
+lx_uring_revents(short revents, uint32_t lx_events)
+{
+	return ((ushort_t)lx_poll_stol_revents(revents, (short)lx_events));
+}
+
+static const uring_xlate_t lx_uring_xlate = {
+	lx_uring_errno,
+	lx_uring_msgflags,
+	lx_uring_sockflags,
+	lx_uring_pollevents,
+	lx_uring_revents,
+};
+
+/*
+ * Get the ring for an fd; Linux fails with EOPNOTSUPP for anything else.
+ */
+static int
+lx_uring_getf(int fd, file_t **fpp)
+{
+	file_t *fp;
+	vnode_t *vp;
+
+	if ((fp = getf(fd)) == NULL)
+		return (EBADF);
+
+	vp = fp->f_vnode;
+	if (vp->v_type != VCHR ||
+	    getmajor(vp->v_rdev) != ddi_name_to_major("uring")) {
+		releasef(fd);
+		return (EOPNOTSUPP);
+	}
+
+	*fpp = fp;
+	return (0);
+}
+
+long
+lx_io_uring_setup(uint32_t entries, void *uparams)
+{
+	struct io_uring_params params;
+	int err, fd, rv;
+	int fmode = FREAD | FWRITE;
+	vnode_t *vp = NULL;
+	file_t *fp = NULL;
+
+	if (copyin(uparams, &params, sizeof (params)) != 0)
+		return (set_errno(EFAULT));
+	params.sq_entries = entries;
+
+	if (falloc((vnode_t *)NULL, fmode, &fp, &fd) != 0)
+		return (set_errno(EMFILE));
+
+	if (ldi_vp_from_name("/dev/uring", &vp) != 0) {
+		/*
+		 * As for a Linux kernel built without io_uring, which is what
+		 * applications are prepared for.
+		 */
+		err = ENOSYS;
+		goto error;
+	}
+	if ((err = VOP_OPEN(&vp, fmode | FKLYR, CRED(), NULL)) != 0) {
+		VN_RELE(vp);
+		vp = NULL;
+		goto error;
+	}
+
+	if ((err = VOP_IOCTL(vp, URINGIOC_XLATE, (intptr_t)&lx_uring_xlate,
+	    fmode | FKIOCTL, CRED(), &rv, NULL)) != 0 ||
+	    (err = VOP_IOCTL(vp, URINGIOC_SETUP, (intptr_t)&params,
+	    fmode | FKIOCTL | DATAMODEL_NATIVE, CRED(), &rv, NULL)) != 0)
+		goto error;
+
+	if (copyout(&params, uparams, sizeof (params)) != 0) {
+		err = EFAULT;
+		goto error;
+	}
+
+	/* as on Linux, the ring is always close-on-exec */
+	fp->f_vnode = vp;
+	mutex_exit(&fp->f_tlock);
+	setf(fd, fp);
+	f_setfd(fd, FD_CLOEXEC);
+	return (fd);
+
+error:
+	if (fp != NULL) {
+		setf(fd, NULL);
+		unfalloc(fp);
+	}
+	if (vp != NULL) {
+		(void) VOP_CLOSE(vp, fmode, 0, 0, CRED(), NULL);
+		VN_RELE(vp);
+	}
+	return (set_errno(err));
+}
+
+long
+lx_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+    uint32_t flags, void *sigmask, size_t sigsz)
+{
+	uring_enter_t ue;
+	k_sigset_t ksig;
+	file_t *fp;
+	int rv = 0, error;
+
+	bzero(&ue, sizeof (ue));
+	ue.ue_to_submit = to_submit;
+	ue.ue_min_complete = min_complete;
+	ue.ue_flags = flags;
+
+	if (sigmask != NULL) {
+		lx_sigset_t lsig;
+
+		if (sigsz != sizeof (lsig))
+			return (set_errno(EINVAL));
+		if (copyin(sigmask, &lsig, sizeof (lsig)) != 0)
+			return (set_errno(EFAULT));
+		lx_ltos_sigset(&lsig, &ksig);
+		ue.ue_sigmask = (uintptr_t)&ksig;
+	}
+
+	if ((error = lx_uring_getf(fd, &fp)) != 0)
+		return (set_errno(error));
+
+	error = VOP_IOCTL(fp->f_vnode, URINGIOC_ENTER, (intptr_t)&ue,
+	    fp->f_flag | FKIOCTL | DATAMODEL_NATIVE, fp->f_cred, &rv, NULL);
+
+	releasef(fd);
+	if (error != 0) {
+		return (set_errno(error));
+	}
+	return (rv);
+}
+
+long
+lx_io_uring_register(int fd, uint32_t opcode, void *arg, uint32_t nr_args)
+{
+	uring_register_t urr;
+	file_t *fp;
+	int rv = 0, error;
+
+	urr.ur_opcode = opcode;
+	urr.ur_nr_args = nr_args;
+	urr.ur_arg = (uintptr_t)arg;
+
+	if ((error = lx_uring_getf(fd, &fp)) != 0)
+		return (set_errno(error));
+
+	error = VOP_IOCTL(fp->f_vnode, URINGIOC_REGISTER, (intptr_t)&urr,
+	    fp->f_flag | FKIOCTL | DATAMODEL_NATIVE, fp->f_cred, &rv, NULL);
+
+	releasef(fd);
+	if (error != 0) {
+		return (set_errno(error));
+	}
+	return (0);
+}
@@ -64,6 +64,57 @@ extern int poll_common(pollstate_t *, pollfd_t *, nfds_t, timespec_t *, int *);
 	(LX_POLL_COMMON_EVENTS | LX_POLLWRNORM | LX_POLLWRBAND | LX_POLLRDHUP)
 
 
+/*
+ * Translate Linux poll events into their SunOS equivalent, and SunOS revents
+ * back into Linux ones given the Linux events originally polled for.  These
+ * are also used for io_uring POLL_ADD requests.
+ */
+int
+lx_poll_ltos_events(short lx_events, short *eventsp)
+{
+	short events;
+
+	/*
+	 * If the caller is polling for an unsupported event, we have to bail
+	 * out.
+	 */
+	if (lx_events & ~LX_POLL_SUPPORTED_EVENTS) {
+		return (ENOTSUP);
+	}
+
+	events = lx_events & LX_POLL_COMMON_EVENTS;
+	if (lx_events & LX_POLLWRNORM)
+		events |= POLLWRNORM;
+	if (lx_events & LX_POLLWRBAND)
+		events |= POLLWRBAND;
+	if (lx_events & LX_POLLRDHUP)
+		events |= POLLRDHUP;
+	*eventsp = events;
+	return (0);
+}
+
+short
+lx_poll_stol_revents(short revents, short orig_events)
+{
+	short lx_revents = revents & LX_POLL_COMMON_EVENTS;
+
+	if (revents & POLLWRBAND)
+		lx_revents |= LX_POLLWRBAND;
+	if (revents & POLLRDHUP)
+		lx_revents |= LX_POLLRDHUP;
+	/*
+	 * Because POLLOUT and POLLWRNORM are native defined as the same value,
+	 * care must be taken when translating them to Linux where they differ.
+	 */
+	if (revents & POLLOUT) {
+		if ((orig_events & LX_POLLOUT) == 0)
+			lx_revents &= ~LX_POLLOUT;
+		if (orig_events & LX_POLLWRNORM)
+			lx_revents |= LX_POLLWRNORM;
+	}
+	return (lx_revents);
+}
+
 static int
 lx_poll_copyin(pollstate_t *ps, pollfd_t *fds, nfds_t nfds, short *oldevt)
 {
@@ -78,24 +129,11 @@ lx_poll_copyin(pollstate_t *ps, pollfd_t *fds, nfds_t nfds, short *oldevt)
 	/* Convert the Linux events bitmask into SunOS equivalent. */
 	for (i = 0; i < nfds; i++) {
 		short lx_events = pollfdp[i].events;
-		short events;
 
-		/*
-		 * If the caller is polling for an unsupported event, we
-		 * have to bail out.
-		 */
-		if (lx_events & ~LX_POLL_SUPPORTED_EVENTS) {
-			return (ENOTSUP);
+		if ((error = lx_poll_ltos_events(lx_events,
+		    &pollfdp[i].events)) != 0) {
+			return (error);
 		}
-
-		events = lx_events & LX_POLL_COMMON_EVENTS;
-		if (lx_events & LX_POLLWRNORM)
-			events |= POLLWRNORM;
-		if (lx_events & LX_POLLWRBAND)
-			events |= POLLWRBAND;
-		if (lx_events & LX_POLLRDHUP)
-			events |= POLLRDHUP;
-		pollfdp[i].events = events;
 		oldevt[i] = lx_events;
 	}
 	return (0);
@@ -111,28 +149,9 @@ lx_poll_copyout(pollfd_t *pollfdp, pollfd_t *fds, nfds_t nfds, short *oldevt)
 	 * cached events field which was swizzled by lx_poll_copyin.
 	 */
 	for (i = 0; i < nfds; i++) {
-		short revents = pollfdp[i].revents;
-		short lx_revents = revents & LX_POLL_COMMON_EVENTS;
-		short orig_events = oldevt[i];
-
-		if (revents & POLLWRBAND)
-			lx_revents |= LX_POLLWRBAND;
-		if (revents & POLLRDHUP)
-			lx_revents |= LX_POLLRDHUP;
-		/*
-		 * Because POLLOUT and POLLWRNORM are native defined as the
-		 * same value, care must be taken when translating them to
-		 * Linux where they differ.
-		 */
-		if (revents & POLLOUT) {
-			if ((orig_events & LX_POLLOUT) == 0)
-				lx_revents &= ~LX_POLLOUT;
-			if (orig_events & LX_POLLWRNORM)
-				lx_revents |= LX_POLLWRNORM;
-		}
-
-		pollfdp[i].revents = lx_revents;
-		pollfdp[i].events = orig_events;
+		pollfdp[i].revents = lx_poll_stol_revents(pollfdp[i].revents,
+		    oldevt[i]);
+		pollfdp[i].events = oldevt[i];
 	}
 
 	if (copyout(pollfdp, fds, sizeof (pollfd_t) * nfds) != 0)
@@ -369,6 +369,15 @@ lx_xlate_sock_flags(int inflags, lx_xlate_dir_t dir)
 	return (outflags);
 }
 
+/*
+ * Translate Linux send and receive flags for io_uring SEND and RECV requests.
+ */
+int
+lx_socket_msgflags(int lx_flags)
+{
+	return (lx_xlate_sock_flags(lx_flags, LX_TO_SUNOS));
+}
+
 typedef enum lx_sun_type {
 	LX_SUN_NORMAL,
 	LX_SUN_ABSTRACT,
@@ -508,6 +508,11 @@ sonode_constructor(void *buf, void *cdrarg, int kmflags)
 	so->so_krecv_cb = NULL;
 	so->so_krecv_arg = NULL;
 
+	so->so_zc_flags = 0;
+	so->so_zc_next = 0;
+	list_create(&so->so_zc_done, sizeof (so_zc_done_t),
+	    offsetof(so_zc_done_t, szd_node));
+
 	return (0);
 }
 
@@ -535,6 +540,8 @@ sonode_destructor(void *buf, void *cdrarg)
 	ASSERT(so->so_filter_top == NULL);
 	ASSERT(so->so_filter_bottom == NULL);
 
+	list_destroy(&so->so_zc_done);
+
 	ASSERT(vp->v_data == so);
 	ASSERT(vn_matchops(vp, socket_vnodeops));
 
@@ -626,6 +633,10 @@ sonode_init(struct sonode *so, struct sockparams *sp, int family,
 
 	so->so_direct = NULL;
 
+	so->so_zc_flags = 0;
+	so->so_zc_next = 0;
+	ASSERT(list_is_empty(&so->so_zc_done));
+
 	vn_exists(vp);
 }
 
@@ -665,6 +676,9 @@ sonode_fini(struct sonode *so)
 	so->so_krecv_cb = NULL;
 	so->so_krecv_arg = NULL;
 
+	/* Discard zero-copy completions that were never collected */
+	so_zerocopy_flush(so);
+
 	ASSERT(list_is_empty(&so->so_acceptq_list));
 	ASSERT(list_is_empty(&so->so_acceptq_defer));
 	ASSERT(!list_link_active(&so->so_acceptq_node));
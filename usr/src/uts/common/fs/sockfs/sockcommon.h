@@ -215,6 +215,24 @@ extern int socket_strioc_common(struct sonode *, int, intptr_t, int,
     struct cred *, int32_t *);
 
 extern int so_zcopy_wait(struct sonode *);
+
+/* MSG_ZEROCOPY support */
+typedef struct so_zc_req so_zc_req_t;
+
+/* Entry on so_zc_done */
+typedef struct so_zc_done {
+	list_node_t		szd_node;
+	struct so_zerocopy_done	szd_range;
+} so_zc_done_t;
+
+extern void	so_zerocopy_init(void);
+extern so_zc_req_t *so_zerocopy_begin(struct sonode *);
+extern void	so_zerocopy_rele(so_zc_req_t *);
+extern boolean_t so_zerocopy_capable(struct sonode *, struct uio *,
+    struct cred *);
+extern int	so_zerocopy_sendmsg(struct sonode *, struct nmsghdr *,
+    struct uio *, struct cred *, so_zc_req_t *);
+extern void	so_zerocopy_flush(struct sonode *);
 extern int so_get_mod_version(struct sockparams *);
 
 /* Notification functions */
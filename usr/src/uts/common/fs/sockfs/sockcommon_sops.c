@@ -373,6 +373,7 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 	boolean_t dontblock;
 	ssize_t orig_resid;
 	mblk_t  *mp;
+	so_zc_req_t *szr = NULL;
 
 	SO_BLOCK_FALLBACK(so, SOP_SENDMSG(so, msg, uiop, cr));
 
@@ -396,6 +397,20 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 		return (EMSGSIZE);
 	}
 
+	/*
+	 * A MSG_ZEROCOPY send is always assigned a completion, whether or
+	 * not the data can actually be loaned to the protocol.
+	 */
+	if ((flags & MSG_ZEROCOPY) && (so->so_zc_flags & SO_ZC_ENABLED)) {
+		szr = so_zerocopy_begin(so);
+		if (so_zerocopy_capable(so, uiop, cr)) {
+			error = so_zerocopy_sendmsg(so, msg, uiop, cr, szr);
+			so_zerocopy_rele(szr);
+			SO_UNBLOCK_FALLBACK(so);
+			return (error);
+		}
+	}
+
 	/*
 	 * For atomic sends we will only do one iteration.
 	 */
@@ -476,6 +491,9 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 		}
 	} while (uiop->uio_resid > 0);
 
+	if (szr != NULL)
+		so_zerocopy_rele(szr);
+
 	SO_UNBLOCK_FALLBACK(so);
 
 	return (error);
@@ -805,6 +823,24 @@ so_setsockopt(struct sonode *so, int level, int option_name,
 
 	if (level == SOL_SOCKET) {
 		switch (option_name) {
+		case SO_ZEROCOPY:
+			/*
+			 * Handled entirely by sockfs; the protocol only sees
+			 * the resulting SO_SND_COPYAVOID request.
+			 */
+			if (optlen != (socklen_t)sizeof (int32_t)) {
+				error = EINVAL;
+			} else if (so->so_type != SOCK_STREAM) {
+				error = EOPNOTSUPP;
+			} else {
+				mutex_enter(&so->so_lock);
+				if (*(int32_t *)optval != 0)
+					so->so_zc_flags |= SO_ZC_ENABLED;
+				else
+					so->so_zc_flags &= ~SO_ZC_ENABLED;
+				mutex_exit(&so->so_lock);
+			}
+			goto done;
 		case SO_RCVTIMEO:
 		case SO_SNDTIMEO: {
 			/*
@@ -991,6 +1027,10 @@ so_poll(struct sonode *so, short events, int anyyet, short *reventsp,
 			*reventsp |= POLLHUP;
 	}
 
+	/* Zero-copy completions are reported like an error queue */
+	if (!list_is_empty(&so->so_zc_done))
+		*reventsp |= POLLERR;
+
 	if ((!*reventsp && !anyyet) || (events & POLLET)) {
 		/* Check for read events again, but this time under lock */
 		if (events & (POLLIN|POLLRDNORM)) {
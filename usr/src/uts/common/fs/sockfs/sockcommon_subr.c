@@ -40,6 +40,10 @@
 #include <sys/strsun.h>
 #include <sys/atomic.h>
 #include <sys/tihdr.h>
+#include <sys/buf.h>
+#include <sys/taskq_impl.h>
+#include <sys/disp.h>
+#include <vm/as.h>
 
 #include <fs/sockfs/sockcommon.h>
 #include <fs/sockfs/sockfilter_impl.h>
@@ -1833,6 +1837,34 @@ socket_getopt_common(struct sonode *so, int level, int option_name,
 		*optlenp = sizeof (struct so_snd_bufinfo);
 		return (0);
 	}
+	case SO_ZEROCOPY: {
+		int32_t value;
+
+		if (*optlenp < (t_uscalar_t)sizeof (int32_t))
+			return (EINVAL);
+
+		value = (so->so_zc_flags & SO_ZC_ENABLED) ? 1 : 0;
+		bcopy(&value, optval, sizeof (value));
+		*optlenp = sizeof (value);
+		return (0);
+	}
+	case SO_ZEROCOPY_DONE: {
+		so_zc_done_t *szd;
+
+		if (*optlenp < (t_uscalar_t)sizeof (struct so_zerocopy_done))
+			return (EINVAL);
+
+		mutex_enter(&so->so_lock);
+		szd = list_remove_head(&so->so_zc_done);
+		mutex_exit(&so->so_lock);
+		if (szd == NULL)
+			return (EAGAIN);
+
+		bcopy(&szd->szd_range, optval, sizeof (szd->szd_range));
+		*optlenp = sizeof (szd->szd_range);
+		kmem_free(szd, sizeof (*szd));
+		return (0);
+	}
 	case SO_SND_COPYAVOID: {
 		sof_instance_t *inst;
 
@@ -1885,6 +1917,328 @@ so_zcopy_wait(struct sonode *so)
 	return (error);
 }
 
+/*
+ * MSG_ZEROCOPY support.
+ *
+ * Each MSG_ZEROCOPY send on a socket with SO_ZEROCOPY enabled is tracked by a
+ * so_zc_req_t and assigned the next sequence number.  Where the protocol
+ * allows VM-safe loaning (see SO_SND_COPYAVOID), iovec segments of at least
+ * sock_zerocopy_min bytes are not copied: the user pages are locked with
+ * as_pagelock(), mapped with bp_mapin() and passed down as desballoca()
+ * mblks marked STRUIO_ZC, much as sendfilev(3EXT) loans segmap pages.  Smaller
+ * segments, and sends on sockets that cannot loan, are copied as usual.
+ *
+ * The sender and every loaned mblk hold a reference on the request.  The
+ * mblk free routine may be called in interrupt context, so the pages are
+ * unmapped and unlocked from sock_zcopy_taskq.  When the last reference is
+ * dropped the sequence number is posted to so_zc_done, coalesced with the
+ * previous completion where possible, and POLLERR is raised; the application
+ * collects completions with getsockopt(SO_ZEROCOPY_DONE).  A completion is
+ * flagged SO_ZEROCOPY_COPIED if no pages were loaned.
+ *
+ * A request holds the sonode's vnode, so completions remain deliverable
+ * (and so_zc_done remains valid) if the socket is closed while the protocol
+ * still references loaned pages.  Locked pages also hold off as_free(), so
+ * the address space outlives the request.
+ *
+ * Loaned pages stay locked for as long as the protocol holds the mblks,
+ * which for TCP means until the peer has acknowledged the data.  Until then
+ * munmap(2) of the buffer waits in as_unmap(), and an exiting process waits
+ * in as_free().  This is the same constraint sendfilev(3EXT) places on a
+ * file's pages, and the wait has the same bound: the data is freed once it
+ * is acknowledged, or when the connection is aborted, which for a peer that
+ * has stopped responding happens after tcp_ip_abort_interval.  Applications
+ * that need to reuse or unmap a buffer should wait for its completion.
+ */
+struct so_zc_req {
+	struct sonode	*szr_so;
+	uint32_t	szr_id;		/* sequence number */
+	uint32_t	szr_refcnt;	/* sender + loaned mblks */
+	boolean_t	szr_loaned;	/* any pages loaned */
+	so_zc_done_t	*szr_done;	/* preallocated completion */
+};
+
+typedef struct so_zc_buf {
+	so_zc_req_t	*szb_req;
+	struct as	*szb_as;
+	caddr_t		szb_uaddr;
+	size_t		szb_len;
+	struct page	**szb_pplist;	/* from as_pagelock() */
+	buf_t		szb_buf;	/* for bp_mapin() */
+	frtn_t		szb_frtn;
+	taskq_ent_t	szb_tqent;
+} so_zc_buf_t;
+
+/* Smallest iovec segment worth loaning rather than copying */
+size_t sock_zerocopy_min = 16 * 1024;
+/* Largest loan, used when the protocol has no maximum packet size */
+size_t sock_zerocopy_chunk = 256 * 1024;
+
+static taskq_t *sock_zcopy_taskq;
+
+void
+so_zerocopy_init(void)
+{
+	sock_zcopy_taskq = taskq_create("sock_zcopy_taskq", 1, minclsyspri,
+	    1, INT_MAX, TASKQ_PREPOPULATE);
+}
+
+so_zc_req_t *
+so_zerocopy_begin(struct sonode *so)
+{
+	so_zc_req_t *szr;
+
+	szr = kmem_zalloc(sizeof (*szr), KM_SLEEP);
+	szr->szr_done = kmem_zalloc(sizeof (so_zc_done_t), KM_SLEEP);
+	szr->szr_so = so;
+	szr->szr_refcnt = 1;
+	VN_HOLD(SOTOV(so));
+
+	mutex_enter(&so->so_lock);
+	szr->szr_id = so->so_zc_next++;
+	mutex_exit(&so->so_lock);
+
+	return (szr);
+}
+
+void
+so_zerocopy_rele(so_zc_req_t *szr)
+{
+	struct sonode *so = szr->szr_so;
+	so_zc_done_t *szd = szr->szr_done, *last;
+	uint32_t flags;
+
+	if (atomic_dec_32_nv(&szr->szr_refcnt) != 0)
+		return;
+
+	flags = szr->szr_loaned ? 0 : SO_ZEROCOPY_COPIED;
+
+	mutex_enter(&so->so_lock);
+	last = list_tail(&so->so_zc_done);
+	if (last != NULL && last->szd_range.szd_flags == flags &&
+	    last->szd_range.szd_last + 1 == szr->szr_id) {
+		last->szd_range.szd_last = szr->szr_id;
+	} else {
+		szd->szd_range.szd_first = szr->szr_id;
+		szd->szd_range.szd_last = szr->szr_id;
+		szd->szd_range.szd_flags = flags;
+		list_insert_tail(&so->so_zc_done, szd);
+		szd = NULL;
+	}
+	mutex_exit(&so->so_lock);
+
+	pollwakeup(&so->so_poll_list, POLLERR);
+
+	if (szd != NULL)
+		kmem_free(szd, sizeof (*szd));
+	kmem_free(szr, sizeof (*szr));
+	VN_RELE(SOTOV(so));
+}
+
+void
+so_zerocopy_flush(struct sonode *so)
+{
+	so_zc_done_t *szd;
+
+	while ((szd = list_remove_head(&so->so_zc_done)) != NULL)
+		kmem_free(szd, sizeof (*szd));
+}
+
+/*
+ * Determine whether the protocol below will accept loaned pages. As for
+ * sendfilev(3EXT), the first attempt asks the protocol to enable
+ * SO_SND_COPYAVOID; after that sopp_zcopyflag tracks its answer.
+ */
+boolean_t
+so_zerocopy_capable(struct sonode *so, struct uio *uiop, struct cred *cr)
+{
+	uint_t copyflag = so->so_proto_props.sopp_zcopyflag;
+	int on = 1;
+
+	if (uiop->uio_segflg != UIO_USERSPACE || so->so_filter_active > 0 ||
+	    so->so_downcalls->sd_send == NULL ||
+	    so->so_downcalls->sd_send_uio != NULL)
+		return (B_FALSE);
+
+	if ((copyflag & (STZCVMSAFE|STZCVMUNSAFE)) != 0)
+		return ((copyflag & STZCVMSAFE) != 0);
+
+	if (so->so_zc_flags & SO_ZC_NOLOAN)
+		return (B_FALSE);
+
+	if ((*so->so_downcalls->sd_setsockopt)(so->so_proto_handle,
+	    SOL_SOCKET, SO_SND_COPYAVOID, &on, sizeof (on), cr) == 0)
+		return (B_TRUE);
+
+	mutex_enter(&so->so_lock);
+	so->so_zc_flags |= SO_ZC_NOLOAN;
+	mutex_exit(&so->so_lock);
+	return (B_FALSE);
+}
+
+static void
+so_zerocopy_unloan(void *arg)
+{
+	so_zc_buf_t *szb = arg;
+	so_zc_req_t *szr = szb->szb_req;
+
+	bp_mapout(&szb->szb_buf);
+	as_pageunlock(szb->szb_as, szb->szb_pplist, szb->szb_uaddr,
+	    szb->szb_len, S_READ);
+	kmem_free(szb, sizeof (*szb));
+
+	so_zerocopy_rele(szr);
+}
+
+static void
+so_zerocopy_free(caddr_t arg)
+{
+	so_zc_buf_t *szb = (so_zc_buf_t *)arg;
+
+	taskq_dispatch_ent(sock_zcopy_taskq, so_zerocopy_unloan, szb, 0,
+	    &szb->szb_tqent);
+}
+
+/*
+ * Loan len bytes at the head of uiop's current iovec as a single mblk.
+ */
+static mblk_t *
+so_zerocopy_loan(so_zc_req_t *szr, struct uio *uiop, size_t len, int *errorp)
+{
+	struct as *as = curproc->p_as;
+	caddr_t uaddr = uiop->uio_iov->iov_base;
+	so_zc_buf_t *szb;
+	buf_t *bp;
+	mblk_t *mp;
+
+	szb = kmem_zalloc(sizeof (*szb), KM_SLEEP);
+	if ((*errorp = as_pagelock(as, &szb->szb_pplist, uaddr, len,
+	    S_READ)) != 0) {
+		kmem_free(szb, sizeof (*szb));
+		return (NULL);
+	}
+	szb->szb_req = szr;
+	szb->szb_as = as;
+	szb->szb_uaddr = uaddr;
+	szb->szb_len = len;
+
+	bp = &szb->szb_buf;
+	bp->b_flags = B_BUSY | B_PHYS;
+	if (szb->szb_pplist != NULL) {
+		bp->b_flags |= B_SHADOW;
+		bp->b_shadow = szb->szb_pplist;
+	}
+	bp->b_un.b_addr = uaddr;
+	bp->b_bcount = len;
+	bp->b_proc = curproc;
+	bp_mapin(bp);
+
+	szb->szb_frtn.free_func = so_zerocopy_free;
+	szb->szb_frtn.free_arg = (caddr_t)szb;
+	mp = desballoca((uchar_t *)bp->b_un.b_addr, len, BPRI_HI,
+	    &szb->szb_frtn);
+	if (mp == NULL) {
+		bp_mapout(bp);
+		as_pageunlock(as, szb->szb_pplist, uaddr, len, S_READ);
+		kmem_free(szb, sizeof (*szb));
+		*errorp = ENOMEM;
+		return (NULL);
+	}
+	mp->b_wptr += len;
+	mp->b_datap->db_struioflag |= STRUIO_ZC;
+
+	atomic_inc_32(&szr->szr_refcnt);
+	szr->szr_loaned = B_TRUE;
+	uioskip(uiop, len);
+
+	return (mp);
+}
+
+/*
+ * Send the data described by uiop, loaning large segments and copying the
+ * rest. Each message handed to the protocol is at most sopp_maxpsz bytes.
+ *
+ * Messages are built from a private copy of the uio, and uiop is only
+ * advanced by what the protocol actually accepted. A failure part way
+ * through building or sending a message therefore leaves uiop describing
+ * exactly the unsent data.
+ */
+int
+so_zerocopy_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
+    struct cred *cr, so_zc_req_t *szr)
+{
+	ssize_t maxpsz = so->so_proto_props.sopp_maxpsz;
+	int iovcnt = uiop->uio_iovcnt;
+	iovec_t *iovs;
+	uio_t uio;
+	int error = 0;
+
+	if (maxpsz <= 0)
+		maxpsz = sock_zerocopy_chunk;
+
+	iovs = kmem_alloc(iovcnt * sizeof (iovec_t), KM_SLEEP);
+	(void) uiodup(uiop, &uio, iovs, iovcnt);
+
+	while (uio.uio_resid > 0) {
+		mblk_t *head = NULL, **tail = &head, *mp;
+		ssize_t len = 0;
+
+		while (len < maxpsz && uio.uio_resid > 0) {
+			struct iovec *iov = uio.uio_iov;
+			size_t n;
+
+			if (iov->iov_len == 0) {
+				uio.uio_iov++;
+				uio.uio_iovcnt--;
+				continue;
+			}
+
+			n = MIN(iov->iov_len, (size_t)(maxpsz - len));
+			if (iov->iov_len >= sock_zerocopy_min) {
+				mp = so_zerocopy_loan(szr, &uio, n, &error);
+			} else {
+				mp = socopyinuio(&uio, n,
+				    so->so_proto_props.sopp_wroff,
+				    so->so_proto_props.sopp_maxblk,
+				    so->so_proto_props.sopp_tail, &error);
+			}
+			*tail = mp;
+			while (*tail != NULL)
+				tail = &(*tail)->b_cont;
+			if (error != 0)
+				break;
+			len += n;
+		}
+
+		if (error != 0) {
+			freemsg(head);
+			break;
+		}
+
+		mp = head;
+		error = so_sendmblk_impl(so, msg, uiop->uio_fmode, cr, &mp,
+		    so->so_filter_top, B_FALSE);
+		if (mp != NULL) {
+			/*
+			 * The protocol did not take all of the data; only
+			 * what it took is consumed from the caller's uio, and
+			 * the next message starts from there.
+			 */
+			len -= msgdsize(mp);
+			freemsg(mp);
+			uioskip(uiop, len);
+			(void) uiodup(uiop, &uio, iovs, iovcnt);
+		} else {
+			uioskip(uiop, len);
+		}
+		if (error != 0)
+			break;
+	}
+
+	kmem_free(iovs, iovcnt * sizeof (iovec_t));
+	return (error);
+}
+
 void
 so_timer_callback(void *arg)
 {
@@ -283,6 +283,7 @@ sockinit(int fstype, char *name)
 
 	mutex_init(&socklist.sl_lock, NULL, MUTEX_DEFAULT, NULL);
 	sendfile_init();
+	so_zerocopy_init();
 	if (!modrootloaded) {
 		sockfs_defer_nl7c_init = 1;
 	} else {
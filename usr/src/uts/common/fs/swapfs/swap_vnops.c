@@ -21,6 +21,7 @@
 /*
  * Copyright (c) 1991, 2010, Oracle and/or its affiliates. All rights reserved.
  * Copyright 2015 Nexenta Systems, Inc.  All rights reserved.
+ * Copyright 2026 Joyent, Inc.
  */
 
 #include <sys/types.h>
@@ -212,8 +213,8 @@ again:
 		}
 	} else {
 		pp = page_create_va(vp, off, PAGESIZE,
-		    PG_WAIT | PG_EXCL | flag_noreloc,
-		    seg, addr);
+		    PG_WAIT | PG_EXCL | flag_noreloc |
+		    (rw == S_CREATE ? PG_ZERO : 0), seg, addr);
 		/*
 		 * Someone raced in and created the page after we did the
 		 * lookup but before we did the create, so go back and
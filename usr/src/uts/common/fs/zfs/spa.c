@@ -137,7 +137,10 @@ static const char *const zio_taskq_types[ZIO_TASKQ_TYPES] = {
  * point of lock contention. The ZTI_P(#, #) macro indicates that we need an
  * additional degree of parallelism specified by the number of threads per-
  * taskq and the number of taskqs; when dispatching an event in this case, the
- * particular taskq is chosen at random.
+ * particular taskq is chosen at random.  When zio_taskq_percpu is set, the
+ * taskqs are instead created with per-CPU queues (TASKQ_PERCPU), which
+ * removes that contention, so a single taskq with all of the threads is
+ * created in place of several.
  *
  * The different taskq priorities are to handle the different contexts (issue
  * and interrupt) and then to reserve threads for ZIO_PRIORITY_NOW I/Os that
@@ -163,6 +166,7 @@ static void spa_vdev_resilver_done(spa_t *spa);
 uint_t		zio_taskq_batch_pct = 75;	/* 1 thread per cpu in pset */
 id_t		zio_taskq_psrset_bind = PS_NONE;
 boolean_t	zio_taskq_sysdc = B_TRUE;	/* use SDC scheduling class */
+boolean_t	zio_taskq_percpu = B_FALSE;	/* use per-CPU queues */
 uint_t		zio_taskq_basedc = 80;		/* base duty cycle */
 
 boolean_t	spa_create_process = B_TRUE;	/* no process ==> no sysdc */
@@ -961,6 +965,14 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 
 	ASSERT3U(count, >, 0);
 
+	if (zio_taskq_percpu) {
+		flags |= TASKQ_PERCPU;
+		if (mode == ZTI_MODE_FIXED) {
+			value *= count;
+			count = 1;
+		}
+	}
+
 	tqs->stqs_count = count;
 	tqs->stqs_taskq = kmem_alloc(count * sizeof (taskq_t *), KM_SLEEP);
 
@@ -1040,8 +1052,9 @@ spa_taskqs_fini(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 /*
  * Dispatch a task to the appropriate taskq for the ZFS I/O type and priority.
  * Note that a type may have multiple discrete taskqs to avoid lock contention
- * on the taskq itself. In that case we choose which taskq at random by using
- * the low bits of gethrtime().
+ * on the taskq itself (only when zio_taskq_percpu was clear when the pool was
+ * activated). In that case we choose which taskq at random by using the low
+ * bits of gethrtime().
  */
 void
 spa_taskq_dispatch_ent(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
@@ -82,6 +82,34 @@
  * counter on the connection found (if any). This reference should be dropped
  * when the caller has finished processing the connection.
  *
+ * Lookup Concurrency:
+ * -------------------
+ *
+ * The SYN for a new TCP connection misses in ipcl_conn_fanout before
+ * finding its listener in ipcl_bind_fanout; the eager created for it is
+ * inserted into the conn fanout at that point, so the ACK that completes the
+ * handshake and everything after it are found there. With the table sized
+ * to memory most conn fanout buckets are empty, so the classify functions
+ * test connf_head without the bucket lock and skip straight to the bind
+ * fanout when it is NULL. Incoming SYNs therefore do not bounce the lock's
+ * cache line between CPUs. This is no weaker than the locked lookup: a
+ * conn_t is hashed before any segment that could match it is sent, and a
+ * segment racing with the insertion could equally have been classified just
+ * before the bucket lock was taken. A non-empty bucket is always searched
+ * under its lock, since walking the chain requires it.
+ *
+ * No membar_producer()/membar_consumer() pair is needed for the unlocked
+ * test. The reader dereferences nothing through the value it loads: a
+ * non-NULL head only sends it to mutex_enter(), which orders the walk
+ * against the insertion. And it cannot see a NULL older than an insertion
+ * that the segment depends on, since the insertion is published by the
+ * bucket's mutex_exit() before the reply that provokes the segment is sent,
+ * and the segment reaches this CPU through driver and squeue locks that
+ * order the load after it.
+ *
+ * Similarly, ipcl_globalhash_insert() chooses a global list from the
+ * conn_t address and the current CPU instead of a shared counter.
+ *
  *
  * INTERFACES:
  * ===========
@@ -1574,6 +1602,12 @@ ipcl_classify_v4(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		connfp =
 		    &ipst->ips_ipcl_conn_fanout[IPCL_CONN_HASH(ipha->ipha_src,
 		    ports, ipst)];
+		/*
+		 * Check for an empty bucket without the lock; see
+		 * "Lookup Concurrency" above.
+		 */
+		if (connfp->connf_head == NULL)
+			goto bind_lookup;
 		mutex_enter(&connfp->connf_lock);
 		for (connp = connfp->connf_head; connp != NULL;
 		    connp = connp->conn_next) {
@@ -1601,6 +1635,8 @@ ipcl_classify_v4(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		}
 
 		mutex_exit(&connfp->connf_lock);
+
+bind_lookup:
 		lport = up[1];
 		bind_connfp =
 		    &ipst->ips_ipcl_bind_fanout[IPCL_BIND_HASH(lport, ipst)];
@@ -1717,6 +1753,12 @@ ipcl_classify_v6(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		connfp =
 		    &ipst->ips_ipcl_conn_fanout[IPCL_CONN_HASH_V6(ip6h->ip6_src,
 		    ports, ipst)];
+		/*
+		 * Check for an empty bucket without the lock; see
+		 * "Lookup Concurrency" above.
+		 */
+		if (connfp->connf_head == NULL)
+			goto bind_lookup;
 		mutex_enter(&connfp->connf_lock);
 		for (connp = connfp->connf_head; connp != NULL;
 		    connp = connp->conn_next) {
@@ -1745,6 +1787,7 @@ ipcl_classify_v6(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 
 		mutex_exit(&connfp->connf_lock);
 
+bind_lookup:
 		lport = up[1];
 		bind_connfp =
 		    &ipst->ips_ipcl_bind_fanout[IPCL_BIND_HASH(lport, ipst)];
@@ -2291,11 +2334,11 @@ ipcl_globalhash_insert(conn_t *connp)
 	ip_stack_t	*ipst = connp->conn_netstack->netstack_ip;
 
 	/*
-	 * No need for atomic here. Approximate even distribution
-	 * in the global lists is sufficient.
+	 * Approximate even distribution in the global lists is sufficient;
+	 * avoid a counter shared by every CPU creating connections.
 	 */
-	ipst->ips_conn_g_index++;
-	index = ipst->ips_conn_g_index & (CONN_G_HASH_SIZE - 1);
+	index = (((uintptr_t)connp >> 8) ^ CPU->cpu_seqid) &
+	    (CONN_G_HASH_SIZE - 1);
 
 	connp->conn_g_prev = NULL;
 	/*
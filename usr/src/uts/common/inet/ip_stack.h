@@ -205,7 +205,6 @@ struct ip_stack {
 	uint_t		ips_ipcl_raw_fanout_size;
 	uint_t		ips_ipcl_iptun_fanout_size;
 	struct connf_s	*ips_ipcl_globalhash_fanout;
-	int		ips_conn_g_index;
 
 /* ip.c */
 	/* Following protected by igmp_timer_lock */
@@ -138,6 +138,7 @@ tcp_timeout(conn_t *connp, void (*f)(void *), hrtime_t tim)
 	mblk_t *mp;
 	tcp_timer_t *tcpt;
 	tcp_t *tcp = connp->conn_tcp;
+	hrtime_t slack;
 
 	ASSERT(connp->conn_sqp != NULL);
 
@@ -164,9 +165,22 @@ tcp_timeout(conn_t *connp, void (*f)(void *), hrtime_t tim)
 	 * batch timers in the callout subsystem to make TCP timers more
 	 * efficient. The roundup also protects short timers from expiring too
 	 * early before they have a chance to be cancelled.
+	 *
+	 * Long timers (keepalive, TIME_WAIT and the like) can tolerate more:
+	 * when the callout timer wheel is in use we allow them to run up to
+	 * 1/256th of their interval late, which lets the wheel coalesce them.
+	 * The heap would just round them up to that coarser boundary.
 	 */
-	tcpt->tcpt_tid = timeout_generic(CALLOUT_NORMAL, tcp_timer_callback, mp,
-	    tim * MICROSEC, CALLOUT_TCP_RESOLUTION, CALLOUT_FLAG_ROUNDUP);
+	if (callout_wheel_enabled) {
+		slack = MAX(CALLOUT_TCP_RESOLUTION, (tim * MICROSEC) >> 8);
+		tcpt->tcpt_tid = timeout_generic(CALLOUT_NORMAL,
+		    tcp_timer_callback, mp, tim * MICROSEC, slack,
+		    CALLOUT_FLAG_SLACK);
+	} else {
+		tcpt->tcpt_tid = timeout_generic(CALLOUT_NORMAL,
+		    tcp_timer_callback, mp, tim * MICROSEC,
+		    CALLOUT_TCP_RESOLUTION, CALLOUT_FLAG_ROUNDUP);
+	}
 	VERIFY(!(tcpt->tcpt_tid & CALLOUT_ID_FREE));
 
 	return ((timeout_id_t)mp);
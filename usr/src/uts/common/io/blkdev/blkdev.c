@@ -49,6 +49,7 @@
 #include <sys/vtoc.h>
 #include <sys/scsi/scsi.h>	/* for DTYPE_DIRECT */
 #include <sys/kstat.h>
+#include <sys/cpuvar.h>
 #include <sys/fs/dv_node.h>
 #include <sys/ddi.h>
 #include <sys/sunddi.h>
@@ -107,10 +108,11 @@
  * parent driver supports multiple hardware queues it can then select
  * where to submit the I/O request.
  *
- * Currently blkdev uses a simplistic round-robin queue selection method.
- * It has the advantage that it is lockless. In the future it will be
- * worthwhile reviewing this strategy for something which prioritizes queues
- * depending on how busy they are.
+ * By default blkdev selects the queue by the sequential ID of the submitting
+ * CPU, so that each CPU keeps using the same waitq/runq pair, and with it
+ * the same hardware queue of the parent driver. With enough queues, no two
+ * CPUs share a queue, its lock, or its cache lines. Setting the tunable
+ * bd_queue_affinity to 0 selects the old round-robin method instead.
  *
  * Each waitq/runq pair is protected by its mutex (q_iomutex). Incoming
  * I/O requests are initially added to the waitq. They are taken off the
@@ -120,6 +122,14 @@
  * will remove the I/O request from the runq and pass I/O completion
  * status up the stack.
  *
+ * The I/O statistics are kept per queue, under q_iomutex, and are only
+ * summed up into the per-device disk kstat when that is read. Busy time
+ * can't be summed meaningfully across queues that run in parallel, so the
+ * busy time of the busiest queue is reported. Each queue also has a named
+ * kstat (queue<N>) which shows how well the CPU affinity works, including
+ * the number of completions that happen on a different CPU than the one
+ * that submitted the I/O.
+ *
  * Locks
  * -----
  * There are 4 instance global locks d_ocmutex, d_ksmutex, d_errmutex and
@@ -127,8 +137,9 @@
  *
  * Lock Hierarchy
  * --------------
- * The only two locks which may be held simultaneously are q_iomutex and
- * d_ksmutex. In all cases q_iomutex must be acquired before d_ksmutex.
+ * The only two locks which may be held simultaneously are d_ksmutex and
+ * q_iomutex, while the disk kstat is updated. In all cases d_ksmutex must
+ * be acquired before q_iomutex.
  */
 
 #define	BD_MAXPART	64
@@ -152,7 +163,7 @@ struct bd {
 	unsigned	d_open_lyr[BD_MAXPART];	/* open count */
 	uint64_t	d_open_excl;	/* bit mask indexed by partition */
 	uint64_t	d_open_reg[OTYPCNT];		/* bit mask */
-	uint64_t	d_io_counter;
+	uint64_t	d_io_counter;		/* for round-robin queueing */
 
 	uint32_t	d_qcount;
 	uint32_t	d_qactive;
@@ -170,7 +181,7 @@ struct bd {
 	kmem_cache_t	*d_cache;
 	bd_queue_t	*d_queues;
 	kstat_t		*d_ksp;
-	kstat_io_t	*d_kiop;
+	kstat_io_t	d_kbase;	/* persistent disk kstat at attach */
 	kstat_t		*d_errstats;
 	struct bd_errstats *d_kerr;
 
@@ -209,15 +220,29 @@ struct bd_xfer_impl {
 	uint32_t	i_blkshift;
 	size_t		i_len;
 	size_t		i_resid;
+	uint_t		i_cpu;		/* seqid of the submitting CPU */
+};
+
+struct bd_qstats {
+	kstat_named_t	qs_submits;
+	kstat_named_t	qs_remote_done;	/* completed on another CPU */
+	kstat_named_t	qs_max_active;	/* high-water mark of q_qactive */
 };
 
+/*
+ * Queues are aligned to a cache line so that CPUs using different queues
+ * don't share any.
+ */
 struct bd_queue {
 	kmutex_t	q_iomutex;
 	uint32_t	q_qsize;
 	uint32_t	q_qactive;
 	list_t		q_runq;
 	list_t		q_waitq;
-};
+	kstat_io_t	q_kstat;	/* summed up into d_ksp */
+	kstat_t		*q_ksp;
+	struct bd_qstats q_stats;
+} __aligned(64);
 
 #define	i_dmah		i_public.x_dmah
 #define	i_dmac		i_public.x_dmac
@@ -268,6 +293,7 @@ static void bd_xfer_dtor(void *, void *);
 static void bd_sched(bd_t *, bd_queue_t *);
 static void bd_submit(bd_t *, bd_xfer_impl_t *);
 static void bd_runq_exit(bd_xfer_impl_t *, int);
+static int bd_kstat_update(kstat_t *, int);
 static void bd_update_state(bd_t *);
 static int bd_check_state(bd_t *, enum dkio_state *);
 static int bd_flush_write_cache(bd_t *, struct dk_callback *);
@@ -329,6 +355,9 @@ static struct modlinkage modlinkage = {
 static void *bd_state;
 static krwlock_t bd_lock;
 
+/* tunable to select queues by CPU (1) or round-robin (0) */
+int bd_queue_affinity = 1;
+
 int
 _init(void)
 {
@@ -603,6 +632,8 @@ bd_queues_free(bd_t *bd)
 	for (i = 0; i < bd->d_qcount; i++) {
 		bd_queue_t *bq = &bd->d_queues[i];
 
+		if (bq->q_ksp != NULL)
+			kstat_delete(bq->q_ksp);
 		mutex_destroy(&bq->q_iomutex);
 		list_destroy(&bq->q_waitq);
 		list_destroy(&bq->q_runq);
@@ -700,20 +731,18 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	bd->d_cache = kmem_cache_create(kcache, sizeof (bd_xfer_impl_t), 8,
 	    bd_xfer_ctor, bd_xfer_dtor, NULL, bd, NULL, 0);
 
+	/*
+	 * The disk kstat is installed once the queues whose statistics it
+	 * sums up exist. A persistent kstat may still hold the statistics
+	 * of a previous attach, which we keep adding to.
+	 */
 	bd->d_ksp = kstat_create(ddi_driver_name(dip), inst, NULL, "disk",
 	    KSTAT_TYPE_IO, 1, KSTAT_FLAG_PERSISTENT);
 	if (bd->d_ksp != NULL) {
 		bd->d_ksp->ks_lock = &bd->d_ksmutex;
-		kstat_install(bd->d_ksp);
-		bd->d_kiop = bd->d_ksp->ks_data;
-	} else {
-		/*
-		 * Even if we cannot create the kstat, we create a
-		 * scratch kstat.  The reason for this is to ensure
-		 * that we can update the kstat all of the time,
-		 * without adding an extra branch instruction.
-		 */
-		bd->d_kiop = kmem_zalloc(sizeof (kstat_io_t), KM_SLEEP);
+		bd->d_ksp->ks_update = bd_kstat_update;
+		bd->d_ksp->ks_private = bd;
+		bd->d_kbase = *KSTAT_IO_PTR(bd->d_ksp);
 	}
 
 	cmlb_alloc_handle(&bd->d_cmlbh);
@@ -778,10 +807,16 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	bd_create_errstats(bd, inst, &drive);
 	bd_update_state(bd);
 
-	bd->d_queues = kmem_alloc(sizeof (*bd->d_queues) * bd->d_qcount,
+	/*
+	 * The size of the array is a multiple of 64, which kmem_alloc()
+	 * aligns to 64 bytes as well.
+	 */
+	bd->d_queues = kmem_zalloc(sizeof (*bd->d_queues) * bd->d_qcount,
 	    KM_SLEEP);
 	for (i = 0; i < bd->d_qcount; i++) {
 		bd_queue_t *bq = &bd->d_queues[i];
+		struct bd_qstats *qs = &bq->q_stats;
+		char qname[KSTAT_STRLEN];
 
 		bq->q_qsize = drive.d_qsize;
 		bq->q_qactive = 0;
@@ -791,8 +826,27 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 		    offsetof(struct bd_xfer_impl, i_linkage));
 		list_create(&bq->q_runq, sizeof (bd_xfer_impl_t),
 		    offsetof(struct bd_xfer_impl, i_linkage));
+
+		(void) snprintf(qname, sizeof (qname), "queue%u", i);
+		bq->q_ksp = kstat_create(ddi_driver_name(dip), inst, qname,
+		    "misc", KSTAT_TYPE_NAMED,
+		    sizeof (*qs) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+		if (bq->q_ksp != NULL) {
+			kstat_named_init(&qs->qs_submits, "submits",
+			    KSTAT_DATA_UINT64);
+			kstat_named_init(&qs->qs_remote_done,
+			    "remote_completions", KSTAT_DATA_UINT64);
+			kstat_named_init(&qs->qs_max_active, "max_active",
+			    KSTAT_DATA_UINT32);
+			bq->q_ksp->ks_data = qs;
+			bq->q_ksp->ks_lock = &bq->q_iomutex;
+			kstat_install(bq->q_ksp);
+		}
 	}
 
+	if (bd->d_ksp != NULL)
+		kstat_install(bd->d_ksp);
+
 	rv = cmlb_attach(dip, &bd_tg_ops, DTYPE_DIRECT,
 	    bd->d_removable, bd->d_hotpluggable,
 	    /*LINTED: E_BAD_PTR_CAST_ALIGN*/
@@ -835,6 +889,10 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	return (DDI_SUCCESS);
 
 fail_cmlb_attach:
+	if (bd->d_ksp != NULL) {
+		kstat_delete(bd->d_ksp);
+		bd->d_ksp = NULL;
+	}
 	bd_queues_free(bd);
 	bd_destroy_errstats(bd);
 
@@ -844,8 +902,6 @@ fail_drive_info:
 	if (bd->d_ksp != NULL) {
 		kstat_delete(bd->d_ksp);
 		bd->d_ksp = NULL;
-	} else {
-		kmem_free(bd->d_kiop, sizeof (kstat_io_t));
 	}
 
 	kmem_cache_destroy(bd->d_cache);
@@ -875,10 +931,12 @@ bd_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 	}
 
 	if (bd->d_ksp != NULL) {
+		/* Bring the persistent statistics up to date first. */
+		mutex_enter(&bd->d_ksmutex);
+		(void) bd_kstat_update(bd->d_ksp, KSTAT_READ);
+		mutex_exit(&bd->d_ksmutex);
 		kstat_delete(bd->d_ksp);
 		bd->d_ksp = NULL;
-	} else {
-		kmem_free(bd->d_kiop, sizeof (kstat_io_t));
 	}
 
 	bd_destroy_errstats(bd);
@@ -1463,6 +1521,13 @@ bd_strategy(struct buf *bp)
 	}
 	xi->i_blkno = lblkno + p_lba;
 
+	/*
+	 * Someone is waiting for a synchronous read, so let the driver know
+	 * that its latency matters more than that of other I/O.
+	 */
+	xi->i_flags = (bp->b_flags & (B_READ | B_ASYNC)) == B_READ ?
+	    BD_XFER_HIPRI : 0;
+
 	bd_submit(bd, xi);
 
 	return (0);
@@ -1795,11 +1860,11 @@ bd_sched(bd_t *bd, bd_queue_t *bq)
 
 	while ((bq->q_qactive < bq->q_qsize) &&
 	    ((xi = list_remove_head(&bq->q_waitq)) != NULL)) {
-		mutex_enter(&bd->d_ksmutex);
-		kstat_waitq_to_runq(bd->d_kiop);
-		mutex_exit(&bd->d_ksmutex);
+		kstat_waitq_to_runq(&bq->q_kstat);
 
 		bq->q_qactive++;
+		if (bq->q_qactive > bq->q_stats.qs_max_active.value.ui32)
+			bq->q_stats.qs_max_active.value.ui32 = bq->q_qactive;
 		list_insert_tail(&bq->q_runq, xi);
 
 		/*
@@ -1820,9 +1885,7 @@ bd_sched(bd_t *bd, bd_queue_t *bq)
 
 			mutex_enter(&bq->q_iomutex);
 
-			mutex_enter(&bd->d_ksmutex);
-			kstat_runq_exit(bd->d_kiop);
-			mutex_exit(&bd->d_ksmutex);
+			kstat_runq_exit(&bq->q_kstat);
 
 			bq->q_qactive--;
 			list_remove(&bq->q_runq, xi);
@@ -1838,20 +1901,25 @@ bd_sched(bd_t *bd, bd_queue_t *bq)
 static void
 bd_submit(bd_t *bd, bd_xfer_impl_t *xi)
 {
-	uint64_t	nv = atomic_inc_64_nv(&bd->d_io_counter);
-	unsigned	q = nv % bd->d_qcount;
-	bd_queue_t	*bq = &bd->d_queues[q];
+	uint_t		cpu = CPU->cpu_seqid;
+	unsigned	q;
+	bd_queue_t	*bq;
+
+	if (bd_queue_affinity)
+		q = cpu % bd->d_qcount;
+	else
+		q = atomic_inc_64_nv(&bd->d_io_counter) % bd->d_qcount;
+	bq = &bd->d_queues[q];
 
 	xi->i_bq = bq;
 	xi->i_qnum = q;
+	xi->i_cpu = cpu;
 
 	mutex_enter(&bq->q_iomutex);
 
 	list_insert_tail(&bq->q_waitq, xi);
-
-	mutex_enter(&bd->d_ksmutex);
-	kstat_waitq_enter(bd->d_kiop);
-	mutex_exit(&bd->d_ksmutex);
+	kstat_waitq_enter(&bq->q_kstat);
+	bq->q_stats.qs_submits.value.ui64++;
 
 	mutex_exit(&bq->q_iomutex);
 
@@ -1868,27 +1936,62 @@ bd_runq_exit(bd_xfer_impl_t *xi, int err)
 	mutex_enter(&bq->q_iomutex);
 	bq->q_qactive--;
 
-	mutex_enter(&bd->d_ksmutex);
-	kstat_runq_exit(bd->d_kiop);
-	mutex_exit(&bd->d_ksmutex);
-
-	list_remove(&bq->q_runq, xi);
-	mutex_exit(&bq->q_iomutex);
-
+	kstat_runq_exit(&bq->q_kstat);
 	if (err == 0) {
 		if (bp->b_flags & B_READ) {
-			atomic_inc_uint(&bd->d_kiop->reads);
-			atomic_add_64((uint64_t *)&bd->d_kiop->nread,
-			    bp->b_bcount - xi->i_resid);
+			bq->q_kstat.reads++;
+			bq->q_kstat.nread += bp->b_bcount - xi->i_resid;
 		} else {
-			atomic_inc_uint(&bd->d_kiop->writes);
-			atomic_add_64((uint64_t *)&bd->d_kiop->nwritten,
-			    bp->b_bcount - xi->i_resid);
+			bq->q_kstat.writes++;
+			bq->q_kstat.nwritten += bp->b_bcount - xi->i_resid;
 		}
 	}
+	if (CPU->cpu_seqid != xi->i_cpu)
+		bq->q_stats.qs_remote_done.value.ui64++;
+
+	list_remove(&bq->q_runq, xi);
+	mutex_exit(&bq->q_iomutex);
+
 	bd_sched(bd, bq);
 }
 
+/*
+ * Sum up the I/O statistics of all queues into the disk kstat.
+ */
+static int
+bd_kstat_update(kstat_t *ksp, int rw)
+{
+	bd_t		*bd = ksp->ks_private;
+	kstat_io_t	*kio = KSTAT_IO_PTR(ksp);
+	uint32_t	i;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	*kio = bd->d_kbase;
+	for (i = 0; i < bd->d_qcount; i++) {
+		bd_queue_t	*bq = &bd->d_queues[i];
+		kstat_io_t	*qio = &bq->q_kstat;
+
+		mutex_enter(&bq->q_iomutex);
+		kio->nread += qio->nread;
+		kio->nwritten += qio->nwritten;
+		kio->reads += qio->reads;
+		kio->writes += qio->writes;
+		kio->wlentime += qio->wlentime;
+		kio->rlentime += qio->rlentime;
+		kio->wcnt += qio->wcnt;
+		kio->rcnt += qio->rcnt;
+		kio->wtime = MAX(kio->wtime, bd->d_kbase.wtime + qio->wtime);
+		kio->rtime = MAX(kio->rtime, bd->d_kbase.rtime + qio->rtime);
+		kio->wlastupdate = MAX(kio->wlastupdate, qio->wlastupdate);
+		kio->rlastupdate = MAX(kio->rlastupdate, qio->rlastupdate);
+		mutex_exit(&bq->q_iomutex);
+	}
+
+	return (0);
+}
+
 static void
 bd_update_state(bd_t *bd)
 {
@@ -119,6 +119,15 @@ kmem_cache_t	*iscsit_status_pdu_cache;
 
 boolean_t	iscsit_sm_logging = B_FALSE;
 
+/*
+ * iscsit_zcopy allows the LU to hand us its own buffers (for sbd, loaned
+ * ARC buffers of a zvol) to transfer from and to, rather than copying
+ * through buffers of ours.  Transfers smaller than iscsit_zcopy_threshold
+ * are cheaper to copy than to set up that way.  It is off by default.
+ */
+boolean_t	iscsit_zcopy = B_FALSE;
+uint32_t	iscsit_zcopy_threshold = 16 * 1024;
+
 kmutex_t	login_sm_session_mutex;
 
 static idm_status_t iscsit_init(dev_info_t *dip);
@@ -200,6 +209,15 @@ iscsit_dbuf_alloc(scsi_task_t *task, uint32_t size, uint32_t *pminsize,
 static void
 iscsit_dbuf_free(stmf_dbuf_store_t *ds, stmf_data_buf_t *dbuf);
 
+static stmf_status_t
+iscsit_dbuf_setup(scsi_task_t *task, stmf_data_buf_t *dbuf, uint32_t flags);
+
+static void
+iscsit_dbuf_teardown(stmf_dbuf_store_t *ds, stmf_data_buf_t *dbuf);
+
+static idm_status_t
+iscsit_lu_dbuf_xfer(iscsit_task_t *itask, stmf_data_buf_t *dbuf);
+
 static void
 iscsit_buf_xfer_cb(idm_buf_t *idb, idm_status_t status);
 
@@ -707,6 +725,8 @@ iscsit_enable_svc(iscsit_hostinfo_t *hostinfo)
 	}
 	dbuf_store->ds_alloc_data_buf = iscsit_dbuf_alloc;
 	dbuf_store->ds_free_data_buf = iscsit_dbuf_free;
+	dbuf_store->ds_setup_dbuf = iscsit_dbuf_setup;
+	dbuf_store->ds_teardown_dbuf = iscsit_dbuf_teardown;
 	dbuf_store->ds_port_private = NULL;
 	iscsit_global.global_dbuf_store = dbuf_store;
 
@@ -1525,6 +1545,107 @@ iscsit_dbuf_free(stmf_dbuf_store_t *ds, stmf_data_buf_t *dbuf)
 	}
 }
 
+static void
+iscsit_lu_ibuf_free(iscsit_buf_t *ibuf, uint_t nbufs)
+{
+	while (nbufs > 0)
+		idm_buf_free(ibuf->ibuf_lu_bufs[--nbufs]);
+	kmem_free(ibuf, sizeof (iscsit_buf_t) +
+	    ibuf->ibuf_lu_nbufs * sizeof (idm_buf_t *));
+}
+
+/*
+ * Prepare a buffer belonging to the LU for transfer on the task's
+ * connection.  Each segment is registered with the transport as it stands;
+ * the data is never copied.
+ */
+/*ARGSUSED*/
+static stmf_status_t
+iscsit_dbuf_setup(scsi_task_t *task, stmf_data_buf_t *dbuf, uint32_t flags)
+{
+	iscsit_task_t *itask = task->task_port_private;
+	idm_conn_t *ic = itask->it_ict->ict_ic;
+	uint_t nbufs = dbuf->db_sglist_length;
+	iscsit_buf_t *ibuf;
+	uint_t i;
+
+	ASSERT(dbuf->db_flags & DB_LU_DATA_BUF);
+
+	/*
+	 * A transfer of more than MaxBurstLength would need more than one
+	 * R2T or Data-In sequence per segment; task_max_xfer_len keeps sbd
+	 * from asking for one.
+	 */
+	if (nbufs == 0 ||
+	    dbuf->db_data_size > itask->it_ict->ict_op.op_max_burst_length)
+		return (STMF_FAILURE);
+
+	ibuf = kmem_zalloc(sizeof (iscsit_buf_t) +
+	    nbufs * sizeof (idm_buf_t *), KM_NOSLEEP);
+	if (ibuf == NULL)
+		return (STMF_FAILURE);
+	ibuf->ibuf_stmf_buf = dbuf;
+	ibuf->ibuf_is_immed = B_FALSE;
+	ibuf->ibuf_lu_bufs = (idm_buf_t **)(ibuf + 1);
+	ibuf->ibuf_lu_nbufs = (uint16_t)nbufs;
+
+	for (i = 0; i < nbufs; i++) {
+		ibuf->ibuf_lu_bufs[i] = idm_buf_alloc(ic,
+		    dbuf->db_sglist[i].seg_addr, dbuf->db_sglist[i].seg_length);
+		if (ibuf->ibuf_lu_bufs[i] == NULL) {
+			iscsit_lu_ibuf_free(ibuf, i);
+			return (STMF_FAILURE);
+		}
+	}
+
+	dbuf->db_port_private = ibuf;
+	return (STMF_SUCCESS);
+}
+
+/*ARGSUSED*/
+static void
+iscsit_dbuf_teardown(stmf_dbuf_store_t *ds, stmf_data_buf_t *dbuf)
+{
+	iscsit_buf_t *ibuf = dbuf->db_port_private;
+
+	ASSERT(dbuf->db_flags & DB_LU_DATA_BUF);
+
+	dbuf->db_port_private = NULL;
+	iscsit_lu_ibuf_free(ibuf, ibuf->ibuf_lu_nbufs);
+}
+
+/*
+ * Start the transfer of the current segment of an LU buffer; the next is
+ * started from iscsit_buf_xfer_cb when it completes.  Going one segment at a
+ * time keeps a write to one R2T outstanding per buffer, as task_max_nbufs
+ * assumes, and lets the status be collapsed into the final Data-In PDU of
+ * the last segment.  The caller holds ist_sn_mutex.
+ */
+static idm_status_t
+iscsit_lu_dbuf_xfer(iscsit_task_t *itask, stmf_data_buf_t *dbuf)
+{
+	iscsit_buf_t *ibuf = dbuf->db_port_private;
+	idm_buf_t *idb = ibuf->ibuf_lu_bufs[ibuf->ibuf_lu_cur];
+	uint32_t resid, len;
+
+	ASSERT(MUTEX_HELD(&itask->it_ict->ict_sess->ist_sn_mutex));
+
+	resid = dbuf->db_relative_offset + dbuf->db_data_size -
+	    ibuf->ibuf_lu_off;
+	len = MIN(idb->idb_buflen, resid);
+
+	if (dbuf->db_flags & DB_DIRECTION_TO_RPORT) {
+		if (len == resid && (dbuf->db_flags & DB_SEND_STATUS_GOOD))
+			itask->it_idm_task->idt_flags |=
+			    IDM_TASK_PHASECOLLAPSE_REQ;
+		return (idm_buf_tx_to_ini(itask->it_idm_task, idb,
+		    ibuf->ibuf_lu_off, len, &iscsit_buf_xfer_cb, dbuf));
+	}
+
+	return (idm_buf_rx_from_ini(itask->it_idm_task, idb,
+	    ibuf->ibuf_lu_off, len, &iscsit_buf_xfer_cb, dbuf));
+}
+
 /*ARGSUSED*/
 stmf_status_t
 iscsit_xfer_scsi_data(scsi_task_t *task, stmf_data_buf_t *dbuf,
@@ -1542,6 +1663,16 @@ iscsit_xfer_scsi_data(scsi_task_t *task, stmf_data_buf_t *dbuf,
 		return (STMF_SUCCESS);
 	}
 
+	if (dbuf->db_flags & DB_LU_DATA_BUF) {
+		ibuf->ibuf_lu_cur = 0;
+		ibuf->ibuf_lu_off = dbuf->db_relative_offset;
+		mutex_enter(&ict_sess->ist_sn_mutex);
+		idm_rc = iscsit_lu_dbuf_xfer(iscsit_task, dbuf);
+		mutex_exit(&ict_sess->ist_sn_mutex);
+
+		return (iscsit_idm_to_stmf(idm_rc));
+	}
+
 	/*
 	 * If it's not immediate data then start the transfer
 	 */
@@ -1591,6 +1722,26 @@ iscsit_buf_xfer_cb(idm_buf_t *idb, idm_status_t status)
 {
 	iscsit_task_t *itask = idb->idb_task_binding->idt_private;
 	stmf_data_buf_t *dbuf = idb->idb_cb_arg;
+	iscsit_buf_t *ibuf = dbuf->db_port_private;
+
+	/*
+	 * Move on to the next segment of an LU buffer, if there is one.
+	 */
+	if ((dbuf->db_flags & DB_LU_DATA_BUF) &&
+	    status == IDM_STATUS_SUCCESS && !itask->it_stmf_abort) {
+		ibuf->ibuf_lu_off += idb->idb_xfer_len;
+		if (ibuf->ibuf_lu_off <
+		    dbuf->db_relative_offset + dbuf->db_data_size) {
+			iscsit_sess_t *ist = itask->it_ict->ict_sess;
+
+			ibuf->ibuf_lu_cur++;
+			mutex_enter(&ist->ist_sn_mutex);
+			status = iscsit_lu_dbuf_xfer(itask, dbuf);
+			mutex_exit(&ist->ist_sn_mutex);
+			if (status == IDM_STATUS_SUCCESS)
+				return;
+		}
+	}
 
 	dbuf->db_xfer_status = iscsit_idm_to_stmf(status);
 
@@ -2118,6 +2269,11 @@ iscsit_post_scsi_cmd(idm_conn_t *ic, idm_pdu_t *rx_pdu)
 
 
 	task->task_additional_flags = 0;
+	if (iscsit_zcopy) {
+		task->task_additional_flags |= TASK_AF_ACCEPT_LU_DBUF;
+		task->task_copy_threshold = iscsit_zcopy_threshold;
+		task->task_max_xfer_len = ict->ict_op.op_max_burst_length;
+	}
 	task->task_priority = 0;
 	task->task_mgmt_function = TM_NONE;
 
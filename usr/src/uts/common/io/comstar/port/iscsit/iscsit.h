@@ -513,11 +513,22 @@ typedef struct iscsit_conn_s {
 
 #define	ICT_FLAGS_DISCOVERY	0x00000001
 
+/*
+ * A buffer handed to us by the LU (DB_LU_DATA_BUF) is described by a
+ * scatter/gather list rather than a single allocation, so each of its
+ * segments gets an idm_buf_t of its own in ibuf_lu_bufs.  The segments are
+ * transferred one after another; ibuf_lu_cur is the one in flight and
+ * ibuf_lu_off its offset within the command.
+ */
 typedef struct {
 	idm_buf_t		*ibuf_idm_buf;
 	stmf_data_buf_t		*ibuf_stmf_buf;
 	idm_pdu_t		*ibuf_immed_data_pdu;
 	boolean_t		ibuf_is_immed;
+	idm_buf_t		**ibuf_lu_bufs;
+	uint16_t		ibuf_lu_nbufs;
+	uint16_t		ibuf_lu_cur;
+	uint32_t		ibuf_lu_off;
 } iscsit_buf_t;
 
 typedef struct {
@@ -26,6 +26,7 @@
  * Copyright 2019 Nexenta Systems, Inc.  All rights reserved.
  * Copyright (c) 2013 by Delphix. All rights reserved.
  * Copyright (c) 2013 by Saso Kiselkov. All rights reserved.
+ * Copyright 2026 Joyent, Inc.
  */
 
 #include <sys/conf.h>
@@ -164,6 +165,7 @@ static void stmf_update_kstat_lu_q(scsi_task_t *, void());
 static void stmf_update_kstat_lport_q(scsi_task_t *, void());
 static void stmf_update_kstat_lu_io(scsi_task_t *, stmf_data_buf_t *);
 static void stmf_update_kstat_lport_io(scsi_task_t *, stmf_data_buf_t *);
+static void stmf_update_kstat_lu_estat(scsi_task_t *);
 static hrtime_t stmf_update_rport_timestamps(hrtime_t *start_tstamp,
     hrtime_t *done_tstamp, stmf_i_scsi_task_t *itask);
 
@@ -2894,11 +2896,50 @@ stmf_update_kstat_lu_io(scsi_task_t *task, stmf_data_buf_t *dbuf)
 	}
 }
 
+/*
+ * Account the latency of a completed task to its LU; called with the LU's
+ * ks_lock held.
+ */
+static void
+stmf_update_kstat_lu_estat(scsi_task_t *task)
+{
+	stmf_i_scsi_task_t	*itask = task->task_stmf_private;
+	stmf_i_lu_t		*ilu = task->task_lu->lu_stmf_private;
+	stmf_kstat_lu_estat_t	*ks_estat;
+	hrtime_t		lat;
+
+	if (ilu->ilu_kstat_estat == NULL)
+		return;
+
+	ASSERT(MUTEX_HELD(ilu->ilu_kstat_estat->ks_lock));
+	ks_estat = (stmf_kstat_lu_estat_t *)KSTAT_NAMED_PTR(
+	    ilu->ilu_kstat_estat);
+	lat = itask->itask_done_timestamp - itask->itask_start_timestamp;
+
+	if (itask->itask_read_xfer > 0) {
+		ks_estat->i_nread_tasks.value.ui64++;
+		ks_estat->i_lu_read_latency.value.ui64 += lat;
+		ks_estat->i_lu_read_time.value.ui64 +=
+		    itask->itask_lu_read_time;
+		ks_estat->i_lport_read_time.value.ui64 +=
+		    itask->itask_lport_read_time;
+	} else if ((itask->itask_write_xfer > 0) ||
+	    (task->task_flags & TF_INITIAL_BURST)) {
+		ks_estat->i_nwrite_tasks.value.ui64++;
+		ks_estat->i_lu_write_latency.value.ui64 += lat;
+		ks_estat->i_lu_write_time.value.ui64 +=
+		    itask->itask_lu_write_time;
+		ks_estat->i_lport_write_time.value.ui64 +=
+		    itask->itask_lport_write_time;
+	}
+}
+
 static void
 stmf_create_kstat_lu(stmf_i_lu_t *ilu)
 {
 	char				ks_nm[KSTAT_STRLEN];
 	stmf_kstat_lu_info_t		*ks_lu;
+	stmf_kstat_lu_estat_t		*ks_estat;
 
 	/* create kstat lun info */
 	ks_lu = (stmf_kstat_lu_info_t *)kmem_zalloc(STMF_KSTAT_LU_SZ,
@@ -2951,6 +2992,36 @@ stmf_create_kstat_lu(stmf_i_lu_t *ilu)
 	mutex_init(&ilu->ilu_kstat_lock, NULL, MUTEX_DRIVER, 0);
 	ilu->ilu_kstat_io->ks_lock = &ilu->ilu_kstat_lock;
 	kstat_install(ilu->ilu_kstat_io);
+
+	/* create kstat lun latency */
+	(void) snprintf(ks_nm, KSTAT_STRLEN, "stmf_lu_st_%"PRIxPTR"",
+	    (uintptr_t)ilu);
+	if ((ilu->ilu_kstat_estat = kstat_create(STMF_MODULE_NAME, 0,
+	    ks_nm, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (*ks_estat) / sizeof (kstat_named_t), 0)) == NULL) {
+		cmn_err(CE_WARN, "STMF: kstat_create lu_st failed");
+		return;
+	}
+	ks_estat = (stmf_kstat_lu_estat_t *)KSTAT_NAMED_PTR(
+	    ilu->ilu_kstat_estat);
+	kstat_named_init(&ks_estat->i_lu_read_latency, "rlatency",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_lu_write_latency, "wlatency",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_lu_read_time, "rlutime",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_lu_write_time, "wlutime",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_lport_read_time, "rlporttime",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_lport_write_time, "wlporttime",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_nread_tasks, "rntasks",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks_estat->i_nwrite_tasks, "wntasks",
+	    KSTAT_DATA_UINT64);
+	ilu->ilu_kstat_estat->ks_lock = &ilu->ilu_kstat_lock;
+	kstat_install(ilu->ilu_kstat_estat);
 }
 
 static void
@@ -3278,6 +3349,9 @@ stmf_deregister_lu(stmf_lu_t *lu)
 		kmem_free(ilu->ilu_kstat_info->ks_data, STMF_KSTAT_LU_SZ);
 		kstat_delete(ilu->ilu_kstat_info);
 	}
+	if (ilu->ilu_kstat_estat) {
+		kstat_delete(ilu->ilu_kstat_estat);
+	}
 	if (ilu->ilu_kstat_io) {
 		kstat_delete(ilu->ilu_kstat_io);
 		mutex_destroy(&ilu->ilu_kstat_lock);
@@ -7501,6 +7575,8 @@ stmf_itl_task_done(stmf_i_scsi_task_t *itask)
 
 	mutex_enter(ilu->ilu_kstat_io->ks_lock);
 
+	stmf_update_kstat_lu_estat(task);
+
 	if (itask->itask_flags & ITASK_KSTAT_IN_RUNQ) {
 		stmf_update_kstat_lu_q(task, kstat_runq_exit);
 		mutex_exit(ilu->ilu_kstat_io->ks_lock);
@@ -23,6 +23,7 @@
  *
  * Copyright 2016 Nexenta Systems, Inc.  All rights reserved.
  * Copyright (c) 2013 by Delphix. All rights reserved.
+ * Copyright 2026 Joyent, Inc.
  */
 #ifndef _STMF_IMPL_H
 #define	_STMF_IMPL_H
@@ -99,6 +100,7 @@ typedef struct stmf_i_lu {
 	struct stmf_itl_data	*ilu_itl_list;
 	kstat_t		*ilu_kstat_info;
 	kstat_t		*ilu_kstat_io;
+	kstat_t		*ilu_kstat_estat;
 	kmutex_t	ilu_kstat_lock;
 	kcondvar_t	ilu_offline_pending_cv;
 
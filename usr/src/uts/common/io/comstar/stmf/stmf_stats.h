@@ -21,6 +21,7 @@
 /*
  * Copyright 2010 Sun Microsystems, Inc.  All rights reserved.
  * Use is subject to license terms.
+ * Copyright 2026 Joyent, Inc.
  */
 #ifndef _STMF_STATS_H
 #define	_STMF_STATS_H
@@ -54,6 +55,24 @@ typedef struct stmf_kstat_lu_info {
 	kstat_named_t		i_lun_alias;
 } stmf_kstat_lu_info_t;
 
+/*
+ * Per-LU latency.  The latencies are the sums, in nanoseconds, of the time
+ * from the arrival of each task to its completion; the LU and port times are
+ * the parts of that spent in the LU's backing store and moving data to or
+ * from the remote port.  Dividing each by the matching task count gives the
+ * mean for the interval between two snapshots.
+ */
+typedef struct stmf_kstat_lu_estat {
+	kstat_named_t		i_lu_read_latency;
+	kstat_named_t		i_lu_write_latency;
+	kstat_named_t		i_lu_read_time;
+	kstat_named_t		i_lu_write_time;
+	kstat_named_t		i_lport_read_time;
+	kstat_named_t		i_lport_write_time;
+	kstat_named_t		i_nread_tasks;
+	kstat_named_t		i_nwrite_tasks;
+} stmf_kstat_lu_estat_t;
+
 typedef struct stmf_kstat_tgt_info {
 	kstat_named_t		i_tgt_name;
 	kstat_named_t		i_tgt_alias;
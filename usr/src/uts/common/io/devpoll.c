@@ -123,11 +123,6 @@ static struct modlinkage modlinkage = {
 	NULL
 };
 
-static void pcachelink_assoc(pollcache_t *, pollcache_t *);
-static void pcachelink_mark_stale(pollcache_t *);
-static void pcachelink_purge_stale(pollcache_t *);
-static void pcachelink_purge_all(pollcache_t *);
-
 
 /*
  * Locking Design
@@ -233,398 +228,392 @@ dpinfo(dev_info_t *dip, ddi_info_cmd_t infocmd, void *arg, void **result)
 }
 
 /*
- * dp_pcache_poll has similar logic to pcache_poll() in poll.c. The major
- * differences are: (1) /dev/poll requires scanning the bitmap starting at
- * where it was stopped last time, instead of always starting from 0,
- * (2) since user may not have cleaned up the cached fds when they are
- * closed, some polldats in cache may refer to closed or reused fds. We
- * need to check for those cases.
+ * Ready List
  *
- * NOTE: Upon closing an fd, automatic poll cache cleanup is done for
- *	 poll(2) caches but NOT for /dev/poll caches. So expect some
- *	 stale entries!
+ * Without help, DP_POLL (and epoll_wait(), which the lx brand implements on
+ * top of /dev/poll) finds the fds it must examine by scanning the pollcache
+ * bitmap, so its cost grows with the highest cached fd rather than with the
+ * number of fds which have something to report.  A process watching tens of
+ * thousands of mostly idle connections pays for all of them on every call.
+ *
+ * Pollcaches of handles opened while devpoll_readyq is set are marked
+ * PC_READYQ, and every polldat whose bit is set in pc_bitmap is also kept on
+ * pc_ready.  pollnotify() appends a polldat when pollwakeup() sets its bit,
+ * and dpwrite() does the same for the fds it caches.  dp_pcache_poll_ready()
+ * then takes polldats off the head of the list, polls each one, and appends
+ * it to the tail again if its bit is still set afterwards: level-triggered
+ * fds with events pending, fds whose driver provides no pollhead, closed fds
+ * reported as POLLNVAL and so on.  Fds which are latched by POLLET, which
+ * have fired under POLLONESHOT, or which have nothing pending have their bit
+ * cleared and are not requeued, exactly as they would be skipped by the
+ * bitmap scan.  Requeueing at the tail provides the round-robin fairness that
+ * resuming the scan at pc_mapstart does, and the number of polldats visited
+ * is bounded by the length of the list on entry so that none is polled twice
+ * in one call.
+ *
+ * All bit changes for PC_READYQ caches go through dp_ready_set() and
+ * dp_ready_clear() (or pollnotify()), which keep the list in step.  Note that
+ * pc_lock may be dropped within VOP_POLL (see pollunlock()), so the polldat
+ * being polled may be notified or removed by dpwrite() meanwhile; it is only
+ * requeued if it is still marked and not already back on the list.
+ */
+boolean_t devpoll_readyq = B_TRUE;
+
+static void
+dp_ready_set(pollcache_t *pcp, polldat_t *pdp)
+{
+	ASSERT(MUTEX_HELD(&pcp->pc_lock));
+	BT_SET(pcp->pc_bitmap, pdp->pd_fd);
+	if ((pcp->pc_flag & PC_READYQ) != 0 &&
+	    !list_link_active(&pdp->pd_readylink)) {
+		list_insert_tail(&pcp->pc_ready, pdp);
+		pcp->pc_nready++;
+	}
+}
+
+static void
+dp_ready_clear(pollcache_t *pcp, polldat_t *pdp)
+{
+	ASSERT(MUTEX_HELD(&pcp->pc_lock));
+	BT_CLEAR(pcp->pc_bitmap, pdp->pd_fd);
+	if (list_link_active(&pdp->pd_readylink)) {
+		ASSERT(pcp->pc_flag & PC_READYQ);
+		list_remove(&pcp->pc_ready, pdp);
+		pcp->pc_nready--;
+	}
+}
+
+/*
+ * Poll one cached fd on behalf of dp_pcache_poll(), reporting any event in
+ * slot *fdcntp of dpbuf and advancing *fdcntp.  The bit for the fd is cleared
+ * when it need not be polled again until the next pollwakeup().
  */
 static int
-dp_pcache_poll(dp_entry_t *dpep, void *dpbuf, pollcache_t *pcp, nfds_t nfds,
-    int *fdcntp)
+dp_pcache_poll_fd(dp_entry_t *dpep, void *dpbuf, pollcache_t *pcp,
+    polldat_t *pdp, int *fdcntp)
 {
-	int		start, ostart, end, fdcnt, error = 0;
-	boolean_t	done, no_wrap;
-	pollfd_t	*pfdp;
-	epoll_event_t	*epoll;
+	int		fd = pdp->pd_fd, error;
+	pollfd_t	*pfdp = NULL;
+	epoll_event_t	*epoll = NULL;
+	pollhead_t	*php;
+	short		revent;
+	uf_entry_gen_t	gen;
+	file_t		*fp;
 	const short	mask = POLLRDHUP | POLLWRBAND;
 	const boolean_t	is_epoll = (dpep->dpe_flag & DP_ISEPOLLCOMPAT) != 0;
 
-	ASSERT(MUTEX_HELD(&pcp->pc_lock));
-	if (pcp->pc_bitmap == NULL) {
-		/* No Need to search because no poll fd has been cached. */
+	if (dpbuf != NULL) {
+		if (is_epoll)
+			epoll = &((epoll_event_t *)dpbuf)[*fdcntp];
+		else
+			pfdp = &((pollfd_t *)dpbuf)[*fdcntp];
+	}
+
+repoll:
+	php = NULL;
+	revent = 0;
+	if (pdp->pd_fp == NULL) {
+		/*
+		 * The fd is POLLREMOVed. This fd is logically no longer
+		 * cached, so there is nothing to examine until it is added
+		 * again.
+		 */
+		dp_ready_clear(pcp, pdp);
 		return (0);
 	}
+	if ((fp = getf_gen(fd, &gen)) == NULL) {
+		if (is_epoll) {
+			/*
+			 * In the epoll compatibility case, we actually
+			 * perform the implicit removal to remain closer to
+			 * the epoll semantics.
+			 */
+			pdp->pd_fp = NULL;
+			pdp->pd_events = 0;
 
-	if (is_epoll) {
-		pfdp = NULL;
-		epoll = (epoll_event_t *)dpbuf;
-	} else {
-		pfdp = (pollfd_t *)dpbuf;
-		epoll = NULL;
+			if (pdp->pd_php != NULL) {
+				pollhead_delete(pdp->pd_php, pdp);
+				pdp->pd_php = NULL;
+			}
+
+			dp_ready_clear(pcp, pdp);
+		} else if (pfdp != NULL) {
+			/*
+			 * The fd has been closed, but user has not done a
+			 * POLLREMOVE on this fd yet. Instead of cleaning it
+			 * here implicitly, we return POLLNVAL. This is
+			 * consistent with poll(2) polling a closed fd. Hope
+			 * this will remind user to do a POLLREMOVE.
+			 */
+			pfdp->fd = fd;
+			pfdp->revents = POLLNVAL;
+			(*fdcntp)++;
+		}
+		return (0);
 	}
-retry:
-	start = ostart = pcp->pc_mapstart;
-	end = pcp->pc_mapend;
 
-	if (start == 0) {
+	/*
+	 * Detect a change to the resource underlying a cached file
+	 * descriptor.  While the fd generation comparison will catch nearly
+	 * all cases, the file_t comparison is maintained as a failsafe as
+	 * well.
+	 */
+	if (gen != pdp->pd_gen || fp != pdp->pd_fp) {
 		/*
-		 * started from every begining, no need to wrap around.
+		 * The user is polling on a cached fd which was closed and
+		 * then reused.  Unfortunately there is no good way to
+		 * communicate this fact to the consumer.
+		 *
+		 * When this situation has been detected, it's likely that
+		 * any existing pollhead is ill-suited to perform proper
+		 * wake-ups.
+		 *
+		 * Clean up the old entry under the expectation that a valid
+		 * one will be provided as part of the later VOP_POLL.
 		 */
-		no_wrap = B_TRUE;
-	} else {
-		no_wrap = B_FALSE;
+		if (pdp->pd_php != NULL) {
+			pollhead_delete(pdp->pd_php, pdp);
+			pdp->pd_php = NULL;
+		}
+
+		/*
+		 * Since epoll is expected to act on the underlying 'struct
+		 * file' (in Linux terms, our vnode_t would be a closer
+		 * analog) rather than the fd itself, an implicit remove is
+		 * necessary under these circumstances to suppress any
+		 * results (or errors) from the new resource occupying the
+		 * fd.
+		 */
+		if (is_epoll) {
+			pdp->pd_fp = NULL;
+			pdp->pd_events = 0;
+			dp_ready_clear(pcp, pdp);
+			releasef(fd);
+			return (0);
+		} else {
+			/*
+			 * Regular /dev/poll is unbothered about the fd
+			 * reassignment.
+			 */
+			pdp->pd_fp = fp;
+			pdp->pd_gen = gen;
+		}
 	}
-	done = B_FALSE;
-	fdcnt = 0;
-	while ((fdcnt < nfds) && !done) {
-		pollhead_t *php = NULL;
-		short revent = 0;
-		uf_entry_gen_t gen;
-		int fd;
+
+	/*
+	 * Skip entries marked with the sentinal value for having already
+	 * fired under oneshot conditions.
+	 */
+	if (pdp->pd_events == POLLONESHOT) {
+		releasef(fd);
+		dp_ready_clear(pcp, pdp);
+		return (0);
+	}
+
+	/*
+	 * XXX - pollrelock() logic needs to know which which pollcache lock
+	 * to grab. It'd be a cleaner solution if we could pass pcp as an
+	 * arguement in VOP_POLL interface instead of implicitly passing it
+	 * using thread_t struct. On the other hand, changing VOP_POLL
+	 * interface will require all driver/file system poll routine to
+	 * change. May want to revisit the tradeoff later.
+	 */
+	curthread->t_pollcache = pcp;
+	error = VOP_POLL(fp->f_vnode, pdp->pd_events, 0, &revent, &php, NULL);
+
+	/*
+	 * Recheck edge-triggered descriptors which lack a pollhead.  While
+	 * this check is performed when an fd is added to the pollcache in
+	 * dpwrite(), subsequent descriptor manipulation could cause a
+	 * different resource to be present now.
+	 */
+	if ((pdp->pd_events & POLLET) && error == 0 &&
+	    pdp->pd_php == NULL && php == NULL && revent != 0) {
+		short levent = 0;
 
 		/*
-		 * Examine the bit map in a circular fashion
-		 * to avoid starvation. Always resume from
-		 * last stop. Scan till end of the map. Then
-		 * wrap around.
+		 * The same POLLET-only VOP_POLL is used in an attempt to
+		 * coax a pollhead from older driver logic.
 		 */
-		fd = bt_getlowbit(pcp->pc_bitmap, start, end);
-		ASSERT(fd <= end);
-		if (fd >= 0) {
-			file_t *fp;
-			polldat_t *pdp;
+		error = VOP_POLL(fp->f_vnode, POLLET, 0, &levent, &php, NULL);
+	}
 
-			if (fd == end) {
-				if (no_wrap) {
-					done = B_TRUE;
-				} else {
-					start = 0;
-					end = ostart - 1;
-					no_wrap = B_TRUE;
-				}
-			} else {
-				start = fd + 1;
-			}
-			pdp = pcache_lookup_fd(pcp, fd);
-repoll:
-			ASSERT(pdp != NULL);
-			ASSERT(pdp->pd_fd == fd);
-			if (pdp->pd_fp == NULL) {
-				/*
-				 * The fd is POLLREMOVed. This fd is
-				 * logically no longer cached. So move
-				 * on to the next one.
-				 */
-				continue;
-			}
-			if ((fp = getf_gen(fd, &gen)) == NULL) {
-				if (is_epoll) {
-					/*
-					 * In the epoll compatibility case, we
-					 * actually perform the implicit
-					 * removal to remain closer to the
-					 * epoll semantics.
-					 */
-					pdp->pd_fp = NULL;
-					pdp->pd_events = 0;
+	curthread->t_pollcache = NULL;
+	releasef(fd);
+	if (error != 0) {
+		return (error);
+	}
 
-					if (pdp->pd_php != NULL) {
-						pollhead_delete(pdp->pd_php,
-						    pdp);
-						pdp->pd_php = NULL;
-					}
+	/*
+	 * layered devices (e.g. console driver) may change the vnode and
+	 * thus the pollhead pointer out from underneath us.  Move to the new
+	 * pollhead and poll this fd again.
+	 */
+	if (php != NULL && pdp->pd_php != NULL && php != pdp->pd_php) {
+		pollhead_delete(pdp->pd_php, pdp);
+		pdp->pd_php = php;
+		pollhead_insert(php, pdp);
+		/*
+		 * The bit should still be set.
+		 */
+		ASSERT(BT_TEST(pcp->pc_bitmap, fd));
+		goto repoll;
+	}
 
-					BT_CLEAR(pcp->pc_bitmap, fd);
-				} else if (pfdp != NULL) {
-					/*
-					 * The fd has been closed, but user has
-					 * not done a POLLREMOVE on this fd
-					 * yet. Instead of cleaning it here
-					 * implicitly, we return POLLNVAL. This
-					 * is consistent with poll(2) polling a
-					 * closed fd. Hope this will remind
-					 * user to do a POLLREMOVE.
-					 */
-					pfdp[fdcnt].fd = fd;
-					pfdp[fdcnt].revents = POLLNVAL;
-					fdcnt++;
-				}
-				continue;
-			}
+	if (revent != 0) {
+		if (pfdp != NULL) {
+			pfdp->fd = fd;
+			pfdp->events = pdp->pd_events;
+			pfdp->revents = revent;
+		} else if (epoll != NULL) {
+			epoll->data.u64 = pdp->pd_epolldata;
 
 			/*
-			 * Detect a change to the resource underlying a cached
-			 * file descriptor.  While the fd generation comparison
-			 * will catch nearly all cases, the file_t comparison
-			 * is maintained as a failsafe as well.
+			 * Since POLLNVAL is a legal event for VOP_POLL
+			 * handlers to emit, it must be translated
+			 * epoll-legal.
 			 */
-			if (gen != pdp->pd_gen || fp != pdp->pd_fp) {
-				/*
-				 * The user is polling on a cached fd which was
-				 * closed and then reused.  Unfortunately there
-				 * is no good way to communicate this fact to
-				 * the consumer.
-				 *
-				 * When this situation has been detected, it's
-				 * likely that any existing pollhead is
-				 * ill-suited to perform proper wake-ups.
-				 *
-				 * Clean up the old entry under the expectation
-				 * that a valid one will be provided as part of
-				 * the later VOP_POLL.
-				 */
-				if (pdp->pd_php != NULL) {
-					pollhead_delete(pdp->pd_php, pdp);
-					pdp->pd_php = NULL;
-				}
-
-				/*
-				 * Since epoll is expected to act on the
-				 * underlying 'struct file' (in Linux terms,
-				 * our vnode_t would be a closer analog) rather
-				 * than the fd itself, an implicit remove
-				 * is necessary under these circumstances to
-				 * suppress any results (or errors) from the
-				 * new resource occupying the fd.
-				 */
-				if (is_epoll) {
-					pdp->pd_fp = NULL;
-					pdp->pd_events = 0;
-					BT_CLEAR(pcp->pc_bitmap, fd);
-					releasef(fd);
-					continue;
-				} else {
-					/*
-					 * Regular /dev/poll is unbothered
-					 * about the fd reassignment.
-					 */
-					pdp->pd_fp = fp;
-					pdp->pd_gen = gen;
-				}
+			if (revent & POLLNVAL) {
+				revent &= ~POLLNVAL;
+				revent |= POLLERR;
 			}
 
 			/*
-			 * Skip entries marked with the sentinal value for
-			 * having already fired under oneshot conditions.
+			 * If any of the event bits are set for which poll
+			 * and epoll representations differ, swizzle in the
+			 * native epoll values.
 			 */
-			if (pdp->pd_events == POLLONESHOT) {
-				releasef(fd);
-				BT_CLEAR(pcp->pc_bitmap, fd);
-				continue;
+			if (revent & mask) {
+				epoll->events = (revent & ~mask) |
+				    ((revent & POLLRDHUP) ? EPOLLRDHUP : 0) |
+				    ((revent & POLLWRBAND) ? EPOLLWRBAND : 0);
+			} else {
+				epoll->events = revent;
 			}
 
 			/*
-			 * XXX - pollrelock() logic needs to know which
-			 * which pollcache lock to grab. It'd be a
-			 * cleaner solution if we could pass pcp as
-			 * an arguement in VOP_POLL interface instead
-			 * of implicitly passing it using thread_t
-			 * struct. On the other hand, changing VOP_POLL
-			 * interface will require all driver/file system
-			 * poll routine to change. May want to revisit
-			 * the tradeoff later.
+			 * We define POLLWRNORM to be POLLOUT, but epoll has
+			 * separate definitions for them; if POLLOUT is set
+			 * and the user has asked for EPOLLWRNORM, set that
+			 * as well.
 			 */
-			curthread->t_pollcache = pcp;
-			error = VOP_POLL(fp->f_vnode, pdp->pd_events, 0,
-			    &revent, &php, NULL);
-
+			if ((revent & POLLOUT) &&
+			    (pdp->pd_events & EPOLLWRNORM)) {
+				epoll->events |= EPOLLWRNORM;
+			}
+		} else {
+			pollstate_t *ps = curthread->t_pollstate;
 			/*
-			 * Recheck edge-triggered descriptors which lack a
-			 * pollhead.  While this check is performed when an fd
-			 * is added to the pollcache in dpwrite(), subsequent
-			 * descriptor manipulation could cause a different
-			 * resource to be present now.
+			 * The devpoll handle itself is being polled.  Notify
+			 * the caller of any readable event(s), leaving as
+			 * much state as possible untouched.
 			 */
-			if ((pdp->pd_events & POLLET) && error == 0 &&
-			    pdp->pd_php == NULL && php == NULL && revent != 0) {
-				short levent = 0;
+			VERIFY(*fdcntp == 0);
+			VERIFY(ps != NULL);
 
-				/*
-				 * The same POLLET-only VOP_POLL is used in an
-				 * attempt to coax a pollhead from older
-				 * driver logic.
-				 */
-				error = VOP_POLL(fp->f_vnode, POLLET,
-				    0, &levent, &php, NULL);
-			}
-
-			curthread->t_pollcache = NULL;
-			releasef(fd);
-			if (error != 0) {
-				break;
+			/*
+			 * If a call to pollunlock() fails during VOP_POLL,
+			 * skip over the fd and continue polling.
+			 *
+			 * Otherwise, report that there is an event pending;
+			 * the caller stops as soon as one is found.
+			 */
+			if ((ps->ps_flags & POLLSTATE_ULFAIL) != 0) {
+				ps->ps_flags &= ~POLLSTATE_ULFAIL;
+			} else {
+				(*fdcntp)++;
 			}
+			return (0);
+		}
 
+		/* Handle special polling modes. */
+		if (pdp->pd_events & POLLONESHOT) {
 			/*
-			 * layered devices (e.g. console driver)
-			 * may change the vnode and thus the pollhead
-			 * pointer out from underneath us.
+			 * Entries operating under POLLONESHOT will be marked
+			 * with a sentinel value to indicate that they have
+			 * "fired" when emitting an event.  This will disable
+			 * them from polling until a later add/modify event
+			 * rearms them.
 			 */
-			if (php != NULL && pdp->pd_php != NULL &&
-			    php != pdp->pd_php) {
+			pdp->pd_events = POLLONESHOT;
+			if (pdp->pd_php != NULL) {
 				pollhead_delete(pdp->pd_php, pdp);
-				pdp->pd_php = php;
+				pdp->pd_php = NULL;
+			}
+			dp_ready_clear(pcp, pdp);
+		} else if (pdp->pd_events & POLLET) {
+			/*
+			 * Wire up the pollhead which should have been
+			 * provided.  Edge-triggered polling cannot function
+			 * properly with drivers which do not emit one.
+			 */
+			if (php != NULL && pdp->pd_php == NULL) {
 				pollhead_insert(php, pdp);
-				/*
-				 * The bit should still be set.
-				 */
-				ASSERT(BT_TEST(pcp->pc_bitmap, fd));
-				goto retry;
+				pdp->pd_php = php;
 			}
 
-			if (revent != 0) {
-				if (pfdp != NULL) {
-					pfdp[fdcnt].fd = fd;
-					pfdp[fdcnt].events = pdp->pd_events;
-					pfdp[fdcnt].revents = revent;
-				} else if (epoll != NULL) {
-					epoll_event_t *ep = &epoll[fdcnt];
-
-					ASSERT(epoll != NULL);
-					ep->data.u64 = pdp->pd_epolldata;
-
-					/*
-					 * Since POLLNVAL is a legal event for
-					 * VOP_POLL handlers to emit, it must
-					 * be translated epoll-legal.
-					 */
-					if (revent & POLLNVAL) {
-						revent &= ~POLLNVAL;
-						revent |= POLLERR;
-					}
+			/*
+			 * If the driver has emitted a pollhead, clear the bit
+			 * in the bitmap which effectively latches the edge on
+			 * a pollwakeup() from the driver.
+			 */
+			if (pdp->pd_php != NULL) {
+				dp_ready_clear(pcp, pdp);
+			}
+		}
 
-					/*
-					 * If any of the event bits are set for
-					 * which poll and epoll representations
-					 * differ, swizzle in the native epoll
-					 * values.
-					 */
-					if (revent & mask) {
-						ep->events = (revent & ~mask) |
-						    ((revent & POLLRDHUP) ?
-						    EPOLLRDHUP : 0) |
-						    ((revent & POLLWRBAND) ?
-						    EPOLLWRBAND : 0);
-					} else {
-						ep->events = revent;
-					}
+		(*fdcntp)++;
+	} else if (php != NULL) {
+		/*
+		 * We clear a bit or cache a poll fd if the driver returns a
+		 * poll head ptr, which is expected in the case of 0 revents.
+		 * Some buggy driver may return NULL php pointer with 0
+		 * revents. In this case, we just treat the driver as
+		 * "noncachable" and not clearing the bit in bitmap.
+		 */
+		if ((pdp->pd_php != NULL) &&
+		    ((pcp->pc_flag & PC_POLLWAKE) == 0)) {
+			dp_ready_clear(pcp, pdp);
+		}
+		if (pdp->pd_php == NULL) {
+			pollhead_insert(php, pdp);
+			pdp->pd_php = php;
+			/*
+			 * An event of interest may have arrived between the
+			 * VOP_POLL() and the pollhead_insert(); check again.
+			 */
+			goto repoll;
+		}
+	}
 
-					/*
-					 * We define POLLWRNORM to be POLLOUT,
-					 * but epoll has separate definitions
-					 * for them; if POLLOUT is set and the
-					 * user has asked for EPOLLWRNORM, set
-					 * that as well.
-					 */
-					if ((revent & POLLOUT) &&
-					    (pdp->pd_events & EPOLLWRNORM)) {
-						ep->events |= EPOLLWRNORM;
-					}
-				} else {
-					pollstate_t *ps =
-					    curthread->t_pollstate;
-					/*
-					 * The devpoll handle itself is being
-					 * polled.  Notify the caller of any
-					 * readable event(s), leaving as much
-					 * state as possible untouched.
-					 */
-					VERIFY(fdcnt == 0);
-					VERIFY(ps != NULL);
+	return (0);
+}
 
-					/*
-					 * If a call to pollunlock() fails
-					 * during VOP_POLL, skip over the fd
-					 * and continue polling.
-					 *
-					 * Otherwise, report that there is an
-					 * event pending.
-					 */
-					if ((ps->ps_flags & POLLSTATE_ULFAIL)
-					    != 0) {
-						ps->ps_flags &=
-						    ~POLLSTATE_ULFAIL;
-						continue;
-					} else {
-						fdcnt++;
-						break;
-					}
-				}
+/*
+ * Find the fds to poll by scanning the bitmap in a circular fashion to avoid
+ * starvation: resume from where the last scan stopped, scan till the end of
+ * the map, then wrap around.
+ */
+static int
+dp_pcache_poll_scan(dp_entry_t *dpep, void *dpbuf, pollcache_t *pcp,
+    nfds_t nfds, int *fdcntp)
+{
+	int		start, ostart, end, fdcnt = 0, error = 0;
+	boolean_t	done = B_FALSE, no_wrap;
 
-				/* Handle special polling modes. */
-				if (pdp->pd_events & POLLONESHOT) {
-					/*
-					 * Entries operating under POLLONESHOT
-					 * will be marked with a sentinel value
-					 * to indicate that they have "fired"
-					 * when emitting an event.  This will
-					 * disable them from polling until a
-					 * later add/modify event rearms them.
-					 */
-					pdp->pd_events = POLLONESHOT;
-					if (pdp->pd_php != NULL) {
-						pollhead_delete(pdp->pd_php,
-						    pdp);
-						pdp->pd_php = NULL;
-					}
-					BT_CLEAR(pcp->pc_bitmap, fd);
-				} else if (pdp->pd_events & POLLET) {
-					/*
-					 * Wire up the pollhead which should
-					 * have been provided.  Edge-triggered
-					 * polling cannot function properly
-					 * with drivers which do not emit one.
-					 */
-					if (php != NULL &&
-					    pdp->pd_php == NULL) {
-						pollhead_insert(php, pdp);
-						pdp->pd_php = php;
-					}
+	start = ostart = pcp->pc_mapstart;
+	end = pcp->pc_mapend;
 
-					/*
-					 * If the driver has emitted a pollhead,
-					 * clear the bit in the bitmap which
-					 * effectively latches the edge on a
-					 * pollwakeup() from the driver.
-					 */
-					if (pdp->pd_php != NULL) {
-						BT_CLEAR(pcp->pc_bitmap, fd);
-					}
-				}
+	/*
+	 * If started from the very beginning, no need to wrap around.
+	 */
+	no_wrap = (start == 0);
+	while ((fdcnt < nfds) && !done) {
+		int fd;
 
-				fdcnt++;
-			} else if (php != NULL) {
-				/*
-				 * We clear a bit or cache a poll fd if
-				 * the driver returns a poll head ptr,
-				 * which is expected in the case of 0
-				 * revents. Some buggy driver may return
-				 * NULL php pointer with 0 revents. In
-				 * this case, we just treat the driver as
-				 * "noncachable" and not clearing the bit
-				 * in bitmap.
-				 */
-				if ((pdp->pd_php != NULL) &&
-				    ((pcp->pc_flag & PC_POLLWAKE) == 0)) {
-					BT_CLEAR(pcp->pc_bitmap, fd);
-				}
-				if (pdp->pd_php == NULL) {
-					pollhead_insert(php, pdp);
-					pdp->pd_php = php;
-					/*
-					 * An event of interest may have
-					 * arrived between the VOP_POLL() and
-					 * the pollhead_insert(); check again.
-					 */
-					goto repoll;
-				}
-			}
-		} else {
+		fd = bt_getlowbit(pcp->pc_bitmap, start, end);
+		ASSERT(fd <= end);
+		if (fd < 0) {
 			/*
 			 * No bit set in the range. Check for wrap around.
 			 */
@@ -635,17 +624,94 @@ repoll:
 			} else {
 				done = B_TRUE;
 			}
+			continue;
 		}
+
+		if (fd == end) {
+			if (no_wrap) {
+				done = B_TRUE;
+			} else {
+				start = 0;
+				end = ostart - 1;
+				no_wrap = B_TRUE;
+			}
+		} else {
+			start = fd + 1;
+		}
+
+		error = dp_pcache_poll_fd(dpep, dpbuf, pcp,
+		    pcache_lookup_fd(pcp, fd), &fdcnt);
+		if (error != 0 || (dpbuf == NULL && fdcnt != 0))
+			break;
 	}
 
 	if (!done) {
 		pcp->pc_mapstart = start;
 	}
-	ASSERT(*fdcntp == 0);
 	*fdcntp = fdcnt;
 	return (error);
 }
 
+/*
+ * Visit only the polldats on the ready list; see "Ready List" above.
+ */
+static int
+dp_pcache_poll_ready(dp_entry_t *dpep, void *dpbuf, pollcache_t *pcp,
+    nfds_t nfds, int *fdcntp)
+{
+	uint_t		nready = pcp->pc_nready;
+	int		fdcnt = 0, error = 0;
+	polldat_t	*pdp;
+
+	while (fdcnt < nfds && nready-- > 0 &&
+	    (pdp = list_remove_head(&pcp->pc_ready)) != NULL) {
+		pcp->pc_nready--;
+		ASSERT(BT_TEST(pcp->pc_bitmap, pdp->pd_fd));
+		ASSERT3P(pdp, ==, pcache_lookup_fd(pcp, pdp->pd_fd));
+
+		error = dp_pcache_poll_fd(dpep, dpbuf, pcp, pdp, &fdcnt);
+
+		if (BT_TEST(pcp->pc_bitmap, pdp->pd_fd) &&
+		    !list_link_active(&pdp->pd_readylink)) {
+			list_insert_tail(&pcp->pc_ready, pdp);
+			pcp->pc_nready++;
+		}
+		if (error != 0 || (dpbuf == NULL && fdcnt != 0))
+			break;
+	}
+
+	*fdcntp = fdcnt;
+	return (error);
+}
+
+/*
+ * dp_pcache_poll has similar logic to pcache_poll() in poll.c. The major
+ * differences are: (1) /dev/poll examines only the fds on the ready list,
+ * or scans the bitmap starting at where it was stopped last time, instead
+ * of always starting from 0, (2) since user may not have cleaned up the
+ * cached fds when they are closed, some polldats in cache may refer to
+ * closed or reused fds. We need to check for those cases.
+ *
+ * NOTE: Upon closing an fd, automatic poll cache cleanup is done for
+ *	 poll(2) caches but NOT for /dev/poll caches. So expect some
+ *	 stale entries!
+ */
+static int
+dp_pcache_poll(dp_entry_t *dpep, void *dpbuf, pollcache_t *pcp, nfds_t nfds,
+    int *fdcntp)
+{
+	ASSERT(MUTEX_HELD(&pcp->pc_lock));
+	ASSERT(*fdcntp == 0);
+	if (pcp->pc_bitmap == NULL) {
+		/* No Need to search because no poll fd has been cached. */
+		return (0);
+	}
+
+	if ((pcp->pc_flag & PC_READYQ) != 0)
+		return (dp_pcache_poll_ready(dpep, dpbuf, pcp, nfds, fdcntp));
+	return (dp_pcache_poll_scan(dpep, dpbuf, pcp, nfds, fdcntp));
+}
+
 /*ARGSUSED*/
 static int
 dpopen(dev_t *devp, int flag, int otyp, cred_t *credp)
@@ -700,6 +766,8 @@ dpopen(dev_t *devp, int flag, int otyp, cred_t *credp)
 	pcp = pcache_alloc();
 	dpep->dpe_pcache = pcp;
 	pcp->pc_pid = -1;
+	if (devpoll_readyq)
+		pcp->pc_flag |= PC_READYQ;
 	*devp = makedevice(getmajor(*devp), minordev);  /* clone the driver */
 	mutex_enter(&devpoll_lock);
 	ASSERT(minordev < dptblsize);
@@ -976,7 +1044,7 @@ dpwrite(dev_t dev, struct uio *uiop, cred_t *credp)
 					 * call, set the bit in bitmap to force
 					 * DP_POLL ioctl to examine it.
 					 */
-					BT_SET(pcp->pc_bitmap, fd);
+					dp_ready_set(pcp, pdp);
 					pdp->pd_events |= pfdp->events;
 					continue;
 				}
@@ -1046,7 +1114,7 @@ dpwrite(dev_t dev, struct uio *uiop, cred_t *credp)
 			 * DP_POLL.  We also attempt a pollhead_insert();
 			 * if it's not possible, we'll do it in dpioctl().
 			 */
-			BT_SET(pcp->pc_bitmap, fd);
+			dp_ready_set(pcp, pdp);
 			if (error != 0) {
 				releasef(fd);
 				break;
@@ -1091,7 +1159,7 @@ dpwrite(dev_t dev, struct uio *uiop, cred_t *credp)
 				pollhead_delete(pdp->pd_php, pdp);
 				pdp->pd_php = NULL;
 			}
-			BT_CLEAR(pcp->pc_bitmap, fd);
+			dp_ready_clear(pcp, pdp);
 		}
 	}
 	/*
@@ -1695,173 +1763,3 @@ dpclose(dev_t dev, int flag, int otyp, cred_t *credp)
 	kmem_free(dpep, sizeof (dp_entry_t));
 	return (0);
 }
-
-static void
-pcachelink_locked_rele(pcachelink_t *pl)
-{
-	ASSERT(MUTEX_HELD(&pl->pcl_lock));
-	VERIFY(pl->pcl_refcnt >= 1);
-
-	pl->pcl_refcnt--;
-	if (pl->pcl_refcnt == 0) {
-		VERIFY(pl->pcl_state == PCL_INVALID);
-		ASSERT(pl->pcl_parent_pc == NULL);
-		ASSERT(pl->pcl_child_pc == NULL);
-		ASSERT(pl->pcl_parent_next == NULL);
-		ASSERT(pl->pcl_child_next == NULL);
-
-		pl->pcl_state = PCL_FREE;
-		mutex_destroy(&pl->pcl_lock);
-		kmem_free(pl, sizeof (pcachelink_t));
-	} else {
-		mutex_exit(&pl->pcl_lock);
-	}
-}
-
-/*
- * Associate parent and child pollcaches via a pcachelink_t.  If an existing
- * link (stale or valid) between the two is found, it will be reused.  If a
- * suitable link is not found for reuse, a new one will be allocated.
- */
-static void
-pcachelink_assoc(pollcache_t *child, pollcache_t *parent)
-{
-	pcachelink_t	*pl, **plpn;
-
-	ASSERT(MUTEX_HELD(&child->pc_lock));
-	ASSERT(MUTEX_HELD(&parent->pc_lock));
-
-	/* Search for an existing link we can reuse. */
-	plpn = &child->pc_parents;
-	for (pl = child->pc_parents; pl != NULL; pl = *plpn) {
-		mutex_enter(&pl->pcl_lock);
-		if (pl->pcl_state == PCL_INVALID) {
-			/* Clean any invalid links while walking the list */
-			*plpn = pl->pcl_parent_next;
-			pl->pcl_child_pc = NULL;
-			pl->pcl_parent_next = NULL;
-			pcachelink_locked_rele(pl);
-		} else if (pl->pcl_parent_pc == parent) {
-			/* Successfully found parent link */
-			ASSERT(pl->pcl_state == PCL_VALID ||
-			    pl->pcl_state == PCL_STALE);
-			pl->pcl_state = PCL_VALID;
-			mutex_exit(&pl->pcl_lock);
-			return;
-		} else {
-			plpn = &pl->pcl_parent_next;
-			mutex_exit(&pl->pcl_lock);
-		}
-	}
-
-	/* No existing link to the parent was found.  Create a fresh one. */
-	pl = kmem_zalloc(sizeof (pcachelink_t), KM_SLEEP);
-	mutex_init(&pl->pcl_lock,  NULL, MUTEX_DEFAULT, NULL);
-
-	pl->pcl_parent_pc = parent;
-	pl->pcl_child_next = parent->pc_children;
-	parent->pc_children = pl;
-	pl->pcl_refcnt++;
-
-	pl->pcl_child_pc = child;
-	pl->pcl_parent_next = child->pc_parents;
-	child->pc_parents = pl;
-	pl->pcl_refcnt++;
-
-	pl->pcl_state = PCL_VALID;
-}
-
-/*
- * Mark all child links in a pollcache as stale.  Any invalid child links found
- * during iteration are purged.
- */
-static void
-pcachelink_mark_stale(pollcache_t *pcp)
-{
-	pcachelink_t	*pl, **plpn;
-
-	ASSERT(MUTEX_HELD(&pcp->pc_lock));
-
-	plpn = &pcp->pc_children;
-	for (pl = pcp->pc_children; pl != NULL; pl = *plpn) {
-		mutex_enter(&pl->pcl_lock);
-		if (pl->pcl_state == PCL_INVALID) {
-			/*
-			 * Remove any invalid links while we are going to the
-			 * trouble of walking the list.
-			 */
-			*plpn = pl->pcl_child_next;
-			pl->pcl_parent_pc = NULL;
-			pl->pcl_child_next = NULL;
-			pcachelink_locked_rele(pl);
-		} else {
-			pl->pcl_state = PCL_STALE;
-			plpn = &pl->pcl_child_next;
-			mutex_exit(&pl->pcl_lock);
-		}
-	}
-}
-
-/*
- * Purge all stale (or invalid) child links from a pollcache.
- */
-static void
-pcachelink_purge_stale(pollcache_t *pcp)
-{
-	pcachelink_t	*pl, **plpn;
-
-	ASSERT(MUTEX_HELD(&pcp->pc_lock));
-
-	plpn = &pcp->pc_children;
-	for (pl = pcp->pc_children; pl != NULL; pl = *plpn) {
-		mutex_enter(&pl->pcl_lock);
-		switch (pl->pcl_state) {
-		case PCL_STALE:
-			pl->pcl_state = PCL_INVALID;
-			/* FALLTHROUGH */
-		case PCL_INVALID:
-			*plpn = pl->pcl_child_next;
-			pl->pcl_parent_pc = NULL;
-			pl->pcl_child_next = NULL;
-			pcachelink_locked_rele(pl);
-			break;
-		default:
-			plpn = &pl->pcl_child_next;
-			mutex_exit(&pl->pcl_lock);
-		}
-	}
-}
-
-/*
- * Purge all child and parent links from a pollcache, regardless of status.
- */
-static void
-pcachelink_purge_all(pollcache_t *pcp)
-{
-	pcachelink_t	*pl, **plpn;
-
-	ASSERT(MUTEX_HELD(&pcp->pc_lock));
-
-	plpn = &pcp->pc_parents;
-	for (pl = pcp->pc_parents; pl != NULL; pl = *plpn) {
-		mutex_enter(&pl->pcl_lock);
-		pl->pcl_state = PCL_INVALID;
-		*plpn = pl->pcl_parent_next;
-		pl->pcl_child_pc = NULL;
-		pl->pcl_parent_next = NULL;
-		pcachelink_locked_rele(pl);
-	}
-
-	plpn = &pcp->pc_children;
-	for (pl = pcp->pc_children; pl != NULL; pl = *plpn) {
-		mutex_enter(&pl->pcl_lock);
-		pl->pcl_state = PCL_INVALID;
-		*plpn = pl->pcl_child_next;
-		pl->pcl_parent_pc = NULL;
-		pl->pcl_child_next = NULL;
-		pcachelink_locked_rele(pl);
-	}
-
-	ASSERT(pcp->pc_parents == NULL);
-	ASSERT(pcp->pc_children == NULL);
-}
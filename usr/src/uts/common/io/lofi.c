@@ -172,6 +172,7 @@
 #include <sys/efi_partition.h>
 #include <sys/note.h>
 #include <LzmaDec.h>
+#include <lz4.h>
 
 #define	NBLOCKS_PROP_NAME	"Nblocks"
 #define	SIZE_PROP_NAME		"Size"
@@ -222,16 +223,25 @@ const char lofi_crypto_magic[6] = LOFI_CRYPTO_MAGIC;
  * when accessing small parts of a segment's data, we cache and reuse
  * the uncompressed segment's data.
  *
- * A single cached segment is sufficient to avoid lots of duplicate
- * segment decompress operations. A small cache size also reduces the
- * memory footprint.
- *
  * lofi_max_comp_cache is the maximum number of decompressed data segments
  * cached for each compressed lofi image. It can be set to 0 to disable
- * caching.
+ * caching.  The cache of an image is further limited to a fraction of
+ * physical memory, 1 / 2^lofi_comp_cache_memshift, so that an image with
+ * large segments cannot consume it.  Both limits apply to each image on its
+ * own; there is no limit on the caches of all images together.
+ *
+ * When a compressed image is read sequentially, the lofi_comp_readahead
+ * segments following a request are decompressed ahead of time, in parallel,
+ * by a task queue of the image with threads for lofi_comp_taskq_pct percent
+ * of the CPUs.  So are the segments of a request beyond its first, which the
+ * thread serving the request would otherwise decompress one at a time.  Read
+ * ahead is only done when the cache is enabled.
  */
 
-uint32_t lofi_max_comp_cache = 1;
+uint32_t lofi_max_comp_cache = 1024;
+uint32_t lofi_comp_cache_memshift = 10;
+uint32_t lofi_comp_readahead = 4;
+int lofi_comp_taskq_pct = 50;
 
 static int gzip_decompress(void *src, size_t srclen, void *dst,
 	size_t *destlen, int level);
@@ -239,14 +249,19 @@ static int gzip_decompress(void *src, size_t srclen, void *dst,
 static int lzma_decompress(void *src, size_t srclen, void *dst,
 	size_t *dstlen, int level);
 
+static int lz4_seg_decompress(void *src, size_t srclen, void *dst,
+	size_t *dstlen, int level);
+
 lofi_compress_info_t lofi_compress_table[LOFI_COMPRESS_FUNCTIONS] = {
 	{gzip_decompress,	NULL,	6,	"gzip"}, /* default */
 	{gzip_decompress,	NULL,	6,	"gzip-6"},
 	{gzip_decompress,	NULL,	9,	"gzip-9"},
-	{lzma_decompress,	NULL,	0,	"lzma"}
+	{lzma_decompress,	NULL,	0,	"lzma"},
+	{lz4_seg_decompress,	NULL,	0,	"lz4"}
 };
 
 static void lofi_strategy_task(void *);
+static void lofi_comp_readahead_task(void *);
 static int lofi_tg_rdwr(dev_info_t *, uchar_t, void *, diskaddr_t,
     size_t, void *);
 static int lofi_tg_getinfo(dev_info_t *, int, void *, void *);
@@ -283,11 +298,26 @@ lofi_free_comp_cache(struct lofi_state *lsp)
 	struct lofi_comp_cache *lc;
 
 	while ((lc = list_remove_head(&lsp->ls_comp_cache)) != NULL) {
+		avl_remove(&lsp->ls_comp_cache_avl, lc);
 		kmem_free(lc->lc_data, lsp->ls_uncomp_seg_sz);
 		kmem_free(lc, sizeof (struct lofi_comp_cache));
 		lsp->ls_comp_cache_count--;
 	}
 	ASSERT(lsp->ls_comp_cache_count == 0);
+	ASSERT(avl_numnodes(&lsp->ls_comp_cache_avl) == 0);
+}
+
+static int
+lofi_comp_cache_compare(const void *a, const void *b)
+{
+	const struct lofi_comp_cache *lca = a;
+	const struct lofi_comp_cache *lcb = b;
+
+	if (lca->lc_index < lcb->lc_index)
+		return (-1);
+	if (lca->lc_index > lcb->lc_index)
+		return (1);
+	return (0);
 }
 
 static int
@@ -539,6 +569,10 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 		taskq_destroy(lsp->ls_taskq);
 		lsp->ls_taskq = NULL;
 	}
+	if (lsp->ls_comp_taskq != NULL) {
+		taskq_destroy(lsp->ls_comp_taskq);
+		lsp->ls_comp_taskq = NULL;
+	}
 
 	list_remove(&lofi_list, lsp);
 
@@ -571,12 +605,17 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 		kstat_delete(lsp->ls_kstat);
 		lsp->ls_kstat = NULL;
 	}
+	if (lsp->ls_comp_kstat != NULL) {
+		kstat_delete(lsp->ls_comp_kstat);
+		lsp->ls_comp_kstat = NULL;
+	}
 
 	/*
 	 * Free cached decompressed segment data
 	 */
 	lofi_free_comp_cache(lsp);
 	list_destroy(&lsp->ls_comp_cache);
+	avl_destroy(&lsp->ls_comp_cache_avl);
 
 	if (lsp->ls_uncomp_seg_sz > 0) {
 		kmem_free(lsp->ls_comp_index_data, lsp->ls_comp_index_data_sz);
@@ -587,6 +626,7 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 	zone_rele_ref(&lsp->ls_zone, ZONE_REF_LOFI);
 
 	mutex_destroy(&lsp->ls_comp_cache_lock);
+	cv_destroy(&lsp->ls_comp_cache_cv);
 	mutex_destroy(&lsp->ls_comp_bufs_lock);
 	mutex_destroy(&lsp->ls_kstat_lock);
 	mutex_destroy(&lsp->ls_vp_lock);
@@ -1148,102 +1188,370 @@ lofi_mapped_rdwr(caddr_t bufaddr, offset_t offset, struct buf *bp,
 	return (error);
 }
 
+#define	LOFI_COMP_KSTAT(lsp, stat)	do {				\
+	if ((lsp)->ls_comp_kstat != NULL) {				\
+		((lofi_comp_kstat_t *)(lsp)->ls_comp_kstat->ks_data)->	\
+		    stat.value.ui64++;					\
+	}								\
+} while (0)
+
 /*
  * Check if segment seg_index is present in the decompressed segment
  * data cache.
  *
  * Returns a pointer to the decompressed segment data cache entry if
  * found, and NULL when decompressed data for this segment is not yet
- * cached.
+ * cached.  The entry's lc_data is NULL while the segment is still being
+ * decompressed.
  */
 static struct lofi_comp_cache *
 lofi_find_comp_data(struct lofi_state *lsp, uint64_t seg_index)
 {
-	struct lofi_comp_cache *lc;
+	struct lofi_comp_cache *lc, search;
 
 	ASSERT(MUTEX_HELD(&lsp->ls_comp_cache_lock));
 
-	for (lc = list_head(&lsp->ls_comp_cache); lc != NULL;
-	    lc = list_next(&lsp->ls_comp_cache, lc)) {
-		if (lc->lc_index == seg_index) {
-			/*
-			 * Decompressed segment data was found in the
-			 * cache.
-			 *
-			 * The cache uses an LRU replacement strategy;
-			 * move the entry to head of list.
-			 */
-			list_remove(&lsp->ls_comp_cache, lc);
-			list_insert_head(&lsp->ls_comp_cache, lc);
-			return (lc);
-		}
+	search.lc_index = seg_index;
+	lc = avl_find(&lsp->ls_comp_cache_avl, &search, NULL);
+	if (lc != NULL && lc->lc_data != NULL) {
+		/*
+		 * Decompressed segment data was found in the
+		 * cache.
+		 *
+		 * The cache uses an LRU replacement strategy;
+		 * move the entry to head of list.
+		 */
+		list_remove(&lsp->ls_comp_cache, lc);
+		list_insert_head(&lsp->ls_comp_cache, lc);
 	}
-	return (NULL);
+	return (lc);
 }
 
 /*
- * Add the data for a decompressed segment at segment index
- * seg_index to the cache of the decompressed segments.
- *
- * Returns a pointer to the cache element structure in case
- * the data was added to the cache; returns NULL when the data
- * wasn't cached.
+ * Add an entry for the segment at segment index seg_index to the cache
+ * of the decompressed segments, to be filled in by lofi_add_comp_data()
+ * once it has been decompressed.  Until then, others wanting the segment
+ * wait for it on ls_comp_cache_cv rather than decompress it themselves.
  */
 static struct lofi_comp_cache *
-lofi_add_comp_data(struct lofi_state *lsp, uint64_t seg_index,
-    uchar_t *data)
+lofi_reserve_comp_data(struct lofi_state *lsp, uint64_t seg_index)
 {
 	struct lofi_comp_cache *lc;
 
 	ASSERT(MUTEX_HELD(&lsp->ls_comp_cache_lock));
 
-	while (lsp->ls_comp_cache_count > lofi_max_comp_cache) {
-		lc = list_remove_tail(&lsp->ls_comp_cache);
-		ASSERT(lc != NULL);
-		kmem_free(lc->lc_data, lsp->ls_uncomp_seg_sz);
+	lc = kmem_zalloc(sizeof (struct lofi_comp_cache), KM_SLEEP);
+	lc->lc_index = seg_index;
+	lc->lc_lsp = lsp;
+	avl_add(&lsp->ls_comp_cache_avl, lc);
+	return (lc);
+}
+
+/*
+ * Complete a cache entry reserved with lofi_reserve_comp_data(), with
+ * the decompressed data for its segment; the cache takes ownership of
+ * data.  If data is NULL the segment could not be decompressed, and the
+ * entry is removed again.
+ */
+static void
+lofi_add_comp_data(struct lofi_state *lsp, struct lofi_comp_cache *lc,
+    uchar_t *data)
+{
+	struct lofi_comp_cache *old;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_comp_cache_lock));
+	ASSERT(lc->lc_data == NULL);
+
+	cv_broadcast(&lsp->ls_comp_cache_cv);
+
+	if (data == NULL) {
+		avl_remove(&lsp->ls_comp_cache_avl, lc);
 		kmem_free(lc, sizeof (struct lofi_comp_cache));
+		return;
+	}
+
+	/*
+	 * When the cache is full, free the least recently used
+	 * segment data to make room.  The new segment is added to
+	 * the head of the list.
+	 */
+	while (lsp->ls_comp_cache_count >= lsp->ls_comp_cache_max) {
+		old = list_remove_tail(&lsp->ls_comp_cache);
+		ASSERT(old != NULL);
+		avl_remove(&lsp->ls_comp_cache_avl, old);
+		kmem_free(old->lc_data, lsp->ls_uncomp_seg_sz);
+		kmem_free(old, sizeof (struct lofi_comp_cache));
 		lsp->ls_comp_cache_count--;
+		LOFI_COMP_KSTAT(lsp, lck_evictions);
+	}
+
+	lc->lc_data = data;
+	list_insert_head(&lsp->ls_comp_cache, lc);
+	lsp->ls_comp_cache_count++;
+
+	if (lsp->ls_comp_kstat != NULL) {
+		((lofi_comp_kstat_t *)lsp->ls_comp_kstat->ks_data)->
+		    lck_segments.value.ui64 = lsp->ls_comp_cache_count;
 	}
+}
+
+/*
+ * Read compressed segment seg_index from the image and decompress it into
+ * data, which has room for ls_uncomp_seg_sz bytes.
+ */
+static int
+lofi_decompress_seg(struct lofi_state *lsp, uint64_t seg_index,
+    uchar_t *data)
+{
+	lofi_compress_info_t *li;
+	struct buf rbuf;
+	uchar_t *compressed_seg, *cmpbuf;
+	u_offset_t salign, ealign, sdiff;
+	uint64_t cmpbytes;
+	size_t seglen, len;
+	int error, j;
+
+	ASSERT(lsp->ls_comp_algorithm_index >= 0);
+	if (seg_index >= lsp->ls_comp_index_sz - 1)
+		return (EIO);
+
+	li = &lofi_compress_table[lsp->ls_comp_algorithm_index];
+
+	/*
+	 * The last segment is special in that it is most likely
+	 * not going to be the same (uncompressed) size as the
+	 * other segments.
+	 */
+	if (seg_index == lsp->ls_comp_index_sz - 2)
+		seglen = lsp->ls_uncomp_last_seg_sz;
+	else
+		seglen = lsp->ls_uncomp_seg_sz;
 
 	/*
-	 * Do not cache when disabled by tunable variable
+	 * Each of the segment index entries contains the starting
+	 * block number for that segment.  The number of compressed
+	 * bytes in a segment is thus the difference between the
+	 * starting block number of this segment and the starting
+	 * block number of the next segment.
 	 */
-	if (lofi_max_comp_cache == 0)
-		return (NULL);
+	cmpbytes = lsp->ls_comp_seg_index[seg_index + 1] -
+	    lsp->ls_comp_seg_index[seg_index];
+	if (cmpbytes <= SEGHDR)
+		return (EIO);
 
 	/*
-	 * When the cache has not yet reached the maximum allowed
-	 * number of segments, allocate a new cache element.
-	 * Otherwise the cache is full; reuse the last list element
-	 * (LRU) for caching the decompressed segment data.
-	 *
-	 * The cache element for the new decompressed segment data is
-	 * added to the head of the list.
+	 * Align start offset to block boundary for segmap
 	 */
-	if (lsp->ls_comp_cache_count < lofi_max_comp_cache) {
-		lc = kmem_alloc(sizeof (struct lofi_comp_cache), KM_SLEEP);
-		lc->lc_data = NULL;
-		list_insert_head(&lsp->ls_comp_cache, lc);
-		lsp->ls_comp_cache_count++;
+	salign = lsp->ls_comp_seg_index[seg_index];
+	sdiff = salign & (DEV_BSIZE - 1);
+	salign -= sdiff;
+	if (seg_index + 1 >= lsp->ls_comp_index_sz - 1)
+		ealign = lsp->ls_vp_comp_size;
+	else
+		ealign = lsp->ls_comp_seg_index[seg_index + 1];
+	len = ealign - salign;
+
+	/*
+	 * Buffers to hold compressed segments are pre-allocated
+	 * for each thread of the strategy task queue.  Find one
+	 * that is not currently in use and mark it for use; the
+	 * read ahead threads may find none, and allocate their own.
+	 */
+	mutex_enter(&lsp->ls_comp_bufs_lock);
+	for (j = 0; j < lofi_taskq_nthreads; j++) {
+		if (lsp->ls_comp_bufs[j].inuse == 0) {
+			lsp->ls_comp_bufs[j].inuse = 1;
+			break;
+		}
+	}
+	mutex_exit(&lsp->ls_comp_bufs_lock);
+
+	if (j < lofi_taskq_nthreads) {
+		/*
+		 * If the pre-allocated buffer is too small for
+		 * this segment, re-allocate it with the
+		 * appropriate size
+		 */
+		if (lsp->ls_comp_bufs[j].bufsize < len) {
+			if (lsp->ls_comp_bufs[j].bufsize > 0)
+				kmem_free(lsp->ls_comp_bufs[j].buf,
+				    lsp->ls_comp_bufs[j].bufsize);
+			lsp->ls_comp_bufs[j].buf = kmem_alloc(len, KM_SLEEP);
+			lsp->ls_comp_bufs[j].bufsize = len;
+		}
+		compressed_seg = lsp->ls_comp_bufs[j].buf;
 	} else {
-		lc = list_remove_tail(&lsp->ls_comp_cache);
-		if (lc == NULL)
-			return (NULL);
-		list_insert_head(&lsp->ls_comp_cache, lc);
+		compressed_seg = kmem_alloc(len, KM_SLEEP);
 	}
 
 	/*
-	 * Free old uncompressed segment data when reusing a cache
-	 * entry.
+	 * Map in the calculated number of blocks
 	 */
-	if (lc->lc_data != NULL)
-		kmem_free(lc->lc_data, lsp->ls_uncomp_seg_sz);
+	bioinit(&rbuf);
+	rbuf.b_flags = B_READ;
+	rbuf.b_bcount = len;
+	error = lofi_mapped_rdwr((caddr_t)compressed_seg, salign, &rbuf, lsp);
+	biofini(&rbuf);
+	if (error != 0)
+		goto out;
 
-	lc->lc_data = data;
-	lc->lc_index = seg_index;
-	return (lc);
+	/*
+	 * The first byte in a compressed segment is a flag that
+	 * indicates whether this segment is compressed at all.
+	 */
+	cmpbuf = compressed_seg + sdiff;
+	if (*cmpbuf == UNCOMPRESSED) {
+		if (cmpbytes - SEGHDR < seglen)
+			error = EIO;
+		else
+			bcopy(cmpbuf + SEGHDR, data, seglen);
+	} else if (li->l_decompress(cmpbuf + SEGHDR, cmpbytes - SEGHDR,
+	    data, &seglen, li->l_level) != 0) {
+		error = EIO;
+	}
+
+out:
+	if (j < lofi_taskq_nthreads) {
+		mutex_enter(&lsp->ls_comp_bufs_lock);
+		lsp->ls_comp_bufs[j].inuse = 0;
+		mutex_exit(&lsp->ls_comp_bufs_lock);
+	} else {
+		kmem_free(compressed_seg, len);
+	}
+	return (error);
+}
+
+/*
+ * Copy len bytes at offset off of segment seg_index to bufaddr, from the
+ * cache if it is there, and otherwise decompressing it into the cache.
+ */
+static int
+lofi_read_comp_seg(struct lofi_state *lsp, uint64_t seg_index,
+    offset_t off, caddr_t bufaddr, size_t len)
+{
+	struct lofi_comp_cache *lc;
+	uchar_t *data;
+	int error;
+
+	data = NULL;
+	if (lsp->ls_comp_cache_max == 0) {
+		data = kmem_alloc(lsp->ls_uncomp_seg_sz, KM_SLEEP);
+		error = lofi_decompress_seg(lsp, seg_index, data);
+		if (error == 0)
+			bcopy(data + off, bufaddr, len);
+		kmem_free(data, lsp->ls_uncomp_seg_sz);
+		return (error);
+	}
+
+	mutex_enter(&lsp->ls_comp_cache_lock);
+	while ((lc = lofi_find_comp_data(lsp, seg_index)) != NULL &&
+	    lc->lc_data == NULL) {
+		cv_wait(&lsp->ls_comp_cache_cv, &lsp->ls_comp_cache_lock);
+	}
+	if (lc != NULL) {
+		/*
+		 * We've found the decompressed segment data in the
+		 * cache; reuse it.
+		 */
+		LOFI_COMP_KSTAT(lsp, lck_hits);
+		if (lc->lc_readahead) {
+			LOFI_COMP_KSTAT(lsp, lck_readahead_hits);
+			lc->lc_readahead = B_FALSE;
+		}
+		bcopy(lc->lc_data + off, bufaddr, len);
+		mutex_exit(&lsp->ls_comp_cache_lock);
+		return (0);
+	}
+	LOFI_COMP_KSTAT(lsp, lck_misses);
+	lc = lofi_reserve_comp_data(lsp, seg_index);
+	mutex_exit(&lsp->ls_comp_cache_lock);
+
+	data = kmem_alloc(lsp->ls_uncomp_seg_sz, KM_SLEEP);
+	error = lofi_decompress_seg(lsp, seg_index, data);
+	if (error == 0) {
+		bcopy(data + off, bufaddr, len);
+	} else {
+		kmem_free(data, lsp->ls_uncomp_seg_sz);
+		data = NULL;
+	}
+
+	mutex_enter(&lsp->ls_comp_cache_lock);
+	lofi_add_comp_data(lsp, lc, data);
+	mutex_exit(&lsp->ls_comp_cache_lock);
+	return (error);
+}
+
+/*
+ * Start decompressing the segments of a request after the first, and the
+ * lofi_comp_readahead segments after the request if it continues from the
+ * last, so that they are in the cache by the time they are read.
+ */
+static void
+lofi_comp_start_readahead(struct lofi_state *lsp, uint64_t sblkno,
+    uint64_t eblkno)
+{
+	struct lofi_comp_cache *lc;
+	uint64_t i, last;
+
+	if (lsp->ls_comp_taskq == NULL)
+		return;
+
+	mutex_enter(&lsp->ls_comp_cache_lock);
+	last = eblkno;
+	if (sblkno == lsp->ls_comp_last_seg ||
+	    sblkno == lsp->ls_comp_last_seg + 1)
+		last += lofi_comp_readahead;
+	last = MIN(last, lsp->ls_comp_index_sz - 2);
+	lsp->ls_comp_last_seg = eblkno;
+
+	for (i = sblkno + 1; i <= last; i++) {
+		if (lofi_find_comp_data(lsp, i) != NULL)
+			continue;
+
+		lc = lofi_reserve_comp_data(lsp, i);
+		lc->lc_readahead = B_TRUE;
+		if (taskq_dispatch(lsp->ls_comp_taskq,
+		    lofi_comp_readahead_task, lc, TQ_NOSLEEP) ==
+		    TASKQID_INVALID) {
+			lofi_add_comp_data(lsp, lc, NULL);
+			break;
+		}
+		LOFI_COMP_KSTAT(lsp, lck_readahead);
+	}
+	mutex_exit(&lsp->ls_comp_cache_lock);
 }
 
+static void
+lofi_comp_readahead_task(void *arg)
+{
+	struct lofi_comp_cache *lc = arg;
+	struct lofi_state *lsp = lc->lc_lsp;
+	uchar_t *data = NULL;
+
+	mutex_enter(&lsp->ls_vp_lock);
+	if (lsp->ls_vp == NULL || lsp->ls_vp_closereq) {
+		mutex_exit(&lsp->ls_vp_lock);
+		goto done;
+	}
+	lsp->ls_vp_iocount++;
+	mutex_exit(&lsp->ls_vp_lock);
+
+	data = kmem_alloc(lsp->ls_uncomp_seg_sz, KM_SLEEP);
+	if (lofi_decompress_seg(lsp, lc->lc_index, data) != 0) {
+		kmem_free(data, lsp->ls_uncomp_seg_sz);
+		data = NULL;
+	}
+
+	mutex_enter(&lsp->ls_vp_lock);
+	if (--lsp->ls_vp_iocount == 0)
+		cv_broadcast(&lsp->ls_vp_cv);
+	mutex_exit(&lsp->ls_vp_lock);
+
+done:
+	mutex_enter(&lsp->ls_comp_cache_lock);
+	lofi_add_comp_data(lsp, lc, data);
+	mutex_exit(&lsp->ls_comp_cache_lock);
+}
 
 /*ARGSUSED*/
 static int
@@ -1279,6 +1587,16 @@ lzma_decompress(void *src, size_t srclen, void *dst,
 	return (0);
 }
 
+/*ARGSUSED*/
+static int
+lz4_seg_decompress(void *src, size_t srclen, void *dst,
+    size_t *dstlen, int level)
+{
+	if (lz4_decompress(src, dst, srclen, *dstlen, level) != 0)
+		return (-1);
+	return (0);
+}
+
 /*
  * This is basically what strategy used to be before we found we
  * needed task queues.
@@ -1351,38 +1669,14 @@ lofi_strategy_task(void *arg)
 	} else if (lsp->ls_uncomp_seg_sz == 0) {
 		error = lofi_mapped_rdwr(bufaddr, offset, bp, lsp);
 	} else {
-		uchar_t *compressed_seg = NULL, *cmpbuf;
-		uchar_t *uncompressed_seg = NULL;
-		lofi_compress_info_t *li;
-		size_t oblkcount;
-		ulong_t seglen;
-		uint64_t sblkno, eblkno, cmpbytes;
-		uint64_t uncompressed_seg_index;
-		struct lofi_comp_cache *lc;
-		offset_t sblkoff, eblkoff;
-		u_offset_t salign, ealign;
-		u_offset_t sdiff;
-		uint32_t comp_data_sz;
-		uint64_t i;
-		int j;
+		uint64_t sblkno, eblkno, i;
+		offset_t sblkoff;
 
 		/*
 		 * From here on we're dealing primarily with compressed files
 		 */
 		ASSERT(!lsp->ls_crypto_enabled);
 
-		/*
-		 * Compressed files can only be read from and
-		 * not written to
-		 */
-		if (!(bp->b_flags & B_READ)) {
-			bp->b_resid = bp->b_bcount;
-			error = EROFS;
-			goto done;
-		}
-
-		ASSERT(lsp->ls_comp_algorithm_index >= 0);
-		li = &lofi_compress_table[lsp->ls_comp_algorithm_index];
 		/*
 		 * Compute starting and ending compressed segment numbers
 		 * We use only bitwise operations avoiding division and
@@ -1391,222 +1685,47 @@ lofi_strategy_task(void *arg)
 		 */
 		sblkno = offset >> lsp->ls_comp_seg_shift;
 		sblkoff = offset & (lsp->ls_uncomp_seg_sz - 1);
-		eblkno = (offset + bp->b_bcount) >> lsp->ls_comp_seg_shift;
-		eblkoff = (offset + bp->b_bcount) & (lsp->ls_uncomp_seg_sz - 1);
 
 		/*
-		 * Check the decompressed segment cache.
-		 *
-		 * The cache is used only when the requested data
-		 * is within a segment. Requests that cross
-		 * segment boundaries bypass the cache.
+		 * Compressed files can only be read from and
+		 * not written to
 		 */
-		if (sblkno == eblkno ||
-		    (sblkno + 1 == eblkno && eblkoff == 0)) {
-			/*
-			 * Request doesn't cross a segment boundary,
-			 * now check the cache.
-			 */
-			mutex_enter(&lsp->ls_comp_cache_lock);
-			lc = lofi_find_comp_data(lsp, sblkno);
-			if (lc != NULL) {
-				/*
-				 * We've found the decompressed segment
-				 * data in the cache; reuse it.
-				 */
-				bcopy(lc->lc_data + sblkoff, bufaddr,
-				    bp->b_bcount);
-				mutex_exit(&lsp->ls_comp_cache_lock);
-				bp->b_resid = 0;
-				error = 0;
-				goto done;
-			}
-			mutex_exit(&lsp->ls_comp_cache_lock);
-		}
+		bp->b_resid = bp->b_bcount;
+		if (!(bp->b_flags & B_READ)) {
+			error = EROFS;
+		} else if (bp->b_bcount == 0) {
+			/* There is no last segment, nor anything to read */
+			error = 0;
+		} else {
+			eblkno = (offset + bp->b_bcount - 1) >>
+			    lsp->ls_comp_seg_shift;
 
-		/*
-		 * Align start offset to block boundary for segmap
-		 */
-		salign = lsp->ls_comp_seg_index[sblkno];
-		sdiff = salign & (DEV_BSIZE - 1);
-		salign -= sdiff;
-		if (eblkno >= (lsp->ls_comp_index_sz - 1)) {
 			/*
-			 * We're dealing with the last segment of
-			 * the compressed file -- the size of this
-			 * segment *may not* be the same as the
-			 * segment size for the file
+			 * Have the read ahead threads decompress the rest of
+			 * the request's segments, and those following a
+			 * sequential read, while we work on the first.
 			 */
-			eblkoff = (offset + bp->b_bcount) &
-			    (lsp->ls_uncomp_last_seg_sz - 1);
-			ealign = lsp->ls_vp_comp_size;
-		} else {
-			ealign = lsp->ls_comp_seg_index[eblkno + 1];
+			lofi_comp_start_readahead(lsp, sblkno, eblkno);
+			error = 0;
 		}
 
-		/*
-		 * Preserve original request paramaters
-		 */
-		oblkcount = bp->b_bcount;
-
-		/*
-		 * Assign the calculated parameters
-		 */
-		comp_data_sz = ealign - salign;
-		bp->b_bcount = comp_data_sz;
-
-		/*
-		 * Buffers to hold compressed segments are pre-allocated
-		 * on a per-thread basis. Find a pre-allocated buffer
-		 * that is not currently in use and mark it for use.
-		 */
-		mutex_enter(&lsp->ls_comp_bufs_lock);
-		for (j = 0; j < lofi_taskq_nthreads; j++) {
-			if (lsp->ls_comp_bufs[j].inuse == 0) {
-				lsp->ls_comp_bufs[j].inuse = 1;
+		for (i = sblkno; error == 0 && bp->b_resid > 0; i++) {
+			if (i >= lsp->ls_comp_index_sz - 1) {
+				error = EIO;
 				break;
 			}
-		}
-
-		mutex_exit(&lsp->ls_comp_bufs_lock);
-		ASSERT(j < lofi_taskq_nthreads);
-
-		/*
-		 * If the pre-allocated buffer size does not match
-		 * the size of the I/O request, re-allocate it with
-		 * the appropriate size
-		 */
-		if (lsp->ls_comp_bufs[j].bufsize < bp->b_bcount) {
-			if (lsp->ls_comp_bufs[j].bufsize > 0)
-				kmem_free(lsp->ls_comp_bufs[j].buf,
-				    lsp->ls_comp_bufs[j].bufsize);
-			lsp->ls_comp_bufs[j].buf = kmem_alloc(bp->b_bcount,
-			    KM_SLEEP);
-			lsp->ls_comp_bufs[j].bufsize = bp->b_bcount;
-		}
-		compressed_seg = lsp->ls_comp_bufs[j].buf;
-
-		/*
-		 * Map in the calculated number of blocks
-		 */
-		error = lofi_mapped_rdwr((caddr_t)compressed_seg, salign,
-		    bp, lsp);
-
-		bp->b_bcount = oblkcount;
-		bp->b_resid = oblkcount;
-		if (error != 0)
-			goto done;
-
-		/*
-		 * decompress compressed blocks start
-		 */
-		cmpbuf = compressed_seg + sdiff;
-		for (i = sblkno; i <= eblkno; i++) {
-			ASSERT(i < lsp->ls_comp_index_sz - 1);
-			uchar_t *useg;
-
-			/*
-			 * The last segment is special in that it is
-			 * most likely not going to be the same
-			 * (uncompressed) size as the other segments.
-			 */
-			if (i == (lsp->ls_comp_index_sz - 2)) {
-				seglen = lsp->ls_uncomp_last_seg_sz;
-			} else {
-				seglen = lsp->ls_uncomp_seg_sz;
-			}
-
-			/*
-			 * Each of the segment index entries contains
-			 * the starting block number for that segment.
-			 * The number of compressed bytes in a segment
-			 * is thus the difference between the starting
-			 * block number of this segment and the starting
-			 * block number of the next segment.
-			 */
-			cmpbytes = lsp->ls_comp_seg_index[i + 1] -
-			    lsp->ls_comp_seg_index[i];
-
-			/*
-			 * The first byte in a compressed segment is a flag
-			 * that indicates whether this segment is compressed
-			 * at all.
-			 *
-			 * The variable 'useg' is used (instead of
-			 * uncompressed_seg) in this loop to keep a
-			 * reference to the uncompressed segment.
-			 *
-			 * N.B. If 'useg' is replaced with uncompressed_seg,
-			 * it leads to memory leaks and heap corruption in
-			 * corner cases where compressed segments lie
-			 * adjacent to uncompressed segments.
-			 */
-			if (*cmpbuf == UNCOMPRESSED) {
-				useg = cmpbuf + SEGHDR;
-			} else {
-				if (uncompressed_seg == NULL)
-					uncompressed_seg =
-					    kmem_alloc(lsp->ls_uncomp_seg_sz,
-					    KM_SLEEP);
-				useg = uncompressed_seg;
-				uncompressed_seg_index = i;
-
-				if (li->l_decompress((cmpbuf + SEGHDR),
-				    (cmpbytes - SEGHDR), uncompressed_seg,
-				    &seglen, li->l_level) != 0) {
-					error = EIO;
-					goto done;
-				}
-			}
-
-			/*
-			 * Determine how much uncompressed data we
-			 * have to copy and copy it
-			 */
-			xfersize = lsp->ls_uncomp_seg_sz - sblkoff;
-			if (i == eblkno)
-				xfersize -= (lsp->ls_uncomp_seg_sz - eblkoff);
 
-			bcopy((useg + sblkoff), bufaddr, xfersize);
+			xfersize = MIN(lsp->ls_uncomp_seg_sz - sblkoff,
+			    bp->b_resid);
+			error = lofi_read_comp_seg(lsp, i, sblkoff, bufaddr,
+			    xfersize);
+			if (error != 0)
+				break;
 
-			cmpbuf += cmpbytes;
 			bufaddr += xfersize;
 			bp->b_resid -= xfersize;
 			sblkoff = 0;
-
-			if (bp->b_resid == 0)
-				break;
-		} /* decompress compressed blocks ends */
-
-		/*
-		 * Skip to done if there is no uncompressed data to cache
-		 */
-		if (uncompressed_seg == NULL)
-			goto done;
-
-		/*
-		 * Add the data for the last decompressed segment to
-		 * the cache.
-		 *
-		 * In case the uncompressed segment data was added to (and
-		 * is referenced by) the cache, make sure we don't free it
-		 * here.
-		 */
-		mutex_enter(&lsp->ls_comp_cache_lock);
-		if ((lc = lofi_add_comp_data(lsp, uncompressed_seg_index,
-		    uncompressed_seg)) != NULL) {
-			uncompressed_seg = NULL;
 		}
-		mutex_exit(&lsp->ls_comp_cache_lock);
-
-done:
-		if (compressed_seg != NULL) {
-			mutex_enter(&lsp->ls_comp_bufs_lock);
-			lsp->ls_comp_bufs[j].inuse = 0;
-			mutex_exit(&lsp->ls_comp_bufs_lock);
-		}
-		if (uncompressed_seg != NULL)
-			kmem_free(uncompressed_seg, lsp->ls_uncomp_seg_sz);
 	} /* end of handling compressed files */
 
 	if ((error == 0) && (syncflag != 0))
@@ -1933,6 +2052,7 @@ lofi_online_dev(dev_info_t *dip)
 
 	cv_init(&lsp->ls_vp_cv, NULL, CV_DRIVER, NULL);
 	mutex_init(&lsp->ls_comp_cache_lock, NULL, MUTEX_DRIVER, NULL);
+	cv_init(&lsp->ls_comp_cache_cv, NULL, CV_DRIVER, NULL);
 	mutex_init(&lsp->ls_comp_bufs_lock, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&lsp->ls_kstat_lock, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&lsp->ls_vp_lock, NULL, MUTEX_DRIVER, NULL);
@@ -1971,6 +2091,7 @@ merr:
 	lofi_zone_unbind(lsp);
 lerr:
 	mutex_destroy(&lsp->ls_comp_cache_lock);
+	cv_destroy(&lsp->ls_comp_cache_cv);
 	mutex_destroy(&lsp->ls_comp_bufs_lock);
 	mutex_destroy(&lsp->ls_kstat_lock);
 	mutex_destroy(&lsp->ls_vp_lock);
@@ -2613,6 +2734,52 @@ lofi_compress_select(const char *signature)
 	return (-1);
 }
 
+/*
+ * Size the decompressed segment cache of a compressed image, and set up
+ * the task queue to read ahead into it and the statistics on its use.
+ */
+static void
+lofi_init_comp_cache(struct lofi_state *lsp)
+{
+	char namebuf[TASKQ_NAMELEN];
+	lofi_comp_kstat_t *lck;
+	uint64_t maxsegs;
+	int id = LOFI_MINOR2ID(getminor(lsp->ls_dev));
+
+	maxsegs = (ptob((uint64_t)physmem) >> lofi_comp_cache_memshift) /
+	    lsp->ls_uncomp_seg_sz;
+	maxsegs = MAX(maxsegs, 1);
+	lsp->ls_comp_cache_max = MIN(maxsegs, lofi_max_comp_cache);
+	lsp->ls_comp_last_seg = UINT64_MAX;
+
+	if (lsp->ls_comp_cache_max > 1 && lofi_comp_readahead > 0) {
+		(void) snprintf(namebuf, sizeof (namebuf), "%s_comp_taskq_%d",
+		    LOFI_DRIVER_NAME, id);
+		lsp->ls_comp_taskq = taskq_create_proc(namebuf,
+		    lofi_comp_taskq_pct, minclsyspri, 1, INT_MAX,
+		    curzone->zone_zsched, TASKQ_THREADS_CPU_PCT);
+	}
+
+	lsp->ls_comp_kstat = kstat_create_zone(LOFI_DRIVER_NAME, id,
+	    "compcache", "misc", KSTAT_TYPE_NAMED,
+	    sizeof (lofi_comp_kstat_t) / sizeof (kstat_named_t), 0,
+	    getzoneid());
+	if (lsp->ls_comp_kstat == NULL)
+		return;
+
+	lck = lsp->ls_comp_kstat->ks_data;
+	kstat_named_init(&lck->lck_hits, "hits", KSTAT_DATA_UINT64);
+	kstat_named_init(&lck->lck_misses, "misses", KSTAT_DATA_UINT64);
+	kstat_named_init(&lck->lck_readahead, "readahead", KSTAT_DATA_UINT64);
+	kstat_named_init(&lck->lck_readahead_hits, "readahead_hits",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&lck->lck_evictions, "evictions", KSTAT_DATA_UINT64);
+	kstat_named_init(&lck->lck_segments, "segments", KSTAT_DATA_UINT64);
+	lsp->ls_comp_kstat->ks_lock = &lsp->ls_comp_cache_lock;
+	kstat_zone_add(lsp->ls_comp_kstat, GLOBAL_ZONEID);
+	kstat_install(lsp->ls_comp_kstat);
+}
+
 static int
 lofi_init_compress(struct lofi_state *lsp)
 {
@@ -2644,7 +2811,11 @@ lofi_init_compress(struct lofi_state *lsp)
 	lsp->ls_comp_bufs = kmem_zalloc(lofi_taskq_nthreads *
 	    sizeof (struct compbuf), KM_SLEEP);
 
-	return (lofi_map_compressed_file(lsp, buf));
+	if ((error = lofi_map_compressed_file(lsp, buf)) != 0)
+		return (error);
+
+	lofi_init_comp_cache(lsp);
+	return (0);
 }
 
 /*
@@ -2886,6 +3057,9 @@ lofi_map_file(dev_t dev, struct lofi_ioctl *ulip, int pickminor,
 
 	list_create(&lsp->ls_comp_cache, sizeof (struct lofi_comp_cache),
 	    offsetof(struct lofi_comp_cache, lc_list));
+	avl_create(&lsp->ls_comp_cache_avl, lofi_comp_cache_compare,
+	    sizeof (struct lofi_comp_cache),
+	    offsetof(struct lofi_comp_cache, lc_avl));
 
 	/*
 	 * save open mode so file can be closed properly and vnode counts
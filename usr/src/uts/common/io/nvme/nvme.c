@@ -43,6 +43,25 @@
  * handler will retrieve completed commands from all queues sharing an interrupt
  * vector and will post them to a taskq for completion processing.
  *
+ * As blkdev selects a queue by the submitting CPU, the MSI-X vector of each
+ * I/O completion queue is bound to the first CPU that submits to it. With as
+ * many I/O queues as CPUs this means that each CPU owns a queue pair and its
+ * interrupt. This can be disabled with the "io-queue-affinity" property.
+ *
+ * Interrupt coalescing, where the device holds back an interrupt until either
+ * a number of completions is pending or some time has passed, is a setting of
+ * the whole controller, of which single vectors can only opt out. By default
+ * the driver leaves it alone. With the "adaptive" policy it adapts it to the
+ * load instead: every nvme_coal_interval_ms a thread
+ * estimates the number of commands in flight on each vector from the
+ * completion rate and average latency of its queues, and raises coalescing a
+ * profile at a time while the busiest vector keeps twice the threshold of the
+ * next profile in flight. It is lowered as soon as that no longer holds.
+ * Vectors with less than nvme_coal_min_depth commands in flight have
+ * coalescing disabled, so that a synchronous I/O stream never waits for the
+ * aggregation time. The "intr-coalescing" property selects the policy, the
+ * settings in use are reported by the intr_coal kstat.
+ *
  *
  * Command Processing:
  *
@@ -79,6 +98,28 @@
  * way, and then repeatedly attempt a command retrieval until it gets the
  * command back.
  *
+ * Additionally, a number of I/O queue pairs can be set aside for polled
+ * completion ("io-poll-queues"). These are created after the interrupt driven
+ * queues, with their own completion queues that have interrupts disabled and
+ * are not part of n_cq. Each polled queue pair has a poller thread which sleeps
+ * while the queue is idle and is woken up by the submission of a command. In
+ * hybrid mode (the default) the poller first sleeps for half the average
+ * completion latency of the queue, and then spins on the completion queue until
+ * all commands have completed and the queue has stayed idle for a short while.
+ * Completed commands are handed to their callbacks directly from the poller
+ * instead of going through a taskq. If the poller spins for too long without
+ * seeing a completion, it backs off and sleeps for a few microseconds at a
+ * time, as a clock tick would be longer than most commands take.
+ *
+ * I/O to namespaces listed in "io-poll-namespaces" is always posted to the
+ * polled queues, and if "io-poll-hipri" is set, so is any I/O that blkdev marks
+ * as latency sensitive (BD_XFER_HIPRI). Should a polled queue be full, the
+ * command is posted to the regular interrupt driven queue instead.
+ *
+ * For every I/O queue pair the driver maintains a histogram of completion
+ * latencies in power-of-two microsecond buckets, which is exported as the
+ * named kstat nvme:<instance>:ioq<N>.
+ *
  *
  * Namespace Support:
  *
@@ -99,6 +140,42 @@
  * 32bit minor node number.
  *
  *
+ * Multipathing:
+ *
+ * A dual-ported NVMe subsystem shows up as one controller per port, each of
+ * which reports the namespaces it shares with the other controllers. Such a
+ * shared namespace (NMIC) is identified by its NGUID, or EUI64 if it has no
+ * NGUID. All controllers attaching a namespace with the same identifier join
+ * a system-wide multipath group. The controller that attaches it first owns
+ * the group and creates the only blkdev instance for it, the other ones only
+ * add paths to the group. This requires the controllers to agree on the block
+ * size, capacity, memory page size and maximum transfer size of the namespace.
+ * The DMA cookies of a transfer are reused on whatever path the I/O is posted
+ * to, which is fine as long as the controllers share the same view of memory.
+ *
+ * Each I/O picks a path among those whose controller is alive and whose
+ * Asymmetric Namespace Access (ANA) state is optimized, or non-optimized if
+ * there are no optimized ones. Paths in the inaccessible, persistent loss and
+ * change states are never used. If no path is usable but some are in the
+ * change state, the I/O waits for the transition to complete, for up to the
+ * ANA Transition Time (ANATT) of their controllers. It is retried whenever an
+ * ANA change event is posted and every nvme_mpath_retry_ms, on a thread of
+ * nvme_mpath_taskq, and fails once ANATT has passed or the group goes away.
+ * By default the paths are used round-robin;
+ * with the "queue-depth" policy the path with the fewest outstanding I/O
+ * commands is used. The ANA state of a controller's namespaces is read from
+ * the ANA log page when the controller is initialized and whenever it posts an
+ * ANA change asynchronous event. Controllers not reporting ANA have all their
+ * namespaces in the optimized state.
+ *
+ * If an I/O fails because its controller died or because of a path related
+ * status, it is retried on another path, at most once per path. A path that
+ * failed with an ANA status is not used again until the next ANA change event.
+ * If the owning controller is detached, the blkdev instance and the group go
+ * away with it. The remaining paths are then unused until their controllers
+ * are reattached.
+ *
+ *
  * Minor nodes:
  *
  * For each NVMe device the driver exposes one minor node for the controller and
@@ -115,8 +192,9 @@
  * setup, and splitting of transfers into manageable chunks.
  *
  * I/O requests coming in from blkdev are turned into NVM commands and posted to
- * an I/O queue. The queue is selected by taking the CPU id modulo the number of
- * queues. There is currently no timeout handling of I/O commands.
+ * an I/O queue. The queue is the one blkdev selected, which is by default the
+ * sequential CPU id modulo the number of queues. There is currently no timeout
+ * handling of I/O commands.
  *
  * Blkdev also supports querying device/media information and generating a
  * devid. The driver reports the best block size as determined by the namespace
@@ -189,11 +267,23 @@
  * nvme_process_iocq(). nvme_process_iocq() is only called from the
  * interrupt thread and nvme_retrieve_cmd() during polled I/O, so the
  * mutex is non-contentious but is required for implementation completeness
- * and safety.
+ * and safety. The poller of a polled queue pair also calls
+ * nvme_retrieve_cmd(), and holds no locks while calling the completion
+ * callbacks. Its nq_poll_mutex only protects the poller state and is never held
+ * together with any other lock.
  *
  * Each minor node has its own nm_mutex, which protects the open count nm_ocnt
  * and exclusive-open flag nm_oexcl.
  *
+ * The list of multipath groups is protected by nvme_mpath_mutex, which is only
+ * taken when namespaces join or leave a group, and while a failed I/O is
+ * reposted to another path so that its group can't be freed meanwhile, or an
+ * I/O waiting out an ANA transition is retried. The paths of a group are
+ * protected by its nm_lock, which is held as reader while a path is selected
+ * for an I/O and as writer while paths are added or removed, and so are the
+ * I/Os waiting on the group. If both are held, nvme_mpath_mutex must be
+ * acquired first.
+ *
  *
  * Quiesce / Fast Reboot:
  *
@@ -248,13 +338,33 @@
  * - max-completion-queues: the maximum number of I/O completion queues,
  *   can be less than max-submission-queues, in which case the completion
  *   queues are shared.
+ * - io-poll-queues: the number of additional I/O queue pairs with polled
+ *   completion, 0 (the default) disables polled I/O.
+ * - io-poll-hybrid: can be set to 0 to have the pollers spin right away
+ *   instead of sleeping for half the average completion latency first
+ * - io-poll-namespaces: the IDs of the namespaces whose I/O is to be posted
+ *   to the polled queues
+ * - io-poll-hipri: can be set to 1 to post latency sensitive I/O of all
+ *   namespaces to the polled queues
+ * - io-queue-affinity: can be set to 0 to leave the placement of the I/O
+ *   queue interrupts to the system
+ * - multipath: can be set to 0 to use shared namespaces of this controller as
+ *   independent disks instead of merging them with those of other controllers
+ * - multipath-policy: how multipath I/O is spread across the paths of a
+ *   namespace, either "round-robin" (the default) or "queue-depth"
+ * - intr-coalescing: the interrupt coalescing policy, either "off" (the
+ *   default) to leave the device settings alone, "adaptive" to follow the I/O
+ *   load, or "static" to use intr-coal-threshold and intr-coal-time-us
+ * - intr-coal-threshold: the number of completions to coalesce in the static
+ *   policy (1-256)
+ * - intr-coal-time-us: the time to hold back an interrupt for in the static
+ *   policy, rounded up to a multiple of 100us (0-25500)
  *
  *
  * TODO:
  * - figure out sane default for I/O queue depth reported to blkdev
  * - FMA handling of media errors
  * - support for devices supporting very large I/O requests using chained PRPs
- * - support for configuring hardware parameters like interrupt coalescing
  * - support for media formatting and hard partitioning into namespaces
  * - support for big-endian systems
  * - support for fast reboot
@@ -273,6 +383,7 @@
 #include <sys/conf.h>
 #include <sys/devops.h>
 #include <sys/ddi.h>
+#include <sys/ddi_intr_impl.h>
 #include <sys/ddi_ufm.h>
 #include <sys/sunddi.h>
 #include <sys/sunndi.h>
@@ -281,6 +392,7 @@
 #include <sys/param.h>
 #include <sys/varargs.h>
 #include <sys/cpuvar.h>
+#include <sys/cpu.h>
 #include <sys/disp.h>
 #include <sys/blkdev.h>
 #include <sys/atomic.h>
@@ -306,6 +418,8 @@
  */
 CTASSERT(sizeof (nvme_identify_ctrl_t) == 0x1000);
 CTASSERT(offsetof(nvme_identify_ctrl_t, id_oacs) == 256);
+CTASSERT(offsetof(nvme_identify_ctrl_t, ap_anatt) == 342);
+CTASSERT(offsetof(nvme_identify_ctrl_t, ap_pels) == 352);
 CTASSERT(offsetof(nvme_identify_ctrl_t, id_sqes) == 512);
 CTASSERT(offsetof(nvme_identify_ctrl_t, id_oncs) == 520);
 CTASSERT(offsetof(nvme_identify_ctrl_t, id_subnqn) == 768);
@@ -315,6 +429,7 @@ CTASSERT(offsetof(nvme_identify_ctrl_t, id_vs) == 3072);
 
 CTASSERT(sizeof (nvme_identify_nsid_t) == 0x1000);
 CTASSERT(offsetof(nvme_identify_nsid_t, id_fpi) == 32);
+CTASSERT(offsetof(nvme_identify_nsid_t, id_anagrpid) == 92);
 CTASSERT(offsetof(nvme_identify_nsid_t, id_nguid) == 104);
 CTASSERT(offsetof(nvme_identify_nsid_t, id_lbaf) == 128);
 CTASSERT(offsetof(nvme_identify_nsid_t, id_vs) == 384);
@@ -323,6 +438,9 @@ CTASSERT(sizeof (nvme_identify_primary_caps_t) == 0x1000);
 CTASSERT(offsetof(nvme_identify_primary_caps_t, nipc_vqfrt) == 32);
 CTASSERT(offsetof(nvme_identify_primary_caps_t, nipc_vifrt) == 64);
 
+CTASSERT(sizeof (nvme_ana_log_t) == 16);
+CTASSERT(sizeof (nvme_ana_desc_t) == 32);
+
 
 /* NVMe spec version supported */
 static const int nvme_version_major = 1;
@@ -336,6 +454,52 @@ int nvme_format_cmd_timeout = 600;
 /* tunable for firmware commit with NVME_FWC_SAVE, default is 15s */
 int nvme_commit_save_cmd_timeout = 15;
 
+/* tunable for how long an idle poller keeps spinning, default is 20us */
+hrtime_t nvme_poll_idle_ns = 20 * NANOSEC / MICROSEC;
+
+/* tunable for how long a poller spins without a completion, default is 1ms */
+hrtime_t nvme_poll_spin_ns = NANOSEC / MILLISEC;
+
+/* tunable for how long a poller then sleeps between checks, default is 10us */
+hrtime_t nvme_poll_backoff_ns = 10 * NANOSEC / MICROSEC;
+
+/* tunable for how often I/O waiting out an ANA transition is retried */
+int nvme_mpath_retry_ms = 100;
+
+/* tunable for the adaptive interrupt coalescing interval, default is 100ms */
+int nvme_coal_interval_ms = 100;
+
+/* tunable for the rate a vector needs to be coalesced, default is 10k IOPS */
+uint64_t nvme_coal_min_rate = 10000;
+
+/* tunable for the commands in flight a vector needs to be coalesced */
+uint64_t nvme_coal_min_depth = 2;
+
+/* tunable for the intervals to wait before raising coalescing */
+uint_t nvme_coal_raise_intervals = 3;
+
+/*
+ * Adaptive interrupt coalescing profiles, from none to the most aggressive.
+ * The threshold is in completion queue entries, the time in the 100us units
+ * of the Interrupt Coalescing feature.
+ */
+static const struct {
+	uint8_t ncp_thr;
+	uint8_t ncp_time;
+} nvme_coal_profiles[] = {
+	{ 1, 0 },
+	{ 4, 1 },
+	{ 8, 1 },
+	{ 16, 2 },
+	{ 32, 2 },
+};
+
+static const char *nvme_coal_policies[] = {
+	[NVME_COAL_OFF] = "off",
+	[NVME_COAL_ADAPTIVE] = "adaptive",
+	[NVME_COAL_STATIC] = "static",
+};
+
 static int nvme_attach(dev_info_t *, ddi_attach_cmd_t);
 static int nvme_detach(dev_info_t *, ddi_detach_cmd_t);
 static int nvme_quiesce(dev_info_t *);
@@ -366,6 +530,7 @@ static int nvme_check_vendor_cmd_status(nvme_cmd_t *);
 static int nvme_check_integrity_cmd_status(nvme_cmd_t *);
 static int nvme_check_specific_cmd_status(nvme_cmd_t *);
 static int nvme_check_generic_cmd_status(nvme_cmd_t *);
+static int nvme_check_path_cmd_status(nvme_cmd_t *);
 static inline int nvme_check_cmd_status(nvme_cmd_t *);
 
 static int nvme_abort_cmd(nvme_cmd_t *, uint_t);
@@ -375,6 +540,8 @@ static int nvme_format_nvm(nvme_t *, boolean_t, uint32_t, uint8_t, boolean_t,
 static int nvme_get_logpage(nvme_t *, boolean_t, void **, size_t *, uint8_t,
     ...);
 static int nvme_identify(nvme_t *, boolean_t, uint32_t, void **);
+static int nvme_set_features_cmd(nvme_t *, boolean_t, uint8_t, uint32_t,
+    uint32_t *);
 static int nvme_set_features(nvme_t *, boolean_t, uint32_t, uint8_t, uint32_t,
     uint32_t *);
 static int nvme_get_features(nvme_t *, boolean_t, uint32_t, uint8_t, uint32_t *,
@@ -390,6 +557,13 @@ static int nvme_zalloc_queue_dma(nvme_t *, uint32_t, uint16_t, uint_t,
 static void nvme_free_qpair(nvme_qpair_t *);
 static int nvme_alloc_qpair(nvme_t *, uint32_t, nvme_qpair_t **, uint_t);
 static int nvme_create_io_qpair(nvme_t *, nvme_qpair_t *, uint16_t);
+static void nvme_poll_thread(void *);
+static void nvme_coal_init(nvme_t *);
+static void nvme_coal_fini(nvme_t *);
+static void nvme_coal_thread(void *);
+static void nvme_poll_wakeup(nvme_qpair_t *);
+static void nvme_qpair_kstat_init(nvme_t *, nvme_qpair_t *, uint_t);
+static void nvme_bind_interrupts(nvme_t *);
 
 static inline void nvme_put64(nvme_t *, uintptr_t, uint64_t);
 static inline void nvme_put32(nvme_t *, uintptr_t, uint32_t);
@@ -410,6 +584,16 @@ static int nvme_bd_write(void *, bd_xfer_t *);
 static int nvme_bd_sync(void *, bd_xfer_t *);
 static int nvme_bd_devid(void *, dev_info_t *, ddi_devid_t *);
 static int nvme_bd_free_space(void *, bd_xfer_t *);
+static int nvme_bd_submit(nvme_namespace_t *, bd_xfer_t *, uint8_t,
+    boolean_t, uint_t);
+
+static boolean_t nvme_mpath_register(nvme_namespace_t *);
+static void nvme_mpath_unregister(nvme_namespace_t *);
+static nvme_namespace_t *nvme_mpath_select(nvme_mpath_t *, uint_t *,
+    nvme_namespace_t *);
+static int nvme_mpath_cmd(nvme_mpath_t *, nvme_namespace_t *, bd_xfer_t *,
+    uint8_t, uint_t);
+static void nvme_ana_update(nvme_t *);
 
 static int nvme_prp_dma_constructor(void *, void *, int);
 static void nvme_prp_dma_destructor(void *, void *);
@@ -582,6 +766,14 @@ static bd_ops_t nvme_bd_ops = {
 static struct list nvme_lost_cmds;
 static kmutex_t nvme_lc_mutex;
 
+/*
+ * Multipath groups of the namespaces shared by several controllers.
+ */
+static list_t nvme_mpaths;
+static kmutex_t nvme_mpath_mutex;
+static kcondvar_t nvme_mpath_cv;
+static taskq_t *nvme_mpath_taskq;
+
 int
 _init(void)
 {
@@ -598,6 +790,13 @@ _init(void)
 	list_create(&nvme_lost_cmds, sizeof (nvme_cmd_t),
 	    offsetof(nvme_cmd_t, nc_list));
 
+	mutex_init(&nvme_mpath_mutex, NULL, MUTEX_DRIVER, NULL);
+	cv_init(&nvme_mpath_cv, NULL, CV_DRIVER, NULL);
+	list_create(&nvme_mpaths, sizeof (nvme_mpath_t),
+	    offsetof(nvme_mpath_t, nm_node));
+	nvme_mpath_taskq = taskq_create("nvme_mpath_taskq", 1, minclsyspri,
+	    1, INT_MAX, TASKQ_DYNAMIC);
+
 	bd_mod_init(&nvme_dev_ops);
 
 	error = mod_install(&nvme_modlinkage);
@@ -605,6 +804,10 @@ _init(void)
 		ddi_soft_state_fini(&nvme_state);
 		mutex_destroy(&nvme_lc_mutex);
 		list_destroy(&nvme_lost_cmds);
+		taskq_destroy(nvme_mpath_taskq);
+		mutex_destroy(&nvme_mpath_mutex);
+		cv_destroy(&nvme_mpath_cv);
+		list_destroy(&nvme_mpaths);
 		bd_mod_fini(&nvme_dev_ops);
 	}
 
@@ -625,6 +828,10 @@ _fini(void)
 		kmem_cache_destroy(nvme_cmd_cache);
 		mutex_destroy(&nvme_lc_mutex);
 		list_destroy(&nvme_lost_cmds);
+		taskq_destroy(nvme_mpath_taskq);
+		mutex_destroy(&nvme_mpath_mutex);
+		cv_destroy(&nvme_mpath_cv);
+		list_destroy(&nvme_mpaths);
 		bd_mod_fini(&nvme_dev_ops);
 	}
 
@@ -867,8 +1074,25 @@ nvme_free_qpair(nvme_qpair_t *qp)
 {
 	int i;
 
+	if (qp->nq_poll_thread != NULL) {
+		mutex_enter(&qp->nq_poll_mutex);
+		qp->nq_poll_exit = B_TRUE;
+		cv_signal(&qp->nq_poll_cv);
+		mutex_exit(&qp->nq_poll_mutex);
+		thread_join(qp->nq_poll_did);
+	}
+
+	if (qp->nq_ksp != NULL)
+		kstat_delete(qp->nq_ksp);
+
+	/* The completion queue of a polled queue pair is never shared. */
+	if (qp->nq_poll && qp->nq_cq != NULL)
+		nvme_free_cq(qp->nq_cq);
+
 	mutex_destroy(&qp->nq_mutex);
 	sema_destroy(&qp->nq_sema);
+	mutex_destroy(&qp->nq_poll_mutex);
+	cv_destroy(&qp->nq_poll_cv);
 
 	if (qp->nq_sqdma != NULL)
 		nvme_free_dma(qp->nq_sqdma);
@@ -920,8 +1144,15 @@ nvme_alloc_cq(nvme_t *nvme, uint32_t nentry, nvme_cq_t **cqp, uint16_t idx,
 	cq->ncq_hdbl = NVME_REG_CQHDBL(nvme, idx);
 
 	/*
-	 * Each completion queue has its own command taskq.
+	 * Each completion queue has its own command taskq, except for those
+	 * of polled queue pairs which complete their commands directly.
 	 */
+	if (nthr == 0) {
+		cq->ncq_poll = B_TRUE;
+		*cqp = cq;
+		return (DDI_SUCCESS);
+	}
+
 	(void) snprintf(name, sizeof (name), "%s%d_cmd_taskq%u",
 	    ddi_driver_name(nvme->n_dip), ddi_get_instance(nvme->n_dip), idx);
 
@@ -995,8 +1226,11 @@ nvme_alloc_qpair(nvme_t *nvme, uint32_t nentry, nvme_qpair_t **nqp,
 	nvme_qpair_t *qp = kmem_zalloc(sizeof (*qp), KM_SLEEP);
 	uint_t cq_idx;
 
+	qp->nq_nvme = nvme;
 	mutex_init(&qp->nq_mutex, NULL, MUTEX_DRIVER,
 	    DDI_INTR_PRI(nvme->n_intr_pri));
+	mutex_init(&qp->nq_poll_mutex, NULL, MUTEX_DRIVER, NULL);
+	cv_init(&qp->nq_poll_cv, NULL, CV_DRIVER, NULL);
 
 	/*
 	 * The NVMe spec defines that a full queue has one empty (unused) slot;
@@ -1009,10 +1243,20 @@ nvme_alloc_qpair(nvme_t *nvme, uint32_t nentry, nvme_qpair_t **nqp,
 		goto fail;
 
 	/*
-	 * idx == 0 is adminq, those above 0 are shared io completion queues.
+	 * idx == 0 is adminq, those above 0 are shared io completion queues,
+	 * and those above n_ioq_count are polled queue pairs with a completion
+	 * queue of their own.
 	 */
-	cq_idx = idx == 0 ? 0 : 1 + (idx - 1) % (nvme->n_cq_count - 1);
-	qp->nq_cq = nvme->n_cq[cq_idx];
+	if (idx > nvme->n_ioq_count) {
+		qp->nq_poll = B_TRUE;
+		cq_idx = nvme->n_completion_queues + idx - nvme->n_ioq_count;
+		if (nvme_alloc_cq(nvme, nentry, &qp->nq_cq, cq_idx, 0) !=
+		    DDI_SUCCESS)
+			goto fail;
+	} else {
+		cq_idx = idx == 0 ? 0 : 1 + (idx - 1) % (nvme->n_cq_count - 1);
+		qp->nq_cq = nvme->n_cq[cq_idx];
+	}
 	qp->nq_sq = (nvme_sqe_t *)qp->nq_sqdma->nd_memp;
 	qp->nq_nentry = nentry;
 
@@ -1089,6 +1333,7 @@ nvme_submit_io_cmd(nvme_qpair_t *qp, nvme_cmd_t *cmd)
 	if (sema_tryp(&qp->nq_sema) == 0)
 		return (EAGAIN);
 
+	cmd->nc_submit = gethrtime();
 	nvme_submit_cmd_common(qp, cmd);
 	return (0);
 }
@@ -1147,6 +1392,26 @@ nvme_unqueue_cmd(nvme_t *nvme, nvme_qpair_t *qp, int cid)
 	return (cmd);
 }
 
+/*
+ * Account for the completion latency of an I/O command in the histogram of its
+ * queue pair, and update the moving average used by hybrid polling.
+ */
+static void
+nvme_account_latency(nvme_qpair_t *qp, hrtime_t lat)
+{
+	nvme_qstat_t *qs = &qp->nq_stat;
+	uint64_t usec = lat / (NANOSEC / MICROSEC);
+	uint_t bucket = usec == 0 ? 0 : highbit64(usec);
+
+	ASSERT(mutex_owned(&qp->nq_mutex));
+
+	qs->nqs_lat[MIN(bucket, NVME_LAT_BUCKETS - 1)].value.ui64++;
+	qs->nqs_cmds.value.ui64++;
+
+	qp->nq_lat_avg += (lat - qp->nq_lat_avg) / 8;
+	qs->nqs_lat_avg.value.ui64 = qp->nq_lat_avg;
+}
+
 /*
  * Get the command tied to the next completed cqe and bump along completion
  * queue head counter.
@@ -1170,6 +1435,8 @@ nvme_get_completed(nvme_t *nvme, nvme_cq_t *cq)
 
 	mutex_enter(&qp->nq_mutex);
 	cmd = nvme_unqueue_cmd(nvme, qp, cqe->cqe_cid);
+	if (cmd->nc_submit != 0)
+		nvme_account_latency(qp, gethrtime() - cmd->nc_submit);
 	mutex_exit(&qp->nq_mutex);
 
 	ASSERT(cmd->nc_sqid == cqe->cqe_sqid);
@@ -1216,6 +1483,9 @@ nvme_process_iocq(nvme_t *nvme, nvme_cq_t *cq)
 		 */
 		head.b.cqhdbl_cqh = cq->ncq_head;
 		nvme_put32(nvme, cq->ncq_hdbl, head.r);
+
+		cq->ncq_intrs++;
+		cq->ncq_intr_cmds += completed;
 	}
 
 	mutex_exit(&cq->ncq_mutex);
@@ -1247,6 +1517,93 @@ nvme_retrieve_cmd(nvme_t *nvme, nvme_qpair_t *qp)
 	return (cmd);
 }
 
+/*
+ * Wake up the poller of a polled queue pair after a command was submitted.
+ */
+static void
+nvme_poll_wakeup(nvme_qpair_t *qp)
+{
+	ASSERT(qp->nq_poll);
+
+	mutex_enter(&qp->nq_poll_mutex);
+	qp->nq_poll_wanted = B_TRUE;
+	cv_signal(&qp->nq_poll_cv);
+	mutex_exit(&qp->nq_poll_mutex);
+}
+
+/*
+ * The poller of a polled queue pair. It sleeps until a command is submitted,
+ * in hybrid mode waits for half the average completion latency, and then spins
+ * on the completion queue, calling the completion callbacks directly, until
+ * the queue pair has been idle for nvme_poll_idle_ns. A command which takes
+ * longer than nvme_poll_spin_ns is then waited for in short sleeps of
+ * nvme_poll_backoff_ns.
+ */
+static void
+nvme_poll_thread(void *arg)
+{
+	nvme_qpair_t *qp = arg;
+	nvme_t *nvme = qp->nq_nvme;
+	nvme_cmd_t *cmd;
+	hrtime_t now, last;
+	boolean_t done;
+
+	mutex_enter(&qp->nq_poll_mutex);
+	for (;;) {
+		while (!qp->nq_poll_wanted && !qp->nq_poll_exit)
+			cv_wait(&qp->nq_poll_cv, &qp->nq_poll_mutex);
+
+		if (qp->nq_poll_exit)
+			break;
+
+		qp->nq_poll_wanted = B_FALSE;
+
+		if (nvme->n_poll_hybrid && qp->nq_lat_avg > 0) {
+			(void) cv_timedwait_hires(&qp->nq_poll_cv,
+			    &qp->nq_poll_mutex, qp->nq_lat_avg / 2,
+			    NANOSEC / MICROSEC, 0);
+		}
+		mutex_exit(&qp->nq_poll_mutex);
+
+		last = gethrtime();
+		while (!nvme->n_dead) {
+			done = B_FALSE;
+			while ((cmd = nvme_retrieve_cmd(nvme, qp)) != NULL) {
+				cmd->nc_callback(cmd);
+				done = B_TRUE;
+			}
+
+			now = gethrtime();
+			if (done) {
+				last = now;
+			} else if (qp->nq_active_cmds == 0) {
+				if (now - last > nvme_poll_idle_ns)
+					break;
+			} else if (now - last > nvme_poll_spin_ns) {
+				/*
+				 * The device is taking its time, so don't
+				 * hog the CPU waiting for it; but sleeping
+				 * for a clock tick would add far more to the
+				 * latency than polling is meant to save.
+				 */
+				mutex_enter(&qp->nq_poll_mutex);
+				(void) cv_timedwait_hires(&qp->nq_poll_cv,
+				    &qp->nq_poll_mutex, nvme_poll_backoff_ns,
+				    NANOSEC / MICROSEC, 0);
+				mutex_exit(&qp->nq_poll_mutex);
+				continue;
+			}
+
+			SMT_PAUSE();
+		}
+
+		mutex_enter(&qp->nq_poll_mutex);
+	}
+	mutex_exit(&qp->nq_poll_mutex);
+
+	thread_exit();
+}
+
 static int
 nvme_check_unknown_cmd_status(nvme_cmd_t *cmd)
 {
@@ -1312,6 +1669,37 @@ nvme_check_integrity_cmd_status(nvme_cmd_t *cmd)
 	}
 }
 
+static int
+nvme_check_path_cmd_status(nvme_cmd_t *cmd)
+{
+	nvme_cqe_t *cqe = &cmd->nc_cqe;
+	nvme_namespace_t *ns = cmd->nc_ns;
+
+	switch (cqe->cqe_sf.sf_sc) {
+	case NVME_CQE_SC_PATH_ANA_PLOSS:
+	case NVME_CQE_SC_PATH_ANA_INACC:
+	case NVME_CQE_SC_PATH_ANA_TRANS:
+		/*
+		 * The namespace isn't accessible through this controller right
+		 * now. Stop using this path until the next ANA change event.
+		 */
+		atomic_inc_32(&cmd->nc_nvme->n_ana_err);
+		if (ns != NULL) {
+			ns->ns_ana_state =
+			    cqe->cqe_sf.sf_sc == NVME_CQE_SC_PATH_ANA_PLOSS ?
+			    NVME_ANA_PERSIST_LOSS :
+			    cqe->cqe_sf.sf_sc == NVME_CQE_SC_PATH_ANA_INACC ?
+			    NVME_ANA_INACCESSIBLE : NVME_ANA_CHANGE;
+		}
+		return (EIO);
+
+	default:
+		/* internal, controller or host pathing error */
+		atomic_inc_32(&cmd->nc_nvme->n_path_err);
+		return (EIO);
+	}
+}
+
 static int
 nvme_check_generic_cmd_status(nvme_cmd_t *cmd)
 {
@@ -1586,6 +1974,8 @@ nvme_check_cmd_status(nvme_cmd_t *cmd)
 		return (nvme_check_specific_cmd_status(cmd));
 	else if (cqe->cqe_sf.sf_sct == NVME_CQE_SCT_INTEGRITY)
 		return (nvme_check_integrity_cmd_status(cmd));
+	else if (cqe->cqe_sf.sf_sct == NVME_CQE_SCT_PATH)
+		return (nvme_check_path_cmd_status(cmd));
 	else if (cqe->cqe_sf.sf_sct == NVME_CQE_SCT_VENDOR)
 		return (nvme_check_vendor_cmd_status(cmd));
 
@@ -1863,6 +2253,23 @@ nvme_async_event_task(void *arg)
 		}
 		break;
 
+	case NVME_ASYNC_TYPE_NOTICE:
+		if (event.b.ae_info == NVME_ASYNC_NOTICE_ANA &&
+		    event.b.ae_logpage == NVME_LOGPAGE_ANA) {
+			/*
+			 * Reading the log page acknowledges the event.
+			 */
+			nvme_ana_update(nvme);
+			atomic_inc_32(&nvme->n_ana_event);
+			break;
+		}
+
+		dev_err(nvme->n_dip, CE_WARN, "!unknown notice async event "
+		    "received, info = %x, logpage = %x", event.b.ae_info,
+		    event.b.ae_logpage);
+		atomic_inc_32(&nvme->n_unknown_event);
+		break;
+
 	case NVME_ASYNC_TYPE_VENDOR:
 		dev_err(nvme->n_dip, CE_WARN, "!vendor specific async event "
 		    "received, info = %x, logpage = %x", event.b.ae_info,
@@ -1994,6 +2401,18 @@ nvme_get_logpage(nvme_t *nvme, boolean_t user, void **buf, size_t *bufsize,
 		*bufsize = sizeof (nvme_fwslot_log_t);
 		break;
 
+	case NVME_LOGPAGE_ANA:
+		/*
+		 * We know the ANA group of each namespace from its identify
+		 * data, so we only need the group descriptors. The log is
+		 * limited to 2 pages like the error log.
+		 */
+		cmd->nc_sqe.sqe_nsid = (uint32_t)-1;
+		getlogpage.b.lp_lsp = NVME_ANA_LSP_RGO;
+		*bufsize = MIN(2 * nvme->n_pagesize, sizeof (nvme_ana_log_t) +
+		    nvme->n_idctl->ap_nanagrpid * sizeof (nvme_ana_desc_t));
+		break;
+
 	default:
 		dev_err(nvme->n_dip, CE_WARN, "!unknown log page requested: %d",
 		    logpage);
@@ -2115,6 +2534,20 @@ nvme_set_features(nvme_t *nvme, boolean_t user, uint32_t nsid, uint8_t feature,
     uint32_t val, uint32_t *res)
 {
 	_NOTE(ARGUNUSED(nsid));
+
+	return (nvme_set_features_cmd(nvme, user, feature, val, res));
+}
+
+/*
+ * Issue a SET FEATURES command. With "dontpanic" set, an error status which
+ * would otherwise indicate a driver bug is returned as an error instead, as
+ * for the commands of users, and for optional features which devices may
+ * reject.
+ */
+static int
+nvme_set_features_cmd(nvme_t *nvme, boolean_t dontpanic, uint8_t feature,
+    uint32_t val, uint32_t *res)
+{
 	nvme_cmd_t *cmd = nvme_alloc_cmd(nvme, KM_SLEEP);
 	int ret = EINVAL;
 
@@ -2125,9 +2558,7 @@ nvme_set_features(nvme_t *nvme, boolean_t user, uint32_t nsid, uint8_t feature,
 	cmd->nc_sqe.sqe_opc = NVME_OPC_SET_FEATURES;
 	cmd->nc_sqe.sqe_cdw10 = feature;
 	cmd->nc_sqe.sqe_cdw11 = val;
-
-	if (user)
-		cmd->nc_dontpanic = B_TRUE;
+	cmd->nc_dontpanic = dontpanic;
 
 	switch (feature) {
 	case NVME_FEAT_WRITE_CACHE:
@@ -2136,6 +2567,9 @@ nvme_set_features(nvme_t *nvme, boolean_t user, uint32_t nsid, uint8_t feature,
 		break;
 
 	case NVME_FEAT_NQUEUES:
+	case NVME_FEAT_INTR_COAL:
+	case NVME_FEAT_INTR_VECT:
+	case NVME_FEAT_ASYNC_EVENT:
 		break;
 
 	default:
@@ -2354,20 +2788,32 @@ nvme_set_nqueues(nvme_t *nvme)
 	ASSERT(nvme->n_submission_queues > 0);
 	ASSERT(nvme->n_completion_queues > 0);
 
-	nq.b.nq_nsq = nvme->n_submission_queues - 1;
-	nq.b.nq_ncq = nvme->n_completion_queues - 1;
+	/*
+	 * Each polled queue pair needs a submission and a completion queue
+	 * in addition to the interrupt driven ones.
+	 */
+	nvme->n_poll_queues = MIN(nvme->n_poll_queues,
+	    UINT16_MAX - nvme->n_submission_queues);
+
+	nq.b.nq_nsq = nvme->n_submission_queues + nvme->n_poll_queues - 1;
+	nq.b.nq_ncq = nvme->n_completion_queues + nvme->n_poll_queues - 1;
 
 	ret = nvme_set_features(nvme, B_FALSE, 0, NVME_FEAT_NQUEUES, nq.r,
 	    &nq.r);
 
 	if (ret == 0) {
 		/*
-		 * Never use more than the requested number of queues.
+		 * Never use more than the requested number of queues. The
+		 * interrupt driven queues take precedence, polled queues only
+		 * get what is left over.
 		 */
 		nvme->n_submission_queues = MIN(nvme->n_submission_queues,
 		    nq.b.nq_nsq + 1);
 		nvme->n_completion_queues = MIN(nvme->n_completion_queues,
 		    nq.b.nq_ncq + 1);
+		nvme->n_poll_queues = MIN(nvme->n_poll_queues,
+		    MIN(nq.b.nq_nsq + 1 - nvme->n_submission_queues,
+		    nq.b.nq_ncq + 1 - nvme->n_completion_queues));
 	}
 
 	return (ret);
@@ -2385,8 +2831,10 @@ nvme_create_completion_queue(nvme_t *nvme, nvme_cq_t *cq)
 	dw10.b.q_qsize = cq->ncq_nentry - 1;
 
 	c_dw11.b.cq_pc = 1;
-	c_dw11.b.cq_ien = 1;
-	c_dw11.b.cq_iv = cq->ncq_id % nvme->n_intr_cnt;
+	if (!cq->ncq_poll) {
+		c_dw11.b.cq_ien = 1;
+		c_dw11.b.cq_iv = cq->ncq_id % nvme->n_intr_cnt;
+	}
 
 	cmd->nc_sqid = 0;
 	cmd->nc_callback = nvme_wakeup_cmd;
@@ -2420,9 +2868,10 @@ nvme_create_io_qpair(nvme_t *nvme, nvme_qpair_t *qp, uint16_t idx)
 	/*
 	 * It is possible to have more qpairs than completion queues,
 	 * and when the idx > ncq_id, that completion queue is shared
-	 * and has already been created.
+	 * and has already been created. Polled qpairs always have their
+	 * own completion queue.
 	 */
-	if (idx <= cq->ncq_id &&
+	if ((idx <= cq->ncq_id || cq->ncq_poll) &&
 	    nvme_create_completion_queue(nvme, cq) != DDI_SUCCESS)
 		return (DDI_FAILURE);
 
@@ -2453,119 +2902,562 @@ nvme_create_io_qpair(nvme_t *nvme, nvme_qpair_t *qp, uint16_t idx)
 	return (ret);
 }
 
-static boolean_t
-nvme_reset(nvme_t *nvme, boolean_t quiesce)
+static void
+nvme_qpair_kstat_init(nvme_t *nvme, nvme_qpair_t *qp, uint_t idx)
 {
-	nvme_reg_csts_t csts;
-	int i;
-
-	nvme_put32(nvme, NVME_REG_CC, 0);
+	nvme_qstat_t *qs = &qp->nq_stat;
+	char name[KSTAT_STRLEN];
+	uint_t i;
 
-	csts.r = nvme_get32(nvme, NVME_REG_CSTS);
-	if (csts.b.csts_rdy == 1) {
-		nvme_put32(nvme, NVME_REG_CC, 0);
-		for (i = 0; i != nvme->n_timeout * 10; i++) {
-			csts.r = nvme_get32(nvme, NVME_REG_CSTS);
-			if (csts.b.csts_rdy == 0)
-				break;
+	(void) snprintf(name, sizeof (name), "ioq%u", idx);
+	qp->nq_ksp = kstat_create(ddi_driver_name(nvme->n_dip),
+	    ddi_get_instance(nvme->n_dip), name, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (nvme_qstat_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
 
-			if (quiesce)
-				drv_usecwait(50000);
-			else
-				delay(drv_usectohz(50000));
-		}
+	if (qp->nq_ksp == NULL) {
+		dev_err(nvme->n_dip, CE_WARN,
+		    "!failed to create kstats for I/O qpair %u", idx);
+		return;
 	}
 
-	nvme_put32(nvme, NVME_REG_AQA, 0);
-	nvme_put32(nvme, NVME_REG_ASQ, 0);
-	nvme_put32(nvme, NVME_REG_ACQ, 0);
+	kstat_named_init(&qs->nqs_cmds, "commands", KSTAT_DATA_UINT64);
+	kstat_named_init(&qs->nqs_lat_avg, "lat_avg_ns", KSTAT_DATA_UINT64);
+	kstat_named_init(&qs->nqs_depth, "depth", KSTAT_DATA_UINT64);
+	kstat_named_init(&qs->nqs_coalesced, "coalesced", KSTAT_DATA_UINT32);
 
-	csts.r = nvme_get32(nvme, NVME_REG_CSTS);
-	return (csts.b.csts_rdy == 0 ? B_TRUE : B_FALSE);
+	/*
+	 * Bucket n counts latencies below 2^n microseconds, the last one
+	 * everything else.
+	 */
+	for (i = 0; i != NVME_LAT_BUCKETS - 1; i++) {
+		(void) snprintf(name, sizeof (name), "lat_lt_%lluus",
+		    1ULL << i);
+		kstat_named_init(&qs->nqs_lat[i], name, KSTAT_DATA_UINT64);
+	}
+	(void) snprintf(name, sizeof (name), "lat_ge_%lluus", 1ULL << (i - 1));
+	kstat_named_init(&qs->nqs_lat[i], name, KSTAT_DATA_UINT64);
+
+	qp->nq_ksp->ks_data = qs;
+	qp->nq_ksp->ks_lock = &qp->nq_mutex;
+	kstat_install(qp->nq_ksp);
 }
 
-static void
-nvme_shutdown(nvme_t *nvme, int mode, boolean_t quiesce)
+/*
+ * Program the controller wide Interrupt Coalescing feature. The threshold is
+ * in entries, the time in units of 100us. Devices ignoring the feature may
+ * reject it as an invalid field, which mustn't panic the system.
+ */
+static int
+nvme_coal_set(nvme_t *nvme, uint_t thr, uint_t time)
 {
-	nvme_reg_cc_t cc;
-	nvme_reg_csts_t csts;
-	int i;
+	nvme_coalstat_t *cs = &nvme->n_coal_stat;
+	nvme_intr_coal_t ic = { 0 };
+	uint32_t res;
 
-	ASSERT(mode == NVME_CC_SHN_NORMAL || mode == NVME_CC_SHN_ABRUPT);
+	ic.b.ic_thr = thr - 1;
+	ic.b.ic_time = time;
 
-	cc.r = nvme_get32(nvme, NVME_REG_CC);
-	cc.b.cc_shn = mode & 0x3;
-	nvme_put32(nvme, NVME_REG_CC, cc.r);
+	if (nvme_set_features_cmd(nvme, B_TRUE, NVME_FEAT_INTR_COAL, ic.r,
+	    &res) != 0) {
+		cs->ncs_errors.value.ui64++;
+		return (EIO);
+	}
 
-	for (i = 0; i != 10; i++) {
-		csts.r = nvme_get32(nvme, NVME_REG_CSTS);
-		if (csts.b.csts_shst == NVME_CSTS_SHN_COMPLETE)
-			break;
+	cs->ncs_threshold.value.ui32 = thr;
+	cs->ncs_time_us.value.ui32 = time * 100;
+	cs->ncs_changes.value.ui64++;
+	return (0);
+}
 
-		if (quiesce)
-			drv_usecwait(100000);
-		else
-			delay(drv_usectohz(100000));
+/*
+ * Set or clear Coalescing Disable for an interrupt vector.
+ */
+static int
+nvme_coal_vect(nvme_t *nvme, uint_t vect, boolean_t disable)
+{
+	nvme_coalstat_t *cs = &nvme->n_coal_stat;
+	nvme_intr_vect_t iv = { 0 };
+	uint32_t res;
+
+	iv.b.iv_iv = vect;
+	iv.b.iv_cd = disable ? 1 : 0;
+
+	if (nvme_set_features_cmd(nvme, B_TRUE, NVME_FEAT_INTR_VECT, iv.r,
+	    &res) != 0) {
+		cs->ncs_errors.value.ui64++;
+		return (EIO);
 	}
+
+	nvme->n_coal_vec[vect].ncv_disabled = disable;
+	cs->ncs_changes.value.ui64++;
+	return (0);
 }
 
+/*
+ * Vector 0 serves I/O completion queues only if there are more of them than
+ * vectors, otherwise it is the admin queue's alone.
+ */
+static boolean_t
+nvme_coal_vect_used(nvme_t *nvme, uint_t vect)
+{
+	return (vect != 0 || nvme->n_cq_count > nvme->n_intr_cnt);
+}
 
 static void
-nvme_prepare_devid(nvme_t *nvme, uint32_t nsid)
+nvme_coal_disable(nvme_t *nvme)
 {
-	/*
-	 * Section 7.7 of the spec describes how to get a unique ID for
-	 * the controller: the vendor ID, the model name and the serial
-	 * number shall be unique when combined.
-	 *
-	 * If a namespace has no EUI64 we use the above and add the hex
-	 * namespace ID to get a unique ID for the namespace.
-	 */
-	char model[sizeof (nvme->n_idctl->id_model) + 1];
-	char serial[sizeof (nvme->n_idctl->id_serial) + 1];
+	dev_err(nvme->n_dip, CE_WARN, "!interrupt coalescing settings "
+	    "rejected, disabling adaptive interrupt coalescing");
+	nvme->n_coal_policy = NVME_COAL_OFF;
+	(void) strlcpy(nvme->n_coal_stat.ncs_policy.value.c,
+	    nvme_coal_policies[NVME_COAL_OFF],
+	    sizeof (nvme->n_coal_stat.ncs_policy.value.c));
+}
 
-	bcopy(nvme->n_idctl->id_model, model, sizeof (nvme->n_idctl->id_model));
-	bcopy(nvme->n_idctl->id_serial, serial,
-	    sizeof (nvme->n_idctl->id_serial));
+/*
+ * One interval of the adaptive coalescing policy. The average number of
+ * commands in flight on each queue pair is its completion rate times its
+ * average latency, which unlike a snapshot of nq_active_cmds doesn't depend on
+ * when it is taken. Coalescing is raised one profile at a time once the
+ * busiest vector has wanted more for nvme_coal_raise_intervals, and is lowered
+ * right away when the load drops, as holding completions back is what costs.
+ */
+static void
+nvme_coal_update(nvme_t *nvme)
+{
+	nvme_coalstat_t *cs = &nvme->n_coal_stat;
+	nvme_coal_vec_t *cv;
+	uint64_t iops = 0, intrs = 0, icmds = 0, depth = 0, rate = 0;
+	hrtime_t now = gethrtime();
+	hrtime_t elapsed = now - nvme->n_coal_sampled;
+	uint_t i, target, prof, ndisabled = 0;
+
+	if (elapsed <= 0)
+		return;
+	nvme->n_coal_sampled = now;
 
-	model[sizeof (nvme->n_idctl->id_model)] = '\0';
-	serial[sizeof (nvme->n_idctl->id_serial)] = '\0';
+	for (i = 0; i != nvme->n_intr_cnt; i++) {
+		nvme->n_coal_vec[i].ncv_rate = 0;
+		nvme->n_coal_vec[i].ncv_depth = 0;
+	}
 
-	nvme->n_ns[nsid - 1].ns_devid = kmem_asprintf("%4X-%s-%s-%X",
-	    nvme->n_idctl->id_vid, model, serial, nsid);
-}
+	for (i = 1; i != nvme->n_ioq_count + 1; i++) {
+		nvme_qpair_t *qp = nvme->n_ioq[i];
+		uint64_t cmds, qrate, qdepth;
 
-static int
-nvme_init_ns(nvme_t *nvme, int nsid)
-{
-	nvme_namespace_t *ns = &nvme->n_ns[nsid - 1];
-	nvme_identify_nsid_t *idns;
-	boolean_t was_ignored;
-	int last_rp;
+		cv = &nvme->n_coal_vec[qp->nq_cq->ncq_id % nvme->n_intr_cnt];
 
-	ns->ns_nvme = nvme;
+		mutex_enter(&qp->nq_mutex);
+		cmds = qp->nq_stat.nqs_cmds.value.ui64;
+		qrate = (cmds - qp->nq_coal_cmds) * NANOSEC / elapsed;
+		qdepth = qrate * qp->nq_lat_avg / NANOSEC;
+		qp->nq_coal_cmds = cmds;
+		qp->nq_stat.nqs_depth.value.ui64 = qdepth;
+		mutex_exit(&qp->nq_mutex);
 
-	if (nvme_identify(nvme, B_FALSE, nsid, (void **)&idns) != 0) {
-		dev_err(nvme->n_dip, CE_WARN,
-		    "!failed to identify namespace %d", nsid);
-		return (DDI_FAILURE);
+		cv->ncv_rate += qrate;
+		cv->ncv_depth += qdepth;
+		iops += qrate;
 	}
 
-	ns->ns_idns = idns;
-	ns->ns_id = nsid;
-	ns->ns_block_count = idns->id_nsize;
-	ns->ns_block_size =
-	    1 << idns->id_lbaf[idns->id_flbas.lba_format].lbaf_lbads;
-	ns->ns_best_block_size = ns->ns_block_size;
+	for (i = 1; i != nvme->n_cq_count; i++) {
+		nvme_cq_t *cq = nvme->n_cq[i];
 
-	/*
-	 * Get the EUI64 if present. Use it for devid and device node names.
-	 */
-	if (NVME_VERSION_ATLEAST(&nvme->n_version, 1, 1))
-		bcopy(idns->id_eui64, ns->ns_eui64, sizeof (ns->ns_eui64));
+		mutex_enter(&cq->ncq_mutex);
+		intrs += cq->ncq_intrs;
+		icmds += cq->ncq_intr_cmds;
+		mutex_exit(&cq->ncq_mutex);
+	}
 
-	/*LINTED: E_BAD_PTR_CAST_ALIGN*/
-	if (*(uint64_t *)ns->ns_eui64 != 0) {
+	cs->ncs_iops.value.ui64 = iops;
+	if (intrs != nvme->n_coal_intrs) {
+		cs->ncs_intr_cmds.value.ui64 =
+		    (icmds - nvme->n_coal_intr_cmds) * 100 /
+		    (intrs - nvme->n_coal_intrs);
+	}
+	nvme->n_coal_intrs = intrs;
+	nvme->n_coal_intr_cmds = icmds;
+
+	for (i = 0; i != nvme->n_intr_cnt; i++) {
+		if (nvme->n_coal_vec[i].ncv_depth > depth) {
+			depth = nvme->n_coal_vec[i].ncv_depth;
+			rate = nvme->n_coal_vec[i].ncv_rate;
+		}
+	}
+
+	target = 0;
+	if (rate >= nvme_coal_min_rate) {
+		for (target = ARRAY_SIZE(nvme_coal_profiles) - 1; target > 0;
+		    target--) {
+			if (depth >= 2 * nvme_coal_profiles[target].ncp_thr)
+				break;
+		}
+	}
+
+	prof = nvme->n_coal_profile;
+	if (target <= prof) {
+		nvme->n_coal_raise = 0;
+		prof = target;
+	} else if (++nvme->n_coal_raise >= nvme_coal_raise_intervals) {
+		nvme->n_coal_raise = 0;
+		prof++;
+	}
+
+	if (prof != nvme->n_coal_profile) {
+		if (nvme_coal_set(nvme, nvme_coal_profiles[prof].ncp_thr,
+		    nvme_coal_profiles[prof].ncp_time) != 0) {
+			nvme_coal_disable(nvme);
+			return;
+		}
+		nvme->n_coal_profile = prof;
+		cs->ncs_profile.value.ui32 = prof;
+	}
+
+	/*
+	 * Without coalescing the vector settings don't matter, so leave them
+	 * until they do.
+	 */
+	for (i = 0; i != nvme->n_intr_cnt; i++) {
+		boolean_t disable;
+
+		cv = &nvme->n_coal_vec[i];
+		if (!nvme_coal_vect_used(nvme, i))
+			continue;
+
+		disable = cv->ncv_depth < nvme_coal_min_depth;
+		if (prof != 0 && disable != cv->ncv_disabled &&
+		    nvme_coal_vect(nvme, i, disable) != 0) {
+			nvme_coal_disable(nvme);
+			return;
+		}
+
+		if (cv->ncv_disabled)
+			ndisabled++;
+	}
+	cs->ncs_vect_disabled.value.ui32 = ndisabled;
+
+	for (i = 1; i != nvme->n_ioq_count + 1; i++) {
+		nvme_qpair_t *qp = nvme->n_ioq[i];
+
+		cv = &nvme->n_coal_vec[qp->nq_cq->ncq_id % nvme->n_intr_cnt];
+
+		mutex_enter(&qp->nq_mutex);
+		qp->nq_stat.nqs_coalesced.value.ui32 =
+		    prof != 0 && !cv->ncv_disabled;
+		mutex_exit(&qp->nq_mutex);
+	}
+}
+
+/*
+ * The adaptive coalescing thread. It issues admin commands, which may sleep,
+ * so this can't be done from a timeout. It starts from a known state, with
+ * coalescing off and no vector opted out of it.
+ */
+static void
+nvme_coal_thread(void *arg)
+{
+	nvme_t *nvme = arg;
+	clock_t interval;
+	uint_t i;
+
+	/*
+	 * As in the loop below, a dead controller is left alone; its commands
+	 * would only time out.
+	 */
+	if (!nvme->n_dead && nvme_coal_set(nvme, nvme_coal_profiles[0].ncp_thr,
+	    nvme_coal_profiles[0].ncp_time) != 0) {
+		nvme_coal_disable(nvme);
+	} else {
+		for (i = 0; i != nvme->n_intr_cnt && !nvme->n_dead; i++) {
+			if (nvme_coal_vect_used(nvme, i) &&
+			    nvme_coal_vect(nvme, i, B_FALSE) != 0) {
+				nvme_coal_disable(nvme);
+				break;
+			}
+		}
+	}
+	nvme->n_coal_sampled = gethrtime();
+
+	mutex_enter(&nvme->n_coal_mutex);
+	while (!nvme->n_coal_exit) {
+		interval = drv_usectohz(MAX(nvme_coal_interval_ms, 1) *
+		    (MICROSEC / MILLISEC));
+		(void) cv_reltimedwait(&nvme->n_coal_cv, &nvme->n_coal_mutex,
+		    interval, TR_CLOCK_TICK);
+
+		if (nvme->n_coal_exit)
+			break;
+		if (nvme->n_coal_policy != NVME_COAL_ADAPTIVE || nvme->n_dead)
+			continue;
+
+		mutex_exit(&nvme->n_coal_mutex);
+		nvme_coal_update(nvme);
+		mutex_enter(&nvme->n_coal_mutex);
+	}
+	mutex_exit(&nvme->n_coal_mutex);
+
+	thread_exit();
+}
+
+/*
+ * Set up interrupt coalescing according to the "intr-coalescing" policy once
+ * the I/O queues exist.
+ */
+static void
+nvme_coal_init(nvme_t *nvme)
+{
+	nvme_coalstat_t *cs = &nvme->n_coal_stat;
+
+	mutex_init(&nvme->n_coal_mutex, NULL, MUTEX_DRIVER, NULL);
+	cv_init(&nvme->n_coal_cv, NULL, CV_DRIVER, NULL);
+	nvme->n_progress |= NVME_COAL_INIT;
+
+	kstat_named_init(&cs->ncs_policy, "policy", KSTAT_DATA_CHAR);
+	kstat_named_init(&cs->ncs_profile, "profile", KSTAT_DATA_UINT32);
+	kstat_named_init(&cs->ncs_threshold, "threshold", KSTAT_DATA_UINT32);
+	kstat_named_init(&cs->ncs_time_us, "time_us", KSTAT_DATA_UINT32);
+	kstat_named_init(&cs->ncs_vect_disabled, "vectors_disabled",
+	    KSTAT_DATA_UINT32);
+	kstat_named_init(&cs->ncs_iops, "iops", KSTAT_DATA_UINT64);
+	kstat_named_init(&cs->ncs_intr_cmds, "cmds_per_intr_x100",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&cs->ncs_changes, "changes", KSTAT_DATA_UINT64);
+	kstat_named_init(&cs->ncs_errors, "errors", KSTAT_DATA_UINT64);
+
+	if (nvme->n_ioq_count == 0)
+		nvme->n_coal_policy = NVME_COAL_OFF;
+
+	if (nvme->n_coal_policy == NVME_COAL_STATIC &&
+	    nvme_coal_set(nvme, nvme->n_coal_static.b.ic_thr + 1,
+	    nvme->n_coal_static.b.ic_time) != 0) {
+		dev_err(nvme->n_dip, CE_WARN, "!interrupt coalescing "
+		    "settings rejected");
+		nvme->n_coal_policy = NVME_COAL_OFF;
+	}
+
+	(void) strlcpy(cs->ncs_policy.value.c,
+	    nvme_coal_policies[nvme->n_coal_policy],
+	    sizeof (cs->ncs_policy.value.c));
+
+	nvme->n_coal_ksp = kstat_create(ddi_driver_name(nvme->n_dip),
+	    ddi_get_instance(nvme->n_dip), "intr_coal", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (nvme_coalstat_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (nvme->n_coal_ksp != NULL) {
+		nvme->n_coal_ksp->ks_data = cs;
+		kstat_install(nvme->n_coal_ksp);
+	} else {
+		dev_err(nvme->n_dip, CE_WARN,
+		    "!failed to create interrupt coalescing kstats");
+	}
+
+	if (nvme->n_coal_policy == NVME_COAL_ADAPTIVE) {
+		nvme->n_coal_vec = kmem_zalloc(sizeof (nvme_coal_vec_t) *
+		    nvme->n_intr_cnt, KM_SLEEP);
+		nvme->n_coal_thread = thread_create(NULL, 0, nvme_coal_thread,
+		    nvme, 0, &p0, TS_RUN, minclsyspri);
+		nvme->n_coal_did = nvme->n_coal_thread->t_did;
+	}
+}
+
+static void
+nvme_coal_fini(nvme_t *nvme)
+{
+	if (nvme->n_coal_thread != NULL) {
+		mutex_enter(&nvme->n_coal_mutex);
+		nvme->n_coal_exit = B_TRUE;
+		cv_signal(&nvme->n_coal_cv);
+		mutex_exit(&nvme->n_coal_mutex);
+		thread_join(nvme->n_coal_did);
+		nvme->n_coal_thread = NULL;
+	}
+
+	if (nvme->n_coal_vec != NULL) {
+		kmem_free(nvme->n_coal_vec, sizeof (nvme_coal_vec_t) *
+		    nvme->n_intr_cnt);
+		nvme->n_coal_vec = NULL;
+	}
+
+	if (nvme->n_coal_ksp != NULL) {
+		kstat_delete(nvme->n_coal_ksp);
+		nvme->n_coal_ksp = NULL;
+	}
+
+	cv_destroy(&nvme->n_coal_cv);
+	mutex_destroy(&nvme->n_coal_mutex);
+	nvme->n_progress &= ~NVME_COAL_INIT;
+}
+
+static boolean_t
+nvme_reset(nvme_t *nvme, boolean_t quiesce)
+{
+	nvme_reg_csts_t csts;
+	int i;
+
+	nvme_put32(nvme, NVME_REG_CC, 0);
+
+	csts.r = nvme_get32(nvme, NVME_REG_CSTS);
+	if (csts.b.csts_rdy == 1) {
+		nvme_put32(nvme, NVME_REG_CC, 0);
+		for (i = 0; i != nvme->n_timeout * 10; i++) {
+			csts.r = nvme_get32(nvme, NVME_REG_CSTS);
+			if (csts.b.csts_rdy == 0)
+				break;
+
+			if (quiesce)
+				drv_usecwait(50000);
+			else
+				delay(drv_usectohz(50000));
+		}
+	}
+
+	nvme_put32(nvme, NVME_REG_AQA, 0);
+	nvme_put32(nvme, NVME_REG_ASQ, 0);
+	nvme_put32(nvme, NVME_REG_ACQ, 0);
+
+	csts.r = nvme_get32(nvme, NVME_REG_CSTS);
+	return (csts.b.csts_rdy == 0 ? B_TRUE : B_FALSE);
+}
+
+static void
+nvme_shutdown(nvme_t *nvme, int mode, boolean_t quiesce)
+{
+	nvme_reg_cc_t cc;
+	nvme_reg_csts_t csts;
+	int i;
+
+	ASSERT(mode == NVME_CC_SHN_NORMAL || mode == NVME_CC_SHN_ABRUPT);
+
+	cc.r = nvme_get32(nvme, NVME_REG_CC);
+	cc.b.cc_shn = mode & 0x3;
+	nvme_put32(nvme, NVME_REG_CC, cc.r);
+
+	for (i = 0; i != 10; i++) {
+		csts.r = nvme_get32(nvme, NVME_REG_CSTS);
+		if (csts.b.csts_shst == NVME_CSTS_SHN_COMPLETE)
+			break;
+
+		if (quiesce)
+			drv_usecwait(100000);
+		else
+			delay(drv_usectohz(100000));
+	}
+}
+
+
+static void
+nvme_prepare_devid(nvme_t *nvme, uint32_t nsid)
+{
+	/*
+	 * Section 7.7 of the spec describes how to get a unique ID for
+	 * the controller: the vendor ID, the model name and the serial
+	 * number shall be unique when combined.
+	 *
+	 * If a namespace has no EUI64 we use the above and add the hex
+	 * namespace ID to get a unique ID for the namespace.
+	 */
+	char model[sizeof (nvme->n_idctl->id_model) + 1];
+	char serial[sizeof (nvme->n_idctl->id_serial) + 1];
+
+	bcopy(nvme->n_idctl->id_model, model, sizeof (nvme->n_idctl->id_model));
+	bcopy(nvme->n_idctl->id_serial, serial,
+	    sizeof (nvme->n_idctl->id_serial));
+
+	model[sizeof (nvme->n_idctl->id_model)] = '\0';
+	serial[sizeof (nvme->n_idctl->id_serial)] = '\0';
+
+	nvme->n_ns[nsid - 1].ns_devid = kmem_asprintf("%4X-%s-%s-%X",
+	    nvme->n_idctl->id_vid, model, serial, nsid);
+}
+
+/*
+ * Update the ANA state of all namespaces from the ANA log page. A namespace
+ * whose ANA group isn't in the log is inaccessible.
+ */
+static void
+nvme_ana_update(nvme_t *nvme)
+{
+	nvme_ana_log_t *log = NULL;
+	nvme_ana_desc_t *desc;
+	size_t logsize = 0;
+	uint_t ndesc;
+
+	if (nvme_get_logpage(nvme, B_FALSE, (void **)&log, &logsize,
+	    NVME_LOGPAGE_ANA) != 0) {
+		dev_err(nvme->n_dip, CE_WARN, "!failed to get ANA log page");
+		return;
+	}
+
+	desc = (nvme_ana_desc_t *)(log + 1);
+	ndesc = MIN(log->al_ngrps,
+	    (logsize - sizeof (nvme_ana_log_t)) / sizeof (nvme_ana_desc_t));
+
+	for (int i = 0; i != nvme->n_namespace_count; i++) {
+		nvme_namespace_t *ns = &nvme->n_ns[i];
+		uint8_t state = NVME_ANA_INACCESSIBLE;
+
+		if (ns->ns_idns == NULL)
+			continue;
+
+		for (uint_t j = 0; j != ndesc; j++) {
+			if (desc[j].ad_grpid == ns->ns_idns->id_anagrpid) {
+				state = desc[j].ad_state;
+				break;
+			}
+		}
+
+		ns->ns_ana_state = state;
+	}
+
+	kmem_free(log, logsize);
+
+	/* Retry any I/O waiting for a path to finish its transition. */
+	mutex_enter(&nvme_mpath_mutex);
+	cv_broadcast(&nvme_mpath_cv);
+	mutex_exit(&nvme_mpath_mutex);
+}
+
+static int
+nvme_init_ns(nvme_t *nvme, int nsid)
+{
+	nvme_namespace_t *ns = &nvme->n_ns[nsid - 1];
+	nvme_identify_nsid_t *idns;
+	boolean_t was_ignored;
+	int last_rp;
+
+	ns->ns_nvme = nvme;
+
+	if (nvme_identify(nvme, B_FALSE, nsid, (void **)&idns) != 0) {
+		dev_err(nvme->n_dip, CE_WARN,
+		    "!failed to identify namespace %d", nsid);
+		return (DDI_FAILURE);
+	}
+
+	ns->ns_idns = idns;
+	ns->ns_id = nsid;
+	ns->ns_block_count = idns->id_nsize;
+	ns->ns_block_size =
+	    1 << idns->id_lbaf[idns->id_flbas.lba_format].lbaf_lbads;
+	ns->ns_best_block_size = ns->ns_block_size;
+
+	/*
+	 * Without ANA reporting every path to a namespace is optimized,
+	 * otherwise the ANA state is set by nvme_ana_update(). Until that
+	 * has succeeded the path is assumed to be optimized, too; should it
+	 * not be, the ANA errors of its I/O will mark it otherwise.
+	 */
+	if (!nvme->n_ana_supported || ns->ns_ana_state == 0)
+		ns->ns_ana_state = NVME_ANA_OPTIMIZED;
+
+	/*
+	 * Get the EUI64 if present. Use it for devid and device node names.
+	 */
+	if (NVME_VERSION_ATLEAST(&nvme->n_version, 1, 1))
+		bcopy(idns->id_eui64, ns->ns_eui64, sizeof (ns->ns_eui64));
+
+	/*LINTED: E_BAD_PTR_CAST_ALIGN*/
+	if (*(uint64_t *)ns->ns_eui64 != 0) {
 		uint8_t *eui64 = ns->ns_eui64;
 
 		(void) snprintf(ns->ns_name, sizeof (ns->ns_name),
@@ -2655,6 +3547,8 @@ nvme_init(nvme_t *nvme)
 	int i = 0;
 	uint16_t nqueues;
 	uint_t tq_threads;
+	int *nsids;
+	uint_t nnsids;
 	char model[sizeof (nvme->n_idctl->id_model) + 1];
 	char *vendor, *product;
 
@@ -2956,6 +3850,13 @@ nvme_init(nvme_t *nvme)
 	 */
 	nvme->n_progress_supported = B_TRUE;
 
+	/*
+	 * Check support for Asymmetric Namespace Access reporting.
+	 */
+	if (NVME_VERSION_ATLEAST(&nvme->n_version, 1, 4))
+		nvme->n_ana_supported =
+		    nvme->n_idctl->id_mic.m_anar == 0 ? B_FALSE : B_TRUE;
+
 	/*
 	 * Identify Namespaces
 	 */
@@ -2985,6 +3886,24 @@ nvme_init(nvme_t *nvme)
 			goto fail;
 	}
 
+	/*
+	 * Get the initial ANA state of the namespaces, and enable the ANA
+	 * change notices that tell us when to look again.
+	 */
+	if (nvme->n_ana_supported) {
+		nvme_async_event_conf_t aec = { 0 };
+		uint32_t res;
+
+		if (nvme_get_features(nvme, B_FALSE, 0, NVME_FEAT_ASYNC_EVENT,
+		    &aec.r, NULL, NULL) == 0) {
+			aec.b.aec_ana = 1;
+			(void) nvme_set_features(nvme, B_FALSE, 0,
+			    NVME_FEAT_ASYNC_EVENT, aec.r, &res);
+		}
+
+		nvme_ana_update(nvme);
+	}
+
 	/*
 	 * Try to set up MSI/MSI-X interrupts.
 	 */
@@ -3020,7 +3939,7 @@ nvme_init(nvme_t *nvme)
 	 */
 	kmem_free(nvme->n_ioq, sizeof (nvme_qpair_t *));
 	nvme->n_ioq = kmem_zalloc(sizeof (nvme_qpair_t *) *
-	    (nvme->n_submission_queues + 1), KM_SLEEP);
+	    (nvme->n_submission_queues + nvme->n_poll_queues + 1), KM_SLEEP);
 	nvme->n_ioq[0] = nvme->n_adminq;
 
 	/*
@@ -3030,6 +3949,10 @@ nvme_init(nvme_t *nvme)
 	ASSERT(nvme->n_submission_queues >= nvme->n_completion_queues);
 
 	nvme->n_ioq_count = nvme->n_submission_queues;
+	nvme->n_pollq_count = nvme->n_poll_queues;
+
+	(void) ddi_prop_update_int(DDI_DEV_T_NONE, nvme->n_dip,
+	    "io-poll-queues", nvme->n_pollq_count);
 
 	nvme->n_io_squeue_len =
 	    MIN(nvme->n_io_squeue_len, nvme->n_max_queue_entries);
@@ -3089,22 +4012,56 @@ nvme_init(nvme_t *nvme)
 	}
 
 	/*
-	 * Alloc & register I/O queue pairs
+	 * Alloc & register I/O queue pairs, the polled ones last.
 	 */
 
-	for (i = 1; i != nvme->n_ioq_count + 1; i++) {
+	for (i = 1; i != nvme->n_ioq_count + nvme->n_pollq_count + 1; i++) {
+		nvme_qpair_t *qp;
+
 		if (nvme_alloc_qpair(nvme, nvme->n_io_squeue_len,
 		    &nvme->n_ioq[i], i) != DDI_SUCCESS) {
 			dev_err(nvme->n_dip, CE_WARN,
 			    "!unable to allocate I/O qpair %d", i);
 			goto fail;
 		}
+		qp = nvme->n_ioq[i];
 
-		if (nvme_create_io_qpair(nvme, nvme->n_ioq[i], i) != 0) {
+		if (nvme_create_io_qpair(nvme, qp, i) != 0) {
 			dev_err(nvme->n_dip, CE_WARN,
 			    "!unable to create I/O qpair %d", i);
 			goto fail;
 		}
+
+		nvme_qpair_kstat_init(nvme, qp, i);
+
+		if (qp->nq_poll) {
+			qp->nq_poll_thread = thread_create(NULL, 0,
+			    nvme_poll_thread, qp, 0, &p0, TS_RUN, minclsyspri);
+			qp->nq_poll_did = qp->nq_poll_thread->t_did;
+		}
+	}
+
+	if (nvme->n_queue_affinity)
+		nvme_bind_interrupts(nvme);
+
+	/*
+	 * Select the namespaces whose I/O goes to the polled queue pairs.
+	 */
+	if (nvme->n_pollq_count > 0 &&
+	    ddi_prop_lookup_int_array(DDI_DEV_T_ANY, nvme->n_dip,
+	    DDI_PROP_DONTPASS, "io-poll-namespaces", &nsids, &nnsids) ==
+	    DDI_PROP_SUCCESS) {
+		for (i = 0; i != nnsids; i++) {
+			if (nsids[i] < 1 ||
+			    nsids[i] > nvme->n_namespace_count) {
+				dev_err(nvme->n_dip, CE_WARN,
+				    "!\"io-poll-namespaces\": invalid "
+				    "namespace %d", nsids[i]);
+				continue;
+			}
+			nvme->n_ns[nsids[i] - 1].ns_poll = B_TRUE;
+		}
+		ddi_prop_free(nsids);
 	}
 
 	/*
@@ -3153,6 +4110,39 @@ nvme_intr(caddr_t arg1, caddr_t arg2)
 	return (ccnt > 0 ? DDI_INTR_CLAIMED : DDI_INTR_UNCLAIMED);
 }
 
+/*
+ * Bind the interrupt vector of each I/O completion queue to the CPU that
+ * submits to it. Submission queue i is used by the CPUs whose sequential id
+ * modulo the number of submission queues is i - 1, and it completes to
+ * completion queue 1 + (i - 1) % n_completion_queues, which uses vector
+ * cq_id % n_intr_cnt. The lowest submission queue completing to vector v
+ * is v, the CPU with sequential id v - 1 being its first user.
+ */
+static void
+nvme_bind_interrupts(nvme_t *nvme)
+{
+	processorid_t cpuid;
+	cpu_t *cp;
+	int i;
+
+	if (nvme->n_intr_type != DDI_INTR_TYPE_MSIX)
+		return;
+
+	for (i = 1; i < nvme->n_intr_cnt && i <= max_ncpus; i++) {
+		mutex_enter(&cpu_lock);
+		cp = cpu_seq[i - 1];
+		cpuid = (cp != NULL && cpu_is_online(cp)) ? cp->cpu_id : -1;
+		mutex_exit(&cpu_lock);
+
+		/* set_intr_affinity() takes cpu_lock itself */
+		if (cpuid == -1 ||
+		    set_intr_affinity(nvme->n_inth[i], cpuid) != DDI_SUCCESS) {
+			dev_err(nvme->n_dip, CE_NOTE,
+			    "!failed to bind interrupt %d to a CPU", i);
+		}
+	}
+}
+
 static void
 nvme_release_interrupts(nvme_t *nvme)
 {
@@ -3297,10 +4287,14 @@ nvme_remove_callback(dev_info_t *dip, ddi_eventcookie_t cookie, void *a,
 
 	/*
 	 * Fail all outstanding commands, including those in the admin queue
-	 * (queue 0).
+	 * (queue 0). Polled queue pairs have no taskq of their own, so their
+	 * commands are completed on the taskq of the admin queue.
 	 */
-	for (uint_t i = 0; i < nvme->n_ioq_count + 1; i++) {
+	for (uint_t i = 0; i < nvme->n_ioq_count + nvme->n_pollq_count + 1;
+	    i++) {
 		nvme_qpair_t *qp = nvme->n_ioq[i];
+		taskq_t *tq = qp->nq_poll ? nvme->n_cq[0]->ncq_cmd_taskq :
+		    qp->nq_cq->ncq_cmd_taskq;
 
 		mutex_enter(&qp->nq_mutex);
 		for (size_t j = 0; j < qp->nq_nentry; j++) {
@@ -3319,8 +4313,8 @@ nvme_remove_callback(dev_info_t *dip, ddi_eventcookie_t cookie, void *a,
 			 * requested cmd to unqueue.
 			 */
 			u_cmd = nvme_unqueue_cmd(nvme, qp, cmd->nc_sqe.sqe_cid);
-			taskq_dispatch_ent(qp->nq_cq->ncq_cmd_taskq,
-			    cmd->nc_callback, cmd, TQ_NOSLEEP, &cmd->nc_tqent);
+			taskq_dispatch_ent(tq, cmd->nc_callback, cmd,
+			    TQ_NOSLEEP, &cmd->nc_tqent);
 
 			ASSERT3P(u_cmd, ==, cmd);
 		}
@@ -3337,6 +4331,8 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	off_t regsize;
 	int i;
 	char name[32];
+	char *policy;
+	int coal_thr, coal_time;
 	bd_ops_t ops = nvme_bd_ops;
 
 	if (cmd != DDI_ATTACH)
@@ -3392,6 +4388,65 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	    DDI_PROP_DONTPASS, "max-submission-queues", -1);
 	nvme->n_completion_queues = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
 	    DDI_PROP_DONTPASS, "max-completion-queues", -1);
+	nvme->n_poll_queues = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
+	    DDI_PROP_DONTPASS, "io-poll-queues", 0);
+	nvme->n_poll_hybrid = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
+	    DDI_PROP_DONTPASS, "io-poll-hybrid", 1) != 0 ? B_TRUE : B_FALSE;
+	nvme->n_poll_hipri = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
+	    DDI_PROP_DONTPASS, "io-poll-hipri", 0) != 0 ? B_TRUE : B_FALSE;
+	nvme->n_queue_affinity = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
+	    DDI_PROP_DONTPASS, "io-queue-affinity", 1) != 0 ? B_TRUE : B_FALSE;
+	nvme->n_multipath = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
+	    DDI_PROP_DONTPASS, "multipath", 1) != 0 ? B_TRUE : B_FALSE;
+
+	nvme->n_mpath_policy = NVME_MPATH_RR;
+	if (ddi_prop_lookup_string(DDI_DEV_T_ANY, dip, DDI_PROP_DONTPASS,
+	    "multipath-policy", &policy) == DDI_PROP_SUCCESS) {
+		if (strcmp(policy, "queue-depth") == 0) {
+			nvme->n_mpath_policy = NVME_MPATH_QD;
+		} else if (strcmp(policy, "round-robin") != 0) {
+			dev_err(dip, CE_WARN, "!\"multipath-policy\"=%s is not "
+			    "valid, using round-robin", policy);
+		}
+		ddi_prop_free(policy);
+	}
+
+	nvme->n_coal_policy = NVME_COAL_OFF;
+	if (ddi_prop_lookup_string(DDI_DEV_T_ANY, dip, DDI_PROP_DONTPASS,
+	    "intr-coalescing", &policy) == DDI_PROP_SUCCESS) {
+		if (strcmp(policy, "adaptive") == 0) {
+			nvme->n_coal_policy = NVME_COAL_ADAPTIVE;
+		} else if (strcmp(policy, "static") == 0) {
+			nvme->n_coal_policy = NVME_COAL_STATIC;
+		} else if (strcmp(policy, "off") != 0) {
+			dev_err(dip, CE_WARN, "!\"intr-coalescing\"=%s is not "
+			    "valid, using off", policy);
+		}
+		ddi_prop_free(policy);
+	}
+
+	coal_thr = ddi_prop_get_int(DDI_DEV_T_ANY, dip, DDI_PROP_DONTPASS,
+	    "intr-coal-threshold", 8);
+	coal_time = ddi_prop_get_int(DDI_DEV_T_ANY, dip, DDI_PROP_DONTPASS,
+	    "intr-coal-time-us", 100);
+
+	if (coal_thr < 1 || coal_thr > UINT8_MAX + 1) {
+		dev_err(dip, CE_WARN, "!\"intr-coal-threshold\"=%d is not "
+		    "valid. Must be [1..%d]", coal_thr, UINT8_MAX + 1);
+		coal_thr = 8;
+	}
+	if (coal_time < 0 || coal_time > UINT8_MAX * 100) {
+		dev_err(dip, CE_WARN, "!\"intr-coal-time-us\"=%d is not "
+		    "valid. Must be [0..%d]", coal_time, UINT8_MAX * 100);
+		coal_time = 100;
+	}
+	nvme->n_coal_static.b.ic_thr = coal_thr - 1;
+	if (coal_time % 100 != 0) {
+		dev_err(dip, CE_NOTE, "!\"intr-coal-time-us\"=%d is not a "
+		    "multiple of 100, using %d", coal_time,
+		    roundup(coal_time, 100));
+	}
+	nvme->n_coal_static.b.ic_time = howmany(coal_time, 100);
 
 	if (!ISP2(nvme->n_min_block_size) ||
 	    (nvme->n_min_block_size < NVME_DEFAULT_MIN_BLOCK_SIZE)) {
@@ -3420,6 +4475,13 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 		nvme->n_completion_queues = -1;
 	}
 
+	if (nvme->n_poll_queues < 0 || nvme->n_poll_queues > UINT16_MAX - 1) {
+		dev_err(dip, CE_WARN, "!\"io-poll-queues\"=%d is not "
+		    "valid. Must be [0..%d]", nvme->n_poll_queues,
+		    UINT16_MAX - 1);
+		nvme->n_poll_queues = 0;
+	}
+
 	if (nvme->n_admin_queue_len < NVME_MIN_ADMIN_QUEUE_LEN)
 		nvme->n_admin_queue_len = NVME_MIN_ADMIN_QUEUE_LEN;
 	else if (nvme->n_admin_queue_len > NVME_MAX_ADMIN_QUEUE_LEN)
@@ -3498,6 +4560,8 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	if (nvme_init(nvme) != DDI_SUCCESS)
 		goto fail;
 
+	nvme_coal_init(nvme);
+
 	if (!nvme->n_idctl->id_oncs.on_dset_mgmt)
 		ops.o_free_space = NULL;
 
@@ -3528,6 +4592,13 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 		if (nvme->n_ns[i].ns_ignore)
 			continue;
 
+		/*
+		 * A shared namespace that is already attached through another
+		 * controller only becomes another path to it.
+		 */
+		if (nvme_mpath_register(&nvme->n_ns[i]))
+			continue;
+
 		nvme->n_ns[i].ns_bd_hdl = bd_alloc_handle(&nvme->n_ns[i],
 		    &ops, &nvme->n_prp_dma_attr, KM_SLEEP);
 
@@ -3596,6 +4667,8 @@ nvme_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 				bd_free_handle(nvme->n_ns[i].ns_bd_hdl);
 			}
 
+			nvme_mpath_unregister(&nvme->n_ns[i]);
+
 			if (nvme->n_ns[i].ns_idns)
 				kmem_free(nvme->n_ns[i].ns_idns,
 				    sizeof (nvme_identify_nsid_t));
@@ -3611,6 +4684,9 @@ nvme_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 		mutex_destroy(&nvme->n_fwslot_mutex);
 	}
 
+	if (nvme->n_progress & NVME_COAL_INIT)
+		nvme_coal_fini(nvme);
+
 	if (nvme->n_progress & NVME_INTERRUPTS)
 		nvme_release_interrupts(nvme);
 
@@ -3620,7 +4696,8 @@ nvme_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 	}
 
 	if (nvme->n_ioq_count > 0) {
-		for (i = 1; i != nvme->n_ioq_count + 1; i++) {
+		for (i = 1; i != nvme->n_ioq_count + nvme->n_pollq_count + 1;
+		    i++) {
 			if (nvme->n_ioq[i] != NULL) {
 				/* TODO: send destroy queue commands */
 				nvme_free_qpair(nvme->n_ioq[i]);
@@ -3628,7 +4705,7 @@ nvme_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 		}
 
 		kmem_free(nvme->n_ioq, sizeof (nvme_qpair_t *) *
-		    (nvme->n_ioq_count + 1));
+		    (nvme->n_ioq_count + nvme->n_pollq_count + 1));
 	}
 
 	if (nvme->n_prp_cache != NULL) {
@@ -3880,16 +4957,362 @@ fail:
 	return (NULL);
 }
 
+/*
+ * Add a namespace to the multipath group of its NGUID or EUI64 if it is
+ * shared, creating the group if it doesn't exist yet. Returns B_TRUE if the
+ * namespace joined an existing group, in which case it must not be attached
+ * to blkdev.
+ */
+static boolean_t
+nvme_mpath_register(nvme_namespace_t *ns)
+{
+	nvme_t *nvme = ns->ns_nvme;
+	nvme_identify_nsid_t *idns = ns->ns_idns;
+	nvme_namespace_t *head;
+	nvme_mpath_t *mp;
+	uint8_t id[sizeof (mp->nm_id)] = { 0 };
+	uint8_t zero[sizeof (mp->nm_id)] = { 0 };
+
+	if (!nvme->n_multipath || idns->id_nmic.nm_shared == 0)
+		return (B_FALSE);
+
+	if (NVME_VERSION_ATLEAST(&nvme->n_version, 1, 2))
+		bcopy(idns->id_nguid, id, sizeof (idns->id_nguid));
+	if (bcmp(id, zero, sizeof (id)) == 0)
+		bcopy(ns->ns_eui64, id, sizeof (ns->ns_eui64));
+	if (bcmp(id, zero, sizeof (id)) == 0)
+		return (B_FALSE);
+
+	mutex_enter(&nvme_mpath_mutex);
+
+	for (mp = list_head(&nvme_mpaths); mp != NULL;
+	    mp = list_next(&nvme_mpaths, mp)) {
+		if (bcmp(mp->nm_id, id, sizeof (id)) == 0)
+			break;
+	}
+
+	if (mp == NULL) {
+		mp = kmem_zalloc(sizeof (nvme_mpath_t), KM_SLEEP);
+		bcopy(id, mp->nm_id, sizeof (id));
+		mp->nm_head = ns;
+		mp->nm_policy = nvme->n_mpath_policy;
+		rw_init(&mp->nm_lock, NULL, RW_DRIVER, NULL);
+		list_create(&mp->nm_paths, sizeof (nvme_namespace_t),
+		    offsetof(nvme_namespace_t, ns_mpath_node));
+		list_create(&mp->nm_waiting, sizeof (nvme_mpath_wait_t),
+		    offsetof(nvme_mpath_wait_t, nw_node));
+		list_insert_tail(&nvme_mpaths, mp);
+	}
+
+	/*
+	 * I/O is set up by blkdev according to the head, which every other
+	 * path must be able to handle.
+	 */
+	head = mp->nm_head;
+	if (head != ns && (ns->ns_block_size != head->ns_block_size ||
+	    ns->ns_block_count != head->ns_block_count ||
+	    nvme->n_pagesize != head->ns_nvme->n_pagesize ||
+	    nvme->n_max_data_transfer_size <
+	    head->ns_nvme->n_max_data_transfer_size)) {
+		dev_err(nvme->n_dip, CE_WARN, "!namespace %d doesn't match "
+		    "namespace %d of %s%d, not using it as another path",
+		    ns->ns_id, head->ns_id,
+		    ddi_driver_name(head->ns_nvme->n_dip),
+		    ddi_get_instance(head->ns_nvme->n_dip));
+		mutex_exit(&nvme_mpath_mutex);
+		return (B_FALSE);
+	}
+
+	rw_enter(&mp->nm_lock, RW_WRITER);
+	list_insert_tail(&mp->nm_paths, ns);
+	mp->nm_npaths++;
+	ns->ns_mpath = mp;
+	rw_exit(&mp->nm_lock);
+
+	if (head != ns) {
+		dev_err(nvme->n_dip, CE_NOTE, "!namespace %d is another path "
+		    "to namespace %d of %s%d", ns->ns_id, head->ns_id,
+		    ddi_driver_name(head->ns_nvme->n_dip),
+		    ddi_get_instance(head->ns_nvme->n_dip));
+	}
+
+	mutex_exit(&nvme_mpath_mutex);
+
+	return (head != ns);
+}
+
+/*
+ * Remove a namespace from its multipath group and wait for the I/O posted to
+ * it to complete. If the namespace is the head of the group, its blkdev
+ * instance is gone and so is the group.
+ */
+static void
+nvme_mpath_unregister(nvme_namespace_t *ns)
+{
+	nvme_mpath_t *mp = ns->ns_mpath;
+	nvme_namespace_t *path;
+	nvme_mpath_wait_t *nw;
+
+	if (mp == NULL)
+		return;
+
+	mutex_enter(&nvme_mpath_mutex);
+	rw_enter(&mp->nm_lock, RW_WRITER);
+
+	if (mp->nm_head == ns) {
+		while ((path = list_remove_head(&mp->nm_paths)) != NULL)
+			path->ns_mpath = NULL;
+		mp->nm_npaths = 0;
+
+		/* I/O waiting out an ANA transition fails right away. */
+		while ((nw = list_remove_head(&mp->nm_waiting)) != NULL)
+			nw->nw_mpath = NULL;
+		cv_broadcast(&nvme_mpath_cv);
+	} else {
+		list_remove(&mp->nm_paths, ns);
+		mp->nm_npaths--;
+		ns->ns_mpath = NULL;
+	}
+
+	rw_exit(&mp->nm_lock);
+
+	if (mp->nm_npaths == 0) {
+		list_remove(&nvme_mpaths, mp);
+		list_destroy(&mp->nm_paths);
+		list_destroy(&mp->nm_waiting);
+		rw_destroy(&mp->nm_lock);
+		kmem_free(mp, sizeof (nvme_mpath_t));
+	}
+
+	mutex_exit(&nvme_mpath_mutex);
+
+	while (ns->ns_inflight != 0)
+		delay(drv_usectohz(10000));
+}
+
+/*
+ * Select the path for an I/O, skipping the path given in "failed". Optimized
+ * paths are preferred over non-optimized ones. The I/O is accounted to the
+ * selected path before the group is unlocked, so the path can't go away until
+ * the I/O completes. If there is no usable path, "anattp" is set to the
+ * longest ANATT of the controllers with paths in the change state, in seconds,
+ * or to 0 if there are none.
+ */
+static nvme_namespace_t *
+nvme_mpath_select(nvme_mpath_t *mp, uint_t *anattp, nvme_namespace_t *failed)
+{
+	nvme_namespace_t *ns, *best = NULL;
+	uint8_t state;
+	uint_t i, start;
+
+	*anattp = 0;
+
+	rw_enter(&mp->nm_lock, RW_READER);
+
+	start = atomic_inc_32_nv(&mp->nm_next) % MAX(1, mp->nm_npaths);
+
+	for (state = NVME_ANA_OPTIMIZED;
+	    best == NULL && state <= NVME_ANA_NONOPTIMIZED; state++) {
+		boolean_t wrapped = B_TRUE;
+
+		for (ns = list_head(&mp->nm_paths), i = 0; ns != NULL;
+		    ns = list_next(&mp->nm_paths, ns), i++) {
+			if (ns == failed || ns->ns_nvme->n_dead ||
+			    ns->ns_ana_state != state)
+				continue;
+
+			if (mp->nm_policy == NVME_MPATH_QD) {
+				if (best == NULL ||
+				    ns->ns_inflight < best->ns_inflight)
+					best = ns;
+				continue;
+			}
+
+			/*
+			 * Round-robin: use the first path at or after the
+			 * cursor, or the first path if there is none.
+			 */
+			if (best == NULL || (wrapped && i >= start)) {
+				best = ns;
+				wrapped = i < start;
+			}
+		}
+	}
+
+	if (best != NULL) {
+		atomic_inc_32(&best->ns_inflight);
+	} else {
+		for (ns = list_head(&mp->nm_paths); ns != NULL;
+		    ns = list_next(&mp->nm_paths, ns)) {
+			if (!ns->ns_nvme->n_dead &&
+			    ns->ns_ana_state == NVME_ANA_CHANGE) {
+				*anattp = MAX(*anattp, MAX(1,
+				    ns->ns_nvme->n_idctl->ap_anatt));
+			}
+		}
+	}
+
+	rw_exit(&mp->nm_lock);
+
+	return (best);
+}
+
+/*
+ * Retry a multipath I/O until a path has finished its ANA transition, ANATT
+ * has passed or the group has gone away.
+ */
+static void
+nvme_mpath_wait(void *arg)
+{
+	nvme_mpath_wait_t *nw = arg;
+	nvme_namespace_t *ns;
+	nvme_mpath_t *mp;
+	uint_t anatt;
+	int ret = EIO;
+
+	mutex_enter(&nvme_mpath_mutex);
+	while ((mp = nw->nw_mpath) != NULL) {
+		if ((ns = nvme_mpath_select(mp, &anatt, NULL)) != NULL) {
+			ret = nvme_bd_submit(ns, nw->nw_xfer, nw->nw_opc,
+			    B_TRUE, nw->nw_retries);
+			if (ret != 0)
+				atomic_dec_32(&ns->ns_inflight);
+			break;
+		}
+
+		if (anatt == 0 || gethrtime() >= nw->nw_deadline)
+			break;
+
+		(void) cv_reltimedwait(&nvme_mpath_cv, &nvme_mpath_mutex,
+		    drv_usectohz(nvme_mpath_retry_ms * 1000), TR_CLOCK_TICK);
+	}
+
+	if (mp != NULL) {
+		rw_enter(&mp->nm_lock, RW_WRITER);
+		list_remove(&mp->nm_waiting, nw);
+		rw_exit(&mp->nm_lock);
+	}
+	mutex_exit(&nvme_mpath_mutex);
+
+	if (ret != 0)
+		bd_xfer_done(nw->nw_xfer, ret);
+
+	kmem_free(nw, sizeof (nvme_mpath_wait_t));
+}
+
+/*
+ * Have a multipath I/O wait for up to "anatt" seconds for a path to finish
+ * its ANA transition. Polled I/O, as when dumping, can't wait.
+ */
+static int
+nvme_mpath_defer(nvme_mpath_t *mp, bd_xfer_t *xfer, uint8_t opc,
+    uint_t retries, uint_t anatt)
+{
+	nvme_mpath_wait_t *nw;
+
+	if ((xfer->x_flags & BD_XFER_POLL) != 0)
+		return (EIO);
+
+	if ((nw = kmem_zalloc(sizeof (nvme_mpath_wait_t), KM_NOSLEEP)) == NULL)
+		return (EIO);
+
+	nw->nw_mpath = mp;
+	nw->nw_xfer = xfer;
+	nw->nw_opc = opc;
+	nw->nw_retries = retries;
+	nw->nw_deadline = gethrtime() + (hrtime_t)anatt * NANOSEC;
+
+	rw_enter(&mp->nm_lock, RW_WRITER);
+	list_insert_tail(&mp->nm_waiting, nw);
+	rw_exit(&mp->nm_lock);
+
+	if (taskq_dispatch(nvme_mpath_taskq, nvme_mpath_wait, nw,
+	    TQ_NOSLEEP) == TASKQID_INVALID) {
+		rw_enter(&mp->nm_lock, RW_WRITER);
+		list_remove(&mp->nm_waiting, nw);
+		rw_exit(&mp->nm_lock);
+		kmem_free(nw, sizeof (nvme_mpath_wait_t));
+		return (EIO);
+	}
+
+	return (0);
+}
+
+/*
+ * Post a multipath I/O to the best path, which must not be "failed".
+ */
+static int
+nvme_mpath_cmd(nvme_mpath_t *mp, nvme_namespace_t *failed, bd_xfer_t *xfer,
+    uint8_t opc, uint_t retries)
+{
+	nvme_namespace_t *ns;
+	uint_t anatt;
+	int ret;
+
+	if ((ns = nvme_mpath_select(mp, &anatt, failed)) == NULL) {
+		if (anatt == 0)
+			return (EIO);
+		return (nvme_mpath_defer(mp, xfer, opc, retries, anatt));
+	}
+
+	ret = nvme_bd_submit(ns, xfer, opc, B_TRUE, retries);
+	if (ret != 0)
+		atomic_dec_32(&ns->ns_inflight);
+
+	return (ret);
+}
+
 static void
 nvme_bd_xfer_done(void *arg)
 {
 	nvme_cmd_t *cmd = arg;
 	bd_xfer_t *xfer = cmd->nc_xfer;
+	nvme_namespace_t *path = cmd->nc_ns;
+	uint_t retries = cmd->nc_retries;
+	uint8_t opc = cmd->nc_sqe.sqe_opc;
+	boolean_t failover = B_FALSE;
 	int error = 0;
 
 	error = nvme_check_cmd_status(cmd);
+
+	/*
+	 * Multipath I/O that failed because of its path is retried on
+	 * another path.
+	 */
+	if (error != 0 && path != NULL) {
+		failover = cmd->nc_nvme->n_dead ||
+		    cmd->nc_cqe.cqe_sf.sf_sct == NVME_CQE_SCT_PATH;
+	}
+
 	nvme_free_cmd(cmd);
 
+	if (path != NULL) {
+		nvme_mpath_t *mp;
+
+		/*
+		 * The group may be torn down by nvme_mpath_unregister() at any
+		 * time, so it is looked up under nvme_mpath_mutex and stays
+		 * held until the I/O has been reposted. The path itself may go
+		 * away as soon as its I/O count drops to zero, so that must
+		 * happen last.
+		 */
+		if (failover) {
+			mutex_enter(&nvme_mpath_mutex);
+			mp = path->ns_mpath;
+			if (mp != NULL && retries < mp->nm_npaths &&
+			    nvme_mpath_cmd(mp, path, xfer, opc,
+			    retries + 1) == 0) {
+				mutex_exit(&nvme_mpath_mutex);
+				atomic_inc_32(&path->ns_nvme->n_failover);
+				atomic_dec_32(&path->ns_inflight);
+				return;
+			}
+			mutex_exit(&nvme_mpath_mutex);
+		}
+
+		atomic_dec_32(&path->ns_inflight);
+	}
+
 	bd_xfer_done(xfer, error);
 }
 
@@ -3971,7 +5394,7 @@ nvme_bd_mediainfo(void *arg, bd_media_t *media)
 	nvme_namespace_t *ns = arg;
 	nvme_t *nvme = ns->ns_nvme;
 
-	if (nvme->n_dead) {
+	if (nvme->n_dead && ns->ns_mpath == NULL) {
 		return (EIO);
 	}
 
@@ -3987,6 +5410,25 @@ nvme_bd_mediainfo(void *arg, bd_media_t *media)
 
 static int
 nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
+{
+	if (ns->ns_mpath != NULL)
+		return (nvme_mpath_cmd(ns->ns_mpath, NULL, xfer, opc, 0));
+
+	if (ns->ns_nvme->n_dead) {
+		return (EIO);
+	}
+
+	return (nvme_bd_submit(ns, xfer, opc, B_FALSE, 0));
+}
+
+/*
+ * Post an I/O to a namespace. Multipath I/O remembers the path it was posted
+ * to, which may be a namespace of another controller than the one blkdev
+ * selected the queue for.
+ */
+static int
+nvme_bd_submit(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc,
+    boolean_t mpath, uint_t retries)
 {
 	nvme_t *nvme = ns->ns_nvme;
 	nvme_cmd_t *cmd;
@@ -3994,17 +5436,14 @@ nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
 	boolean_t poll;
 	int ret;
 
-	if (nvme->n_dead) {
-		return (EIO);
-	}
-
 	cmd = nvme_create_nvm_cmd(ns, opc, xfer);
 	if (cmd == NULL)
 		return (ENOMEM);
 
-	cmd->nc_sqid = xfer->x_qnum + 1;
-	ASSERT(cmd->nc_sqid <= nvme->n_ioq_count);
-	ioq = nvme->n_ioq[cmd->nc_sqid];
+	if (mpath) {
+		cmd->nc_ns = ns;
+		cmd->nc_retries = retries;
+	}
 
 	/*
 	 * Get the polling flag before submitting the command. The command may
@@ -4013,6 +5452,29 @@ nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
 	 */
 	poll = (xfer->x_flags & BD_XFER_POLL) != 0;
 
+	/*
+	 * Post I/O that wants polled completion to one of the polled queue
+	 * pairs, unless we're dumping. If that queue pair is full, fall back
+	 * to the regular queue rather than failing the I/O.
+	 */
+	if (nvme->n_pollq_count > 0 && !poll && (ns->ns_poll ||
+	    (nvme->n_poll_hipri && (xfer->x_flags & BD_XFER_HIPRI) != 0))) {
+		cmd->nc_sqid = nvme->n_ioq_count + 1 +
+		    xfer->x_qnum % nvme->n_pollq_count;
+		ioq = nvme->n_ioq[cmd->nc_sqid];
+
+		ret = nvme_submit_io_cmd(ioq, cmd);
+		if (ret != EAGAIN) {
+			if (ret == 0)
+				nvme_poll_wakeup(ioq);
+			return (ret);
+		}
+	}
+
+	cmd->nc_sqid = xfer->x_qnum % nvme->n_ioq_count + 1;
+	ASSERT(cmd->nc_sqid <= nvme->n_ioq_count);
+	ioq = nvme->n_ioq[cmd->nc_sqid];
+
 	ret = nvme_submit_io_cmd(ioq, cmd);
 
 	if (ret != 0)
@@ -4053,7 +5515,7 @@ nvme_bd_sync(void *arg, bd_xfer_t *xfer)
 {
 	nvme_namespace_t *ns = arg;
 
-	if (ns->ns_nvme->n_dead)
+	if (ns->ns_nvme->n_dead && ns->ns_mpath == NULL)
 		return (EIO);
 
 	/*
@@ -4079,7 +5541,7 @@ nvme_bd_devid(void *arg, dev_info_t *devinfo, ddi_devid_t *devid)
 	nvme_namespace_t *ns = arg;
 	nvme_t *nvme = ns->ns_nvme;
 
-	if (nvme->n_dead) {
+	if (nvme->n_dead && ns->ns_mpath == NULL) {
 		return (EIO);
 	}
 
@@ -4231,7 +5693,7 @@ nvme_ioc_cmd(nvme_t *nvme, nvme_sqe_t *sqe, boolean_t is_admin, void *data_addr,
 		cmd->nc_sqid = 0;
 		ioq = nvme->n_adminq;
 	} else {
-		cmd->nc_sqid = (CPU->cpu_id % nvme->n_ioq_count) + 1;
+		cmd->nc_sqid = (CPU->cpu_seqid % nvme->n_ioq_count) + 1;
 		ASSERT(cmd->nc_sqid <= nvme->n_ioq_count);
 		ioq = nvme->n_ioq[cmd->nc_sqid];
 	}
@@ -4642,6 +6104,10 @@ nvme_ioctl_detach(nvme_t *nvme, int nsid, nvme_ioctl_t *nioc, int mode,
 	if (nvme->n_ns[nsid - 1].ns_ignore)
 		return (0);
 
+	/* Other paths to a multipath namespace have no blkdev instance. */
+	if (nvme->n_ns[nsid - 1].ns_bd_hdl == NULL)
+		return (0);
+
 	rv = bd_detach_handle(nvme->n_ns[nsid - 1].ns_bd_hdl);
 	if (rv != DDI_SUCCESS)
 		rv = EBUSY;
@@ -4675,6 +6141,11 @@ nvme_ioctl_attach(nvme_t *nvme, int nsid, nvme_ioctl_t *nioc, int mode,
 	if (nvme->n_ns[nsid - 1].ns_ignore)
 		return (ENOTSUP);
 
+	/* This is just another path to a namespace attached elsewhere. */
+	if (nvme->n_ns[nsid - 1].ns_mpath != NULL &&
+	    nvme->n_ns[nsid - 1].ns_mpath->nm_head != &nvme->n_ns[nsid - 1])
+		return (0);
+
 	if (nvme->n_ns[nsid - 1].ns_bd_hdl == NULL)
 		nvme->n_ns[nsid - 1].ns_bd_hdl = bd_alloc_handle(
 		    &nvme->n_ns[nsid - 1], &nvme_bd_ops, &nvme->n_prp_dma_attr,
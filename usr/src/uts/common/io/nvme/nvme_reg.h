@@ -327,6 +327,7 @@ typedef struct {
  */
 #define	NVME_ASYNC_TYPE_ERROR		0x0	/* Error Status */
 #define	NVME_ASYNC_TYPE_HEALTH		0x1	/* SMART/Health Status */
+#define	NVME_ASYNC_TYPE_NOTICE		0x2	/* Notice */
 #define	NVME_ASYNC_TYPE_VENDOR		0x7	/* vendor specific */
 
 #define	NVME_ASYNC_ERROR_INV_SQ		0x0	/* Invalid Submission Queue */
@@ -340,6 +341,8 @@ typedef struct {
 #define	NVME_ASYNC_HEALTH_TEMPERATURE	0x1	/* Temp. Above Threshold */
 #define	NVME_ASYNC_HEALTH_SPARE		0x2	/* Spare Below Threshold */
 
+#define	NVME_ASYNC_NOTICE_ANA		0x3	/* ANA Change (1.4) */
+
 typedef union {
 	struct {
 		uint8_t ae_type:3;		/* Asynchronous Event Type */
@@ -415,7 +418,9 @@ typedef union {
 typedef union {
 	struct {
 		uint8_t lp_lid;		/* Log Page Identifier */
-		uint8_t lp_rsvd1;
+		uint8_t lp_lsp:4;	/* Log Specific Field (1.3) */
+		uint8_t lp_rsvd1:3;
+		uint8_t lp_rae:1;	/* Retain Asynchronous Event (1.3) */
 		uint16_t lp_numd:12;	/* Number of Dwords */
 		uint16_t lp_rsvd2:4;
 	} b;
@@ -24,6 +24,7 @@
 #include <sys/blkdev.h>
 #include <sys/taskq_impl.h>
 #include <sys/list.h>
+#include <sys/kstat.h>
 
 /*
  * NVMe driver state
@@ -39,6 +40,7 @@ extern "C" {
 #define	NVME_CTRL_LIMITS		0x8
 #define	NVME_INTERRUPTS			0x10
 #define	NVME_UFM_INIT			0x20
+#define	NVME_COAL_INIT			0x40
 
 #define	NVME_MIN_ADMIN_QUEUE_LEN	16
 #define	NVME_MIN_IO_QUEUE_LEN		16
@@ -48,6 +50,25 @@ extern "C" {
 #define	NVME_MIN_ASYNC_EVENT_LIMIT	1
 #define	NVME_DEFAULT_MIN_BLOCK_SIZE	512
 
+/*
+ * Completion latency histogram buckets, each covering a power of two of
+ * microseconds. The last bucket also counts anything slower.
+ */
+#define	NVME_LAT_BUCKETS		20
+
+/*
+ * Path selection policies for namespaces shared by several controllers.
+ */
+#define	NVME_MPATH_RR			0	/* round-robin */
+#define	NVME_MPATH_QD			1	/* least queue depth */
+
+/*
+ * Interrupt coalescing policies.
+ */
+#define	NVME_COAL_OFF			0	/* leave the device defaults */
+#define	NVME_COAL_ADAPTIVE		1	/* follow the I/O load */
+#define	NVME_COAL_STATIC		2	/* fixed threshold and time */
+
 
 typedef struct nvme nvme_t;
 typedef struct nvme_namespace nvme_namespace_t;
@@ -57,6 +78,10 @@ typedef struct nvme_cmd nvme_cmd_t;
 typedef struct nvme_cq nvme_cq_t;
 typedef struct nvme_qpair nvme_qpair_t;
 typedef struct nvme_task_arg nvme_task_arg_t;
+typedef struct nvme_qstat nvme_qstat_t;
+typedef struct nvme_mpath nvme_mpath_t;
+typedef struct nvme_coalstat nvme_coalstat_t;
+typedef struct nvme_coal_vec nvme_coal_vec_t;
 
 struct nvme_minor_state {
 	kmutex_t	nm_mutex;
@@ -85,6 +110,9 @@ struct nvme_cmd {
 	boolean_t nc_completed;
 	boolean_t nc_dontpanic;
 	uint16_t nc_sqid;
+	hrtime_t nc_submit;	/* submission time of I/O commands */
+	nvme_namespace_t *nc_ns;	/* path of a multipath I/O command */
+	uint_t nc_retries;		/* number of failovers so far */
 
 	nvme_dma_t *nc_dma;
 
@@ -105,13 +133,49 @@ struct nvme_cq {
 	uint_t ncq_tail;
 	uintptr_t ncq_hdbl;
 	int ncq_phase;
+	boolean_t ncq_poll;	/* no interrupt, reaped by a poller */
 
 	taskq_t *ncq_cmd_taskq;
 
 	kmutex_t ncq_mutex;
+
+	/* interrupts with work and commands reaped by them, under ncq_mutex */
+	uint64_t ncq_intrs;
+	uint64_t ncq_intr_cmds;
+};
+
+struct nvme_qstat {
+	kstat_named_t nqs_cmds;		/* completed I/O commands */
+	kstat_named_t nqs_lat_avg;	/* moving average latency, in ns */
+	kstat_named_t nqs_depth;	/* average commands in flight */
+	kstat_named_t nqs_coalesced;	/* interrupts are being coalesced */
+	kstat_named_t nqs_lat[NVME_LAT_BUCKETS];
+};
+
+struct nvme_coalstat {
+	kstat_named_t ncs_policy;	/* "off", "adaptive" or "static" */
+	kstat_named_t ncs_profile;	/* adaptive profile in use */
+	kstat_named_t ncs_threshold;	/* aggregation threshold, in entries */
+	kstat_named_t ncs_time_us;	/* aggregation time */
+	kstat_named_t ncs_vect_disabled; /* vectors with coalescing disabled */
+	kstat_named_t ncs_iops;		/* I/O completions per second */
+	kstat_named_t ncs_intr_cmds;	/* completions per interrupt, x100 */
+	kstat_named_t ncs_changes;	/* settings programmed */
+	kstat_named_t ncs_errors;	/* settings rejected by the device */
+};
+
+/*
+ * The load seen by an interrupt vector in the last sampling interval of the
+ * adaptive coalescing policy.
+ */
+struct nvme_coal_vec {
+	uint64_t ncv_rate;	/* I/O completions per second */
+	uint64_t ncv_depth;	/* average I/O commands in flight */
+	boolean_t ncv_disabled;	/* Coalescing Disable set */
 };
 
 struct nvme_qpair {
+	nvme_t *nq_nvme;
 	size_t nq_nentry;
 
 	/* submission fields */
@@ -131,6 +195,21 @@ struct nvme_qpair {
 
 	kmutex_t nq_mutex;	/* protects shared state */
 	ksema_t nq_sema; /* semaphore to ensure q always has >= 1 empty slot */
+
+	/* completion latency, protected by nq_mutex */
+	hrtime_t nq_lat_avg;
+	uint64_t nq_coal_cmds;	/* nqs_cmds at the last coalescing sample */
+	kstat_t *nq_ksp;
+	nvme_qstat_t nq_stat;
+
+	/* poller state for queues without an interrupt */
+	boolean_t nq_poll;
+	kthread_t *nq_poll_thread;
+	kt_did_t nq_poll_did;
+	kmutex_t nq_poll_mutex;	/* protects the fields below */
+	kcondvar_t nq_poll_cv;
+	boolean_t nq_poll_wanted;
+	boolean_t nq_poll_exit;
 };
 
 struct nvme {
@@ -174,6 +253,15 @@ struct nvme {
 	boolean_t n_progress_supported;
 	int n_submission_queues;
 	int n_completion_queues;
+	int n_poll_queues;
+	boolean_t n_poll_hybrid;
+	boolean_t n_poll_hipri;
+	boolean_t n_queue_affinity;
+	boolean_t n_multipath;
+	int n_mpath_policy;
+	boolean_t n_ana_supported;
+	int n_coal_policy;
+	nvme_intr_coal_t n_coal_static;
 
 	int n_nssr_supported;
 	int n_doorbell_stride;
@@ -188,6 +276,11 @@ struct nvme {
 	uint_t n_namespaces_attachable;
 	uint_t n_ioq_count;
 	uint_t n_cq_count;
+	/*
+	 * Polled I/O queue pairs follow the n_ioq_count interrupt driven ones
+	 * in n_ioq, each with its own completion queue outside of n_cq.
+	 */
+	uint_t n_pollq_count;
 
 	nvme_identify_ctrl_t *n_idctl;
 
@@ -195,7 +288,7 @@ struct nvme {
 	nvme_qpair_t *n_adminq;
 	/*
 	 * All command queues, including the admin queue.
-	 * Its length is: n_ioq_count + 1.
+	 * Its length is: n_ioq_count + n_pollq_count + 1.
 	 */
 	nvme_qpair_t **n_ioq;
 	nvme_cq_t **n_cq;
@@ -214,6 +307,24 @@ struct nvme {
 	/* state for devctl minor node */
 	nvme_minor_state_t n_minor;
 
+	/*
+	 * Interrupt coalescing state. The controller thread is the only one
+	 * issuing the features, n_coal_mutex only protects n_coal_exit.
+	 */
+	kthread_t *n_coal_thread;
+	kt_did_t n_coal_did;
+	kmutex_t n_coal_mutex;
+	kcondvar_t n_coal_cv;
+	boolean_t n_coal_exit;
+	uint_t n_coal_profile;		/* index into nvme_coal_profiles */
+	uint_t n_coal_raise;		/* intervals spent wanting more */
+	hrtime_t n_coal_sampled;	/* time of the last sample */
+	uint64_t n_coal_intrs;		/* ncq_intrs at the last sample */
+	uint64_t n_coal_intr_cmds;	/* ncq_intr_cmds at the last sample */
+	nvme_coal_vec_t *n_coal_vec;	/* n_intr_cnt entries */
+	kstat_t *n_coal_ksp;
+	nvme_coalstat_t n_coal_stat;
+
 	/* errors detected by driver */
 	uint32_t n_dma_bind_err;
 	uint32_t n_abort_failed;
@@ -222,6 +333,7 @@ struct nvme {
 	uint32_t n_wrong_logpage;
 	uint32_t n_unknown_logpage;
 	uint32_t n_too_many_cookies;
+	uint32_t n_failover;
 
 	/* errors detected by hardware */
 	uint32_t n_data_xfr_err;
@@ -240,6 +352,8 @@ struct nvme {
 	uint32_t n_cnfl_attr;
 	uint32_t n_inv_prot;
 	uint32_t n_readonly;
+	uint32_t n_ana_err;
+	uint32_t n_path_err;
 
 	/* errors reported by asynchronous events */
 	uint32_t n_diagfail_event;
@@ -250,6 +364,7 @@ struct nvme {
 	uint32_t n_temperature_event;
 	uint32_t n_spare_event;
 	uint32_t n_vendor_event;
+	uint32_t n_ana_event;
 	uint32_t n_unknown_event;
 
 	/* hot removal NDI event handling */
@@ -264,6 +379,37 @@ struct nvme {
 	kmutex_t n_fwslot_mutex;
 };
 
+/*
+ * A namespace shared by several controllers, identified by its NGUID or EUI64.
+ * The namespace of the controller attaching it first is the head, which owns
+ * the blkdev instance. All of them, including the head, are paths to post I/O
+ * to. The list of paths is protected by nm_lock.
+ */
+struct nvme_mpath {
+	list_node_t nm_node;
+	uint8_t nm_id[16];
+	nvme_namespace_t *nm_head;
+	int nm_policy;
+	krwlock_t nm_lock;
+	list_t nm_paths;
+	uint_t nm_npaths;
+	volatile uint32_t nm_next;	/* round-robin cursor */
+	list_t nm_waiting;		/* I/O waiting out an ANA transition */
+};
+
+/*
+ * A multipath I/O waiting for a path to finish an ANA transition. nw_mpath is
+ * cleared, under nvme_mpath_mutex, if the group goes away meanwhile.
+ */
+typedef struct nvme_mpath_wait {
+	list_node_t nw_node;
+	nvme_mpath_t *nw_mpath;
+	bd_xfer_t *nw_xfer;
+	uint8_t nw_opc;
+	uint_t nw_retries;
+	hrtime_t nw_deadline;
+} nvme_mpath_wait_t;
+
 struct nvme_namespace {
 	nvme_t *ns_nvme;
 	uint8_t ns_eui64[8];
@@ -277,6 +423,13 @@ struct nvme_namespace {
 	size_t ns_best_block_size;
 
 	boolean_t ns_ignore;
+	boolean_t ns_poll;	/* use the polled I/O queues */
+
+	/* multipath group of a shared namespace, and state of this path */
+	nvme_mpath_t *ns_mpath;
+	list_node_t ns_mpath_node;
+	uint8_t ns_ana_state;
+	volatile uint32_t ns_inflight;
 
 	nvme_identify_nsid_t *ns_idns;
 
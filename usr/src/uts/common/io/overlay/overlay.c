@@ -447,6 +447,23 @@
  * and potentially better ways to program receive filters so they get directly
  * to us. Though, that's all fantasy future land.
  *
+ * Transmit Offloads
+ *
+ * Without any offloads, every segment that TCP sends over an overlay has to
+ * be built, checksummed, and walked through the stack one MTU at a time. To
+ * avoid that, the overlay device advertises full checksum offload and basic
+ * IPv4 TCP LSO to MAC clients (this may be disabled through the
+ * overlay_tx_hcksum and overlay_tx_lso tunables). We don't have any hardware
+ * that understands the inner frame, so in overlay_m_tx() we perform the
+ * target lookup once per message from the client and then use mac_hw_emul()
+ * to checksum and segment the inner frame before it's encapsulated. The
+ * resulting segments all share the same destination and are encapsulated and
+ * handed to the mux as a single b_next chain. A UDP ksocket takes one datagram
+ * per call, so overlay_mux_tx() still sends the segments one at a time; what
+ * the chain saves is the per-segment target lookup. The outer IP and UDP
+ * headers are built by the stack itself, which will use the underlay NIC's
+ * checksum offload for them when it's available.
+ *
  * The next part of the puzzle is the target cache. The purpose of the target
  * cache is to cache where we should send a packet on the underlay network,
  * given its mac address. The target cache operates in two modes depending on
@@ -810,13 +827,17 @@
 #include <sys/param.h>
 #include <sys/sysmacros.h>
 #include <sys/ddifm.h>
+#include <sys/pattr.h>
+#include <sys/dlpi.h>
 
 #include <sys/dls.h>
 #include <sys/dld_ioc.h>
 #include <sys/mac_provider.h>
+#include <sys/mac_client.h>
 #include <sys/mac_client_priv.h>
 #include <sys/mac_ether.h>
 #include <sys/vlan.h>
+#include <inet/ip.h>
 
 #include <sys/overlay_impl.h>
 
@@ -845,6 +866,19 @@ static const char *overlay_dev_props[] = {
 #define	OVERLAY_MTU_DEF	1400
 #define	OVERLAY_MTU_MAX	8900
 
+/*
+ * Largest LSO message we'll accept from the stack. This is segmented in
+ * software before encapsulation, so it isn't bounded by the underlay.
+ */
+#define	OVERLAY_LSO_MAXLEN	IP_MAXPACKET
+
+/*
+ * Whether or not we advertise checksum and LSO offload to MAC clients. See the
+ * 'Transmit Offloads' section of the big theory statement.
+ */
+boolean_t overlay_tx_hcksum = B_TRUE;
+boolean_t overlay_tx_lso = B_TRUE;
+
 overlay_dev_t *
 overlay_hold_by_dlid(datalink_id_t id)
 {
@@ -1048,7 +1082,7 @@ mblk_t *
 overlay_m_tx(void *arg, mblk_t *mp_chain)
 {
 	overlay_dev_t *odd = arg;
-	mblk_t *mp, *ep;
+	mblk_t *mp, *nmp, *ep, *ehead, *etail;
 	int ret;
 	ovep_encap_info_t einfo;
 	struct msghdr hdr;
@@ -1088,15 +1122,51 @@ overlay_m_tx(void *arg, mblk_t *mp_chain)
 		hdr.msg_name = &storage;
 		hdr.msg_namelen = slen;
 
-		ret = odd->odd_plugin->ovp_ops->ovpo_encap(odd->odd_mh, mp,
-		    &einfo, &ep);
-		if (ret != 0 || ep == NULL) {
-			freemsg(mp);
-			goto out;
+		/*
+		 * Take care of any checksum or LSO work that we told our
+		 * clients we'd do before we wrap up the inner frame. This may
+		 * turn a single message into a chain of segments, all of which
+		 * share the destination we just looked up.
+		 */
+		if ((DB_CKSUMFLAGS(mp) & (HCK_TX_FLAGS | HW_LSO_FLAGS)) != 0) {
+			mac_hw_emul(&mp, NULL, NULL, MAC_ALL_EMULS);
+			if (mp == NULL) {
+				mp = mp_chain;
+				continue;
+			}
+		}
+
+		ehead = etail = NULL;
+		for (; mp != NULL; mp = nmp) {
+			nmp = mp->b_next;
+			mp->b_next = NULL;
+
+			ret = odd->odd_plugin->ovp_ops->ovpo_encap(odd->odd_mh,
+			    mp, &einfo, &ep);
+			if (ret != 0 || ep == NULL) {
+				freemsg(mp);
+				freemsgchain(nmp);
+				freemsgchain(ehead);
+				goto out;
+			}
+
+			ASSERT(ep->b_cont == mp || ep == mp);
+
+			/*
+			 * Any offload flags describe the inner frame and have
+			 * been dealt with above; they must not be applied to
+			 * the outer headers by the stack below us.
+			 */
+			DB_CKSUMFLAGS(ep) = 0;
+			if (ehead == NULL) {
+				ehead = etail = ep;
+			} else {
+				etail->b_next = ep;
+				etail = ep;
+			}
 		}
 
-		ASSERT(ep->b_cont == mp || ep == mp);
-		ret = overlay_mux_tx(odd->odd_mux, &hdr, ep);
+		ret = overlay_mux_tx(odd->odd_mux, &hdr, ehead);
 		if (ret != 0)
 			goto out;
 
@@ -1122,12 +1192,39 @@ overlay_m_ioctl(void *arg, queue_t *q, mblk_t *mp)
 static boolean_t
 overlay_m_getcapab(void *arg, mac_capab_t cap, void *cap_data)
 {
-	/*
-	 * Tell MAC we're an overlay.
-	 */
-	if (cap == MAC_CAPAB_OVERLAY)
-		return (B_TRUE);
-	return (B_FALSE);
+	switch (cap) {
+	case MAC_CAPAB_OVERLAY:
+		/*
+		 * Tell MAC we're an overlay.
+		 */
+		break;
+	case MAC_CAPAB_HCKSUM: {
+		uint32_t *hcksum_txflags = cap_data;
+
+		if (!overlay_tx_hcksum)
+			return (B_FALSE);
+		*hcksum_txflags = HCKSUM_INET_FULL_V4 | HCKSUM_INET_FULL_V6 |
+		    HCKSUM_IPHDRCKSUM;
+		break;
+	}
+	case MAC_CAPAB_LSO: {
+		mac_capab_lso_t *cap_lso = cap_data;
+
+		/*
+		 * Software LSO requires that we're also doing the checksums,
+		 * and mac_hw_emul() only knows how to segment TCP over IPv4.
+		 */
+		if (!overlay_tx_hcksum || !overlay_tx_lso)
+			return (B_FALSE);
+		cap_lso->lso_flags = LSO_TX_BASIC_TCP_IPV4;
+		cap_lso->lso_basic_tcp_ipv4.lso_max = OVERLAY_LSO_MAXLEN;
+		break;
+	}
+	default:
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
 }
 
 /* ARGSUSED */
@@ -346,26 +346,43 @@ overlay_mux_remove_dev(overlay_mux_t *mux, overlay_dev_t *odd)
 	mutex_exit(&mux->omux_lock);
 }
 
+/*
+ * Transmit a b_next chain of encapsulated messages, all of which are destined
+ * for the address in hdr. If we fail to send one of them, the rest of the chain
+ * is dropped as well.
+ */
 int
-overlay_mux_tx(overlay_mux_t *mux, struct msghdr *hdr, mblk_t *mp)
+overlay_mux_tx(overlay_mux_t *mux, struct msghdr *hdr, mblk_t *mp_chain)
 {
-	int ret;
+	int ret = 0;
+	mblk_t *mp, *nmp;
 
-	/*
-	 * It'd be nice to be able to use MSG_MBLK_QUICKRELE, unfortunately,
-	 * that isn't actually supported by UDP at this time.
-	 *
-	 * Send with MSG_DONTWAIT to indicate clogged UDP sockets upstack.
-	 */
-	ret = ksocket_sendmblk(mux->omux_ksock, hdr, MSG_DONTWAIT, &mp, kcred);
-	/*
-	 * NOTE: ksocket_sendmblk() may send partial packets downstack,
-	 * returning what's not sent in &mp (i.e. mp pre-call might be a
-	 * b_cont of mp post-call).  We can't hold up this message (it's a
-	 * datagram), so we drop, and let the caller cope.
-	 */
-	if (ret != 0)
-		freemsg(mp);
+	for (mp = mp_chain; mp != NULL; mp = nmp) {
+		nmp = mp->b_next;
+		mp->b_next = NULL;
+
+		/*
+		 * It'd be nice to be able to use MSG_MBLK_QUICKRELE,
+		 * unfortunately, that isn't actually supported by UDP at this
+		 * time.
+		 *
+		 * Send with MSG_DONTWAIT to indicate clogged UDP sockets
+		 * upstack.
+		 */
+		ret = ksocket_sendmblk(mux->omux_ksock, hdr, MSG_DONTWAIT, &mp,
+		    kcred);
+		/*
+		 * NOTE: ksocket_sendmblk() may send partial packets downstack,
+		 * returning what's not sent in &mp (i.e. mp pre-call might be
+		 * a b_cont of mp post-call).  We can't hold up this message
+		 * (it's a datagram), so we drop, and let the caller cope.
+		 */
+		if (ret != 0) {
+			freemsg(mp);
+			freemsgchain(nmp);
+			break;
+		}
+	}
 
 	return (ret);
 }
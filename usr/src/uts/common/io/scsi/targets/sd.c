@@ -179,6 +179,7 @@ static	char *sd_config_list		= "sd-config-list";
 #define	sd_reset_throttle_timeout	ssd_reset_throttle_timeout
 #define	sd_qfull_throttle_timeout	ssd_qfull_throttle_timeout
 #define	sd_qfull_throttle_enable	ssd_qfull_throttle_enable
+#define	sd_fastpath_enable		ssd_fastpath_enable
 #define	sd_check_media_time		ssd_check_media_time
 #define	sd_wait_cmds_complete		ssd_wait_cmds_complete
 #define	sd_label_mutex			ssd_label_mutex
@@ -243,6 +244,12 @@ int sd_min_throttle			= SD_MIN_THROTTLE;
 int sd_rot_delay			= 4; /* Default 4ms Rotation delay */
 int sd_qfull_throttle_enable		= TRUE;
 
+/*
+ * Submit buf IO on the plain disk chains through sd_fastpath_iostart(); see
+ * the comment there.
+ */
+int sd_fastpath_enable			= 0;
+
 int sd_retry_on_reservation_conflict	= 1;
 int sd_reinstate_resv_delay		= SD_REINSTATE_RESV_DELAY;
 _NOTE(SCHEME_PROTECTS_DATA("safe sharing", sd_reinstate_resv_delay))
@@ -928,12 +935,14 @@ static int sd_pm_idletime = 1;
 #define	sd_checksum_uscsi_iostart	ssd_checksum_uscsi_iostart
 #define	sd_pm_iostart			ssd_pm_iostart
 #define	sd_core_iostart			ssd_core_iostart
+#define	sd_fastpath_iostart		ssd_fastpath_iostart
 #define	sd_mapblockaddr_iodone		ssd_mapblockaddr_iodone
 #define	sd_mapblocksize_iodone		ssd_mapblocksize_iodone
 #define	sd_checksum_iodone		ssd_checksum_iodone
 #define	sd_checksum_uscsi_iodone	ssd_checksum_uscsi_iodone
 #define	sd_pm_iodone			ssd_pm_iodone
 #define	sd_initpkt_for_buf		ssd_initpkt_for_buf
+#define	sd_setup_bufpkt			ssd_setup_bufpkt
 #define	sd_destroypkt_for_buf		ssd_destroypkt_for_buf
 #define	sd_setup_rw_pkt			ssd_setup_rw_pkt
 #define	sd_setup_next_rw_pkt		ssd_setup_next_rw_pkt
@@ -1348,7 +1357,10 @@ static void sd_pm_iodone(int index, struct sd_lun *un, struct buf *bp);
  * Prototypes for functions to support buf(9S) based IO.
  */
 static void sd_xbuf_strategy(struct buf *bp, ddi_xbuf_t xp, void *arg);
+static void sd_fastpath_iostart(struct sd_lun *un, struct buf *bp);
 static int sd_initpkt_for_buf(struct buf *, struct scsi_pkt **);
+static void sd_setup_bufpkt(struct sd_lun *un, struct buf *bp,
+    struct scsi_pkt *pktp);
 static void sd_destroypkt_for_buf(struct buf *);
 static int sd_setup_rw_pkt(struct sd_lun *un, struct scsi_pkt **pktpp,
     struct buf *bp, int flags,
@@ -1918,6 +1930,13 @@ static sd_chain_t sd_iostart_chain[] = {
 #define	SD_CHAIN_MSS_CHKSUM_IOSTART		26
 #define	SD_CHAIN_MSS_CHKSUM_IOSTART_NO_PM	31
 
+/*
+ * Locations of sd_core_iostart() in the two plain disk chains, for
+ * sd_fastpath_iostart(), which does the work of the layers above it itself.
+ */
+#define	SD_CHAIN_DISK_CORE			2
+#define	SD_CHAIN_DISK_CORE_NO_PM		4
+
 
 /*
  * Table of function pointers for the iodone-side routines for the driver-
@@ -11692,6 +11711,7 @@ static void
 sd_xbuf_strategy(struct buf *bp, ddi_xbuf_t xp, void *arg)
 {
 	struct sd_lun *un = arg;
+	int index;
 
 	ASSERT(bp != NULL);
 	ASSERT(xp != NULL);
@@ -11704,8 +11724,15 @@ sd_xbuf_strategy(struct buf *bp, ddi_xbuf_t xp, void *arg)
 	 */
 	sd_xbuf_init(un, bp, xp, SD_CHAIN_BUFIO, NULL);
 
+	index = ((struct sd_xbuf *)xp)->xb_chain_iostart;
+	if (sd_fastpath_enable != 0 && (index == SD_CHAIN_DISK_IOSTART ||
+	    index == SD_CHAIN_DISK_IOSTART_NO_PM)) {
+		sd_fastpath_iostart(un, bp);
+		return;
+	}
+
 	/* Send the buf down the iostart chain */
-	SD_BEGIN_IOSTART(((struct sd_xbuf *)xp)->xb_chain_iostart, un, bp);
+	SD_BEGIN_IOSTART(index, un, bp);
 }
 
 
@@ -13733,6 +13760,180 @@ sd_core_iostart(int index, struct sd_lun *un, struct buf *bp)
 }
 
 
+/*
+ *    Function: sd_fastpath_iostart
+ *
+ * Description: Submission path for buf(9S) IO on the plain disk chains,
+ *		SD_CHAIN_DISK_IOSTART and SD_CHAIN_DISK_IOSTART_NO_PM.  For
+ *		an aligned transfer lying wholly within a valid partition,
+ *		this does the work of sd_mapblockaddr_iostart(),
+ *		sd_pm_iostart() and sd_core_iostart() itself; anything
+ *		else is sent down the iostart chain, which knows how to
+ *		fail or trim it.
+ *
+ *		Under a single short hold of SD_MUTEX, the buf either
+ *		joins the wait queue, without a packet, for
+ *		sd_start_cmds() to deal with as usual, or, when nothing
+ *		is queued ahead of it, no retry or recovery is pending
+ *		and the throttle allows it, takes a slot in the transport
+ *		count.  Only then are the scsi_pkt and its DMA resources
+ *		allocated, and the command transported, without SD_MUTEX,
+ *		where sd_start_cmds() would drop and retake it around
+ *		both.  A command which cannot be allocated or which the
+ *		HBA does not take goes back to the head of the wait queue
+ *		and is left to sd_start_cmds().  Completion takes the
+ *		same iodone chain as it would have.
+ *
+ *		This is off by default: setting sd_fastpath_enable sends
+ *		plain disk IO this way, clearing it sends all IO down the
+ *		chain.
+ *
+ *     Context: Kernel thread context. Can sleep.
+ */
+
+static void
+sd_fastpath_iostart(struct sd_lun *un, struct buf *bp)
+{
+	struct sd_xbuf	*xp;
+	struct scsi_pkt	*pktp = NULL;
+	diskaddr_t	nblocks;
+	diskaddr_t	partition_offset;
+	daddr_t		blocknum;
+	size_t		blockcount;
+	int		blknomask, secmask;
+	int		core;
+	int		rval;
+
+	ASSERT(un != NULL);
+	ASSERT(bp != NULL);
+	ASSERT(!mutex_owned(SD_MUTEX(un)));
+
+	SD_TRACE(SD_LOG_IO_CORE, un,
+	    "sd_fastpath_iostart: entry: bp:0x%p\n", bp);
+
+	xp = SD_GET_XBUF(bp);
+	ASSERT(xp != NULL);
+
+	core = (xp->xb_chain_iostart == SD_CHAIN_DISK_IOSTART) ?
+	    SD_CHAIN_DISK_CORE : SD_CHAIN_DISK_CORE_NO_PM;
+
+	/*
+	 * The failfast state is tested without SD_MUTEX: a buf racing with
+	 * its activation is no different from one already on the waitq.
+	 */
+	if (NOT_DEVBSIZE(un) || un->un_f_enable_rmw ||
+	    !SD_IS_VALID_LABEL(un) || bp->b_bcount == 0 ||
+	    ((bp->b_flags & B_FAILFAST) != 0 &&
+	    un->un_failfast_state == SD_FAILFAST_ACTIVE)) {
+		goto chain;
+	}
+
+	if (cmlb_partinfo(un->un_cmlbhandle, SDPART(bp->b_edev), &nblocks,
+	    &partition_offset, NULL, NULL, (void *)SD_PATH_DIRECT) != 0) {
+		goto chain;
+	}
+
+	blknomask = (un->un_tgt_blocksize / DEV_BSIZE) - 1;
+	secmask = un->un_tgt_blocksize - 1;
+	if ((bp->b_lblkno & blknomask) != 0 || (bp->b_bcount & secmask) != 0)
+		goto chain;
+
+	blocknum = SD_SYS2TGTBLOCK(un, xp->xb_blkno);
+	blockcount = SD_BYTES2TGTBLOCKS(un, bp->b_bcount);
+	if (blocknum < 0 || (diskaddr_t)blocknum >= nblocks ||
+	    blockcount > nblocks - blocknum) {
+		goto chain;
+	}
+
+	/* Convert the block number to an absolute address. */
+	xp->xb_blkno = blocknum + partition_offset;
+
+	if (core == SD_CHAIN_DISK_CORE && sd_pm_entry(un) != DDI_SUCCESS) {
+		bioerror(bp, EIO);
+		bp->b_resid = bp->b_bcount;
+		SD_BEGIN_IODONE(core - 1, un, bp);
+		return;
+	}
+
+	mutex_enter(SD_MUTEX(un));
+	if (un->un_state != SD_STATE_NORMAL || un->un_waitq_headp != NULL ||
+	    un->un_retry_bp != NULL || un->un_startstop_timeid != NULL ||
+	    un->un_direct_priority_timeid != NULL ||
+	    un->un_ncmds_in_transport >= un->un_throttle || ddi_in_panic()) {
+		/* Queue it as sd_core_iostart() would. */
+		sd_add_buf_to_waitq(un, bp);
+		SD_UPDATE_KSTATS(un, kstat_waitq_enter, bp);
+		sd_start_cmds(un, NULL);
+		mutex_exit(SD_MUTEX(un));
+		return;
+	}
+
+	/*
+	 * Take the command's place against the throttle before dropping
+	 * SD_MUTEX, so that sd_start_cmds() cannot overcommit meanwhile.
+	 */
+	un->un_ncmds_in_transport++;
+	SD_UPDATE_KSTATS(un, kstat_runq_enter, bp);
+	mutex_exit(SD_MUTEX(un));
+
+	/*
+	 * With NULL_FUNC there is no runout callback to arrange for.  If the
+	 * allocation fails, leave it to sd_start_cmds() to retry with one,
+	 * or to fail the buf; clear any error the attempt left on it first.
+	 */
+	rval = sd_setup_rw_pkt(un, &pktp, bp, un->un_pkt_flags, NULL_FUNC,
+	    NULL, (diskaddr_t)xp->xb_blkno, blockcount);
+	if (rval != 0) {
+		bioerror(bp, 0);
+		goto requeue;
+	}
+	sd_setup_bufpkt(un, bp, pktp);
+	xp->xb_pktp = pktp;
+
+	/*
+	 * As in sd_start_cmds(), the completion may run before
+	 * scsi_transport() returns, so neither bp nor pktp may be
+	 * referenced once the command has been accepted.
+	 */
+	DTRACE_PROBE1(scsi__transport__dispatch, struct buf *, bp);
+	rval = scsi_transport(pktp);
+	if (rval == TRAN_ACCEPT) {
+		if (un->un_tran_fatal_count != 0) {
+			mutex_enter(SD_MUTEX(un));
+			un->un_tran_fatal_count = 0;
+			mutex_exit(SD_MUTEX(un));
+		}
+		SD_TRACE(SD_LOG_IO_CORE, un, "sd_fastpath_iostart: exit\n");
+		return;
+	}
+
+	/*
+	 * The HBA did not take the command.  Return the buf to the head of
+	 * the waitq and have sd_start_cmds() resend it, so that TRAN_BUSY
+	 * and transport errors are dealt with in one place.
+	 */
+	SD_TRACE(SD_LOG_IO_CORE | SD_LOG_ERROR, un,
+	    "sd_fastpath_iostart: scsi_transport() returned %d\n", rval);
+
+requeue:
+	mutex_enter(SD_MUTEX(un));
+	un->un_ncmds_in_transport--;
+	ASSERT(un->un_ncmds_in_transport >= 0);
+	SD_UPDATE_KSTATS(un, kstat_runq_back_to_waitq, bp);
+	bp->av_forw = un->un_waitq_headp;
+	un->un_waitq_headp = bp;
+	if (un->un_waitq_tailp == NULL) {
+		un->un_waitq_tailp = bp;
+	}
+	sd_start_cmds(un, NULL);
+	mutex_exit(SD_MUTEX(un));
+	return;
+
+chain:
+	SD_BEGIN_IOSTART(xp->xb_chain_iostart, un, bp);
+}
+
+
 /*
  *    Function: sd_init_cdb_limits
  *
@@ -13896,33 +14097,8 @@ sd_initpkt_for_buf(struct buf *bp, struct scsi_pkt **pktpp)
 	    startblock, blockcount);
 
 	if (rval == 0) {
-		/*
-		 * Success.
-		 *
-		 * If partial DMA is being used and required for this transfer.
-		 * set it up here.
-		 */
-		if ((un->un_pkt_flags & PKT_DMA_PARTIAL) != 0 &&
-		    (pktp->pkt_resid != 0)) {
-
-			/*
-			 * Save the CDB length and pkt_resid for the
-			 * next xfer
-			 */
-			xp->xb_dma_resid = pktp->pkt_resid;
-
-			/* rezero resid */
-			pktp->pkt_resid = 0;
-
-		} else {
-			xp->xb_dma_resid = 0;
-		}
-
-		pktp->pkt_flags = un->un_tagflags;
-		pktp->pkt_time  = un->un_cmd_timeout;
-		pktp->pkt_comp  = sdintr;
-
-		pktp->pkt_private = bp;
+		/* Success. */
+		sd_setup_bufpkt(un, bp, pktp);
 		*pktpp = pktp;
 
 		SD_TRACE(SD_LOG_IO_CORE, un,
@@ -13979,6 +14155,50 @@ sd_initpkt_for_buf(struct buf *bp, struct scsi_pkt **pktpp)
 }
 
 
+/*
+ *    Function: sd_setup_bufpkt
+ *
+ * Description: Complete the initialization of a scsi_pkt(9S) returned by
+ *		sd_setup_rw_pkt() for the given buf.
+ *
+ *     Context: Kernel thread and may be called from software interrupt context
+ *		as part of a sdrunout callback. This function may not block or
+ *		call routines that block
+ */
+
+static void
+sd_setup_bufpkt(struct sd_lun *un, struct buf *bp, struct scsi_pkt *pktp)
+{
+	struct sd_xbuf	*xp = SD_GET_XBUF(bp);
+
+	/*
+	 * If partial DMA is being used and required for this transfer.
+	 * set it up here.
+	 */
+	if ((un->un_pkt_flags & PKT_DMA_PARTIAL) != 0 &&
+	    (pktp->pkt_resid != 0)) {
+
+		/*
+		 * Save the CDB length and pkt_resid for the
+		 * next xfer
+		 */
+		xp->xb_dma_resid = pktp->pkt_resid;
+
+		/* rezero resid */
+		pktp->pkt_resid = 0;
+
+	} else {
+		xp->xb_dma_resid = 0;
+	}
+
+	pktp->pkt_flags = un->un_tagflags;
+	pktp->pkt_time  = un->un_cmd_timeout;
+	pktp->pkt_comp  = sdintr;
+
+	pktp->pkt_private = bp;
+}
+
+
 /*
  *    Function: sd_destroypkt_for_buf
  *
@@ -0,0 +1,2242 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Support for shared-memory submission and completion rings for file and
+ * socket I/O, binary compatible with the Linux io_uring facility.
+ *
+ * Rings
+ *
+ * Each open of /dev/uring is a clone which, once URINGIOC_SETUP has been
+ * issued, owns a submission queue (SQ) and a completion queue (CQ).  Their
+ * memory comes from ddi_umem_alloc() and is exported to the process with
+ * devmap at the offsets that Linux uses: the SQ indices, the CQ indices, the
+ * completion queue entries (CQEs) and the SQ index array are in a single
+ * mapping (IORING_FEAT_SINGLE_MMAP), and the submission queue entries (SQEs)
+ * themselves are in a second.  The application fills in SQEs, places their
+ * indices in the SQ array, advances the SQ tail and calls io_uring_enter()
+ * (URINGIOC_ENTER); the kernel consumes the SQ from its head and posts a CQE
+ * at the CQ tail for each operation, and the application consumes CQEs by
+ * advancing the CQ head.  The indices are free-running 32-bit counters masked
+ * by the (power of two) ring sizes, and each index written by one side and
+ * read by the other sits on a cache line of its own.  The kernel keeps its
+ * own copies of the SQ head and CQ tail; what the application may write (the
+ * SQ tail, the SQ array and the CQ head) is only ever read and bounded.
+ *
+ * Execution
+ *
+ * There is no kernel thread polling the SQ: entries are consumed by
+ * io_uring_enter(), which amortizes one system call over a batch of
+ * operations.  How an operation is performed depends upon what it needs:
+ *
+ *   - Reads and writes to user buffers, and socket sends, receives and
+ *     accepts, need the submitting process's address space or file table, and
+ *     are performed by the submitting thread.  On regular files they simply
+ *     run to completion.  On anything else they are attempted without
+ *     blocking and, if they would block, the request is parked (see below) --
+ *     unless the file has itself been put in non-blocking mode, in which case
+ *     the result is EAGAIN, as it is on Linux.
+ *
+ *   - Reads and writes to registered buffers on regular files and block
+ *     devices, and fsync, need nothing from the process and are performed
+ *     asynchronously on uring_taskq.
+ *
+ *   - Poll requests complete immediately if the file is ready, and are
+ *     parked if it is not.
+ *
+ * Submissions are only admitted while the CQ has room for all outstanding
+ * completions, so the CQ never overflows; if nothing can be admitted,
+ * io_uring_enter() fails with EBUSY.
+ *
+ * Parked requests
+ *
+ * A parked request waits for its file in the same way that an fd in an epoll
+ * set does.  Each ring has a pollcache, set up with PC_READYQ, and each
+ * request embeds a polldat (with pd_fd set to a per-ring slot number) which is
+ * placed on the file's pollhead while the request is parked; pollwakeup()
+ * then queues the polldat on pc_ready and broadcasts pc_cv.  Ready requests
+ * are retried whenever the ring is entered, to submit or to wait: those that
+ * make progress are completed, and the rest stay parked.  A thread waiting
+ * in io_uring_enter() for completions sleeps on pc_cv, which is broadcast
+ * both for parked requests becoming ready and for completions from
+ * uring_taskq.  The ring polls as readable when there are completions to
+ * consume or parked requests to retry and, like a nested epoll fd, links its
+ * pollcache to that of the thread polling it so that the latter is woken for
+ * both; an application that waits for its ring with poll(2) or epoll, rather
+ * than in io_uring_enter(), must therefore enter the ring when it is readable
+ * but has no completions.
+ *
+ * Registered files and buffers
+ *
+ * IORING_REGISTER_FILES holds the given files for the life of the
+ * registration, so that IOSQE_FIXED_FILE requests need no fd lookup.  Requests
+ * on other files hold their file (with getf()) only while being performed by
+ * the submitter, and take a reference of their own only when parked or handed
+ * to uring_taskq.  IORING_REGISTER_BUFFERS locks each buffer down with
+ * umem_lockmemory() -- charged against max-locked-memory -- and maps it into
+ * the kernel, so that the *_FIXED operations need neither page locking nor
+ * user copies, and can be performed by uring_taskq.  The locking is
+ * long-term: should the process unmap a registered buffer, or exit, the umem
+ * callback (uring_buf_cleanup()) unlocks it, waiting only for operations
+ * actually in progress on it, and requests using it thereafter fail with
+ * EFAULT.  Because a ring may be closed from within as_unmap() (when its last
+ * mapping goes away after its fd), buffers are released by its close on
+ * uring_taskq.
+ *
+ * Brands
+ *
+ * The lx brand's io_uring_setup(), io_uring_enter() and io_uring_register()
+ * open /dev/uring and issue the ioctls here, having supplied (with the
+ * kernel-only URINGIOC_XLATE) a uring_xlate_t with which flags in SQEs are
+ * translated from and results in CQEs translated to Linux values.
+ *
+ * Not supported are SQ polling and I/O polling, linked and drained requests,
+ * and the operations without definitions in sys/io_uring.h.
+ */
+
+#include <sys/ddi.h>
+#include <sys/sunddi.h>
+#include <sys/esunddi.h>
+#include <sys/ddidevmap.h>
+#include <sys/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/conf.h>
+#include <sys/vmem.h>
+#include <sys/sysmacros.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/nbmlock.h>
+#include <sys/limits.h>
+#include <sys/fcntl.h>
+#include <sys/disp.h>
+#include <sys/poll_impl.h>
+#include <sys/id_space.h>
+#include <sys/taskq.h>
+#include <sys/modhash.h>
+#include <sys/schedctl.h>
+#include <sys/stropts.h>
+#include <sys/socket.h>
+#include <sys/socketvar.h>
+#include <fs/sockfs/sockcommon.h>
+#include <vm/as.h>
+
+/*
+ * The layout of the shared memory holding the indices, the CQEs and the SQ
+ * array, in that order.
+ */
+typedef struct uring_shared {
+	uint32_t	us_sq_head;		/* written by the kernel */
+	uint32_t	us_pad0[15];
+	uint32_t	us_sq_tail;		/* written by the application */
+	uint32_t	us_pad1[15];
+	uint32_t	us_cq_head;		/* written by the application */
+	uint32_t	us_pad2[15];
+	uint32_t	us_cq_tail;		/* written by the kernel */
+	uint32_t	us_pad3[15];
+	uint32_t	us_sq_mask;		/* constant from here on */
+	uint32_t	us_sq_entries;
+	uint32_t	us_sq_flags;
+	uint32_t	us_sq_dropped;
+	uint32_t	us_cq_mask;
+	uint32_t	us_cq_entries;
+	uint32_t	us_cq_overflow;
+	uint32_t	us_cq_flags;
+	uint32_t	us_pad4[8];
+	struct io_uring_cqe us_cqes[1];		/* followed by the SQ array */
+} uring_shared_t;
+
+#define	URING_LOAD(x)		(*(volatile uint32_t *)&(x))
+#define	URING_STORE(x, v)	(*(volatile uint32_t *)&(x) = (v))
+
+/*
+ * Largest transfer of any one operation, so that its result fits in a CQE.
+ */
+#define	URING_RW_MAX	(INT32_MAX & PAGEMASK)
+
+#define	URING_IOV_STACK	8
+
+typedef struct uring uring_t;
+
+/*
+ * A registered buffer.  ub_refs counts the ring's reference and those of
+ * requests and of uring_buf_cleanup(); ub_ops counts the operations
+ * currently transferring to or from the buffer, which must drain before it
+ * is unlocked.
+ */
+typedef struct uring_buf {
+	kmutex_t	ub_lock;		/* protects ub_ops, ub_locked */
+	kcondvar_t	ub_cv;			/* ub_ops has drained */
+	uint_t		ub_refs;		/* references, atomic */
+	uint_t		ub_ops;			/* operations in progress */
+	boolean_t	ub_locked;		/* pages are still locked */
+	ddi_umem_cookie_t ub_cookie;		/* from umem_lockmemory() */
+	buf_t		*ub_bp;			/* from ddi_umem_iosetup() */
+	uintptr_t	ub_uaddr;		/* user address */
+	size_t		ub_len;			/* length */
+	caddr_t		ub_kaddr;		/* kernel address of ub_uaddr */
+} uring_buf_t;
+
+/*
+ * A request, from submission to completion.
+ */
+typedef struct uring_req {
+	polldat_t	urq_pd;			/* while parked */
+	list_node_t	urq_link;		/* on ur_async or ur_parked */
+	uring_t		*urq_ring;		/* owning ring */
+	file_t		*urq_fp;		/* file operated upon */
+	boolean_t	urq_held;		/* urq_fp is held */
+	boolean_t	urq_async;		/* on uring_taskq */
+	uring_buf_t	*urq_buf;		/* registered buffer, if any */
+	rlim64_t	urq_fsz_ctl;		/* submitter's RLIMIT_FSIZE */
+	struct io_uring_sqe urq_sqe;		/* stable copy of the SQE */
+} uring_req_t;
+
+#define	URQ_FROM_PD(pdp)	\
+	((uring_req_t *)((uintptr_t)(pdp) - offsetof(uring_req_t, urq_pd)))
+
+/*
+ * Per-ring state.  ur_submit_lock serializes consumption of the SQ and
+ * everything done by the submitter -- performing and parking requests, and
+ * registration -- and so protects the SQ head, the parked requests and the
+ * registered files and buffers.  ur_lock protects the CQ tail and everything
+ * shared with uring_taskq.  ur_submit_lock, when both are held, is taken
+ * first; pc_lock of ur_pcache is never held while taking either.
+ */
+struct uring {
+	kmutex_t	ur_submit_lock;		/* see above */
+	kmutex_t	ur_lock;		/* see above */
+	kcondvar_t	ur_cv;			/* ur_async has drained */
+	boolean_t	ur_setup;		/* rings have been set up */
+	boolean_t	ur_wake;		/* CQEs to announce */
+	struct as	*ur_as;			/* creator's address space */
+	const uring_xlate_t *ur_xlate;		/* brand translations */
+	ddi_umem_cookie_t ur_ring_cookie;	/* indices, CQEs, SQ array */
+	size_t		ur_ring_size;
+	uring_shared_t	*ur_shared;
+	uint32_t	*ur_sq_array;
+	ddi_umem_cookie_t ur_sqe_cookie;	/* SQEs */
+	size_t		ur_sqe_size;
+	struct io_uring_sqe *ur_sqes;
+	uint32_t	ur_sq_entries;		/* size of SQ */
+	uint32_t	ur_cq_entries;		/* size of CQ */
+	uint32_t	ur_sq_head;		/* authoritative SQ head */
+	uint32_t	ur_cq_tail;		/* authoritative CQ tail */
+	uint32_t	ur_inflight;		/* admitted, not completed */
+	uint32_t	ur_nwaiters;		/* threads waiting for CQEs */
+	list_t		ur_async;		/* requests on uring_taskq */
+	list_t		ur_parked;		/* parked requests */
+	pollcache_t	*ur_pcache;		/* parked request wake-ups */
+	id_space_t	*ur_slots;		/* pd_fd of parked requests */
+	file_t		**ur_files;		/* registered files */
+	uint_t		ur_nfiles;
+	uring_buf_t	**ur_bufs;		/* registered buffers */
+	uint_t		ur_nbufs;
+	file_t		*ur_eventfd;		/* registered eventfd */
+	pollhead_t	ur_pollhd;		/* poll head */
+};
+
+/*
+ * Operations, and how they are performed.
+ */
+#define	URO_VALID	0x01			/* supported */
+#define	URO_FILE	0x02			/* operates on a file */
+#define	URO_FIXED	0x04			/* uses a registered buffer */
+
+static const uint8_t uring_optab[IORING_OP_LAST] = {
+	[IORING_OP_NOP] =		URO_VALID,
+	[IORING_OP_READV] =		URO_VALID | URO_FILE,
+	[IORING_OP_WRITEV] =		URO_VALID | URO_FILE,
+	[IORING_OP_FSYNC] =		URO_VALID | URO_FILE,
+	[IORING_OP_READ_FIXED] =	URO_VALID | URO_FILE | URO_FIXED,
+	[IORING_OP_WRITE_FIXED] =	URO_VALID | URO_FILE | URO_FIXED,
+	[IORING_OP_POLL_ADD] =		URO_VALID | URO_FILE,
+	[IORING_OP_POLL_REMOVE] =	URO_VALID,
+	[IORING_OP_ACCEPT] =		URO_VALID | URO_FILE,
+	[IORING_OP_ASYNC_CANCEL] =	URO_VALID,
+	[IORING_OP_READ] =		URO_VALID | URO_FILE,
+	[IORING_OP_WRITE] =		URO_VALID | URO_FILE,
+	[IORING_OP_SEND] =		URO_VALID | URO_FILE,
+	[IORING_OP_RECV] =		URO_VALID | URO_FILE,
+};
+
+/*
+ * Tunables.
+ */
+uint_t		uring_max_entries = IORING_MAX_ENTRIES;	/* SQ size limit */
+uint_t		uring_max_files = 32768;	/* registered files limit */
+uint_t		uring_max_bufs = 1024;		/* registered buffers limit */
+size_t		uring_max_buflen = 1UL << 30;	/* registered buffer size */
+int		uring_taskq_nthreads = 16;	/* uring_taskq threads */
+
+/*
+ * Internal global variables.
+ */
+static kmutex_t		uring_lock;		/* lock protecting state */
+static dev_info_t	*uring_devi;		/* device info */
+static major_t		uring_major;		/* our major number */
+static vmem_t		*uring_minor;		/* minor number arena */
+static void		*uring_softstate;	/* softstate pointer */
+static taskq_t		*uring_taskq;		/* asynchronous operations */
+static kmem_cache_t	*uring_req_cache;	/* requests */
+static mod_hash_t	*uring_buf_hash;	/* umem cookie to buffer */
+
+static void uring_buf_cleanup(ddi_umem_cookie_t *);
+
+static struct umem_callback_ops uring_umem_cbops = {
+	UMEM_CALLBACK_VERSION,
+	uring_buf_cleanup,
+};
+
+/*
+ * Copy in an array of iovecs in the data model of the current process.
+ */
+static int
+uring_iov_copyin(uint64_t uaddr, uint_t cnt, iovec_t *iov, ssize_t *countp)
+{
+	ssize_t count = 0;
+	uint_t i;
+
+#ifdef _SYSCALL32_IMPL
+	if (get_udatamodel() == DATAMODEL_ILP32) {
+		size_t len = cnt * sizeof (iovec32_t);
+		iovec32_t *iov32 = kmem_alloc(len, KM_SLEEP);
+
+		if (copyin((void *)(uintptr_t)uaddr, iov32, len) != 0) {
+			kmem_free(iov32, len);
+			return (EFAULT);
+		}
+		for (i = 0; i < cnt; i++) {
+			iov[i].iov_base = (caddr_t)(uintptr_t)iov32[i].iov_base;
+			iov[i].iov_len = iov32[i].iov_len;
+		}
+		kmem_free(iov32, len);
+	} else
+#endif
+	if (copyin((void *)(uintptr_t)uaddr, iov, cnt * sizeof (iovec_t)) != 0)
+		return (EFAULT);
+
+	for (i = 0; i < cnt; i++) {
+		if (iov[i].iov_len > URING_RW_MAX ||
+		    (count += iov[i].iov_len) > URING_RW_MAX)
+			return (EINVAL);
+	}
+	*countp = count;
+	return (0);
+}
+
+static void
+uring_buf_rele(uring_buf_t *ub)
+{
+	if (atomic_dec_uint_nv(&ub->ub_refs) != 0)
+		return;
+
+	ASSERT(!ub->ub_locked);
+	cv_destroy(&ub->ub_cv);
+	mutex_destroy(&ub->ub_lock);
+	kmem_free(ub, sizeof (uring_buf_t));
+}
+
+/*ARGSUSED*/
+static void
+uring_buf_hold_cb(mod_hash_key_t key, mod_hash_val_t val)
+{
+	atomic_inc_uint(&((uring_buf_t *)val)->ub_refs);
+}
+
+/*
+ * Begin and end a transfer to or from a registered buffer, which fails if it
+ * has been unlocked.
+ */
+static boolean_t
+uring_buf_enter(uring_buf_t *ub)
+{
+	boolean_t locked;
+
+	mutex_enter(&ub->ub_lock);
+	if ((locked = ub->ub_locked) != B_FALSE)
+		ub->ub_ops++;
+	mutex_exit(&ub->ub_lock);
+	return (locked);
+}
+
+static void
+uring_buf_exit(uring_buf_t *ub)
+{
+	mutex_enter(&ub->ub_lock);
+	ASSERT(ub->ub_ops > 0);
+	if (--ub->ub_ops == 0)
+		cv_broadcast(&ub->ub_cv);
+	mutex_exit(&ub->ub_lock);
+}
+
+/*
+ * Unlock a registered buffer once transfers in progress have drained.  This
+ * is done by whichever of the ring and uring_buf_cleanup() gets here first,
+ * and that one also removes the buffer from uring_buf_hash, before the
+ * cookie can be freed and reused.
+ */
+static void
+uring_buf_unlock(uring_buf_t *ub)
+{
+	mod_hash_val_t val;
+	boolean_t locked;
+
+	mutex_enter(&ub->ub_lock);
+	while (ub->ub_ops != 0)
+		cv_wait(&ub->ub_cv, &ub->ub_lock);
+	locked = ub->ub_locked;
+	ub->ub_locked = B_FALSE;
+	mutex_exit(&ub->ub_lock);
+
+	if (!locked)
+		return;
+
+	(void) mod_hash_remove(uring_buf_hash, (mod_hash_key_t)ub->ub_cookie,
+	    &val);
+	bp_mapout(ub->ub_bp);
+	freerbuf(ub->ub_bp);
+	ddi_umem_unlock(ub->ub_cookie);
+}
+
+/*
+ * The umem_lockmemory() callback, called when a registered buffer is unmapped
+ * or its process exits.
+ */
+static void
+uring_buf_cleanup(ddi_umem_cookie_t *cookie)
+{
+	mod_hash_val_t val;
+
+	if (mod_hash_find_cb(uring_buf_hash, (mod_hash_key_t)cookie, &val,
+	    uring_buf_hold_cb) != 0) {
+		/* the ring has already unlocked it */
+		return;
+	}
+
+	uring_buf_unlock((uring_buf_t *)val);
+	uring_buf_rele((uring_buf_t *)val);
+}
+
+/*
+ * Release the ring's reference to a registered buffer; this is the
+ * uring_taskq function used when the ring is closed.
+ */
+static void
+uring_buf_reclaim(void *arg)
+{
+	uring_buf_t *ub = arg;
+
+	uring_buf_unlock(ub);
+	uring_buf_rele(ub);
+}
+
+static int
+uring_buf_create(iovec_t *iov, uring_buf_t **ubp)
+{
+	uintptr_t uaddr = (uintptr_t)iov->iov_base;
+	uintptr_t base, end;
+	uring_buf_t *ub;
+	int error;
+
+	if (iov->iov_len == 0 || iov->iov_len > uring_max_buflen ||
+	    uaddr + iov->iov_len < uaddr)
+		return (EINVAL);
+
+	base = P2ALIGN(uaddr, PAGESIZE);
+	end = P2ROUNDUP(uaddr + iov->iov_len, PAGESIZE);
+
+	ub = kmem_zalloc(sizeof (uring_buf_t), KM_SLEEP);
+	mutex_init(&ub->ub_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&ub->ub_cv, NULL, CV_DEFAULT, NULL);
+	ub->ub_refs = 1;
+	ub->ub_uaddr = uaddr;
+	ub->ub_len = iov->iov_len;
+
+	if ((error = umem_lockmemory((caddr_t)base, end - base,
+	    DDI_UMEMLOCK_READ | DDI_UMEMLOCK_WRITE | DDI_UMEMLOCK_LONGTERM,
+	    &ub->ub_cookie, &uring_umem_cbops, NULL)) != 0) {
+		uring_buf_rele(ub);
+		return (error);
+	}
+
+	ub->ub_bp = ddi_umem_iosetup(ub->ub_cookie, 0, end - base, B_READ,
+	    NODEV, 0, NULL, DDI_UMEM_SLEEP);
+	bp_mapin(ub->ub_bp);
+	ub->ub_kaddr = ub->ub_bp->b_un.b_addr + (uaddr - base);
+	ub->ub_locked = B_TRUE;
+
+	VERIFY0(mod_hash_insert(uring_buf_hash, (mod_hash_key_t)ub->ub_cookie,
+	    (mod_hash_val_t)ub));
+
+	*ubp = ub;
+	return (0);
+}
+
+static void
+uring_bufs_release(uring_buf_t **bufs, uint_t nbufs, boolean_t defer)
+{
+	for (uint_t i = 0; i < nbufs; i++) {
+		if (bufs[i] == NULL)
+			continue;
+
+		if (defer) {
+			(void) taskq_dispatch(uring_taskq, uring_buf_reclaim,
+			    bufs[i], TQ_SLEEP);
+		} else {
+			uring_buf_reclaim(bufs[i]);
+		}
+	}
+	kmem_free(bufs, nbufs * sizeof (uring_buf_t *));
+}
+
+static int
+uring_bufs_register(uring_t *ur, uint64_t uaddr, uint_t nr)
+{
+	uring_buf_t **bufs;
+	iovec_t *iov;
+	ssize_t count;
+	int error = 0;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	if (ur->ur_nbufs != 0)
+		return (EBUSY);
+	if (nr == 0 || nr > uring_max_bufs)
+		return (EINVAL);
+
+	iov = kmem_alloc(nr * sizeof (iovec_t), KM_SLEEP);
+	bufs = kmem_zalloc(nr * sizeof (uring_buf_t *), KM_SLEEP);
+
+	/*
+	 * The total length is of no interest here, and may well exceed what
+	 * uring_iov_copyin() allows; the buffers are checked one at a time.
+	 */
+	if ((error = uring_iov_copyin(uaddr, nr, iov, &count)) == EINVAL)
+		error = 0;
+
+	for (uint_t i = 0; error == 0 && i < nr; i++)
+		error = uring_buf_create(&iov[i], &bufs[i]);
+
+	kmem_free(iov, nr * sizeof (iovec_t));
+
+	if (error != 0) {
+		uring_bufs_release(bufs, nr, B_FALSE);
+		return (error);
+	}
+
+	ur->ur_bufs = bufs;
+	ur->ur_nbufs = nr;
+	return (0);
+}
+
+static void
+uring_files_release(file_t **files, uint_t nfiles)
+{
+	for (uint_t i = 0; i < nfiles; i++) {
+		if (files[i] != NULL)
+			(void) closef(files[i]);
+	}
+	kmem_free(files, nfiles * sizeof (file_t *));
+}
+
+static int
+uring_files_register(uring_t *ur, uint64_t uaddr, uint_t nr)
+{
+	file_t **files;
+	int32_t *fds;
+	int error = 0;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	if (ur->ur_nfiles != 0)
+		return (EBUSY);
+	if (nr == 0 || nr > uring_max_files)
+		return (EINVAL);
+
+	fds = kmem_alloc(nr * sizeof (int32_t), KM_SLEEP);
+	files = kmem_zalloc(nr * sizeof (file_t *), KM_SLEEP);
+
+	if (copyin((void *)(uintptr_t)uaddr, fds, nr * sizeof (int32_t)) != 0)
+		error = EFAULT;
+
+	for (uint_t i = 0; error == 0 && i < nr; i++) {
+		file_t *fp;
+		vnode_t *vp;
+
+		/* -1 leaves a slot empty */
+		if (fds[i] == -1)
+			continue;
+
+		if ((fp = getf(fds[i])) == NULL) {
+			error = EBADF;
+			break;
+		}
+
+		/* a ring cannot hold another ring open */
+		vp = fp->f_vnode;
+		if (vp->v_type == VCHR && getmajor(vp->v_rdev) == uring_major) {
+			releasef(fds[i]);
+			error = EBADF;
+			break;
+		}
+
+		mutex_enter(&fp->f_tlock);
+		fp->f_count++;
+		mutex_exit(&fp->f_tlock);
+		files[i] = fp;
+		releasef(fds[i]);
+	}
+
+	kmem_free(fds, nr * sizeof (int32_t));
+
+	if (error != 0) {
+		uring_files_release(files, nr);
+		return (error);
+	}
+
+	ur->ur_files = files;
+	ur->ur_nfiles = nr;
+	return (0);
+}
+
+static int
+uring_eventfd_register(uring_t *ur, uint64_t uaddr, uint_t nr)
+{
+	int32_t fd;
+	file_t *fp;
+	vnode_t *vp;
+
+	if (nr != 1)
+		return (EINVAL);
+	if (copyin((void *)(uintptr_t)uaddr, &fd, sizeof (fd)) != 0)
+		return (EFAULT);
+	if ((fp = getf(fd)) == NULL)
+		return (EBADF);
+
+	vp = fp->f_vnode;
+	if (vp->v_type != VCHR ||
+	    getmajor(vp->v_rdev) != ddi_name_to_major("eventfd")) {
+		releasef(fd);
+		return (EINVAL);
+	}
+
+	mutex_enter(&ur->ur_lock);
+	if (ur->ur_eventfd != NULL) {
+		mutex_exit(&ur->ur_lock);
+		releasef(fd);
+		return (EBUSY);
+	}
+	mutex_enter(&fp->f_tlock);
+	fp->f_count++;
+	mutex_exit(&fp->f_tlock);
+	ur->ur_eventfd = fp;
+	mutex_exit(&ur->ur_lock);
+
+	releasef(fd);
+	return (0);
+}
+
+static int
+uring_eventfd_unregister(uring_t *ur)
+{
+	file_t *fp;
+
+	mutex_enter(&ur->ur_lock);
+	fp = ur->ur_eventfd;
+	ur->ur_eventfd = NULL;
+	mutex_exit(&ur->ur_lock);
+
+	if (fp == NULL)
+		return (ENXIO);
+
+	(void) closef(fp);
+	return (0);
+}
+
+static int
+uring_probe(uint64_t uaddr, uint_t nr)
+{
+	struct io_uring_probe *probe;
+	size_t len;
+	int error = 0;
+
+	nr = MIN(nr, IORING_OP_LAST);
+	len = sizeof (*probe) + nr * sizeof (struct io_uring_probe_op);
+	probe = kmem_zalloc(len, KM_SLEEP);
+
+	if (copyin((void *)(uintptr_t)uaddr, probe, len) != 0) {
+		error = EFAULT;
+		goto out;
+	}
+
+	/* as on Linux, the structure must arrive zeroed */
+	for (size_t i = 0; i < len; i++) {
+		if (((uint8_t *)probe)[i] != 0) {
+			error = EINVAL;
+			goto out;
+		}
+	}
+
+	probe->last_op = IORING_OP_LAST - 1;
+	probe->ops_len = nr;
+	for (uint_t i = 0; i < nr; i++) {
+		probe->ops[i].op = i;
+		if (uring_optab[i] & URO_VALID)
+			probe->ops[i].flags = IO_URING_OP_SUPPORTED;
+	}
+
+	if (copyout(probe, (void *)(uintptr_t)uaddr, len) != 0)
+		error = EFAULT;
+out:
+	kmem_free(probe, len);
+	return (error);
+}
+
+/*
+ * The number of CQEs that the application has yet to consume.
+ */
+static uint32_t
+uring_cq_ready(uring_t *ur)
+{
+	uint32_t ready = ur->ur_cq_tail - URING_LOAD(ur->ur_shared->us_cq_head);
+
+	return (MIN(ready, ur->ur_cq_entries));
+}
+
+/*
+ * Announce completions: wake threads waiting in io_uring_enter() and pollers
+ * of the ring, and signal the registered eventfd.
+ */
+static void
+uring_wake(uring_t *ur)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	boolean_t waiters;
+
+	mutex_enter(&ur->ur_lock);
+	waiters = (ur->ur_nwaiters != 0);
+	if (ur->ur_eventfd != NULL) {
+		uint64_t val = 1;
+
+		(void) VOP_IOCTL(ur->ur_eventfd->f_vnode, EVENTFDIOC_POST,
+		    (intptr_t)&val, FKIOCTL, ur->ur_eventfd->f_cred, NULL,
+		    NULL);
+	}
+	mutex_exit(&ur->ur_lock);
+
+	if (waiters) {
+		mutex_enter(&pcp->pc_lock);
+		cv_broadcast(&pcp->pc_cv);
+		mutex_exit(&pcp->pc_lock);
+	}
+
+	pollwakeup(&ur->ur_pollhd, POLLIN | POLLRDNORM);
+}
+
+/*
+ * Post the completion of a request and free it.  Completions posted by the
+ * submitter are announced once it is done; those from uring_taskq are
+ * announced immediately.
+ *
+ * A request from uring_taskq stays on ur_async until uring_done() has
+ * finished with the ring, since uring_teardown() frees the ring's resources
+ * as soon as ur_async drains.
+ */
+static void
+uring_done(uring_t *ur, uring_req_t *urq, int res)
+{
+	uring_shared_t *us = ur->ur_shared;
+	struct io_uring_cqe *cqe;
+	boolean_t async = urq->urq_async;
+
+	if (res < 0 && ur->ur_xlate != NULL)
+		res = -ur->ur_xlate->ux_errno(-res);
+
+	mutex_enter(&ur->ur_lock);
+
+	/* admission guarantees that there is room */
+	ASSERT(ur->ur_inflight > 0);
+	cqe = &us->us_cqes[ur->ur_cq_tail & (ur->ur_cq_entries - 1)];
+	cqe->user_data = urq->urq_sqe.user_data;
+	cqe->res = res;
+	cqe->flags = 0;
+	membar_producer();
+	URING_STORE(us->us_cq_tail, ++ur->ur_cq_tail);
+	ur->ur_inflight--;
+	mutex_exit(&ur->ur_lock);
+
+	if (urq->urq_held)
+		(void) closef(urq->urq_fp);
+	if (urq->urq_buf != NULL)
+		uring_buf_rele(urq->urq_buf);
+
+	if (async) {
+		uring_wake(ur);
+
+		/* this is the last use of ur; see above */
+		mutex_enter(&ur->ur_lock);
+		list_remove(&ur->ur_async, urq);
+		if (list_is_empty(&ur->ur_async))
+			cv_broadcast(&ur->ur_cv);
+		mutex_exit(&ur->ur_lock);
+	} else {
+		ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+		ur->ur_wake = B_TRUE;
+	}
+
+	kmem_cache_free(uring_req_cache, urq);
+}
+
+static void
+uring_hold(uring_req_t *urq)
+{
+	file_t *fp = urq->urq_fp;
+
+	if (urq->urq_held)
+		return;
+
+	mutex_enter(&fp->f_tlock);
+	fp->f_count++;
+	mutex_exit(&fp->f_tlock);
+	urq->urq_held = B_TRUE;
+}
+
+/*
+ * Reads and writes.  An offset of -1 means the file's current offset, which
+ * is then updated; otherwise the offset is used as with pread() and pwrite(),
+ * or ignored for streams (pipes and sockets), as Linux does.
+ */
+static int
+uring_rw(uring_t *ur, uring_req_t *urq, uio_rw_t rw, short *eventsp)
+{
+	struct io_uring_sqe *sqe = &urq->urq_sqe;
+	uring_buf_t *ub = urq->urq_buf;
+	file_t *fp = urq->urq_fp;
+	vnode_t *vp = fp->f_vnode;
+	iovec_t stackiov[URING_IOV_STACK], *iov = stackiov;
+	uint_t iovcnt = 1;
+	boolean_t curoff = (sqe->off == UINT64_MAX);
+	boolean_t parkable = B_FALSE;
+	int fflag = fp->f_flag;
+	int rwflag = (rw == UIO_WRITE) ? 1 : 0;
+	int ioflag, svmand, error = 0, in_crit = 0;
+	ssize_t count;
+	struct uio uio;
+
+	if ((fflag & (rw == UIO_WRITE ? FWRITE : FREAD)) == 0)
+		return (-EBADF);
+
+	bzero(&uio, sizeof (uio));
+	switch (sqe->opcode) {
+	case IORING_OP_READV:
+	case IORING_OP_WRITEV:
+		if ((iovcnt = sqe->len) == 0 || iovcnt > IOV_MAX)
+			return (-EINVAL);
+		if (iovcnt > URING_IOV_STACK)
+			iov = kmem_alloc(iovcnt * sizeof (iovec_t), KM_SLEEP);
+		if ((error = uring_iov_copyin(sqe->addr, iovcnt, iov,
+		    &count)) != 0)
+			goto out;
+		uio.uio_segflg = UIO_USERSPACE;
+		break;
+
+	case IORING_OP_READ_FIXED:
+	case IORING_OP_WRITE_FIXED:
+		/* the range was checked against the buffer on submission */
+		iov->iov_base = ub->ub_kaddr + (sqe->addr - ub->ub_uaddr);
+		iov->iov_len = count = MIN(sqe->len, URING_RW_MAX);
+		uio.uio_segflg = UIO_SYSSPACE;
+		break;
+
+	default:
+		iov->iov_base = (caddr_t)(uintptr_t)sqe->addr;
+		iov->iov_len = count = MIN(sqe->len, URING_RW_MAX);
+		uio.uio_segflg = UIO_USERSPACE;
+		break;
+	}
+
+	uio.uio_iov = iov;
+	uio.uio_iovcnt = iovcnt;
+	uio.uio_fmode = fflag;
+	uio.uio_extflg = UIO_COPY_DEFAULT;
+	uio.uio_llimit = (rw == UIO_WRITE) ? urq->urq_fsz_ctl : MAXOFFSET_T;
+
+	if (vp->v_type != VREG) {
+		parkable = ((fflag & (FNONBLOCK | FNDELAY)) == 0);
+		uio.uio_fmode |= FNONBLOCK;
+	}
+
+	if (!curoff && vp->v_type != VFIFO && vp->v_type != VSOCK) {
+		if ((offset_t)sqe->off < 0) {
+			error = EINVAL;
+			goto out;
+		}
+		uio.uio_loffset = sqe->off;
+	}
+
+	if (nbl_need_check(vp)) {
+		nbl_start_crit(vp, RW_READER);
+		in_crit = 1;
+		if ((error = nbl_svmand(vp, fp->f_cred, &svmand)) != 0)
+			goto out;
+	}
+
+	(void) VOP_RWLOCK(vp, rwflag, NULL);
+	if (curoff)
+		uio.uio_loffset = fp->f_offset;
+
+	if (in_crit && nbl_conflict(vp, rw == UIO_WRITE ? NBL_WRITE : NBL_READ,
+	    uio.uio_loffset, count, svmand, NULL)) {
+		VOP_RWUNLOCK(vp, rwflag, NULL);
+		error = EACCES;
+		goto out;
+	}
+
+	if (vp->v_type == VREG && uio.uio_loffset + count > OFFSET_MAX(fp)) {
+		if (uio.uio_loffset >= OFFSET_MAX(fp)) {
+			VOP_RWUNLOCK(vp, rwflag, NULL);
+			error = (rw == UIO_WRITE) ? EFBIG : 0;
+			count = 0;
+			goto out;
+		}
+		count = OFFSET_MAX(fp) - uio.uio_loffset;
+		if (iovcnt == 1)
+			iov->iov_len = count;
+	}
+	uio.uio_resid = count;
+
+	ioflag = fflag & (FAPPEND | FSYNC | FDSYNC | FRSYNC);
+	if (rw == UIO_WRITE) {
+		error = VOP_WRITE(vp, &uio, ioflag, fp->f_cred, NULL);
+	} else {
+		if ((ioflag & FRSYNC) == 0)
+			ioflag &= ~(FSYNC | FDSYNC);
+		error = VOP_READ(vp, &uio, ioflag, fp->f_cred, NULL);
+	}
+	count -= uio.uio_resid;
+
+	if (curoff && vp->v_type != VFIFO)
+		fp->f_offset = uio.uio_loffset;
+	VOP_RWUNLOCK(vp, rwflag, NULL);
+
+	if (count != 0) {
+		error = 0;
+	} else if (error == EAGAIN && parkable) {
+		*eventsp = (rw == UIO_WRITE) ? POLLOUT : (POLLIN | POLLRDNORM);
+	}
+
+out:
+	if (in_crit)
+		nbl_end_crit(vp);
+	if (iov != stackiov)
+		kmem_free(iov, iovcnt * sizeof (iovec_t));
+	return (error != 0 ? -error : (int)count);
+}
+
+/*
+ * Socket sends and receives.
+ */
+static int
+uring_msg(uring_t *ur, uring_req_t *urq, short *eventsp)
+{
+	struct io_uring_sqe *sqe = &urq->urq_sqe;
+	file_t *fp = urq->urq_fp;
+	vnode_t *vp = fp->f_vnode;
+	boolean_t send = (sqe->opcode == IORING_OP_SEND);
+	struct nmsghdr msg;
+	struct iovec iov;
+	struct uio uio;
+	ssize_t count;
+	int flags = (int)sqe->op_flags;
+	int error;
+
+	if (vp->v_type != VSOCK)
+		return (-ENOTSOCK);
+	if (ur->ur_xlate != NULL &&
+	    (error = ur->ur_xlate->ux_msgflags(sqe->op_flags, &flags)) != 0)
+		return (-error);
+
+	flags &= send ? (MSG_OOB | MSG_DONTROUTE | MSG_EOR | MSG_DONTWAIT |
+	    MSG_NOSIGNAL) : (MSG_OOB | MSG_PEEK | MSG_WAITALL | MSG_DONTWAIT);
+
+	bzero(&msg, sizeof (msg));
+	msg.msg_flags = flags | MSG_DONTWAIT;
+
+	iov.iov_base = (caddr_t)(uintptr_t)sqe->addr;
+	iov.iov_len = count = MIN(sqe->len, URING_RW_MAX);
+
+	bzero(&uio, sizeof (uio));
+	uio.uio_iov = &iov;
+	uio.uio_iovcnt = 1;
+	uio.uio_resid = count;
+	uio.uio_segflg = UIO_USERSPACE;
+	uio.uio_fmode = fp->f_flag;
+	uio.uio_extflg = UIO_COPY_DEFAULT;
+	uio.uio_llimit = MAXOFFSET_T;
+
+	if (send) {
+		error = socket_sendmsg(VTOSO(vp), &msg, &uio, CRED());
+	} else {
+		error = socket_recvmsg(VTOSO(vp), &msg, &uio, CRED());
+	}
+
+	if (error == EWOULDBLOCK && (flags & MSG_DONTWAIT) == 0 &&
+	    (fp->f_flag & (FNONBLOCK | FNDELAY)) == 0)
+		*eventsp = send ? POLLOUT : (POLLIN | POLLRDNORM);
+
+	return (error != 0 ? -error : (int)(count - uio.uio_resid));
+}
+
+/*
+ * Accept a connection into a new fd.  As on Linux (and unlike accept(3SOCKET))
+ * the new socket does not inherit the listener's non-blocking mode, which
+ * only SOCK_NONBLOCK sets.  The peer's address is copied out to addr, with
+ * its length at the socklen_t that off points to.
+ */
+static int
+uring_accept(uring_t *ur, uring_req_t *urq, short *eventsp)
+{
+	struct io_uring_sqe *sqe = &urq->urq_sqe;
+	file_t *fp = urq->urq_fp, *nfp;
+	vnode_t *vp = fp->f_vnode, *nvp;
+	struct sonode *so, *nso;
+	void *name = (void *)(uintptr_t)sqe->addr;
+	void *namelenp = (void *)(uintptr_t)sqe->off;
+	socklen_t namelen = 0;
+	int flags = (int)sqe->op_flags;
+	int error, nfd;
+
+	if (vp->v_type != VSOCK)
+		return (-ENOTSOCK);
+	if (ur->ur_xlate != NULL &&
+	    (error = ur->ur_xlate->ux_sockflags(sqe->op_flags, &flags)) != 0)
+		return (-error);
+	if ((flags & ~(SOCK_CLOEXEC | SOCK_NONBLOCK)) != 0)
+		return (-EINVAL);
+
+	so = VTOSO(vp);
+	if (name != NULL &&
+	    copyin(namelenp, &namelen, sizeof (namelen)) != 0)
+		return (-EFAULT);
+
+	if ((nfd = ufalloc(0)) == -1)
+		return (-EMFILE);
+
+	if ((error = socket_accept(so, fp->f_flag | FNONBLOCK, CRED(),
+	    &nso)) != 0) {
+		setf(nfd, NULL);
+		if (error == EWOULDBLOCK &&
+		    (fp->f_flag & (FNONBLOCK | FNDELAY)) == 0)
+			*eventsp = POLLIN | POLLRDNORM;
+		return (-error);
+	}
+	nvp = SOTOV(nso);
+
+	if (name != NULL) {
+		socklen_t addrlen = so->so_max_addr_len;
+		struct sockaddr *addrp = kmem_alloc(addrlen, KM_SLEEP);
+
+		if ((error = socket_getpeername(nso, addrp, &addrlen, B_TRUE,
+		    CRED())) != 0) {
+			error = ECONNABORTED;
+		} else if ((namelen != 0 && copyout(addrp, name,
+		    MIN(namelen, addrlen)) != 0) ||
+		    copyout(&addrlen, namelenp, sizeof (addrlen)) != 0) {
+			error = EFAULT;
+		}
+		kmem_free(addrp, so->so_max_addr_len);
+	}
+
+	if (error == 0 &&
+	    (error = falloc(NULL, FREAD | FWRITE, &nfp, NULL)) == 0) {
+		nfp->f_vnode = nvp;
+		mutex_exit(&nfp->f_tlock);
+		setf(nfd, nfp);
+	} else {
+		setf(nfd, NULL);
+		(void) socket_close(nso, 0, CRED());
+		socket_destroy(nso);
+		return (-error);
+	}
+
+	if (flags & SOCK_CLOEXEC)
+		f_setfd(nfd, FD_CLOEXEC);
+
+	if ((flags & SOCK_NONBLOCK) &&
+	    VOP_SETFL(nvp, nfp->f_flag, FNONBLOCK, nfp->f_cred, NULL) == 0) {
+		mutex_enter(&nfp->f_tlock);
+		nfp->f_flag |= FNONBLOCK;
+		mutex_exit(&nfp->f_tlock);
+	}
+
+	return (nfd);
+}
+
+/*
+ * Poll a file on behalf of the ring, in the manner of a nested epoll fd.  A
+ * pollhead is only wanted (and returned in *phpp) when parking.
+ */
+static int
+uring_vop_poll(uring_t *ur, vnode_t *vp, short events, short *reventsp,
+    pollhead_t **phpp)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	pollhead_t *php = NULL;
+	int error;
+
+	switch (pollstate_enter(pcp)) {
+	case PSE_SUCCESS:
+		break;
+	case PSE_FAIL_DEPTH:
+		return (EINVAL);
+	case PSE_FAIL_LOOP:
+	case PSE_FAIL_DEADLOCK:
+		return (ELOOP);
+	default:
+		return (EIO);
+	}
+
+	curthread->t_pollcache = pcp;
+	error = VOP_POLL(vp, events, phpp == NULL, reventsp, &php, NULL);
+
+	/*
+	 * As with EPOLLET in /dev/poll, drivers which only emit a pollhead
+	 * when nothing is ready are given a second chance to do so.
+	 */
+	if (error == 0 && phpp != NULL && php == NULL) {
+		short levent = 0;
+
+		error = VOP_POLL(vp, POLLET, 0, &levent, &php, NULL);
+	}
+	curthread->t_pollcache = NULL;
+
+	if (phpp != NULL)
+		*phpp = php;
+
+	pollstate_exit(pcp);
+	return (error);
+}
+
+static int
+uring_poll_add(uring_t *ur, uring_req_t *urq, short *eventsp)
+{
+	struct io_uring_sqe *sqe = &urq->urq_sqe;
+	short events = (short)sqe->op_flags;
+	short revents = 0;
+	int error;
+
+	if (ur->ur_xlate != NULL &&
+	    (error = ur->ur_xlate->ux_pollevents(sqe->op_flags, &events)) != 0)
+		return (-error);
+
+	if ((error = uring_vop_poll(ur, urq->urq_fp->f_vnode, events, &revents,
+	    NULL)) != 0)
+		return (-error);
+
+	if (revents == 0) {
+		*eventsp = events;
+		return (-EAGAIN);
+	}
+
+	if (ur->ur_xlate != NULL)
+		return ((int)ur->ur_xlate->ux_revents(revents, sqe->op_flags));
+
+	return ((int)(ushort_t)revents);
+}
+
+/*
+ * Perform (or attempt) an operation, returning the result for its CQE.  An
+ * operation that would block and should be parked sets *eventsp to the
+ * events that it waits for.
+ */
+static int
+uring_exec(uring_t *ur, uring_req_t *urq, short *eventsp)
+{
+	struct io_uring_sqe *sqe = &urq->urq_sqe;
+	int res, error;
+
+	*eventsp = 0;
+
+	switch (sqe->opcode) {
+	case IORING_OP_READ:
+	case IORING_OP_READV:
+		return (uring_rw(ur, urq, UIO_READ, eventsp));
+
+	case IORING_OP_WRITE:
+	case IORING_OP_WRITEV:
+		return (uring_rw(ur, urq, UIO_WRITE, eventsp));
+
+	case IORING_OP_READ_FIXED:
+	case IORING_OP_WRITE_FIXED:
+		/* asynchronous requests entered the buffer when dispatched */
+		if (!urq->urq_async && !uring_buf_enter(urq->urq_buf))
+			return (-EFAULT);
+		res = uring_rw(ur, urq, sqe->opcode == IORING_OP_READ_FIXED ?
+		    UIO_READ : UIO_WRITE, eventsp);
+		if (!urq->urq_async)
+			uring_buf_exit(urq->urq_buf);
+		return (res);
+
+	case IORING_OP_FSYNC:
+		error = VOP_FSYNC(urq->urq_fp->f_vnode,
+		    (sqe->op_flags & IORING_FSYNC_DATASYNC) ? FDSYNC : FSYNC,
+		    urq->urq_fp->f_cred, NULL);
+		return (-error);
+
+	case IORING_OP_SEND:
+	case IORING_OP_RECV:
+		return (uring_msg(ur, urq, eventsp));
+
+	case IORING_OP_ACCEPT:
+		return (uring_accept(ur, urq, eventsp));
+
+	case IORING_OP_POLL_ADD:
+		return (uring_poll_add(ur, urq, eventsp));
+
+	default:
+		return (-EINVAL);
+	}
+}
+
+static void
+uring_async(void *arg)
+{
+	uring_req_t *urq = arg;
+	uring_t *ur = urq->urq_ring;
+	short events;
+	int res;
+
+	res = uring_exec(ur, urq, &events);
+	if (urq->urq_buf != NULL)
+		uring_buf_exit(urq->urq_buf);
+	uring_done(ur, urq, res);
+}
+
+/*
+ * Park a request until its file is ready.  Returns B_FALSE if it cannot be:
+ * the file offers no pollhead to wait on.
+ */
+static boolean_t
+uring_park(uring_t *ur, uring_req_t *urq, short events)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	polldat_t *pdp = &urq->urq_pd;
+	pollhead_t *php = NULL;
+	short revents = 0;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	if (uring_vop_poll(ur, urq->urq_fp->f_vnode, events, &revents,
+	    &php) != 0 || php == NULL)
+		return (B_FALSE);
+
+	uring_hold(urq);
+	pdp->pd_fd = id_alloc(ur->ur_slots);
+	pdp->pd_events = events;
+	pdp->pd_pcache = pcp;
+	pdp->pd_php = php;
+	pollhead_insert(php, pdp);
+
+	/* if the file became ready meanwhile, retry at the next opportunity */
+	mutex_enter(&pcp->pc_lock);
+	if (revents != 0)
+		pollnotify(pcp, pdp);
+	mutex_exit(&pcp->pc_lock);
+
+	list_insert_tail(&ur->ur_parked, urq);
+	return (B_TRUE);
+}
+
+static void
+uring_unpark(uring_t *ur, uring_req_t *urq)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	polldat_t *pdp = &urq->urq_pd;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	pollhead_delete(pdp->pd_php, pdp);
+	pdp->pd_php = NULL;
+
+	mutex_enter(&pcp->pc_lock);
+	if (list_link_active(&pdp->pd_readylink)) {
+		list_remove(&pcp->pc_ready, pdp);
+		pcp->pc_nready--;
+	}
+	BT_CLEAR(pcp->pc_bitmap, pdp->pd_fd);
+	mutex_exit(&pcp->pc_lock);
+
+	id_free(ur->ur_slots, pdp->pd_fd);
+	list_remove(&ur->ur_parked, urq);
+}
+
+/*
+ * Perform a request in the submitter, parking it if it would block.
+ */
+static void
+uring_run(uring_t *ur, uring_req_t *urq)
+{
+	short events;
+	int res;
+
+	res = uring_exec(ur, urq, &events);
+	if (events != 0 && uring_park(ur, urq, events))
+		return;
+
+	uring_done(ur, urq, res);
+}
+
+/*
+ * Retry parked requests whose files have become ready.  Only those ready on
+ * entry are retried: any that are readied again meanwhile wait for the next
+ * call.
+ */
+static void
+uring_resume(uring_t *ur)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	uring_req_t *urq;
+	polldat_t *pdp;
+	short events;
+	uint_t n;
+	int res;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	mutex_enter(&pcp->pc_lock);
+	n = pcp->pc_nready;
+	pcp->pc_flag &= ~PC_POLLWAKE;
+	mutex_exit(&pcp->pc_lock);
+
+	while (n-- != 0) {
+		mutex_enter(&pcp->pc_lock);
+		if ((pdp = list_remove_head(&pcp->pc_ready)) != NULL) {
+			pcp->pc_nready--;
+			BT_CLEAR(pcp->pc_bitmap, pdp->pd_fd);
+		}
+		mutex_exit(&pcp->pc_lock);
+
+		if (pdp == NULL)
+			break;
+
+		/* still parked if it would block */
+		urq = URQ_FROM_PD(pdp);
+		res = uring_exec(ur, urq, &events);
+		if (events != 0)
+			continue;
+
+		uring_unpark(ur, urq);
+		uring_done(ur, urq, res);
+	}
+}
+
+/*
+ * Cancel a parked request (for ASYNC_CANCEL) or parked poll (for POLL_REMOVE)
+ * by its user_data.  Requests already being performed on uring_taskq cannot
+ * be cancelled.
+ */
+static int
+uring_cancel(uring_t *ur, uint64_t user_data, boolean_t pollonly)
+{
+	uring_req_t *urq;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	for (urq = list_head(&ur->ur_parked); urq != NULL;
+	    urq = list_next(&ur->ur_parked, urq)) {
+		if (urq->urq_sqe.user_data == user_data && (!pollonly ||
+		    urq->urq_sqe.opcode == IORING_OP_POLL_ADD)) {
+			uring_unpark(ur, urq);
+			uring_done(ur, urq, -ECANCELED);
+			return (0);
+		}
+	}
+
+	if (!pollonly) {
+		mutex_enter(&ur->ur_lock);
+		for (urq = list_head(&ur->ur_async); urq != NULL;
+		    urq = list_next(&ur->ur_async, urq)) {
+			if (urq->urq_sqe.user_data == user_data) {
+				mutex_exit(&ur->ur_lock);
+				return (-EALREADY);
+			}
+		}
+		mutex_exit(&ur->ur_lock);
+	}
+
+	return (-ENOENT);
+}
+
+/*
+ * Issue a newly-submitted request.
+ */
+static void
+uring_issue(uring_t *ur, uring_req_t *urq)
+{
+	struct io_uring_sqe *sqe = &urq->urq_sqe;
+	uint8_t op = sqe->opcode;
+	int fd = -1;
+	vnode_t *vp;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	if (op >= IORING_OP_LAST || (uring_optab[op] & URO_VALID) == 0 ||
+	    (sqe->flags & ~(IOSQE_FIXED_FILE | IOSQE_ASYNC)) != 0 ||
+	    sqe->personality != 0 || sqe->splice_fd_in != 0) {
+		uring_done(ur, urq, -EINVAL);
+		return;
+	}
+
+	switch (op) {
+	case IORING_OP_NOP:
+		uring_done(ur, urq, 0);
+		return;
+	case IORING_OP_POLL_REMOVE:
+	case IORING_OP_ASYNC_CANCEL:
+		uring_done(ur, urq, uring_cancel(ur, sqe->addr,
+		    op == IORING_OP_POLL_REMOVE));
+		return;
+	default:
+		break;
+	}
+
+	if (sqe->flags & IOSQE_FIXED_FILE) {
+		if (sqe->fd < 0 || sqe->fd >= ur->ur_nfiles ||
+		    (urq->urq_fp = ur->ur_files[sqe->fd]) == NULL) {
+			uring_done(ur, urq, -EBADF);
+			return;
+		}
+	} else if ((urq->urq_fp = getf(fd = sqe->fd)) == NULL) {
+		uring_done(ur, urq, -EBADF);
+		return;
+	}
+	vp = urq->urq_fp->f_vnode;
+
+	/*
+	 * A ring cannot hold another ring open, as parked and asynchronous
+	 * requests would, any more than through its registered files.
+	 */
+	if (vp->v_type == VCHR && getmajor(vp->v_rdev) == uring_major) {
+		uring_done(ur, urq, -EBADF);
+		goto out;
+	}
+
+	if (uring_optab[op] & URO_FIXED) {
+		uring_buf_t *ub;
+
+		if (sqe->buf_index >= ur->ur_nbufs ||
+		    (ub = ur->ur_bufs[sqe->buf_index]) == NULL ||
+		    sqe->addr < ub->ub_uaddr || sqe->len > ub->ub_len ||
+		    sqe->addr - ub->ub_uaddr > ub->ub_len - sqe->len) {
+			uring_done(ur, urq, -EFAULT);
+			goto out;
+		}
+		atomic_inc_uint(&ub->ub_refs);
+		urq->urq_buf = ub;
+	}
+
+	if (op == IORING_OP_FSYNC || ((uring_optab[op] & URO_FIXED) &&
+	    (vp->v_type == VREG || vp->v_type == VBLK))) {
+		if (urq->urq_buf != NULL && !uring_buf_enter(urq->urq_buf)) {
+			uring_done(ur, urq, -EFAULT);
+			goto out;
+		}
+		uring_hold(urq);
+		urq->urq_async = B_TRUE;
+		mutex_enter(&ur->ur_lock);
+		list_insert_tail(&ur->ur_async, urq);
+		mutex_exit(&ur->ur_lock);
+		(void) taskq_dispatch(uring_taskq, uring_async, urq, TQ_SLEEP);
+	} else {
+		uring_run(ur, urq);
+	}
+
+out:
+	if (fd != -1)
+		releasef(fd);
+}
+
+/*
+ * Consume up to n entries from the SQ, as far as the CQ has room for their
+ * completions.
+ */
+static int
+uring_submit(uring_t *ur, uint32_t n, uint32_t *submittedp)
+{
+	uring_shared_t *us = ur->ur_shared;
+	uint32_t mask = ur->ur_sq_entries - 1;
+	uint32_t avail, room, busy, i, dropped = 0;
+
+	ASSERT(MUTEX_HELD(&ur->ur_submit_lock));
+
+	avail = URING_LOAD(us->us_sq_tail) - ur->ur_sq_head;
+	membar_consumer();
+	n = MIN(n, MIN(avail, ur->ur_sq_entries));
+	if (n == 0) {
+		*submittedp = 0;
+		return (0);
+	}
+
+	mutex_enter(&ur->ur_lock);
+	busy = uring_cq_ready(ur) + ur->ur_inflight;
+	room = (busy < ur->ur_cq_entries) ? ur->ur_cq_entries - busy : 0;
+	if ((n = MIN(n, room)) == 0) {
+		mutex_exit(&ur->ur_lock);
+		return (EBUSY);
+	}
+	ur->ur_inflight += n;
+	mutex_exit(&ur->ur_lock);
+
+	for (i = 0; i < n; i++) {
+		uint32_t idx;
+		uring_req_t *urq;
+
+		idx = URING_LOAD(ur->ur_sq_array[ur->ur_sq_head & mask]);
+
+		ur->ur_sq_head++;
+		if (idx >= ur->ur_sq_entries) {
+			URING_STORE(us->us_sq_dropped,
+			    URING_LOAD(us->us_sq_dropped) + 1);
+			dropped++;
+			continue;
+		}
+
+		urq = kmem_cache_alloc(uring_req_cache, KM_SLEEP);
+		bzero(urq, sizeof (*urq));
+		urq->urq_ring = ur;
+		urq->urq_fsz_ctl = curproc->p_fsz_ctl;
+		bcopy(&ur->ur_sqes[idx], &urq->urq_sqe, sizeof (urq->urq_sqe));
+		uring_issue(ur, urq);
+	}
+
+	/* the SQEs have been copied before the application may reuse them */
+	membar_exit();
+	URING_STORE(us->us_sq_head, ur->ur_sq_head);
+
+	if (dropped != 0) {
+		mutex_enter(&ur->ur_lock);
+		ur->ur_inflight -= dropped;
+		mutex_exit(&ur->ur_lock);
+	}
+
+	*submittedp = n;
+	return (0);
+}
+
+static void
+uring_sigmask_restore(k_sigset_t *ksetp)
+{
+	kthread_t *t = curthread;
+	klwp_t *lwp = ttolwp(t);
+	proc_t *p = ttoproc(t);
+
+	if (ksetp == NULL)
+		return;
+
+	mutex_enter(&p->p_lock);
+	if (lwp->lwp_cursig == 0) {
+		t->t_hold = lwp->lwp_sigoldmask;
+		t->t_flag &= ~T_TOMASK;
+	}
+	mutex_exit(&p->p_lock);
+}
+
+/*
+ * Wait for at least min CQEs to be available, retrying parked requests as
+ * their files become ready.  With a signal mask, this is to
+ * io_uring_enter() what ppoll() is to poll(): see DP_PPOLL.
+ */
+static int
+uring_wait(uring_t *ur, uint32_t min, uint64_t sigmask, int md)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	kthread_t *t = curthread;
+	klwp_t *lwp = ttolwp(t);
+	proc_t *p = ttoproc(t);
+	k_sigset_t kset, *ksetp = NULL;
+	boolean_t wake;
+	int error = 0;
+
+	if (sigmask != 0) {
+		if (md & FKIOCTL) {
+			/* the brand has already converted the set */
+			ksetp = (k_sigset_t *)(uintptr_t)sigmask;
+		} else {
+			sigset_t set;
+
+			if (copyin((void *)(uintptr_t)sigmask, &set,
+			    sizeof (set)) != 0)
+				return (EFAULT);
+			sigutok(&set, &kset);
+			ksetp = &kset;
+		}
+
+		mutex_enter(&p->p_lock);
+		schedctl_finish_sigblock(t);
+		lwp->lwp_sigoldmask = t->t_hold;
+		t->t_hold = *ksetp;
+		t->t_flag |= T_TOMASK;
+		mutex_exit(&p->p_lock);
+	}
+
+	min = MIN(min, ur->ur_cq_entries);
+	for (;;) {
+		int rv = 1;
+
+		mutex_enter(&ur->ur_submit_lock);
+		uring_resume(ur);
+		wake = ur->ur_wake;
+		ur->ur_wake = B_FALSE;
+		mutex_exit(&ur->ur_submit_lock);
+
+		if (wake)
+			uring_wake(ur);
+
+		if (uring_cq_ready(ur) >= min)
+			break;
+
+		mutex_enter(&ur->ur_lock);
+		ur->ur_nwaiters++;
+		mutex_exit(&ur->ur_lock);
+
+		mutex_enter(&pcp->pc_lock);
+		if (pcp->pc_nready == 0 && uring_cq_ready(ur) < min)
+			rv = cv_wait_sig_swap(&pcp->pc_cv, &pcp->pc_lock);
+		mutex_exit(&pcp->pc_lock);
+
+		mutex_enter(&ur->ur_lock);
+		ur->ur_nwaiters--;
+		mutex_exit(&ur->ur_lock);
+
+		if (rv == 0) {
+			error = EINTR;
+			break;
+		}
+	}
+
+	uring_sigmask_restore(ksetp);
+	return (error);
+}
+
+static int
+uring_enter(uring_t *ur, intptr_t arg, int md, int *rvalp)
+{
+	uring_enter_t ue;
+	uint32_t submitted = 0;
+	boolean_t wake;
+	int error = 0;
+
+	if (ddi_copyin((void *)arg, &ue, sizeof (ue), md) != 0)
+		return (EFAULT);
+	if ((ue.ue_flags & ~IORING_ENTER_GETEVENTS) != 0)
+		return (EINVAL);
+	if (!ur->ur_setup)
+		return (EINVAL);
+	if (curproc->p_as != ur->ur_as)
+		return (EPERM);
+
+	(void) pollstate_create();
+
+	if (ue.ue_to_submit != 0) {
+		mutex_enter(&ur->ur_submit_lock);
+		uring_resume(ur);
+		error = uring_submit(ur, ue.ue_to_submit, &submitted);
+		wake = ur->ur_wake;
+		ur->ur_wake = B_FALSE;
+		mutex_exit(&ur->ur_submit_lock);
+
+		if (wake)
+			uring_wake(ur);
+	}
+
+	if (error == 0 && (ue.ue_flags & IORING_ENTER_GETEVENTS))
+		error = uring_wait(ur, ue.ue_min_complete, ue.ue_sigmask, md);
+
+	/* having submitted anything, the count is the result */
+	*rvalp = submitted;
+	return (submitted != 0 ? 0 : error);
+}
+
+static int
+uring_register(uring_t *ur, intptr_t arg, int md)
+{
+	uring_register_t urr;
+	uring_buf_t **bufs;
+	file_t **files;
+	uint_t n;
+	int error = 0;
+
+	if (ddi_copyin((void *)arg, &urr, sizeof (urr), md) != 0)
+		return (EFAULT);
+	if (!ur->ur_setup)
+		return (EINVAL);
+	if (curproc->p_as != ur->ur_as)
+		return (EPERM);
+
+	mutex_enter(&ur->ur_submit_lock);
+
+	switch (urr.ur_opcode) {
+	case IORING_REGISTER_BUFFERS:
+		error = uring_bufs_register(ur, urr.ur_arg, urr.ur_nr_args);
+		break;
+
+	case IORING_UNREGISTER_BUFFERS:
+		if ((n = ur->ur_nbufs) == 0) {
+			error = ENXIO;
+			break;
+		}
+		bufs = ur->ur_bufs;
+		ur->ur_bufs = NULL;
+		ur->ur_nbufs = 0;
+		uring_bufs_release(bufs, n, B_FALSE);
+		break;
+
+	case IORING_REGISTER_FILES:
+		error = uring_files_register(ur, urr.ur_arg, urr.ur_nr_args);
+		break;
+
+	case IORING_UNREGISTER_FILES:
+		if ((n = ur->ur_nfiles) == 0) {
+			error = ENXIO;
+			break;
+		}
+		files = ur->ur_files;
+		ur->ur_files = NULL;
+		ur->ur_nfiles = 0;
+		uring_files_release(files, n);
+		break;
+
+	case IORING_REGISTER_EVENTFD:
+		error = uring_eventfd_register(ur, urr.ur_arg, urr.ur_nr_args);
+		break;
+
+	case IORING_UNREGISTER_EVENTFD:
+		error = uring_eventfd_unregister(ur);
+		break;
+
+	case IORING_REGISTER_PROBE:
+		error = uring_probe(urr.ur_arg, urr.ur_nr_args);
+		break;
+
+	default:
+		error = EINVAL;
+		break;
+	}
+
+	mutex_exit(&ur->ur_submit_lock);
+	return (error);
+}
+
+static int
+uring_setup(uring_t *ur, intptr_t arg, int md)
+{
+	struct io_uring_params params;
+	uint32_t sq, cq, flags;
+	uring_shared_t *us;
+	size_t cqes;
+
+	if (ddi_copyin((void *)arg, &params, sizeof (params), md) != 0)
+		return (EFAULT);
+
+	flags = params.flags;
+	if ((flags & ~(IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP)) != 0 ||
+	    params.resv[0] != 0 || params.resv[1] != 0 || params.resv[2] != 0)
+		return (EINVAL);
+
+	if ((sq = params.sq_entries) == 0)
+		return (EINVAL);
+	if (sq > uring_max_entries) {
+		if ((flags & IORING_SETUP_CLAMP) == 0)
+			return (EINVAL);
+		sq = uring_max_entries;
+	}
+	sq = 1U << highbit(sq - 1);
+
+	if (flags & IORING_SETUP_CQSIZE) {
+		if ((cq = params.cq_entries) == 0)
+			return (EINVAL);
+		if (cq > 2 * uring_max_entries) {
+			if ((flags & IORING_SETUP_CLAMP) == 0)
+				return (EINVAL);
+			cq = 2 * uring_max_entries;
+		}
+		cq = 1U << highbit(cq - 1);
+		if (cq < sq)
+			return (EINVAL);
+	} else {
+		cq = 2 * sq;
+	}
+
+	mutex_enter(&ur->ur_submit_lock);
+	if (ur->ur_setup) {
+		mutex_exit(&ur->ur_submit_lock);
+		return (EBUSY);
+	}
+
+	cqes = offsetof(uring_shared_t, us_cqes);
+	ur->ur_ring_size = ptob(btopr(cqes + cq * sizeof (struct io_uring_cqe) +
+	    sq * sizeof (uint32_t)));
+	us = ddi_umem_alloc(ur->ur_ring_size, DDI_UMEM_SLEEP,
+	    &ur->ur_ring_cookie);
+	bzero(us, ur->ur_ring_size);
+	ur->ur_sqe_size = ptob(btopr(sq * sizeof (struct io_uring_sqe)));
+	ur->ur_sqes = ddi_umem_alloc(ur->ur_sqe_size, DDI_UMEM_SLEEP,
+	    &ur->ur_sqe_cookie);
+	bzero(ur->ur_sqes, ur->ur_sqe_size);
+
+	ur->ur_shared = us;
+	ur->ur_sq_array = (uint32_t *)&us->us_cqes[cq];
+	ur->ur_sq_entries = us->us_sq_entries = sq;
+	ur->ur_cq_entries = us->us_cq_entries = cq;
+	us->us_sq_mask = sq - 1;
+	us->us_cq_mask = cq - 1;
+
+	ur->ur_pcache = pcache_alloc();
+	pcache_create(ur->ur_pcache, cq);
+	ur->ur_pcache->pc_flag |= PC_READYQ;
+	ur->ur_slots = id_space_create("uring_slots", 0, cq);
+	ur->ur_as = curproc->p_as;
+
+	bzero(&params.sq_off, sizeof (params.sq_off));
+	params.sq_off.head = offsetof(uring_shared_t, us_sq_head);
+	params.sq_off.tail = offsetof(uring_shared_t, us_sq_tail);
+	params.sq_off.ring_mask = offsetof(uring_shared_t, us_sq_mask);
+	params.sq_off.ring_entries = offsetof(uring_shared_t, us_sq_entries);
+	params.sq_off.flags = offsetof(uring_shared_t, us_sq_flags);
+	params.sq_off.dropped = offsetof(uring_shared_t, us_sq_dropped);
+	params.sq_off.array = (uintptr_t)ur->ur_sq_array - (uintptr_t)us;
+
+	bzero(&params.cq_off, sizeof (params.cq_off));
+	params.cq_off.head = offsetof(uring_shared_t, us_cq_head);
+	params.cq_off.tail = offsetof(uring_shared_t, us_cq_tail);
+	params.cq_off.ring_mask = offsetof(uring_shared_t, us_cq_mask);
+	params.cq_off.ring_entries = offsetof(uring_shared_t, us_cq_entries);
+	params.cq_off.overflow = offsetof(uring_shared_t, us_cq_overflow);
+	params.cq_off.cqes = cqes;
+	params.cq_off.flags = offsetof(uring_shared_t, us_cq_flags);
+
+	params.sq_entries = sq;
+	params.cq_entries = cq;
+	params.features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_SUBMIT_STABLE |
+	    IORING_FEAT_RW_CUR_POS;
+
+	membar_producer();
+	ur->ur_setup = B_TRUE;
+	mutex_exit(&ur->ur_submit_lock);
+
+	if (ddi_copyout(&params, (void *)arg, sizeof (params), md) != 0)
+		return (EFAULT);
+
+	return (0);
+}
+
+static void
+uring_teardown(uring_t *ur)
+{
+	pollcache_t *pcp = ur->ur_pcache;
+	uring_req_t *urq;
+
+	mutex_enter(&ur->ur_submit_lock);
+	while ((urq = list_head(&ur->ur_parked)) != NULL) {
+		uring_unpark(ur, urq);
+		uring_done(ur, urq, -ECANCELED);
+	}
+	mutex_exit(&ur->ur_submit_lock);
+
+	mutex_enter(&ur->ur_lock);
+	while (!list_is_empty(&ur->ur_async))
+		cv_wait(&ur->ur_cv, &ur->ur_lock);
+	mutex_exit(&ur->ur_lock);
+
+	if (ur->ur_nfiles != 0)
+		uring_files_release(ur->ur_files, ur->ur_nfiles);
+	if (ur->ur_nbufs != 0)
+		uring_bufs_release(ur->ur_bufs, ur->ur_nbufs, B_TRUE);
+	(void) uring_eventfd_unregister(ur);
+
+	/*
+	 * Wait for any pollwakeup() that backed off from pc_lock to finish
+	 * with the pollcache; see dpclose().
+	 */
+	mutex_enter(&pcp->pc_no_exit);
+	while (pcp->pc_busy > 0)
+		cv_wait(&pcp->pc_busy_cv, &pcp->pc_no_exit);
+	mutex_exit(&pcp->pc_no_exit);
+
+	mutex_enter(&pcp->pc_lock);
+	pcachelink_purge_all(pcp);
+	mutex_exit(&pcp->pc_lock);
+	pcache_destroy(pcp);
+
+	id_space_destroy(ur->ur_slots);
+	ddi_umem_free(ur->ur_sqe_cookie);
+	ddi_umem_free(ur->ur_ring_cookie);
+}
+
+/*ARGSUSED*/
+static int
+uring_open(dev_t *devp, int flag, int otyp, cred_t *cred_p)
+{
+	uring_t *ur;
+	major_t major = getemajor(*devp);
+	minor_t minor = getminor(*devp);
+
+	if (minor != URINGMNRN_URING)
+		return (ENXIO);
+
+	mutex_enter(&uring_lock);
+
+	minor = (minor_t)(uintptr_t)vmem_alloc(uring_minor, 1,
+	    VM_BESTFIT | VM_SLEEP);
+
+	if (ddi_soft_state_zalloc(uring_softstate, minor) != DDI_SUCCESS) {
+		vmem_free(uring_minor, (void *)(uintptr_t)minor, 1);
+		mutex_exit(&uring_lock);
+		return (ENXIO);
+	}
+
+	ur = ddi_get_soft_state(uring_softstate, minor);
+	mutex_init(&ur->ur_submit_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&ur->ur_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&ur->ur_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&ur->ur_async, sizeof (uring_req_t),
+	    offsetof(uring_req_t, urq_link));
+	list_create(&ur->ur_parked, sizeof (uring_req_t),
+	    offsetof(uring_req_t, urq_link));
+	*devp = makedevice(major, minor);
+
+	mutex_exit(&uring_lock);
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static int
+uring_ioctl(dev_t dev, int cmd, intptr_t arg, int md, cred_t *cr, int *rv)
+{
+	uring_t *ur;
+	minor_t minor = getminor(dev);
+
+	ur = ddi_get_soft_state(uring_softstate, minor);
+
+	switch (cmd) {
+	case URINGIOC_SETUP:
+		return (uring_setup(ur, arg, md));
+
+	case URINGIOC_ENTER:
+		return (uring_enter(ur, arg, md, rv));
+
+	case URINGIOC_REGISTER:
+		return (uring_register(ur, arg, md));
+
+	case URINGIOC_XLATE:
+		/*
+		 * This ioctl is expected to be kernel-internal, used only by
+		 * brands to supply their translations.
+		 */
+		if ((md & FKIOCTL) == 0)
+			break;
+		ur->ur_xlate = (const uring_xlate_t *)arg;
+		return (0);
+
+	default:
+		break;
+	}
+
+	return (ENOTTY);
+}
+
+/*ARGSUSED*/
+static int
+uring_devmap(dev_t dev, devmap_cookie_t dhp, offset_t off, size_t len,
+    size_t *maplen, uint_t model)
+{
+	uring_t *ur;
+	minor_t minor = getminor(dev);
+	ddi_umem_cookie_t cookie;
+	size_t size;
+	int error;
+
+	ur = ddi_get_soft_state(uring_softstate, minor);
+
+	if (!ur->ur_setup)
+		return (ENXIO);
+
+	switch (off) {
+	case IORING_OFF_SQ_RING:
+	case IORING_OFF_CQ_RING:
+		cookie = ur->ur_ring_cookie;
+		size = ur->ur_ring_size;
+		break;
+	case IORING_OFF_SQES:
+		cookie = ur->ur_sqe_cookie;
+		size = ur->ur_sqe_size;
+		break;
+	default:
+		return (EINVAL);
+	}
+
+	if ((len = ptob(btopr(len))) > size)
+		return (EINVAL);
+
+	if ((error = devmap_umem_setup(dhp, uring_devi, NULL, cookie, 0, len,
+	    PROT_ALL, DEVMAP_DEFAULTS, NULL)) != 0)
+		return (error);
+
+	*maplen = len;
+	return (0);
+}
+
+/*ARGSUSED*/
+static int
+uring_poll(dev_t dev, short events, int anyyet, short *reventsp,
+    struct pollhead **phpp)
+{
+	uring_t *ur;
+	minor_t minor = getminor(dev);
+	pollcache_t *pcp;
+	short revents = 0;
+	int res;
+
+	ur = ddi_get_soft_state(uring_softstate, minor);
+
+	if (ur->ur_setup && (events & (POLLIN | POLLRDNORM))) {
+		pcp = ur->ur_pcache;
+
+		/*
+		 * Link our pollcache to that of the poller, if any, so that
+		 * parked requests becoming ready wake it; see dppoll().
+		 */
+		if ((res = pollstate_enter(pcp)) == PSE_SUCCESS) {
+			pollstate_t *ps = curthread->t_pollstate;
+
+			if (ps->ps_pc_stack[0] != pcp)
+				pcachelink_assoc(pcp, ps->ps_pc_stack[0]);
+		} else if (res == PSE_FAIL_LOOP || res == PSE_FAIL_DEADLOCK) {
+			return (ELOOP);
+		}
+
+		if (uring_cq_ready(ur) != 0 || pcp->pc_nready != 0)
+			revents = events & (POLLIN | POLLRDNORM);
+
+		if (res == PSE_SUCCESS)
+			pollstate_exit(pcp);
+	}
+
+	*reventsp = revents;
+	if ((revents == 0 && !anyyet) || (events & POLLET))
+		*phpp = &ur->ur_pollhd;
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static int
+uring_close(dev_t dev, int flag, int otyp, cred_t *cred_p)
+{
+	uring_t *ur;
+	minor_t minor = getminor(dev);
+
+	ur = ddi_get_soft_state(uring_softstate, minor);
+
+	if (ur->ur_setup)
+		uring_teardown(ur);
+
+	if (ur->ur_pollhd.ph_list != NULL) {
+		pollwakeup(&ur->ur_pollhd, POLLERR);
+		pollhead_clean(&ur->ur_pollhd);
+	}
+
+	list_destroy(&ur->ur_async);
+	list_destroy(&ur->ur_parked);
+	cv_destroy(&ur->ur_cv);
+	mutex_destroy(&ur->ur_lock);
+	mutex_destroy(&ur->ur_submit_lock);
+
+	mutex_enter(&uring_lock);
+	ddi_soft_state_free(uring_softstate, minor);
+	vmem_free(uring_minor, (void *)(uintptr_t)minor, 1);
+	mutex_exit(&uring_lock);
+
+	return (0);
+}
+
+static int
+uring_attach(dev_info_t *devi, ddi_attach_cmd_t cmd)
+{
+	switch (cmd) {
+	case DDI_ATTACH:
+		break;
+
+	case DDI_RESUME:
+		return (DDI_SUCCESS);
+
+	default:
+		return (DDI_FAILURE);
+	}
+
+	mutex_enter(&uring_lock);
+
+	if (ddi_soft_state_init(&uring_softstate, sizeof (uring_t), 0) != 0) {
+		cmn_err(CE_NOTE, "/dev/uring failed to create soft state");
+		mutex_exit(&uring_lock);
+		return (DDI_FAILURE);
+	}
+
+	if (ddi_create_minor_node(devi, "uring", S_IFCHR,
+	    URINGMNRN_URING, DDI_PSEUDO, 0) == DDI_FAILURE) {
+		cmn_err(CE_NOTE, "/dev/uring couldn't create minor node");
+		ddi_soft_state_fini(&uring_softstate);
+		mutex_exit(&uring_lock);
+		return (DDI_FAILURE);
+	}
+
+	ddi_report_dev(devi);
+	uring_devi = devi;
+	uring_major = ddi_driver_major(devi);
+
+	uring_minor = vmem_create("uring_minor", (void *)URINGMNRN_CLONE,
+	    UINT32_MAX - URINGMNRN_CLONE, 1, NULL, NULL, NULL, 0,
+	    VM_SLEEP | VMC_IDENTIFIER);
+
+	uring_taskq = taskq_create("uring_taskq", uring_taskq_nthreads,
+	    minclsyspri, 1, INT_MAX, TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
+	uring_req_cache = kmem_cache_create("uring_req_cache",
+	    sizeof (uring_req_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	uring_buf_hash = mod_hash_create_ptrhash("uring_buf_hash", 64,
+	    mod_hash_null_valdtor, sizeof (ddi_umem_cookie_t));
+
+	mutex_exit(&uring_lock);
+
+	return (DDI_SUCCESS);
+}
+
+/*ARGSUSED*/
+static int
+uring_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
+{
+	switch (cmd) {
+	case DDI_DETACH:
+		break;
+
+	case DDI_SUSPEND:
+		return (DDI_SUCCESS);
+
+	default:
+		return (DDI_FAILURE);
+	}
+
+	mutex_enter(&uring_lock);
+
+	/* buffers of closed rings may still be being released */
+	taskq_destroy(uring_taskq);
+	mod_hash_destroy_ptrhash(uring_buf_hash);
+	kmem_cache_destroy(uring_req_cache);
+	vmem_destroy(uring_minor);
+
+	ddi_remove_minor_node(uring_devi, NULL);
+	uring_devi = NULL;
+
+	ddi_soft_state_fini(&uring_softstate);
+	mutex_exit(&uring_lock);
+
+	return (DDI_SUCCESS);
+}
+
+/*ARGSUSED*/
+static int
+uring_info(dev_info_t *dip, ddi_info_cmd_t infocmd, void *arg, void **result)
+{
+	int error;
+
+	switch (infocmd) {
+	case DDI_INFO_DEVT2DEVINFO:
+		*result = (void *)uring_devi;
+		error = DDI_SUCCESS;
+		break;
+	case DDI_INFO_DEVT2INSTANCE:
+		*result = (void *)0;
+		error = DDI_SUCCESS;
+		break;
+	default:
+		error = DDI_FAILURE;
+	}
+	return (error);
+}
+
+static struct cb_ops uring_cb_ops = {
+	uring_open,		/* open */
+	uring_close,		/* close */
+	nulldev,		/* strategy */
+	nulldev,		/* print */
+	nodev,			/* dump */
+	nodev,			/* read */
+	nodev,			/* write */
+	uring_ioctl,		/* ioctl */
+	uring_devmap,		/* devmap */
+	nodev,			/* mmap */
+	nodev,			/* segmap */
+	uring_poll,		/* poll */
+	ddi_prop_op,		/* cb_prop_op */
+	0,			/* streamtab  */
+	D_NEW | D_MP | D_DEVMAP	/* Driver compatibility flag */
+};
+
+static struct dev_ops uring_ops = {
+	DEVO_REV,		/* devo_rev */
+	0,			/* refcnt */
+	uring_info,		/* get_dev_info */
+	nulldev,		/* identify */
+	nulldev,		/* probe */
+	uring_attach,		/* attach */
+	uring_detach,		/* detach */
+	nodev,			/* reset */
+	&uring_cb_ops,		/* driver operations */
+	NULL,			/* bus operations */
+	nodev,			/* dev power */
+	ddi_quiesce_not_needed,	/* quiesce */
+};
+
+static struct modldrv modldrv = {
+	&mod_driverops,		/* module type (this is a pseudo driver) */
+	"io_uring support",	/* name of module */
+	&uring_ops,		/* driver ops */
+};
+
+static struct modlinkage modlinkage = {
+	MODREV_1,
+	(void *)&modldrv,
+	NULL
+};
+
+int
+_init(void)
+{
+	return (mod_install(&modlinkage));
+}
+
+int
+_info(struct modinfo *modinfop)
+{
+	return (mod_info(&modlinkage, modinfop));
+}
+
+int
+_fini(void)
+{
+	return (mod_remove(&modlinkage));
+}
@@ -44,6 +44,17 @@
 
 /*
  * VIRTIO NETWORK DRIVER
+ *
+ * If the device offers VIRTIO_NET_F_MQ, we use up to one receive and transmit
+ * queue pair per CPU (see "vioif_max_qpairs") and enable them with a command
+ * on the control queue.  Each queue pair has its own lock, buffers, and
+ * statistics.  Receive queues are exposed to MAC as the rings of a single
+ * static group, which allows MAC to fan incoming traffic out to its soft rings
+ * and to poll a busy ring with the interrupt disabled.  Transmit queues are
+ * exposed as individual rings, and MAC hashes outbound flows across them.
+ *
+ * The per-instance "vif_mutex" is taken before any per-queue lock.  The run
+ * state is only changed with every queue lock held; see vioif_runstate_set().
  */
 
 #include <sys/types.h>
@@ -64,6 +75,7 @@
 #include <sys/vlan.h>
 #include <sys/sysmacros.h>
 #include <sys/smbios.h>
+#include <sys/cpuvar.h>
 
 #include <sys/dlpi.h>
 #include <sys/taskq.h>
@@ -88,21 +100,19 @@ static int vioif_quiesce(dev_info_t *);
 static int vioif_attach(dev_info_t *, ddi_attach_cmd_t);
 static int vioif_detach(dev_info_t *, ddi_detach_cmd_t);
 static boolean_t vioif_has_feature(vioif_t *, uint32_t);
-static void vioif_reclaim_restart(vioif_t *);
+static void vioif_reclaim_restart(vioif_txq_t *);
 static int vioif_m_stat(void *, uint_t, uint64_t *);
 static void vioif_m_stop(void *);
 static int vioif_m_start(void *);
 static int vioif_m_multicst(void *, boolean_t, const uint8_t *);
 static int vioif_m_setpromisc(void *, boolean_t);
-static int vioif_m_unicst(void *, const uint8_t *);
-static mblk_t *vioif_m_tx(void *, mblk_t *);
 static int vioif_m_setprop(void *, const char *, mac_prop_id_t, uint_t,
     const void *);
 static int vioif_m_getprop(void *, const char *, mac_prop_id_t, uint_t, void *);
 static void vioif_m_propinfo(void *, const char *, mac_prop_id_t,
     mac_prop_info_handle_t);
 static boolean_t vioif_m_getcapab(void *, mac_capab_t, void *);
-static uint_t vioif_add_rx(vioif_t *);
+static uint_t vioif_add_rx(vioif_rxq_t *);
 
 
 static struct cb_ops vioif_cb_ops = {
@@ -162,8 +172,6 @@ static mac_callbacks_t vioif_mac_callbacks = {
 	.mc_stop =			vioif_m_stop,
 	.mc_setpromisc =		vioif_m_setpromisc,
 	.mc_multicst =			vioif_m_multicst,
-	.mc_unicst =			vioif_m_unicst,
-	.mc_tx =			vioif_m_tx,
 
 	.mc_callbacks =			(MC_GETCAPAB | MC_SETPROP |
 					    MC_GETPROP | MC_PROPINFO),
@@ -189,6 +197,13 @@ uint_t vioif_reclaim_ms = 200;
  */
 int vioif_allowed_int_types = -1;
 
+/*
+ * The maximum number of receive and transmit queue pairs to use, if the device
+ * supports more than one.  This is further limited by VIOIF_MAX_QPAIRS and by
+ * the number of online CPUs at attach time.
+ */
+uint_t vioif_max_qpairs = VIOIF_MAX_QPAIRS;
+
 /*
  * DMA attribute template for transmit and receive buffers.  The SGL entry
  * count will be modified before using the template.  Note that these
@@ -230,6 +245,25 @@ ddi_dma_attr_t vioif_dma_attr_external = {
 	.dma_attr_flags =		0
 };
 
+/*
+ * DMA attributes for the control queue command buffer, which must be
+ * physically contiguous as it is carved into several descriptors.
+ */
+ddi_dma_attr_t vioif_dma_attr_ctrl = {
+	.dma_attr_version =		DMA_ATTR_V0,
+	.dma_attr_addr_lo =		0x0000000000000000,
+	.dma_attr_addr_hi =		0xFFFFFFFFFFFFFFFF,
+	.dma_attr_count_max =		0x00000000FFFFFFFF,
+	.dma_attr_align =		sizeof (uint64_t),
+	.dma_attr_burstsizes =		1,
+	.dma_attr_minxfer =		1,
+	.dma_attr_maxxfer =		0x00000000FFFFFFFF,
+	.dma_attr_seg =			0x00000000FFFFFFFF,
+	.dma_attr_sgllen =		1,
+	.dma_attr_granular =		1,
+	.dma_attr_flags =		0
+};
+
 
 /*
  * VIRTIO NET MAC PROPERTIES
@@ -250,72 +284,72 @@ static char *vioif_priv_props[] = {
 
 
 static vioif_txbuf_t *
-vioif_txbuf_alloc(vioif_t *vif)
+vioif_txbuf_alloc(vioif_txq_t *txq)
 {
 	vioif_txbuf_t *tb;
 
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_HELD(&txq->txq_mutex));
 
-	if ((tb = list_remove_head(&vif->vif_txbufs)) != NULL) {
-		vif->vif_ntxbufs_alloc++;
+	if ((tb = list_remove_head(&txq->txq_bufs)) != NULL) {
+		txq->txq_nbufs_alloc++;
 	}
 
 	return (tb);
 }
 
 static void
-vioif_txbuf_free(vioif_t *vif, vioif_txbuf_t *tb)
+vioif_txbuf_free(vioif_txq_t *txq, vioif_txbuf_t *tb)
 {
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_HELD(&txq->txq_mutex));
 
-	VERIFY3U(vif->vif_ntxbufs_alloc, >, 0);
-	vif->vif_ntxbufs_alloc--;
+	VERIFY3U(txq->txq_nbufs_alloc, >, 0);
+	txq->txq_nbufs_alloc--;
 
 	virtio_chain_clear(tb->tb_chain);
-	list_insert_head(&vif->vif_txbufs, tb);
+	list_insert_head(&txq->txq_bufs, tb);
 }
 
 static vioif_rxbuf_t *
-vioif_rxbuf_alloc(vioif_t *vif)
+vioif_rxbuf_alloc(vioif_rxq_t *rxq)
 {
 	vioif_rxbuf_t *rb;
 
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_HELD(&rxq->rxq_mutex));
 
-	if ((rb = list_remove_head(&vif->vif_rxbufs)) != NULL) {
-		vif->vif_nrxbufs_alloc++;
+	if ((rb = list_remove_head(&rxq->rxq_bufs)) != NULL) {
+		rxq->rxq_nbufs_alloc++;
 	}
 
 	return (rb);
 }
 
 static void
-vioif_rxbuf_free(vioif_t *vif, vioif_rxbuf_t *rb)
+vioif_rxbuf_free(vioif_rxq_t *rxq, vioif_rxbuf_t *rb)
 {
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_HELD(&rxq->rxq_mutex));
 
-	VERIFY3U(vif->vif_nrxbufs_alloc, >, 0);
-	vif->vif_nrxbufs_alloc--;
+	VERIFY3U(rxq->rxq_nbufs_alloc, >, 0);
+	rxq->rxq_nbufs_alloc--;
 
 	virtio_chain_clear(rb->rb_chain);
-	list_insert_head(&vif->vif_rxbufs, rb);
+	list_insert_head(&rxq->rxq_bufs, rb);
 }
 
 static void
 vioif_rx_free_callback(caddr_t free_arg)
 {
 	vioif_rxbuf_t *rb = (vioif_rxbuf_t *)free_arg;
-	vioif_t *vif = rb->rb_vioif;
+	vioif_rxq_t *rxq = rb->rb_rxq;
 
-	mutex_enter(&vif->vif_mutex);
+	mutex_enter(&rxq->rxq_mutex);
 
 	/*
 	 * Return this receive buffer to the free list.
 	 */
-	vioif_rxbuf_free(vif, rb);
+	vioif_rxbuf_free(rxq, rb);
 
-	VERIFY3U(vif->vif_nrxbufs_onloan, >, 0);
-	vif->vif_nrxbufs_onloan--;
+	VERIFY3U(rxq->rxq_nbufs_onloan, >, 0);
+	rxq->rxq_nbufs_onloan--;
 
 	/*
 	 * Attempt to replenish the receive queue with at least the buffer we
@@ -323,25 +357,29 @@ vioif_rx_free_callback(caddr_t free_arg)
 	 * though because we'll only loan at most half of the buffers there
 	 * should always be at least some available even if this fails.
 	 */
-	(void) vioif_add_rx(vif);
+	(void) vioif_add_rx(rxq);
 
-	mutex_exit(&vif->vif_mutex);
+	mutex_exit(&rxq->rxq_mutex);
 }
 
 static void
-vioif_free_bufs(vioif_t *vif)
+vioif_txq_free_bufs(vioif_txq_t *txq)
 {
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_HELD(&txq->txq_mutex));
 
-	VERIFY3U(vif->vif_ntxbufs_alloc, ==, 0);
-	for (uint_t i = 0; i < vif->vif_txbufs_capacity; i++) {
-		vioif_txbuf_t *tb = &vif->vif_txbufs_mem[i];
+	if (txq->txq_bufs_mem == NULL) {
+		return;
+	}
+
+	VERIFY3U(txq->txq_nbufs_alloc, ==, 0);
+	for (uint_t i = 0; i < txq->txq_bufs_capacity; i++) {
+		vioif_txbuf_t *tb = &txq->txq_bufs_mem[i];
 
 		/*
 		 * Ensure that this txbuf is now in the free list:
 		 */
 		VERIFY(list_link_active(&tb->tb_link));
-		list_remove(&vif->vif_txbufs, tb);
+		list_remove(&txq->txq_bufs, tb);
 
 		/*
 		 * We should not have an mblk chain at this point.
@@ -373,23 +411,32 @@ vioif_free_bufs(vioif_t *vif)
 			tb->tb_dmaext_capacity = 0;
 		}
 	}
-	VERIFY(list_is_empty(&vif->vif_txbufs));
-	if (vif->vif_txbufs_mem != NULL) {
-		kmem_free(vif->vif_txbufs_mem,
-		    sizeof (vioif_txbuf_t) * vif->vif_txbufs_capacity);
-		vif->vif_txbufs_mem = NULL;
-		vif->vif_txbufs_capacity = 0;
+	VERIFY(list_is_empty(&txq->txq_bufs));
+	list_destroy(&txq->txq_bufs);
+	kmem_free(txq->txq_bufs_mem,
+	    sizeof (vioif_txbuf_t) * txq->txq_bufs_capacity);
+	txq->txq_bufs_mem = NULL;
+	txq->txq_bufs_capacity = 0;
+}
+
+static void
+vioif_rxq_free_bufs(vioif_rxq_t *rxq)
+{
+	VERIFY(MUTEX_HELD(&rxq->rxq_mutex));
+
+	if (rxq->rxq_bufs_mem == NULL) {
+		return;
 	}
 
-	VERIFY3U(vif->vif_nrxbufs_alloc, ==, 0);
-	for (uint_t i = 0; i < vif->vif_rxbufs_capacity; i++) {
-		vioif_rxbuf_t *rb = &vif->vif_rxbufs_mem[i];
+	VERIFY3U(rxq->rxq_nbufs_alloc, ==, 0);
+	for (uint_t i = 0; i < rxq->rxq_bufs_capacity; i++) {
+		vioif_rxbuf_t *rb = &rxq->rxq_bufs_mem[i];
 
 		/*
 		 * Ensure that this rxbuf is now in the free list:
 		 */
 		VERIFY(list_link_active(&rb->rb_link));
-		list_remove(&vif->vif_rxbufs, rb);
+		list_remove(&rxq->rxq_bufs, rb);
 
 		if (rb->rb_dma != NULL) {
 			virtio_dma_free(rb->rb_dma);
@@ -401,81 +448,79 @@ vioif_free_bufs(vioif_t *vif)
 			rb->rb_chain = NULL;
 		}
 	}
-	VERIFY(list_is_empty(&vif->vif_rxbufs));
-	if (vif->vif_rxbufs_mem != NULL) {
-		kmem_free(vif->vif_rxbufs_mem,
-		    sizeof (vioif_rxbuf_t) * vif->vif_rxbufs_capacity);
-		vif->vif_rxbufs_mem = NULL;
-		vif->vif_rxbufs_capacity = 0;
-	}
+	VERIFY(list_is_empty(&rxq->rxq_bufs));
+	list_destroy(&rxq->rxq_bufs);
+	kmem_free(rxq->rxq_bufs_mem,
+	    sizeof (vioif_rxbuf_t) * rxq->rxq_bufs_capacity);
+	rxq->rxq_bufs_mem = NULL;
+	rxq->rxq_bufs_capacity = 0;
 }
 
-static int
-vioif_alloc_bufs(vioif_t *vif)
+static void
+vioif_free_bufs(vioif_t *vif)
 {
 	VERIFY(MUTEX_HELD(&vif->vif_mutex));
 
-	/*
-	 * Allocate one contiguous chunk of memory for the transmit and receive
-	 * buffer tracking objects.  If the ring is unusually small, we'll
-	 * reduce our target buffer count accordingly.
-	 */
-	vif->vif_txbufs_capacity = MIN(VIRTIO_NET_TX_BUFS,
-	    virtio_queue_size(vif->vif_tx_vq));
-	vif->vif_txbufs_mem = kmem_zalloc(
-	    sizeof (vioif_txbuf_t) * vif->vif_txbufs_capacity, KM_SLEEP);
-	list_create(&vif->vif_txbufs, sizeof (vioif_txbuf_t),
-	    offsetof(vioif_txbuf_t, tb_link));
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
 
-	vif->vif_rxbufs_capacity = MIN(VIRTIO_NET_RX_BUFS,
-	    virtio_queue_size(vif->vif_rx_vq));
-	vif->vif_rxbufs_mem = kmem_zalloc(
-	    sizeof (vioif_rxbuf_t) * vif->vif_rxbufs_capacity, KM_SLEEP);
-	list_create(&vif->vif_rxbufs, sizeof (vioif_rxbuf_t),
-	    offsetof(vioif_rxbuf_t, rb_link));
+		mutex_enter(&txq->txq_mutex);
+		vioif_txq_free_bufs(txq);
+		mutex_exit(&txq->txq_mutex);
+
+		mutex_enter(&rxq->rxq_mutex);
+		vioif_rxq_free_bufs(rxq);
+		mutex_exit(&rxq->rxq_mutex);
+	}
+}
+
+static int
+vioif_txq_alloc_bufs(vioif_txq_t *txq)
+{
+	vioif_t *vif = txq->txq_vioif;
+
+	VERIFY(MUTEX_HELD(&txq->txq_mutex));
 
 	/*
-	 * Do not loan more than half of our allocated receive buffers into
-	 * the networking stack.
+	 * Allocate one contiguous chunk of memory for the transmit buffer
+	 * tracking objects.  If the ring is unusually small, we'll reduce our
+	 * target buffer count accordingly.
 	 */
-	vif->vif_nrxbufs_onloan_max = vif->vif_rxbufs_capacity / 2;
+	txq->txq_bufs_capacity = MIN(VIRTIO_NET_TX_BUFS,
+	    virtio_queue_size(txq->txq_vq));
+	txq->txq_bufs_mem = kmem_zalloc(
+	    sizeof (vioif_txbuf_t) * txq->txq_bufs_capacity, KM_SLEEP);
+	list_create(&txq->txq_bufs, sizeof (vioif_txbuf_t),
+	    offsetof(vioif_txbuf_t, tb_link));
 
 	/*
 	 * Put everything in the free list straight away in order to simplify
-	 * the use of vioif_free_bufs() for cleanup on allocation failure.
+	 * the use of vioif_txq_free_bufs() for cleanup on allocation failure.
 	 */
-	for (uint_t i = 0; i < vif->vif_txbufs_capacity; i++) {
-		list_insert_tail(&vif->vif_txbufs, &vif->vif_txbufs_mem[i]);
-	}
-	for (uint_t i = 0; i < vif->vif_rxbufs_capacity; i++) {
-		list_insert_tail(&vif->vif_rxbufs, &vif->vif_rxbufs_mem[i]);
+	for (uint_t i = 0; i < txq->txq_bufs_capacity; i++) {
+		list_insert_tail(&txq->txq_bufs, &txq->txq_bufs_mem[i]);
 	}
 
-	/*
-	 * Start from the DMA attribute template common to both transmit and
-	 * receive buffers.  The SGL entry count will be modified for each
-	 * buffer type.
-	 */
-	ddi_dma_attr_t attr = vioif_dma_attr_bufs;
-
 	/*
 	 * The transmit inline buffer is small (less than a page), so it's
 	 * reasonable to request a single cookie.
 	 */
+	ddi_dma_attr_t attr = vioif_dma_attr_bufs;
 	attr.dma_attr_sgllen = 1;
 
-	for (vioif_txbuf_t *tb = list_head(&vif->vif_txbufs); tb != NULL;
-	    tb = list_next(&vif->vif_txbufs, tb)) {
+	for (vioif_txbuf_t *tb = list_head(&txq->txq_bufs); tb != NULL;
+	    tb = list_next(&txq->txq_bufs, tb)) {
 		if ((tb->tb_dma = virtio_dma_alloc(vif->vif_virtio,
 		    VIOIF_TX_INLINE_SIZE, &attr,
 		    DDI_DMA_STREAMING | DDI_DMA_WRITE, KM_SLEEP)) == NULL) {
-			goto fail;
+			return (ENOMEM);
 		}
 		VERIFY3U(virtio_dma_ncookies(tb->tb_dma), ==, 1);
 
-		if ((tb->tb_chain = virtio_chain_alloc(vif->vif_tx_vq,
+		if ((tb->tb_chain = virtio_chain_alloc(txq->txq_vq,
 		    KM_SLEEP)) == NULL) {
-			goto fail;
+			return (ENOMEM);
 		}
 		virtio_chain_data_set(tb->tb_chain, tb);
 
@@ -485,24 +530,52 @@ vioif_alloc_bufs(vioif_t *vif)
 		    KM_SLEEP);
 	}
 
+	return (0);
+}
+
+static int
+vioif_rxq_alloc_bufs(vioif_rxq_t *rxq)
+{
+	vioif_t *vif = rxq->rxq_vioif;
+
+	VERIFY(MUTEX_HELD(&rxq->rxq_mutex));
+
+	rxq->rxq_bufs_capacity = MIN(VIRTIO_NET_RX_BUFS,
+	    virtio_queue_size(rxq->rxq_vq));
+	rxq->rxq_bufs_mem = kmem_zalloc(
+	    sizeof (vioif_rxbuf_t) * rxq->rxq_bufs_capacity, KM_SLEEP);
+	list_create(&rxq->rxq_bufs, sizeof (vioif_rxbuf_t),
+	    offsetof(vioif_rxbuf_t, rb_link));
+
+	/*
+	 * Do not loan more than half of our allocated receive buffers into
+	 * the networking stack.
+	 */
+	rxq->rxq_nbufs_onloan_max = rxq->rxq_bufs_capacity / 2;
+
+	for (uint_t i = 0; i < rxq->rxq_bufs_capacity; i++) {
+		list_insert_tail(&rxq->rxq_bufs, &rxq->rxq_bufs_mem[i]);
+	}
+
 	/*
 	 * The receive buffers are larger, and we can tolerate a large number
 	 * of segments.  Adjust the SGL entry count, setting aside one segment
 	 * for the virtio net header.
 	 */
+	ddi_dma_attr_t attr = vioif_dma_attr_bufs;
 	attr.dma_attr_sgllen = VIOIF_MAX_SEGS - 1;
 
-	for (vioif_rxbuf_t *rb = list_head(&vif->vif_rxbufs); rb != NULL;
-	    rb = list_next(&vif->vif_rxbufs, rb)) {
+	for (vioif_rxbuf_t *rb = list_head(&rxq->rxq_bufs); rb != NULL;
+	    rb = list_next(&rxq->rxq_bufs, rb)) {
 		if ((rb->rb_dma = virtio_dma_alloc(vif->vif_virtio,
 		    VIOIF_RX_BUF_SIZE, &attr, DDI_DMA_STREAMING | DDI_DMA_READ,
 		    KM_SLEEP)) == NULL) {
-			goto fail;
+			return (ENOMEM);
 		}
 
-		if ((rb->rb_chain = virtio_chain_alloc(vif->vif_rx_vq,
+		if ((rb->rb_chain = virtio_chain_alloc(rxq->rxq_vq,
 		    KM_SLEEP)) == NULL) {
-			goto fail;
+			return (ENOMEM);
 		}
 		virtio_chain_data_set(rb->rb_chain, rb);
 
@@ -520,16 +593,69 @@ vioif_alloc_bufs(vioif_t *vif)
 		VERIFY3U((uintptr_t)virtio_dma_va(rb->rb_dma,
 		    VIOIF_HEADER_SKIP) % 4, ==, 2);
 
-		rb->rb_vioif = vif;
+		rb->rb_rxq = rxq;
 		rb->rb_frtn.free_func = vioif_rx_free_callback;
 		rb->rb_frtn.free_arg = (caddr_t)rb;
 	}
 
 	return (0);
+}
 
-fail:
-	vioif_free_bufs(vif);
-	return (ENOMEM);
+/*
+ * Allocate the transmit and receive buffers for each queue pair in use.  The
+ * DMA attribute template is common to both transmit and receive buffers; the
+ * SGL entry count is modified for each buffer type.
+ */
+static int
+vioif_alloc_bufs(vioif_t *vif)
+{
+	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+
+	for (uint_t i = 0; i < vif->vif_nqpairs; i++) {
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+		int r;
+
+		mutex_enter(&txq->txq_mutex);
+		r = vioif_txq_alloc_bufs(txq);
+		mutex_exit(&txq->txq_mutex);
+
+		if (r == 0) {
+			mutex_enter(&rxq->rxq_mutex);
+			r = vioif_rxq_alloc_bufs(rxq);
+			mutex_exit(&rxq->rxq_mutex);
+		}
+
+		if (r != 0) {
+			vioif_free_bufs(vif);
+			return (r);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * The run state is changed with "vif_mutex" and every queue lock held, so
+ * that it may be checked while holding any one of them.  Queue locks are
+ * taken in order of queue pair index, receive before transmit.
+ */
+static void
+vioif_runstate_set(vioif_t *vif, vioif_runstate_t state)
+{
+	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+
+	for (uint_t i = 0; i < vif->vif_nqpairs; i++) {
+		mutex_enter(&vif->vif_rxqs[i].rxq_mutex);
+		mutex_enter(&vif->vif_txqs[i].txq_mutex);
+	}
+
+	vif->vif_runstate = state;
+
+	for (uint_t i = 0; i < vif->vif_nqpairs; i++) {
+		mutex_exit(&vif->vif_txqs[i].txq_mutex);
+		mutex_exit(&vif->vif_rxqs[i].rxq_mutex);
+	}
 }
 
 static int
@@ -556,16 +682,42 @@ vioif_m_setpromisc(void *arg, boolean_t on)
 	return (0);
 }
 
+/*
+ * The device has exactly one unicast address and we cannot program any
+ * filters, so the receive group accepts only the primary MAC address.  Asking
+ * for another address will cause MAC to fall back to promiscuous mode for the
+ * extra clients.
+ */
 static int
-vioif_m_unicst(void *arg, const uint8_t *mac)
+vioif_group_addmac(void *arg, const uint8_t *mac_addr)
 {
-	return (ENOTSUP);
+	vioif_t *vif = arg;
+
+	if (bcmp(mac_addr, vif->vif_mac, ETHERADDRL) != 0) {
+		return (ENOSPC);
+	}
+
+	return (0);
+}
+
+static int
+vioif_group_remmac(void *arg, const uint8_t *mac_addr)
+{
+	vioif_t *vif = arg;
+
+	if (bcmp(mac_addr, vif->vif_mac, ETHERADDRL) != 0) {
+		return (EINVAL);
+	}
+
+	return (0);
 }
 
 static uint_t
-vioif_add_rx(vioif_t *vif)
+vioif_add_rx(vioif_rxq_t *rxq)
 {
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	vioif_t *vif = rxq->rxq_vioif;
+
+	VERIFY(MUTEX_HELD(&rxq->rxq_mutex));
 
 	if (vif->vif_runstate != VIOIF_RUNSTATE_RUNNING) {
 		/*
@@ -578,7 +730,7 @@ vioif_add_rx(vioif_t *vif)
 	uint_t num_added = 0;
 
 	vioif_rxbuf_t *rb;
-	while ((rb = vioif_rxbuf_alloc(vif)) != NULL) {
+	while ((rb = vioif_rxbuf_alloc(rxq)) != NULL) {
 		/*
 		 * For legacy devices, and those that have not negotiated
 		 * VIRTIO_F_ANY_LAYOUT, the virtio net header must appear in a
@@ -612,28 +764,34 @@ vioif_add_rx(vioif_t *vif)
 		continue;
 
 fail:
-		vioif_rxbuf_free(vif, rb);
-		vif->vif_norecvbuf++;
+		vioif_rxbuf_free(rxq, rb);
+		rxq->rxq_norecvbuf++;
 		break;
 	}
 
 	if (num_added > 0) {
-		virtio_queue_flush(vif->vif_rx_vq);
+		virtio_queue_flush(rxq->rxq_vq);
 	}
 
 	return (num_added);
 }
 
-static uint_t
-vioif_process_rx(vioif_t *vif)
+/*
+ * Collect received frames from the queue into a chain of messages, stopping
+ * once at least "max_bytes" of frame data has been gathered.
+ */
+static mblk_t *
+vioif_process_rx(vioif_rxq_t *rxq, size_t max_bytes)
 {
+	vioif_t *vif = rxq->rxq_vioif;
 	virtio_chain_t *vic;
 	mblk_t *mphead = NULL, *lastmp = NULL, *mp;
-	uint_t num_processed = 0;
+	size_t nbytes = 0;
 
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_HELD(&rxq->rxq_mutex));
 
-	while ((vic = virtio_queue_poll(vif->vif_rx_vq)) != NULL) {
+	while (nbytes < max_bytes &&
+	    (vic = virtio_queue_poll(rxq->rxq_vq)) != NULL) {
 		/*
 		 * We have to use the chain received length here, as the device
 		 * does not tell us the received frame length any other way.
@@ -649,14 +807,14 @@ vioif_process_rx(vioif_t *vif)
 		 * If the NIC is not running, discard any received frames.
 		 */
 		if (vif->vif_runstate != VIOIF_RUNSTATE_RUNNING) {
-			vioif_rxbuf_free(vif, rb);
+			vioif_rxbuf_free(rxq, rb);
 			continue;
 		}
 
 		if (len < sizeof (struct virtio_net_hdr)) {
-			vif->vif_rxfail_chain_undersize++;
-			vif->vif_ierrors++;
-			vioif_rxbuf_free(vif, rb);
+			rxq->rxq_rxfail_chain_undersize++;
+			rxq->rxq_ierrors++;
+			vioif_rxbuf_free(rxq, rb);
 			continue;
 		}
 		len -= sizeof (struct virtio_net_hdr);
@@ -667,14 +825,12 @@ vioif_process_rx(vioif_t *vif)
 		 * the buffers upstream.
 		 */
 		if (len < vif->vif_rxcopy_thresh ||
-		    vif->vif_nrxbufs_onloan >= vif->vif_nrxbufs_onloan_max) {
-			mutex_exit(&vif->vif_mutex);
+		    rxq->rxq_nbufs_onloan >= rxq->rxq_nbufs_onloan_max) {
 			if ((mp = allocb(len, 0)) == NULL) {
-				mutex_enter(&vif->vif_mutex);
-				vif->vif_norecvbuf++;
-				vif->vif_ierrors++;
+				rxq->rxq_norecvbuf++;
+				rxq->rxq_ierrors++;
 
-				vioif_rxbuf_free(vif, rb);
+				vioif_rxbuf_free(rxq, rb);
 				continue;
 			}
 
@@ -687,25 +843,21 @@ vioif_process_rx(vioif_t *vif)
 			 * loaned, we can return the receive buffer resources
 			 * to the free list.
 			 */
-			mutex_enter(&vif->vif_mutex);
-			vioif_rxbuf_free(vif, rb);
+			vioif_rxbuf_free(rxq, rb);
 
 		} else {
-			mutex_exit(&vif->vif_mutex);
 			if ((mp = desballoc(virtio_dma_va(rb->rb_dma,
 			    VIOIF_HEADER_SKIP), len, 0,
 			    &rb->rb_frtn)) == NULL) {
-				mutex_enter(&vif->vif_mutex);
-				vif->vif_norecvbuf++;
-				vif->vif_ierrors++;
+				rxq->rxq_norecvbuf++;
+				rxq->rxq_ierrors++;
 
-				vioif_rxbuf_free(vif, rb);
+				vioif_rxbuf_free(rxq, rb);
 				continue;
 			}
 			mp->b_wptr = mp->b_rptr + len;
 
-			mutex_enter(&vif->vif_mutex);
-			vif->vif_nrxbufs_onloan++;
+			rxq->rxq_nbufs_onloan++;
 		}
 
 		/*
@@ -714,13 +866,14 @@ vioif_process_rx(vioif_t *vif)
 		 */
 		if (mp->b_rptr[0] & 0x1) {
 			if (bcmp(mp->b_rptr, vioif_broadcast, ETHERADDRL) != 0)
-				vif->vif_multircv++;
+				rxq->rxq_multircv++;
 			else
-				vif->vif_brdcstrcv++;
+				rxq->rxq_brdcstrcv++;
 		}
 
-		vif->vif_rbytes += len;
-		vif->vif_ipackets++;
+		rxq->rxq_rbytes += len;
+		rxq->rxq_ipackets++;
+		nbytes += len;
 
 		if (lastmp == NULL) {
 			mphead = mp;
@@ -728,35 +881,20 @@ vioif_process_rx(vioif_t *vif)
 			lastmp->b_next = mp;
 		}
 		lastmp = mp;
-		num_processed++;
 	}
 
-	if (mphead != NULL) {
-		if (vif->vif_runstate == VIOIF_RUNSTATE_RUNNING) {
-			mutex_exit(&vif->vif_mutex);
-			mac_rx(vif->vif_mac_handle, NULL, mphead);
-			mutex_enter(&vif->vif_mutex);
-		} else {
-			/*
-			 * The NIC was disabled part way through our execution,
-			 * so free the messages we allocated.
-			 */
-			freemsgchain(mphead);
-		}
-	}
-
-	return (num_processed);
+	return (mphead);
 }
 
 static uint_t
-vioif_reclaim_used_tx(vioif_t *vif)
+vioif_reclaim_used_tx(vioif_txq_t *txq)
 {
 	virtio_chain_t *vic;
 	uint_t num_reclaimed = 0;
 
-	VERIFY(MUTEX_NOT_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_NOT_HELD(&txq->txq_mutex));
 
-	while ((vic = virtio_queue_poll(vif->vif_tx_vq)) != NULL) {
+	while ((vic = virtio_queue_poll(txq->txq_vq)) != NULL) {
 		vioif_txbuf_t *tb = virtio_chain_data(vic);
 
 		if (tb->tb_mp != NULL) {
@@ -778,9 +916,9 @@ vioif_reclaim_used_tx(vioif_t *vif)
 		/*
 		 * Return this transmit buffer to the free list for reuse.
 		 */
-		mutex_enter(&vif->vif_mutex);
-		vioif_txbuf_free(vif, tb);
-		mutex_exit(&vif->vif_mutex);
+		mutex_enter(&txq->txq_mutex);
+		vioif_txbuf_free(txq, tb);
+		mutex_exit(&txq->txq_mutex);
 
 		num_reclaimed++;
 	}
@@ -789,24 +927,25 @@ vioif_reclaim_used_tx(vioif_t *vif)
 	if (num_reclaimed > 0) {
 		boolean_t do_update = B_FALSE;
 
-		mutex_enter(&vif->vif_mutex);
-		vif->vif_stat_tx_reclaim += num_reclaimed;
-		if (vif->vif_tx_corked) {
+		mutex_enter(&txq->txq_mutex);
+		txq->txq_stat_tx_reclaim += num_reclaimed;
+		if (txq->txq_corked) {
 			/*
 			 * TX was corked on a lack of available descriptors.
 			 * That dire state has passed so the TX interrupt can
 			 * be disabled and MAC can be notified that
 			 * transmission is possible again.
 			 */
-			vif->vif_tx_corked = B_FALSE;
-			virtio_queue_no_interrupt(vif->vif_tx_vq, B_TRUE);
+			txq->txq_corked = B_FALSE;
+			virtio_queue_no_interrupt(txq->txq_vq, B_TRUE);
 			do_update = B_TRUE;
 		}
+		mutex_exit(&txq->txq_mutex);
 
 		if (do_update) {
-			mac_tx_update(vif->vif_mac_handle);
+			mac_tx_ring_update(txq->txq_vioif->vif_mac_handle,
+			    txq->txq_ring_handle);
 		}
-		mutex_exit(&vif->vif_mutex);
 	}
 
 	return (num_reclaimed);
@@ -815,83 +954,84 @@ vioif_reclaim_used_tx(vioif_t *vif)
 static void
 vioif_reclaim_periodic(void *arg)
 {
-	vioif_t *vif = arg;
+	vioif_txq_t *txq = arg;
 	uint_t num_reclaimed;
 
-	num_reclaimed = vioif_reclaim_used_tx(vif);
+	num_reclaimed = vioif_reclaim_used_tx(txq);
 
-	mutex_enter(&vif->vif_mutex);
-	vif->vif_tx_reclaim_tid = 0;
+	mutex_enter(&txq->txq_mutex);
+	txq->txq_reclaim_tid = 0;
 	/*
 	 * If used descriptors were reclaimed or TX descriptors appear to be
 	 * outstanding, the ring is considered active and periodic reclamation
 	 * is necessary for now.
 	 */
-	if (num_reclaimed != 0 || virtio_queue_nactive(vif->vif_tx_vq) != 0) {
+	if (num_reclaimed != 0 || virtio_queue_nactive(txq->txq_vq) != 0) {
 		/* Do not reschedule if the ring is being drained. */
-		if (!vif->vif_tx_drain) {
-			vioif_reclaim_restart(vif);
+		if (!txq->txq_drain) {
+			vioif_reclaim_restart(txq);
 		}
 	}
-	mutex_exit(&vif->vif_mutex);
+	mutex_exit(&txq->txq_mutex);
 }
 
 static void
-vioif_reclaim_restart(vioif_t *vif)
+vioif_reclaim_restart(vioif_txq_t *txq)
 {
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
-	VERIFY(!vif->vif_tx_drain);
+	VERIFY(MUTEX_HELD(&txq->txq_mutex));
+	VERIFY(!txq->txq_drain);
 
-	if (vif->vif_tx_reclaim_tid == 0) {
-		vif->vif_tx_reclaim_tid = timeout(vioif_reclaim_periodic, vif,
+	if (txq->txq_reclaim_tid == 0) {
+		txq->txq_reclaim_tid = timeout(vioif_reclaim_periodic, txq,
 		    MSEC_TO_TICK_ROUNDUP(vioif_reclaim_ms));
 	}
 }
 
 static void
-vioif_tx_drain(vioif_t *vif)
+vioif_tx_drain(vioif_txq_t *txq)
 {
-	VERIFY(MUTEX_HELD(&vif->vif_mutex));
-	VERIFY3S(vif->vif_runstate, ==, VIOIF_RUNSTATE_STOPPING);
+	VERIFY(MUTEX_HELD(&txq->txq_mutex));
+	VERIFY3S(txq->txq_vioif->vif_runstate, ==, VIOIF_RUNSTATE_STOPPING);
 
-	vif->vif_tx_drain = B_TRUE;
+	txq->txq_drain = B_TRUE;
 	/* Put a stop to the periodic reclaim if it is running */
-	if (vif->vif_tx_reclaim_tid != 0) {
-		timeout_id_t tid = vif->vif_tx_reclaim_tid;
+	if (txq->txq_reclaim_tid != 0) {
+		timeout_id_t tid = txq->txq_reclaim_tid;
 
 		/*
-		 * With vif_tx_drain set, there is no risk that a racing
+		 * With txq_drain set, there is no risk that a racing
 		 * vioif_reclaim_periodic() call will reschedule itself.
 		 *
 		 * Being part of the mc_stop hook also guarantees that
-		 * vioif_m_tx() will not be called to restart it.
+		 * vioif_ring_tx() will not be called to restart it.
 		 */
-		vif->vif_tx_reclaim_tid = 0;
-		mutex_exit(&vif->vif_mutex);
+		txq->txq_reclaim_tid = 0;
+		mutex_exit(&txq->txq_mutex);
 		(void) untimeout(tid);
-		mutex_enter(&vif->vif_mutex);
+		mutex_enter(&txq->txq_mutex);
 	}
-	virtio_queue_no_interrupt(vif->vif_tx_vq, B_TRUE);
+	virtio_queue_no_interrupt(txq->txq_vq, B_TRUE);
 
 	/*
 	 * Wait for all of the TX descriptors to be processed by the host so
 	 * they can be reclaimed.
 	 */
-	while (vif->vif_ntxbufs_alloc > 0) {
-		mutex_exit(&vif->vif_mutex);
-		(void) vioif_reclaim_used_tx(vif);
+	while (txq->txq_nbufs_alloc > 0) {
+		mutex_exit(&txq->txq_mutex);
+		(void) vioif_reclaim_used_tx(txq);
 		delay(5);
-		mutex_enter(&vif->vif_mutex);
+		mutex_enter(&txq->txq_mutex);
 	}
-	VERIFY(!vif->vif_tx_corked);
-	VERIFY3U(vif->vif_tx_reclaim_tid, ==, 0);
-	VERIFY3U(virtio_queue_nactive(vif->vif_tx_vq), ==, 0);
+	VERIFY(!txq->txq_corked);
+	VERIFY3U(txq->txq_reclaim_tid, ==, 0);
+	VERIFY3U(virtio_queue_nactive(txq->txq_vq), ==, 0);
 }
 
 static int
-vioif_tx_inline(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
+vioif_tx_inline(vioif_txq_t *txq, vioif_txbuf_t *tb, mblk_t *mp,
+    size_t msg_size)
 {
-	VERIFY(MUTEX_NOT_HELD(&vif->vif_mutex));
+	VERIFY(MUTEX_NOT_HELD(&txq->txq_mutex));
 
 	VERIFY3U(msg_size, <=, virtio_dma_size(tb->tb_dma) - VIOIF_HEADER_SKIP);
 
@@ -910,9 +1050,12 @@ vioif_tx_inline(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
 }
 
 static int
-vioif_tx_external(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
+vioif_tx_external(vioif_txq_t *txq, vioif_txbuf_t *tb, mblk_t *mp,
+    size_t msg_size)
 {
-	VERIFY(MUTEX_NOT_HELD(&vif->vif_mutex));
+	vioif_t *vif = txq->txq_vioif;
+
+	VERIFY(MUTEX_NOT_HELD(&txq->txq_mutex));
 
 	mblk_t *nmp = mp;
 	tb->tb_ndmaext = 0;
@@ -929,10 +1072,10 @@ vioif_tx_external(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
 		}
 
 		if (tb->tb_ndmaext >= tb->tb_dmaext_capacity) {
-			mutex_enter(&vif->vif_mutex);
-			vif->vif_txfail_indirect_limit++;
-			vif->vif_notxbuf++;
-			mutex_exit(&vif->vif_mutex);
+			mutex_enter(&txq->txq_mutex);
+			txq->txq_txfail_indirect_limit++;
+			txq->txq_notxbuf++;
+			mutex_exit(&txq->txq_mutex);
 			goto fail;
 		}
 
@@ -943,9 +1086,9 @@ vioif_tx_external(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
 			if ((tb->tb_dmaext[tb->tb_ndmaext] =
 			    virtio_dma_alloc_nomem(vif->vif_virtio,
 			    &vioif_dma_attr_external, KM_SLEEP)) == NULL) {
-				mutex_enter(&vif->vif_mutex);
-				vif->vif_notxbuf++;
-				mutex_exit(&vif->vif_mutex);
+				mutex_enter(&txq->txq_mutex);
+				txq->txq_notxbuf++;
+				mutex_exit(&txq->txq_mutex);
 				goto fail;
 			}
 		}
@@ -954,9 +1097,9 @@ vioif_tx_external(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
 		if (virtio_dma_bind(extdma, nmp->b_rptr, len,
 		    DDI_DMA_WRITE | DDI_DMA_STREAMING, KM_SLEEP) !=
 		    DDI_SUCCESS) {
-			mutex_enter(&vif->vif_mutex);
-			vif->vif_txfail_dma_bind++;
-			mutex_exit(&vif->vif_mutex);
+			mutex_enter(&txq->txq_mutex);
+			txq->txq_txfail_dma_bind++;
+			mutex_exit(&txq->txq_mutex);
 			goto fail;
 		}
 
@@ -966,10 +1109,10 @@ vioif_tx_external(vioif_t *vif, vioif_txbuf_t *tb, mblk_t *mp, size_t msg_size)
 
 			if (virtio_chain_append(tb->tb_chain, pa, sz,
 			    VIRTIO_DIR_DEVICE_READS) != DDI_SUCCESS) {
-				mutex_enter(&vif->vif_mutex);
-				vif->vif_txfail_indirect_limit++;
-				vif->vif_notxbuf++;
-				mutex_exit(&vif->vif_mutex);
+				mutex_enter(&txq->txq_mutex);
+				txq->txq_txfail_indirect_limit++;
+				txq->txq_notxbuf++;
+				mutex_exit(&txq->txq_mutex);
 				goto fail;
 			}
 		}
@@ -999,9 +1142,11 @@ fail:
 }
 
 static boolean_t
-vioif_send(vioif_t *vif, mblk_t *mp)
+vioif_send(vioif_txq_t *txq, mblk_t *mp)
 {
-	VERIFY(MUTEX_NOT_HELD(&vif->vif_mutex));
+	vioif_t *vif = txq->txq_vioif;
+
+	VERIFY(MUTEX_NOT_HELD(&txq->txq_mutex));
 
 	vioif_txbuf_t *tb = NULL;
 	struct virtio_net_hdr *vnh = NULL;
@@ -1024,12 +1169,12 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 		lso_required = (lso_flags & HW_LSO) != 0;
 	}
 
-	mutex_enter(&vif->vif_mutex);
-	if ((tb = vioif_txbuf_alloc(vif)) == NULL) {
-		vif->vif_notxbuf++;
+	mutex_enter(&txq->txq_mutex);
+	if ((tb = vioif_txbuf_alloc(txq)) == NULL) {
+		txq->txq_notxbuf++;
 		goto fail;
 	}
-	mutex_exit(&vif->vif_mutex);
+	mutex_exit(&txq->txq_mutex);
 
 	/*
 	 * Use the inline buffer for the virtio net header.  Zero the portion
@@ -1046,8 +1191,8 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 	if (virtio_chain_append(tb->tb_chain,
 	    virtio_dma_cookie_pa(tb->tb_dma, 0), sizeof (struct virtio_net_hdr),
 	    VIRTIO_DIR_DEVICE_READS) != DDI_SUCCESS) {
-		mutex_enter(&vif->vif_mutex);
-		vif->vif_notxbuf++;
+		mutex_enter(&txq->txq_mutex);
+		txq->txq_notxbuf++;
 		goto fail;
 	}
 
@@ -1093,16 +1238,16 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 		tcpha_t *tcpha;
 
 		if (mac_ether_offload_info(mp, &meo) != 0) {
-			goto fail;
+			goto fail_unlocked;
 		}
 
 		needed = MEOI_L2INFO_SET | MEOI_L3INFO_SET | MEOI_L4INFO_SET;
 		if ((meo.meoi_flags & needed) != needed) {
-			goto fail;
+			goto fail_unlocked;
 		}
 
 		if (meo.meoi_l4proto != IPPROTO_TCP) {
-			goto fail;
+			goto fail_unlocked;
 		}
 
 		if (meo.meoi_l3proto == ETHERTYPE_IP && vif->vif_tx_tso4) {
@@ -1111,7 +1256,7 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 		    vif->vif_tx_tso6) {
 			vnh->vnh_gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
 		} else {
-			goto fail;
+			goto fail_unlocked;
 		}
 
 		/*
@@ -1127,7 +1272,7 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 		if (MBLKL(mp) < vnh->vnh_hdr_len) {
 			pullmp = msgpullup(mp, vnh->vnh_hdr_len);
 			if (pullmp == NULL)
-				goto fail;
+				goto fail_unlocked;
 			tcpha = (tcpha_t *)(pullmp->b_rptr + meo.meoi_l2hlen +
 			    meo.meoi_l3hlen);
 		} else {
@@ -1157,13 +1302,13 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 	 * ourselves.
 	 */
 	if ((ether->ether_dhost.ether_addr_octet[0] & 0x01) != 0) {
-		mutex_enter(&vif->vif_mutex);
+		mutex_enter(&txq->txq_mutex);
 		if (ether_cmp(&ether->ether_dhost, vioif_broadcast) == 0) {
-			vif->vif_brdcstxmt++;
+			txq->txq_brdcstxmt++;
 		} else {
-			vif->vif_multixmt++;
+			txq->txq_multixmt++;
 		}
-		mutex_exit(&vif->vif_mutex);
+		mutex_exit(&txq->txq_mutex);
 	}
 
 	/*
@@ -1172,63 +1317,68 @@ vioif_send(vioif_t *vif, mblk_t *mp)
 	 * functions ensure that "mp" is freed before returning.
 	 */
 	if (msg_size < vif->vif_txcopy_thresh) {
-		ret = vioif_tx_inline(vif, tb, mp, msg_size);
+		ret = vioif_tx_inline(txq, tb, mp, msg_size);
 	} else {
-		ret = vioif_tx_external(vif, tb, mp, msg_size);
+		ret = vioif_tx_external(txq, tb, mp, msg_size);
 	}
 	mp = NULL;
 
-	mutex_enter(&vif->vif_mutex);
+	mutex_enter(&txq->txq_mutex);
 
 	if (ret != DDI_SUCCESS) {
 		goto fail;
 	}
 
-	vif->vif_opackets++;
-	vif->vif_obytes += msg_size;
-	mutex_exit(&vif->vif_mutex);
+	txq->txq_opackets++;
+	txq->txq_obytes += msg_size;
+	mutex_exit(&txq->txq_mutex);
 
 	virtio_dma_sync(tb->tb_dma, DDI_DMA_SYNC_FORDEV);
 	virtio_chain_submit(tb->tb_chain, B_TRUE);
 
 	return (B_TRUE);
 
+fail_unlocked:
+	/*
+	 * The offload checks above run without the queue lock held.
+	 */
+	mutex_enter(&txq->txq_mutex);
 fail:
-	vif->vif_oerrors++;
+	txq->txq_oerrors++;
 	if (tb != NULL) {
-		vioif_txbuf_free(vif, tb);
+		vioif_txbuf_free(txq, tb);
 	}
-	mutex_exit(&vif->vif_mutex);
+	mutex_exit(&txq->txq_mutex);
 
 	return (mp == NULL);
 }
 
 static mblk_t *
-vioif_m_tx(void *arg, mblk_t *mp)
+vioif_ring_tx(void *arg, mblk_t *mp)
 {
-	vioif_t *vif = arg;
+	vioif_txq_t *txq = arg;
 	mblk_t *nmp;
 
 	/*
 	 * Prior to attempting to send any more frames, do a reclaim to pick up
 	 * any descriptors which have been processed by the host.
 	 */
-	if (virtio_queue_nactive(vif->vif_tx_vq) != 0) {
-		(void) vioif_reclaim_used_tx(vif);
+	if (virtio_queue_nactive(txq->txq_vq) != 0) {
+		(void) vioif_reclaim_used_tx(txq);
 	}
 
 	while (mp != NULL) {
 		nmp = mp->b_next;
 		mp->b_next = NULL;
 
-		if (!vioif_send(vif, mp)) {
+		if (!vioif_send(txq, mp)) {
 			/*
 			 * If there are no descriptors available, try to
 			 * reclaim some, allowing a retry of the send if some
 			 * are found.
 			 */
 			mp->b_next = nmp;
-			if (vioif_reclaim_used_tx(vif) != 0) {
+			if (vioif_reclaim_used_tx(txq) != 0) {
 				continue;
 			}
 
@@ -1238,128 +1388,335 @@ vioif_m_tx(void *arg, mblk_t *mp)
 			 * can begin again.  For safety, make sure the periodic
 			 * reclaim is running as well.
 			 */
-			mutex_enter(&vif->vif_mutex);
-			vif->vif_tx_corked = B_TRUE;
-			virtio_queue_no_interrupt(vif->vif_tx_vq, B_FALSE);
-			vioif_reclaim_restart(vif);
-			mutex_exit(&vif->vif_mutex);
+			mutex_enter(&txq->txq_mutex);
+			txq->txq_corked = B_TRUE;
+			virtio_queue_no_interrupt(txq->txq_vq, B_FALSE);
+			vioif_reclaim_restart(txq);
+			mutex_exit(&txq->txq_mutex);
+
+			/*
+			 * Descriptors the device returned before it saw the
+			 * interrupt enabled will not raise one, so collect
+			 * them now.
+			 */
+			if (virtio_queue_pending(txq->txq_vq) &&
+			    vioif_reclaim_used_tx(txq) != 0) {
+				continue;
+			}
 			return (mp);
 		}
 		mp = nmp;
 	}
 
 	/* Ensure the periodic reclaim has been started. */
-	mutex_enter(&vif->vif_mutex);
-	vioif_reclaim_restart(vif);
-	mutex_exit(&vif->vif_mutex);
+	mutex_enter(&txq->txq_mutex);
+	vioif_reclaim_restart(txq);
+	mutex_exit(&txq->txq_mutex);
 
 	return (NULL);
 }
 
-static int
-vioif_m_start(void *arg)
+static mblk_t *
+vioif_ring_rx_poll(void *arg, int poll_bytes)
 {
-	vioif_t *vif = arg;
+	vioif_rxq_t *rxq = arg;
+	mblk_t *mp;
 
-	mutex_enter(&vif->vif_mutex);
-
-	VERIFY3S(vif->vif_runstate, ==, VIOIF_RUNSTATE_STOPPED);
-	vif->vif_runstate = VIOIF_RUNSTATE_RUNNING;
+	VERIFY3S(poll_bytes, >, 0);
 
-	mac_link_update(vif->vif_mac_handle, LINK_STATE_UP);
+	mutex_enter(&rxq->rxq_mutex);
+	mp = vioif_process_rx(rxq, (size_t)poll_bytes);
+	(void) vioif_add_rx(rxq);
+	mutex_exit(&rxq->rxq_mutex);
 
-	virtio_queue_no_interrupt(vif->vif_rx_vq, B_FALSE);
+	return (mp);
+}
 
-	/*
-	 * Starting interrupts on the TX virtqueue is unnecessary at this time.
-	 * Descriptor reclamation is handling during transmit, via a periodic
-	 * timer, and when resources are tight, via the then-enabled interrupt.
-	 */
-	vif->vif_tx_drain = B_FALSE;
+static int
+vioif_rx_ring_start(mac_ring_driver_t rh, uint64_t gen_num)
+{
+	vioif_rxq_t *rxq = (vioif_rxq_t *)rh;
 
 	/*
-	 * Add as many receive buffers as we can to the receive queue.  If we
-	 * cannot add any, it may be because we have stopped and started again
-	 * and the descriptors are all in the queue already.
+	 * MAC uses the generation number to discard frames delivered from a
+	 * ring that has since been restarted.
 	 */
-	(void) vioif_add_rx(vif);
+	mutex_enter(&rxq->rxq_mutex);
+	rxq->rxq_gen_num = gen_num;
+	rxq->rxq_polling = B_FALSE;
+	mutex_exit(&rxq->rxq_mutex);
 
-	mutex_exit(&vif->vif_mutex);
-	return (DDI_SUCCESS);
+	return (0);
 }
 
-static void
-vioif_m_stop(void *arg)
+static int
+vioif_rx_ring_intr_enable(mac_intr_handle_t ih)
 {
-	vioif_t *vif = arg;
+	vioif_rxq_t *rxq = (vioif_rxq_t *)ih;
 
-	mutex_enter(&vif->vif_mutex);
+	mutex_enter(&rxq->rxq_mutex);
+	rxq->rxq_polling = B_FALSE;
+	virtio_queue_no_interrupt(rxq->rxq_vq, B_FALSE);
+	mutex_exit(&rxq->rxq_mutex);
 
-	VERIFY3S(vif->vif_runstate, ==, VIOIF_RUNSTATE_RUNNING);
-	vif->vif_runstate = VIOIF_RUNSTATE_STOPPING;
+	/*
+	 * Frames the device returned after MAC last polled, but before it saw
+	 * the interrupt enabled, will not raise one.  MAC calls us with the
+	 * ring's SRS locked, so they cannot be delivered from here; hand them
+	 * to the soft interrupt instead.
+	 */
+	if (virtio_queue_pending(rxq->rxq_vq))
+		(void) ddi_intr_trigger_softint(rxq->rxq_softint, NULL);
 
-	/* Ensure all TX descriptors have been processed and reclaimed */
-	vioif_tx_drain(vif);
+	return (0);
+}
 
-	virtio_queue_no_interrupt(vif->vif_rx_vq, B_TRUE);
+static int
+vioif_rx_ring_intr_disable(mac_intr_handle_t ih)
+{
+	vioif_rxq_t *rxq = (vioif_rxq_t *)ih;
 
-	vif->vif_runstate = VIOIF_RUNSTATE_STOPPED;
-	mutex_exit(&vif->vif_mutex);
+	mutex_enter(&rxq->rxq_mutex);
+	virtio_queue_no_interrupt(rxq->rxq_vq, B_TRUE);
+	rxq->rxq_polling = B_TRUE;
+	mutex_exit(&rxq->rxq_mutex);
+
+	return (0);
 }
 
 static int
-vioif_m_stat(void *arg, uint_t stat, uint64_t *val)
+vioif_rx_ring_stat(mac_ring_driver_t rh, uint_t stat, uint64_t *val)
 {
-	vioif_t *vif = arg;
+	vioif_rxq_t *rxq = (vioif_rxq_t *)rh;
 
 	switch (stat) {
 	case MAC_STAT_IERRORS:
-		*val = vif->vif_ierrors;
-		break;
-	case MAC_STAT_OERRORS:
-		*val = vif->vif_oerrors;
+		*val = rxq->rxq_ierrors;
 		break;
 	case MAC_STAT_MULTIRCV:
-		*val = vif->vif_multircv;
+		*val = rxq->rxq_multircv;
 		break;
 	case MAC_STAT_BRDCSTRCV:
-		*val = vif->vif_brdcstrcv;
-		break;
-	case MAC_STAT_MULTIXMT:
-		*val = vif->vif_multixmt;
-		break;
-	case MAC_STAT_BRDCSTXMT:
-		*val = vif->vif_brdcstxmt;
+		*val = rxq->rxq_brdcstrcv;
 		break;
 	case MAC_STAT_IPACKETS:
-		*val = vif->vif_ipackets;
+		*val = rxq->rxq_ipackets;
 		break;
 	case MAC_STAT_RBYTES:
-		*val = vif->vif_rbytes;
+		*val = rxq->rxq_rbytes;
+		break;
+	case MAC_STAT_NORCVBUF:
+		*val = rxq->rxq_norecvbuf;
+		break;
+	default:
+		return (ENOTSUP);
+	}
+
+	return (0);
+}
+
+static int
+vioif_tx_ring_stat(mac_ring_driver_t rh, uint_t stat, uint64_t *val)
+{
+	vioif_txq_t *txq = (vioif_txq_t *)rh;
+
+	switch (stat) {
+	case MAC_STAT_OERRORS:
+		*val = txq->txq_oerrors;
+		break;
+	case MAC_STAT_MULTIXMT:
+		*val = txq->txq_multixmt;
+		break;
+	case MAC_STAT_BRDCSTXMT:
+		*val = txq->txq_brdcstxmt;
 		break;
 	case MAC_STAT_OPACKETS:
-		*val = vif->vif_opackets;
+		*val = txq->txq_opackets;
 		break;
 	case MAC_STAT_OBYTES:
-		*val = vif->vif_obytes;
-		break;
-	case MAC_STAT_NORCVBUF:
-		*val = vif->vif_norecvbuf;
+		*val = txq->txq_obytes;
 		break;
 	case MAC_STAT_NOXMTBUF:
-		*val = vif->vif_notxbuf;
+		*val = txq->txq_notxbuf;
 		break;
+	default:
+		return (ENOTSUP);
+	}
+
+	return (0);
+}
+
+static void
+vioif_fill_rx_ring(void *arg, mac_ring_type_t rtype, const int group_index,
+    const int ring_index, mac_ring_info_t *infop, mac_ring_handle_t rh)
+{
+	vioif_t *vif = arg;
+
+	VERIFY3S(rtype, ==, MAC_RING_TYPE_RX);
+	VERIFY3S(group_index, ==, 0);
+	VERIFY3S(ring_index, >=, 0);
+	VERIFY3S(ring_index, <, vif->vif_nqpairs);
+
+	vioif_rxq_t *rxq = &vif->vif_rxqs[ring_index];
+	rxq->rxq_ring_handle = rh;
+
+	infop->mri_driver = (mac_ring_driver_t)rxq;
+	infop->mri_start = vioif_rx_ring_start;
+	infop->mri_stop = NULL;
+	infop->mri_poll = vioif_ring_rx_poll;
+	infop->mri_stat = vioif_rx_ring_stat;
+
+	/*
+	 * The virtio framework does not expose its interrupt handles, so we
+	 * cannot offer interrupt retargeting to MAC.
+	 */
+	infop->mri_intr.mi_handle = (mac_intr_handle_t)rxq;
+	infop->mri_intr.mi_enable = vioif_rx_ring_intr_enable;
+	infop->mri_intr.mi_disable = vioif_rx_ring_intr_disable;
+}
+
+static void
+vioif_fill_tx_ring(void *arg, mac_ring_type_t rtype, const int group_index,
+    const int ring_index, mac_ring_info_t *infop, mac_ring_handle_t rh)
+{
+	vioif_t *vif = arg;
+
+	/*
+	 * We do not group transmit rings; MAC creates a pseudo-group for each
+	 * ring and passes a group index of -1.
+	 */
+	VERIFY3S(rtype, ==, MAC_RING_TYPE_TX);
+	VERIFY3S(group_index, ==, -1);
+	VERIFY3S(ring_index, >=, 0);
+	VERIFY3S(ring_index, <, vif->vif_nqpairs);
+
+	vioif_txq_t *txq = &vif->vif_txqs[ring_index];
+	txq->txq_ring_handle = rh;
+
+	infop->mri_driver = (mac_ring_driver_t)txq;
+	infop->mri_start = NULL;
+	infop->mri_stop = NULL;
+	infop->mri_tx = vioif_ring_tx;
+	infop->mri_stat = vioif_tx_ring_stat;
+}
+
+static void
+vioif_fill_rx_group(void *arg, mac_ring_type_t rtype, const int index,
+    mac_group_info_t *infop, mac_group_handle_t gh)
+{
+	vioif_t *vif = arg;
+
+	VERIFY3S(rtype, ==, MAC_RING_TYPE_RX);
+	VERIFY3S(index, ==, 0);
+
+	vif->vif_rx_group_handle = gh;
+
+	infop->mgi_driver = (mac_group_driver_t)vif;
+	infop->mgi_start = NULL;
+	infop->mgi_stop = NULL;
+	infop->mgi_addmac = vioif_group_addmac;
+	infop->mgi_remmac = vioif_group_remmac;
+	infop->mgi_count = vif->vif_nqpairs;
+}
+
+static int
+vioif_m_start(void *arg)
+{
+	vioif_t *vif = arg;
+
+	mutex_enter(&vif->vif_mutex);
+
+	VERIFY3S(vif->vif_runstate, ==, VIOIF_RUNSTATE_STOPPED);
+	vioif_runstate_set(vif, VIOIF_RUNSTATE_RUNNING);
+
+	mac_link_update(vif->vif_mac_handle, LINK_STATE_UP);
+
+	for (uint_t i = 0; i < vif->vif_nqpairs; i++) {
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+
+		virtio_queue_no_interrupt(rxq->rxq_vq, B_FALSE);
+
+		/*
+		 * Starting interrupts on the TX virtqueue is unnecessary at
+		 * this time.  Descriptor reclamation is handling during
+		 * transmit, via a periodic timer, and when resources are
+		 * tight, via the then-enabled interrupt.
+		 */
+		mutex_enter(&txq->txq_mutex);
+		txq->txq_drain = B_FALSE;
+		mutex_exit(&txq->txq_mutex);
+
+		/*
+		 * Add as many receive buffers as we can to the receive queue.
+		 * If we cannot add any, it may be because we have stopped and
+		 * started again and the descriptors are all in the queue
+		 * already.
+		 */
+		mutex_enter(&rxq->rxq_mutex);
+		(void) vioif_add_rx(rxq);
+		mutex_exit(&rxq->rxq_mutex);
+	}
+
+	mutex_exit(&vif->vif_mutex);
+	return (DDI_SUCCESS);
+}
+
+static void
+vioif_m_stop(void *arg)
+{
+	vioif_t *vif = arg;
+
+	mutex_enter(&vif->vif_mutex);
+
+	VERIFY3S(vif->vif_runstate, ==, VIOIF_RUNSTATE_RUNNING);
+	vioif_runstate_set(vif, VIOIF_RUNSTATE_STOPPING);
+
+	for (uint_t i = 0; i < vif->vif_nqpairs; i++) {
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+
+		/* Ensure all TX descriptors are processed and reclaimed */
+		mutex_enter(&txq->txq_mutex);
+		vioif_tx_drain(txq);
+		mutex_exit(&txq->txq_mutex);
+
+		virtio_queue_no_interrupt(vif->vif_rxqs[i].rxq_vq, B_TRUE);
+	}
+
+	vioif_runstate_set(vif, VIOIF_RUNSTATE_STOPPED);
+	mutex_exit(&vif->vif_mutex);
+}
+
+static int
+vioif_m_stat(void *arg, uint_t stat, uint64_t *val)
+{
+	vioif_t *vif = arg;
+
+	switch (stat) {
 	case MAC_STAT_IFSPEED:
 		/* always 1 Gbit */
 		*val = 1000000000ULL;
-		break;
+		return (DDI_SUCCESS);
 	case ETHER_STAT_LINK_DUPLEX:
 		/* virtual device, always full-duplex */
 		*val = LINK_DUPLEX_FULL;
-		break;
+		return (DDI_SUCCESS);
+	}
 
-	default:
-		return (ENOTSUP);
+	/*
+	 * Everything else is counted per queue; sum over the queues in use.
+	 */
+	*val = 0;
+	for (uint_t i = 0; i < vif->vif_nqpairs; i++) {
+		uint64_t v;
+
+		if (vioif_rx_ring_stat((mac_ring_driver_t)&vif->vif_rxqs[i],
+		    stat, &v) != 0 &&
+		    vioif_tx_ring_stat((mac_ring_driver_t)&vif->vif_txqs[i],
+		    stat, &v) != 0) {
+			return (ENOTSUP);
+		}
+		*val += v;
 	}
 
 	return (DDI_SUCCESS);
@@ -1523,6 +1880,32 @@ vioif_m_getcapab(void *arg, mac_capab_t cap, void *cap_data)
 		return (B_TRUE);
 	}
 
+	case MAC_CAPAB_RINGS: {
+		mac_capab_rings_t *cap_rings = cap_data;
+
+		cap_rings->mr_group_type = MAC_GROUP_TYPE_STATIC;
+		cap_rings->mr_rnum = vif->vif_nqpairs;
+		cap_rings->mr_gaddring = NULL;
+		cap_rings->mr_gremring = NULL;
+
+		switch (cap_rings->mr_type) {
+		case MAC_RING_TYPE_RX:
+			cap_rings->mr_gnum = 1;
+			cap_rings->mr_rget = vioif_fill_rx_ring;
+			cap_rings->mr_gget = vioif_fill_rx_group;
+			break;
+		case MAC_RING_TYPE_TX:
+			cap_rings->mr_gnum = 0;
+			cap_rings->mr_rget = vioif_fill_tx_ring;
+			cap_rings->mr_gget = NULL;
+			break;
+		default:
+			return (B_FALSE);
+		}
+
+		return (B_TRUE);
+	}
+
 	default:
 		return (B_FALSE);
 	}
@@ -1583,36 +1966,207 @@ vioif_get_mac(vioif_t *vif)
 static uint_t
 vioif_rx_handler(caddr_t arg0, caddr_t arg1)
 {
-	vioif_t *vif = (vioif_t *)arg0;
+	vioif_rxq_t *rxq = (vioif_rxq_t *)arg0;
+	vioif_t *vif = rxq->rxq_vioif;
+	mblk_t *mp;
+	uint64_t gen_num;
+	boolean_t running;
+
+	mutex_enter(&rxq->rxq_mutex);
+	if (rxq->rxq_polling) {
+		/*
+		 * MAC is polling this ring and will collect the frames
+		 * itself.
+		 */
+		mutex_exit(&rxq->rxq_mutex);
+		return (DDI_INTR_CLAIMED);
+	}
 
-	mutex_enter(&vif->vif_mutex);
-	(void) vioif_process_rx(vif);
+	mp = vioif_process_rx(rxq, SIZE_MAX);
 
 	/*
 	 * Attempt to replenish the receive queue.  If we cannot add any
 	 * descriptors here, it may be because all of the recently received
 	 * packets were loaned up to the networking stack.
 	 */
-	(void) vioif_add_rx(vif);
-	mutex_exit(&vif->vif_mutex);
+	(void) vioif_add_rx(rxq);
+
+	gen_num = rxq->rxq_gen_num;
+	running = (vif->vif_runstate == VIOIF_RUNSTATE_RUNNING);
+	mutex_exit(&rxq->rxq_mutex);
+
+	if (mp != NULL) {
+		if (running) {
+			mac_rx_ring(vif->vif_mac_handle, rxq->rxq_ring_handle,
+			    mp, gen_num);
+		} else {
+			freemsgchain(mp);
+		}
+	}
 
 	return (DDI_INTR_CLAIMED);
 }
 
+static void
+vioif_remove_softints(vioif_t *vif)
+{
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+
+		if (rxq->rxq_softint != NULL) {
+			(void) ddi_intr_remove_softint(rxq->rxq_softint);
+			rxq->rxq_softint = NULL;
+		}
+	}
+}
+
 static uint_t
 vioif_tx_handler(caddr_t arg0, caddr_t arg1)
 {
-	vioif_t *vif = (vioif_t *)arg0;
+	vioif_txq_t *txq = (vioif_txq_t *)arg0;
 
 	/*
 	 * The TX interrupt could race with other reclamation activity, so
 	 * interpreting the return value is unimportant.
 	 */
-	(void) vioif_reclaim_used_tx(vif);
+	(void) vioif_reclaim_used_tx(txq);
 
 	return (DDI_INTR_CLAIMED);
 }
 
+/*
+ * Submit a command on the control queue and wait for the device to
+ * acknowledge it.  The control queue has no interrupt handler; commands are
+ * only issued from attach, so we poll for completion.
+ */
+static int
+vioif_ctrl_cmd(vioif_t *vif, uint8_t class, uint8_t cmd, const void *data,
+    size_t datalen)
+{
+	virtio_chain_t *vic = vif->vif_ctrl_chain;
+	struct virtio_net_ctrl_hdr *hdr;
+	uint8_t *ack;
+	uint64_t pa;
+	size_t ackoff = VIOIF_CTRL_SIZE - sizeof (*ack);
+
+	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+	VERIFY3U(sizeof (*hdr) + datalen, <=, ackoff);
+
+	if (vif->vif_ctrl_vq == NULL) {
+		return (ENOTSUP);
+	}
+
+	if (virtio_queue_nactive(vif->vif_ctrl_vq) != 0) {
+		/*
+		 * A previous command was never acknowledged, so the device
+		 * still owns the buffer.
+		 */
+		return (EBUSY);
+	}
+
+	hdr = virtio_dma_va(vif->vif_ctrl_dma, 0);
+	hdr->vnch_class = class;
+	hdr->vnch_command = cmd;
+	bcopy(data, virtio_dma_va(vif->vif_ctrl_dma, sizeof (*hdr)), datalen);
+	ack = virtio_dma_va(vif->vif_ctrl_dma, ackoff);
+	*ack = VIRTIO_NET_CTRL_ERR;
+
+	/*
+	 * Some legacy devices expect the header, the data, and the
+	 * acknowledgement in separate descriptors.
+	 */
+	pa = virtio_dma_cookie_pa(vif->vif_ctrl_dma, 0);
+	virtio_chain_clear(vic);
+	if (virtio_chain_append(vic, pa, sizeof (*hdr),
+	    VIRTIO_DIR_DEVICE_READS) != DDI_SUCCESS ||
+	    virtio_chain_append(vic, pa + sizeof (*hdr), datalen,
+	    VIRTIO_DIR_DEVICE_READS) != DDI_SUCCESS ||
+	    virtio_chain_append(vic, pa + ackoff, sizeof (*ack),
+	    VIRTIO_DIR_DEVICE_WRITES) != DDI_SUCCESS) {
+		return (ENOMEM);
+	}
+
+	virtio_dma_sync(vif->vif_ctrl_dma, DDI_DMA_SYNC_FORDEV);
+	virtio_chain_submit(vic, B_TRUE);
+
+	for (uint_t i = 0; i < 100; i++) {
+		if (virtio_queue_poll(vif->vif_ctrl_vq) != NULL) {
+			virtio_dma_sync(vif->vif_ctrl_dma,
+			    DDI_DMA_SYNC_FORCPU);
+			return (*ack == VIRTIO_NET_CTRL_OK ? 0 : EIO);
+		}
+		delay(drv_usectohz(10000));
+	}
+
+	return (ETIMEDOUT);
+}
+
+static void
+vioif_ctrl_free(vioif_t *vif)
+{
+	if (vif->vif_ctrl_chain != NULL) {
+		/*
+		 * If the device never completed a command, it must be reset
+		 * before the chain can be taken back.
+		 */
+		if (virtio_queue_nactive(vif->vif_ctrl_vq) != 0) {
+			virtio_shutdown(vif->vif_virtio);
+			while (virtio_queue_evacuate(vif->vif_ctrl_vq) !=
+			    NULL) {
+				continue;
+			}
+		}
+		virtio_chain_free(vif->vif_ctrl_chain);
+		vif->vif_ctrl_chain = NULL;
+	}
+
+	if (vif->vif_ctrl_dma != NULL) {
+		virtio_dma_free(vif->vif_ctrl_dma);
+		vif->vif_ctrl_dma = NULL;
+	}
+}
+
+static int
+vioif_ctrl_alloc(vioif_t *vif)
+{
+	if ((vif->vif_ctrl_dma = virtio_dma_alloc(vif->vif_virtio,
+	    VIOIF_CTRL_SIZE, &vioif_dma_attr_ctrl,
+	    DDI_DMA_RDWR | DDI_DMA_CONSISTENT, KM_SLEEP)) == NULL ||
+	    (vif->vif_ctrl_chain = virtio_chain_alloc(vif->vif_ctrl_vq,
+	    KM_SLEEP)) == NULL) {
+		vioif_ctrl_free(vif);
+		return (ENOMEM);
+	}
+
+	return (0);
+}
+
+/*
+ * Ask the device to steer received frames across the first "vif_nqpairs"
+ * queue pairs.  If the device will not, fall back to a single pair.
+ */
+static void
+vioif_set_qpairs(vioif_t *vif)
+{
+	struct virtio_net_ctrl_mq mq;
+	int r;
+
+	VERIFY(MUTEX_HELD(&vif->vif_mutex));
+
+	if (vif->vif_nqpairs == 1) {
+		return;
+	}
+
+	mq.vncm_virtqueue_pairs = vif->vif_nqpairs;
+	if ((r = vioif_ctrl_alloc(vif)) != 0 ||
+	    (r = vioif_ctrl_cmd(vif, VIRTIO_NET_CTRL_MQ,
+	    VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &mq, sizeof (mq))) != 0) {
+		dev_err(vif->vif_dip, CE_WARN, "!could not enable %u queue "
+		    "pairs (%d); using one", vif->vif_nqpairs, r);
+		vif->vif_nqpairs = 1;
+	}
+}
+
 static void
 vioif_check_features(vioif_t *vif)
 {
@@ -1696,6 +2250,54 @@ vioif_select_interrupt_types(void)
 	return (0);
 }
 
+/*
+ * Recover any receive buffers still held in the queue.  This must only be
+ * done once the device has been reset.
+ */
+static void
+vioif_rxq_evacuate(vioif_rxq_t *rxq)
+{
+	virtio_chain_t *vic;
+
+	mutex_enter(&rxq->rxq_mutex);
+	while ((vic = virtio_queue_evacuate(rxq->rxq_vq)) != NULL) {
+		vioif_rxbuf_t *rb = virtio_chain_data(vic);
+		vioif_rxbuf_free(rxq, rb);
+	}
+	mutex_exit(&rxq->rxq_mutex);
+}
+
+/*
+ * Decide how many queue pairs to use, returning the number the device offers
+ * in "maxp".  Multiple queue pairs are only available if the device provides
+ * a control queue through which we can enable them.
+ */
+static uint_t
+vioif_select_qpairs(vioif_t *vif, uint_t *maxp)
+{
+	uint_t max = 1, n;
+
+	if (vioif_has_feature(vif, VIRTIO_NET_F_CTRL_VQ) &&
+	    vioif_has_feature(vif, VIRTIO_NET_F_MQ)) {
+		max = virtio_dev_get16(vif->vif_virtio,
+		    VIRTIO_NET_CONFIG_MAX_VQ_PAIRS);
+		if (max < VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN ||
+		    max > VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX) {
+			dev_err(vif->vif_dip, CE_WARN, "!device reported "
+			    "invalid maximum queue pairs (%u)", max);
+			*maxp = 0;
+			return (1);
+		}
+	}
+	*maxp = max;
+
+	n = MIN(max, VIOIF_MAX_QPAIRS);
+	n = MIN(n, (uint_t)ncpus_online);
+	n = MIN(n, vioif_max_qpairs);
+
+	return (MAX(n, 1));
+}
+
 static int
 vioif_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 {
@@ -1703,6 +2305,8 @@ vioif_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	vioif_t *vif;
 	virtio_t *vio;
 	mac_register_t *macp = NULL;
+	uint_t max_qpairs;
+	boolean_t mutexes = B_FALSE;
 
 	if (cmd != DDI_ATTACH) {
 		return (DDI_FAILURE);
@@ -1719,11 +2323,47 @@ vioif_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	vif->vif_runstate = VIOIF_RUNSTATE_STOPPED;
 	ddi_set_driver_private(dip, vif);
 
-	if ((vif->vif_rx_vq = virtio_queue_alloc(vio, VIRTIO_NET_VIRTQ_RX,
-	    "rx", vioif_rx_handler, vif, B_FALSE, VIOIF_MAX_SEGS)) == NULL ||
-	    (vif->vif_tx_vq = virtio_queue_alloc(vio, VIRTIO_NET_VIRTQ_TX,
-	    "tx", vioif_tx_handler, vif, B_FALSE, VIOIF_MAX_SEGS)) == NULL) {
-		goto fail;
+	vif->vif_qpairs_capacity = vioif_select_qpairs(vif, &max_qpairs);
+	vif->vif_nqpairs = vif->vif_qpairs_capacity;
+	vif->vif_rxqs = kmem_zalloc(sizeof (vioif_rxq_t) *
+	    vif->vif_qpairs_capacity, KM_SLEEP);
+	vif->vif_txqs = kmem_zalloc(sizeof (vioif_txq_t) *
+	    vif->vif_qpairs_capacity, KM_SLEEP);
+
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+
+		rxq->rxq_vioif = vif;
+		rxq->rxq_index = i;
+		(void) snprintf(rxq->rxq_name, sizeof (rxq->rxq_name),
+		    "rx%u", i);
+		txq->txq_vioif = vif;
+		txq->txq_index = i;
+		(void) snprintf(txq->txq_name, sizeof (txq->txq_name),
+		    "tx%u", i);
+
+		if ((rxq->rxq_vq = virtio_queue_alloc(vio,
+		    VIRTIO_NET_VIRTQ_RXN(i), rxq->rxq_name, vioif_rx_handler,
+		    rxq, B_FALSE, VIOIF_MAX_SEGS)) == NULL ||
+		    (txq->txq_vq = virtio_queue_alloc(vio,
+		    VIRTIO_NET_VIRTQ_TXN(i), txq->txq_name, vioif_tx_handler,
+		    txq, B_FALSE, VIOIF_MAX_SEGS)) == NULL) {
+			goto fail;
+		}
+	}
+
+	/*
+	 * The control queue is only needed to enable additional queue pairs.
+	 * It is serviced by polling, so it has no interrupt handler.
+	 */
+	if (vif->vif_qpairs_capacity > 1) {
+		VERIFY3U(max_qpairs, >, 1);
+		if ((vif->vif_ctrl_vq = virtio_queue_alloc(vio,
+		    VIRTIO_NET_VIRTQ_CONTROL_MQ(max_qpairs), "ctrl", NULL,
+		    NULL, B_FALSE, 3)) == NULL) {
+			goto fail;
+		}
 	}
 
 	if (virtio_init_complete(vio, vioif_select_interrupt_types()) !=
@@ -1732,12 +2372,39 @@ vioif_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 		goto fail;
 	}
 
-	virtio_queue_no_interrupt(vif->vif_rx_vq, B_TRUE);
-	virtio_queue_no_interrupt(vif->vif_tx_vq, B_TRUE);
-
 	mutex_init(&vif->vif_mutex, NULL, MUTEX_DRIVER, virtio_intr_pri(vio));
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+
+		mutex_init(&rxq->rxq_mutex, NULL, MUTEX_DRIVER,
+		    virtio_intr_pri(vio));
+		mutex_init(&txq->txq_mutex, NULL, MUTEX_DRIVER,
+		    virtio_intr_pri(vio));
+
+		virtio_queue_no_interrupt(rxq->rxq_vq, B_TRUE);
+		virtio_queue_no_interrupt(txq->txq_vq, B_TRUE);
+	}
+	if (vif->vif_ctrl_vq != NULL) {
+		virtio_queue_no_interrupt(vif->vif_ctrl_vq, B_TRUE);
+	}
+	mutexes = B_TRUE;
+
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+
+		if (ddi_intr_add_softint(dip, &rxq->rxq_softint,
+		    DDI_INTR_SOFTPRI_DEFAULT, vioif_rx_handler,
+		    (caddr_t)rxq) != DDI_SUCCESS) {
+			dev_err(dip, CE_WARN, "failed to add soft interrupt");
+			goto fail;
+		}
+	}
+
 	mutex_enter(&vif->vif_mutex);
 
+	vioif_set_qpairs(vif);
+
 	vioif_get_mac(vif);
 
 	vif->vif_rxcopy_thresh = VIOIF_MACPROP_RXCOPY_THRESH_DEF;
@@ -1795,11 +2462,36 @@ vioif_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	return (DDI_SUCCESS);
 
 fail:
-	vioif_free_bufs(vif);
 	if (macp != NULL) {
 		mac_free(macp);
 	}
+	if (mutexes) {
+		vioif_remove_softints(vif);
+
+		/*
+		 * Reset the device so that any receive buffers already
+		 * submitted can be recovered and freed.
+		 */
+		virtio_shutdown(vio);
+		mutex_enter(&vif->vif_mutex);
+		for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+			vioif_rxq_evacuate(&vif->vif_rxqs[i]);
+		}
+		vioif_ctrl_free(vif);
+		vioif_free_bufs(vif);
+		mutex_exit(&vif->vif_mutex);
+
+		for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+			mutex_destroy(&vif->vif_rxqs[i].rxq_mutex);
+			mutex_destroy(&vif->vif_txqs[i].txq_mutex);
+		}
+		mutex_destroy(&vif->vif_mutex);
+	}
 	(void) virtio_fini(vio, B_TRUE);
+	kmem_free(vif->vif_rxqs, sizeof (vioif_rxq_t) *
+	    vif->vif_qpairs_capacity);
+	kmem_free(vif->vif_txqs, sizeof (vioif_txq_t) *
+	    vif->vif_qpairs_capacity);
 	kmem_free(vif, sizeof (*vif));
 	return (DDI_FAILURE);
 }
@@ -1825,44 +2517,56 @@ vioif_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 		return (DDI_FAILURE);
 	}
 
-	/*
-	 * There should be no outstanding transmit buffers once the NIC is
-	 * completely stopped.
-	 */
-	VERIFY3U(vif->vif_ntxbufs_alloc, ==, 0);
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_rxq_t *rxq = &vif->vif_rxqs[i];
+		vioif_txq_t *txq = &vif->vif_txqs[i];
+		uint_t onloan;
 
-	/*
-	 * Though we cannot claw back all of the receive buffers until we reset
-	 * the device, we must ensure all those loaned to MAC have been
-	 * returned before calling mac_unregister().
-	 */
-	if (vif->vif_nrxbufs_onloan > 0) {
-		dev_err(dip, CE_WARN, "!%u receive buffers still loaned, "
-		    "cannot detach", vif->vif_nrxbufs_onloan);
-		mutex_exit(&vif->vif_mutex);
-		return (DDI_FAILURE);
+		/*
+		 * There should be no outstanding transmit buffers once the
+		 * NIC is completely stopped.
+		 */
+		mutex_enter(&txq->txq_mutex);
+		VERIFY3U(txq->txq_nbufs_alloc, ==, 0);
+		mutex_exit(&txq->txq_mutex);
+
+		/*
+		 * Though we cannot claw back all of the receive buffers until
+		 * we reset the device, we must ensure all those loaned to MAC
+		 * have been returned before calling mac_unregister().
+		 */
+		mutex_enter(&rxq->rxq_mutex);
+		onloan = rxq->rxq_nbufs_onloan;
+		mutex_exit(&rxq->rxq_mutex);
+		if (onloan > 0) {
+			dev_err(dip, CE_WARN, "!%u receive buffers still "
+			    "loaned, cannot detach", onloan);
+			mutex_exit(&vif->vif_mutex);
+			return (DDI_FAILURE);
+		}
 	}
 
 	if ((r = mac_unregister(vif->vif_mac_handle)) != 0) {
 		dev_err(dip, CE_WARN, "!MAC unregister failed (%d)", r);
+		mutex_exit(&vif->vif_mutex);
 		return (DDI_FAILURE);
 	}
 
+	/*
+	 * MAC no longer re-enables ring interrupts, so the soft interrupts
+	 * delivering frames on its behalf can go before the device does.
+	 */
+	vioif_remove_softints(vif);
+
 	/*
 	 * Shut down the device so that we can recover any previously
 	 * submitted receive buffers.
 	 */
 	virtio_shutdown(vif->vif_virtio);
-	for (;;) {
-		virtio_chain_t *vic;
-
-		if ((vic = virtio_queue_evacuate(vif->vif_rx_vq)) == NULL) {
-			break;
-		}
-
-		vioif_rxbuf_t *rb = virtio_chain_data(vic);
-		vioif_rxbuf_free(vif, rb);
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		vioif_rxq_evacuate(&vif->vif_rxqs[i]);
 	}
+	vioif_ctrl_free(vif);
 
 	/*
 	 * vioif_free_bufs() must be called before virtio_fini()
@@ -1873,8 +2577,17 @@ vioif_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 	(void) virtio_fini(vif->vif_virtio, B_FALSE);
 
 	mutex_exit(&vif->vif_mutex);
+
+	for (uint_t i = 0; i < vif->vif_qpairs_capacity; i++) {
+		mutex_destroy(&vif->vif_rxqs[i].rxq_mutex);
+		mutex_destroy(&vif->vif_txqs[i].txq_mutex);
+	}
 	mutex_destroy(&vif->vif_mutex);
 
+	kmem_free(vif->vif_rxqs, sizeof (vioif_rxq_t) *
+	    vif->vif_qpairs_capacity);
+	kmem_free(vif->vif_txqs, sizeof (vioif_txq_t) *
+	    vif->vif_qpairs_capacity);
 	kmem_free(vif, sizeof (*vif));
 
 	return (DDI_SUCCESS);
@@ -47,6 +47,16 @@ extern "C" {
 #define	VIRTIO_NET_VIRTQ_TX		1
 #define	VIRTIO_NET_VIRTQ_CONTROL	2
 
+/*
+ * If VIRTIO_NET_F_MQ is negotiated, the device provides up to
+ * VIRTIO_NET_CONFIG_MAX_VQ_PAIRS receive and transmit queue pairs.  Queue pair
+ * N is made up of the receive queue at index 2N and the transmit queue at
+ * index 2N + 1; the control queue follows the last possible pair.
+ */
+#define	VIRTIO_NET_VIRTQ_RXN(n)		((n) * 2)
+#define	VIRTIO_NET_VIRTQ_TXN(n)		((n) * 2 + 1)
+#define	VIRTIO_NET_VIRTQ_CONTROL_MQ(max)	((max) * 2)
+
 /*
  * VIRTIO NETWORK FEATURE BITS
  */
@@ -155,6 +165,15 @@ extern "C" {
 #define	VIRTIO_NET_F_CTRL_VLAN		(1ULL << 19)
 #define	VIRTIO_NET_F_CTRL_RX_EXTRA	(1ULL << 20)
 
+/*
+ * MQ:
+ *	The device supports more than one receive and transmit queue pair, and
+ *	will steer received frames across the queue pairs in use.  The number
+ *	of pairs to use is set with the VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET
+ *	command, so this feature depends on VIRTIO_NET_F_CTRL_VQ.
+ */
+#define	VIRTIO_NET_F_MQ			(1ULL << 22)
+
 /*
  * These features are supported by the driver and we will request them from the
  * device.  Note that we do not currently request GUEST_CSUM, as the driver
@@ -167,7 +186,9 @@ extern "C" {
 					VIRTIO_NET_F_HOST_TSO6 |	\
 					VIRTIO_NET_F_HOST_ECN |		\
 					VIRTIO_NET_F_MAC |		\
-					VIRTIO_NET_F_MTU)
+					VIRTIO_NET_F_MTU |		\
+					VIRTIO_NET_F_CTRL_VQ |		\
+					VIRTIO_NET_F_MQ)
 
 /*
  * VIRTIO NETWORK HEADER
@@ -201,6 +222,34 @@ struct virtio_net_hdr {
 #define	VIRTIO_NET_HDR_GSO_TCPV6	4
 #define	VIRTIO_NET_HDR_GSO_ECN		0x80
 
+/*
+ * VIRTIO NETWORK CONTROL QUEUE
+ *
+ * Each command submitted on the control queue is made up of this header,
+ * followed by any command-specific data, followed by a single byte written
+ * by the device to acknowledge the command.
+ */
+struct virtio_net_ctrl_hdr {
+	uint8_t				vnch_class;
+	uint8_t				vnch_command;
+} __packed;
+
+#define	VIRTIO_NET_CTRL_OK		0
+#define	VIRTIO_NET_CTRL_ERR		1
+
+/*
+ * VIRTIO NETWORK CONTROL QUEUE: MULTIQUEUE COMMANDS
+ */
+#define	VIRTIO_NET_CTRL_MQ		4
+#define	VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET	0
+
+#define	VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN	1
+#define	VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX	0x8000
+
+struct virtio_net_ctrl_mq {
+	uint16_t			vncm_virtqueue_pairs;
+} __packed;
+
 
 /*
  * DRIVER PARAMETERS
@@ -261,12 +310,27 @@ struct virtio_net_hdr {
  */
 #define	VIOIF_TX_INLINE_SIZE		(2 * 1024)
 
+/*
+ * The maximum number of receive and transmit queue pairs we will use, each of
+ * which is exposed to MAC as a ring.  The number actually used is further
+ * limited by the device, the number of CPUs, and "vioif_max_qpairs".
+ */
+#define	VIOIF_MAX_QPAIRS		16
+
+/*
+ * A single small DMA buffer is used for control queue commands, holding the
+ * command header, the command data, and the acknowledgement byte.
+ */
+#define	VIOIF_CTRL_SIZE			64
+
 
 /*
  * TYPE DEFINITIONS
  */
 
 typedef struct vioif vioif_t;
+typedef struct vioif_rxq vioif_rxq_t;
+typedef struct vioif_txq vioif_txq_t;
 
 /*
  * Receive buffers are allocated in advance as a combination of DMA memory and
@@ -274,13 +338,13 @@ typedef struct vioif vioif_t;
  * to avoid copying, and this object contains the free routine to pass to
  * desballoc().
  *
- * When receive buffers are not in use, they are linked into the per-instance
- * free list, "vif_rxbufs" via "rb_link".  Under normal conditions, we expect
- * the free list to be empty much of the time; most buffers will be in the ring
- * or on loan.
+ * When receive buffers are not in use, they are linked into the per-queue free
+ * list, "rxq_bufs" via "rb_link".  Under normal conditions, we expect the free
+ * list to be empty much of the time; most buffers will be in the ring or on
+ * loan.
  */
 typedef struct vioif_rxbuf {
-	vioif_t				*rb_vioif;
+	vioif_rxq_t			*rb_rxq;
 	frtn_t				rb_frtn;
 
 	virtio_dma_t			*rb_dma;
@@ -294,8 +358,8 @@ typedef struct vioif_rxbuf {
  * the virtio net header, and to hold small packets.  Larger packets are mapped
  * from storage loaned to the driver by the network stack.
  *
- * When transmit buffers are not in use, they are linked into the per-instance
- * free list, "vif_txbufs" via "tb_link".
+ * When transmit buffers are not in use, they are linked into the per-queue
+ * free list, "txq_bufs" via "tb_link".
  */
 typedef struct vioif_txbuf {
 	mblk_t				*tb_mp;
@@ -324,6 +388,92 @@ typedef enum vioif_runstate {
 	VIOIF_RUNSTATE_RUNNING
 } vioif_runstate_t;
 
+/*
+ * Per-queue receive state.  Each receive queue is exposed to MAC as a ring in
+ * the single receive group, and has its own buffers, lock, and statistics so
+ * that queues may be serviced on different CPUs without contention.
+ */
+struct vioif_rxq {
+	vioif_t				*rxq_vioif;
+	uint_t				rxq_index;
+	char				rxq_name[16];
+	virtio_queue_t			*rxq_vq;
+
+	kmutex_t			rxq_mutex;
+
+	/*
+	 * MAC ring state.  While MAC is polling the ring, "rxq_polling" is set
+	 * and the interrupt handler does not deliver frames.  Frames which
+	 * arrive as MAC stops polling are delivered through "rxq_softint".
+	 */
+	mac_ring_handle_t		rxq_ring_handle;
+	uint64_t			rxq_gen_num;
+	boolean_t			rxq_polling;
+	ddi_softint_handle_t		rxq_softint;
+
+	/*
+	 * Receive buffer free list and accounting:
+	 */
+	list_t				rxq_bufs;
+	uint_t				rxq_nbufs_alloc;
+	uint_t				rxq_nbufs_onloan;
+	uint_t				rxq_nbufs_onloan_max;
+	uint_t				rxq_bufs_capacity;
+	vioif_rxbuf_t			*rxq_bufs_mem;
+
+	/*
+	 * Statistics:
+	 */
+	uint64_t			rxq_ipackets;
+	uint64_t			rxq_rbytes;
+	uint64_t			rxq_brdcstrcv;
+	uint64_t			rxq_multircv;
+	uint64_t			rxq_norecvbuf;
+	uint64_t			rxq_ierrors;
+	uint64_t			rxq_rxfail_chain_undersize;
+};
+
+/*
+ * Per-queue transmit state.  Each transmit queue is exposed to MAC as a ring,
+ * and MAC selects a ring for each outbound flow.
+ */
+struct vioif_txq {
+	vioif_t				*txq_vioif;
+	uint_t				txq_index;
+	char				txq_name[16];
+	virtio_queue_t			*txq_vq;
+
+	kmutex_t			txq_mutex;
+
+	mac_ring_handle_t		txq_ring_handle;
+
+	/* TX virtqueue management resources */
+	boolean_t			txq_corked;
+	boolean_t			txq_drain;
+	timeout_id_t			txq_reclaim_tid;
+
+	/*
+	 * Transmit buffer free list and accounting:
+	 */
+	list_t				txq_bufs;
+	uint_t				txq_nbufs_alloc;
+	uint_t				txq_bufs_capacity;
+	vioif_txbuf_t			*txq_bufs_mem;
+
+	/*
+	 * Statistics:
+	 */
+	uint64_t			txq_opackets;
+	uint64_t			txq_obytes;
+	uint64_t			txq_brdcstxmt;
+	uint64_t			txq_multixmt;
+	uint64_t			txq_notxbuf;
+	uint64_t			txq_oerrors;
+	uint64_t			txq_txfail_dma_bind;
+	uint64_t			txq_txfail_indirect_limit;
+	uint64_t			txq_stat_tx_reclaim;
+};
+
 /*
  * Per-instance driver object.
  */
@@ -331,6 +481,11 @@ struct vioif {
 	dev_info_t			*vif_dip;
 	virtio_t			*vif_virtio;
 
+	/*
+	 * This lock protects the run state, the MTU, and the tunables below.
+	 * When more than one lock is needed, it is taken before any of the
+	 * per-queue locks.
+	 */
 	kmutex_t			vif_mutex;
 
 	/*
@@ -343,14 +498,25 @@ struct vioif {
 	vioif_runstate_t		vif_runstate;
 
 	mac_handle_t			vif_mac_handle;
+	mac_group_handle_t		vif_rx_group_handle;
 
-	virtio_queue_t			*vif_rx_vq;
-	virtio_queue_t			*vif_tx_vq;
+	/*
+	 * Receive and transmit queue pairs.  Without VIRTIO_NET_F_MQ there is
+	 * exactly one pair.  If the device refuses to enable all of the pairs
+	 * we allocated, only the first "vif_nqpairs" are used.
+	 */
+	uint_t				vif_nqpairs;
+	uint_t				vif_qpairs_capacity;
+	vioif_rxq_t			*vif_rxqs;
+	vioif_txq_t			*vif_txqs;
 
-	/* TX virtqueue management resources */
-	boolean_t			vif_tx_corked;
-	boolean_t			vif_tx_drain;
-	timeout_id_t			vif_tx_reclaim_tid;
+	/*
+	 * The control queue, if VIRTIO_NET_F_CTRL_VQ was negotiated, and the
+	 * DMA buffer used to issue commands on it.
+	 */
+	virtio_queue_t			*vif_ctrl_vq;
+	virtio_dma_t			*vif_ctrl_dma;
+	virtio_chain_t			*vif_ctrl_chain;
 
 	/*
 	 * Configured offload features:
@@ -370,24 +536,6 @@ struct vioif {
 	uint_t				vif_mtu_max;
 	uint8_t				vif_mac[ETHERADDRL];
 
-	/*
-	 * Receive buffer free list and accounting:
-	 */
-	list_t				vif_rxbufs;
-	uint_t				vif_nrxbufs_alloc;
-	uint_t				vif_nrxbufs_onloan;
-	uint_t				vif_nrxbufs_onloan_max;
-	uint_t				vif_rxbufs_capacity;
-	vioif_rxbuf_t			*vif_rxbufs_mem;
-
-	/*
-	 * Transmit buffer free list and accounting:
-	 */
-	list_t				vif_txbufs;
-	uint_t				vif_ntxbufs_alloc;
-	uint_t				vif_txbufs_capacity;
-	vioif_txbuf_t			*vif_txbufs_mem;
-
 	/*
 	 * These copy size thresholds are exposed as private MAC properties so
 	 * that they can be tuned without rebooting.
@@ -395,35 +543,14 @@ struct vioif {
 	uint_t				vif_rxcopy_thresh;
 	uint_t				vif_txcopy_thresh;
 
-	/*
-	 * Statistics visible through mac:
-	 */
-	uint64_t			vif_ipackets;
-	uint64_t			vif_opackets;
-	uint64_t			vif_rbytes;
-	uint64_t			vif_obytes;
-	uint64_t			vif_brdcstxmt;
-	uint64_t			vif_brdcstrcv;
-	uint64_t			vif_multixmt;
-	uint64_t			vif_multircv;
-	uint64_t			vif_norecvbuf;
-	uint64_t			vif_notxbuf;
-	uint64_t			vif_ierrors;
-	uint64_t			vif_oerrors;
-
 	/*
 	 * Internal debugging statistics:
 	 */
 	uint64_t			vif_rxfail_dma_handle;
 	uint64_t			vif_rxfail_dma_buffer;
 	uint64_t			vif_rxfail_dma_bind;
-	uint64_t			vif_rxfail_chain_undersize;
 	uint64_t			vif_rxfail_no_descriptors;
 	uint64_t			vif_txfail_dma_handle;
-	uint64_t			vif_txfail_dma_bind;
-	uint64_t			vif_txfail_indirect_limit;
-
-	uint64_t			vif_stat_tx_reclaim;
 };
 
 #ifdef __cplusplus
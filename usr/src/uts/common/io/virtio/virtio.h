@@ -50,7 +50,8 @@
  *
  * The framework will additionally negotiate some set of features that are not
  * specific to a device type on behalf of the client driver; e.g., support for
- * indirect descriptors.
+ * indirect descriptors, and the event index mechanism for suppressing
+ * interrupts and notifications.
  *
  * Some features allow the driver to read additional configuration values from
  * the device-specific regions of the device register space.  These can be
@@ -167,6 +168,17 @@
  * virtio_queue_no_interrupt().  Note that this flag is purely advisory, and
  * may not actually stop interrupts from the device in a timely fashion.
  *
+ * If the device supports event indexes, interrupts are moderated further:
+ * while interrupts are enabled, the device will interrupt only once until the
+ * driver has consumed every returned chain; i.e., until virtio_queue_poll()
+ * has returned NULL.  Client drivers should therefore always poll a queue
+ * until it is empty in their interrupt handler.
+ *
+ * Chains returned while interrupts were disabled, or just before they were
+ * enabled again, may not raise an interrupt.  A driver re-enabling interrupts
+ * must therefore check virtio_queue_pending() afterwards, and collect any
+ * chains it reports without waiting for an interrupt.
+ *
  * INTERRUPT MANAGEMENT
  *
  * A mutex used within an interrupt handler must be initialised with the
@@ -303,6 +315,7 @@ virtio_chain_t *virtio_queue_poll(virtio_queue_t *);
 virtio_chain_t *virtio_queue_evacuate(virtio_queue_t *);
 void virtio_queue_flush(virtio_queue_t *);
 void virtio_queue_no_interrupt(virtio_queue_t *, boolean_t);
+boolean_t virtio_queue_pending(virtio_queue_t *);
 uint_t virtio_queue_nactive(virtio_queue_t *);
 uint_t virtio_queue_size(virtio_queue_t *);
 
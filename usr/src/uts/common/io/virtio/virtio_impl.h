@@ -108,6 +108,7 @@ struct virtio_queue {
 
 	boolean_t			viq_shutdown;
 	boolean_t			viq_indirect;
+	boolean_t			viq_event_idx;
 	uint_t				viq_max_segs;
 
 	/*
@@ -140,6 +141,14 @@ struct virtio_queue {
 	uint16_t			viq_device_index;
 	uint16_t			viq_driver_index;
 
+	/*
+	 * When VIRTIO_F_RING_EVENT_IDX has been negotiated, the device ignores
+	 * the NO_INTERRUPT flag.  We track the driver's wish for interrupts
+	 * here instead, and only publish a new "used_event" index while
+	 * interrupts are wanted.
+	 */
+	boolean_t			viq_no_interrupt;
+
 	/*
 	 * Interrupt handler function, or NULL if not provided.
 	 */
@@ -238,6 +247,14 @@ struct virtio_vq_driver {
 
 #define	VIRTQ_AVAIL_F_NO_INTERRUPT	(1 << 0)
 
+/*
+ * If VIRTIO_F_RING_EVENT_IDX is negotiated, the driver-owned ring is followed
+ * by a "used_event" index.  The device will only interrupt once it returns the
+ * chain at this position in the device-owned ring.
+ */
+#define	VIRTQ_USED_EVENT(viq)		((viq)->viq_dma_driver->vqdr_ring[ \
+					    (viq)->viq_size])
+
 /*
  * We use the sizeof operator on this packed struct to calculate the offset of
  * subsequent structs.  Ensure the compiler is not adding any padding to the
@@ -268,6 +285,24 @@ struct virtio_vq_device {
 
 #define	VIRTQ_USED_F_NO_NOTIFY		(1 << 0)
 
+/*
+ * Similarly, the device-owned ring is followed by an "avail_event" index.  The
+ * device only needs a notification once the driver makes available the chain
+ * at this position in the driver-owned ring.
+ */
+#define	VIRTQ_AVAIL_EVENT(viq)		(*(uint16_t *)( \
+					    &(viq)->viq_dma_device->vqde_ring[ \
+					    (viq)->viq_size]))
+
+/*
+ * Determine whether moving an index from "old" to "new" has passed the
+ * requested "event" index, taking into account the wrapping of the 16-bit
+ * index values.  This is the "vring_need_event()" test from the
+ * specification.
+ */
+#define	VIRTQ_NEED_EVENT(event, new, old)	\
+	((uint16_t)((new) - (event) - 1) < (uint16_t)((new) - (old)))
+
 /*
  * BASIC CONFIGURATION
  *
@@ -320,6 +355,7 @@ struct virtio_vq_device {
  * VIRTIO_LEGACY_FEATURES_DRIVER):
  */
 #define	VIRTIO_F_RING_INDIRECT_DESC	(1ULL << 28)
+#define	VIRTIO_F_RING_EVENT_IDX		(1ULL << 29)
 
 /*
  * For devices operating in the legacy mode, virtqueues must be aligned on a
@@ -83,6 +83,13 @@ static void virtio_interrupts_disable_locked(virtio_t *);
 static void virtio_queue_free(virtio_queue_t *);
 static void virtio_device_reset_locked(virtio_t *);
 
+/*
+ * Allow the use of VIRTIO_F_RING_EVENT_IDX, where offered by the device, for
+ * interrupt and notification suppression.  This may be disabled in
+ * /etc/system if a hypervisor is found to mishandle the feature.
+ */
+boolean_t virtio_allow_event_idx = B_TRUE;
+
 /*
  * We use the same device access attributes for BAR mapping and access to the
  * virtqueue memory.
@@ -307,6 +314,9 @@ virtio_init(dev_info_t *dip, uint64_t driver_features, boolean_t allow_indirect)
 	if (allow_indirect) {
 		driver_features |= VIRTIO_F_RING_INDIRECT_DESC;
 	}
+	if (virtio_allow_event_idx) {
+		driver_features |= VIRTIO_F_RING_EVENT_IDX;
+	}
 	vio->vio_features = vio->vio_features_device & driver_features;
 	virtio_put32(vio, VIRTIO_LEGACY_FEATURES_DRIVER, vio->vio_features);
 
@@ -659,6 +669,14 @@ virtio_queue_alloc(virtio_t *vio, uint16_t qidx, const char *name,
 		viq->viq_indirect = B_TRUE;
 	}
 
+	if (virtio_feature_present(vio, VIRTIO_F_RING_EVENT_IDX)) {
+		/*
+		 * The device will use the "used_event" and "avail_event"
+		 * indexes in place of the NO_INTERRUPT and NO_NOTIFY flags.
+		 */
+		viq->viq_event_idx = B_TRUE;
+	}
+
 	/*
 	 * Track descriptor usage in an identifier space.
 	 */
@@ -673,15 +691,20 @@ virtio_queue_alloc(virtio_t *vio, uint16_t qidx, const char *name,
 
 	/*
 	 * For legacy devices, memory for the queue has a strict layout
-	 * determined by the queue size.
+	 * determined by the queue size.  Each ring is followed by a trailing
+	 * event index, which is only used by the device if
+	 * VIRTIO_F_RING_EVENT_IDX is negotiated, but is always part of the
+	 * layout.
 	 */
 	size_t sz_descs = sizeof (virtio_vq_desc_t) * qsz;
 	size_t sz_driver = P2ROUNDUP_TYPED(sz_descs +
 	    sizeof (virtio_vq_driver_t) +
-	    sizeof (uint16_t) * qsz,
+	    sizeof (uint16_t) * qsz +
+	    sizeof (uint16_t),
 	    VIRTIO_PAGE_SIZE, size_t);
 	size_t sz_device = P2ROUNDUP_TYPED(sizeof (virtio_vq_device_t) +
-	    sizeof (virtio_vq_elem_t) * qsz,
+	    sizeof (virtio_vq_elem_t) * qsz +
+	    sizeof (uint16_t),
 	    VIRTIO_PAGE_SIZE, size_t);
 
 	if (virtio_dma_init(vio, &viq->viq_dma, sz_driver + sz_device,
@@ -777,14 +800,54 @@ virtio_queue_no_interrupt(virtio_queue_t *viq, boolean_t stop_interrupts)
 {
 	mutex_enter(&viq->viq_mutex);
 
+	viq->viq_no_interrupt = stop_interrupts;
 	if (stop_interrupts) {
 		viq->viq_dma_driver->vqdr_flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
 	} else {
 		viq->viq_dma_driver->vqdr_flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+		if (viq->viq_event_idx) {
+			/*
+			 * Request an interrupt for the next chain the device
+			 * returns to us.  While interrupts are not wanted we
+			 * simply leave the event index behind, so that the
+			 * device stops interrupting once it has passed it.
+			 */
+			VIRTQ_USED_EVENT(viq) = viq->viq_device_index;
+		}
 	}
 	VIRTQ_DMA_SYNC_FORDEV(viq);
 
+	/*
+	 * Make the update visible before any check the caller then makes with
+	 * virtio_queue_pending() for chains the device returned before it saw
+	 * the update, and so did not interrupt for.
+	 */
+	membar_enter();
+
+	mutex_exit(&viq->viq_mutex);
+}
+
+/*
+ * Report whether the device has returned chains which virtio_queue_poll() has
+ * not yet collected.
+ */
+boolean_t
+virtio_queue_pending(virtio_queue_t *viq)
+{
+	boolean_t pending;
+
+	mutex_enter(&viq->viq_mutex);
+	if (viq->viq_shutdown) {
+		mutex_exit(&viq->viq_mutex);
+		return (B_FALSE);
+	}
+
+	VIRTQ_DMA_SYNC_FORKERNEL(viq);
+	pending = viq->viq_device_index != viq->viq_dma_device->vqde_index;
 	mutex_exit(&viq->viq_mutex);
+
+	return (pending);
 }
 
 static virtio_chain_t *
@@ -842,8 +905,28 @@ virtio_queue_poll(virtio_queue_t *viq)
 		 * If the device index has not changed since the last poll,
 		 * there are no new chains to process.
 		 */
-		mutex_exit(&viq->viq_mutex);
-		return (NULL);
+		if (!viq->viq_event_idx || viq->viq_no_interrupt) {
+			mutex_exit(&viq->viq_mutex);
+			return (NULL);
+		}
+
+		/*
+		 * With event index suppression, the device interrupts only
+		 * once for each update of "used_event".  Now that the driver
+		 * has caught up, ask for an interrupt when the next chain is
+		 * returned.  The device may have returned more chains before
+		 * it could see our update, so we must check again after
+		 * making it visible.
+		 */
+		VIRTQ_USED_EVENT(viq) = viq->viq_device_index;
+		VIRTQ_DMA_SYNC_FORDEV(viq);
+		membar_enter();
+
+		VIRTQ_DMA_SYNC_FORKERNEL(viq);
+		if (viq->viq_device_index == viq->viq_dma_device->vqde_index) {
+			mutex_exit(&viq->viq_mutex);
+			return (NULL);
+		}
 	}
 
 	/*
@@ -1194,6 +1277,7 @@ virtio_queue_flush_locked(virtio_queue_t *viq)
 	 * pointer (vqdr_index).
 	 */
 	membar_producer();
+	uint16_t old_index = viq->viq_dma_driver->vqdr_index;
 	viq->viq_dma_driver->vqdr_index = viq->viq_driver_index;
 	VIRTQ_DMA_SYNC_FORDEV(viq);
 
@@ -1201,8 +1285,24 @@ virtio_queue_flush_locked(virtio_queue_t *viq)
 	 * Determine whether the device expects us to notify it of new
 	 * descriptors.
 	 */
-	VIRTQ_DMA_SYNC_FORKERNEL(viq);
-	if (!(viq->viq_dma_device->vqde_flags & VIRTQ_USED_F_NO_NOTIFY)) {
+	boolean_t notify;
+	if (viq->viq_event_idx) {
+		/*
+		 * The new ring index must be visible to the device before we
+		 * read the event index it has published; otherwise we could
+		 * miss a notification that the device is waiting for.
+		 */
+		membar_enter();
+		VIRTQ_DMA_SYNC_FORKERNEL(viq);
+		notify = VIRTQ_NEED_EVENT(VIRTQ_AVAIL_EVENT(viq),
+		    viq->viq_driver_index, old_index);
+	} else {
+		VIRTQ_DMA_SYNC_FORKERNEL(viq);
+		notify = !(viq->viq_dma_device->vqde_flags &
+		    VIRTQ_USED_F_NO_NOTIFY);
+	}
+
+	if (notify) {
 		virtio_put16(viq->viq_virtio, VIRTIO_LEGACY_QUEUE_NOTIFY,
 		    viq->viq_index);
 	}
@@ -21,6 +21,7 @@
 /*
  * Copyright (c) 1992, 2010, Oracle and/or its affiliates. All rights reserved.
  * Copyright (c) 2016 by Delphix. All rights reserved.
+ * Copyright 2026 Joyent, Inc.
  */
 
 #include <sys/callo.h>
@@ -35,6 +36,7 @@
 #include <sys/debug.h>
 #include <sys/vtrace.h>
 #include <sys/sysmacros.h>
+#include <sys/bitmap.h>
 #include <sys/sdt.h>
 
 int callout_init_done;				/* useful during boot */
@@ -56,6 +58,14 @@ static ulong_t callout_table_mask;		/* mask for the table bits */
 static callout_cache_t *callout_caches;		/* linked list of caches */
 #pragma align 64(callout_table)
 static callout_table_t *callout_table;		/* global callout table array */
+boolean_t callout_wheel_enabled;		/* callout_wheel at boot */
+
+/*
+ * Set callout_wheel in /etc/system to keep callouts of tick resolution or
+ * coarser on a hierarchical timer wheel instead of the expiration heap. See
+ * the timer wheel comment below. It is only looked at during boot.
+ */
+int callout_wheel = 0;
 
 /*
  * We run 'realtime' callouts at PIL 1 (CY_LOW_LEVEL). For 'normal'
@@ -75,6 +85,9 @@ static char *callout_kstat_names[] = {
 	"callout_expirations",
 	"callout_allocations",
 	"callout_cleanups",
+	"callout_wheel_ticks",
+	"callout_wheel_lists_max",
+	"callout_wheel_cascades",
 };
 
 static hrtime_t	callout_heap_process(callout_table_t *, hrtime_t, int);
@@ -967,6 +980,404 @@ callout_heap_process(callout_table_t *ct, hrtime_t delta, int timechange)
 	return (heap->ch_expiration);
 }
 
+/*
+ * Timer wheel.
+ *
+ * With callout_wheel set, a callout list whose resolution is a tick or
+ * coarser is kept on a hierarchical timer wheel rather than in the heap.
+ * This makes inserting and cancelling such callouts O(1), which matters for
+ * the timers (TCP's in particular) that are created and cancelled at high
+ * rates and seldom expire. 1-nanosecond and other sub-tick resolution
+ * callout lists stay in the heap, which expires them exactly.
+ *
+ * The wheel counts time in wheel ticks of cw_res nanoseconds, and a callout
+ * list belongs to the wheel tick at or after its expiration. A list due
+ * fewer than CALLOUT_WHEEL_SLOTS ticks after the first tick that has yet to
+ * be processed goes into a slot of level 0, indexed by its wheel tick. One
+ * due further out goes into the lowest level L whose span covers it, in the
+ * slot indexed by its wheel tick divided by CALLOUT_WHEEL_SLOTS^L. When the
+ * wheel reaches the tick at which such a slot's span begins, the slot is
+ * cascaded: its lists are placed again, this time in lower levels. Lists
+ * beyond the span of the last level are kept in an overflow list, which is
+ * rescanned whenever the last level's current slot changes.
+ *
+ * Rather than run on every clock tick, the wheel has its own cyclic,
+ * ct_wcyclic, which is programmed to the next tick at which a slot must be
+ * expired or cascaded. The occupancy bitmaps of the levels make finding that
+ * tick cheap, and when the cyclic fires, the wheel is advanced from event to
+ * event up to the current time.
+ *
+ * Callouts created with CALLOUT_FLAG_SLACK declare how late they may run.
+ * For these, the expiration is rounded up to the coarsest power-of-two
+ * multiple of the wheel tick within that tolerance. Since these boundaries
+ * nest, callouts with different tolerances still coalesce into the same
+ * callout lists, and far fewer lists need to be placed and expired.
+ *
+ * An emptied callout list is removed from the wheel and freed right away,
+ * so the wheel never needs reaping.
+ */
+
+/*
+ * Return the wheel tick to which an expiration belongs.
+ */
+static hrtime_t
+callout_wheel_tick(callout_wheel_t *cw, hrtime_t expiration)
+{
+	hrtime_t tick;
+
+	tick = expiration / cw->cw_res;
+	if (tick * cw->cw_res < expiration)
+		tick++;
+
+	return (tick);
+}
+
+/*
+ * Place a callout list in the wheel, where base is the first wheel tick that
+ * has not been expired yet. Return the wheel tick at which the wheel must
+ * next be processed on account of this list.
+ */
+static hrtime_t
+callout_wheel_add(callout_wheel_t *cw, callout_list_t *cl, hrtime_t base)
+{
+	callout_hash_t *slot;
+	hrtime_t tick, delta;
+	int level, shift, idx;
+
+	tick = callout_wheel_tick(cw, cl->cl_expiration);
+	if (tick < base)
+		tick = base;
+	delta = tick - base;
+
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+		if ((delta >> ((level + 1) * CALLOUT_WHEEL_SHIFT)) == 0)
+			break;
+	}
+
+	if (level == CALLOUT_WHEEL_LEVELS) {
+		CALLOUT_HASH_APPEND(cw->cw_overflow, cl, cl_wnext, cl_wprev);
+		cl->cl_wslot = &cw->cw_overflow;
+		shift = (CALLOUT_WHEEL_LEVELS - 1) * CALLOUT_WHEEL_SHIFT;
+		return (((base >> shift) + 1) << shift);
+	}
+
+	shift = level * CALLOUT_WHEEL_SHIFT;
+	idx = (tick >> shift) & CALLOUT_WHEEL_MASK;
+	slot = &cw->cw_slots[level][idx];
+	CALLOUT_HASH_APPEND(*slot, cl, cl_wnext, cl_wprev);
+	cl->cl_wslot = slot;
+	cw->cw_map[level] |= (1ULL << idx);
+
+	return ((tick >> shift) << shift);
+}
+
+/*
+ * Remove a callout list from the wheel.
+ */
+static void
+callout_wheel_remove(callout_wheel_t *cw, callout_list_t *cl)
+{
+	callout_hash_t *slot;
+	int idx;
+
+	slot = cl->cl_wslot;
+	CALLOUT_HASH_DELETE(*slot, cl, cl_wnext, cl_wprev);
+	cl->cl_wslot = NULL;
+
+	if ((slot->ch_head == NULL) && (slot != &cw->cw_overflow)) {
+		idx = slot - &cw->cw_slots[0][0];
+		cw->cw_map[idx >> CALLOUT_WHEEL_SHIFT] &=
+		    ~(1ULL << (idx & CALLOUT_WHEEL_MASK));
+	}
+}
+
+/*
+ * Return the next wheel tick, after the last one processed, at which a slot
+ * must be expired or cascaded, or CY_INFINITY if the wheel is empty.
+ */
+static hrtime_t
+callout_wheel_next(callout_wheel_t *cw)
+{
+	hrtime_t next, unit, tick;
+	uint64_t map;
+	int level, shift, idx;
+
+	next = CY_INFINITY;
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+		if ((map = cw->cw_map[level]) == 0)
+			continue;
+
+		/*
+		 * Rotate the bitmap so that bit 0 is the slot for the next
+		 * span of this level, and find the first occupied slot.
+		 */
+		shift = level * CALLOUT_WHEEL_SHIFT;
+		unit = (cw->cw_now >> shift) + 1;
+		idx = unit & CALLOUT_WHEEL_MASK;
+		map = (map >> idx) | (map << ((CALLOUT_WHEEL_SLOTS - idx) &
+		    CALLOUT_WHEEL_MASK));
+		tick = (unit + lowbit(map) - 1) << shift;
+		if (tick < next)
+			next = tick;
+	}
+
+	if (cw->cw_overflow.ch_head != NULL) {
+		shift = (CALLOUT_WHEEL_LEVELS - 1) * CALLOUT_WHEEL_SHIFT;
+		tick = ((cw->cw_now >> shift) + 1) << shift;
+		if (tick < next)
+			next = tick;
+	}
+
+	return (next);
+}
+
+/*
+ * Place again all the callout lists in a slot, relative to wheel tick base.
+ */
+static void
+callout_wheel_cascade(callout_table_t *ct, callout_hash_t *slot,
+    hrtime_t base)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	callout_hash_t temp;
+	callout_list_t *cl;
+
+	temp = *slot;
+	slot->ch_head = NULL;
+	slot->ch_tail = NULL;
+
+	while ((cl = temp.ch_head) != NULL) {
+		CALLOUT_HASH_DELETE(temp, cl, cl_wnext, cl_wprev);
+		(void) callout_wheel_add(cw, cl, base);
+		ct->ct_wheel_cascades++;
+	}
+}
+
+/*
+ * Process the wheel up to and including wheel tick target, cascading slots
+ * and moving callout lists that are due to the expired list.
+ */
+static void
+callout_wheel_advance(callout_table_t *ct, hrtime_t target)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	callout_hash_t *slot;
+	callout_list_t *cl;
+	hrtime_t tick;
+	int level, shift, idx, hash;
+	uint64_t nlists;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	while ((tick = callout_wheel_next(cw)) <= target) {
+		/*
+		 * Cascade the current slot of every level whose span begins
+		 * at this tick. At the start of a span of the last level,
+		 * also look at the overflow list.
+		 */
+		for (level = 1; level < CALLOUT_WHEEL_LEVELS; level++) {
+			shift = level * CALLOUT_WHEEL_SHIFT;
+			if ((tick & ((1LL << shift) - 1)) != 0)
+				break;
+
+			idx = (tick >> shift) & CALLOUT_WHEEL_MASK;
+			if (cw->cw_map[level] & (1ULL << idx)) {
+				cw->cw_map[level] &= ~(1ULL << idx);
+				callout_wheel_cascade(ct,
+				    &cw->cw_slots[level][idx], tick);
+			}
+			if (level == CALLOUT_WHEEL_LEVELS - 1) {
+				callout_wheel_cascade(ct, &cw->cw_overflow,
+				    tick);
+			}
+		}
+
+		/*
+		 * Everything left in the level 0 slot for this tick is due.
+		 */
+		idx = tick & CALLOUT_WHEEL_MASK;
+		slot = &cw->cw_slots[0][idx];
+		nlists = 0;
+		while ((cl = slot->ch_head) != NULL) {
+			ASSERT(callout_wheel_tick(cw, cl->cl_expiration) <=
+			    tick);
+			CALLOUT_HASH_DELETE(*slot, cl, cl_wnext, cl_wprev);
+			cl->cl_wslot = NULL;
+			cl->cl_flags &= ~CALLOUT_LIST_FLAG_WHEELED;
+			hash = CALLOUT_CLHASH(cl->cl_expiration);
+			CALLOUT_LIST_DELETE(ct->ct_clhash[hash], cl);
+			CALLOUT_LIST_APPEND(ct->ct_expired, cl);
+			nlists++;
+		}
+		cw->cw_map[0] &= ~(1ULL << idx);
+		cw->cw_now = tick;
+
+		if (nlists != 0) {
+			ct->ct_wheel_ticks++;
+			if (nlists > ct->ct_wheel_lists_max)
+				ct->ct_wheel_lists_max = nlists;
+		}
+	}
+
+	if (target > cw->cw_now)
+		cw->cw_now = target;
+}
+
+/*
+ * Initialize a callout table's timer wheel.
+ */
+static void
+callout_wheel_init(callout_table_t *ct)
+{
+	callout_wheel_t *cw;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+	ASSERT(ct->ct_wheel == NULL);
+
+	cw = kmem_zalloc(sizeof (callout_wheel_t), KM_SLEEP);
+	cw->cw_res = nsec_per_tick;
+	cw->cw_now = gethrtime() / cw->cw_res;
+	cw->cw_next = CY_INFINITY;
+	ct->ct_wheel = cw;
+}
+
+/*
+ * Insert a new callout list into a callout table's wheel, and reprogram the
+ * wheel cyclic if it now has to go off earlier.
+ */
+static void
+callout_wheel_insert(callout_table_t *ct, callout_list_t *cl)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	hrtime_t expiration;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	cl->cl_flags |= CALLOUT_LIST_FLAG_WHEELED;
+	expiration = callout_wheel_add(cw, cl, cw->cw_now + 1) * cw->cw_res;
+
+	/*
+	 * As with the heap, do not reprogram the cyclic during the CPR
+	 * suspend phase. It is reprogrammed on resume.
+	 */
+	if ((expiration < cw->cw_next) && (ct->ct_suspend == 0)) {
+		cw->cw_next = expiration;
+		(void) cyclic_reprogram(ct->ct_wcyclic, expiration);
+	}
+}
+
+/*
+ * Delete and handle all past expirations in a callout table's wheel.
+ */
+static hrtime_t
+callout_wheel_delete(callout_table_t *ct)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	hrtime_t next;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	callout_wheel_advance(ct, gethrtime() / cw->cw_res);
+
+	next = callout_wheel_next(cw);
+	if ((next == CY_INFINITY) || (ct->ct_suspend > 0)) {
+		cw->cw_next = CY_INFINITY;
+		return (CY_INFINITY);
+	}
+
+	cw->cw_next = next * cw->cw_res;
+	(void) cyclic_reprogram(ct->ct_wcyclic, cw->cw_next);
+
+	return (cw->cw_next);
+}
+
+/*
+ * The timer wheel counterpart of callout_heap_process(), for the KMDB/OBP
+ * and system time change cases. Every callout list is taken off the wheel,
+ * then expired or adjusted as necessary and placed back.
+ */
+static hrtime_t
+callout_wheel_process(callout_table_t *ct, hrtime_t delta, int timechange)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	callout_list_t *cl;
+	callout_hash_t temp;
+	hrtime_t expiration, now, next;
+	int level, idx, hash, clflags;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	if (cw == NULL)
+		return (CY_INFINITY);
+
+	temp.ch_head = NULL;
+	temp.ch_tail = NULL;
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+		for (idx = 0; idx < CALLOUT_WHEEL_SLOTS; idx++) {
+			while ((cl = cw->cw_slots[level][idx].ch_head) !=
+			    NULL) {
+				callout_wheel_remove(cw, cl);
+				CALLOUT_HASH_APPEND(temp, cl, cl_wnext,
+				    cl_wprev);
+			}
+		}
+	}
+	while ((cl = cw->cw_overflow.ch_head) != NULL) {
+		callout_wheel_remove(cw, cl);
+		CALLOUT_HASH_APPEND(temp, cl, cl_wnext, cl_wprev);
+	}
+
+	clflags = (CALLOUT_LIST_FLAG_HRESTIME | CALLOUT_LIST_FLAG_ABSOLUTE);
+	now = gethrtime();
+	cw->cw_now = now / cw->cw_res;
+	while ((cl = temp.ch_head) != NULL) {
+		CALLOUT_HASH_DELETE(temp, cl, cl_wnext, cl_wprev);
+		hash = CALLOUT_CLHASH(cl->cl_expiration);
+
+		/*
+		 * Expire the callout list if it is due, or if it is an
+		 * absolute hrestime one and system time has changed.
+		 */
+		if ((cl->cl_expiration <= now) ||
+		    (timechange && ((cl->cl_flags & clflags) == clflags))) {
+			cl->cl_flags &= ~CALLOUT_LIST_FLAG_WHEELED;
+			CALLOUT_LIST_DELETE(ct->ct_clhash[hash], cl);
+			CALLOUT_LIST_APPEND(ct->ct_expired, cl);
+			continue;
+		}
+
+		/*
+		 * Adjust relative callout lists for the time spent in
+		 * KMDB/OBP, as callout_heap_process() does.
+		 */
+		if (delta && !(cl->cl_flags & CALLOUT_LIST_FLAG_ABSOLUTE)) {
+			CALLOUT_LIST_DELETE(ct->ct_clhash[hash], cl);
+			expiration = cl->cl_expiration + delta;
+			if (expiration <= 0)
+				expiration = CY_INFINITY;
+			cl->cl_expiration = expiration;
+			hash = CALLOUT_CLHASH(cl->cl_expiration);
+			CALLOUT_LIST_INSERT(ct->ct_clhash[hash], cl);
+		}
+
+		(void) callout_wheel_add(cw, cl, cw->cw_now + 1);
+	}
+
+	/*
+	 * As for the heap, the cyclic must go off immediately if there are
+	 * expired callouts.
+	 */
+	if (ct->ct_expired.ch_head != NULL) {
+		cw->cw_next = gethrtime();
+	} else if ((next = callout_wheel_next(cw)) == CY_INFINITY) {
+		cw->cw_next = CY_INFINITY;
+	} else {
+		cw->cw_next = next * cw->cw_res;
+	}
+
+	return (cw->cw_next);
+}
+
 /*
  * Common function used to create normal and realtime callouts.
  *
@@ -1051,6 +1462,24 @@ timeout_generic(int type, void (*func)(void *), void *arg,
 		expiration += now;
 	}
 
+	if (flags & CALLOUT_FLAG_SLACK) {
+		/*
+		 * The resolution is the caller's tolerance. On the timer
+		 * wheel, align to the coarsest power-of-two multiple of the
+		 * wheel tick that stays within it, so that callouts with
+		 * different tolerances share boundaries and callout lists.
+		 */
+		if ((ct->ct_wheel != NULL) &&
+		    (resolution >= ct->ct_wheel->cw_res)) {
+			hrtime_t slack = resolution;
+
+			resolution = ct->ct_wheel->cw_res;
+			while (resolution <= (slack >> 1))
+				resolution <<= 1;
+		}
+		flags |= CALLOUT_FLAG_ROUNDUP;
+	}
+
 	if (resolution > 1) {
 		/*
 		 * Align expiration to the specified resolution.
@@ -1128,6 +1557,17 @@ again:
 		cl->cl_expiration = expiration;
 		cl->cl_flags = clflags;
 
+		/*
+		 * If this table has a timer wheel and the resolution is no
+		 * finer than the wheel's, the callout list goes there.
+		 */
+		if ((ct->ct_wheel != NULL) &&
+		    (resolution >= ct->ct_wheel->cw_res)) {
+			CALLOUT_LIST_INSERT(ct->ct_clhash[hash], cl);
+			callout_wheel_insert(ct, cl);
+			goto out;
+		}
+
 		/*
 		 * Check if we have enough space in the heap to insert one
 		 * expiration. If not, expand the heap.
@@ -1323,10 +1763,12 @@ untimeout_generic(callout_id_t id, int nowait)
 			ct->ct_timeouts_pending--;
 
 			/*
-			 * If the callout list has become empty, there are 3
+			 * If the callout list has become empty, there are 4
 			 * possibilities. If it is present:
 			 *	- in the heap, it needs to be cleaned along
 			 *	  with its heap entry. Increment a reap count.
+			 *	- in the timer wheel, remove it from its slot
+			 *	  and the hash table, and free it.
 			 *	- in the callout queue, free it.
 			 *	- in the expired list, free it.
 			 */
@@ -1334,6 +1776,12 @@ untimeout_generic(callout_id_t id, int nowait)
 				flags = cl->cl_flags;
 				if (flags & CALLOUT_LIST_FLAG_HEAPED) {
 					ct->ct_nreap++;
+				} else if (flags & CALLOUT_LIST_FLAG_WHEELED) {
+					callout_wheel_remove(ct->ct_wheel, cl);
+					hash = CALLOUT_CLHASH(expiration);
+					CALLOUT_LIST_DELETE(ct->ct_clhash[hash],
+					    cl);
+					CALLOUT_LIST_FREE(ct, cl);
 				} else if (flags & CALLOUT_LIST_FLAG_QUEUED) {
 					CALLOUT_LIST_DELETE(ct->ct_queue, cl);
 					CALLOUT_LIST_FREE(ct, cl);
@@ -1573,6 +2021,15 @@ callout_queue_realtime(callout_table_t *ct)
 	mutex_exit(&ct->ct_mutex);
 }
 
+void
+callout_wheel_realtime(callout_table_t *ct)
+{
+	mutex_enter(&ct->ct_mutex);
+	(void) callout_wheel_delete(ct);
+	callout_expire(ct);
+	mutex_exit(&ct->ct_mutex);
+}
+
 void
 callout_execute(callout_table_t *ct)
 {
@@ -1620,6 +2077,24 @@ callout_queue_normal(callout_table_t *ct)
 	}
 }
 
+void
+callout_wheel_normal(callout_table_t *ct)
+{
+	int i, exec;
+	hrtime_t exp;
+
+	mutex_enter(&ct->ct_mutex);
+	exp = callout_wheel_delete(ct);
+	CALLOUT_EXEC_COMPUTE(ct, exp, exec);
+	mutex_exit(&ct->ct_mutex);
+
+	for (i = 0; i < exec; i++) {
+		ASSERT(ct->ct_taskq != NULL);
+		(void) taskq_dispatch(ct->ct_taskq,
+		    (task_func_t *)callout_execute, ct, TQ_NOSLEEP);
+	}
+}
+
 /*
  * Suspend callout processing.
  */
@@ -1652,6 +2127,10 @@ callout_suspend(void)
 				    CY_INFINITY);
 				(void) cyclic_reprogram(ct->ct_qcyclic,
 				    CY_INFINITY);
+				if (ct->ct_wcyclic != CYCLIC_NONE) {
+					(void) cyclic_reprogram(ct->ct_wcyclic,
+					    CY_INFINITY);
+				}
 			}
 			mutex_exit(&ct->ct_mutex);
 		}
@@ -1664,7 +2143,7 @@ callout_suspend(void)
 static void
 callout_resume(hrtime_t delta, int timechange)
 {
-	hrtime_t hexp, qexp;
+	hrtime_t hexp, qexp, wexp;
 	int t, f;
 	callout_table_t *ct;
 
@@ -1693,11 +2172,16 @@ callout_resume(hrtime_t delta, int timechange)
 			 */
 			hexp = callout_heap_process(ct, delta, timechange);
 			qexp = callout_queue_process(ct, delta, timechange);
+			wexp = callout_wheel_process(ct, delta, timechange);
 
 			ct->ct_suspend--;
 			if (ct->ct_suspend == 0) {
 				(void) cyclic_reprogram(ct->ct_cyclic, hexp);
 				(void) cyclic_reprogram(ct->ct_qcyclic, qexp);
+				if (ct->ct_wcyclic != CYCLIC_NONE) {
+					(void) cyclic_reprogram(ct->ct_wcyclic,
+					    wexp);
+				}
 			}
 
 			mutex_exit(&ct->ct_mutex);
@@ -1758,7 +2242,7 @@ callout_debug_callb(void *arg, int code)
 static void
 callout_hrestime_one(callout_table_t *ct)
 {
-	hrtime_t hexp, qexp;
+	hrtime_t hexp, qexp, wexp;
 
 	mutex_enter(&ct->ct_mutex);
 	if (ct->ct_cyclic == CYCLIC_NONE) {
@@ -1771,10 +2255,13 @@ callout_hrestime_one(callout_table_t *ct)
 	 */
 	hexp = callout_heap_process(ct, 0, 1);
 	qexp = callout_queue_process(ct, 0, 1);
+	wexp = callout_wheel_process(ct, 0, 1);
 
 	if (ct->ct_suspend == 0) {
 		(void) cyclic_reprogram(ct->ct_cyclic, hexp);
 		(void) cyclic_reprogram(ct->ct_qcyclic, qexp);
+		if (ct->ct_wcyclic != CYCLIC_NONE)
+			(void) cyclic_reprogram(ct->ct_wcyclic, wexp);
 	}
 
 	mutex_exit(&ct->ct_mutex);
@@ -1860,7 +2347,7 @@ callout_cyclic_init(callout_table_t *ct)
 	cyc_time_t when;
 	processorid_t seqid;
 	int t;
-	cyclic_id_t cyclic, qcyclic;
+	cyclic_id_t cyclic, qcyclic, wcyclic;
 
 	ASSERT(MUTEX_HELD(&ct->ct_mutex));
 
@@ -1941,9 +2428,23 @@ callout_cyclic_init(callout_table_t *ct)
 
 	qcyclic = cyclic_add(&hdlr, &when);
 
+	/*
+	 * The timer wheel, if there is one, gets a cyclic of its own.
+	 */
+	wcyclic = CYCLIC_NONE;
+	if (ct->ct_wheel != NULL) {
+		if (t == CALLOUT_REALTIME)
+			hdlr.cyh_func = (cyc_func_t)callout_wheel_realtime;
+		else
+			hdlr.cyh_func = (cyc_func_t)callout_wheel_normal;
+
+		wcyclic = cyclic_add(&hdlr, &when);
+	}
+
 	mutex_enter(&ct->ct_mutex);
 	ct->ct_cyclic = cyclic;
 	ct->ct_qcyclic = qcyclic;
+	ct->ct_wcyclic = wcyclic;
 }
 
 void
@@ -2007,6 +2508,8 @@ callout_cpu_online(cpu_t *cp)
 		 */
 		if (ct->ct_heap == NULL) {
 			callout_heap_init(ct);
+			if (callout_wheel_enabled)
+				callout_wheel_init(ct);
 			callout_hash_init(ct);
 			callout_kstat_init(ct);
 			callout_cyclic_init(ct);
@@ -2019,6 +2522,8 @@ callout_cpu_online(cpu_t *cp)
 		 */
 		cyclic_bind(ct->ct_cyclic, cp, NULL);
 		cyclic_bind(ct->ct_qcyclic, cp, NULL);
+		if (ct->ct_wcyclic != CYCLIC_NONE)
+			cyclic_bind(ct->ct_wcyclic, cp, NULL);
 	}
 }
 
@@ -2042,6 +2547,8 @@ callout_cpu_offline(cpu_t *cp)
 		 */
 		cyclic_bind(ct->ct_cyclic, NULL, NULL);
 		cyclic_bind(ct->ct_qcyclic, NULL, NULL);
+		if (ct->ct_wcyclic != CYCLIC_NONE)
+			cyclic_bind(ct->ct_wcyclic, NULL, NULL);
 	}
 }
 
@@ -2115,6 +2622,7 @@ callout_init(void)
 		callout_chunk = CALLOUT_CHUNK;
 	else
 		callout_chunk = P2ROUNDUP(callout_chunk, CALLOUT_CHUNK);
+	callout_wheel_enabled = (callout_wheel != 0);
 
 	/*
 	 * Allocate all the callout tables based on max_ncpus. We have chosen
@@ -2169,6 +2677,7 @@ callout_init(void)
 			 */
 			ct->ct_cyclic = CYCLIC_NONE;
 			ct->ct_qcyclic = CYCLIC_NONE;
+			ct->ct_wcyclic = CYCLIC_NONE;
 			ct->ct_kstat_data = kmem_zalloc(size, KM_SLEEP);
 		}
 	}
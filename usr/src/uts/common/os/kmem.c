@@ -842,6 +842,7 @@
 #include <sys/id32.h>
 #include <sys/zone.h>
 #include <sys/netstack.h>
+#include <sys/lgrp.h>
 #ifdef	DEBUG
 #include <sys/random.h>
 #endif
@@ -890,6 +891,7 @@ struct kmem_cache_kstat {
 	kstat_named_t	kmc_move_hunt_found; /* ... but found in mag layer */
 	kstat_named_t	kmc_move_slabs_freed; /* slabs freed by consolidator */
 	kstat_named_t	kmc_move_reclaimable; /* buffers, if consolidator ran */
+	kstat_named_t	kmc_slab_alloc_remote; /* from another lgroup's slabs */
 } kmem_cache_kstat = {
 	{ "buf_size",		KSTAT_DATA_UINT64 },
 	{ "align",		KSTAT_DATA_UINT64 },
@@ -929,6 +931,7 @@ struct kmem_cache_kstat {
 	{ "move_hunt_found",	KSTAT_DATA_UINT64 },
 	{ "move_slabs_freed",	KSTAT_DATA_UINT64 },
 	{ "move_reclaimable",	KSTAT_DATA_UINT64 },
+	{ "slab_alloc_remote",	KSTAT_DATA_UINT64 },
 };
 
 static kmutex_t kmem_cache_kstat_lock;
@@ -1005,6 +1008,7 @@ static uint32_t kmem_reaping_idspace;
  */
 clock_t kmem_reap_interval;	/* cache reaping rate [15 * HZ ticks] */
 int kmem_depot_contention = 3;	/* max failed tryenters per real interval */
+int kmem_lgrp_local = 1;	/* per-lgroup depots and partial slab lists */
 pgcnt_t kmem_reapahead = 0;	/* start reaping N pages before pageout */
 int kmem_panic = 1;		/* whether to panic on error */
 int kmem_logging = 1;		/* kmem_log_enter() override */
@@ -1063,6 +1067,7 @@ static vmem_t		*kmem_firewall_va_arena;
 static vmem_t		*kmem_firewall_arena;
 
 static int		kmem_zerosized;		/* # of zero-sized allocs */
+static int		kmem_ndepots = 1;	/* depots (lgroups) per cache */
 
 /*
  * kmem slab consolidator thresholds (tunables)
@@ -1492,6 +1497,62 @@ kmem_log_event(kmem_log_header_t *lp, kmem_cache_t *cp,
 	KMEM_AUDIT(lp, cp, &bca);
 }
 
+/*
+ * Return the ID of the lgroup of the given load, or 0 if it is beyond the
+ * range of lgroups for which cp has depots (or there is no load yet, early in
+ * boot).  The caller must keep the load from going away.
+ */
+static int
+kmem_lpl_lgrp(kmem_cache_t *cp, lpl_t *lpl)
+{
+	if (lpl == NULL || lpl->lpl_lgrpid < 0 ||
+	    lpl->lpl_lgrpid >= cp->cache_ndepots)
+		return (0);
+
+	return ((int)lpl->lpl_lgrpid);
+}
+
+/*
+ * Return the depot of the lgroup of the CPU that owns ccp.  A CPU cache only
+ * ever exchanges magazines with the depot of its own lgroup.  The caller may
+ * have migrated since it looked up ccp, so the current CPU will not do.
+ */
+static kmem_depot_t *
+kmem_cpu_depot(kmem_cache_t *cp, kmem_cpu_cache_t *ccp)
+{
+	int lgrp = 0;
+	cpu_t *cpu;
+
+	if (cp->cache_ndepots > 1) {
+		kpreempt_disable();
+		cpu = cpu_seq[ccp - cp->cache_cpu];
+		if (cpu != NULL)
+			lgrp = kmem_lpl_lgrp(cp, cpu->cpu_lpl);
+		kpreempt_enable();
+	}
+
+	return (&cp->cache_depot[lgrp]);
+}
+
+/*
+ * Return the lgroup in which memory for a new slab is placed on behalf of the
+ * current thread.  This is its home lgroup: lgrp_mem_choose() places kernel
+ * heap pages there by default.
+ */
+static int
+kmem_home_lgrp(kmem_cache_t *cp)
+{
+	int lgrp = 0;
+
+	if (cp->cache_ndepots > 1) {
+		kpreempt_disable();
+		lgrp = kmem_lpl_lgrp(cp, curthread->t_lpl);
+		kpreempt_enable();
+	}
+
+	return (lgrp);
+}
+
 /*
  * Create a new slab for cache cp.
  */
@@ -1548,6 +1609,7 @@ kmem_slab_create(kmem_cache_t *cp, int kmflag)
 	sp->slab_stuck_offset = (uint32_t)-1;
 	sp->slab_later_count = 0;
 	sp->slab_flags = 0;
+	sp->slab_lgrp = (uint8_t)kmem_home_lgrp(cp);
 
 	ASSERT(chunks > 0);
 	while (chunks-- != 0) {
@@ -1628,6 +1690,38 @@ kmem_slab_destroy(kmem_cache_t *cp, kmem_slab_t *sp)
 	vmem_free(vmp, slab, cp->cache_slabsize);
 }
 
+/*
+ * Return the first partial slab homed in the given lgroup, which is the one
+ * to allocate from there, or NULL if the lgroup has no partial slabs.  The
+ * partial slabs are sorted by lgroup first (see kmem_partial_slab_cmp()), so
+ * this is the slab following a key that sorts before all others in the
+ * lgroup.
+ */
+static kmem_slab_t *
+kmem_partial_slab_first(kmem_cache_t *cp, int lgrp)
+{
+	kmem_slab_t key, *sp;
+	avl_index_t where;
+
+	ASSERT(MUTEX_HELD(&cp->cache_lock));
+
+	if (cp->cache_ndepots == 1)
+		return (avl_first(&cp->cache_partial_slabs));
+
+	key.slab_cache = cp;
+	key.slab_refcnt = 1;
+	key.slab_chunks = 2;
+	key.slab_flags = KMEM_SLAB_KEY;
+	key.slab_lgrp = (uint8_t)lgrp;
+
+	VERIFY(avl_find(&cp->cache_partial_slabs, &key, &where) == NULL);
+	sp = avl_nearest(&cp->cache_partial_slabs, where, AVL_AFTER);
+	if (sp == NULL || sp->slab_lgrp != lgrp)
+		return (NULL);
+
+	return (sp);
+}
+
 static void *
 kmem_slab_alloc_impl(kmem_cache_t *cp, kmem_slab_t *sp, boolean_t prefill)
 {
@@ -1642,7 +1736,7 @@ kmem_slab_alloc_impl(kmem_cache_t *cp, kmem_slab_t *sp, boolean_t prefill)
 	 * slab is newly created.
 	 */
 	ASSERT(new_slab || (KMEM_SLAB_IS_PARTIAL(sp) &&
-	    (sp == avl_first(&cp->cache_partial_slabs))));
+	    (sp == kmem_partial_slab_first(cp, sp->slab_lgrp))));
 	ASSERT(sp->slab_cache == cp);
 
 	cp->cache_slab_alloc++;
@@ -1711,7 +1805,9 @@ kmem_slab_alloc_impl(kmem_cache_t *cp, kmem_slab_t *sp, boolean_t prefill)
 }
 
 /*
- * Allocate a raw (unconstructed) buffer from cp's slab layer.
+ * Allocate a raw (unconstructed) buffer from cp's slab layer.  We allocate
+ * from the current thread's home lgroup if we can, even if that means
+ * creating a new slab while there are partial slabs in other lgroups.
  */
 static void *
 kmem_slab_alloc(kmem_cache_t *cp, int kmflag)
@@ -1719,27 +1815,39 @@ kmem_slab_alloc(kmem_cache_t *cp, int kmflag)
 	kmem_slab_t *sp;
 	void *buf;
 	boolean_t test_destructor;
+	int lgrp = kmem_home_lgrp(cp);
 
 	mutex_enter(&cp->cache_lock);
 	test_destructor = (cp->cache_slab_alloc == 0);
-	sp = avl_first(&cp->cache_partial_slabs);
+	sp = kmem_partial_slab_first(cp, lgrp);
 	if (sp == NULL) {
-		ASSERT(cp->cache_bufslab == 0);
+		ASSERT(cp->cache_bufslab == 0 || cp->cache_ndepots > 1);
 
 		/*
 		 * The freelist is empty.  Create a new slab.
 		 */
 		mutex_exit(&cp->cache_lock);
-		if ((sp = kmem_slab_create(cp, kmflag)) == NULL) {
+		sp = kmem_slab_create(cp, kmflag);
+		mutex_enter(&cp->cache_lock);
+		if (sp != NULL) {
+			cp->cache_slab_create++;
+			if ((cp->cache_buftotal += sp->slab_chunks) >
+			    cp->cache_bufmax)
+				cp->cache_bufmax = cp->cache_buftotal;
+			cp->cache_bufslab += sp->slab_chunks;
+		} else if ((sp = avl_first(&cp->cache_partial_slabs)) == NULL) {
+			mutex_exit(&cp->cache_lock);
 			return (NULL);
 		}
-		mutex_enter(&cp->cache_lock);
-		cp->cache_slab_create++;
-		if ((cp->cache_buftotal += sp->slab_chunks) > cp->cache_bufmax)
-			cp->cache_bufmax = cp->cache_buftotal;
-		cp->cache_bufslab += sp->slab_chunks;
+		/*
+		 * Otherwise we've settled for a partial slab in another
+		 * lgroup (or one freed while we dropped the lock) rather
+		 * than fail.
+		 */
 	}
 
+	if (sp->slab_lgrp != lgrp)
+		cp->cache_slab_alloc_remote++;
 	buf = kmem_slab_alloc_impl(cp, sp, B_TRUE);
 	ASSERT((cp->cache_slab_create - cp->cache_slab_destroy) ==
 	    (cp->cache_complete_slab_count +
@@ -2078,7 +2186,7 @@ kmem_magazine_destroy(kmem_cache_t *cp, kmem_magazine_t *mp, int nrounds)
  * Allocate a magazine from the depot.
  */
 static kmem_magazine_t *
-kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
+kmem_depot_alloc(kmem_cache_t *cp, kmem_depot_t *kdp, kmem_maglist_t *mlp)
 {
 	kmem_magazine_t *mp;
 
@@ -2088,9 +2196,9 @@ kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
 	 * contention rate to determine whether we need to
 	 * increase the magazine size for better scalability.
 	 */
-	if (!mutex_tryenter(&cp->cache_depot_lock)) {
-		mutex_enter(&cp->cache_depot_lock);
-		cp->cache_depot_contention++;
+	if (!mutex_tryenter(&kdp->kd_lock)) {
+		mutex_enter(&kdp->kd_lock);
+		kdp->kd_contention++;
 	}
 
 	if ((mp = mlp->ml_list) != NULL) {
@@ -2101,7 +2209,7 @@ kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
 		mlp->ml_alloc++;
 	}
 
-	mutex_exit(&cp->cache_depot_lock);
+	mutex_exit(&kdp->kd_lock);
 
 	return (mp);
 }
@@ -2110,43 +2218,58 @@ kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
  * Free a magazine to the depot.
  */
 static void
-kmem_depot_free(kmem_cache_t *cp, kmem_maglist_t *mlp, kmem_magazine_t *mp)
+kmem_depot_free(kmem_cache_t *cp, kmem_depot_t *kdp, kmem_maglist_t *mlp,
+    kmem_magazine_t *mp)
 {
-	mutex_enter(&cp->cache_depot_lock);
+	mutex_enter(&kdp->kd_lock);
 	ASSERT(KMEM_MAGAZINE_VALID(cp, mp));
 	mp->mag_next = mlp->ml_list;
 	mlp->ml_list = mp;
 	mlp->ml_total++;
-	mutex_exit(&cp->cache_depot_lock);
+	mutex_exit(&kdp->kd_lock);
 }
 
 /*
- * Update the working set statistics for cp's depot.
+ * Update the working set statistics for cp's depots.  Each lgroup's depot
+ * has its own working set, so that one whose CPUs have gone idle is reaped
+ * without disturbing those that are busy.
  */
 static void
 kmem_depot_ws_update(kmem_cache_t *cp)
 {
-	mutex_enter(&cp->cache_depot_lock);
-	cp->cache_full.ml_reaplimit = cp->cache_full.ml_min;
-	cp->cache_full.ml_min = cp->cache_full.ml_total;
-	cp->cache_empty.ml_reaplimit = cp->cache_empty.ml_min;
-	cp->cache_empty.ml_min = cp->cache_empty.ml_total;
-	mutex_exit(&cp->cache_depot_lock);
+	int d;
+
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		kmem_depot_t *kdp = &cp->cache_depot[d];
+
+		mutex_enter(&kdp->kd_lock);
+		kdp->kd_full.ml_reaplimit = kdp->kd_full.ml_min;
+		kdp->kd_full.ml_min = kdp->kd_full.ml_total;
+		kdp->kd_empty.ml_reaplimit = kdp->kd_empty.ml_min;
+		kdp->kd_empty.ml_min = kdp->kd_empty.ml_total;
+		mutex_exit(&kdp->kd_lock);
+	}
 }
 
 /*
- * Set the working set statistics for cp's depot to zero.  (Everything is
+ * Set the working set statistics for cp's depots to zero.  (Everything is
  * eligible for reaping.)
  */
 static void
 kmem_depot_ws_zero(kmem_cache_t *cp)
 {
-	mutex_enter(&cp->cache_depot_lock);
-	cp->cache_full.ml_reaplimit = cp->cache_full.ml_total;
-	cp->cache_full.ml_min = cp->cache_full.ml_total;
-	cp->cache_empty.ml_reaplimit = cp->cache_empty.ml_total;
-	cp->cache_empty.ml_min = cp->cache_empty.ml_total;
-	mutex_exit(&cp->cache_depot_lock);
+	int d;
+
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		kmem_depot_t *kdp = &cp->cache_depot[d];
+
+		mutex_enter(&kdp->kd_lock);
+		kdp->kd_full.ml_reaplimit = kdp->kd_full.ml_total;
+		kdp->kd_full.ml_min = kdp->kd_full.ml_total;
+		kdp->kd_empty.ml_reaplimit = kdp->kd_empty.ml_total;
+		kdp->kd_empty.ml_min = kdp->kd_empty.ml_total;
+		mutex_exit(&kdp->kd_lock);
+	}
 }
 
 /*
@@ -2157,7 +2280,7 @@ kmem_depot_ws_zero(kmem_cache_t *cp)
 size_t kmem_reap_preempt_bytes = 1024 * 1024;
 
 /*
- * Reap all magazines that have fallen out of the depot's working set.
+ * Reap all magazines that have fallen out of the depots' working sets.
  */
 static void
 kmem_depot_ws_reap(kmem_cache_t *cp)
@@ -2165,29 +2288,37 @@ kmem_depot_ws_reap(kmem_cache_t *cp)
 	size_t bytes = 0;
 	long reap;
 	kmem_magazine_t *mp;
+	int d;
 
 	ASSERT(!list_link_active(&cp->cache_link) ||
 	    taskq_member(kmem_taskq, curthread));
 
-	reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
-	while (reap-- &&
-	    (mp = kmem_depot_alloc(cp, &cp->cache_full)) != NULL) {
-		kmem_magazine_destroy(cp, mp, cp->cache_magtype->mt_magsize);
-		bytes += cp->cache_magtype->mt_magsize * cp->cache_bufsize;
-		if (bytes > kmem_reap_preempt_bytes) {
-			kpreempt(KPREEMPT_SYNC);
-			bytes = 0;
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		kmem_depot_t *kdp = &cp->cache_depot[d];
+
+		reap = MIN(kdp->kd_full.ml_reaplimit, kdp->kd_full.ml_min);
+		while (reap-- &&
+		    (mp = kmem_depot_alloc(cp, kdp, &kdp->kd_full)) != NULL) {
+			kmem_magazine_destroy(cp, mp,
+			    cp->cache_magtype->mt_magsize);
+			bytes += cp->cache_magtype->mt_magsize *
+			    cp->cache_bufsize;
+			if (bytes > kmem_reap_preempt_bytes) {
+				kpreempt(KPREEMPT_SYNC);
+				bytes = 0;
+			}
 		}
-	}
 
-	reap = MIN(cp->cache_empty.ml_reaplimit, cp->cache_empty.ml_min);
-	while (reap-- &&
-	    (mp = kmem_depot_alloc(cp, &cp->cache_empty)) != NULL) {
-		kmem_magazine_destroy(cp, mp, 0);
-		bytes += cp->cache_magtype->mt_magsize * cp->cache_bufsize;
-		if (bytes > kmem_reap_preempt_bytes) {
-			kpreempt(KPREEMPT_SYNC);
-			bytes = 0;
+		reap = MIN(kdp->kd_empty.ml_reaplimit, kdp->kd_empty.ml_min);
+		while (reap-- &&
+		    (mp = kmem_depot_alloc(cp, kdp, &kdp->kd_empty)) != NULL) {
+			kmem_magazine_destroy(cp, mp, 0);
+			bytes += cp->cache_magtype->mt_magsize *
+			    cp->cache_bufsize;
+			if (bytes > kmem_reap_preempt_bytes) {
+				kpreempt(KPREEMPT_SYNC);
+				bytes = 0;
+			}
 		}
 	}
 }
@@ -2430,6 +2561,7 @@ kmem_cache_alloc(kmem_cache_t *cp, int kmflag)
 {
 	kmem_cpu_cache_t *ccp = KMEM_CPU_CACHE(cp);
 	kmem_magazine_t *fmp;
+	kmem_depot_t *kdp;
 	void *buf;
 
 	mutex_enter(&ccp->cc_lock);
@@ -2497,10 +2629,11 @@ kmem_cache_alloc(kmem_cache_t *cp, int kmflag)
 		/*
 		 * Try to get a full magazine from the depot.
 		 */
-		fmp = kmem_depot_alloc(cp, &cp->cache_full);
+		kdp = kmem_cpu_depot(cp, ccp);
+		fmp = kmem_depot_alloc(cp, kdp, &kdp->kd_full);
 		if (fmp != NULL) {
 			if (ccp->cc_ploaded != NULL)
-				kmem_depot_free(cp, &cp->cache_empty,
+				kmem_depot_free(cp, kdp, &kdp->kd_empty,
 				    ccp->cc_ploaded);
 			kmem_cpu_reload(ccp, fmp, ccp->cc_magsize);
 			continue;
@@ -2597,6 +2730,7 @@ kmem_cpucache_magazine_alloc(kmem_cpu_cache_t *ccp, kmem_cache_t *cp)
 {
 	kmem_magazine_t *emp;
 	kmem_magtype_t *mtp;
+	kmem_depot_t *kdp = kmem_cpu_depot(cp, ccp);
 
 	ASSERT(MUTEX_HELD(&ccp->cc_lock));
 	ASSERT(((uint_t)ccp->cc_rounds == ccp->cc_magsize ||
@@ -2604,10 +2738,10 @@ kmem_cpucache_magazine_alloc(kmem_cpu_cache_t *ccp, kmem_cache_t *cp)
 	    ((uint_t)ccp->cc_prounds == ccp->cc_magsize ||
 	    ((uint_t)ccp->cc_prounds == -1)));
 
-	emp = kmem_depot_alloc(cp, &cp->cache_empty);
+	emp = kmem_depot_alloc(cp, kdp, &kdp->kd_empty);
 	if (emp != NULL) {
 		if (ccp->cc_ploaded != NULL)
-			kmem_depot_free(cp, &cp->cache_full,
+			kmem_depot_free(cp, kdp, &kdp->kd_full,
 			    ccp->cc_ploaded);
 		kmem_cpu_reload(ccp, emp, 0);
 		return (1);
@@ -2641,7 +2775,7 @@ kmem_cpucache_magazine_alloc(kmem_cpu_cache_t *ccp, kmem_cache_t *cp)
 		 * We got a magazine of the right size.  Add it to
 		 * the depot and try the whole dance again.
 		 */
-		kmem_depot_free(cp, &cp->cache_empty, emp);
+		kmem_depot_free(cp, kdp, &kdp->kd_empty, emp);
 		return (1);
 	}
 
@@ -3057,20 +3191,27 @@ kmem_cache_reap(kmem_cache_t *cp)
 	 * callback is just an advisory plea for help.
 	 */
 	if (cp->cache_reclaim != NULL) {
+		long total[NLGRPS_MAX];
 		long delta;
+		int d;
 
 		/*
 		 * Reclaimed memory should be reapable (not included in the
 		 * depot's working set).
 		 */
-		delta = cp->cache_full.ml_total;
+		for (d = 0; d < cp->cache_ndepots; d++)
+			total[d] = cp->cache_depot[d].kd_full.ml_total;
 		cp->cache_reclaim(cp->cache_private);
-		delta = cp->cache_full.ml_total - delta;
-		if (delta > 0) {
-			mutex_enter(&cp->cache_depot_lock);
-			cp->cache_full.ml_reaplimit += delta;
-			cp->cache_full.ml_min += delta;
-			mutex_exit(&cp->cache_depot_lock);
+		for (d = 0; d < cp->cache_ndepots; d++) {
+			kmem_depot_t *kdp = &cp->cache_depot[d];
+
+			delta = kdp->kd_full.ml_total - total[d];
+			if (delta > 0) {
+				mutex_enter(&kdp->kd_lock);
+				kdp->kd_full.ml_reaplimit += delta;
+				kdp->kd_full.ml_min += delta;
+				mutex_exit(&kdp->kd_lock);
+			}
 		}
 	}
 
@@ -3277,16 +3418,21 @@ static void
 kmem_cache_magazine_resize(kmem_cache_t *cp)
 {
 	kmem_magtype_t *mtp = cp->cache_magtype;
+	int d;
 
 	ASSERT(taskq_member(kmem_taskq, curthread));
 
 	if (cp->cache_chunksize < mtp->mt_maxbuf) {
 		kmem_cache_magazine_purge(cp);
-		mutex_enter(&cp->cache_depot_lock);
+		for (d = 0; d < cp->cache_ndepots; d++)
+			mutex_enter(&cp->cache_depot[d].kd_lock);
 		cp->cache_magtype = ++mtp;
-		cp->cache_depot_contention_prev =
-		    cp->cache_depot_contention + INT_MAX;
-		mutex_exit(&cp->cache_depot_lock);
+		for (d = 0; d < cp->cache_ndepots; d++) {
+			kmem_depot_t *kdp = &cp->cache_depot[d];
+
+			kdp->kd_contention_prev = kdp->kd_contention + INT_MAX;
+			mutex_exit(&kdp->kd_lock);
+		}
 		kmem_cache_magazine_enable(cp);
 	}
 }
@@ -3351,6 +3497,7 @@ kmem_cache_update(kmem_cache_t *cp)
 {
 	int need_hash_rescale = 0;
 	int need_magazine_resize = 0;
+	int d;
 
 	ASSERT(MUTEX_HELD(&kmem_cache_lock));
 
@@ -3374,19 +3521,23 @@ kmem_cache_update(kmem_cache_t *cp)
 	kmem_depot_ws_update(cp);
 
 	/*
-	 * If there's a lot of contention in the depot,
+	 * If there's a lot of contention in any of the depots,
 	 * increase the magazine size.
 	 */
-	mutex_enter(&cp->cache_depot_lock);
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		kmem_depot_t *kdp = &cp->cache_depot[d];
 
-	if (cp->cache_chunksize < cp->cache_magtype->mt_maxbuf &&
-	    (int)(cp->cache_depot_contention -
-	    cp->cache_depot_contention_prev) > kmem_depot_contention)
-		need_magazine_resize = 1;
+		mutex_enter(&kdp->kd_lock);
 
-	cp->cache_depot_contention_prev = cp->cache_depot_contention;
+		if (cp->cache_chunksize < cp->cache_magtype->mt_maxbuf &&
+		    (int)(kdp->kd_contention -
+		    kdp->kd_contention_prev) > kmem_depot_contention)
+			need_magazine_resize = 1;
 
-	mutex_exit(&cp->cache_depot_lock);
+		kdp->kd_contention_prev = kdp->kd_contention;
+
+		mutex_exit(&kdp->kd_lock);
+	}
 
 	if (need_hash_rescale)
 		(void) taskq_dispatch(kmem_taskq,
@@ -3431,7 +3582,7 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 	kmem_cache_t *cp = ksp->ks_private;
 	uint64_t cpu_buf_avail;
 	uint64_t buf_avail = 0;
-	int cpu_seqid;
+	int cpu_seqid, d;
 	long reap;
 
 	ASSERT(MUTEX_HELD(&kmem_cache_kstat_lock));
@@ -3446,6 +3597,7 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 	kmcp->kmc_free.value.ui64		= cp->cache_slab_free;
 	kmcp->kmc_slab_alloc.value.ui64		= cp->cache_slab_alloc;
 	kmcp->kmc_slab_free.value.ui64		= cp->cache_slab_free;
+	kmcp->kmc_slab_alloc_remote.value.ui64	= cp->cache_slab_alloc_remote;
 
 	for (cpu_seqid = 0; cpu_seqid < max_ncpus; cpu_seqid++) {
 		kmem_cpu_cache_t *ccp = &cp->cache_cpu[cpu_seqid];
@@ -3465,25 +3617,40 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 		mutex_exit(&ccp->cc_lock);
 	}
 
-	mutex_enter(&cp->cache_depot_lock);
-
-	kmcp->kmc_depot_alloc.value.ui64	= cp->cache_full.ml_alloc;
-	kmcp->kmc_depot_free.value.ui64		= cp->cache_empty.ml_alloc;
-	kmcp->kmc_depot_contention.value.ui64	= cp->cache_depot_contention;
-	kmcp->kmc_full_magazines.value.ui64	= cp->cache_full.ml_total;
-	kmcp->kmc_empty_magazines.value.ui64	= cp->cache_empty.ml_total;
+	kmcp->kmc_depot_alloc.value.ui64	= 0;
+	kmcp->kmc_depot_free.value.ui64		= 0;
+	kmcp->kmc_depot_contention.value.ui64	= 0;
+	kmcp->kmc_full_magazines.value.ui64	= 0;
+	kmcp->kmc_empty_magazines.value.ui64	= 0;
 	kmcp->kmc_magazine_size.value.ui64	=
 	    (cp->cache_flags & KMF_NOMAGAZINE) ?
 	    0 : cp->cache_magtype->mt_magsize;
+	reap = 0;
+
+	for (d = 0; d < cp->cache_ndepots; d++) {
+		kmem_depot_t *kdp = &cp->cache_depot[d];
+		long depot_reap;
+
+		mutex_enter(&kdp->kd_lock);
 
-	kmcp->kmc_alloc.value.ui64		+= cp->cache_full.ml_alloc;
-	kmcp->kmc_free.value.ui64		+= cp->cache_empty.ml_alloc;
-	buf_avail += cp->cache_full.ml_total * cp->cache_magtype->mt_magsize;
+		kmcp->kmc_depot_alloc.value.ui64 += kdp->kd_full.ml_alloc;
+		kmcp->kmc_depot_free.value.ui64	+= kdp->kd_empty.ml_alloc;
+		kmcp->kmc_depot_contention.value.ui64 += kdp->kd_contention;
+		kmcp->kmc_full_magazines.value.ui64 += kdp->kd_full.ml_total;
+		kmcp->kmc_empty_magazines.value.ui64 +=
+		    kdp->kd_empty.ml_total;
 
-	reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
-	reap = MIN(reap, cp->cache_full.ml_total);
+		kmcp->kmc_alloc.value.ui64	+= kdp->kd_full.ml_alloc;
+		kmcp->kmc_free.value.ui64	+= kdp->kd_empty.ml_alloc;
+		buf_avail += kdp->kd_full.ml_total *
+		    cp->cache_magtype->mt_magsize;
 
-	mutex_exit(&cp->cache_depot_lock);
+		depot_reap = MIN(kdp->kd_full.ml_reaplimit,
+		    kdp->kd_full.ml_min);
+		reap += MIN(depot_reap, kdp->kd_full.ml_total);
+
+		mutex_exit(&kdp->kd_lock);
+	}
 
 	kmcp->kmc_buf_size.value.ui64	= cp->cache_bufsize;
 	kmcp->kmc_align.value.ui64	= cp->cache_align;
@@ -3633,6 +3800,11 @@ kmem_debugging(void)
  * unfreeable. If the client returns KMEM_CBRC_NO in response to a cache_move()
  * callback, the slab is marked unfreeable for as long as it remains on the
  * freelist.
+ *
+ * All of that applies within an lgroup: the slabs are sorted by the lgroup
+ * they are homed in before anything else, so that each lgroup's partial slabs
+ * form a run of their own, starting with the one to allocate from there (see
+ * kmem_partial_slab_first()).  With a single lgroup, this changes nothing.
  */
 static int
 kmem_partial_slab_cmp(const void *p0, const void *p1)
@@ -3650,6 +3822,16 @@ kmem_partial_slab_cmp(const void *p0, const void *p1)
 	ASSERT(MUTEX_HELD(&cp->cache_lock));
 	binshift = cp->cache_partial_binshift;
 
+	if (s0->slab_lgrp < s1->slab_lgrp)
+		return (-1);
+	if (s0->slab_lgrp > s1->slab_lgrp)
+		return (1);
+
+	/* a search key sorts before every slab in its lgroup */
+	ASSERT(!(s1->slab_flags & KMEM_SLAB_KEY));
+	if (s0->slab_flags & KMEM_SLAB_KEY)
+		return (-1);
+
 	/* weight of first slab */
 	w0 = KMEM_PARTIAL_SLAB_WEIGHT(s0, binshift);
 	if (s0->slab_flags & KMEM_SLAB_NOMOVE) {
@@ -3693,11 +3875,12 @@ kmem_cache_create(
 	vmem_t *vmp,		/* vmem source for slab allocation */
 	int cflags)		/* cache creation flags */
 {
-	int cpu_seqid;
+	int cpu_seqid, d;
 	size_t chunksize;
 	kmem_cache_t *cp;
 	kmem_magtype_t *mtp;
-	size_t csize = KMEM_CACHE_SIZE(max_ncpus);
+	size_t csize = KMEM_CACHE_SIZE(max_ncpus) +
+	    KMEM_DEPOT_SIZE(kmem_ndepots);
 
 #ifdef	DEBUG
 	/*
@@ -3725,12 +3908,16 @@ kmem_cache_create(
 	/*
 	 * Get a kmem_cache structure.  We arrange that cp->cache_cpu[]
 	 * is aligned on a KMEM_CPU_CACHE_SIZE boundary to prevent
-	 * false sharing of per-CPU data.
+	 * false sharing of per-CPU data.  The per-lgroup depots follow
+	 * the per-CPU caches, and are multiples of that size too.
 	 */
 	cp = vmem_xalloc(kmem_cache_arena, csize, KMEM_CPU_CACHE_SIZE,
 	    P2NPHASE(csize, KMEM_CPU_CACHE_SIZE), 0, NULL, NULL, VM_SLEEP);
 	bzero(cp, csize);
 	list_link_init(&cp->cache_link);
+	cp->cache_depot = (kmem_depot_t *)((uintptr_t)cp +
+	    KMEM_CACHE_SIZE(max_ncpus));
+	cp->cache_ndepots = kmem_ndepots;
 
 	if (align == 0)
 		align = KMEM_ALIGN;
@@ -3942,9 +4129,11 @@ kmem_cache_create(
 	}
 
 	/*
-	 * Initialize the depot.
+	 * Initialize the depots, one for each lgroup.
 	 */
-	mutex_init(&cp->cache_depot_lock, NULL, MUTEX_DEFAULT, NULL);
+	for (d = 0; d < cp->cache_ndepots; d++)
+		mutex_init(&cp->cache_depot[d].kd_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
 
 	for (mtp = kmem_magtype; chunksize <= mtp->mt_minbuf; mtp++)
 		continue;
@@ -4085,7 +4274,7 @@ kmem_cache_set_move(kmem_cache_t *cp,
 void
 kmem_cache_destroy(kmem_cache_t *cp)
 {
-	int cpu_seqid;
+	int cpu_seqid, d;
 
 	/*
 	 * Remove the cache from the global cache list so that no one else
@@ -4135,10 +4324,12 @@ kmem_cache_destroy(kmem_cache_t *cp)
 	for (cpu_seqid = 0; cpu_seqid < max_ncpus; cpu_seqid++)
 		mutex_destroy(&cp->cache_cpu[cpu_seqid].cc_lock);
 
-	mutex_destroy(&cp->cache_depot_lock);
+	for (d = 0; d < cp->cache_ndepots; d++)
+		mutex_destroy(&cp->cache_depot[d].kd_lock);
 	mutex_destroy(&cp->cache_lock);
 
-	vmem_free(kmem_cache_arena, cp, KMEM_CACHE_SIZE(max_ncpus));
+	vmem_free(kmem_cache_arena, cp, KMEM_CACHE_SIZE(max_ncpus) +
+	    KMEM_DEPOT_SIZE(cp->cache_ndepots));
 }
 
 /*ARGSUSED*/
@@ -4320,6 +4511,15 @@ kmem_init(void)
 
 	/* LINTED */
 	ASSERT(sizeof (kmem_cpu_cache_t) == KMEM_CPU_CACHE_SIZE);
+	/* LINTED */
+	ASSERT(sizeof (kmem_depot_t) == 2 * KMEM_CPU_CACHE_SIZE);
+
+	/*
+	 * lgrp_init() has already determined how many lgroups there can be;
+	 * give each cache a depot per lgroup if there is more than one.
+	 */
+	if (kmem_lgrp_local && nlgrpsmax > 1)
+		kmem_ndepots = MIN(nlgrpsmax, NLGRPS_MAX);
 
 	list_create(&kmem_caches, sizeof (kmem_cache_t),
 	    offsetof(kmem_cache_t, cache_link));
@@ -4868,6 +5068,7 @@ kmem_move_begin(kmem_cache_t *cp, kmem_slab_t *sp, void *buf, int flags)
 	void *to_buf;
 	avl_index_t index;
 	kmem_move_t *callback, *pending;
+	kmem_slab_t *to_sp;
 	ulong_t n;
 
 	ASSERT(taskq_member(kmem_taskq, curthread));
@@ -4906,8 +5107,13 @@ kmem_move_begin(kmem_cache_t *cp, kmem_slab_t *sp, void *buf, int flags)
 		return (B_TRUE);
 	}
 
-	to_buf = kmem_slab_alloc_impl(cp, avl_first(&cp->cache_partial_slabs),
-	    B_FALSE);
+	/*
+	 * Keep the buffer in its own lgroup if there is a slab there to move
+	 * it to.
+	 */
+	if ((to_sp = kmem_partial_slab_first(cp, sp->slab_lgrp)) == NULL)
+		to_sp = avl_first(&cp->cache_partial_slabs);
+	to_buf = kmem_slab_alloc_impl(cp, to_sp, B_FALSE);
 	callback->kmm_to_buf = to_buf;
 	avl_insert(&cp->cache_defrag->kmd_moves_pending, callback, index);
 
@@ -5022,13 +5228,22 @@ kmem_move_buffers(kmem_cache_t *cp, size_t max_scan, size_t max_slabs,
 		max_slabs = (size_t)-1;
 	}
 
+	/*
+	 * Scan backwards from the least-used slab of the last lgroup.  The
+	 * first slab of each lgroup is where buffers from that lgroup are
+	 * moved to, so we skip it; with a single lgroup, that's where the scan
+	 * ends.
+	 */
 	sp = avl_last(&cp->cache_partial_slabs);
 	ASSERT(KMEM_SLAB_IS_PARTIAL(sp));
-	for (i = 0, s = 0; (i < max_scan) && (s < max_slabs) && (sp != NULL) &&
-	    ((sp != avl_first(&cp->cache_partial_slabs)) ||
-	    (flags & KMM_DEBUG));
+	for (i = 0, s = 0; (i < max_scan) && (s < max_slabs) && (sp != NULL);
 	    sp = AVL_PREV(&cp->cache_partial_slabs, sp), i++) {
 
+		if (sp == kmem_partial_slab_first(cp, sp->slab_lgrp) &&
+		    !(flags & KMM_DEBUG)) {
+			continue;
+		}
+
 		if (!kmem_slab_is_reclaimable(cp, sp, flags)) {
 			continue;
 		}
@@ -5156,9 +5371,10 @@ kmem_move_buffers(kmem_cache_t *cp, size_t max_scan, size_t max_slabs,
 			/*
 			 * Generating a move request allocates a destination
 			 * buffer from the slab layer, bumping the first partial
-			 * slab if it is completely allocated. If the current
-			 * slab becomes the first partial slab as a result, we
-			 * can't continue to scan backwards.
+			 * slab of the lgroup if it is completely allocated. If
+			 * the current slab becomes the first partial slab of
+			 * its lgroup as a result, we can't continue to scan
+			 * backwards within the lgroup.
 			 *
 			 * If this is a KMM_DEBUG move and we allocated the
 			 * destination buffer from the last partial slab, then
@@ -5167,12 +5383,19 @@ kmem_move_buffers(kmem_cache_t *cp, size_t max_scan, size_t max_slabs,
 			 * reaching here if there are no partial slabs left.
 			 */
 			ASSERT(!avl_is_empty(&cp->cache_partial_slabs));
-			if (sp == avl_first(&cp->cache_partial_slabs)) {
+			if (sp == kmem_partial_slab_first(cp, sp->slab_lgrp)) {
 				/*
 				 * We're not interested in a second KMM_DEBUG
 				 * move.
 				 */
-				goto end_scan;
+				if (flags & KMM_DEBUG)
+					goto end_scan;
+				/*
+				 * Stop moving buffers off this slab.  The scan
+				 * goes on with the previous slab, which is the
+				 * last partial slab of the previous lgroup.
+				 */
+				break;
 			}
 		}
 	}
@@ -5329,12 +5552,19 @@ kmem_cache_is_fragmented(kmem_cache_t *cp, boolean_t *doreap)
 	 * have fallen out of the working set.
 	 */
 	if (!fragmented) {
-		long reap;
+		long reap = 0;
+		int d;
 
-		mutex_enter(&cp->cache_depot_lock);
-		reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
-		reap = MIN(reap, cp->cache_full.ml_total);
-		mutex_exit(&cp->cache_depot_lock);
+		for (d = 0; d < cp->cache_ndepots; d++) {
+			kmem_depot_t *kdp = &cp->cache_depot[d];
+			long depot_reap;
+
+			mutex_enter(&kdp->kd_lock);
+			depot_reap = MIN(kdp->kd_full.ml_reaplimit,
+			    kdp->kd_full.ml_min);
+			reap += MIN(depot_reap, kdp->kd_full.ml_total);
+			mutex_exit(&kdp->kd_lock);
+		}
 
 		nfree += ((uint64_t)reap * cp->cache_magtype->mt_magsize);
 		if (kmem_cache_frag_threshold(cp, nfree)) {
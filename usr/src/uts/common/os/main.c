@@ -621,6 +621,8 @@ main(void)
 	 * Any per cpu initialization is done here.
 	 */
 	kmem_mp_init();
+	page_pcache_init();
+	page_zpool_init();
 
 	clock_tick_init_post();
 
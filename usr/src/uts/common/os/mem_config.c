@@ -1803,6 +1803,16 @@ delete_memory_thread(caddr_t amhp)
 
 		MDSTAT_INCR(mhp, nloop);
 		collected = 0;
+
+		/*
+		 * Free pages in the span may be held locked in the per-CPU
+		 * page caches or the zero pool.
+		 */
+		mutex_exit(&mhp->mh_mutex);
+		page_pcache_reap();
+		page_zpool_reap();
+		mutex_enter(&mhp->mh_mutex);
+
 		for (mdsp = mhp->mh_transit.trl_spans; (mdsp != NULL) &&
 		    (mhp->mh_cancel == 0); mdsp = mdsp->mds_next) {
 			pfn_t pfn, p_end;
@@ -126,6 +126,16 @@
  *		supported for DYNAMIC task queues.  This flag is not compatible
  *		with TASKQ_THREADS_CPU_PCT.
  *
+ *	  TASKQ_PERCPU: Split the queue of a non-dynamic task queue into
+ *		per-CPU queues, for task queues with a dispatch rate high enough
+ *		that tq_lock becomes contended.  Tasks are queued on the queue
+ *		of the dispatching CPU, and each thread serves one queue,
+ *		stealing from the others when its own is empty.  Task execution
+ *		order is not predictable, even if nthreads == 1.  Task entries
+ *		come straight from the kmem cache, so 'minalloc' and 'maxalloc'
+ *		are ignored.  This flag is not supported for DYNAMIC task
+ *		queues.
+ *
  *	The 'pri' field specifies the default priority for the threads that
  *	service all scheduled tasks.
  *
@@ -168,7 +178,8 @@
  *	  TQ_NOSLEEP: Do not wait for resources; may fail.
  *
  *	  TQ_NOALLOC: Do not allocate memory; may fail.  May only be used with
- *		non-dynamic task queues.
+ *		non-dynamic task queues.  TASKQ_PERCPU task queues treat it
+ *		as TQ_NOSLEEP.
  *
  *	  TQ_NOQUEUE: Do not enqueue a task if it can't dispatch it due to
  *		lack of available resources and fail. If this flag is not
@@ -354,6 +365,51 @@
  * walks the list of TASKQ_THREAD_CPU_PCT taskqs, adjusts their nthread_target
  * if need be, and wakes up all of the threads to process the change.
  *
+ * Per-CPU Task Queues Implementation ------------------------------------------
+ *
+ * A TASKQ_PERCPU task queue has tq_npcq queues (tq_pcq) in place of tq_task,
+ * each with its own lock, task list and statistics on separate cache lines.
+ * The number of queues is 2^n, and is no more than the number of buckets a
+ * dynamic task queue would have nor the maximum number of threads, so every
+ * queue has at least one thread once the task queue is fully populated.
+ *
+ * taskq_dispatch() and taskq_dispatch_ent() append the task to the queue
+ * selected by the dispatching CPU's sequential id, taking only that queue's
+ * lock; tq_lock is not touched.  Entries for taskq_dispatch() come directly
+ * from taskq_ent_cache, whose magazine layer is per-CPU too.
+ *
+ * The queues are mutex-protected lists rather than lock-free deques.  Entries
+ * passed to taskq_dispatch_ent() are owned by the caller and linked through
+ * tqent_next/tqent_prev, so the queues must stay intrusive doubly-linked
+ * lists, and each queue's lock is normally taken only by its own CPU.  Note
+ * that mdb's ::taskq and ::taskq_entry walkers only look at tq_task, so they
+ * show no pending tasks for a TASKQ_PERCPU task queue; the per-queue depths
+ * are in its "taskq_pcq" kstats.
+ *
+ * Thread n serves queue (n - 1) mod tq_npcq, its "home" queue.  It takes tasks
+ * from the front of its home queue and, when that is empty, steals the oldest
+ * task from the first non-empty queue after it.  Once the task has run, the
+ * thread takes the lock of the queue it came from again to account for it.
+ * Threads check for TASKQ_CHANGING between tasks, and otherwise only take
+ * tq_lock when they go idle and when they wake up, to maintain tq_active and
+ * the CPR protocol.
+ *
+ * A thread with nothing to do counts itself in tqq_nidle of its home queue
+ * and in tq_pcq_nidle, and sleeps on tqq_cv.  A dispatch signals tqq_cv if the
+ * queue has idle threads of its own, which is the common case when a taskq is
+ * lightly loaded.  Otherwise, if tq_pcq_nidle shows that threads are idle
+ * elsewhere, it wakes one of them to steal the task, so that a task never
+ * waits behind a busy home thread while other threads sleep.  The thread going
+ * idle and the dispatcher each issue a memory barrier between publishing
+ * their own update and looking at the other's, so either the dispatcher sees
+ * the idle thread or the thread sees the new task before sleeping.
+ *
+ * Each queue keeps counts of queued and executed tasks, its current and
+ * maximum depth, the number of its tasks that were stolen, and the total time
+ * its tasks spent queued (from tqent_time) and executing.  These are exported
+ * per queue in the "taskq" kstat module, class "taskq_pcq", and summed into the
+ * usual "taskq" class kstat.
+ *
  * Dynamic Task Queues Implementation ------------------------------------------
  *
  * For a dynamic task queues there is a 1-to-1 mapping between a thread and
@@ -423,12 +479,17 @@
  *	      scheduled for dynamic task queues. It only suspends new tasks
  *	      scheduled after taskq_suspend() was called.
  *
+ *	Threads of TASKQ_PERCPU task queues do not use the thread lock.
+ *	Instead, taskq_suspend() marks each per-CPU queue TQQ_SUSPEND, so that
+ *	no more tasks are taken from it, and waits for the tasks already taken
+ *	from it to complete.
+ *
  *	taskq_member() function works by comparing a thread t_taskq pointer with
  *	the passed thread pointer.
  *
  * LOCKS and LOCK Hierarchy ----------------------------------------------------
  *
- *   There are three locks used in task queues:
+ *   There are four locks used in task queues:
  *
  *   1) The taskq_t's tq_lock, protecting global task queue state.
  *
@@ -437,9 +498,15 @@
  *   3) The global taskq_cpupct_lock, which protects the list of
  *      TASKQ_THREADS_CPU_PCT taskqs.
  *
+ *   4) Each per-CPU queue of a TASKQ_PERCPU taskq has a lock protecting its
+ *      task list and statistics.
+ *
  *   If both (1) and (2) are needed, tq_lock should be taken *after* the bucket
  *   lock.
  *
+ *   If both (1) and (4) are needed, tq_lock should be taken *before* the queue
+ *   lock.  No more than one queue lock is held at a time.
+ *
  *   If both (1) and (3) are needed, tq_lock should be taken *after*
  *   taskq_cpupct_lock.
  *
@@ -504,6 +571,7 @@
 #include <sys/sdt.h>
 #include <sys/sysdc.h>
 #include <sys/note.h>
+#include <sys/atomic.h>
 
 static kmem_cache_t *taskq_ent_cache, *taskq_cache;
 
@@ -588,6 +656,7 @@ static void taskq_ent_free(taskq_t *, taskq_ent_t *);
 static int taskq_ent_exists(taskq_t *, task_func_t, void *);
 static taskq_ent_t *taskq_bucket_dispatch(taskq_bucket_t *, task_func_t,
     void *);
+static void taskq_pcq_wakeall(taskq_t *);
 
 /*
  * Task queues kstats.
@@ -656,10 +725,28 @@ struct taskq_d_kstat {
 	{ "nfree",		KSTAT_DATA_UINT64 },
 };
 
+/*
+ * Statistics exported for each queue of a TASKQ_PERCPU task queue, in the
+ * order they are filled in by taskq_pcq_kstat_update().
+ */
+static const char *taskq_pcq_kstat_names[] = {
+	"tasks",
+	"executed",
+	"depth",
+	"maxdepth",
+	"steals",
+	"waittime",
+	"totaltime",
+};
+
+#define	TASKQ_PCQ_NSTATS	\
+	(sizeof (taskq_pcq_kstat_names) / sizeof (taskq_pcq_kstat_names[0]))
+
 static kmutex_t taskq_kstat_lock;
 static kmutex_t taskq_d_kstat_lock;
 static int taskq_kstat_update(kstat_t *, int);
 static int taskq_d_kstat_update(kstat_t *, int);
+static int taskq_pcq_kstat_update(kstat_t *, int);
 
 /*
  * List of all TASKQ_THREADS_CPU_PCT taskqs.
@@ -870,6 +957,8 @@ taskq_update_nthreads(taskq_t *tq, uint_t ncpus)
 		tq->tq_nthreads_target = newtarget;
 		cv_broadcast(&tq->tq_dispatch_cv);
 		cv_broadcast(&tq->tq_exit_cv);
+		if (tq->tq_flags & TASKQ_PERCPU)
+			taskq_pcq_wakeall(tq);
 	}
 }
 
@@ -1131,6 +1220,113 @@ taskq_bucket_dispatch(taskq_bucket_t *b, task_func_t func, void *arg)
 	return (tqe);
 }
 
+/*
+ * Wake an idle thread of a TASKQ_PERCPU task queue, looking at 'n' queues
+ * starting with queue 'qid', to run a task just queued.
+ */
+static void
+taskq_pcq_wake(taskq_t *tq, uint_t qid, uint_t n)
+{
+	uint_t i;
+
+	/*
+	 * Order our caller's store of the task before our loads of the idle
+	 * counts; this pairs with the barrier in taskq_pcq_thread().
+	 */
+	membar_enter();
+	if (tq->tq_pcq_nidle == 0)
+		return;
+
+	for (i = 0; i < n; i++) {
+		taskq_pcq_t *q = &tq->tq_pcq[(qid + i) & (tq->tq_npcq - 1)];
+
+		if (q->tqq_nidle == 0)
+			continue;
+
+		mutex_enter(&q->tqq_lock);
+		if (q->tqq_nidle != 0) {
+			cv_signal(&q->tqq_cv);
+			mutex_exit(&q->tqq_lock);
+			return;
+		}
+		mutex_exit(&q->tqq_lock);
+	}
+}
+
+/*
+ * Wake all idle threads of a TASKQ_PERCPU task queue.
+ */
+static void
+taskq_pcq_wakeall(taskq_t *tq)
+{
+	uint_t qid;
+
+	for (qid = 0; qid < tq->tq_npcq; qid++) {
+		taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+		mutex_enter(&q->tqq_lock);
+		cv_broadcast(&q->tqq_cv);
+		mutex_exit(&q->tqq_lock);
+	}
+}
+
+/*
+ * Schedule a task specified by func and arg into the task queue entry tqe, on
+ * the per-CPU queue of the current CPU, and make sure a thread will run it.
+ */
+static void
+taskq_pcq_enqueue(taskq_t *tq, taskq_ent_t *tqe, task_func_t func, void *arg,
+    uint_t flags)
+{
+	uint_t qid = CPU->cpu_seqid & (tq->tq_npcq - 1);
+	taskq_pcq_t *q = &tq->tq_pcq[qid];
+	boolean_t woken;
+
+	tqe->tqent_func = func;
+	tqe->tqent_arg = arg;
+	tqe->tqent_time = gethrtime();
+
+	mutex_enter(&q->tqq_lock);
+	if (flags & TQ_FRONT) {
+		TQ_PREPEND(q->tqq_task, tqe);
+	} else {
+		TQ_APPEND(q->tqq_task, tqe);
+	}
+	q->tqq_tasks++;
+	if (++q->tqq_depth > q->tqq_maxdepth)
+		q->tqq_maxdepth = q->tqq_depth;
+	if ((woken = (q->tqq_nidle != 0)))
+		cv_signal(&q->tqq_cv);
+	DTRACE_PROBE2(taskq__enqueue, taskq_t *, tq, taskq_ent_t *, tqe);
+	mutex_exit(&q->tqq_lock);
+
+	/*
+	 * All of the threads of our queue are busy; if there are idle threads
+	 * elsewhere, have one of them steal the task.
+	 */
+	if (!woken)
+		taskq_pcq_wake(tq, qid + 1, tq->tq_npcq - 1);
+}
+
+/*
+ * Returns B_TRUE if any per-CPU queue has tasks.  Unless 'suspended' is set,
+ * queues suspended by taskq_suspend() are ignored.
+ */
+static boolean_t
+taskq_pcq_pending(taskq_t *tq, boolean_t suspended)
+{
+	uint_t qid;
+
+	for (qid = 0; qid < tq->tq_npcq; qid++) {
+		taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+		if (q->tqq_depth != 0 &&
+		    (suspended || !(q->tqq_flags & TQQ_SUSPEND)))
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
 /*
  * Dispatch a task.
  *
@@ -1152,6 +1348,27 @@ taskq_dispatch(taskq_t *tq, task_func_t func, void *arg, uint_t flags)
 	ASSERT(tq != NULL);
 	ASSERT(func != NULL);
 
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		int kmflags = (flags & (TQ_NOSLEEP | TQ_NOALLOC)) ?
+		    KM_NOSLEEP : KM_SLEEP;
+
+		/*
+		 * TQ_NOQUEUE flag can't be used with non-dynamic task queues.
+		 */
+		ASSERT(!(flags & TQ_NOQUEUE));
+		TASKQ_D_RANDOM_DISPATCH_FAILURE(tq, flags);
+
+		if ((tqe = kmem_cache_alloc(taskq_ent_cache, kmflags)) ==
+		    NULL) {
+			atomic_inc_64(&tq->tq_nomem);
+			return (TASKQID_INVALID);
+		}
+		/* Make sure we start without any flags */
+		tqe->tqent_un.tqent_flags = 0;
+		taskq_pcq_enqueue(tq, tqe, func, arg, flags);
+		return ((taskqid_t)tqe);
+	}
+
 	if (!(tq->tq_flags & TASKQ_DYNAMIC)) {
 		/*
 		 * TQ_NOQUEUE flag can't be used with non-dynamic task queues.
@@ -1311,6 +1528,12 @@ taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
 	 * to ensure that we don't free it later.
 	 */
 	tqe->tqent_un.tqent_flags |= TQENT_FLAG_PREALLOC;
+
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		taskq_pcq_enqueue(tq, tqe, func, arg, flags);
+		return;
+	}
+
 	/*
 	 * Enqueue the task to the underlying queue.
 	 */
@@ -1334,7 +1557,8 @@ taskq_empty(taskq_t *tq)
 
 	ASSERT3P(tq, !=, curthread->t_taskq);
 	mutex_enter(&tq->tq_lock);
-	rv = (tq->tq_task.tqent_next == &tq->tq_task) && (tq->tq_active == 0);
+	rv = (tq->tq_task.tqent_next == &tq->tq_task) && (tq->tq_active == 0) &&
+	    !taskq_pcq_pending(tq, B_TRUE);
 	mutex_exit(&tq->tq_lock);
 
 	return (rv);
@@ -1349,8 +1573,14 @@ taskq_wait(taskq_t *tq)
 {
 	ASSERT(tq != curthread->t_taskq);
 
+	/*
+	 * For TASKQ_PERCPU task queues, the threads only become active while
+	 * holding tq_lock, so when tq_active is 0 none of them can take a task
+	 * from a per-CPU queue until we drop it.
+	 */
 	mutex_enter(&tq->tq_lock);
-	while (tq->tq_task.tqent_next != &tq->tq_task || tq->tq_active != 0)
+	while (tq->tq_task.tqent_next != &tq->tq_task || tq->tq_active != 0 ||
+	    taskq_pcq_pending(tq, B_TRUE))
 		cv_wait(&tq->tq_wait_cv, &tq->tq_lock);
 	mutex_exit(&tq->tq_lock);
 
@@ -1393,6 +1623,20 @@ taskq_suspend(taskq_t *tq)
 			mutex_exit(&b->tqbucket_lock);
 		}
 	}
+
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		uint_t qid;
+
+		for (qid = 0; qid < tq->tq_npcq; qid++) {
+			taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+			mutex_enter(&q->tqq_lock);
+			q->tqq_flags |= TQQ_SUSPEND;
+			while (q->tqq_nrunning != 0)
+				cv_wait(&q->tqq_wait_cv, &q->tqq_lock);
+			mutex_exit(&q->tqq_lock);
+		}
+	}
 	/*
 	 * Mark task queue as being suspended. Needed for taskq_suspended().
 	 */
@@ -1428,6 +1672,20 @@ taskq_resume(taskq_t *tq)
 			mutex_exit(&b->tqbucket_lock);
 		}
 	}
+
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		uint_t qid;
+
+		for (qid = 0; qid < tq->tq_npcq; qid++) {
+			taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+			mutex_enter(&q->tqq_lock);
+			q->tqq_flags &= ~TQQ_SUSPEND;
+			mutex_exit(&q->tqq_lock);
+		}
+		/* Idle threads may now have tasks to take. */
+		taskq_pcq_wakeall(tq);
+	}
 	mutex_enter(&tq->tq_lock);
 	ASSERT(tq->tq_flags & TASKQ_SUSPENDED);
 	tq->tq_flags &= ~TASKQ_SUSPENDED;
@@ -1528,6 +1786,160 @@ taskq_thread_wait(taskq_t *tq, kmutex_t *mx, kcondvar_t *cv,
 	return (ret);
 }
 
+/*
+ * Take the next task for a thread of a TASKQ_PERCPU task queue: the oldest one
+ * on its home queue or, failing that, on the first queue after it with any.
+ * Returns NULL if there are none, or the entry with *qp set to its queue.
+ */
+static taskq_ent_t *
+taskq_pcq_take(taskq_t *tq, taskq_pcq_t *home, taskq_pcq_t **qp)
+{
+	uint_t qid = home - tq->tq_pcq;
+	uint_t i;
+
+	for (i = 0; i < tq->tq_npcq; i++) {
+		taskq_pcq_t *q = &tq->tq_pcq[(qid + i) & (tq->tq_npcq - 1)];
+		taskq_ent_t *tqe;
+
+		/* Don't bother with the lock of a queue that looks empty. */
+		if (q->tqq_depth == 0)
+			continue;
+
+		mutex_enter(&q->tqq_lock);
+		if ((q->tqq_flags & TQQ_SUSPEND) ||
+		    (tqe = q->tqq_task.tqent_next) == &q->tqq_task) {
+			mutex_exit(&q->tqq_lock);
+			continue;
+		}
+		tqe->tqent_prev->tqent_next = tqe->tqent_next;
+		tqe->tqent_next->tqent_prev = tqe->tqent_prev;
+		q->tqq_depth--;
+		q->tqq_nrunning++;
+		q->tqq_waittime += gethrtime() - tqe->tqent_time;
+		if (q != home)
+			q->tqq_steals++;
+		mutex_exit(&q->tqq_lock);
+
+		*qp = q;
+		return (tqe);
+	}
+	return (NULL);
+}
+
+/*
+ * Returns B_TRUE if thread 'thread_id' has work to do in taskq_thread() to
+ * apply a change in the number of threads: exiting, creating another thread,
+ * or clearing TASKQ_CHANGING.
+ */
+static boolean_t
+taskq_pcq_changing(taskq_t *tq, int thread_id)
+{
+	return (thread_id > tq->tq_nthreads_target ||
+	    ((tq->tq_flags & (TASKQ_CHANGING | TASKQ_THREAD_CREATED)) ==
+	    TASKQ_CHANGING && tq->tq_nthreads <= tq->tq_nthreads_target));
+}
+
+/*
+ * The part of taskq_thread() specific to TASKQ_PERCPU task queues: execute
+ * tasks until there are none left, then sleep on our home queue until a task
+ * is dispatched.  Returns early if taskq_pcq_changing().
+ *
+ * Assumes: tq->tq_lock is held; it is held again on return.
+ */
+static void
+taskq_pcq_thread(taskq_t *tq, int thread_id, callb_cpr_t *cprinfo)
+{
+	taskq_pcq_t *home = &tq->tq_pcq[(thread_id - 1) & (tq->tq_npcq - 1)];
+	taskq_pcq_t *q;
+	taskq_ent_t *tqe;
+	hrtime_t start, end;
+	boolean_t freeit;
+
+	ASSERT(MUTEX_HELD(&tq->tq_lock));
+	mutex_exit(&tq->tq_lock);
+
+	/*
+	 * Reading tq_flags and the thread counts without tq_lock is only a
+	 * hint; they are checked again below before we sleep.
+	 */
+	while (!taskq_pcq_changing(tq, thread_id) &&
+	    (tqe = taskq_pcq_take(tq, home, &q)) != NULL) {
+		/*
+		 * As in taskq_thread(), a prealloc'd entry belongs to the
+		 * caller again once the function has been called.
+		 */
+		if (tqe->tqent_un.tqent_flags & TQENT_FLAG_PREALLOC) {
+			tqe->tqent_next = tqe->tqent_prev = NULL;
+			freeit = B_FALSE;
+		} else {
+			freeit = B_TRUE;
+		}
+
+		start = gethrtime();
+		DTRACE_PROBE2(taskq__exec__start, taskq_t *, tq,
+		    taskq_ent_t *, tqe);
+		tqe->tqent_func(tqe->tqent_arg);
+		DTRACE_PROBE2(taskq__exec__end, taskq_t *, tq,
+		    taskq_ent_t *, tqe);
+		end = gethrtime();
+
+		mutex_enter(&q->tqq_lock);
+		q->tqq_executed++;
+		q->tqq_totaltime += end - start;
+		if (--q->tqq_nrunning == 0 && (q->tqq_flags & TQQ_SUSPEND))
+			cv_broadcast(&q->tqq_wait_cv);
+		mutex_exit(&q->tqq_lock);
+
+		if (freeit)
+			kmem_cache_free(taskq_ent_cache, tqe);
+	}
+
+	mutex_enter(&tq->tq_lock);
+	if (taskq_pcq_changing(tq, thread_id))
+		return;
+
+	/*
+	 * Announce that we are idle before looking at the queues for the last
+	 * time; a dispatch either sees us or its task is seen here.  The
+	 * barrier pairs with the one in taskq_pcq_wake().
+	 */
+	mutex_enter(&home->tqq_lock);
+	home->tqq_nidle++;
+	atomic_inc_uint(&tq->tq_pcq_nidle);
+	membar_enter();
+	if (taskq_pcq_pending(tq, B_FALSE)) {
+		home->tqq_nidle--;
+		atomic_dec_uint(&tq->tq_pcq_nidle);
+		mutex_exit(&home->tqq_lock);
+		return;
+	}
+
+	if (--tq->tq_active == 0)
+		cv_broadcast(&tq->tq_wait_cv);
+	if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+		CALLB_CPR_SAFE_BEGIN(cprinfo);
+	}
+	mutex_exit(&tq->tq_lock);
+
+	cv_wait(&home->tqq_cv, &home->tqq_lock);
+	home->tqq_nidle--;
+	atomic_dec_uint(&tq->tq_pcq_nidle);
+	mutex_exit(&home->tqq_lock);
+
+	mutex_enter(&tq->tq_lock);
+	if (!(tq->tq_flags & TASKQ_CPR_SAFE)) {
+		CALLB_CPR_SAFE_END(cprinfo, &tq->tq_lock);
+	}
+	tq->tq_active++;
+
+	/*
+	 * If we are about to exit, we may have been woken for a task on our
+	 * home queue; pass that on to another idle thread.
+	 */
+	if (thread_id > tq->tq_nthreads_target && home->tqq_depth != 0)
+		taskq_pcq_wake(tq, home - tq->tq_pcq, tq->tq_npcq);
+}
+
 /*
  * Worker thread for processing task queue.
  */
@@ -1614,6 +2026,10 @@ taskq_thread(void *arg)
 				}
 			}
 		}
+		if (tq->tq_flags & TASKQ_PERCPU) {
+			taskq_pcq_thread(tq, thread_id, &cprinfo);
+			continue;	/* tq_lock was dropped */
+		}
 		if ((tqe = tq->tq_task.tqent_next) == &tq->tq_task) {
 			if (--tq->tq_active == 0)
 				cv_broadcast(&tq->tq_wait_cv);
@@ -1895,6 +2311,7 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 	taskq_t *tq = kmem_cache_alloc(taskq_cache, KM_SLEEP);
 	uint_t ncpus = ((boot_max_ncpus == -1) ? max_ncpus : boot_max_ncpus);
 	uint_t bsize;	/* # of buckets - always power of 2 */
+	uint_t npcq = 0;	/* # of per-CPU queues - always power of 2 */
 	int max_nthreads;
 
 	/*
@@ -1908,6 +2325,9 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 	/* Cannot have DYNAMIC with DUTY_CYCLE */
 	IMPLY((flags & TASKQ_DYNAMIC), !(flags & TASKQ_DUTY_CYCLE));
 
+	/* Cannot have DYNAMIC with PERCPU */
+	IMPLY((flags & TASKQ_DYNAMIC), !(flags & TASKQ_PERCPU));
+
 	/* Cannot have DUTY_CYCLE with a p0 kernel process */
 	IMPLY((flags & TASKQ_DUTY_CYCLE), proc != &p0);
 
@@ -1952,6 +2372,12 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 		max_nthreads = nthreads;
 	}
 
+	/*
+	 * Don't have more per-CPU queues than threads to serve them.
+	 */
+	if (flags & TASKQ_PERCPU)
+		npcq = MIN(bsize, 1 << (highbit(max_nthreads) - 1));
+
 	if (max_nthreads < taskq_minimum_nthreads_max)
 		max_nthreads = taskq_minimum_nthreads_max;
 
@@ -1979,6 +2405,27 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 		tq->tq_threadlist = kmem_alloc(
 		    sizeof (kthread_t *) * max_nthreads, KM_SLEEP);
 
+	/*
+	 * The per-CPU queues must be in place before the first thread starts.
+	 * Since their size is a multiple of 64 bytes, kmem_zalloc() gives them
+	 * the alignment they ask for.
+	 */
+	if (flags & TASKQ_PERCPU) {
+		taskq_pcq_t *q;
+		uint_t qid;
+
+		tq->tq_npcq = npcq;
+		tq->tq_pcq = kmem_zalloc(sizeof (taskq_pcq_t) * npcq, KM_SLEEP);
+		for (qid = 0; qid < npcq; qid++) {
+			q = &tq->tq_pcq[qid];
+			mutex_init(&q->tqq_lock, NULL, MUTEX_DEFAULT, NULL);
+			cv_init(&q->tqq_cv, NULL, CV_DEFAULT, NULL);
+			cv_init(&q->tqq_wait_cv, NULL, CV_DEFAULT, NULL);
+			q->tqq_task.tqent_next = q->tqq_task.tqent_prev =
+			    &q->tqq_task;
+		}
+	}
+
 	mutex_enter(&tq->tq_lock);
 	if (flags & TASKQ_PREPOPULATE) {
 		while (minalloc-- > 0)
@@ -2059,6 +2506,27 @@ taskq_create_common(const char *name, int instance, int nthreads, pri_t pri,
 		}
 	}
 
+	if ((flags & TASKQ_PERCPU) &&
+	    (tq->tq_pcq_kstat = kstat_create("taskq", instance, tq->tq_name,
+	    "taskq_pcq", KSTAT_TYPE_NAMED, npcq * TASKQ_PCQ_NSTATS, 0)) !=
+	    NULL) {
+		kstat_named_t *knp = tq->tq_pcq_kstat->ks_data;
+		char name[KSTAT_STRLEN];
+		uint_t qid, i;
+
+		for (qid = 0; qid < npcq; qid++) {
+			for (i = 0; i < TASKQ_PCQ_NSTATS; i++) {
+				(void) snprintf(name, sizeof (name), "q%u_%s",
+				    qid, taskq_pcq_kstat_names[i]);
+				kstat_named_init(knp++, name,
+				    KSTAT_DATA_UINT64);
+			}
+		}
+		tq->tq_pcq_kstat->ks_update = taskq_pcq_kstat_update;
+		tq->tq_pcq_kstat->ks_private = tq;
+		kstat_install(tq->tq_pcq_kstat);
+	}
+
 	return (tq);
 }
 
@@ -2083,6 +2551,10 @@ taskq_destroy(taskq_t *tq)
 		kstat_delete(tq->tq_kstat);
 		tq->tq_kstat = NULL;
 	}
+	if (tq->tq_pcq_kstat != NULL) {
+		kstat_delete(tq->tq_pcq_kstat);
+		tq->tq_pcq_kstat = NULL;
+	}
 
 	/*
 	 * Destroy instance if needed.
@@ -2115,6 +2587,8 @@ taskq_destroy(taskq_t *tq)
 	tq->tq_flags |= TASKQ_CHANGING;
 	cv_broadcast(&tq->tq_dispatch_cv);
 	cv_broadcast(&tq->tq_exit_cv);
+	if (tq->tq_flags & TASKQ_PERCPU)
+		taskq_pcq_wakeall(tq);
 
 	while (tq->tq_nthreads != 0)
 		cv_wait(&tq->tq_wait_cv, &tq->tq_lock);
@@ -2129,6 +2603,25 @@ taskq_destroy(taskq_t *tq)
 
 	mutex_exit(&tq->tq_lock);
 
+	if (tq->tq_pcq != NULL) {
+		uint_t qid;
+
+		ASSERT(tq->tq_flags & TASKQ_PERCPU);
+		ASSERT0(tq->tq_pcq_nidle);
+		for (qid = 0; qid < tq->tq_npcq; qid++) {
+			taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+			ASSERT(IS_EMPTY(q->tqq_task));
+			ASSERT0(q->tqq_nrunning);
+			mutex_destroy(&q->tqq_lock);
+			cv_destroy(&q->tqq_cv);
+			cv_destroy(&q->tqq_wait_cv);
+		}
+		kmem_free(tq->tq_pcq, sizeof (taskq_pcq_t) * tq->tq_npcq);
+		tq->tq_pcq = NULL;
+		tq->tq_npcq = 0;
+	}
+
 	/*
 	 * Mark each bucket as closing and wakeup all sleeping threads.
 	 */
@@ -2287,6 +2780,23 @@ taskq_kstat_update(kstat_t *ksp, int rw)
 	tqsp->tq_pri.value.ui64 = tq->tq_pri;
 	tqsp->tq_nthreads.value.ui64 = tq->tq_nthreads;
 	tqsp->tq_nomem.value.ui64 = tq->tq_nomem;
+
+	/*
+	 * For TASKQ_PERCPU task queues, maxtasks is the sum of the per-queue
+	 * maximums, so it is an upper bound.
+	 */
+	if (tq->tq_flags & TASKQ_PERCPU) {
+		uint_t qid;
+
+		for (qid = 0; qid < tq->tq_npcq; qid++) {
+			taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+			tqsp->tq_tasks.value.ui64 += q->tqq_tasks;
+			tqsp->tq_executed.value.ui64 += q->tqq_executed;
+			tqsp->tq_maxtasks.value.ui64 += q->tqq_maxdepth;
+			tqsp->tq_totaltime.value.ui64 += q->tqq_totaltime;
+		}
+	}
 	return (0);
 }
 
@@ -2340,3 +2850,30 @@ taskq_d_kstat_update(kstat_t *ksp, int rw)
 	}
 	return (0);
 }
+
+static int
+taskq_pcq_kstat_update(kstat_t *ksp, int rw)
+{
+	kstat_named_t *knp = ksp->ks_data;
+	taskq_t *tq = ksp->ks_private;
+	uint_t qid;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	ASSERT(tq->tq_flags & TASKQ_PERCPU);
+
+	/* In the order of taskq_pcq_kstat_names[] */
+	for (qid = 0; qid < tq->tq_npcq; qid++) {
+		taskq_pcq_t *q = &tq->tq_pcq[qid];
+
+		(knp++)->value.ui64 = q->tqq_tasks;
+		(knp++)->value.ui64 = q->tqq_executed;
+		(knp++)->value.ui64 = q->tqq_depth;
+		(knp++)->value.ui64 = q->tqq_maxdepth;
+		(knp++)->value.ui64 = q->tqq_steals;
+		(knp++)->value.ui64 = q->tqq_waittime;
+		(knp++)->value.ui64 = q->tqq_totaltime;
+	}
+	return (0);
+}
@@ -66,6 +66,7 @@
 #include <sys/time.h>
 #include <sys/zone.h>
 #include <sys/stdbool.h>
+#include <sys/atomic.h>
 
 #include <vm/hat.h>
 #include <vm/as.h>
@@ -75,6 +76,7 @@
 #include <vm/seg_kmem.h>
 
 static int checkpage(page_t *, int);
+static void pageout_shadow_init(void);
 
 /*
  * The following parameters control operation of the page replacement
@@ -889,6 +891,8 @@ pageout()
 	for (i = 0; i < async_list_size - 1; i++)
 		push_req[i].a_next = &push_req[i + 1];
 
+	pageout_shadow_init();
+
 	pageout_pri = curthread->t_pri;
 
 	/* Create the (first) pageout scanner thread. */
@@ -1261,6 +1265,131 @@ reset:
 	pageout_pushcount_seen = pageout_pushcount;
 }
 
+/*
+ * Refault tracking.  The clock decides on the reference bit alone, so a
+ * one-off scan of a large file can push hot pages out of memory, only for
+ * them to be faulted straight back in.  To notice this, each file page freed
+ * by checkpage() leaves a shadow entry behind: its vnode and offset, and the
+ * value of pageout_evictions, which counts every page pageout frees.  The
+ * table of shadows is direct-mapped, so a newer eviction simply replaces an
+ * older one that hashes to the same entry, and entries hold no reference on
+ * their vnode; a stale match only costs a misjudged refault.
+ *
+ * When a page is reclaimed from the cachelist or created anew,
+ * pageout_refault() looks for its shadow.  The number of pages evicted since
+ * is the refault distance: had there been that many more pages of memory,
+ * the page would never have left.  If the distance is no more than the
+ * memory in use, the page was part of the working set and is thrashing, so
+ * it is marked P_REFAULT; checkpage() then passes over it once more before
+ * freeing it.  Refaults and thrashing are counted against the faulting zone,
+ * in its memory_cap kstat.
+ */
+typedef struct pageout_shadow {
+	vnode_t		*ps_vp;
+	u_offset_t	ps_off;
+	uint64_t	ps_evict;	/* pageout_evictions when evicted */
+} pageout_shadow_t;
+
+#define	PAGEOUT_SHADOW_LOCKS	256
+
+int		pageout_refault_enable = 1;
+ulong_t		pageout_shadow_size = 0;	/* entries, 0 for default */
+
+static uint64_t		pageout_evictions;
+static pageout_shadow_t	*pageout_shadows;
+static ulong_t		pageout_shadow_mask;
+static kmutex_t		pageout_shadow_locks[PAGEOUT_SHADOW_LOCKS];
+
+#define	PAGEOUT_SHADOW_IDX(vp, off)					\
+	((((uintptr_t)(vp) >> 7) + ((off) >> PAGESHIFT)) & pageout_shadow_mask)
+
+#define	PAGEOUT_SHADOW_LOCK(idx)					\
+	(&pageout_shadow_locks[(idx) & (PAGEOUT_SHADOW_LOCKS - 1)])
+
+/*
+ * By default, there is one shadow for every eight pages of memory.
+ */
+static void
+pageout_shadow_init(void)
+{
+	int i;
+
+	if (pageout_shadow_size == 0)
+		pageout_shadow_size = total_pages / 8;
+	pageout_shadow_size = 1UL << (highbit(MAX(pageout_shadow_size,
+	    PAGEOUT_SHADOW_LOCKS)) - 1);
+	pageout_shadow_mask = pageout_shadow_size - 1;
+
+	for (i = 0; i < PAGEOUT_SHADOW_LOCKS; i++) {
+		mutex_init(&pageout_shadow_locks[i], NULL, MUTEX_DEFAULT,
+		    NULL);
+	}
+	pageout_shadows = kmem_zalloc(pageout_shadow_size *
+	    sizeof (pageout_shadow_t), KM_SLEEP);
+}
+
+/*
+ * Count a page freed by pageout, and remember it if it belongs to a file.
+ */
+static void
+pageout_evict(vnode_t *vp, u_offset_t off, int isfs)
+{
+	pageout_shadow_t *ps;
+	uint64_t evict;
+	ulong_t idx;
+
+	evict = atomic_inc_64_nv(&pageout_evictions);
+	if (!isfs || !pageout_refault_enable)
+		return;
+
+	idx = PAGEOUT_SHADOW_IDX(vp, off);
+	ps = &pageout_shadows[idx];
+	mutex_enter(PAGEOUT_SHADOW_LOCK(idx));
+	ps->ps_vp = vp;
+	ps->ps_off = off;
+	ps->ps_evict = evict;
+	mutex_exit(PAGEOUT_SHADOW_LOCK(idx));
+}
+
+/*
+ * Called with the page locked SE_EXCL when it is given back its identity,
+ * either by page_reclaim() or page_create_va().
+ */
+void
+pageout_refault(page_t *pp)
+{
+	vnode_t *vp = pp->p_vnode;
+	u_offset_t off = pp->p_offset;
+	pageout_shadow_t *ps;
+	uint64_t distance;
+	ulong_t idx;
+
+	ASSERT(PAGE_EXCL(pp));
+
+	if (pageout_shadows == NULL || vp == NULL)
+		return;
+
+	idx = PAGEOUT_SHADOW_IDX(vp, off);
+	ps = &pageout_shadows[idx];
+	if (ps->ps_vp != vp || ps->ps_off != off)
+		return;
+
+	mutex_enter(PAGEOUT_SHADOW_LOCK(idx));
+	if (ps->ps_vp != vp || ps->ps_off != off) {
+		mutex_exit(PAGEOUT_SHADOW_LOCK(idx));
+		return;
+	}
+	distance = pageout_evictions - ps->ps_evict;
+	ps->ps_vp = NULL;
+	mutex_exit(PAGEOUT_SHADOW_LOCK(idx));
+
+	atomic_inc_64(&curzone->zone_refault);
+	if (distance <= total_pages - MIN(freemem, total_pages)) {
+		PP_SETREFAULT(pp);
+		atomic_inc_64(&curzone->zone_thrash);
+	}
+}
+
 /*
  * Look at the page at hand.  If it is locked (e.g., for physical i/o),
  * system (u., page table) or free, then leave it alone.  Otherwise,
@@ -1378,6 +1507,19 @@ recheck:
 		return (0);
 	}
 
+	/*
+	 * A page that refaulted while thrashing is given one more trip
+	 * around the clock.  Neither hand frees it this time around; the
+	 * back hand clears the mark, so it is judged normally by the next
+	 * pair of hands to pass.
+	 */
+	if (PP_ISREFAULT(pp)) {
+		if (whichhand == BACK)
+			PP_CLRREFAULT(pp);
+		page_unlock(pp);
+		return (0);
+	}
+
 	/*
 	 * This page is not referenced, so it must be reclaimable and we can
 	 * add it to the free list. This can be done by either hand.
@@ -1435,6 +1577,7 @@ recheck:
 			VN_RELE(vp);
 			return (0);
 		}
+		pageout_evict(vp, offset, isfs);
 		if (isfs) {
 			zone_pageout_stat(zid, ZPO_DIRTY);
 		} else {
@@ -1456,6 +1599,8 @@ recheck:
 	if ((ppattr & P_REF) || ((ppattr & P_MOD) && pp->p_vnode))
 		goto recheck;
 
+	pageout_evict(pp->p_vnode, pp->p_offset, isfs);
+
 	/*LINTED: constant in conditional context*/
 	VN_DISPOSE(pp, B_FREE, 0, kcred);
 
@@ -2312,6 +2312,8 @@ zone_mcap_kstat_update(kstat_t *ksp, int rw)
 	zmp->zm_execpgin.value.ui64 = zone->zone_execpgin;
 	zmp->zm_fspgin.value.ui64 = zone->zone_fspgin;
 	zmp->zm_anon_alloc_fail.value.ui64 = zone->zone_anon_alloc_fail;
+	zmp->zm_refault.value.ui64 = zone->zone_refault;
+	zmp->zm_thrash.value.ui64 = zone->zone_thrash;
 
 	return (0);
 }
@@ -2351,6 +2353,8 @@ zone_mcap_kstat_create(zone_t *zone)
 	kstat_named_init(&zmp->zm_fspgin, "fspgin", KSTAT_DATA_UINT64);
 	kstat_named_init(&zmp->zm_anon_alloc_fail, "anon_alloc_fail",
 	    KSTAT_DATA_UINT64);
+	kstat_named_init(&zmp->zm_refault, "refaults", KSTAT_DATA_UINT64);
+	kstat_named_init(&zmp->zm_thrash, "thrashing", KSTAT_DATA_UINT64);
 
 	ksp->ks_update = zone_mcap_kstat_update;
 	ksp->ks_private = zone;
@@ -2396,6 +2400,9 @@ zone_misc_kstat_update(kstat_t *ksp, int rw)
 
 	zmp->zm_mfseglim.value.ui32 = zone->zone_mfseglim;
 
+	zmp->zm_thp_promote.value.ui64 = zone->zone_thp_promote;
+	zmp->zm_thp_demote.value.ui64 = zone->zone_thp_demote;
+
 	zmp->zm_nested_intp.value.ui32 = zone->zone_nested_intp;
 
 	zmp->zm_init_pid.value.ui32 = zone->zone_proc_initpid;
@@ -2442,6 +2449,9 @@ zone_misc_kstat_create(zone_t *zone)
 	kstat_named_init(&zmp->zm_ffmisc, "forkfail_misc", KSTAT_DATA_UINT32);
 	kstat_named_init(&zmp->zm_mfseglim, "mapfail_seglim",
 	    KSTAT_DATA_UINT32);
+	kstat_named_init(&zmp->zm_thp_promote, "lpg_promote",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&zmp->zm_thp_demote, "lpg_demote", KSTAT_DATA_UINT64);
 	kstat_named_init(&zmp->zm_nested_intp, "nested_interp",
 	    KSTAT_DATA_UINT32);
 	kstat_named_init(&zmp->zm_init_pid, "init_pid", KSTAT_DATA_UINT32);
@@ -102,6 +102,7 @@ struct bd_xfer {
 };
 
 #define	BD_XFER_POLL		(1U << 0)	/* no interrupts (dump) */
+#define	BD_XFER_HIPRI		(1U << 1)	/* latency sensitive */
 
 struct bd_drive {
 	uint32_t		d_qsize;
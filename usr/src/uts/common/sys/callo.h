@@ -25,6 +25,7 @@
 /*
  * Copyright 2010 Sun Microsystems, Inc.  All rights reserved.
  * Use is subject to license terms.
+ * Copyright 2026 Joyent, Inc.
  */
 
 #ifndef _SYS_CALLO_H
@@ -230,6 +231,8 @@ typedef struct callout_hash {
  *	Callout list is present in the callout heap.
  * CALLOUT_LIST_FLAG_QUEUED
  *	Callout list is present in the callout queue.
+ * CALLOUT_LIST_FLAG_WHEELED
+ *	Callout list is present in the timer wheel.
  */
 #define	CALLOUT_LIST_FLAG_FREE			0x1
 #define	CALLOUT_LIST_FLAG_ABSOLUTE		0x2
@@ -237,6 +240,7 @@ typedef struct callout_hash {
 #define	CALLOUT_LIST_FLAG_NANO			0x8
 #define	CALLOUT_LIST_FLAG_HEAPED		0x10
 #define	CALLOUT_LIST_FLAG_QUEUED		0x20
+#define	CALLOUT_LIST_FLAG_WHEELED		0x40
 
 struct callout_list {
 	callout_list_t	*cl_next;	/* next in clhash */
@@ -244,6 +248,9 @@ struct callout_list {
 	hrtime_t	cl_expiration;	/* expiration for callouts in list */
 	callout_hash_t	cl_callouts;	/* list of callouts */
 	int		cl_flags;	/* callout flags */
+	callout_list_t	*cl_wnext;	/* next in wheel slot */
+	callout_list_t	*cl_wprev;	/* prev in wheel slot */
+	callout_hash_t	*cl_wslot;	/* wheel slot */
 };
 
 /*
@@ -275,6 +282,29 @@ typedef struct callout_heap {
 #define	CALLOUT_CLEANUP(ct)	((ct->ct_nreap >= callout_min_reap) &&	\
 				    (ct->ct_nreap >= (ct->ct_heap_num >> 1)))
 
+/*
+ * Hierarchical timer wheel, used in place of the heap for callout lists of
+ * tick resolution or coarser when callout_wheel is set; see callout.c. Each
+ * level has CALLOUT_WHEEL_SLOTS slots, and a slot at level L spans
+ * CALLOUT_WHEEL_SLOTS^L wheel ticks of cw_res nanoseconds. The occupancy
+ * bitmap of each level lets the next non-empty slot be found without
+ * walking the slots. Callout lists too far out for the last level are kept
+ * in cw_overflow.
+ */
+#define	CALLOUT_WHEEL_SHIFT	6
+#define	CALLOUT_WHEEL_SLOTS	(1 << CALLOUT_WHEEL_SHIFT)
+#define	CALLOUT_WHEEL_MASK	(CALLOUT_WHEEL_SLOTS - 1)
+#define	CALLOUT_WHEEL_LEVELS	4
+
+typedef struct callout_wheel {
+	hrtime_t	cw_res;		/* nanoseconds per wheel tick */
+	hrtime_t	cw_now;		/* last wheel tick processed */
+	hrtime_t	cw_next;	/* expiration of the wheel cyclic */
+	uint64_t	cw_map[CALLOUT_WHEEL_LEVELS];	/* occupied slots */
+	callout_hash_t	cw_slots[CALLOUT_WHEEL_LEVELS][CALLOUT_WHEEL_SLOTS];
+	callout_hash_t	cw_overflow;	/* beyond the last level */
+} callout_wheel_t;
+
 /*
  * Per-callout table kstats.
  *
@@ -296,6 +326,12 @@ typedef struct callout_heap {
  *	Number of callout structures allocated.
  * CALLOUT_CLEANUPS
  *	Number of times a callout table is cleaned up.
+ * CALLOUT_WHEEL_TICKS
+ *	Number of timer wheel ticks at which callout lists expired.
+ * CALLOUT_WHEEL_LISTS_MAX
+ *	Largest number of callout lists expired at a single wheel tick.
+ * CALLOUT_WHEEL_CASCADES
+ *	Number of callout lists moved down a level of the timer wheel.
  */
 typedef enum callout_stat_type {
 	CALLOUT_TIMEOUTS,
@@ -306,6 +342,9 @@ typedef enum callout_stat_type {
 	CALLOUT_EXPIRATIONS,
 	CALLOUT_ALLOCATIONS,
 	CALLOUT_CLEANUPS,
+	CALLOUT_WHEEL_TICKS,
+	CALLOUT_WHEEL_LISTS_MAX,
+	CALLOUT_WHEEL_CASCADES,
 	CALLOUT_NUM_STATS
 } callout_stat_type_t;
 
@@ -328,11 +367,17 @@ typedef enum callout_stat_type {
  * CALLOUT_FLAG_32BIT
  *	Legacy interfaces timeout() and realtime_timeout() pass this flag
  *	to timeout_generic() to indicate that a 32-bit ID should be allocated.
+ * CALLOUT_FLAG_SLACK
+ *	The resolution passed is a tolerance: the callout may run up to that
+ *	much after its expiration. The expiration is rounded up, as with
+ *	CALLOUT_FLAG_ROUNDUP, and the timer wheel may round it up further
+ *	so that it can be coalesced with other callouts.
  */
 #define	CALLOUT_FLAG_ROUNDUP		0x1
 #define	CALLOUT_FLAG_ABSOLUTE		0x2
 #define	CALLOUT_FLAG_HRESTIME		0x4
 #define	CALLOUT_FLAG_32BIT		0x8
+#define	CALLOUT_FLAG_SLACK		0x10
 
 /*
  * On 32-bit systems, the legacy interfaces, timeout() and realtime_timeout(),
@@ -375,8 +420,12 @@ typedef struct callout_table {
 	int		ct_nreap;	/* # heap entries that need reaping */
 	cyclic_id_t	ct_qcyclic;	/* cyclic for the callout queue */
 	callout_hash_t	ct_queue;	/* overflow queue of callouts */
-#ifndef _LP64
-	char		ct_pad[12];	/* cache alignment */
+	callout_wheel_t	*ct_wheel;	/* timer wheel, if enabled */
+	cyclic_id_t	ct_wcyclic;	/* cyclic for the timer wheel */
+#ifdef _LP64
+	char		ct_pad[48];	/* cache alignment */
+#else
+	char		ct_pad[4];	/* cache alignment */
 #endif
 	/*
 	 * This structure should be aligned to a 64-byte (cache-line)
@@ -404,6 +453,12 @@ typedef struct callout_table {
 		ct_kstat_data[CALLOUT_ALLOCATIONS].value.ui64
 #define	ct_cleanups							\
 		ct_kstat_data[CALLOUT_CLEANUPS].value.ui64
+#define	ct_wheel_ticks							\
+		ct_kstat_data[CALLOUT_WHEEL_TICKS].value.ui64
+#define	ct_wheel_lists_max						\
+		ct_kstat_data[CALLOUT_WHEEL_LISTS_MAX].value.ui64
+#define	ct_wheel_cascades						\
+		ct_kstat_data[CALLOUT_WHEEL_CASCADES].value.ui64
 
 /*
  * CALLOUT_CHUNK is the minimum initial size of each heap, and the amount
@@ -439,6 +494,8 @@ typedef struct callout_table {
 
 #define	CALLOUT_TOLERANCE	200000		/* nanoseconds */
 
+extern boolean_t	callout_wheel_enabled;
+
 extern void		callout_init(void);
 extern void		membar_sync(void);
 extern void		callout_cpu_online(cpu_t *);
@@ -0,0 +1,233 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * Header file to support shared-memory submission and completion rings for
+ * file and socket I/O.  This facility is designed to be binary compatible
+ * with the Linux io_uring facility: the ring layout, the submission and
+ * completion queue entries, and the values of the constants here exactly
+ * match those found in Linux, so that the lx brand can hand the rings of a
+ * Linux process straight to the native implementation.  Only the subset of
+ * operations and flags defined here is supported; anything else is rejected
+ * with EINVAL, as Linux does for operations it does not know about.
+ */
+
+#ifndef _SYS_IO_URING_H
+#define	_SYS_IO_URING_H
+
+#include <sys/types.h>
+#include <sys/signal.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Submission queue entry.  The union members of the Linux definition are
+ * collapsed into the first member of each; the layout is identical.
+ */
+struct io_uring_sqe {
+	uint8_t		opcode;		/* IORING_OP_* */
+	uint8_t		flags;		/* IOSQE_* */
+	uint16_t	ioprio;		/* ignored */
+	int32_t		fd;		/* fd, or index if IOSQE_FIXED_FILE */
+	uint64_t	off;		/* file offset, or addr2 */
+	uint64_t	addr;		/* buffer or iovec pointer */
+	uint32_t	len;		/* buffer length or iovec count */
+	uint32_t	op_flags;	/* per-operation flags */
+	uint64_t	user_data;	/* returned in the completion */
+	uint16_t	buf_index;	/* registered buffer, for *_FIXED */
+	uint16_t	personality;	/* must be zero */
+	int32_t		splice_fd_in;	/* must be zero */
+	uint64_t	__pad2[2];
+};
+
+#define	IOSQE_FIXED_FILE	(1U << 0)	/* fd is a registered file */
+#define	IOSQE_IO_DRAIN		(1U << 1)	/* not supported */
+#define	IOSQE_IO_LINK		(1U << 2)	/* not supported */
+#define	IOSQE_IO_HARDLINK	(1U << 3)	/* not supported */
+#define	IOSQE_ASYNC		(1U << 4)	/* hint; always accepted */
+
+#define	IORING_OP_NOP		0
+#define	IORING_OP_READV		1
+#define	IORING_OP_WRITEV	2
+#define	IORING_OP_FSYNC		3
+#define	IORING_OP_READ_FIXED	4
+#define	IORING_OP_WRITE_FIXED	5
+#define	IORING_OP_POLL_ADD	6
+#define	IORING_OP_POLL_REMOVE	7
+#define	IORING_OP_ACCEPT	13
+#define	IORING_OP_ASYNC_CANCEL	14
+#define	IORING_OP_READ		22
+#define	IORING_OP_WRITE		23
+#define	IORING_OP_SEND		26
+#define	IORING_OP_RECV		27
+#define	IORING_OP_LAST		28
+
+#define	IORING_FSYNC_DATASYNC	(1U << 0)	/* op_flags for FSYNC */
+
+/*
+ * Completion queue entry.  res is the result of the operation, or a negated
+ * errno value.
+ */
+struct io_uring_cqe {
+	uint64_t	user_data;	/* from the submission */
+	int32_t		res;		/* result */
+	uint32_t	flags;		/* always zero */
+};
+
+/*
+ * Offsets of the fields of the rings within their mappings, as returned by
+ * io_uring_setup().
+ */
+struct io_sqring_offsets {
+	uint32_t	head;
+	uint32_t	tail;
+	uint32_t	ring_mask;
+	uint32_t	ring_entries;
+	uint32_t	flags;
+	uint32_t	dropped;
+	uint32_t	array;
+	uint32_t	resv1;
+	uint64_t	resv2;
+};
+
+struct io_cqring_offsets {
+	uint32_t	head;
+	uint32_t	tail;
+	uint32_t	ring_mask;
+	uint32_t	ring_entries;
+	uint32_t	overflow;
+	uint32_t	cqes;
+	uint32_t	flags;
+	uint32_t	resv1;
+	uint64_t	resv2;
+};
+
+struct io_uring_params {
+	uint32_t	sq_entries;
+	uint32_t	cq_entries;
+	uint32_t	flags;		/* IORING_SETUP_* */
+	uint32_t	sq_thread_cpu;
+	uint32_t	sq_thread_idle;
+	uint32_t	features;	/* IORING_FEAT_*, returned */
+	uint32_t	wq_fd;
+	uint32_t	resv[3];
+	struct io_sqring_offsets sq_off;
+	struct io_cqring_offsets cq_off;
+};
+
+#define	IORING_SETUP_CQSIZE	(1U << 3)	/* cq_entries is specified */
+#define	IORING_SETUP_CLAMP	(1U << 4)	/* clamp entries to maximum */
+
+#define	IORING_FEAT_SINGLE_MMAP		(1U << 0)
+#define	IORING_FEAT_SUBMIT_STABLE	(1U << 2)
+#define	IORING_FEAT_RW_CUR_POS		(1U << 3)
+
+#define	IORING_MAX_ENTRIES	32768
+#define	IORING_MAX_CQ_ENTRIES	(2 * IORING_MAX_ENTRIES)
+
+/*
+ * mmap(2) offsets of the rings.  With IORING_FEAT_SINGLE_MMAP, the mapping
+ * at IORING_OFF_SQ_RING also contains the completion queue.
+ */
+#define	IORING_OFF_SQ_RING	0ULL
+#define	IORING_OFF_CQ_RING	0x8000000ULL
+#define	IORING_OFF_SQES		0x10000000ULL
+
+#define	IORING_ENTER_GETEVENTS	(1U << 0)
+
+#define	IORING_REGISTER_BUFFERS		0
+#define	IORING_UNREGISTER_BUFFERS	1
+#define	IORING_REGISTER_FILES		2
+#define	IORING_UNREGISTER_FILES		3
+#define	IORING_REGISTER_EVENTFD		4
+#define	IORING_UNREGISTER_EVENTFD	5
+#define	IORING_REGISTER_PROBE		8
+
+#define	IO_URING_OP_SUPPORTED	(1U << 0)
+
+struct io_uring_probe_op {
+	uint8_t		op;
+	uint8_t		resv;
+	uint16_t	flags;		/* IO_URING_OP_* */
+	uint32_t	resv2;
+};
+
+struct io_uring_probe {
+	uint8_t		last_op;	/* last opcode supported */
+	uint8_t		ops_len;	/* length of ops[] */
+	uint16_t	resv;
+	uint32_t	resv2[3];
+	struct io_uring_probe_op ops[];
+};
+
+/*
+ * These ioctl values are specific to the native implementation; applications
+ * shouldn't be using them directly, and they should therefore be safe to
+ * change without breaking apps.
+ */
+#define	URINGIOC		(('u' << 24) | ('r' << 16) | ('g' << 8))
+#define	URINGIOC_SETUP		(URINGIOC | 1)	/* io_uring_setup() */
+#define	URINGIOC_ENTER		(URINGIOC | 2)	/* io_uring_enter() */
+#define	URINGIOC_REGISTER	(URINGIOC | 3)	/* io_uring_register() */
+
+typedef struct uring_enter {
+	uint32_t	ue_to_submit;
+	uint32_t	ue_min_complete;
+	uint32_t	ue_flags;	/* IORING_ENTER_* */
+	uint32_t	ue_pad;
+	uint64_t	ue_sigmask;	/* sigset_t *, or 0 */
+} uring_enter_t;
+
+typedef struct uring_register {
+	uint32_t	ur_opcode;	/* IORING_REGISTER_* */
+	uint32_t	ur_nr_args;
+	uint64_t	ur_arg;		/* user pointer */
+} uring_register_t;
+
+#ifndef _KERNEL
+
+extern int io_uring_setup(uint32_t, struct io_uring_params *);
+extern int io_uring_enter(int, uint32_t, uint32_t, uint32_t, const sigset_t *);
+extern int io_uring_register(int, uint32_t, void *, uint32_t);
+
+#else
+
+#define	URINGMNRN_URING		0
+#define	URINGMNRN_CLONE		1
+
+/*
+ * Kernel-internal method by which a brand supplies translations for the
+ * foreign values found in its processes' submissions and completions.  Each
+ * translation into native values returns 0 or an errno.
+ */
+typedef struct uring_xlate {
+	int	(*ux_errno)(int);		/* native errno to foreign */
+	int	(*ux_msgflags)(uint32_t, int *); /* SEND/RECV flags */
+	int	(*ux_sockflags)(uint32_t, int *); /* ACCEPT flags */
+	int	(*ux_pollevents)(uint32_t, short *); /* POLL_ADD events */
+	uint32_t (*ux_revents)(short, uint32_t); /* POLL_ADD result */
+} uring_xlate_t;
+
+#define	URINGIOC_XLATE		(URINGIOC | 4)	/* FKIOCTL only */
+
+#endif /* _KERNEL */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_IO_URING_H */
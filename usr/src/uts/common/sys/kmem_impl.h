@@ -49,7 +49,7 @@ extern "C" {
  * Lock order:
  * 1. cache_lock
  * 2. cc_lock in order by CPU ID
- * 3. cache_depot_lock
+ * 3. kd_lock of each depot in order by lgroup ID
  *
  * Do not call kmem_cache_alloc() or taskq_dispatch() while holding any of the
  * above locks.
@@ -220,6 +220,7 @@ typedef struct kmem_buftag_lite {
 /* slab_flags */
 #define	KMEM_SLAB_NOMOVE	0x1
 #define	KMEM_SLAB_MOVE_PENDING	0x2
+#define	KMEM_SLAB_KEY		0x4	/* AVL search key, not a slab */
 
 typedef struct kmem_slab {
 	struct kmem_cache	*slab_cache;	/* controlling cache */
@@ -230,7 +231,8 @@ typedef struct kmem_slab {
 	long			slab_chunks;	/* chunks (bufs) in this slab */
 	uint32_t		slab_stuck_offset; /* unmoved buffer offset */
 	uint16_t		slab_later_count; /* cf KMEM_CBRC_LATER */
-	uint16_t		slab_flags;	/* bits to mark the slab */
+	uint8_t			slab_flags;	/* bits to mark the slab */
+	uint8_t			slab_lgrp;	/* lgroup of slab's memory */
 } kmem_slab_t;
 
 #define	KMEM_HASH_INITIAL	64
@@ -261,6 +263,8 @@ typedef struct kmem_magtype {
 	5 * sizeof (short))
 #define	KMEM_CACHE_SIZE(ncpus)	\
 	((size_t)(&((kmem_cache_t *)0)->cache_cpu[ncpus]))
+#define	KMEM_DEPOT_SIZE(ndepots)	\
+	((size_t)(ndepots) * sizeof (kmem_depot_t))
 
 /* Offset from kmem_cache->cache_cpu for per cpu caches */
 #define	KMEM_CPU_CACHE_OFFSET(cpuid)					\
@@ -293,6 +297,26 @@ typedef struct kmem_maglist {
 	uint64_t	ml_alloc;	/* allocations from this list */
 } kmem_maglist_t;
 
+/*
+ * The depot is split by lgroup, so that a CPU exchanges magazines only with
+ * other CPUs in its lgroup and the objects it gets back were most likely
+ * constructed in node-local memory.  A cache has one depot for each possible
+ * lgroup ID (cache_ndepots), which follow the per-CPU caches in the same
+ * allocation; with a single lgroup, or kmem_lgrp_local turned off, there is
+ * just the one.
+ */
+#define	KMEM_DEPOT_PAD		(2 * KMEM_CPU_CACHE_SIZE - sizeof (kmutex_t) - \
+	2 * sizeof (kmem_maglist_t) - 2 * sizeof (uint64_t))
+
+typedef struct kmem_depot {
+	kmutex_t	kd_lock;		/* protects this depot */
+	kmem_maglist_t	kd_full;		/* full magazines */
+	kmem_maglist_t	kd_empty;		/* empty magazines */
+	uint64_t	kd_contention;		/* mutex contention count */
+	uint64_t	kd_contention_prev;	/* previous snapshot */
+	char		kd_pad[KMEM_DEPOT_PAD];	/* for nice alignment */
+} kmem_depot_t;
+
 typedef struct kmem_defrag {
 	/*
 	 * Statistics
@@ -352,8 +376,7 @@ struct kmem_cache {
 	uint64_t	cache_reap;		/* cache reaps */
 	uint64_t	cache_rescale;		/* hash table rescales */
 	uint64_t	cache_lookup_depth;	/* hash lookup depth */
-	uint64_t	cache_depot_contention;	/* mutex contention count */
-	uint64_t	cache_depot_contention_prev; /* previous snapshot */
+	uint64_t	cache_slab_alloc_remote; /* slab allocs off-lgroup */
 
 	/*
 	 * Cache properties
@@ -401,10 +424,9 @@ struct kmem_cache {
 	/*
 	 * Depot layer
 	 */
-	kmutex_t	cache_depot_lock;	/* protects depot */
 	kmem_magtype_t	*cache_magtype;		/* magazine type */
-	kmem_maglist_t	cache_full;		/* full magazines */
-	kmem_maglist_t	cache_empty;		/* empty magazines */
+	kmem_depot_t	*cache_depot;		/* per-lgroup depots */
+	int		cache_ndepots;		/* elements of cache_depot */
 	kmem_dump_t	cache_dump;		/* used during crash dump */
 
 	/*
@@ -24,6 +24,7 @@
  * Copyright 2013 Nexenta Systems, Inc. All rights reserved.
  * Copyright (c) 2016 Andrey Sokolov
  * Copyright 2016 Toomas Soome <tsoome@me.com>
+ * Copyright 2026 Joyent, Inc.
  */
 
 #ifndef	_SYS_LOFI_H
@@ -35,6 +36,8 @@
 #include <sys/dkio.h>
 #include <sys/vnode.h>
 #include <sys/list.h>
+#include <sys/avl.h>
+#include <sys/kstat.h>
 #include <sys/crypto/api.h>
 #include <sys/zone.h>
 #ifdef _KERNEL
@@ -205,14 +208,32 @@ struct lofi_ioctl {
  *
  * To avoid that we have to decompress data of a compressed
  * segment multiple times when accessing parts of the segment's
- * data we cache the uncompressed data, using a simple linked list.
+ * data we cache the uncompressed data.  Entries are found through an
+ * AVL tree and replaced in LRU order.  An entry whose lc_data is still
+ * NULL is being decompressed by another thread, and is not yet on the
+ * LRU list.
  */
 struct lofi_comp_cache {
-	list_node_t	lc_list;		/* linked list */
+	list_node_t	lc_list;		/* LRU list */
+	avl_node_t	lc_avl;			/* lookup by segment index */
 	uchar_t		*lc_data;		/* decompressed segment data */
 	uint64_t	lc_index;		/* segment index */
+	struct lofi_state *lc_lsp;		/* owning device */
+	boolean_t	lc_readahead;		/* read ahead, not yet used */
 };
 
+/*
+ * Statistics for the decompressed segment cache.
+ */
+typedef struct lofi_comp_kstat {
+	kstat_named_t	lck_hits;		/* served from the cache */
+	kstat_named_t	lck_misses;		/* decompressed on demand */
+	kstat_named_t	lck_readahead;		/* read ahead issued */
+	kstat_named_t	lck_readahead_hits;	/* read ahead later used */
+	kstat_named_t	lck_evictions;		/* replaced when full */
+	kstat_named_t	lck_segments;		/* segments cached */
+} lofi_comp_kstat_t;
+
 #define	V_ISLOFIABLE(vtype) \
 	((vtype == VREG) || (vtype == VBLK) || (vtype == VCHR))
 
@@ -292,8 +313,14 @@ struct lofi_state {
 
 	/* lock and anchor for compressed segment caching */
 	kmutex_t	ls_comp_cache_lock;	/* protects ls_comp_cache */
+	kcondvar_t	ls_comp_cache_cv;	/* segment decompressed */
 	list_t		ls_comp_cache;		/* cached decompressed segs */
-	uint32_t	ls_comp_cache_count;
+	avl_tree_t	ls_comp_cache_avl;	/* all entries, by index */
+	uint32_t	ls_comp_cache_count;	/* entries on ls_comp_cache */
+	uint32_t	ls_comp_cache_max;	/* limit on the above */
+	uint64_t	ls_comp_last_seg;	/* last segment read */
+	taskq_t		*ls_comp_taskq;		/* for read ahead */
+	kstat_t		*ls_comp_kstat;
 
 	/* the following fields are required for encryption support */
 	boolean_t		ls_crypto_enabled;
@@ -331,6 +358,7 @@ enum lofi_compress {
 	LOFI_COMPRESS_GZIP_6 = 1,
 	LOFI_COMPRESS_GZIP_9 = 2,
 	LOFI_COMPRESS_LZMA = 3,
+	LOFI_COMPRESS_LZ4 = 4,
 	LOFI_COMPRESS_FUNCTIONS
 };
 
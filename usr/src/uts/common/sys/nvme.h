@@ -154,7 +154,8 @@ typedef struct {
 		uint8_t m_multi_pci:1;	/* HW has multiple PCIe interfaces */
 		uint8_t m_multi_ctrl:1; /* HW has multiple controllers (1.1) */
 		uint8_t m_sr_iov:1;	/* controller is SR-IOV virt fn (1.1) */
-		uint8_t m_rsvd:5;
+		uint8_t m_anar:1;	/* ANA reporting supported (1.4) */
+		uint8_t m_rsvd:4;
 	} id_mic;
 	uint8_t	id_mdts;		/* Maximum Data Transfer Size */
 	uint16_t id_cntlid;		/* Unique Controller Identifier (1.1) */
@@ -217,7 +218,26 @@ typedef struct {
 	uint16_t ap_mntmt;		/* Minimum Thermal Temperature */
 	uint16_t ap_mxtmt;		/* Maximum Thermal Temperature */
 	uint32_t ap_sanitize;		/* Sanitize Caps */
-	uint8_t id_rsvd_ac[512 - 332];
+	/* Added in NVMe 1.4 */
+	uint32_t ap_hmminds;		/* Host Memory Buf Min Desc Entry Sz */
+	uint16_t ap_hmmaxd;		/* Host Memory Buf Max Desc Entries */
+	uint16_t ap_nsetidmax;		/* Max NVM Set Identifier */
+	uint16_t ap_endgidmax;		/* Max Endurance Group Identifier */
+	uint8_t ap_anatt;		/* ANA Transition Time */
+	struct {			/* Asymmetric Namespace Access Caps */
+		uint8_t anacap_opt:1;	/* reports Optimized state */
+		uint8_t anacap_nonopt:1; /* reports Non-Optimized state */
+		uint8_t anacap_inacc:1;	/* reports Inaccessible state */
+		uint8_t anacap_ploss:1;	/* reports Persistent Loss state */
+		uint8_t anacap_change:1; /* reports Change state */
+		uint8_t anacap_rsvd:1;
+		uint8_t anacap_grpid_fixed:1; /* ANAGRPID doesn't change */
+		uint8_t anacap_grpid_nz:1; /* non-zero ANAGRPID in NS Mgmt */
+	} ap_anacap;
+	uint32_t ap_anagrpmax;		/* ANA Group Identifier Maximum */
+	uint32_t ap_nanagrpid;		/* Number of ANA Group Identifiers */
+	uint32_t ap_pels;		/* Persistent Event Log Size */
+	uint8_t id_rsvd_ac[512 - 356];
 
 	/* NVM Command Set Attributes */
 	nvme_idctl_qes_t id_sqes;	/* Submission Queue Entry Size */
@@ -341,7 +361,9 @@ typedef struct {
 	uint16_t id_nabspf;		/* Atomic Boundary Size Fail (1.2) */
 	uint16_t id_noiob;		/* Optimal I/O Bondary (1.3) */
 	uint8_t id_nvmcap[16];		/* NVM Capacity */
-	uint8_t id_rsvd1[104 - 64];
+	uint8_t id_rsvd1[92 - 64];
+	uint32_t id_anagrpid;		/* ANA Group Identifier (1.4) */
+	uint8_t id_rsvd1b[104 - 96];
 	uint8_t id_nguid[16];		/* Namespace GUID (1.2) */
 	uint8_t id_eui64[8];		/* IEEE Extended Unique Id (1.1) */
 	nvme_idns_lbaf_t id_lbaf[16];	/* LBA Formats */
@@ -392,6 +414,7 @@ typedef struct {
 #define	NVME_LOGPAGE_ERROR	0x1	/* Error Information */
 #define	NVME_LOGPAGE_HEALTH	0x2	/* SMART/Health Information */
 #define	NVME_LOGPAGE_FWSLOT	0x3	/* Firmware Slot Information */
+#define	NVME_LOGPAGE_ANA	0xc	/* Asymmetric Namespace Access (1.4) */
 
 typedef struct {
 	uint64_t el_count;		/* Error Count */
@@ -474,6 +497,34 @@ typedef struct {
 	uint8_t fw_rsvd4[512 - 64];
 } nvme_fwslot_log_t;
 
+/*
+ * Asymmetric Namespace Access log (1.4). The header is followed by al_ngrps
+ * group descriptors, each followed by ad_nnsids namespace IDs unless only the
+ * groups were requested.
+ */
+#define	NVME_ANA_OPTIMIZED	0x1	/* ANA Optimized */
+#define	NVME_ANA_NONOPTIMIZED	0x2	/* ANA Non-Optimized */
+#define	NVME_ANA_INACCESSIBLE	0x3	/* ANA Inaccessible */
+#define	NVME_ANA_PERSIST_LOSS	0x4	/* ANA Persistent Loss */
+#define	NVME_ANA_CHANGE		0xf	/* ANA Change */
+
+#define	NVME_ANA_LSP_RGO	0x1	/* Return Groups Only */
+
+typedef struct {
+	uint64_t al_chgcnt;		/* Change Count */
+	uint16_t al_ngrps;		/* Number of ANA Group Descriptors */
+	uint8_t al_rsvd[6];
+} nvme_ana_log_t;
+
+typedef struct {
+	uint32_t ad_grpid;		/* ANA Group ID */
+	uint32_t ad_nnsids;		/* Number of NSID Values */
+	uint64_t ad_chgcnt;		/* Change Count */
+	uint8_t ad_state:4;		/* ANA State */
+	uint8_t ad_rsvd1:4;
+	uint8_t ad_rsvd2[15];
+} nvme_ana_desc_t;
+
 
 /*
  * NVMe Format NVM
@@ -644,7 +695,12 @@ typedef union {
 		uint8_t aec_readonly:1;	/* media is read-only */
 		uint8_t aec_volatile:1;	/* volatile memory backup failed */
 		uint8_t aec_rsvd1:3;
-		uint8_t aec_rsvd2[3];
+		uint8_t aec_nsan:1;	/* namespace attribute notices (1.2) */
+		uint8_t aec_fwact:1;	/* firmware activation notices (1.2) */
+		uint8_t aec_telln:1;	/* telemetry log notices (1.3) */
+		uint8_t aec_ana:1;	/* ANA change notices (1.4) */
+		uint8_t aec_rsvd2:4;
+		uint8_t aec_rsvd3[2];
 	} b;
 	uint32_t r;
 } nvme_async_event_conf_t;
@@ -720,6 +776,7 @@ typedef union {
 #define	NVME_CQE_SCT_GENERIC	0	/* Generic Command Status */
 #define	NVME_CQE_SCT_SPECIFIC	1	/* Command Specific Status */
 #define	NVME_CQE_SCT_INTEGRITY	2	/* Media and Data Integrity Errors */
+#define	NVME_CQE_SCT_PATH	3	/* Path Related Status (1.4) */
 #define	NVME_CQE_SCT_VENDOR	7	/* Vendor Specific */
 
 /* NVMe completion status code (generic) */
@@ -787,6 +844,15 @@ typedef union {
 #define	NVME_CQE_SC_INT_NVM_COMPARE	0x85	/* Compare Failure */
 #define	NVME_CQE_SC_INT_NVM_ACCESS	0x86	/* Access Denied */
 
+/* NVMe completion status code (path related, 1.4) */
+#define	NVME_CQE_SC_PATH_INTERNAL	0x0	/* Internal Path Error */
+#define	NVME_CQE_SC_PATH_ANA_PLOSS	0x1	/* ANA Persistent Loss */
+#define	NVME_CQE_SC_PATH_ANA_INACC	0x2	/* ANA Inaccessible */
+#define	NVME_CQE_SC_PATH_ANA_TRANS	0x3	/* ANA Transition */
+#define	NVME_CQE_SC_PATH_CTRL		0x60	/* Controller Pathing Error */
+#define	NVME_CQE_SC_PATH_HOST		0x70	/* Host Pathing Error */
+#define	NVME_CQE_SC_PATH_HOST_ABORT	0x71	/* Command Aborted By Host */
+
 #ifdef __cplusplus
 }
 #endif
@@ -86,6 +86,7 @@
 
 #include <sys/thread.h>
 #include <sys/file.h>
+#include <sys/list.h>
 #include <sys/port_kernel.h>
 
 #ifdef	__cplusplus
@@ -228,6 +229,7 @@ struct polldat {
 	port_kevent_t	*pd_portev;	/* associated port event struct */
 	uf_entry_gen_t	pd_gen;		/* fd generation at cache time */
 	uint64_t	pd_epolldata;	/* epoll data, if any */
+	list_node_t	pd_readylink;	/* on pc_ready, devpoll only */
 };
 
 /*
@@ -254,17 +256,20 @@ struct pollcache {
 	int		pc_mapstart;	/* where search start, devpoll only */
 	pcachelink_t	*pc_parents;	/* linked list of epoll parents */
 	pcachelink_t	*pc_children;	/* linked list of epoll children */
+	list_t		pc_ready;	/* polldats with bit set (PC_READYQ) */
+	uint_t		pc_nready;	/* number of polldats on pc_ready */
 };
 
 /* pc_flag */
 #define	PC_POLLWAKE	0x02	/* pollwakeup() occurred */
 #define	PC_EPOLL	0x04	/* pollcache is epoll-enabled */
+#define	PC_READYQ	0x08	/* pc_ready tracks the set bits in pc_bitmap */
 
 #if defined(_KERNEL)
 /*
  * Internal routines.
  */
-extern void pollnotify(pollcache_t *, int);
+extern void pollnotify(pollcache_t *, polldat_t *);
 
 /*
  * public poll head interfaces (see poll.h):
@@ -337,6 +342,19 @@ extern void pcache_update_xref(pollcache_t *, int, ssize_t, int);
 extern void pcache_clean_entry(pollstate_t *, int);
 extern void pcache_wake_parents(pollcache_t *);
 
+/*
+ * pcachelink interfaces, used by pollcaches which are themselves polled:
+ *
+ *  pcachelink_assoc	link a child pollcache to the parent polling it
+ *  pcachelink_mark_stale	mark all child links stale before a rescan
+ *  pcachelink_purge_stale	purge child links not refreshed by a rescan
+ *  pcachelink_purge_all	purge all links, before pcache_destroy
+ */
+extern void pcachelink_assoc(pollcache_t *, pollcache_t *);
+extern void pcachelink_mark_stale(pollcache_t *);
+extern void pcachelink_purge_stale(pollcache_t *);
+extern void pcachelink_purge_all(pollcache_t *);
+
 /*
  * pcacheset interfaces:
  *
@@ -203,6 +203,8 @@ struct so_snd_bufinfo {
 #define	SO_EXCLBIND	0x1015		/* exclusive binding */
 #define	SO_MAC_IMPLICIT	0x1016		/* hide mac labels on wire */
 #define	SO_VRRP		0x1017		/* VRRP control socket */
+#define	SO_ZEROCOPY	0x1018		/* allow MSG_ZEROCOPY sends */
+#define	SO_ZEROCOPY_DONE 0x1019		/* get zero-copy completions */
 
 #ifdef	_KERNEL
 #define	SO_SRCADDR	0x2001		/* Internal: AF_UNIX source address */
@@ -232,6 +234,20 @@ struct fil_info {
 #define	FILF_AUTO	0x2		/* automatic attach */
 #define	FILF_BYPASS	0x4		/* filter is not active */
 
+/*
+ * Structure returned by SO_ZEROCOPY_DONE.  Each MSG_ZEROCOPY send on a socket
+ * with SO_ZEROCOPY enabled is assigned the next sequence number, starting at
+ * zero; once the kernel no longer references the user's buffer the number is
+ * reported back, coalesced with its neighbours into an inclusive range.
+ */
+struct so_zerocopy_done {
+	uint32_t	szd_first;	/* first completed send */
+	uint32_t	szd_last;	/* last completed send */
+	uint32_t	szd_flags;	/* see below (SO_ZEROCOPY_*) */
+};
+
+#define	SO_ZEROCOPY_COPIED	0x1	/* data was copied, not loaned */
+
 #if defined(_KERNEL) || defined(_FAKE_KERNEL)
 /*
  * new socket open flags to identify socket and acceptor streams
@@ -434,6 +450,7 @@ struct msghdr32 {
 #define	MSG_NOSIGNAL	0x200		/* Don't generate SIGPIPE */
 #define	MSG_DUPCTRL	0x800		/* Save control message for use with */
 					/* with left over data */
+#define	MSG_ZEROCOPY	0x1000		/* Loan user pages (see SO_ZEROCOPY) */
 #define	MSG_XPG4_2	0x8000		/* Private: XPG4.2 flag */
 
 /* Obsolete but kept for compilation compatibility. Use IOV_MAX. */
@@ -251,8 +251,17 @@ struct sonode {
 	/* Kernel direct receive callbacks */
 	so_krecv_f		so_krecv_cb;		/* recv callback */
 	void			*so_krecv_arg;		/* recv cb arg */
+
+	/* MSG_ZEROCOPY state, protected by so_lock */
+	uint_t			so_zc_flags;		/* SO_ZC_* flags */
+	uint32_t		so_zc_next;		/* next send id */
+	list_t			so_zc_done;		/* completed sends */
 };
 
+/* so_zc_flags */
+#define	SO_ZC_ENABLED	0x1	/* SO_ZEROCOPY set */
+#define	SO_ZC_NOLOAN	0x2	/* protocol refused SO_SND_COPYAVOID */
+
 #define	SO_HAVE_DATA(so)						\
 	/*								\
 	 * For the (tid == 0) case we must check so_rcv_{q_,}head	\
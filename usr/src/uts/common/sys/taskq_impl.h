@@ -26,6 +26,7 @@
  * Copyright 2011 Nexenta Systems, Inc.  All rights reserved.
  * Copyright (c) 2017 by Delphix. All rights reserved.
  * Copyright 2017 RackTop Systems.
+ * Copyright 2026 Joyent, Inc.
  */
 
 #ifndef	_SYS_TASKQ_IMPL_H
@@ -55,6 +56,7 @@ typedef struct taskq_ent {
 	}			tqent_un;
 	kthread_t		*tqent_thread;
 	kcondvar_t		tqent_cv;
+	hrtime_t		tqent_time;	/* TASKQ_PERCPU enqueue time */
 } taskq_ent_t;
 
 #define	TQENT_FLAG_PREALLOC	0x1
@@ -93,6 +95,35 @@ struct taskq_bucket {
 #define	TQBUCKET_CLOSE		0x01
 #define	TQBUCKET_SUSPEND	0x02
 
+/*
+ * Per-CPU queue of a TASKQ_PERCPU task queue.  Each queue sits on its own
+ * cache lines, so that dispatching CPUs and the threads serving them do not
+ * disturb one another.  Statistics are protected by tqq_lock.
+ */
+struct taskq_pcq {
+	kmutex_t	tqq_lock;
+	taskq_ent_t	tqq_task;	/* queued tasks */
+	kcondvar_t	tqq_cv;		/* idle home threads wait here */
+	kcondvar_t	tqq_wait_cv;	/* taskq_suspend() waits here */
+	uint_t		tqq_flags;
+	uint_t		tqq_nidle;	/* # of idle home threads */
+	uint_t		tqq_nrunning;	/* # of our tasks being executed */
+	uint_t		tqq_depth;	/* # of queued tasks */
+	uint_t		tqq_maxdepth;	/* max # of queued tasks */
+	uint64_t	tqq_tasks;	/* total # of tasks queued */
+	uint64_t	tqq_executed;	/* total # of tasks executed */
+	uint64_t	tqq_steals;	/* # executed by other home threads */
+	hrtime_t	tqq_waittime;	/* total time tasks spent queued */
+	hrtime_t	tqq_totaltime;	/* total time spent executing tasks */
+} __aligned(64);
+
+typedef struct taskq_pcq taskq_pcq_t;
+
+/*
+ * Per-CPU queue flags.
+ */
+#define	TQQ_SUSPEND		0x01
+
 #define	TASKQ_INTERFACE_FLAGS	0x0000ffff	/* defined in <sys/taskq.h> */
 
 /*
@@ -129,6 +160,10 @@ struct taskq {
 	taskq_bucket_t	*tq_buckets;	/* Per-cpu array of buckets */
 	int		tq_instance;
 	uint_t		tq_nbuckets;	/* # of buckets	(2^n)	    */
+	taskq_pcq_t	*tq_pcq;	/* TASKQ_PERCPU queues */
+	uint_t		tq_npcq;	/* # of per-CPU queues (2^n) */
+	uint_t		tq_pcq_nidle;	/* # of idle threads on all queues */
+	kstat_t		*tq_pcq_kstat;	/* per-queue statistics */
 	union {
 		kthread_t *_tq_thread;
 		kthread_t **_tq_threadlist;
@@ -54,6 +54,7 @@ void	setupclock(int);
 void	pageout(void);
 void	cv_signal_pageout(void);
 int	queue_io_request(struct vnode *, u_offset_t);
+void	pageout_refault(struct page *);
 
 extern	kmutex_t	memavail_lock;
 extern	kcondvar_t	memavail_cv;
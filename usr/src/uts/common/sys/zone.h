@@ -476,6 +476,8 @@ typedef struct {
 	kstat_named_t	zm_execpgin;
 	kstat_named_t	zm_fspgin;
 	kstat_named_t	zm_anon_alloc_fail;
+	kstat_named_t	zm_refault;
+	kstat_named_t	zm_thrash;
 	kstat_named_t	zm_pf_throttle;
 	kstat_named_t	zm_pf_throttle_usec;
 } zone_mcap_kstat_t;
@@ -493,6 +495,8 @@ typedef struct {
 	kstat_named_t	zm_ffnomem;
 	kstat_named_t	zm_ffmisc;
 	kstat_named_t	zm_mfseglim;
+	kstat_named_t	zm_thp_promote;
+	kstat_named_t	zm_thp_demote;
 	kstat_named_t	zm_nested_intp;
 	kstat_named_t	zm_init_pid;
 	kstat_named_t	zm_init_restarts;
@@ -694,6 +698,8 @@ typedef struct zone {
 	uint64_t	zone_execpgin;		/* exec pages paged in */
 	uint64_t	zone_fspgin;		/* fs pages paged in */
 	uint64_t	zone_anon_alloc_fail;	/* cnt of anon alloc fails */
+	uint64_t	zone_refault;		/* evicted fs pages refaulted */
+	uint64_t	zone_thrash;		/* ... within the working set */
 
 	psecflags_t	zone_secflags; /* default zone security-flags */
 
@@ -713,6 +719,9 @@ typedef struct zone {
 
 	uint32_t	zone_mfseglim;		/* map failure (# segs limit) */
 
+	uint64_t	zone_thp_promote;	/* large page promotions */
+	uint64_t	zone_thp_demote;	/* large page demotions */
+
 	uint32_t	zone_nested_intp;	/* nested interp. kstat */
 
 	struct loadavg_s zone_loadavg;		/* loadavg for this zone */
@@ -886,7 +886,7 @@ retry:
 			 * that the failure rate is very very low.
 			 */
 			if (mutex_tryenter(&pcp->pc_lock)) {
-				pollnotify(pcp, pdp->pd_fd);
+				pollnotify(pcp, pdp);
 				mutex_exit(&pcp->pc_lock);
 			} else {
 				/*
@@ -963,14 +963,20 @@ retry:
 /*
  * This function is called to inform a thread (or threads) that an event being
  * polled on has occurred.  The pollstate lock on the thread should be held
- * on entry.
+ * on entry.  For /dev/poll caches, the polldat is also queued on the ready
+ * list so that DP_POLL need not scan the bitmap to find it.
  */
 void
-pollnotify(pollcache_t *pcp, int fd)
+pollnotify(pollcache_t *pcp, polldat_t *pdp)
 {
-	ASSERT(fd < pcp->pc_mapsize);
+	ASSERT(pdp->pd_fd < pcp->pc_mapsize);
 	ASSERT(MUTEX_HELD(&pcp->pc_lock));
-	BT_SET(pcp->pc_bitmap, fd);
+	BT_SET(pcp->pc_bitmap, pdp->pd_fd);
+	if ((pcp->pc_flag & PC_READYQ) != 0 &&
+	    !list_link_active(&pdp->pd_readylink)) {
+		list_insert_tail(&pcp->pc_ready, pdp);
+		pcp->pc_nready++;
+	}
 	pcp->pc_flag |= PC_POLLWAKE;
 	cv_broadcast(&pcp->pc_cv);
 	pcache_wake_parents(pcp);
@@ -2315,6 +2321,176 @@ pcache_wake_parents(pollcache_t *pcp)
 	}
 }
 
+static void
+pcachelink_locked_rele(pcachelink_t *pl)
+{
+	ASSERT(MUTEX_HELD(&pl->pcl_lock));
+	VERIFY(pl->pcl_refcnt >= 1);
+
+	pl->pcl_refcnt--;
+	if (pl->pcl_refcnt == 0) {
+		VERIFY(pl->pcl_state == PCL_INVALID);
+		ASSERT(pl->pcl_parent_pc == NULL);
+		ASSERT(pl->pcl_child_pc == NULL);
+		ASSERT(pl->pcl_parent_next == NULL);
+		ASSERT(pl->pcl_child_next == NULL);
+
+		pl->pcl_state = PCL_FREE;
+		mutex_destroy(&pl->pcl_lock);
+		kmem_free(pl, sizeof (pcachelink_t));
+	} else {
+		mutex_exit(&pl->pcl_lock);
+	}
+}
+
+/*
+ * Associate parent and child pollcaches via a pcachelink_t.  If an existing
+ * link (stale or valid) between the two is found, it will be reused.  If a
+ * suitable link is not found for reuse, a new one will be allocated.
+ */
+void
+pcachelink_assoc(pollcache_t *child, pollcache_t *parent)
+{
+	pcachelink_t	*pl, **plpn;
+
+	ASSERT(MUTEX_HELD(&child->pc_lock));
+	ASSERT(MUTEX_HELD(&parent->pc_lock));
+
+	/* Search for an existing link we can reuse. */
+	plpn = &child->pc_parents;
+	for (pl = child->pc_parents; pl != NULL; pl = *plpn) {
+		mutex_enter(&pl->pcl_lock);
+		if (pl->pcl_state == PCL_INVALID) {
+			/* Clean any invalid links while walking the list */
+			*plpn = pl->pcl_parent_next;
+			pl->pcl_child_pc = NULL;
+			pl->pcl_parent_next = NULL;
+			pcachelink_locked_rele(pl);
+		} else if (pl->pcl_parent_pc == parent) {
+			/* Successfully found parent link */
+			ASSERT(pl->pcl_state == PCL_VALID ||
+			    pl->pcl_state == PCL_STALE);
+			pl->pcl_state = PCL_VALID;
+			mutex_exit(&pl->pcl_lock);
+			return;
+		} else {
+			plpn = &pl->pcl_parent_next;
+			mutex_exit(&pl->pcl_lock);
+		}
+	}
+
+	/* No existing link to the parent was found.  Create a fresh one. */
+	pl = kmem_zalloc(sizeof (pcachelink_t), KM_SLEEP);
+	mutex_init(&pl->pcl_lock,  NULL, MUTEX_DEFAULT, NULL);
+
+	pl->pcl_parent_pc = parent;
+	pl->pcl_child_next = parent->pc_children;
+	parent->pc_children = pl;
+	pl->pcl_refcnt++;
+
+	pl->pcl_child_pc = child;
+	pl->pcl_parent_next = child->pc_parents;
+	child->pc_parents = pl;
+	pl->pcl_refcnt++;
+
+	pl->pcl_state = PCL_VALID;
+}
+
+/*
+ * Mark all child links in a pollcache as stale.  Any invalid child links found
+ * during iteration are purged.
+ */
+void
+pcachelink_mark_stale(pollcache_t *pcp)
+{
+	pcachelink_t	*pl, **plpn;
+
+	ASSERT(MUTEX_HELD(&pcp->pc_lock));
+
+	plpn = &pcp->pc_children;
+	for (pl = pcp->pc_children; pl != NULL; pl = *plpn) {
+		mutex_enter(&pl->pcl_lock);
+		if (pl->pcl_state == PCL_INVALID) {
+			/*
+			 * Remove any invalid links while we are going to the
+			 * trouble of walking the list.
+			 */
+			*plpn = pl->pcl_child_next;
+			pl->pcl_parent_pc = NULL;
+			pl->pcl_child_next = NULL;
+			pcachelink_locked_rele(pl);
+		} else {
+			pl->pcl_state = PCL_STALE;
+			plpn = &pl->pcl_child_next;
+			mutex_exit(&pl->pcl_lock);
+		}
+	}
+}
+
+/*
+ * Purge all stale (or invalid) child links from a pollcache.
+ */
+void
+pcachelink_purge_stale(pollcache_t *pcp)
+{
+	pcachelink_t	*pl, **plpn;
+
+	ASSERT(MUTEX_HELD(&pcp->pc_lock));
+
+	plpn = &pcp->pc_children;
+	for (pl = pcp->pc_children; pl != NULL; pl = *plpn) {
+		mutex_enter(&pl->pcl_lock);
+		switch (pl->pcl_state) {
+		case PCL_STALE:
+			pl->pcl_state = PCL_INVALID;
+			/* FALLTHROUGH */
+		case PCL_INVALID:
+			*plpn = pl->pcl_child_next;
+			pl->pcl_parent_pc = NULL;
+			pl->pcl_child_next = NULL;
+			pcachelink_locked_rele(pl);
+			break;
+		default:
+			plpn = &pl->pcl_child_next;
+			mutex_exit(&pl->pcl_lock);
+		}
+	}
+}
+
+/*
+ * Purge all child and parent links from a pollcache, regardless of status.
+ */
+void
+pcachelink_purge_all(pollcache_t *pcp)
+{
+	pcachelink_t	*pl, **plpn;
+
+	ASSERT(MUTEX_HELD(&pcp->pc_lock));
+
+	plpn = &pcp->pc_parents;
+	for (pl = pcp->pc_parents; pl != NULL; pl = *plpn) {
+		mutex_enter(&pl->pcl_lock);
+		pl->pcl_state = PCL_INVALID;
+		*plpn = pl->pcl_parent_next;
+		pl->pcl_child_pc = NULL;
+		pl->pcl_parent_next = NULL;
+		pcachelink_locked_rele(pl);
+	}
+
+	plpn = &pcp->pc_children;
+	for (pl = pcp->pc_children; pl != NULL; pl = *plpn) {
+		mutex_enter(&pl->pcl_lock);
+		pl->pcl_state = PCL_INVALID;
+		*plpn = pl->pcl_child_next;
+		pl->pcl_parent_pc = NULL;
+		pl->pcl_child_next = NULL;
+		pcachelink_locked_rele(pl);
+	}
+
+	ASSERT(pcp->pc_parents == NULL);
+	ASSERT(pcp->pc_children == NULL);
+}
+
 /*
  * Initialize thread pollstate structure.
  * It will persist for the life of the thread, until it calls pollcleanup().
@@ -2946,7 +3122,12 @@ pollcheckrevents(pollstate_t *ps, int begin, int end, int cacheindex)
 pollcache_t *
 pcache_alloc()
 {
-	return (kmem_zalloc(sizeof (pollcache_t), KM_SLEEP));
+	pollcache_t *pcp;
+
+	pcp = kmem_zalloc(sizeof (pollcache_t), KM_SLEEP);
+	list_create(&pcp->pc_ready, sizeof (polldat_t),
+	    offsetof(polldat_t, pd_readylink));
+	return (pcp);
 }
 
 void
@@ -2985,6 +3166,10 @@ pcache_destroy(pollcache_t *pcp)
 	polldat_t	**hashtbl;
 	int i;
 
+	while (list_remove_head(&pcp->pc_ready) != NULL)
+		;
+	list_destroy(&pcp->pc_ready);
+
 	hashtbl = pcp->pc_hash;
 	for (i = 0; i < pcp->pc_hashsize; i++) {
 		if (hashtbl[i] != NULL) {
@@ -652,6 +652,8 @@ extern pad_mutex_t ph_mutex[];
 #define	PG_LOCAL	0x0080		/* alloc from given lgrp only */
 #define	PG_NORMALPRI	0x0100		/* PG_WAIT like priority, but */
 					/* non-blocking */
+#define	PG_ZERO		0x0200		/* page will be zeroed; prefer */
+					/* one that already is */
 /*
  * When p_selock has the SE_EWANTED bit set, threads waiting for SE_EXCL
  * access are given priority over all other waiting threads.
@@ -748,6 +750,11 @@ void	page_list_sub_pages(page_t *, uint_t);
 void	page_list_xfer(page_t *, int, int);
 void	page_list_break(page_t **, page_t **, size_t);
 void	page_list_concat(page_t **, page_t **);
+void	page_pcache_init(void);
+int	page_pcache_put(page_t *);
+void	page_pcache_reap(void);
+void	page_zpool_init(void);
+void	page_zpool_reap(void);
 void	page_vpadd(page_t **, page_t *);
 void	page_vpsub(page_t **, page_t *);
 int	page_lock(page_t *, se_t, kmutex_t *, reclaim_t);
@@ -932,6 +939,8 @@ int	page_szc_user_filtered(size_t);
 #define	P_SWAP		0x10		/* belongs to vnode that is V_ISSWAP */
 #define	P_BOOTPAGES	0x08		/* member of bootpages list */
 #define	P_RAF		0x04		/* page retired at free */
+#define	P_ZERO		0x02		/* page is known to be zeroed */
+#define	P_REFAULT	0x01		/* refaulted while thrashing */
 
 #define	PP_ISFREE(pp)		((pp)->p_state & P_FREE)
 #define	PP_ISAGED(pp)		(((pp)->p_state & P_FREE) && \
@@ -943,15 +952,19 @@ int	page_szc_user_filtered(size_t);
 #define	PP_ISSWAP(pp)		((pp)->p_state & P_SWAP)
 #define	PP_ISBOOTPAGES(pp)	((pp)->p_state & P_BOOTPAGES)
 #define	PP_ISRAF(pp)		((pp)->p_state & P_RAF)
+#define	PP_ISZERO(pp)		((pp)->p_state & P_ZERO)
+#define	PP_ISREFAULT(pp)	((pp)->p_state & P_REFAULT)
 
-#define	PP_SETFREE(pp)		((pp)->p_state = ((pp)->p_state & ~P_MIGRATE) \
-				| P_FREE)
+#define	PP_SETFREE(pp)		((pp)->p_state = ((pp)->p_state & \
+				~(P_MIGRATE | P_ZERO | P_REFAULT)) | P_FREE)
 #define	PP_SETAGED(pp)		ASSERT(PP_ISAGED(pp))
 #define	PP_SETNORELOC(pp)	((pp)->p_state |= P_NORELOC)
 #define	PP_SETMIGRATE(pp)	((pp)->p_state |= P_MIGRATE)
 #define	PP_SETSWAP(pp)		((pp)->p_state |= P_SWAP)
 #define	PP_SETBOOTPAGES(pp)	((pp)->p_state |= P_BOOTPAGES)
 #define	PP_SETRAF(pp)		((pp)->p_state |= P_RAF)
+#define	PP_SETZERO(pp)		((pp)->p_state |= P_ZERO)
+#define	PP_SETREFAULT(pp)	((pp)->p_state |= P_REFAULT)
 
 #define	PP_CLRFREE(pp)		((pp)->p_state &= ~P_FREE)
 #define	PP_CLRAGED(pp)		ASSERT(!PP_ISAGED(pp))
@@ -960,6 +973,8 @@ int	page_szc_user_filtered(size_t);
 #define	PP_CLRSWAP(pp)		((pp)->p_state &= ~P_SWAP)
 #define	PP_CLRBOOTPAGES(pp)	((pp)->p_state &= ~P_BOOTPAGES)
 #define	PP_CLRRAF(pp)		((pp)->p_state &= ~P_RAF)
+#define	PP_CLRZERO(pp)		((pp)->p_state &= ~P_ZERO)
+#define	PP_CLRREFAULT(pp)	((pp)->p_state &= ~P_REFAULT)
 
 /*
  * Flags for page_t p_toxic, for tracking memory hardware errors.
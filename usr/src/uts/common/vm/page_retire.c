@@ -1068,6 +1068,13 @@ page_retire(uint64_t pa, uchar_t reason)
 
 	if (MTBF(pr_calls, pr_mtbf)) {
 		page_settoxic(pp, reason);
+		/*
+		 * A free page may be held locked in a per-CPU page cache or
+		 * the zero pool; now that it is toxic, it will not go back
+		 * into either.
+		 */
+		page_pcache_reap();
+		page_zpool_reap();
 		if (page_trycapture(pp, 0, CAPTURE_RETIRE, pp->p_vnode) == 0) {
 			PR_DEBUG(prd_prlocked);
 		} else {
@@ -75,6 +75,8 @@
 #include <sys/project.h>
 #include <sys/zone.h>
 #include <sys/shm_impl.h>
+#include <sys/var.h>
+#include <sys/atomic.h>
 
 /*
  * segvn_fault needs a temporary page list array.  To avoid calling kmem all
@@ -403,6 +405,43 @@ static void segvn_trupdate(void);
 static void segvn_trupdate_seg(struct seg *, segvn_data_t *, svntr_t *,
     ulong_t);
 
+/*
+ * Transparent large pages.  Private anonymous memory (heaps, stacks and
+ * MAP_ANON mappings) is only mapped with large pages if the process asks for
+ * them via memcntl(2) or the MPSS libraries, or if the max_*_lpsize tunables
+ * have been raised, and most applications do neither.  segvn_thp_thread
+ * instead periodically walks all processes looking for large page aligned
+ * regions of small page, private anonymous segments that are at least
+ * segvn_thp_minpct percent populated, and sets the page size of those
+ * regions to segvn_thp_szc with as_setpagesize().  This unloads the existing
+ * translations, and the next fault on each region relocates its small pages
+ * into a large page in segvn_fault_anonpages().
+ *
+ * Large pages tie up physically contiguous memory, and have to be demoted
+ * before any part of them can be paged out.  So while freemem is below
+ * lotsfree the thread promotes nothing, and once it is below desfree it
+ * demotes the segments it promoted itself (svn_thp is set) back to small
+ * pages; page sizes chosen by the application are left alone.  Promotions
+ * and demotions, in large pages, are counted in the lpg_promote and
+ * lpg_demote zone_misc kstats of the process's zone.
+ *
+ * The thread is only started if segvn_thp_enable is set in /etc/system.
+ */
+typedef struct segvn_thp_range {
+	caddr_t		str_addr;
+	size_t		str_len;
+	uint_t		str_szc;	/* page size code of the range */
+} segvn_thp_range_t;
+
+int				segvn_thp_enable = 0;
+uint_t				segvn_thp_szc = 1;
+uint_t				segvn_thp_minpct = 50;
+uint_t				segvn_thp_scan_max = 256;
+int				segvn_thp_interval = 10;
+static kthread_t		*segvn_thp_thr;
+
+static void segvn_thp_thread(void);
+
 /*
  * Initialize segvn data structures
  */
@@ -494,6 +533,13 @@ segvn_init(void)
 	}
 #endif
 
+	if (segvn_thp_enable && segvn_maxpgszc != 0) {
+		if (segvn_thp_szc == 0 || segvn_thp_szc > segvn_maxpgszc)
+			segvn_thp_szc = 1;
+		(void) thread_create(NULL, 0, segvn_thp_thread,
+		    NULL, 0, &p0, TS_RUN, minclsyspri);
+	}
+
 	if (!ISP2(segvn_pglock_comb_balign) ||
 	    segvn_pglock_comb_balign < PAGESIZE) {
 		segvn_pglock_comb_balign = 1UL << 16; /* 64K */
@@ -845,6 +891,7 @@ segvn_create(struct seg **segpp, void *argsp)
 	svd->svn_inz = 0;
 	svd->rcookie = HAT_INVALID_REGION_COOKIE;
 	svd->pageswap = 0;
+	svd->svn_thp = 0;
 
 	if (a->szc != 0 && a->vp != NULL) {
 		segvn_setvnode_mpss(a->vp);
@@ -1047,7 +1094,8 @@ segvn_concat(struct seg *seg1, struct seg *seg2, int amp_cat)
 	    (!svd1->pageadvice && !svd2->pageadvice && incompat(advice)) ||
 	    (!svd1->pageprot && !svd2->pageprot && incompat(prot)) ||
 	    incompat(type) || incompat(cred) || incompat(flags) ||
-	    seg1->s_szc != seg2->s_szc || incompat(policy_info.mem_policy) ||
+	    seg1->s_szc != seg2->s_szc || incompat(svn_thp) ||
+	    incompat(policy_info.mem_policy) ||
 	    (svd2->softlockcnt > 0) || svd1->softlockcnt_send > 0)
 		return (-1);
 #undef incompat
@@ -1624,6 +1672,7 @@ segvn_dup(struct seg *seg, struct seg *newseg)
 	newsvd->svn_inz = svd->svn_inz;
 	newsvd->swresv = svd->swresv;
 	newsvd->pageswap = svd->pageswap;
+	newsvd->svn_thp = svd->svn_thp;
 	newsvd->flags = svd->flags;
 	newsvd->softlockcnt = 0;
 	newsvd->softlockcnt_sbase = 0;
@@ -6094,6 +6143,12 @@ segvn_setpagesize(struct seg *seg, caddr_t addr, size_t len, uint_t szc)
 	ASSERT(addr >= seg->s_base && eaddr <= seg->s_base + seg->s_size);
 
 	if (seg->s_szc == szc || segvn_lpg_disable != 0) {
+		/*
+		 * The application asking for the size the segment already
+		 * has makes that size its own choice, as a change would.
+		 */
+		if (seg->s_szc == szc && curthread != segvn_thp_thr)
+			svd->svn_thp = 0;
 		return (0);
 	}
 
@@ -6356,6 +6411,7 @@ segvn_setpagesize(struct seg *seg, caddr_t addr, size_t len, uint_t szc)
 	}
 
 	seg->s_szc = szc;
+	svd->svn_thp = (szc != 0 && curthread == segvn_thp_thr);
 
 	return (0);
 }
@@ -6382,6 +6438,8 @@ segvn_clrszc(struct seg *seg)
 	    SEGVN_WRITE_HELD(seg->s_as, &svd->lock));
 	ASSERT(svd->softlockcnt == 0);
 
+	svd->svn_thp = 0;
+
 	if (vp == NULL && amp == NULL) {
 		ASSERT(svd->rcookie == HAT_INVALID_REGION_COOKIE);
 		seg->s_szc = 0;
@@ -10341,3 +10399,194 @@ segvn_trupdate_seg(struct seg *seg, segvn_data_t *svd, svntr_t *svntrp,
 
 	SEGVN_TR_ADDSTAT(asyncrepl);
 }
+
+/*
+ * Gather the ranges of a process's address space that the large page thread
+ * should promote or, if demote is set, demote.  Adjacent regions are merged
+ * into a single range so that as_setpagesize() splits segments as little as
+ * possible.
+ */
+static uint_t
+segvn_thp_ranges(struct as *as, boolean_t demote, segvn_thp_range_t *r,
+    uint_t max)
+{
+	size_t pgsz = page_get_pagesize(segvn_thp_szc);
+	pgcnt_t pgcnt = page_get_pagecnt(segvn_thp_szc);
+	pgcnt_t minpages = MAX(pgcnt * segvn_thp_minpct / 100, 1);
+	struct segvn_data *svd;
+	struct anon_map *amp;
+	struct seg *seg;
+	caddr_t a, ea;
+	uint_t n = 0;
+
+	AS_LOCK_ENTER(as, RW_READER);
+	for (seg = AS_SEGFIRST(as); seg != NULL && n < max;
+	    seg = AS_SEGNEXT(as, seg)) {
+		if (seg->s_ops != &segvn_ops)
+			continue;
+		svd = (struct segvn_data *)seg->s_data;
+
+		SEGVN_LOCK_ENTER(as, &svd->lock, RW_READER);
+		if (demote) {
+			if (svd->svn_thp && seg->s_szc != 0) {
+				r[n].str_addr = seg->s_base;
+				r[n].str_len = seg->s_size;
+				r[n].str_szc = seg->s_szc;
+				n++;
+			}
+			SEGVN_LOCK_EXIT(as, &svd->lock);
+			continue;
+		}
+
+		if (seg->s_szc != 0 || svd->vp != NULL ||
+		    svd->type != MAP_PRIVATE || (svd->flags & MAP_NORESERVE) ||
+		    svd->tr_state == SEGVN_TR_ON || (amp = svd->amp) == NULL) {
+			SEGVN_LOCK_EXIT(as, &svd->lock);
+			continue;
+		}
+
+		a = (caddr_t)P2ROUNDUP((uintptr_t)seg->s_base, pgsz);
+		ea = (caddr_t)P2ALIGN((uintptr_t)(seg->s_base + seg->s_size),
+		    pgsz);
+
+		/*
+		 * Anon maps still shared after a fork can't be re-aligned by
+		 * segvn_setpagesize(), so leave them for now.
+		 */
+		ANON_LOCK_ENTER(&amp->a_rwlock, RW_READER);
+		for (; amp->refcnt == 1 && a < ea && n < max; a += pgsz) {
+			if (anon_pages(amp->ahp, svd->anon_index +
+			    seg_page(seg, a), pgcnt) < minpages)
+				continue;
+			if (n != 0 &&
+			    r[n - 1].str_addr + r[n - 1].str_len == a) {
+				r[n - 1].str_len += pgsz;
+				continue;
+			}
+			r[n].str_addr = a;
+			r[n].str_len = pgsz;
+			r[n].str_szc = segvn_thp_szc;
+			n++;
+		}
+		ANON_LOCK_EXIT(&amp->a_rwlock);
+		SEGVN_LOCK_EXIT(as, &svd->lock);
+	}
+	AS_LOCK_EXIT(as);
+
+	return (n);
+}
+
+/*
+ * Promote or demote the ranges of one process, returning the number of
+ * ranges gathered.  The caller holds the process with sprlock(), so neither
+ * it nor its address space can go away.
+ */
+static uint_t
+segvn_thp_proc(proc_t *p, boolean_t demote, segvn_thp_range_t *r, uint_t max)
+{
+	struct as *as = p->p_as;
+	uint64_t npages;
+	uint_t i, n;
+
+	n = segvn_thp_ranges(as, demote, r, max);
+	for (i = 0; i < n; i++) {
+		if (!demote && freemem < lotsfree)
+			break;
+		if (as_setpagesize(as, r[i].str_addr, r[i].str_len,
+		    demote ? 0 : r[i].str_szc, B_FALSE) != 0)
+			continue;
+
+		npages = howmany(r[i].str_len,
+		    page_get_pagesize(r[i].str_szc));
+		if (demote) {
+			atomic_add_64(&p->p_zone->zone_thp_demote, npages);
+		} else {
+			atomic_add_64(&p->p_zone->zone_thp_promote, npages);
+		}
+	}
+
+	return (n);
+}
+
+/*
+ * Walk the process table as vmu_calculate_all_procs() does, holding each
+ * process with sprlock() while its address space is examined, since neither
+ * pidlock nor p_lock can be held across as_setpagesize().  Processes that
+ * are already locked, typically by a debugger, are simply skipped.
+ */
+static void
+segvn_thp_scan(segvn_thp_range_t *r, uint_t budget)
+{
+	boolean_t demote;
+	proc_t *p;
+	int i;
+
+	if (freemem < desfree) {
+		demote = B_TRUE;
+	} else if (freemem >= lotsfree && segvn_thp_enable) {
+		demote = B_FALSE;
+	} else {
+		return;
+	}
+
+	mutex_enter(&pidlock);
+	for (i = 0; i < v.v_proc && budget != 0; i++) {
+		if ((p = pid_entry(i)) == NULL)
+			continue;
+
+		mutex_enter(&p->p_lock);
+		mutex_exit(&pidlock);
+
+		if ((p->p_flag & SVFORK) || sprtrylock_proc(p) != 0) {
+			mutex_exit(&p->p_lock);
+			mutex_enter(&pidlock);
+			continue;
+		}
+		mutex_exit(&p->p_lock);
+
+		budget -= segvn_thp_proc(p, demote, r, budget);
+
+		mutex_enter(&p->p_lock);
+		sprunlock(p);
+		mutex_enter(&pidlock);
+	}
+	mutex_exit(&pidlock);
+}
+
+static void
+segvn_thp_thread(void)
+{
+	callb_cpr_t cpr_info;
+	kmutex_t cpr_lock;	/* just for CPR stuff */
+	segvn_thp_range_t *r;
+	uint_t max = 0;
+
+	mutex_init(&cpr_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	CALLB_CPR_INIT(&cpr_info, &cpr_lock,
+	    callb_generic_cpr, "segvn_thp");
+
+	segvn_thp_thr = curthread;
+	r = NULL;
+
+	for (;;) {
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_BEGIN(&cpr_info);
+		mutex_exit(&cpr_lock);
+		delay(MAX(segvn_thp_interval, 1) * hz);
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_END(&cpr_info, &cpr_lock);
+		mutex_exit(&cpr_lock);
+
+		if (segvn_thp_scan_max != max) {
+			if (max != 0)
+				kmem_free(r, max * sizeof (segvn_thp_range_t));
+			if ((max = segvn_thp_scan_max) != 0) {
+				r = kmem_alloc(max * sizeof (segvn_thp_range_t),
+				    KM_SLEEP);
+			}
+		}
+		if (max != 0)
+			segvn_thp_scan(r, max);
+	}
+}
@@ -110,6 +110,7 @@ typedef struct	segvn_data {
 	struct	segvn_data *svn_trprev; /* textrepl list prev link */
 	int	tr_state;	/* TR (text replication) state */
 	uchar_t	pageswap;	/* true if per page swap accounting is set */
+	uchar_t	svn_thp;	/* true if szc was set by segvn_thp_thread */
 	spgcnt_t softlockcnt_sbase; /* # of softlocks for seg start addr */
 	spgcnt_t softlockcnt_send; /* # of softlocks for seg end addr */
 } segvn_data_t;
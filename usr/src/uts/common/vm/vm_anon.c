@@ -2486,6 +2486,12 @@ anon_private(
 	 * which is locked and loaded in the MMU by
 	 * the caller to prevent yet another page fault.
 	 */
+	/*
+	 * The page may have come from the pre-zeroed pool, which it no
+	 * longer is once copied into.
+	 */
+	PP_CLRZERO(pp);
+
 	/* XXX - should set mod bit in here */
 	if (ppcopy(opp, pp) == 0) {
 		/*
@@ -2736,8 +2742,10 @@ anon_map_privatepages(
 		}
 
 		/*
-		 * Now copy the contents from the original page.
+		 * Now copy the contents from the original page, which
+		 * leaves it no longer zeroed if it came from the pool.
 		 */
+		PP_CLRZERO(pp);
 		if (ppcopy(ppa[pg_idx], pp) == 0) {
 			/*
 			 * Before ppcopy could hanlde UE or other faults, we
@@ -2825,7 +2833,13 @@ anon_zero(struct seg *seg, caddr_t addr, struct anon **app, struct cred *cred)
 	}
 	pp = anon_pl[0];
 
-	pagezero(pp, 0, PAGESIZE);	/* XXX - should set mod bit */
+	/*
+	 * A page from the pre-zeroed pool needs no zeroing here.
+	 */
+	if (PP_ISZERO(pp))
+		PP_CLRZERO(pp);
+	else
+		pagezero(pp, 0, PAGESIZE);	/* XXX - should set mod bit */
 	page_downgrade(pp);
 	CPU_STATS_ADD_K(vm, zfod, 1);
 	hat_setrefmod(pp);	/* mark as modified so pageout writes back */
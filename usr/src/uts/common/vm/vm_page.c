@@ -1872,6 +1872,13 @@ page_create_get_something(vnode_t *vp, u_offset_t off, struct seg *seg,
 			    flags, lgrp);
 		}
 		if (pp == NULL) {
+			/*
+			 * Free pages may be sitting in the caches of other
+			 * CPUs; put them back where we can find them.
+			 */
+			page_pcache_reap();
+			page_zpool_reap();
+
 			/*
 			 * Serialize.  Don't fight with other pcgs().
 			 */
@@ -2289,8 +2296,8 @@ page_create_va(vnode_t *vp, u_offset_t off, size_t bytes, uint_t flags,
 		panic("page_create: invalid flags");
 		/*NOTREACHED*/
 	}
-	ASSERT((flags & ~(PG_EXCL | PG_WAIT |
-	    PG_NORELOC | PG_PANIC | PG_PUSHPAGE | PG_NORMALPRI)) == 0);
+	ASSERT((flags & ~(PG_EXCL | PG_WAIT | PG_NORELOC | PG_PANIC |
+	    PG_PUSHPAGE | PG_NORMALPRI | PG_ZERO)) == 0);
 	    /* but no others */
 
 	pages_req = npages = btopr(bytes);
@@ -2446,6 +2453,8 @@ top:
 		ASSERT(!hat_page_is_mapped(npp));
 		PP_CLRFREE(npp);
 		PP_CLRAGED(npp);
+		if ((flags & PG_ZERO) == 0)
+			PP_CLRZERO(npp);
 
 		/*
 		 * Here we have a page in our hot little mits and are
@@ -2492,6 +2501,7 @@ top:
 			 * bit so we don't have to do it here.
 			 */
 			page_set_props(pp, P_REF);
+			pageout_refault(pp);
 			found_on_free++;
 		} else {
 			VM_STAT_ADD(page_create_exists);
@@ -2640,6 +2650,7 @@ page_free(page_t *pp, int dontneed)
 {
 	struct pcf	*p;
 	uint_t		pcf_index;
+	int		cached = 0;
 
 	ASSERT((PAGE_EXCL(pp) &&
 	    !page_iolock_assert(pp)) || panicstr);
@@ -2690,7 +2701,8 @@ page_free(page_t *pp, int dontneed)
 		 */
 		PP_SETAGED(pp);
 		pp->p_offset = (u_offset_t)-1;
-		page_list_add(pp, PG_FREE_LIST | PG_LIST_TAIL);
+		if ((cached = page_pcache_put(pp)) == 0)
+			page_list_add(pp, PG_FREE_LIST | PG_LIST_TAIL);
 		VM_STAT_ADD(pagecnt.pc_free_free);
 		TRACE_1(TR_FAC_VM, TR_PAGE_FREE_FREE,
 		    "page_free_free:pp %p", pp);
@@ -2712,7 +2724,13 @@ page_free(page_t *pp, int dontneed)
 			    "page_free_cache_head:pp %p", pp);
 		}
 	}
-	page_unlock(pp);
+
+	/*
+	 * A page kept in a per-CPU cache stays locked until it is handed
+	 * out again or drained back to the freelist.
+	 */
+	if (!cached)
+		page_unlock(pp);
 
 	/*
 	 * Now do the `freemem' accounting.
@@ -3053,6 +3071,7 @@ page_reclaim_nomem:
 	PP_CLRFREE(pp);
 	PP_CLRAGED(pp);
 	page_set_props(pp, P_REF);
+	pageout_refault(pp);
 
 	CPU_STATS_ENTER_K();
 	cpup = CPU;	/* get cpup now that CPU cannot change */
@@ -64,6 +64,8 @@
 #include <sys/sdt.h>
 #include <sys/dumphdr.h>
 #include <sys/swap.h>
+#include <sys/kstat.h>
+#include <sys/disp.h>
 
 extern uint_t	vac_colors;
 
@@ -240,6 +242,7 @@ page_t *page_freelist_split(uchar_t,
     uint_t, int, int, pfn_t, pfn_t, page_list_walker_t *);
 page_t *page_get_mnode_cachelist(uint_t, uint_t, int, int);
 static int page_trylock_cons(page_t *pp, se_t se);
+static void page_pcache_drain_cpu(struct cpu *);
 
 /*
  * The page_counters array below is used to keep track of free contiguous
@@ -385,6 +388,8 @@ cpu_vm_data_init(struct cpu *cp)
 void
 cpu_vm_data_destroy(struct cpu *cp)
 {
+	page_pcache_drain_cpu(cp);
+
 	if (cp->cpu_seqid && cp->cpu_vm_data) {
 		ASSERT(cp != CPU0);
 		kmem_free(((vm_cpu_data_t *)cp->cpu_vm_data)->vc_kmptr,
@@ -1376,6 +1381,663 @@ page_freelist_unlock(int mnode)
 	}
 }
 
+/*
+ * Per-CPU page caches.  Every base page allocation and free would otherwise
+ * take the freelist mutex for its mnode and color, and those become hot when
+ * many threads fault in memory at once.  Each CPU therefore keeps a small
+ * cache of free, PAGESIZE pages, hashed by color into ppc_bins.  page_free()
+ * puts pages with no identity into the cache of the current CPU, and
+ * page_get_freelist() looks there for a page of the exact mnode, color and
+ * mtype before going to the freelists.  Misses refill the cache with up to
+ * page_pcache_batch pages of that color taken under a single acquisition of
+ * the freelist mutex, and a full cache drains page_pcache_batch pages back
+ * to the freelists.
+ *
+ * Cached pages stay PP_ISFREE and are counted in freemem, but are off the
+ * freelists and out of the page counters, and are held SE_EXCL locked by
+ * the cache so that anything walking pages by pfn leaves them alone.  Large
+ * pages, cachelist pages (which have an identity and must be found by
+ * page_lookup()), and everything while the cage is on, bypass the caches.
+ * page_pcache_reap() drains every cache, and is called whenever free memory
+ * is needed in bulk: by page_create_get_something() and
+ * page_freelist_coalesce_all().  It is also called by anything that needs a
+ * particular free page: page_retire(), once the page is toxic (toxic pages
+ * are neither cached nor taken by a refill), and delete_memory_thread() on
+ * each pass over the span being deleted.  Relocation needs no help, as the
+ * caches are bypassed whenever the cage is on.
+ *
+ * The caches are disabled unless page_pcache_enable is set in /etc/system.
+ *
+ * Hits, misses and time spent waiting for freelist mutexes are reported in
+ * the unix:0:page_pcache kstat.
+ */
+#define	PAGE_PCACHE_BINS	16
+
+typedef struct page_pcache {
+	kmutex_t	ppc_lock;
+	uint_t		ppc_count;			/* pages cached */
+	uint_t		ppc_rotor;			/* next bin to drain */
+	page_t		*ppc_bins[PAGE_PCACHE_BINS];	/* pages by color */
+	uint64_t	ppc_hit;
+	uint64_t	ppc_miss;
+	uint64_t	ppc_refill;			/* pages refilled */
+	uint64_t	ppc_drain;			/* pages drained */
+	uint64_t	ppc_lockwait;			/* unscaled */
+} page_pcache_t;
+
+typedef struct page_pcache_kstat {
+	kstat_named_t	ppk_hit;
+	kstat_named_t	ppk_miss;
+	kstat_named_t	ppk_refill;
+	kstat_named_t	ppk_drain;
+	kstat_named_t	ppk_cached;
+	kstat_named_t	ppk_lockwait;
+} page_pcache_kstat_t;
+
+int	page_pcache_enable = 0;
+uint_t	page_pcache_max = 64;		/* max pages cached per CPU */
+uint_t	page_pcache_batch = 16;		/* pages per refill or drain */
+
+static caddr_t		page_pcaches;	/* max_ncpus caches, by cpu_seqid */
+static size_t		page_pcache_size;
+static page_pcache_kstat_t page_pcache_kstat_data;
+
+#define	PAGE_PCACHE(seqid)	\
+	((page_pcache_t *)(page_pcaches + (seqid) * page_pcache_size))
+
+/*
+ * Acquire a freelist mutex, accounting for any time spent waiting for it.
+ */
+static void
+page_freelist_mutex_enter(kmutex_t *pcm)
+{
+	hrtime_t start;
+
+	if (mutex_tryenter(pcm))
+		return;
+
+	start = gethrtime_unscaled();
+	mutex_enter(pcm);
+	if (page_pcaches != NULL) {
+		atomic_add_64(&PAGE_PCACHE(CPU->cpu_seqid)->ppc_lockwait,
+		    gethrtime_unscaled() - start);
+	}
+}
+
+/*
+ * Return up to npages pages from a cache to the freelists.
+ */
+static void
+page_pcache_drain(page_pcache_t *ppc, uint_t npages)
+{
+	page_t *list = NULL, *pp;
+	page_t **ppp;
+	uint_t i;
+
+	mutex_enter(&ppc->ppc_lock);
+	for (i = 0; ppc->ppc_count != 0 && npages != 0 &&
+	    i < PAGE_PCACHE_BINS; ) {
+		ppp = &ppc->ppc_bins[ppc->ppc_rotor];
+		if ((pp = *ppp) == NULL) {
+			ppc->ppc_rotor = (ppc->ppc_rotor + 1) &
+			    (PAGE_PCACHE_BINS - 1);
+			i++;
+			continue;
+		}
+		page_sub(ppp, pp);
+		page_add(&list, pp);
+		ppc->ppc_count--;
+		ppc->ppc_drain++;
+		npages--;
+	}
+	mutex_exit(&ppc->ppc_lock);
+
+	while ((pp = list) != NULL) {
+		page_sub(&list, pp);
+		page_list_add(pp, PG_FREE_LIST | PG_LIST_TAIL);
+		page_unlock(pp);
+	}
+}
+
+/*
+ * Take a batch of pages of the given color from the freelists into a cache,
+ * returning the number taken.
+ */
+static uint_t
+page_pcache_refill(page_pcache_t *ppc, int mnode, uint_t bin, int mtype)
+{
+	kmutex_t *pcm = PC_BIN_MUTEX(mnode, bin, PG_FREE_LIST);
+	page_t **fpp = &PAGE_FREELISTS(mnode, 0, bin, mtype);
+	page_t *list = NULL, *pp;
+	uint_t i, n = 0;
+
+	if (*fpp == NULL)
+		return (0);
+
+	page_freelist_mutex_enter(pcm);
+	for (i = 0; i < page_pcache_batch && (pp = *fpp) != NULL; i++) {
+		ASSERT(PP_ISFREE(pp) && PP_ISAGED(pp));
+		ASSERT(pp->p_szc == 0 && pp->p_vnode == NULL);
+		if (IS_DUMP_PAGE(pp) || pp->p_toxic != 0 ||
+		    !page_trylock(pp, SE_EXCL)) {
+			*fpp = pp->p_next;
+			continue;
+		}
+		page_sub(fpp, pp);
+		page_ctr_sub(mnode, mtype, pp, PG_FREE_LIST);
+		page_add(&list, pp);
+		n++;
+	}
+	mutex_exit(pcm);
+
+	if (n != 0) {
+		mutex_enter(&ppc->ppc_lock);
+		page_list_concat(&ppc->ppc_bins[bin & (PAGE_PCACHE_BINS - 1)],
+		    &list);
+		ppc->ppc_count += n;
+		ppc->ppc_refill += n;
+		mutex_exit(&ppc->ppc_lock);
+	}
+	return (n);
+}
+
+/*
+ * Allocate a page of the given mnode, color and mtype from the cache of the
+ * current CPU, refilling it from the freelists if need be.  The page is
+ * returned locked, just as from page_get_mnode_freelist().
+ */
+static page_t *
+page_pcache_get(int mnode, uint_t bin, int mtype, uint_t flags)
+{
+	page_pcache_t *ppc;
+	page_t **ppp, *pp;
+	boolean_t refilled = B_FALSE;
+
+	if (page_pcaches == NULL || !page_pcache_enable || kcage_on ||
+	    (flags & PG_NORELOC))
+		return (NULL);
+
+	MTYPE_START(mnode, mtype, flags);
+	if (mtype < 0)
+		return (NULL);
+
+	ppc = PAGE_PCACHE(CPU->cpu_seqid);
+	ppp = &ppc->ppc_bins[bin & (PAGE_PCACHE_BINS - 1)];
+again:
+	mutex_enter(&ppc->ppc_lock);
+	if ((pp = *ppp) != NULL) {
+		do {
+			if (PP_2_BIN(pp) == bin &&
+			    PP_2_MEM_NODE(pp) == mnode &&
+			    PP_2_MTYPE(pp) == mtype) {
+				page_sub(ppp, pp);
+				ppc->ppc_count--;
+				if (!refilled)
+					ppc->ppc_hit++;
+				mutex_exit(&ppc->ppc_lock);
+				return (pp);
+			}
+		} while ((pp = pp->p_next) != *ppp);
+	}
+	if (refilled) {
+		mutex_exit(&ppc->ppc_lock);
+		return (NULL);
+	}
+	ppc->ppc_miss++;
+	mutex_exit(&ppc->ppc_lock);
+
+	if (page_pcache_refill(ppc, mnode, bin, mtype) == 0)
+		return (NULL);
+	refilled = B_TRUE;
+	goto again;
+}
+
+/*
+ * Called by page_free() with a locked free page that has no identity.
+ * Returns non-zero if the page has been cached, in which case it stays
+ * locked and the caller must not touch it again.
+ */
+int
+page_pcache_put(page_t *pp)
+{
+	page_pcache_t *ppc;
+
+	ASSERT(PAGE_EXCL(pp));
+	ASSERT(PP_ISFREE(pp) && PP_ISAGED(pp));
+
+	if (page_pcaches == NULL || !page_pcache_enable || kcage_on ||
+	    pp->p_szc != 0 || pp->p_toxic != 0 || PP_ISNORELOC(pp) ||
+	    IS_DUMP_PAGE(pp))
+		return (0);
+
+	ppc = PAGE_PCACHE(CPU->cpu_seqid);
+	if (ppc->ppc_count >= page_pcache_max) {
+		page_pcache_drain(ppc, page_pcache_batch);
+		if (ppc->ppc_count >= page_pcache_max)
+			return (0);
+	}
+
+	mutex_enter(&ppc->ppc_lock);
+	page_add(&ppc->ppc_bins[PP_2_BIN(pp) & (PAGE_PCACHE_BINS - 1)], pp);
+	ppc->ppc_count++;
+	mutex_exit(&ppc->ppc_lock);
+	return (1);
+}
+
+/*
+ * Return the pages in every cache to the freelists.
+ */
+void
+page_pcache_reap(void)
+{
+	int i;
+
+	if (page_pcaches == NULL)
+		return;
+
+	for (i = 0; i < max_ncpus; i++) {
+		if (PAGE_PCACHE(i)->ppc_count != 0)
+			page_pcache_drain(PAGE_PCACHE(i), UINT_MAX);
+	}
+}
+
+static void
+page_pcache_drain_cpu(struct cpu *cp)
+{
+	if (page_pcaches != NULL)
+		page_pcache_drain(PAGE_PCACHE(cp->cpu_seqid), UINT_MAX);
+}
+
+static int
+page_pcache_kstat_update(kstat_t *ksp, int rw)
+{
+	page_pcache_kstat_t *ppk = ksp->ks_data;
+	uint64_t hit = 0, miss = 0, refill = 0, drain = 0, cached = 0;
+	hrtime_t lockwait = 0;
+	page_pcache_t *ppc;
+	int i;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (i = 0; i < max_ncpus; i++) {
+		ppc = PAGE_PCACHE(i);
+		hit += ppc->ppc_hit;
+		miss += ppc->ppc_miss;
+		refill += ppc->ppc_refill;
+		drain += ppc->ppc_drain;
+		cached += ppc->ppc_count;
+		lockwait += ppc->ppc_lockwait;
+	}
+	scalehrtime(&lockwait);
+
+	ppk->ppk_hit.value.ui64 = hit;
+	ppk->ppk_miss.value.ui64 = miss;
+	ppk->ppk_refill.value.ui64 = refill;
+	ppk->ppk_drain.value.ui64 = drain;
+	ppk->ppk_cached.value.ui64 = cached;
+	ppk->ppk_lockwait.value.ui64 = lockwait;
+
+	return (0);
+}
+
+/*
+ * Called once kmem is up and max_ncpus is known; until then, pages go
+ * straight to and from the freelists.
+ */
+void
+page_pcache_init(void)
+{
+	page_pcache_kstat_t *ppk = &page_pcache_kstat_data;
+	kstat_t *ksp;
+	caddr_t pcaches;
+	int i;
+
+	page_pcache_size = P2ROUNDUP(sizeof (page_pcache_t), 64);
+	pcaches = kmem_zalloc(max_ncpus * page_pcache_size, KM_SLEEP);
+	for (i = 0; i < max_ncpus; i++) {
+		mutex_init(&((page_pcache_t *)(pcaches +
+		    i * page_pcache_size))->ppc_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+	}
+	membar_producer();
+	page_pcaches = pcaches;
+
+	if ((ksp = kstat_create("unix", 0, "page_pcache", "vm",
+	    KSTAT_TYPE_NAMED, sizeof (page_pcache_kstat_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL)) != NULL) {
+		kstat_named_init(&ppk->ppk_hit, "hits", KSTAT_DATA_UINT64);
+		kstat_named_init(&ppk->ppk_miss, "misses", KSTAT_DATA_UINT64);
+		kstat_named_init(&ppk->ppk_refill, "refills",
+		    KSTAT_DATA_UINT64);
+		kstat_named_init(&ppk->ppk_drain, "drains", KSTAT_DATA_UINT64);
+		kstat_named_init(&ppk->ppk_cached, "cached", KSTAT_DATA_UINT64);
+		kstat_named_init(&ppk->ppk_lockwait, "lockwait_ns",
+		    KSTAT_DATA_UINT64);
+		ksp->ks_data = ppk;
+		ksp->ks_update = page_pcache_kstat_update;
+		kstat_install(ksp);
+	}
+}
+
+/*
+ * Pre-zeroed page pool.  Every zero-fill-on-demand fault would otherwise
+ * zero its page in the faulting thread, which for a large mmap being touched
+ * for the first time is most of the cost of the fault.  page_zpool_thread
+ * therefore takes free PAGESIZE pages from the freelists while the system has
+ * memory to spare and its CPU has nothing else to run, zeroes them, marks
+ * them P_ZERO and keeps them in a pool per mnode, hashed by color into
+ * PAGE_ZPOOL_BINS bins each with its own lock.  page_get_freelist() looks in
+ * the pool first for requests that pass PG_ZERO, and anon_zero() skips
+ * pagezero() for any page it is handed that is still P_ZERO.
+ *
+ * As with the per-CPU page caches, pooled pages stay PP_ISFREE and counted in
+ * freemem, are off the freelists and out of the page counters, and are held
+ * SE_EXCL locked.  The pool is only filled from the highest mtype of each
+ * mnode, which is where ordinary allocations are satisfied first, and is
+ * bypassed while the cage is on.  page_zpool_reap() returns the pool to the
+ * freelists; since free pages are never written, they keep P_ZERO there and
+ * may still save a later zero-fill.  PP_SETFREE() clears P_ZERO when a page
+ * that has been in use is freed, page_create_va() clears it for any request
+ * that did not ask for PG_ZERO, and anon_private() for a page it copies into.
+ * As with the per-CPU page caches, page_retire() and delete_memory_thread()
+ * reap the pool to get at a particular free page, and toxic and dump pages
+ * are never pooled.
+ *
+ * The pool is disabled unless page_zpool_enable is set in /etc/system.
+ *
+ * Zeroing is done by pagezero(), which on x86 already uses non-temporal
+ * stores (hwblkclr()) when the CPU supports them, so filling the pool does
+ * not displace the cache contents of whatever runs next on its CPU.
+ *
+ * Hits, misses and pages zeroed are reported in the unix:0:page_zpool kstat.
+ */
+#define	PAGE_ZPOOL_BINS	64
+
+typedef struct page_zbin {
+	kmutex_t	pzb_lock;
+	uint_t		pzb_count;		/* pages pooled */
+	page_t		*pzb_list;
+	uint64_t	pzb_hit;
+	uint64_t	pzb_miss;
+} page_zbin_t;
+
+typedef struct page_zpool_kstat {
+	kstat_named_t	pzk_hit;
+	kstat_named_t	pzk_miss;
+	kstat_named_t	pzk_zeroed;
+	kstat_named_t	pzk_drain;
+	kstat_named_t	pzk_pooled;
+} page_zpool_kstat_t;
+
+int	page_zpool_enable = 0;
+pgcnt_t	page_zpool_max = 0;		/* max pages pooled, 0 for default */
+uint_t	page_zpool_batch = 32;		/* pages zeroed between idle checks */
+int	page_zpool_interval = 100;	/* msec between fills */
+
+static caddr_t		page_zbins;	/* PAGE_ZPOOL_BINS per mnode */
+static size_t		page_zbin_size;
+static uint_t		page_zpool_rotor;
+static uint64_t		page_zpool_zeroed;
+static uint64_t		page_zpool_drained;
+static page_zpool_kstat_t page_zpool_kstat_data;
+
+#define	PAGE_ZBIN(mnode, bin)						\
+	((page_zbin_t *)(page_zbins + ((mnode) * PAGE_ZPOOL_BINS +	\
+	((bin) & (PAGE_ZPOOL_BINS - 1))) * page_zbin_size))
+
+static pgcnt_t
+page_zpool_pages(int mnode)
+{
+	pgcnt_t count = 0;
+	uint_t i;
+
+	for (i = 0; i < PAGE_ZPOOL_BINS; i++)
+		count += PAGE_ZBIN(mnode, i)->pzb_count;
+	return (count);
+}
+
+/*
+ * Allocate a zeroed page of the given mnode, color and mtype from the pool.
+ * The page is returned locked and P_ZERO, just as from
+ * page_get_mnode_freelist().
+ */
+static page_t *
+page_zpool_get(int mnode, uint_t bin, int mtype, uint_t flags)
+{
+	page_zbin_t *pzb;
+	page_t *pp;
+
+	if (page_zbins == NULL || !page_zpool_enable || kcage_on ||
+	    (flags & PG_NORELOC))
+		return (NULL);
+
+	MTYPE_START(mnode, mtype, flags);
+	if (mtype < 0)
+		return (NULL);
+
+	pzb = PAGE_ZBIN(mnode, bin);
+	mutex_enter(&pzb->pzb_lock);
+	if ((pp = pzb->pzb_list) != NULL) {
+		do {
+			if (PP_2_BIN(pp) == bin && PP_2_MTYPE(pp) == mtype) {
+				ASSERT(PP_ISZERO(pp));
+				page_sub(&pzb->pzb_list, pp);
+				pzb->pzb_count--;
+				pzb->pzb_hit++;
+				mutex_exit(&pzb->pzb_lock);
+				return (pp);
+			}
+		} while ((pp = pp->p_next) != pzb->pzb_list);
+	}
+	pzb->pzb_miss++;
+	mutex_exit(&pzb->pzb_lock);
+	return (NULL);
+}
+
+/*
+ * Zero free pages into the pool of an mnode until it holds target pages,
+ * free memory runs short, or something else wants this CPU.
+ */
+static void
+page_zpool_fill(int mnode, pgcnt_t target)
+{
+	uint_t ncolors = PAGE_GET_PAGECOLORS(0);
+	uint_t flags = PGI_NOCAGE;
+	page_zbin_t *pzb;
+	page_t *pp;
+	uint_t i;
+	int mtype;
+
+	/* LINTED */
+	MTYPE_INIT(mtype, NULL, NULL, flags, PAGESIZE);
+	MTYPE_START(mnode, mtype, flags);
+	if (mtype < 0)
+		return;
+	flags &= ~PGI_MT_RANGE;
+
+	while (page_zpool_pages(mnode) < target) {
+		for (i = 0; i < page_zpool_batch; i++) {
+			if (!page_zpool_enable || kcage_on ||
+			    freemem <= 2 * lotsfree)
+				return;
+
+			pp = page_get_mnode_freelist(mnode,
+			    page_zpool_rotor++ % ncolors, mtype, 0, flags);
+			if (pp == NULL)
+				return;
+
+			/*
+			 * Toxic pages are left for page_retire(), and dump
+			 * pages for the dump.
+			 */
+			if (IS_DUMP_PAGE(pp) || pp->p_toxic != 0) {
+				page_list_add(pp, PG_FREE_LIST | PG_LIST_TAIL);
+				page_unlock(pp);
+				continue;
+			}
+
+			pagezero(pp, 0, PAGESIZE);
+			PP_SETZERO(pp);
+			page_zpool_zeroed++;
+
+			pzb = PAGE_ZBIN(mnode, PP_2_BIN(pp));
+			mutex_enter(&pzb->pzb_lock);
+			page_add(&pzb->pzb_list, pp);
+			pzb->pzb_count++;
+			mutex_exit(&pzb->pzb_lock);
+		}
+		if (CPU->cpu_disp->disp_nrunnable != 0)
+			return;
+	}
+}
+
+/*
+ * Return every pooled page to the freelists.
+ */
+void
+page_zpool_reap(void)
+{
+	page_zbin_t *pzb;
+	page_t *list, *pp;
+	uint64_t n;
+	int mnode;
+	uint_t i;
+
+	if (page_zbins == NULL)
+		return;
+
+	for (mnode = 0; mnode < max_mem_nodes; mnode++) {
+		for (i = 0; i < PAGE_ZPOOL_BINS; i++) {
+			pzb = PAGE_ZBIN(mnode, i);
+			if (pzb->pzb_count == 0)
+				continue;
+
+			mutex_enter(&pzb->pzb_lock);
+			list = pzb->pzb_list;
+			n = pzb->pzb_count;
+			pzb->pzb_list = NULL;
+			pzb->pzb_count = 0;
+			mutex_exit(&pzb->pzb_lock);
+
+			while ((pp = list) != NULL) {
+				page_sub(&list, pp);
+				page_list_add(pp, PG_FREE_LIST | PG_LIST_TAIL);
+				page_unlock(pp);
+			}
+			atomic_add_64(&page_zpool_drained, n);
+		}
+	}
+}
+
+static void
+page_zpool_thread(void)
+{
+	callb_cpr_t cpr_info;
+	kmutex_t cpr_lock;	/* just for CPR stuff */
+	pgcnt_t target;
+	int mnode;
+
+	mutex_init(&cpr_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	CALLB_CPR_INIT(&cpr_info, &cpr_lock,
+	    callb_generic_cpr, "page_zpool");
+
+	for (;;) {
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_BEGIN(&cpr_info);
+		mutex_exit(&cpr_lock);
+		delay(MAX(MSEC_TO_TICK(page_zpool_interval), 1));
+		mutex_enter(&cpr_lock);
+		CALLB_CPR_SAFE_END(&cpr_info, &cpr_lock);
+		mutex_exit(&cpr_lock);
+
+		if (!page_zpool_enable || kcage_on || freemem < lotsfree) {
+			page_zpool_reap();
+			continue;
+		}
+
+		target = page_zpool_max / MAX(max_mem_nodes, 1);
+		for (mnode = 0; mnode < max_mem_nodes; mnode++) {
+			if (mem_node_config[mnode].exists)
+				page_zpool_fill(mnode, target);
+		}
+	}
+}
+
+static int
+page_zpool_kstat_update(kstat_t *ksp, int rw)
+{
+	page_zpool_kstat_t *pzk = ksp->ks_data;
+	uint64_t hit = 0, miss = 0, pooled = 0;
+	page_zbin_t *pzb;
+	int mnode;
+	uint_t i;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (mnode = 0; mnode < max_mem_nodes; mnode++) {
+		for (i = 0; i < PAGE_ZPOOL_BINS; i++) {
+			pzb = PAGE_ZBIN(mnode, i);
+			hit += pzb->pzb_hit;
+			miss += pzb->pzb_miss;
+			pooled += pzb->pzb_count;
+		}
+	}
+
+	pzk->pzk_hit.value.ui64 = hit;
+	pzk->pzk_miss.value.ui64 = miss;
+	pzk->pzk_zeroed.value.ui64 = page_zpool_zeroed;
+	pzk->pzk_drain.value.ui64 = page_zpool_drained;
+	pzk->pzk_pooled.value.ui64 = pooled;
+
+	return (0);
+}
+
+/*
+ * Called once kmem is up; by default, the pool is allowed to grow to 1/256th
+ * of memory, up to 256MB.
+ */
+void
+page_zpool_init(void)
+{
+	page_zpool_kstat_t *pzk = &page_zpool_kstat_data;
+	kstat_t *ksp;
+	caddr_t zbins;
+	int i;
+
+	if (page_zpool_max == 0)
+		page_zpool_max = MIN(physmem / 256, btop(256 * 1024 * 1024));
+
+	page_zbin_size = P2ROUNDUP(sizeof (page_zbin_t), 64);
+	zbins = kmem_zalloc(max_mem_nodes * PAGE_ZPOOL_BINS * page_zbin_size,
+	    KM_SLEEP);
+	for (i = 0; i < max_mem_nodes * PAGE_ZPOOL_BINS; i++) {
+		mutex_init(&((page_zbin_t *)(zbins +
+		    i * page_zbin_size))->pzb_lock, NULL, MUTEX_DEFAULT, NULL);
+	}
+	membar_producer();
+	page_zbins = zbins;
+
+	if ((ksp = kstat_create("unix", 0, "page_zpool", "vm",
+	    KSTAT_TYPE_NAMED, sizeof (page_zpool_kstat_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL)) != NULL) {
+		kstat_named_init(&pzk->pzk_hit, "hits", KSTAT_DATA_UINT64);
+		kstat_named_init(&pzk->pzk_miss, "misses", KSTAT_DATA_UINT64);
+		kstat_named_init(&pzk->pzk_zeroed, "zeroed",
+		    KSTAT_DATA_UINT64);
+		kstat_named_init(&pzk->pzk_drain, "drains", KSTAT_DATA_UINT64);
+		kstat_named_init(&pzk->pzk_pooled, "pooled", KSTAT_DATA_UINT64);
+		ksp->ks_data = pzk;
+		ksp->ks_update = page_zpool_kstat_update;
+		kstat_install(ksp);
+	}
+
+	(void) thread_create(NULL, 0, page_zpool_thread, NULL, 0, &p0,
+	    TS_RUN, minclsyspri);
+}
+
 /*
  * add pp to the specified page list. Defaults to head of the page list
  * unless PG_LIST_TAIL is specified.
@@ -1441,7 +2103,7 @@ page_list_add(page_t *pp, int flags)
 			ASSERT((pp->p_offset & PAGEOFFSET) == 0);
 			ppp = &PAGE_CACHELISTS(mnode, bin, mtype);
 		}
-		mutex_enter(pcm);
+		page_freelist_mutex_enter(pcm);
 		page_add(ppp, pp);
 
 		if (flags & PG_LIST_TAIL)
@@ -2499,6 +3161,9 @@ page_freelist_coalesce_all(int mnode)
 
 	VM_STAT_ADD(vmm_vmstats.page_ctrs_coalesce_all);
 
+	page_pcache_reap();
+	page_zpool_reap();
+
 	if (mpss_coalesce_disable) {
 		return;
 	}
@@ -2951,7 +3616,7 @@ try_again:
 				goto bin_empty_1;
 
 			pcm = PC_BIN_MUTEX(mnode, bin, PG_FREE_LIST);
-			mutex_enter(pcm);
+			page_freelist_mutex_enter(pcm);
 			pp = PAGE_FREELISTS(mnode, szc, bin, mtype);
 			if (pp == NULL)
 				goto bin_empty_0;
@@ -3793,7 +4458,15 @@ page_get_freelist(struct vnode *vp, u_offset_t off, struct seg *seg,
 pgretry:
 	LGRP_MNODE_COOKIE_INIT(lgrp_cookie, lgrp, LGRP_SRCH_LOCAL);
 	while ((mnode = lgrp_memnode_choose(&lgrp_cookie)) >= 0) {
-		pp = page_get_func(mnode, bin, mtype, szc, flags);
+		pp = NULL;
+		if (szc == 0 && page_get_func == page_get_mnode_freelist) {
+			if (flags & PG_ZERO)
+				pp = page_zpool_get(mnode, bin, mtype, flags);
+			if (pp == NULL)
+				pp = page_pcache_get(mnode, bin, mtype, flags);
+		}
+		if (pp == NULL)
+			pp = page_get_func(mnode, bin, mtype, szc, flags);
 		if (pp != NULL) {
 			VM_STAT_ADD(vmm_vmstats.pgf_allocok[szc]);
 			DTRACE_PROBE4(page__get,
@@ -0,0 +1,413 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+#include <sys/file.h>
+#include <sys/dkio.h>
+
+#include "viob_impl.h"
+
+static void viob_blk_req(void *);
+
+/*
+ * Return the number of available descriptors in the vring taking care of the
+ * 16-bit index wraparound.
+ */
+static inline uint_t
+viob_vr_num_avail(viob_vring_t *ring)
+{
+	uint16_t ndesc;
+
+	/* See viona_vr_num_avail() for the necessity of the casts. */
+	ndesc = (unsigned)*ring->vr_avail_idx - (unsigned)ring->vr_cur_aidx;
+
+	return (ndesc);
+}
+
+static void
+viob_blk_wait_outstanding(viob_vring_t *ring)
+{
+	ASSERT(MUTEX_HELD(&ring->vr_lock));
+
+	while (ring->vr_xfer_outstanding != 0) {
+		/*
+		 * Requests in flight on the taskq hold references to guest
+		 * memory, and cannot be interrupted: signals are ignored.
+		 */
+		cv_wait(&ring->vr_cv, &ring->vr_lock);
+	}
+}
+
+void
+viob_blk_ring_alloc(viob_vring_t *ring, const uint16_t qsz)
+{
+	viob_req_t *req;
+
+	req = kmem_zalloc(sizeof (viob_req_t) * qsz, KM_SLEEP);
+	ring->vr_reqs = req;
+	for (uint_t i = 0; i < qsz; i++, req++) {
+		req->r_ring = ring;
+	}
+
+	ring->vr_iov = kmem_alloc(sizeof (struct iovec) * (VIOB_IOV_MAX + 2),
+	    KM_SLEEP);
+}
+
+void
+viob_blk_ring_free(viob_vring_t *ring, const uint16_t qsz)
+{
+	if (ring->vr_reqs != NULL) {
+		kmem_free(ring->vr_reqs, sizeof (viob_req_t) * qsz);
+		ring->vr_reqs = NULL;
+	}
+
+	if (ring->vr_iov != NULL) {
+		kmem_free(ring->vr_iov,
+		    sizeof (struct iovec) * (VIOB_IOV_MAX + 2));
+		ring->vr_iov = NULL;
+	}
+}
+
+/*
+ * Enable or disable the write cache of the backing store, as the guest
+ * negotiates VIRTIO_BLK_F_FLUSH.  Without it, the guest expects each write to
+ * be stable once completed.  For a device, such as a zvol, this is its own
+ * write cache; for a regular file, writes are made synchronous instead.
+ */
+void
+viob_blk_set_wce(viob_dev_t *dev, boolean_t wce)
+{
+	if (dev->d_wce == wce)
+		return;
+
+	if (dev->d_vp->v_type == VCHR && !dev->d_rdonly) {
+		int val = wce ? 1 : 0;
+		int rv;
+
+		(void) VOP_IOCTL(dev->d_vp, DKIOCSETWCE, (intptr_t)&val,
+		    FKIOCTL | dev->d_vpflag, dev->d_cred, &rv, NULL);
+	}
+	dev->d_wce = wce;
+}
+
+static int
+viob_blk_rw(viob_dev_t *dev, struct iovec *iov, uint_t niov, uint64_t sector,
+    boolean_t write, size_t *lenp)
+{
+	vnode_t *vp = dev->d_vp;
+	struct uio uio;
+	size_t len = 0;
+	int err;
+
+	for (uint_t i = 0; i < niov; i++)
+		len += iov[i].iov_len;
+
+	if (sector > (dev->d_size >> VIOB_SECTOR_SHIFT) ||
+	    len > dev->d_size - (sector << VIOB_SECTOR_SHIFT)) {
+		return (EIO);
+	}
+
+	bzero(&uio, sizeof (uio));
+	uio.uio_iov = iov;
+	uio.uio_iovcnt = niov;
+	uio.uio_loffset = (offset_t)(sector << VIOB_SECTOR_SHIFT);
+	uio.uio_segflg = UIO_SYSSPACE;
+	uio.uio_llimit = MAXOFFSET_T;
+	uio.uio_resid = len;
+	uio.uio_extflg = UIO_COPY_DEFAULT;
+
+	if (write) {
+		int ioflag = dev->d_wce ? 0 : FDSYNC;
+
+		uio.uio_fmode = FWRITE;
+		(void) VOP_RWLOCK(vp, V_WRITELOCK_TRUE, NULL);
+		err = VOP_WRITE(vp, &uio, ioflag, dev->d_cred, NULL);
+		VOP_RWUNLOCK(vp, V_WRITELOCK_TRUE, NULL);
+	} else {
+		uio.uio_fmode = FREAD;
+		(void) VOP_RWLOCK(vp, V_WRITELOCK_FALSE, NULL);
+		err = VOP_READ(vp, &uio, 0, dev->d_cred, NULL);
+		VOP_RWUNLOCK(vp, V_WRITELOCK_FALSE, NULL);
+	}
+
+	if (err == 0 && uio.uio_resid != 0)
+		err = EIO;
+	*lenp = len - uio.uio_resid;
+	return (err);
+}
+
+static int
+viob_blk_flush(viob_dev_t *dev)
+{
+	vnode_t *vp = dev->d_vp;
+	int rv;
+
+	if (vp->v_type == VCHR) {
+		return (VOP_IOCTL(vp, DKIOCFLUSHWRITECACHE, 0,
+		    FKIOCTL | dev->d_vpflag, dev->d_cred, &rv, NULL));
+	}
+	return (VOP_FSYNC(vp, FSYNC, dev->d_cred, NULL));
+}
+
+static void
+viob_blk_done(viob_vring_t *ring, uint32_t len, uint16_t cookie)
+{
+	vq_pushchain(ring, len, cookie);
+
+	membar_enter();
+	if ((*ring->vr_avail_flags & VRING_AVAIL_F_NO_INTERRUPT) == 0) {
+		viob_intr_ring(ring);
+	}
+}
+
+/*
+ * Service a request on the device taskq.  The chain consists of the request
+ * header, any data buffers and the status byte, in that order.
+ */
+static void
+viob_blk_req(void *arg)
+{
+	viob_req_t *req = arg;
+	viob_vring_t *ring = req->r_ring;
+	viob_dev_t *dev = ring->vr_dev;
+	struct iovec *iov = req->r_iov;
+	const uint_t ndata = req->r_niov - 2;
+	struct virtio_blk_hdr hdr;
+	uint8_t *status;
+	uint32_t len = 1;
+	uint16_t cookie;
+	size_t nbytes = 0;
+	int err;
+
+	/*
+	 * Copy the header, which lives in guest memory, so that its contents
+	 * cannot change beneath us.
+	 */
+	bcopy(iov[0].iov_base, &hdr, sizeof (hdr));
+	status = (uint8_t *)iov[req->r_niov - 1].iov_base;
+
+	switch (hdr.vbh_type & ~VIRTIO_BLK_T_BARRIER) {
+	case VIRTIO_BLK_T_IN:
+		err = viob_blk_rw(dev, &iov[1], ndata, hdr.vbh_sector, B_FALSE,
+		    &nbytes);
+		VIOB_RING_STAT_INCR(ring, reads);
+		VIOB_RING_STAT_ADD(ring, nread, nbytes);
+		len += nbytes;
+		break;
+	case VIRTIO_BLK_T_OUT:
+		if (dev->d_rdonly) {
+			err = EROFS;
+			break;
+		}
+		err = viob_blk_rw(dev, &iov[1], ndata, hdr.vbh_sector, B_TRUE,
+		    &nbytes);
+		VIOB_RING_STAT_INCR(ring, writes);
+		VIOB_RING_STAT_ADD(ring, nwritten, nbytes);
+		break;
+	case VIRTIO_BLK_T_FLUSH:
+	case VIRTIO_BLK_T_FLUSH_OUT:
+		err = viob_blk_flush(dev);
+		VIOB_RING_STAT_INCR(ring, flushes);
+		break;
+	case VIRTIO_BLK_T_GET_ID:
+		if (ndata == 0) {
+			err = EINVAL;
+			break;
+		}
+		/* The ident is not NUL-terminated if it fills the buffer */
+		bzero(iov[1].iov_base, iov[1].iov_len);
+		bcopy(dev->d_ident, iov[1].iov_base,
+		    MIN(iov[1].iov_len, VIOB_IDENT_LEN));
+		len += MIN(iov[1].iov_len, VIOB_IDENT_LEN);
+		err = 0;
+		break;
+	default:
+		err = ENOTSUP;
+		break;
+	}
+
+	if (err == 0) {
+		*status = VIRTIO_BLK_S_OK;
+	} else if (err == ENOTSUP) {
+		VIOB_RING_STAT_INCR(ring, unsupported);
+		*status = VIRTIO_BLK_S_UNSUPP;
+	} else {
+		VIOB_PROBE3(io_error, viob_vring_t *, ring,
+		    uint32_t, hdr.vbh_type, int, err);
+		VIOB_RING_STAT_INCR(ring, errors);
+		*status = VIRTIO_BLK_S_IOERR;
+	}
+
+	/*
+	 * The request is finished with before its chain is returned, so that
+	 * the guest finds the slot free as soon as it may reuse the head.
+	 */
+	cookie = req->r_cookie;
+	membar_exit();
+	req->r_busy = 0;
+
+	viob_blk_done(ring, len, cookie);
+
+	mutex_enter(&ring->vr_lock);
+	if ((--ring->vr_xfer_outstanding) == 0) {
+		cv_broadcast(&ring->vr_cv);
+	}
+	mutex_exit(&ring->vr_lock);
+}
+
+/*
+ * Pop a request from the ring and hand it to the taskq.  Returns B_FALSE if
+ * the ring is malformed, after which it cannot make progress until the guest
+ * resets it.
+ */
+static boolean_t
+viob_blk(viob_dev_t *dev, viob_vring_t *ring)
+{
+	struct iovec *iov = ring->vr_iov;
+	viob_req_t *req;
+	uint16_t cookie;
+	int n;
+
+	n = vq_popchain(ring, iov, VIOB_IOV_MAX + 2, &cookie);
+	if (n <= 0) {
+		VIOB_PROBE1(bad_chain, viob_vring_t *, ring);
+		return (B_FALSE);
+	}
+
+	/*
+	 * A request needs at least its header and status, which must be of
+	 * the expected sizes.  One which does not is returned unprocessed.
+	 */
+	if (n < 2 || iov[0].iov_len < sizeof (struct virtio_blk_hdr) ||
+	    iov[n - 1].iov_len != 1) {
+		VIOB_PROBE2(bad_req, viob_vring_t *, ring, int, n);
+		VIOB_RING_STAT_INCR(ring, bad_req);
+		viob_blk_done(ring, 0, cookie);
+		return (B_TRUE);
+	}
+
+	/*
+	 * A guest driver operating properly does not reuse a head descriptor
+	 * before its request is posted to the 'used' ring.  One which does has
+	 * the duplicate chain dropped, leaving the request in flight alone.
+	 */
+	req = &ring->vr_reqs[cookie];
+	if (atomic_cas_uint(&req->r_busy, 0, 1) != 0) {
+		VIOB_PROBE2(dup_req, viob_vring_t *, ring, uint16_t, cookie);
+		VIOB_RING_STAT_INCR(ring, bad_req);
+		return (B_TRUE);
+	}
+
+	bcopy(iov, req->r_iov, sizeof (struct iovec) * n);
+	req->r_niov = n;
+	req->r_cookie = cookie;
+
+	mutex_enter(&ring->vr_lock);
+	ring->vr_xfer_outstanding++;
+	mutex_exit(&ring->vr_lock);
+
+	taskq_dispatch_ent(dev->d_taskq, viob_blk_req, req, 0, &req->r_tqent);
+	return (B_TRUE);
+}
+
+void
+viob_worker_blk(viob_vring_t *ring, viob_dev_t *dev)
+{
+	proc_t *p = ttoproc(curthread);
+
+	(void) thread_vsetname(curthread, "viob_%p", ring);
+
+	ASSERT(MUTEX_HELD(&ring->vr_lock));
+	ASSERT3U(ring->vr_state, ==, VRS_RUN);
+
+	mutex_exit(&ring->vr_lock);
+
+	for (;;) {
+		boolean_t bail = B_FALSE;
+		boolean_t renew = B_FALSE;
+		uint_t nreq = 0;
+
+		*ring->vr_used_flags |= VRING_USED_F_NO_NOTIFY;
+		while (viob_vr_num_avail(ring)) {
+			if (!viob_blk(dev, ring)) {
+				bail = B_TRUE;
+				break;
+			}
+
+			/*
+			 * Dispatch is cheap, but periodic breaks to check for
+			 * other events are of value.
+			 */
+			if (nreq++ >= ring->vr_size)
+				break;
+		}
+		*ring->vr_used_flags &= ~VRING_USED_F_NO_NOTIFY;
+
+		VIOB_PROBE2(blk, viob_dev_t *, dev, uint_t, nreq);
+
+		if (bail) {
+			mutex_enter(&ring->vr_lock);
+			break;
+		}
+
+		/*
+		 * Check for available descriptors on the ring once more in
+		 * case a late addition raced with the NO_NOTIFY flag toggle.
+		 *
+		 * The barrier ensures that visibility of the vr_used_flags
+		 * store does not cross the viob_vr_num_avail() check below.
+		 */
+		membar_enter();
+		bail = VRING_NEED_BAIL(ring, p);
+		renew = vmm_drv_lease_expired(ring->vr_lease);
+		if (!bail && !renew && viob_vr_num_avail(ring)) {
+			continue;
+		}
+
+		if ((dev->d_features & VIRTIO_F_RING_NOTIFY_ON_EMPTY) != 0) {
+			viob_intr_ring(ring);
+		}
+
+		mutex_enter(&ring->vr_lock);
+
+		while (!bail && !renew && !viob_vr_num_avail(ring)) {
+			(void) cv_wait_sig(&ring->vr_cv, &ring->vr_lock);
+			bail = VRING_NEED_BAIL(ring, p);
+			renew = vmm_drv_lease_expired(ring->vr_lease);
+		}
+
+		if (bail) {
+			break;
+		} else if (renew) {
+			ring->vr_state_flags |= VRSF_RENEW;
+			/*
+			 * When renewing the lease for the ring, no requests
+			 * may be outstanding, as they contain references to
+			 * guest memory.
+			 */
+			viob_blk_wait_outstanding(ring);
+
+			if (!viob_ring_lease_renew(ring)) {
+				break;
+			}
+			ring->vr_state_flags &= ~VRSF_RENEW;
+		}
+		mutex_exit(&ring->vr_lock);
+	}
+
+	ASSERT(MUTEX_HELD(&ring->vr_lock));
+
+	ring->vr_state = VRS_STOP;
+	viob_blk_wait_outstanding(ring);
+}
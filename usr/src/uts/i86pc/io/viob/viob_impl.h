@@ -0,0 +1,244 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+#ifndef	_VIOB_IMPL_H
+#define	_VIOB_IMPL_H
+
+#include <sys/ddi.h>
+#include <sys/sunddi.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <sys/kstat.h>
+#include <sys/taskq_impl.h>
+#include <sys/vnode.h>
+#include <sys/sdt.h>
+
+#include <sys/vmm_drv.h>
+#include <sys/viob_io.h>
+
+struct viob_dev;
+typedef struct viob_dev viob_dev_t;
+
+enum viob_ring_state {
+	VRS_RESET	= 0x0,	/* just allocated or reset */
+	VRS_SETUP	= 0x1,	/* addrs setup and starting worker thread */
+	VRS_INIT	= 0x2,	/* worker thread started & waiting to run */
+	VRS_RUN		= 0x3,	/* running work routine */
+	VRS_STOP	= 0x4,	/* worker is exiting */
+};
+enum viob_ring_state_flags {
+	VRSF_REQ_START	= 0x1,	/* start running from INIT state */
+	VRSF_REQ_STOP	= 0x2,	/* stop running, clean up, goto RESET state */
+	VRSF_RENEW	= 0x4,	/* ring renewing lease */
+};
+
+struct viob_vring;
+
+/*
+ * A request popped from the ring, in flight on the device taskq.  These are
+ * indexed by the head descriptor of their chain, which the guest may not reuse
+ * until the request is returned to it through the 'used' ring; r_busy catches
+ * a guest which does so anyway.
+ */
+typedef struct viob_req {
+	taskq_ent_t		r_tqent;
+	struct viob_vring	*r_ring;
+	uint_t			r_busy;
+	uint16_t		r_cookie;
+	uint_t			r_niov;
+	struct iovec		r_iov[VIOB_IOV_MAX + 2];
+} viob_req_t;
+
+typedef struct viob_vring {
+	viob_dev_t	*vr_dev;
+	uint16_t	vr_index;	/* RO: index within d_vrings */
+
+	kmutex_t	vr_lock;
+	kcondvar_t	vr_cv;
+	uint16_t	vr_state;
+	uint16_t	vr_state_flags;
+	uint_t		vr_xfer_outstanding;
+	kthread_t	*vr_worker_thread;
+	vmm_lease_t	*vr_lease;
+
+	/* ring-sized resources for request processing */
+	viob_req_t	*vr_reqs;
+	struct iovec	*vr_iov;
+
+	uint_t		vr_intr_enabled;
+	uint64_t	vr_msi_addr;
+	uint64_t	vr_msi_msg;
+
+	/* Internal ring-related state */
+	kmutex_t	vr_a_mutex;	/* sync consumers of 'avail' */
+	kmutex_t	vr_u_mutex;	/* sync consumers of 'used' */
+	uint64_t	vr_pa;
+	uint16_t	vr_size;
+	uint16_t	vr_mask;	/* cached from vr_size */
+	uint16_t	vr_cur_aidx;	/* trails behind 'avail_idx' */
+
+	/* Host-context pointers to the queue */
+	volatile struct virtio_desc	*vr_descr;
+
+	volatile uint16_t		*vr_avail_flags;
+	volatile uint16_t		*vr_avail_idx;
+	volatile uint16_t		*vr_avail_ring;
+	volatile uint16_t		*vr_avail_used_event;
+
+	volatile uint16_t		*vr_used_flags;
+	volatile uint16_t		*vr_used_idx;
+	volatile struct virtio_used	*vr_used_ring;
+	volatile uint16_t		*vr_used_avail_event;
+
+	/* Per-ring statistics, exported via vr_kstat */
+	kstat_t		*vr_kstat;
+	struct viob_ring_stats {
+		uint64_t	rs_reads;
+		uint64_t	rs_writes;
+		uint64_t	rs_flushes;
+		uint64_t	rs_nread;
+		uint64_t	rs_nwritten;
+		uint64_t	rs_errors;
+		uint64_t	rs_unsupported;
+
+		uint64_t	rs_ndesc_too_high;
+		uint64_t	rs_bad_idx;
+		uint64_t	rs_indir_bad_len;
+		uint64_t	rs_indir_bad_nest;
+		uint64_t	rs_indir_bad_next;
+		uint64_t	rs_too_many_desc;
+		uint64_t	rs_desc_bad_len;
+		uint64_t	rs_bad_ring_addr;
+		uint64_t	rs_bad_req;
+	} vr_stats;
+} viob_vring_t;
+
+#define	VIOB_MAX_RINGS		VIOB_VQ_MAX
+
+struct viob_dev {
+	vmm_hold_t		*d_vm_hold;
+	boolean_t		d_destroyed;
+
+	viob_vring_t		d_vrings[VIOB_MAX_RINGS];
+
+	uint32_t		d_features;
+
+	/* Backing store */
+	vnode_t			*d_vp;
+	int			d_vpflag;	/* FREAD/FWRITE open mode */
+	cred_t			*d_cred;
+	u_offset_t		d_size;
+	boolean_t		d_rdonly;
+	boolean_t		d_wce;		/* write cache enabled */
+	char			d_ident[VIOB_IDENT_LEN];
+	taskq_t			*d_taskq;
+
+	uint16_t		d_notify_ioport;
+	void			*d_notify_cookie;
+
+	pollhead_t		d_pollhead;
+};
+
+typedef struct viob_soft_state {
+	kmutex_t		ss_lock;
+	minor_t			ss_minor;
+	viob_dev_t		*ss_dev;
+} viob_soft_state_t;
+
+#pragma pack(1)
+struct virtio_desc {
+	uint64_t	vd_addr;
+	uint32_t	vd_len;
+	uint16_t	vd_flags;
+	uint16_t	vd_next;
+};
+
+struct virtio_used {
+	uint32_t	vu_idx;
+	uint32_t	vu_tlen;
+};
+
+struct virtio_blk_hdr {
+	uint32_t	vbh_type;
+	uint32_t	vbh_ioprio;
+	uint64_t	vbh_sector;
+};
+#pragma pack()
+
+#define	VRING_NEED_BAIL(ring, proc)					\
+		(((ring)->vr_state_flags & VRSF_REQ_STOP) != 0 ||	\
+		((proc)->p_flag & SEXITING) != 0)
+
+#define	VIOB_PROBE(name)	DTRACE_PROBE(viob__##name)
+#define	VIOB_PROBE1(name, arg1, arg2)	\
+	DTRACE_PROBE1(viob__##name, arg1, arg2)
+#define	VIOB_PROBE2(name, arg1, arg2, arg3, arg4)	\
+	DTRACE_PROBE2(viob__##name, arg1, arg2, arg3, arg4)
+#define	VIOB_PROBE3(name, arg1, arg2, arg3, arg4, arg5, arg6)	\
+	DTRACE_PROBE3(viob__##name, arg1, arg2, arg3, arg4, arg5, arg6)
+#define	VIOB_PROBE_BAD_RING_ADDR(r, a)		\
+	VIOB_PROBE2(bad_ring_addr, viob_vring_t *, r, void *, (void *)(a))
+
+#define	VIOB_RING_STAT_INCR(r, name)	\
+	(((r)->vr_stats.rs_ ## name)++)
+#define	VIOB_RING_STAT_ADD(r, name, val)	\
+	(((r)->vr_stats.rs_ ## name) += (val))
+
+#define	VRING_AVAIL_F_NO_INTERRUPT	1
+#define	VRING_USED_F_NO_NOTIFY		1
+
+#define	VRING_DESC_F_NEXT	(1 << 0)
+#define	VRING_DESC_F_WRITE	(1 << 1)
+#define	VRING_DESC_F_INDIRECT	(1 << 2)
+
+#define	VIRTIO_BLK_F_SEG_MAX		(1 << 2)
+#define	VIRTIO_BLK_F_RO			(1 << 5)
+#define	VIRTIO_BLK_F_BLK_SIZE		(1 << 6)
+#define	VIRTIO_BLK_F_FLUSH		(1 << 9)
+#define	VIRTIO_BLK_F_TOPOLOGY		(1 << 10)
+#define	VIRTIO_F_RING_NOTIFY_ON_EMPTY	(1 << 24)
+#define	VIRTIO_F_RING_INDIRECT_DESC	(1 << 28)
+
+#define	VIRTIO_BLK_T_IN			0
+#define	VIRTIO_BLK_T_OUT		1
+#define	VIRTIO_BLK_T_FLUSH		4
+#define	VIRTIO_BLK_T_FLUSH_OUT		5
+#define	VIRTIO_BLK_T_GET_ID		8
+#define	VIRTIO_BLK_T_BARRIER		0x80000000
+
+#define	VIRTIO_BLK_S_OK			0
+#define	VIRTIO_BLK_S_IOERR		1
+#define	VIRTIO_BLK_S_UNSUPP		2
+
+#define	VIOB_SECTOR_SHIFT		9
+
+
+void viob_ring_alloc(viob_dev_t *, viob_vring_t *, uint16_t);
+void viob_ring_free(viob_vring_t *);
+void viob_ring_stat_init(viob_vring_t *, minor_t);
+void viob_ring_stat_fini(viob_vring_t *);
+int viob_ring_reset(viob_vring_t *, boolean_t);
+int viob_ring_init(viob_dev_t *, uint16_t, uint16_t, uint64_t);
+boolean_t viob_ring_lease_renew(viob_vring_t *);
+int vq_popchain(viob_vring_t *, struct iovec *, uint_t, uint16_t *);
+void vq_pushchain(viob_vring_t *, uint32_t, uint16_t);
+void viob_intr_ring(viob_vring_t *);
+
+void viob_worker_blk(viob_vring_t *, viob_dev_t *);
+void viob_blk_ring_alloc(viob_vring_t *, const uint16_t);
+void viob_blk_ring_free(viob_vring_t *, const uint16_t);
+void viob_blk_set_wce(viob_dev_t *, boolean_t);
+
+#endif	/* _VIOB_IMPL_H */
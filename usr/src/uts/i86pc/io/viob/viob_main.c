@@ -0,0 +1,786 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+/*
+ * viob - VirtIO-Block, accelerated
+ *
+ * viob does for virtio-blk what viona does for virtio-net: the virtqueue of a
+ * bhyve guest's disk is processed in the kernel, against the vnode of its
+ * backing zvol or file, so that a request costs neither an exit to userspace
+ * nor the trip through the userspace block emulation.  Most of its structure
+ * is borrowed from viona, and the big theory statement in viona_main.c
+ * applies here too; only the differences are described below.
+ *
+ * An instance is created by opening the viob device and issuing
+ * VIOB_IOC_CREATE with the vmm fd and an fd for the backing store.  viob
+ * holds the vnode of the latter, opened for itself, so that the fd may be
+ * closed by bhyve afterwards.  The userspace portion of bhyve
+ * (pci_virtio_viob.c) emulates the PCI device and its configuration space,
+ * relaying the ring setup, MSI-X configuration and feature negotiation to
+ * viob via ioctls.  As with viona, an ioport hook (see vmm_drv_ioport_hook())
+ * on the virtqueue notification register allows the guest to kick the ring
+ * without exiting to userspace at all.
+ *
+ * -------
+ * Rings
+ * -------
+ *
+ * virtio-blk has a single request queue.  Its ring is serviced by a worker
+ * thread, an lwp in the bhyve process, with the same lifecycle and guest
+ * memory lease handling as the viona rings.  The worker does not perform I/O
+ * itself: each request popped from the ring is handed to a per-instance
+ * taskq, whose threads issue VOP_READ/VOP_WRITE directly on the guest buffers
+ * (mapped into the kernel through the lease) and complete the request to the
+ * 'used' ring.  The taskq allows requests to proceed in parallel, with the
+ * worker free to keep draining the ring.  Requests are preallocated, one for
+ * each possible head descriptor, so dispatch never allocates or fails.
+ *
+ * Requests in flight reference guest memory, so they are counted in
+ * vr_xfer_outstanding; lease renewal and ring reset wait for the count to
+ * drop to zero, exactly as viona does for transmissions.
+ *
+ * -------------
+ * Write caching
+ * -------------
+ *
+ * A guest which does not negotiate VIRTIO_BLK_F_FLUSH expects completed
+ * writes to be stable.  Until the feature is negotiated, the write cache of a
+ * zvol is disabled through DKIOCSETWCE, and writes to a regular file are made
+ * with FDSYNC, mirroring the behaviour of bhyve's block_if.
+ */
+
+#include <sys/conf.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/id_space.h>
+#include <sys/disp.h>
+
+#include "viob_impl.h"
+
+
+#define	VIOB_NAME		"Virtio Block Accelerator"
+#define	VIOB_CTL_MINOR		0
+
+/*
+ * Host capabilities.  VIRTIO_BLK_F_RO is added for a read-only backing store.
+ * The seg_max, blk_size and topology fields of the configuration space are
+ * provided by the userspace consumer.
+ */
+#define	VIOB_S_HOSTCAPS		(	\
+	VIRTIO_BLK_F_SEG_MAX |		\
+	VIRTIO_BLK_F_BLK_SIZE |		\
+	VIRTIO_BLK_F_FLUSH |		\
+	VIRTIO_BLK_F_TOPOLOGY |		\
+	VIRTIO_F_RING_NOTIFY_ON_EMPTY |	\
+	VIRTIO_F_RING_INDIRECT_DESC)
+
+/* Threads, and so concurrent requests, per instance */
+uint_t viob_taskq_nthreads = 8;
+
+static void		*viob_state;
+static dev_info_t	*viob_dip;
+static id_space_t	*viob_minors;
+
+
+static int viob_info(dev_info_t *dip, ddi_info_cmd_t cmd, void *arg,
+    void **result);
+static int viob_attach(dev_info_t *dip, ddi_attach_cmd_t cmd);
+static int viob_detach(dev_info_t *dip, ddi_detach_cmd_t cmd);
+static int viob_open(dev_t *devp, int flag, int otype, cred_t *credp);
+static int viob_close(dev_t dev, int flag, int otype, cred_t *credp);
+static int viob_ioctl(dev_t dev, int cmd, intptr_t data, int mode,
+    cred_t *credp, int *rval);
+static int viob_chpoll(dev_t dev, short events, int anyyet, short *reventsp,
+    struct pollhead **phpp);
+
+static int viob_ioc_create(viob_soft_state_t *, void *, int, cred_t *);
+static int viob_ioc_delete(viob_soft_state_t *, boolean_t);
+
+static int viob_ioc_set_notify_ioport(viob_dev_t *, uint16_t);
+static int viob_ioc_ring_init(viob_dev_t *, void *, int);
+static int viob_ioc_ring_reset(viob_dev_t *, uint_t);
+static int viob_ioc_ring_kick(viob_dev_t *, uint_t);
+static int viob_ioc_ring_set_msi(viob_dev_t *, void *, int);
+static int viob_ioc_ring_intr_clear(viob_dev_t *, uint_t);
+static int viob_ioc_intr_poll(viob_dev_t *, void *, int, int *);
+
+static struct cb_ops viob_cb_ops = {
+	viob_open,
+	viob_close,
+	nodev,
+	nodev,
+	nodev,
+	nodev,
+	nodev,
+	viob_ioctl,
+	nodev,
+	nodev,
+	nodev,
+	viob_chpoll,
+	ddi_prop_op,
+	0,
+	D_MP | D_NEW | D_HOTPLUG,
+	CB_REV,
+	nodev,
+	nodev
+};
+
+static struct dev_ops viob_ops = {
+	DEVO_REV,
+	0,
+	viob_info,
+	nulldev,
+	nulldev,
+	viob_attach,
+	viob_detach,
+	nodev,
+	&viob_cb_ops,
+	NULL,
+	ddi_power,
+	ddi_quiesce_not_needed
+};
+
+static struct modldrv modldrv = {
+	&mod_driverops,
+	VIOB_NAME,
+	&viob_ops,
+};
+
+static struct modlinkage modlinkage = {
+	MODREV_1, &modldrv, NULL
+};
+
+int
+_init(void)
+{
+	int ret;
+
+	ret = ddi_soft_state_init(&viob_state, sizeof (viob_soft_state_t), 0);
+	if (ret != 0) {
+		return (ret);
+	}
+
+	viob_minors = id_space_create("viob_minors",
+	    VIOB_CTL_MINOR + 1, UINT16_MAX);
+
+	ret = mod_install(&modlinkage);
+	if (ret != 0) {
+		ddi_soft_state_fini(&viob_state);
+		id_space_destroy(viob_minors);
+	}
+
+	return (ret);
+}
+
+int
+_fini(void)
+{
+	int ret;
+
+	ret = mod_remove(&modlinkage);
+	if (ret != 0) {
+		return (ret);
+	}
+
+	ddi_soft_state_fini(&viob_state);
+	id_space_destroy(viob_minors);
+
+	return (ret);
+}
+
+int
+_info(struct modinfo *modinfop)
+{
+	return (mod_info(&modlinkage, modinfop));
+}
+
+/* ARGSUSED */
+static int
+viob_info(dev_info_t *dip, ddi_info_cmd_t cmd, void *arg, void **result)
+{
+	int error;
+
+	switch (cmd) {
+	case DDI_INFO_DEVT2DEVINFO:
+		*result = (void *)viob_dip;
+		error = DDI_SUCCESS;
+		break;
+	case DDI_INFO_DEVT2INSTANCE:
+		*result = (void *)0;
+		error = DDI_SUCCESS;
+		break;
+	default:
+		error = DDI_FAILURE;
+		break;
+	}
+	return (error);
+}
+
+static int
+viob_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
+{
+	if (cmd != DDI_ATTACH) {
+		return (DDI_FAILURE);
+	}
+
+	if (ddi_create_minor_node(dip, "viob", S_IFCHR, VIOB_CTL_MINOR,
+	    DDI_PSEUDO, 0) != DDI_SUCCESS) {
+		return (DDI_FAILURE);
+	}
+
+	viob_dip = dip;
+	ddi_report_dev(viob_dip);
+
+	return (DDI_SUCCESS);
+}
+
+static int
+viob_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
+{
+	dev_info_t *old_dip = viob_dip;
+
+	if (cmd != DDI_DETACH) {
+		return (DDI_FAILURE);
+	}
+
+	VERIFY(old_dip != NULL);
+
+	viob_dip = NULL;
+	ddi_remove_minor_node(old_dip, NULL);
+
+	return (DDI_SUCCESS);
+}
+
+static int
+viob_open(dev_t *devp, int flag, int otype, cred_t *credp)
+{
+	int	minor;
+	viob_soft_state_t *ss;
+
+	if (otype != OTYP_CHR) {
+		return (EINVAL);
+	}
+	if (getminor(*devp) != VIOB_CTL_MINOR) {
+		return (ENXIO);
+	}
+
+	minor = id_alloc_nosleep(viob_minors);
+	if (minor == -1) {
+		/* All minors are busy */
+		return (EBUSY);
+	}
+	if (ddi_soft_state_zalloc(viob_state, minor) != DDI_SUCCESS) {
+		id_free(viob_minors, minor);
+		return (ENOMEM);
+	}
+
+	ss = ddi_get_soft_state(viob_state, minor);
+	mutex_init(&ss->ss_lock, NULL, MUTEX_DEFAULT, NULL);
+	ss->ss_minor = minor;
+	*devp = makedevice(getmajor(*devp), minor);
+
+	return (0);
+}
+
+static int
+viob_close(dev_t dev, int flag, int otype, cred_t *credp)
+{
+	int			minor;
+	viob_soft_state_t	*ss;
+
+	if (otype != OTYP_CHR) {
+		return (EINVAL);
+	}
+
+	minor = getminor(dev);
+
+	ss = ddi_get_soft_state(viob_state, minor);
+	if (ss == NULL) {
+		return (ENXIO);
+	}
+
+	VERIFY0(viob_ioc_delete(ss, B_TRUE));
+	mutex_destroy(&ss->ss_lock);
+	ddi_soft_state_free(viob_state, minor);
+	id_free(viob_minors, minor);
+
+	return (0);
+}
+
+static int
+viob_ioctl(dev_t dev, int cmd, intptr_t data, int md, cred_t *cr, int *rv)
+{
+	viob_soft_state_t *ss;
+	void *dptr = (void *)data;
+	int err = 0, val;
+	viob_dev_t *vdev;
+
+	ss = ddi_get_soft_state(viob_state, getminor(dev));
+	if (ss == NULL) {
+		return (ENXIO);
+	}
+
+	switch (cmd) {
+	case VIOB_IOC_CREATE:
+		return (viob_ioc_create(ss, dptr, md, cr));
+	case VIOB_IOC_DELETE:
+		return (viob_ioc_delete(ss, B_FALSE));
+	default:
+		break;
+	}
+
+	mutex_enter(&ss->ss_lock);
+	if ((vdev = ss->ss_dev) == NULL || vdev->d_destroyed ||
+	    vmm_drv_release_reqd(vdev->d_vm_hold)) {
+		mutex_exit(&ss->ss_lock);
+		return (ENXIO);
+	}
+
+	switch (cmd) {
+	case VIOB_IOC_GET_FEATURES:
+		val = VIOB_S_HOSTCAPS;
+		if (vdev->d_rdonly)
+			val |= VIRTIO_BLK_F_RO;
+		if (ddi_copyout(&val, dptr, sizeof (val), md) != 0) {
+			err = EFAULT;
+		}
+		break;
+	case VIOB_IOC_SET_FEATURES:
+		if (ddi_copyin(dptr, &val, sizeof (val), md) != 0) {
+			err = EFAULT;
+			break;
+		}
+		val &= (VIOB_S_HOSTCAPS | VIRTIO_BLK_F_RO);
+
+		vdev->d_features = val;
+		viob_blk_set_wce(vdev, (val & VIRTIO_BLK_F_FLUSH) != 0);
+		break;
+	case VIOB_IOC_RING_INIT:
+		err = viob_ioc_ring_init(vdev, dptr, md);
+		break;
+	case VIOB_IOC_RING_RESET:
+		err = viob_ioc_ring_reset(vdev, (uint_t)data);
+		break;
+	case VIOB_IOC_RING_KICK:
+		err = viob_ioc_ring_kick(vdev, (uint_t)data);
+		break;
+	case VIOB_IOC_RING_SET_MSI:
+		err = viob_ioc_ring_set_msi(vdev, dptr, md);
+		break;
+	case VIOB_IOC_RING_INTR_CLR:
+		err = viob_ioc_ring_intr_clear(vdev, (uint_t)data);
+		break;
+	case VIOB_IOC_INTR_POLL:
+		err = viob_ioc_intr_poll(vdev, dptr, md, rv);
+		break;
+	case VIOB_IOC_SET_NOTIFY_IOP:
+		if (data < 0 || data > UINT16_MAX) {
+			err = EINVAL;
+			break;
+		}
+		err = viob_ioc_set_notify_ioport(vdev, (uint16_t)data);
+		break;
+	default:
+		err = ENOTTY;
+		break;
+	}
+
+	mutex_exit(&ss->ss_lock);
+	return (err);
+}
+
+static int
+viob_chpoll(dev_t dev, short events, int anyyet, short *reventsp,
+    struct pollhead **phpp)
+{
+	viob_soft_state_t *ss;
+	viob_dev_t *vdev;
+
+	ss = ddi_get_soft_state(viob_state, getminor(dev));
+	if (ss == NULL) {
+		return (ENXIO);
+	}
+
+	mutex_enter(&ss->ss_lock);
+	if ((vdev = ss->ss_dev) == NULL || vdev->d_destroyed) {
+		mutex_exit(&ss->ss_lock);
+		return (ENXIO);
+	}
+
+	*reventsp = 0;
+	if ((events & POLLRDBAND) != 0) {
+		for (uint_t i = 0; i < VIOB_MAX_RINGS; i++) {
+			if (vdev->d_vrings[i].vr_intr_enabled != 0) {
+				*reventsp |= POLLRDBAND;
+				break;
+			}
+		}
+	}
+	if ((*reventsp == 0 && !anyyet) || (events & POLLET)) {
+		*phpp = &vdev->d_pollhead;
+	}
+	mutex_exit(&ss->ss_lock);
+
+	return (0);
+}
+
+/*
+ * Take a hold on, and open for ourselves, the vnode underlying the backing
+ * store fd, determining its size.  Only regular files and character devices,
+ * such as zvols, are supported.
+ */
+static int
+viob_backing_open(viob_dev_t *vdev, int fd, cred_t *cr)
+{
+	vnode_t *vp;
+	vattr_t va;
+	file_t *fp;
+	int flag, err;
+
+	if ((fp = getf(fd)) == NULL) {
+		return (EBADF);
+	}
+	vp = fp->f_vnode;
+	flag = fp->f_flag & (FREAD | FWRITE);
+	if ((vp->v_type != VREG && vp->v_type != VCHR) ||
+	    (flag & FREAD) == 0 || (!vdev->d_rdonly && (flag & FWRITE) == 0)) {
+		releasef(fd);
+		return (EINVAL);
+	}
+	if (vdev->d_rdonly)
+		flag = FREAD;
+	VN_HOLD(vp);
+	releasef(fd);
+
+	if ((err = VOP_OPEN(&vp, flag, cr, NULL)) != 0) {
+		VN_RELE(vp);
+		return (err);
+	}
+
+	va.va_mask = AT_SIZE;
+	if ((err = VOP_GETATTR(vp, &va, 0, cr, NULL)) != 0 ||
+	    va.va_size == 0) {
+		(void) VOP_CLOSE(vp, flag, 1, 0, cr, NULL);
+		VN_RELE(vp);
+		return (err != 0 ? err : EINVAL);
+	}
+
+	crhold(cr);
+	vdev->d_cred = cr;
+	vdev->d_vp = vp;
+	vdev->d_vpflag = flag;
+	vdev->d_size = va.va_size;
+	return (0);
+}
+
+static void
+viob_backing_close(viob_dev_t *vdev)
+{
+	if (vdev->d_vp == NULL)
+		return;
+
+	(void) VOP_CLOSE(vdev->d_vp, vdev->d_vpflag, 1, 0, vdev->d_cred, NULL);
+	VN_RELE(vdev->d_vp);
+	crfree(vdev->d_cred);
+	vdev->d_vp = NULL;
+	vdev->d_cred = NULL;
+}
+
+static int
+viob_ioc_create(viob_soft_state_t *ss, void *dptr, int md, cred_t *cr)
+{
+	vioc_blk_create_t	kvc;
+	viob_dev_t	*vdev = NULL;
+	char		tq_name[TASKQ_NAMELEN];
+	int		err = 0;
+	file_t		*fp;
+	vmm_hold_t	*hold = NULL;
+
+	ASSERT(MUTEX_NOT_HELD(&ss->ss_lock));
+
+	if (ddi_copyin(dptr, &kvc, sizeof (kvc), md) != 0) {
+		return (EFAULT);
+	}
+
+	mutex_enter(&ss->ss_lock);
+	if (ss->ss_dev != NULL) {
+		mutex_exit(&ss->ss_lock);
+		return (EEXIST);
+	}
+
+	if ((fp = getf(kvc.c_vmfd)) == NULL) {
+		err = EBADF;
+		goto bail;
+	}
+	err = vmm_drv_hold(fp, cr, &hold);
+	releasef(kvc.c_vmfd);
+	if (err != 0) {
+		goto bail;
+	}
+
+	vdev = kmem_zalloc(sizeof (viob_dev_t), KM_SLEEP);
+	vdev->d_vm_hold = hold;
+	vdev->d_rdonly = (kvc.c_flags & VIOB_CREATE_RDONLY) != 0;
+	bcopy(kvc.c_ident, vdev->d_ident, VIOB_IDENT_LEN);
+
+	if ((err = viob_backing_open(vdev, kvc.c_fd, cr)) != 0) {
+		goto bail;
+	}
+
+	/* Disable write cache until FLUSH feature is negotiated */
+	vdev->d_wce = B_TRUE;
+	viob_blk_set_wce(vdev, B_FALSE);
+
+	(void) snprintf(tq_name, sizeof (tq_name), "viob_%d", ss->ss_minor);
+	vdev->d_taskq = taskq_create(tq_name, viob_taskq_nthreads,
+	    minclsyspri, viob_taskq_nthreads, INT_MAX, TASKQ_PREPOPULATE);
+
+	for (uint_t i = 0; i < VIOB_MAX_RINGS; i++) {
+		viob_ring_alloc(vdev, &vdev->d_vrings[i], i);
+		viob_ring_stat_init(&vdev->d_vrings[i], ss->ss_minor);
+	}
+
+	ss->ss_dev = vdev;
+	mutex_exit(&ss->ss_lock);
+
+	return (0);
+
+bail:
+	if (vdev != NULL) {
+		viob_backing_close(vdev);
+		kmem_free(vdev, sizeof (viob_dev_t));
+	}
+	if (hold != NULL) {
+		vmm_drv_rele(hold);
+	}
+
+	mutex_exit(&ss->ss_lock);
+	return (err);
+}
+
+static int
+viob_ioc_delete(viob_soft_state_t *ss, boolean_t on_close)
+{
+	viob_dev_t *vdev;
+
+	mutex_enter(&ss->ss_lock);
+	if ((vdev = ss->ss_dev) == NULL) {
+		/* Device destruction already complete */
+		mutex_exit(&ss->ss_lock);
+		return (0);
+	}
+
+	if (vdev->d_destroyed) {
+		/* As for viona, this cannot be encountered on close. */
+		VERIFY(!on_close);
+		mutex_exit(&ss->ss_lock);
+		return (EAGAIN);
+	}
+	/*
+	 * The device deletion cannot fail after this point, continuing until
+	 * its successful completion is reached.
+	 */
+	vdev->d_destroyed = B_TRUE;
+
+	/*
+	 * Tear down the IO port hook so it cannot be used to kick the ring
+	 * which is about to be reset and stopped.
+	 */
+	VERIFY0(viob_ioc_set_notify_ioport(vdev, 0));
+	mutex_exit(&ss->ss_lock);
+
+	/*
+	 * Return the rings to their reset state, ignoring any possible
+	 * interruptions from signals.  This waits for all requests in flight.
+	 */
+	for (uint_t i = 0; i < VIOB_MAX_RINGS; i++) {
+		VERIFY0(viob_ring_reset(&vdev->d_vrings[i], B_FALSE));
+	}
+
+	mutex_enter(&ss->ss_lock);
+	taskq_destroy(vdev->d_taskq);
+	viob_backing_close(vdev);
+	if (vdev->d_vm_hold != NULL) {
+		vmm_drv_rele(vdev->d_vm_hold);
+		vdev->d_vm_hold = NULL;
+	}
+
+	for (uint_t i = 0; i < VIOB_MAX_RINGS; i++) {
+		viob_ring_stat_fini(&vdev->d_vrings[i]);
+		viob_ring_free(&vdev->d_vrings[i]);
+	}
+	pollhead_clean(&vdev->d_pollhead);
+	ss->ss_dev = NULL;
+	mutex_exit(&ss->ss_lock);
+
+	kmem_free(vdev, sizeof (viob_dev_t));
+	return (0);
+}
+
+static int
+viob_ioc_ring_init(viob_dev_t *vdev, void *udata, int md)
+{
+	vioc_blk_ring_init_t kri;
+
+	if (ddi_copyin(udata, &kri, sizeof (kri), md) != 0) {
+		return (EFAULT);
+	}
+
+	return (viob_ring_init(vdev, kri.ri_index, kri.ri_qsize,
+	    kri.ri_qaddr));
+}
+
+static int
+viob_ioc_ring_reset(viob_dev_t *vdev, uint_t idx)
+{
+	if (idx >= VIOB_MAX_RINGS) {
+		return (EINVAL);
+	}
+
+	return (viob_ring_reset(&vdev->d_vrings[idx], B_TRUE));
+}
+
+static int
+viob_ioc_ring_kick(viob_dev_t *vdev, uint_t idx)
+{
+	viob_vring_t *ring;
+	int err;
+
+	if (idx >= VIOB_MAX_RINGS) {
+		return (EINVAL);
+	}
+	ring = &vdev->d_vrings[idx];
+
+	mutex_enter(&ring->vr_lock);
+	switch (ring->vr_state) {
+	case VRS_SETUP:
+		/*
+		 * An early kick to a ring which is starting its worker thread
+		 * is fine.  Once that thread is active, it will process the
+		 * start-up request immediately.
+		 */
+		/* FALLTHROUGH */
+	case VRS_INIT:
+		ring->vr_state_flags |= VRSF_REQ_START;
+		/* FALLTHROUGH */
+	case VRS_RUN:
+		cv_broadcast(&ring->vr_cv);
+		err = 0;
+		break;
+	default:
+		err = EBUSY;
+		break;
+	}
+	mutex_exit(&ring->vr_lock);
+
+	return (err);
+}
+
+static int
+viob_ioc_ring_set_msi(viob_dev_t *vdev, void *data, int md)
+{
+	vioc_blk_ring_msi_t vrm;
+	viob_vring_t *ring;
+
+	if (ddi_copyin(data, &vrm, sizeof (vrm), md) != 0) {
+		return (EFAULT);
+	}
+	if (vrm.rm_index >= VIOB_MAX_RINGS) {
+		return (EINVAL);
+	}
+
+	ring = &vdev->d_vrings[vrm.rm_index];
+	mutex_enter(&ring->vr_lock);
+	ring->vr_msi_addr = vrm.rm_addr;
+	ring->vr_msi_msg = vrm.rm_msg;
+	mutex_exit(&ring->vr_lock);
+
+	return (0);
+}
+
+static int
+viob_notify_iop(void *arg, bool in, uint16_t port, uint8_t bytes,
+    uint32_t *val)
+{
+	viob_dev_t *vdev = (viob_dev_t *)arg;
+	uint16_t vq = *val;
+
+	if (in) {
+		/*
+		 * Do not service read (in/ins) requests on this ioport.
+		 * Instead, indicate that the handler is not found, causing a
+		 * fallback to userspace processing.
+		 */
+		return (ESRCH);
+	}
+
+	if (port != vdev->d_notify_ioport) {
+		return (EINVAL);
+	}
+	return (viob_ioc_ring_kick(vdev, vq));
+}
+
+static int
+viob_ioc_set_notify_ioport(viob_dev_t *vdev, uint16_t ioport)
+{
+	int err = 0;
+
+	if (vdev->d_notify_ioport != 0) {
+		vmm_drv_ioport_unhook(vdev->d_vm_hold, &vdev->d_notify_cookie);
+		vdev->d_notify_ioport = 0;
+	}
+
+	if (ioport != 0) {
+		err = vmm_drv_ioport_hook(vdev->d_vm_hold, ioport,
+		    viob_notify_iop, (void *)vdev, &vdev->d_notify_cookie);
+		if (err == 0) {
+			vdev->d_notify_ioport = ioport;
+		}
+	}
+	return (err);
+}
+
+static int
+viob_ioc_ring_intr_clear(viob_dev_t *vdev, uint_t idx)
+{
+	if (idx >= VIOB_MAX_RINGS) {
+		return (EINVAL);
+	}
+
+	vdev->d_vrings[idx].vr_intr_enabled = 0;
+	return (0);
+}
+
+static int
+viob_ioc_intr_poll(viob_dev_t *vdev, void *udata, int md, int *rv)
+{
+	uint_t cnt = 0;
+	vioc_blk_intr_poll_t vip;
+
+	for (uint_t i = 0; i < VIOB_VQ_MAX; i++) {
+		uint_t val = vdev->d_vrings[i].vr_intr_enabled;
+
+		vip.vip_status[i] = val;
+		if (val != 0) {
+			cnt++;
+		}
+	}
+
+	if (ddi_copyout(&vip, udata, sizeof (vip), md) != 0) {
+		return (EFAULT);
+	}
+	*rv = (int)cnt;
+	return (0);
+}
@@ -48,6 +48,7 @@
 #include <sys/strsun.h>
 #include <sys/sysmacros.h>
 #include <sys/uio.h>
+#include <sys/kstat.h>
 
 #include <sys/mac_client.h>
 #include <sys/mac_provider.h>
@@ -81,6 +82,7 @@ enum viona_ring_state_flags {
 
 typedef struct viona_vring {
 	viona_link_t	*vr_link;
+	uint16_t	vr_index;	/* RO: index within l_vrings */
 
 	kmutex_t	vr_lock;
 	kcondvar_t	vr_cv;
@@ -119,8 +121,12 @@ typedef struct viona_vring {
 	volatile struct virtio_used	*vr_used_ring;
 	volatile uint16_t		*vr_used_avail_event;
 
-	/* Per-ring error condition statistics */
+	/* Per-ring statistics, exported via vr_kstat */
+	kstat_t		*vr_kstat;
 	struct viona_ring_stats {
+		uint64_t	rs_packets;
+		uint64_t	rs_bytes;
+
 		uint64_t	rs_ndesc_too_high;
 		uint64_t	rs_bad_idx;
 		uint64_t	rs_indir_bad_len;
@@ -153,7 +159,8 @@ struct viona_link {
 	vmm_hold_t		*l_vm_hold;
 	boolean_t		l_destroyed;
 
-	viona_vring_t		l_vrings[VIONA_VQ_MAX];
+	viona_vring_t		l_vrings[VIONA_MAX_RINGS];
+	uint16_t		l_usepairs;	/* active queue pairs */
 
 	uint32_t		l_features;
 	uint32_t		l_features_hw;
@@ -203,6 +210,7 @@ typedef struct used_elem {
 
 typedef struct viona_soft_state {
 	kmutex_t		ss_lock;
+	minor_t			ss_minor;
 	viona_link_t		*ss_link;
 	list_node_t		ss_node;
 } viona_soft_state_t;
@@ -267,6 +275,11 @@ struct virtio_net_hdr {
 
 #define	VIONA_RING_STAT_INCR(r, name)	\
 	(((r)->vr_stats.rs_ ## name)++)
+#define	VIONA_RING_STAT_ADD(r, name, val)	\
+	(((r)->vr_stats.rs_ ## name) += (val))
+
+#define	VIONA_RING_IS_RX(idx)	(((idx) & 1) == 0)
+#define	VIONA_RING_IS_TX(idx)	(((idx) & 1) != 0)
 
 
 #define	VIONA_MAX_HDRS_LEN	(sizeof (struct ether_vlan_header) + \
@@ -292,13 +305,17 @@ struct virtio_net_hdr {
 #define	VIRTIO_NET_F_HOST_TSO4		(1 << 11) /* host can accept TSO */
 #define	VIRTIO_NET_F_MRG_RXBUF		(1 << 15) /* host can merge RX bufs */
 #define	VIRTIO_NET_F_STATUS		(1 << 16) /* cfg status field present */
+#define	VIRTIO_NET_F_CTRL_VQ		(1 << 17) /* control channel avail */
+#define	VIRTIO_NET_F_MQ			(1 << 22) /* multiqueue with RSS */
 #define	VIRTIO_F_RING_NOTIFY_ON_EMPTY	(1 << 24)
 #define	VIRTIO_F_RING_INDIRECT_DESC	(1 << 28)
 #define	VIRTIO_F_RING_EVENT_IDX		(1 << 29)
 
 
-void viona_ring_alloc(viona_link_t *, viona_vring_t *);
+void viona_ring_alloc(viona_link_t *, viona_vring_t *, uint16_t);
 void viona_ring_free(viona_vring_t *);
+void viona_ring_stat_init(viona_vring_t *, minor_t);
+void viona_ring_stat_fini(viona_vring_t *);
 int viona_ring_reset(viona_vring_t *, boolean_t);
 int viona_ring_init(viona_link_t *, uint16_t, uint16_t, uint64_t);
 boolean_t viona_ring_lease_renew(viona_vring_t *);
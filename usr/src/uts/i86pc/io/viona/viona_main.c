@@ -49,13 +49,13 @@
  * General Architecture
  * --------------------
  *
- * A single viona instance is comprised of a "link" handle and two "rings".
- * After opening the viona device, it must be associated with a MAC network
- * interface and a bhyve (vmm) instance to form its link resource.  This is
- * done with the VNA_IOC_CREATE ioctl, where the datalink ID and vmm fd are
- * passed in to perform the initialization.  With the MAC client opened, and a
- * driver handle to the vmm instance established, the device is ready to be
- * configured by the guest.
+ * A single viona instance is comprised of a "link" handle and two or more
+ * "rings" (see Multiqueue below).  After opening the viona device, it must be
+ * associated with a MAC network interface and a bhyve (vmm) instance to form
+ * its link resource.  This is done with the VNA_IOC_CREATE ioctl, where the
+ * datalink ID and vmm fd are passed in to perform the initialization.  With
+ * the MAC client opened, and a driver handle to the vmm instance established,
+ * the device is ready to be configured by the guest.
  *
  * The userspace portion of bhyve, which interfaces with the PCI device
  * emulation framework, is meant to stay out of the datapath if at all
@@ -215,6 +215,32 @@
  * notification when ring events necessitate the assertion of an interrupt.
  *
  *
+ * ----------
+ * Multiqueue
+ * ----------
+ *
+ * A link may be configured with up to VIONA_MAX_QPAIRS pairs of RX/TX rings
+ * when the guest negotiates VIRTIO_NET_F_MQ.  Ring indices follow the virtio
+ * queue layout, with RX rings at even indices and TX rings at odd ones, so the
+ * existing per-ring ioctls address the additional rings without change.  Each
+ * ring has its own worker thread, allowing guest transmissions on different
+ * queues to be processed in parallel.
+ *
+ * The control queue, through which the guest selects the number of queue pairs
+ * in use, is emulated by the userspace consumer.  For that reason, viona does
+ * not report VIRTIO_NET_F_MQ or VIRTIO_NET_F_CTRL_VQ via VNA_IOC_GET_FEATURES,
+ * but will accept them in VNA_IOC_SET_FEATURES from a consumer which offered
+ * them to the guest.  The consumer then passes the guest's selection down with
+ * VNA_IOC_SET_USEPAIRS.  bhyve does not emulate the control queue yet, so its
+ * guests are limited to a single queue pair for now.
+ *
+ * Inbound traffic is steered between the active RX rings by hashing on the L4
+ * flow (see viona_rx_classified()), keeping each flow on a single guest queue
+ * while spreading the copy-in work across the MAC threads delivering to us.
+ * Each ring of a pair in use exports its statistics through a named kstat
+ * (viona:<minor>:rxqN and viona:<minor>:txqN).
+ *
+ *
  * ---------------
  * Nethook Support
  * ---------------
@@ -259,6 +285,14 @@
 	VIRTIO_F_RING_NOTIFY_ON_EMPTY |	\
 	VIRTIO_F_RING_INDIRECT_DESC)
 
+/*
+ * Capabilities which depend on the control queue emulated by the userspace
+ * consumer.  These are accepted, but not advertised, by viona.
+ */
+#define	VIONA_S_USERCAPS	(	\
+	VIRTIO_NET_F_CTRL_VQ |		\
+	VIRTIO_NET_F_MQ)
+
 /* MAC_CAPAB_HCKSUM specifics of interest */
 #define	VIONA_CAP_HCKSUM_INTEREST	\
 	(HCKSUM_INET_PARTIAL |		\
@@ -291,6 +325,9 @@ static int viona_ioc_ring_kick(viona_link_t *, uint_t);
 static int viona_ioc_ring_set_msi(viona_link_t *, void *, int);
 static int viona_ioc_ring_intr_clear(viona_link_t *, uint_t);
 static int viona_ioc_intr_poll(viona_link_t *, void *, int, int *);
+static int viona_ioc_intr_poll_mq(viona_link_t *, void *, int, int *);
+static int viona_ioc_set_usepairs(viona_link_t *, minor_t, uint_t);
+static void viona_link_stat_sync(viona_link_t *, minor_t);
 
 static struct cb_ops viona_cb_ops = {
 	viona_open,
@@ -482,6 +519,7 @@ viona_open(dev_t *devp, int flag, int otype, cred_t *credp)
 
 	ss = ddi_get_soft_state(viona_state, minor);
 	mutex_init(&ss->ss_lock, NULL, MUTEX_DEFAULT, NULL);
+	ss->ss_minor = minor;
 	*devp = makedevice(getmajor(*devp), minor);
 
 	return (0);
@@ -553,7 +591,8 @@ viona_ioctl(dev_t dev, int cmd, intptr_t data, int md, cred_t *cr, int *rv)
 			err = EFAULT;
 			break;
 		}
-		val &= (VIONA_S_HOSTCAPS | link->l_features_hw);
+		val &= (VIONA_S_HOSTCAPS | VIONA_S_USERCAPS |
+		    link->l_features_hw);
 
 		if ((val & VIRTIO_NET_F_CSUM) == 0)
 			val &= ~VIRTIO_NET_F_HOST_TSO4;
@@ -561,7 +600,14 @@ viona_ioctl(dev_t dev, int cmd, intptr_t data, int md, cred_t *cr, int *rv)
 		if ((val & VIRTIO_NET_F_GUEST_CSUM) == 0)
 			val &= ~VIRTIO_NET_F_GUEST_TSO4;
 
+		if ((val & VIRTIO_NET_F_CTRL_VQ) == 0)
+			val &= ~VIRTIO_NET_F_MQ;
+
 		link->l_features = val;
+		if ((val & VIRTIO_NET_F_MQ) == 0) {
+			link->l_usepairs = 1;
+			viona_link_stat_sync(link, ss->ss_minor);
+		}
 		break;
 	case VNA_IOC_RING_INIT:
 		err = viona_ioc_ring_init(link, dptr, md);
@@ -581,6 +627,15 @@ viona_ioctl(dev_t dev, int cmd, intptr_t data, int md, cred_t *cr, int *rv)
 	case VNA_IOC_INTR_POLL:
 		err = viona_ioc_intr_poll(link, dptr, md, rv);
 		break;
+	case VNA_IOC_INTR_POLL_MQ:
+		err = viona_ioc_intr_poll_mq(link, dptr, md, rv);
+		break;
+	case VNA_IOC_SET_USEPAIRS:
+		err = viona_ioc_set_usepairs(link, ss->ss_minor, (uint_t)data);
+		break;
+	case VNA_IOC_GET_USEPAIRS:
+		*rv = (int)link->l_usepairs;
+		break;
 	case VNA_IOC_SET_NOTIFY_IOP:
 		if (data < 0 || data > UINT16_MAX) {
 			err = EINVAL;
@@ -617,7 +672,7 @@ viona_chpoll(dev_t dev, short events, int anyyet, short *reventsp,
 
 	*reventsp = 0;
 	if ((events & POLLRDBAND) != 0) {
-		for (uint_t i = 0; i < VIONA_VQ_MAX; i++) {
+		for (uint_t i = 0; i < VIONA_MAX_RINGS; i++) {
 			if (link->l_vrings[i].vr_intr_enabled != 0) {
 				*reventsp |= POLLRDBAND;
 				break;
@@ -729,15 +784,20 @@ viona_ioc_create(viona_soft_state_t *ss, void *dptr, int md, cred_t *cr)
 		goto bail;
 	}
 
-	viona_ring_alloc(link, &link->l_vrings[VIONA_VQ_RX]);
-	viona_ring_alloc(link, &link->l_vrings[VIONA_VQ_TX]);
+	for (uint_t i = 0; i < VIONA_MAX_RINGS; i++) {
+		viona_ring_alloc(link, &link->l_vrings[i], i);
+	}
+	link->l_usepairs = 1;
 
 	if ((err = viona_rx_set(link)) != 0) {
-		viona_ring_free(&link->l_vrings[VIONA_VQ_RX]);
-		viona_ring_free(&link->l_vrings[VIONA_VQ_TX]);
+		for (uint_t i = 0; i < VIONA_MAX_RINGS; i++) {
+			viona_ring_free(&link->l_vrings[i]);
+		}
 		goto bail;
 	}
 
+	viona_link_stat_sync(link, ss->ss_minor);
+
 	link->l_neti = nip;
 	ss->ss_link = link;
 	mutex_exit(&ss->ss_lock);
@@ -808,8 +868,9 @@ viona_ioc_delete(viona_soft_state_t *ss, boolean_t on_close)
 	 * Return the rings to their reset state, ignoring any possible
 	 * interruptions from signals.
 	 */
-	VERIFY0(viona_ring_reset(&link->l_vrings[VIONA_VQ_RX], B_FALSE));
-	VERIFY0(viona_ring_reset(&link->l_vrings[VIONA_VQ_TX], B_FALSE));
+	for (uint_t i = 0; i < VIONA_MAX_RINGS; i++) {
+		VERIFY0(viona_ring_reset(&link->l_vrings[i], B_FALSE));
+	}
 
 	mutex_enter(&ss->ss_lock);
 	if (link->l_mch != NULL) {
@@ -828,8 +889,10 @@ viona_ioc_delete(viona_soft_state_t *ss, boolean_t on_close)
 	nip = link->l_neti;
 	link->l_neti = NULL;
 
-	viona_ring_free(&link->l_vrings[VIONA_VQ_RX]);
-	viona_ring_free(&link->l_vrings[VIONA_VQ_TX]);
+	for (uint_t i = 0; i < VIONA_MAX_RINGS; i++) {
+		viona_ring_stat_fini(&link->l_vrings[i]);
+		viona_ring_free(&link->l_vrings[i]);
+	}
 	pollhead_clean(&link->l_pollhead);
 	ss->ss_link = NULL;
 	mutex_exit(&ss->ss_lock);
@@ -864,7 +927,7 @@ viona_ioc_ring_reset(viona_link_t *link, uint_t idx)
 {
 	viona_vring_t *ring;
 
-	if (idx >= VIONA_VQ_MAX) {
+	if (idx >= VIONA_MAX_RINGS) {
 		return (EINVAL);
 	}
 	ring = &link->l_vrings[idx];
@@ -878,7 +941,7 @@ viona_ioc_ring_kick(viona_link_t *link, uint_t idx)
 	viona_vring_t *ring;
 	int err;
 
-	if (idx >= VIONA_VQ_MAX) {
+	if (idx >= VIONA_MAX_RINGS) {
 		return (EINVAL);
 	}
 	ring = &link->l_vrings[idx];
@@ -917,7 +980,7 @@ viona_ioc_ring_set_msi(viona_link_t *link, void *data, int md)
 	if (ddi_copyin(data, &vrm, sizeof (vrm), md) != 0) {
 		return (EFAULT);
 	}
-	if (vrm.rm_index >= VIONA_VQ_MAX) {
+	if (vrm.rm_index >= VIONA_MAX_RINGS) {
 		return (EINVAL);
 	}
 
@@ -975,7 +1038,7 @@ viona_ioc_set_notify_ioport(viona_link_t *link, uint16_t ioport)
 static int
 viona_ioc_ring_intr_clear(viona_link_t *link, uint_t idx)
 {
-	if (idx >= VIONA_VQ_MAX) {
+	if (idx >= VIONA_MAX_RINGS) {
 		return (EINVAL);
 	}
 
@@ -1004,3 +1067,65 @@ viona_ioc_intr_poll(viona_link_t *link, void *udata, int md, int *rv)
 	*rv = (int)cnt;
 	return (0);
 }
+
+static int
+viona_ioc_intr_poll_mq(viona_link_t *link, void *udata, int md, int *rv)
+{
+	uint_t cnt = 0;
+	vioc_intr_poll_mq_t vipm;
+
+	bzero(&vipm, sizeof (vipm));
+	vipm.vipm_nrings = link->l_usepairs * 2;
+	for (uint_t i = 0; i < vipm.vipm_nrings; i++) {
+		uint_t val = link->l_vrings[i].vr_intr_enabled;
+
+		vipm.vipm_status[i] = val;
+		if (val != 0) {
+			cnt++;
+		}
+	}
+
+	if (ddi_copyout(&vipm, udata, sizeof (vipm), md) != 0) {
+		return (EFAULT);
+	}
+	*rv = (int)cnt;
+	return (0);
+}
+
+/*
+ * Create the kstats of the rings of the queue pairs in use, and remove those of
+ * the others.
+ */
+static void
+viona_link_stat_sync(viona_link_t *link, minor_t minor)
+{
+	for (uint_t i = 0; i < VIONA_MAX_RINGS; i++) {
+		viona_vring_t *ring = &link->l_vrings[i];
+
+		if (i < link->l_usepairs * 2) {
+			if (ring->vr_kstat == NULL)
+				viona_ring_stat_init(ring, minor);
+		} else {
+			viona_ring_stat_fini(ring);
+		}
+	}
+}
+
+static int
+viona_ioc_set_usepairs(viona_link_t *link, minor_t minor, uint_t pairs)
+{
+	if (pairs == 0 || pairs > VIONA_MAX_QPAIRS) {
+		return (EINVAL);
+	}
+	if (pairs > 1 && (link->l_features & VIRTIO_NET_F_MQ) == 0) {
+		return (EINVAL);
+	}
+
+	/*
+	 * Rings beyond the new limit are left in whatever state the guest put
+	 * them in; they simply stop receiving steered traffic.
+	 */
+	link->l_usepairs = (uint16_t)pairs;
+	viona_link_stat_sync(link, minor);
+	return (0);
+}
@@ -49,6 +49,39 @@ static boolean_t viona_ring_map(viona_vring_t *);
 static void viona_ring_unmap(viona_vring_t *);
 static kthread_t *viona_create_worker(viona_vring_t *);
 
+/*
+ * Names for the per-ring kstats.  These must be kept in the same order as the
+ * members of struct viona_ring_stats, all of which are uint64_t.
+ */
+static const char *viona_ring_stat_names[] = {
+	"packets",
+	"bytes",
+	"ndesc_too_high",
+	"bad_idx",
+	"indir_bad_len",
+	"indir_bad_nest",
+	"indir_bad_next",
+	"no_space",
+	"too_many_desc",
+	"desc_bad_len",
+	"bad_ring_addr",
+	"fail_hcksum",
+	"fail_hcksum6",
+	"fail_hcksum_proto",
+	"bad_rx_frame",
+	"rx_merge_overrun",
+	"rx_merge_underrun",
+	"rx_pad_short",
+	"rx_mcast_check",
+	"too_short",
+	"tx_absent",
+	"rx_hookdrop",
+	"tx_hookdrop",
+};
+
+CTASSERT(ARRAY_SIZE(viona_ring_stat_names) ==
+    sizeof (struct viona_ring_stats) / sizeof (uint64_t));
+
 static void *
 viona_gpa2kva(viona_vring_t *ring, uint64_t gpa, size_t len)
 {
@@ -122,9 +155,10 @@ viona_ring_lease_renew(viona_vring_t *ring)
 }
 
 void
-viona_ring_alloc(viona_link_t *link, viona_vring_t *ring)
+viona_ring_alloc(viona_link_t *link, viona_vring_t *ring, uint16_t idx)
 {
 	ring->vr_link = link;
+	ring->vr_index = idx;
 	mutex_init(&ring->vr_lock, NULL, MUTEX_DRIVER, NULL);
 	cv_init(&ring->vr_cv, NULL, CV_DRIVER, NULL);
 	mutex_init(&ring->vr_a_mutex, NULL, MUTEX_DRIVER, NULL);
@@ -149,6 +183,58 @@ viona_ring_free(viona_vring_t *ring)
 	ring->vr_link = NULL;
 }
 
+static int
+viona_ring_stat_update(kstat_t *ksp, int rw)
+{
+	viona_vring_t *ring = ksp->ks_private;
+	kstat_named_t *knp = ksp->ks_data;
+	const uint64_t *vals = (const uint64_t *)&ring->vr_stats;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (uint_t i = 0; i < ksp->ks_ndata; i++)
+		knp[i].value.ui64 = vals[i];
+
+	return (0);
+}
+
+void
+viona_ring_stat_init(viona_vring_t *ring, minor_t minor)
+{
+	char name[KSTAT_STRLEN];
+	kstat_named_t *knp;
+	kstat_t *ksp;
+	const uint_t nstats = ARRAY_SIZE(viona_ring_stat_names);
+
+	(void) snprintf(name, sizeof (name), "%s%u",
+	    VIONA_RING_IS_RX(ring->vr_index) ? "rxq" : "txq",
+	    ring->vr_index / 2);
+	ksp = kstat_create("viona", minor, name, "net", KSTAT_TYPE_NAMED,
+	    nstats, 0);
+	if (ksp == NULL)
+		return;
+
+	knp = ksp->ks_data;
+	for (uint_t i = 0; i < nstats; i++) {
+		kstat_named_init(&knp[i], viona_ring_stat_names[i],
+		    KSTAT_DATA_UINT64);
+	}
+	ksp->ks_private = ring;
+	ksp->ks_update = viona_ring_stat_update;
+	kstat_install(ksp);
+	ring->vr_kstat = ksp;
+}
+
+void
+viona_ring_stat_fini(viona_vring_t *ring)
+{
+	if (ring->vr_kstat != NULL) {
+		kstat_delete(ring->vr_kstat);
+		ring->vr_kstat = NULL;
+	}
+}
+
 int
 viona_ring_init(viona_link_t *link, uint16_t idx, uint16_t qsz, uint64_t pa)
 {
@@ -156,7 +242,7 @@ viona_ring_init(viona_link_t *link, uint16_t idx, uint16_t qsz, uint64_t pa)
 	kthread_t *t;
 	int err = 0;
 
-	if (idx >= VIONA_VQ_MAX) {
+	if (idx >= VIONA_MAX_RINGS) {
 		return (EINVAL);
 	}
 	if (qsz == 0 || qsz > VRING_MAX_LEN || (1 << (ffs(qsz) - 1)) != qsz) {
@@ -188,7 +274,7 @@ viona_ring_init(viona_link_t *link, uint16_t idx, uint16_t qsz, uint64_t pa)
 	/* Initialize queue indexes */
 	ring->vr_cur_aidx = 0;
 
-	if (idx == VIONA_VQ_TX) {
+	if (VIONA_RING_IS_TX(idx)) {
 		viona_tx_ring_alloc(ring, qsz);
 	}
 
@@ -381,12 +467,11 @@ viona_worker(void *arg)
 	}
 
 	/* Process actual work */
-	if (ring == &link->l_vrings[VIONA_VQ_RX]) {
+	VERIFY3P(ring, ==, &link->l_vrings[ring->vr_index]);
+	if (VIONA_RING_IS_RX(ring->vr_index)) {
 		viona_worker_rx(ring, link);
-	} else if (ring == &link->l_vrings[VIONA_VQ_TX]) {
-		viona_worker_tx(ring, link);
 	} else {
-		panic("unexpected ring: %p", (void *)ring);
+		viona_worker_tx(ring, link);
 	}
 
 	VERIFY3U(ring->vr_state, ==, VRS_STOP);
@@ -460,7 +460,7 @@ viona_rx_common(viona_vring_t *ring, mblk_t *mp, boolean_t is_loopback)
 	const boolean_t do_merge =
 	    ((link->l_features & VIRTIO_NET_F_MRG_RXBUF) != 0);
 
-	size_t nrx = 0, ndrop = 0;
+	size_t nrx = 0, ndrop = 0, nbytes = 0;
 
 	while (mp != NULL) {
 		mblk_t *next = mp->b_next;
@@ -578,6 +578,7 @@ pad_drop:
 			*mprx_prevp = mp;
 			mprx_prevp = &mp->b_next;
 			nrx++;
+			nbytes += size;
 		}
 		mp = next;
 	}
@@ -602,15 +603,14 @@ pad_drop:
 		mp = next;
 		ndrop++;
 	}
+	VIONA_RING_STAT_ADD(ring, packets, nrx);
+	VIONA_RING_STAT_ADD(ring, bytes, nbytes);
 	VIONA_PROBE3(rx, viona_link_t *, link, size_t, nrx, size_t, ndrop);
 }
 
 static void
-viona_rx_classified(void *arg, mac_resource_handle_t mrh, mblk_t *mp,
-    boolean_t is_loopback)
+viona_rx_ring(viona_vring_t *ring, mblk_t *mp, boolean_t is_loopback)
 {
-	viona_vring_t *ring = (viona_vring_t *)arg;
-
 	/* Drop traffic if ring is inactive or renewing its lease */
 	if (ring->vr_state != VRS_RUN ||
 	    (ring->vr_state_flags & VRSF_RENEW) != 0) {
@@ -621,6 +621,57 @@ viona_rx_classified(void *arg, mac_resource_handle_t mrh, mblk_t *mp,
 	viona_rx_common(ring, mp, is_loopback);
 }
 
+/*
+ * When multiple queue pairs are in use, split the chain by flow so that each
+ * flow is consistently delivered to the same guest RX ring.
+ */
+static void
+viona_rx_steer(viona_link_t *link, uint_t npairs, mblk_t *mp,
+    boolean_t is_loopback)
+{
+	mblk_t *heads[VIONA_MAX_QPAIRS] = { NULL };
+	mblk_t **tailp[VIONA_MAX_QPAIRS];
+
+	ASSERT3U(npairs, <=, VIONA_MAX_QPAIRS);
+
+	for (uint_t i = 0; i < npairs; i++) {
+		tailp[i] = &heads[i];
+	}
+
+	while (mp != NULL) {
+		mblk_t *next = mp->b_next;
+		uint_t q;
+
+		mp->b_next = NULL;
+		q = mac_pkt_hash(DL_ETHER, mp, MAC_PKT_HASH_L4, B_FALSE) %
+		    npairs;
+		*tailp[q] = mp;
+		tailp[q] = &mp->b_next;
+		mp = next;
+	}
+
+	for (uint_t i = 0; i < npairs; i++) {
+		if (heads[i] != NULL) {
+			viona_rx_ring(&link->l_vrings[i * 2], heads[i],
+			    is_loopback);
+		}
+	}
+}
+
+static void
+viona_rx_classified(void *arg, mac_resource_handle_t mrh, mblk_t *mp,
+    boolean_t is_loopback)
+{
+	viona_link_t *link = (viona_link_t *)arg;
+	const uint_t npairs = link->l_usepairs;
+
+	if (npairs > 1) {
+		viona_rx_steer(link, npairs, mp, is_loopback);
+	} else {
+		viona_rx_ring(&link->l_vrings[VIONA_VQ_RX], mp, is_loopback);
+	}
+}
+
 static void
 viona_rx_mcast(void *arg, mac_resource_handle_t mrh, mblk_t *mp,
     boolean_t is_loopback)
@@ -699,7 +750,12 @@ viona_rx_set(viona_link_t *link)
 	viona_vring_t *ring = &link->l_vrings[VIONA_VQ_RX];
 	int err;
 
-	mac_rx_set(link->l_mch, viona_rx_classified, ring);
+	/*
+	 * Classified traffic may be steered to any of the active RX rings,
+	 * while multicast (being comparatively rare) is always delivered to the
+	 * first one.
+	 */
+	mac_rx_set(link->l_mch, viona_rx_classified, link);
 	err = mac_promisc_add(link->l_mch, MAC_CLIENT_PROMISC_MULTI,
 	    viona_rx_mcast, ring, &link->l_mph,
 	    MAC_PROMISC_FLAGS_NO_TX_LOOP | MAC_PROMISC_FLAGS_VLAN_TAG_STRIP);
@@ -703,6 +703,9 @@ viona_tx(viona_link_t *link, viona_vring_t *ring)
 		viona_tx_done(ring, len, cookie);
 	}
 
+	VIONA_RING_STAT_INCR(ring, packets);
+	VIONA_RING_STAT_ADD(ring, bytes, len - iov[0].iov_len);
+
 	/*
 	 * We're potentially going deep into the networking layer; make sure the
 	 * guest can't run concurrently.
@@ -36,6 +36,7 @@
  * http://www.illumos.org/license/CDDL.
  *
  * Copyright 2020 Oxide Computer Company
+ * Copyright 2026 Joyent, Inc.
  */
 
 #include <sys/cdefs.h>
@@ -265,15 +266,27 @@ vm_inout_detach(struct ioport_config *cfg, uint16_t port, bool drv_hook,
 	return (0);
 }
 
+/*
+ * Find the handler for a port.  This is on the path of every guest in/out
+ * instruction, including the virtqueue notifications which the in-kernel
+ * viona and viob devices hook, so the entries (which vm_inout_attach() keeps
+ * sorted by port) are searched by bisection.
+ */
 static ioport_entry_t *
 vm_inout_find(const struct ioport_config *cfg, uint16_t port)
 {
-	const uint_t count = cfg->iop_count;
 	ioport_entry_t *entries = cfg->iop_entries;
+	uint_t lo = 0, hi = cfg->iop_count;
+
+	while (lo < hi) {
+		const uint_t mid = lo + (hi - lo) / 2;
 
-	for (uint_t i = 0; i < count; i++) {
-		if (entries[i].iope_port == port) {
-			return (&entries[i]);
+		if (entries[mid].iope_port == port) {
+			return (&entries[mid]);
+		} else if (entries[mid].iope_port < port) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
 	return (NULL);
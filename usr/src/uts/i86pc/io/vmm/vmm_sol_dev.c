@@ -1579,7 +1579,7 @@ fail:
  * - Hooking IO port addresses
  *
  * The vmm_drv interface exists to provide that functionality to its consumers.
- * (At this time, 'viona' is the only user)
+ * (At this time, 'viona' and 'viob' are its users)
  */
 int
 vmm_drv_hold(file_t *fp, cred_t *cr, vmm_hold_t **holdp)
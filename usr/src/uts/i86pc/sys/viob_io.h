@@ -0,0 +1,75 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2026 Joyent, Inc.
+ */
+
+#ifndef	_VIOB_IO_H_
+#define	_VIOB_IO_H_
+
+#define	VIOB_IOC		(('V' << 16)|('B' << 8))
+#define	VIOB_IOC_CREATE		(VIOB_IOC | 0x01)
+#define	VIOB_IOC_DELETE		(VIOB_IOC | 0x02)
+
+#define	VIOB_IOC_RING_INIT	(VIOB_IOC | 0x10)
+#define	VIOB_IOC_RING_RESET	(VIOB_IOC | 0x11)
+#define	VIOB_IOC_RING_KICK	(VIOB_IOC | 0x12)
+#define	VIOB_IOC_RING_SET_MSI	(VIOB_IOC | 0x13)
+#define	VIOB_IOC_RING_INTR_CLR	(VIOB_IOC | 0x14)
+
+#define	VIOB_IOC_INTR_POLL	(VIOB_IOC | 0x20)
+#define	VIOB_IOC_SET_FEATURES	(VIOB_IOC | 0x21)
+#define	VIOB_IOC_GET_FEATURES	(VIOB_IOC | 0x22)
+#define	VIOB_IOC_SET_NOTIFY_IOP	(VIOB_IOC | 0x23)
+
+/* Length of the serial number returned for VIRTIO_BLK_T_GET_ID */
+#define	VIOB_IDENT_LEN		20
+
+/*
+ * Maximum number of data segments in a request, not counting the header and
+ * status descriptors which bracket them.
+ */
+#define	VIOB_IOV_MAX		128
+
+#define	VIOB_CREATE_RDONLY	0x1
+
+typedef struct vioc_blk_create {
+	int		c_vmfd;
+	int		c_fd;		/* backing file or zvol */
+	uint32_t	c_flags;	/* VIOB_CREATE_* */
+	char		c_ident[VIOB_IDENT_LEN];
+} vioc_blk_create_t;
+
+/*
+ * The ring and MSI structures are those of viona, whose ring handling viob
+ * mirrors.
+ */
+typedef struct vioc_blk_ring_init {
+	uint16_t	ri_index;
+	uint16_t	ri_qsize;
+	uint64_t	ri_qaddr;
+} vioc_blk_ring_init_t;
+
+typedef struct vioc_blk_ring_msi {
+	uint16_t	rm_index;
+	uint64_t	rm_addr;
+	uint64_t	rm_msg;
+} vioc_blk_ring_msi_t;
+
+/* A virtio-blk device has a single request queue */
+#define	VIOB_VQ_MAX		1
+
+typedef struct vioc_blk_intr_poll {
+	uint32_t	vip_status[VIOB_VQ_MAX];
+} vioc_blk_intr_poll_t;
+
+#endif	/* _VIOB_IO_H_ */
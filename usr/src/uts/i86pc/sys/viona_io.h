@@ -31,6 +31,9 @@
 #define	VNA_IOC_SET_FEATURES	(VNA_IOC | 0x21)
 #define	VNA_IOC_GET_FEATURES	(VNA_IOC | 0x22)
 #define	VNA_IOC_SET_NOTIFY_IOP	(VNA_IOC | 0x23)
+#define	VNA_IOC_SET_USEPAIRS	(VNA_IOC | 0x24)
+#define	VNA_IOC_GET_USEPAIRS	(VNA_IOC | 0x25)
+#define	VNA_IOC_INTR_POLL_MQ	(VNA_IOC | 0x26)
 
 typedef struct vioc_create {
 	datalink_id_t	c_linkid;
@@ -59,5 +62,18 @@ typedef struct vioc_intr_poll {
 	uint32_t	vip_status[VIONA_VQ_MAX];
 } vioc_intr_poll_t;
 
+/*
+ * With VIRTIO_NET_F_MQ, ring indices follow the virtio queue layout: RX rings
+ * are even and TX rings are odd, such that queue pair N consists of rings 2N
+ * and 2N + 1.  The control queue is not handled by viona.
+ */
+#define	VIONA_MAX_QPAIRS	16
+#define	VIONA_MAX_RINGS		(VIONA_MAX_QPAIRS * 2)
+
+typedef struct vioc_intr_poll_mq {
+	uint32_t	vipm_nrings;
+	uint32_t	vipm_status[VIONA_MAX_RINGS];
+} vioc_intr_poll_mq_t;
+
 
 #endif	/* _VIONA_IO_H_ */